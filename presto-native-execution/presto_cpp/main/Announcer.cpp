@@ -16,24 +16,17 @@
 #include <boost/lexical_cast.hpp>
 #include <boost/uuid/uuid_generators.hpp>
 #include <boost/uuid/uuid_io.hpp>
+#include <folly/Random.h>
+#include <velox/common/base/StatsReporter.h>
 #include <velox/common/memory/Memory.h>
 #include "presto_cpp/external/json/json.hpp"
+#include "presto_cpp/main/common/Counters.h"
 #include "presto_cpp/main/http/HttpClient.h"
 
 namespace facebook::presto {
 namespace {
 
-std::string announcementBody(
-    const std::string& address,
-    bool useHttps,
-    int port,
-    const std::string& nodeVersion,
-    const std::string& environment,
-    const std::string& nodeLocation,
-    const std::vector<std::string>& connectorIds) {
-  std::string id =
-      boost::lexical_cast<std::string>(boost::uuids::random_generator()());
-
+std::string joinConnectorIds(const std::vector<std::string>& connectorIds) {
   std::ostringstream connectors;
   for (int i = 0; i < connectorIds.size(); i++) {
     if (i > 0) {
@@ -41,22 +34,35 @@ std::string announcementBody(
     }
     connectors << connectorIds[i];
   }
+  return connectors.str();
+}
 
+std::string announcementBody(
+    const std::string& id,
+    const std::string& address,
+    bool useHttps,
+    int port,
+    const std::string& nodeVersion,
+    const std::string& environment,
+    const std::string& nodeLocation,
+    const std::string& connectorIds,
+    const std::map<std::string, std::string>& extraProperties) {
   const auto uriScheme = useHttps ? "https" : "http";
 
+  nlohmann::json properties = {
+      {"node_version", nodeVersion},
+      {"coordinator", false},
+      {"connectorIds", connectorIds},
+      {uriScheme, fmt::format("{}://{}:{}", uriScheme, address, port)}};
+  for (const auto& [name, value] : extraProperties) {
+    properties[name] = value;
+  }
   nlohmann::json body = {
       {"environment", environment},
       {"pool", "general"},
       {"location", nodeLocation},
       {"services",
-       {{{"id", id},
-         {"type", "presto"},
-         {"properties",
-          {{"node_version", nodeVersion},
-           {"coordinator", false},
-           {"connectorIds", connectors.str()},
-           {uriScheme,
-            fmt::format("{}://{}:{}", uriScheme, address, port)}}}}}}};
+       {{{"id", id}, {"type", "presto"}, {"properties", properties}}}}};
   return body.dump();
 }
 
@@ -76,6 +82,18 @@ proxygen::HTTPMessage announcementRequest(
       proxygen::HTTP_HEADER_CONTENT_LENGTH, std::to_string(body.size()));
   return request;
 }
+
+proxygen::HTTPMessage unannouncementRequest(
+    const std::string& address,
+    int port,
+    const std::string& nodeId) {
+  proxygen::HTTPMessage request;
+  request.setMethod(proxygen::HTTPMethod::DELETE);
+  request.setURL(fmt::format("/v1/announcement/{}", nodeId));
+  request.getHeaders().set(
+      proxygen::HTTP_HEADER_HOST, fmt::format("{}:{}", address, port));
+  return request;
+}
 } // namespace
 
 Announcer::Announcer(
@@ -88,19 +106,34 @@ Announcer::Announcer(
     const std::string& nodeId,
     const std::string& nodeLocation,
     const std::vector<std::string>& connectorIds,
-    uint64_t frequencyMs)
+    uint64_t frequencyMs,
+    uint64_t maxBackoffMs)
     : discoveryAddressLookup_(std::move(discoveryAddressLookup)),
       frequencyMs_(frequencyMs),
+      maxBackoffMs_(std::max(frequencyMs, maxBackoffMs)),
+      nodeAddress_(address),
+      useHttps_(useHttps),
+      port_(port),
+      nodeId_(nodeId),
+      nodeVersion_(nodeVersion),
+      environment_(environment),
+      nodeLocation_(nodeLocation),
+      connectorIds_(joinConnectorIds(connectorIds)),
+      serviceId_(
+          boost::lexical_cast<std::string>(boost::uuids::random_generator()())),
       announcementBody_(announcementBody(
-          address,
-          useHttps,
-          port,
-          nodeVersion,
-          environment,
-          nodeLocation,
-          connectorIds)),
+          serviceId_,
+          nodeAddress_,
+          useHttps_,
+          port_,
+          nodeVersion_,
+          environment_,
+          nodeLocation_,
+          connectorIds_,
+          properties_)),
       announcementRequest_(
           announcementRequest(address, port, nodeId, announcementBody_)),
+      unannouncementRequest_(unannouncementRequest(address, port, nodeId)),
       pool_(velox::memory::addDefaultLeafMemoryPool("Announcer")),
       eventBaseThread_(false /*autostart*/) {}
 
@@ -116,11 +149,87 @@ void Announcer::start() {
   eventBase->schedule([this]() { return makeAnnouncement(); });
 }
 
+void Announcer::setPropertiesSupplier(PropertiesSupplier supplier) {
+  auto* eventBase = eventBaseThread_.getEventBase();
+  if (eventBase == nullptr) {
+    propertiesSupplier_ = std::move(supplier);
+    return;
+  }
+  eventBase->runInEventBaseThread(
+      [this, supplier = std::move(supplier)]() mutable {
+        propertiesSupplier_ = std::move(supplier);
+      });
+}
+
+void Announcer::updateAnnouncement() {
+  if (propertiesSupplier_ == nullptr) {
+    return;
+  }
+  auto properties = propertiesSupplier_();
+  if (properties == properties_) {
+    return;
+  }
+  properties_ = std::move(properties);
+  announcementBody_ = announcementBody(
+      serviceId_,
+      nodeAddress_,
+      useHttps_,
+      port_,
+      nodeVersion_,
+      environment_,
+      nodeLocation_,
+      connectorIds_,
+      properties_);
+  announcementRequest_ =
+      announcementRequest(nodeAddress_, port_, nodeId_, announcementBody_);
+}
+
 void Announcer::stop() {
   stopped_ = true;
   eventBaseThread_.stop();
 }
 
+void Announcer::unannounce(std::chrono::milliseconds timeout) {
+  if (stopped_.exchange(true)) {
+    return;
+  }
+  auto [promise, future] = folly::makePromiseContract<folly::Unit>();
+  auto* eventBase = eventBaseThread_.getEventBase();
+  eventBase->runInEventBaseThread([this,
+                                   eventBase,
+                                   promise = std::move(promise)]() mutable {
+    try {
+      if (client_ == nullptr) {
+        address_ = discoveryAddressLookup_();
+        client_ = std::make_unique<http::HttpClient>(
+            eventBase, address_, std::chrono::milliseconds(10'000));
+      }
+    } catch (const std::exception& ex) {
+      LOG(WARNING) << "Unannouncement failed: " << ex.what();
+      promise.setValue();
+      return;
+    }
+    client_->sendRequest(unannouncementRequest_, pool_.get())
+        .via(eventBase)
+        .thenValue([](auto response) {
+          LOG(INFO) << "Unannouncement: HTTP "
+                    << response->headers()->getStatusCode();
+        })
+        .thenError(
+            folly::tag_t<std::exception>{},
+            [](const std::exception& e) {
+              LOG(WARNING) << "Unannouncement failed: " << e.what();
+            })
+        .thenTry([promise = std::move(promise)](auto /*unused*/) mutable {
+          promise.setValue();
+        });
+  });
+  if (!std::move(future).wait(timeout).isReady()) {
+    LOG(WARNING) << "Unannouncement timed out after " << timeout.count()
+                 << "ms";
+  }
+}
+
 void Announcer::makeAnnouncement() {
   // stop() calls EventBase's destructor which executed all pending callbacks;
   // make sure not to do anything if that's the case
@@ -141,11 +250,25 @@ void Announcer::makeAnnouncement() {
     }
   } catch (const std::exception& ex) {
     LOG(WARNING) << "Error occurred during announcement run: " << ex.what();
-    scheduleNext();
+    scheduleNext(false);
     return;
   }
 
-  client_->sendRequest(announcementRequest_, pool_.get(), announcementBody_)
+  try {
+    updateAnnouncement();
+  } catch (const std::exception& ex) {
+    LOG(WARNING) << "Failed to get the announced properties: " << ex.what();
+  }
+
+  // 'announcementBody_' outlives the request as the event base thread is
+  // stopped before this announcer is destroyed, and it is only rebuilt once
+  // the request is done.
+  client_
+      ->sendRequest(
+          announcementRequest_,
+          pool_.get(),
+          folly::IOBuf::wrapBuffer(
+              announcementBody_.data(), announcementBody_.size()))
       .via(eventBaseThread_.getEventBase())
       .thenValue([](auto response) {
         auto message = response->headers();
@@ -153,28 +276,48 @@ void Announcer::makeAnnouncement() {
           LOG(WARNING) << "Announcement failed: HTTP "
                        << message->getStatusCode() << " - "
                        << response->dumpBodyChain();
+          return false;
         } else if (response->hasError()) {
           LOG(ERROR) << "Announcement failed: " << response->error();
-        } else {
-          LOG(INFO) << "Announcement succeeded: " << message->getStatusCode();
+          return false;
         }
+        LOG(INFO) << "Announcement succeeded: " << message->getStatusCode();
+        return true;
       })
       .thenError(
           folly::tag_t<std::exception>{},
           [](const std::exception& e) {
             LOG(WARNING) << "Announcement failed: " << e.what();
+            return false;
           })
-      .thenTry([this](auto /*unused*/) { scheduleNext(); });
+      .thenTry([this](folly::Try<bool> succeeded) {
+        scheduleNext(succeeded.hasValue() && succeeded.value());
+      });
 }
 
-void Announcer::scheduleNext() {
+void Announcer::scheduleNext(bool succeeded) {
   if (stopped_) {
     return;
   }
+  uint64_t delayMs;
+  if (succeeded) {
+    numConsecutiveFailures_ = 0;
+    // Up to 10% early, which spreads out the announcements of the workers
+    // started together without letting the announcement expire.
+    delayMs = static_cast<uint64_t>(
+        frequencyMs_ * folly::Random::randDouble(0.9, 1.0));
+  } else {
+    REPORT_ADD_STAT_VALUE(kCounterNumAnnouncementFailures, 1);
+    // Doubles the interval per consecutive failure, then takes a random part
+    // of the upper half of it.
+    const auto exponent = std::min<uint32_t>(numConsecutiveFailures_++, 20);
+    const auto backoffMs = std::min(frequencyMs_ << exponent, maxBackoffMs_);
+    delayMs =
+        static_cast<uint64_t>(backoffMs * folly::Random::randDouble(0.5, 1.0));
+  }
   eventBaseThread_.getEventBase()->scheduleAt(
       [this]() { return makeAnnouncement(); },
-      std::chrono::steady_clock::now() +
-          std::chrono::milliseconds(frequencyMs_));
+      std::chrono::steady_clock::now() + std::chrono::milliseconds(delayMs));
 }
 
 } // namespace facebook::presto
@@ -14,12 +14,21 @@
 #pragma once
 
 #include <folly/io/async/EventBaseThread.h>
+#include <map>
 #include <presto_cpp/main/http/HttpClient.h>
 
 namespace facebook::presto {
 
 class Announcer {
  public:
+  /// Returns the extra properties to announce, e.g. the load of the node.
+  using PropertiesSupplier =
+      std::function<std::map<std::string, std::string>()>;
+
+  /// Announces every 'frequencyMs'. After consecutive failures the interval
+  /// grows exponentially up to 'maxBackoffMs', with jitter so that a fleet of
+  /// workers does not hit the discovery service in lockstep after its
+  /// restart.
   Announcer(
       const std::string& address,
       bool useHttps,
@@ -30,23 +39,55 @@ class Announcer {
       const std::string& nodeId,
       const std::string& nodeLocation,
       const std::vector<std::string>& connectorIds,
-      uint64_t frequencyMs);
+      uint64_t frequencyMs,
+      uint64_t maxBackoffMs = 300'000);
 
   ~Announcer();
 
   void start();
 
+  /// Sets the supplier of the properties added to the announcements. The
+  /// announcement body is rebuilt only when the supplied properties change.
+  void setPropertiesSupplier(PropertiesSupplier supplier);
+
   void stop();
 
+  /// Stops the announcements and removes this node from the discovery
+  /// service, so that the coordinator stops scheduling new work on it right
+  /// away. Waits up to 'timeout' for the discovery service to reply.
+  void unannounce(
+      std::chrono::milliseconds timeout = std::chrono::milliseconds(5'000));
+
  private:
   void makeAnnouncement();
 
-  void scheduleNext();
+  // Schedules the next announcement, backing off if this one failed.
+  void scheduleNext(bool succeeded);
+
+  // Rebuilds 'announcementBody_' and 'announcementRequest_' if the supplied
+  // properties changed.
+  void updateAnnouncement();
 
   const std::function<folly::SocketAddress()> discoveryAddressLookup_;
   const uint64_t frequencyMs_;
-  const std::string announcementBody_;
-  const proxygen::HTTPMessage announcementRequest_;
+  const uint64_t maxBackoffMs_;
+  const std::string nodeAddress_;
+  const bool useHttps_;
+  const int port_;
+  const std::string nodeId_;
+  const std::string nodeVersion_;
+  const std::string environment_;
+  const std::string nodeLocation_;
+  const std::string connectorIds_;
+  // The id of the announced service, the same across announcements.
+  const std::string serviceId_;
+  // Set and used on the event base thread.
+  PropertiesSupplier propertiesSupplier_;
+  std::map<std::string, std::string> properties_;
+  std::string announcementBody_;
+  proxygen::HTTPMessage announcementRequest_;
+  uint32_t numConsecutiveFailures_{0};
+  const proxygen::HTTPMessage unannouncementRequest_;
   const std::shared_ptr<velox::memory::MemoryPool> pool_;
   folly::SocketAddress address_;
   std::unique_ptr<http::HttpClient> client_;
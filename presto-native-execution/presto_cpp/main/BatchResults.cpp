@@ -0,0 +1,134 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/BatchResults.h"
+
+#include <folly/io/Cursor.h>
+
+#include "presto_cpp/external/json/json.hpp"
+#include "velox/common/base/Exceptions.h"
+
+namespace facebook::presto {
+namespace {
+// int64 sequence, int64 next sequence, int8 complete, int8 error and int64
+// payload size.
+constexpr size_t kFrameHeaderBytes{26};
+
+std::unique_ptr<folly::IOBuf> makeFrameHeader(
+    int64_t sequence,
+    int64_t nextSequence,
+    bool complete,
+    bool error,
+    int64_t payloadBytes) {
+  auto header = folly::IOBuf::create(kFrameHeaderBytes);
+  folly::io::Appender appender(header.get(), 0);
+  appender.writeLE<int64_t>(sequence);
+  appender.writeLE<int64_t>(nextSequence);
+  appender.write<uint8_t>(complete ? 1 : 0);
+  appender.write<uint8_t>(error ? 1 : 0);
+  appender.writeLE<int64_t>(payloadBytes);
+  return header;
+}
+} // namespace
+
+std::string serializeResultLocations(
+    const std::vector<ResultLocation>& locations) {
+  nlohmann::json body = nlohmann::json::array();
+  for (const auto& location : locations) {
+    body.push_back(
+        {{"taskId", location.taskId},
+         {"bufferId", location.bufferId},
+         {"token", location.token}});
+  }
+  return body.dump();
+}
+
+std::vector<ResultLocation> parseResultLocations(const std::string& body) {
+  const auto json = nlohmann::json::parse(body);
+  VELOX_USER_CHECK(
+      json.is_array() && !json.empty(),
+      "Batched results request must be a non-empty json array");
+  std::vector<ResultLocation> locations;
+  locations.reserve(json.size());
+  for (const auto& entry : json) {
+    locations.push_back(
+        {entry.at("taskId").get<std::string>(),
+         entry.at("bufferId").get<long>(),
+         entry.at("token").get<long>()});
+  }
+  return locations;
+}
+
+std::unique_ptr<folly::IOBuf> serializeBatchResults(
+    std::vector<folly::Try<std::unique_ptr<Result>>>& results) {
+  std::unique_ptr<folly::IOBuf> body;
+  auto appendToBody = [&](std::unique_ptr<folly::IOBuf> buf) {
+    if (body == nullptr) {
+      body = std::move(buf);
+    } else {
+      body->prev()->appendChain(std::move(buf));
+    }
+  };
+  for (auto& result : results) {
+    if (result.hasException()) {
+      auto error = result.exception().what().toStdString();
+      appendToBody(makeFrameHeader(0, 0, false, true, error.size()));
+      appendToBody(folly::IOBuf::copyBuffer(error));
+      continue;
+    }
+    auto& value = result.value();
+    const int64_t dataBytes =
+        value->data != nullptr ? value->data->computeChainDataLength() : 0;
+    appendToBody(makeFrameHeader(
+        value->sequence,
+        value->nextSequence,
+        value->complete,
+        false,
+        dataBytes));
+    if (dataBytes > 0) {
+      appendToBody(std::move(value->data));
+    }
+  }
+  return body != nullptr ? std::move(body) : folly::IOBuf::create(0);
+}
+
+std::vector<BatchResult> parseBatchResults(std::unique_ptr<folly::IOBuf> body) {
+  std::vector<BatchResult> results;
+  if (body == nullptr) {
+    return results;
+  }
+  folly::io::Cursor cursor(body.get());
+  while (!cursor.isAtEnd()) {
+    VELOX_CHECK(
+        cursor.canAdvance(kFrameHeaderBytes),
+        "Truncated batched results frame header");
+    BatchResult result;
+    result.sequence = cursor.readLE<int64_t>();
+    result.nextSequence = cursor.readLE<int64_t>();
+    result.complete = cursor.read<uint8_t>() != 0;
+    const bool error = cursor.read<uint8_t>() != 0;
+    const auto payloadBytes = cursor.readLE<int64_t>();
+    VELOX_CHECK(
+        payloadBytes >= 0 && cursor.canAdvance(payloadBytes),
+        "Truncated batched results frame payload");
+    if (error) {
+      result.error = cursor.readFixedString(payloadBytes);
+    } else if (payloadBytes > 0) {
+      cursor.clone(result.data, payloadBytes);
+    }
+    results.push_back(std::move(result));
+  }
+  return results;
+}
+
+} // namespace facebook::presto
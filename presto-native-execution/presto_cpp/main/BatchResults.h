@@ -0,0 +1,64 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <folly/Try.h>
+#include <folly/io/IOBuf.h>
+
+#include "presto_cpp/main/PrestoTask.h"
+
+namespace facebook::presto {
+
+/// The path of the batched results endpoint which reads the results of
+/// several output buffers, possibly of different tasks, in one request.
+constexpr std::string_view kBatchResultsPath{"/v1/task/batch-results"};
+
+/// The output buffer and token to read by one entry of a batched results
+/// request.
+struct ResultLocation {
+  protocol::TaskId taskId;
+  long bufferId;
+  long token;
+};
+
+/// The results read for one ResultLocation of a batched results request.
+struct BatchResult {
+  int64_t sequence{0};
+  int64_t nextSequence{0};
+  bool complete{false};
+  /// Set if the results of this location could not be read.
+  std::string error;
+  /// The serialized pages. Null if there are no pages.
+  std::unique_ptr<folly::IOBuf> data;
+};
+
+/// Serializes 'locations' into the json body of a batched results request.
+std::string serializeResultLocations(
+    const std::vector<ResultLocation>& locations);
+
+std::vector<ResultLocation> parseResultLocations(const std::string& body);
+
+/// Frames 'results' into the body of a batched results response, one frame
+/// per requested location in the request order. A frame consists of the int64
+/// sequence, int64 next sequence, int8 complete flag, int8 error flag and
+/// int64 payload size followed by the payload which is either the serialized
+/// pages or the error message. The pages are chained without copy.
+std::unique_ptr<folly::IOBuf> serializeBatchResults(
+    std::vector<folly::Try<std::unique_ptr<Result>>>& results);
+
+/// Parses the frames of a batched results response 'body'. The returned pages
+/// share the memory of 'body' which must hence own its buffers.
+std::vector<BatchResult> parseBatchResults(std::unique_ptr<folly::IOBuf> body);
+
+} // namespace facebook::presto
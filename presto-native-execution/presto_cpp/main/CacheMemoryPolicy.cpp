@@ -0,0 +1,70 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "presto_cpp/main/CacheMemoryPolicy.h"
+#include <algorithm>
+#include "velox/common/base/Exceptions.h"
+#include "velox/common/caching/AsyncDataCache.h"
+
+namespace facebook::presto {
+
+CacheMemoryPolicy::CacheMemoryPolicy(
+    int64_t capacityBytes,
+    int64_t floorBytes,
+    int64_t ceilingBytes)
+    : capacityBytes_(capacityBytes),
+      floorBytes_(floorBytes),
+      ceilingBytes_(std::min(ceilingBytes, capacityBytes)),
+      targetBytes_(ceilingBytes_) {
+  VELOX_CHECK_GE(floorBytes_, 0);
+  VELOX_CHECK_LE(
+      floorBytes_,
+      ceilingBytes_,
+      "The cache floor must not exceed its ceiling or the node memory");
+}
+
+int64_t CacheMemoryPolicy::update(int64_t queryBytes) {
+  const int64_t growthBytes =
+      std::max<int64_t>(0, queryBytes - lastQueryBytes_);
+  lastQueryBytes_ = queryBytes;
+  const int64_t demandBytes = queryBytes + growthBytes;
+  targetBytes_ =
+      std::clamp(capacityBytes_ - demandBytes, floorBytes_, ceilingBytes_);
+  return targetBytes_;
+}
+
+namespace {
+int64_t cachedBytes(velox::cache::AsyncDataCache& cache) {
+  const auto stats = cache.refreshStats();
+  return stats.tinySize + stats.largeSize;
+}
+} // namespace
+
+int64_t shrinkAsyncDataCache(
+    velox::cache::AsyncDataCache& cache,
+    int64_t targetBytes) {
+  const int64_t startBytes = cachedBytes(cache);
+  if (startBytes <= targetBytes) {
+    return 0;
+  }
+  // The cache evicts between the calls of the callback until it returns true
+  // or nothing evictable is left.
+  constexpr int64_t kPageSize = velox::memory::AllocationTraits::kPageSize;
+  const auto numPages = (startBytes - targetBytes + kPageSize - 1) / kPageSize;
+  cache.makeSpace(
+      numPages, [&]() { return cachedBytes(cache) <= targetBytes; });
+  return startBytes - cachedBytes(cache);
+}
+
+} // namespace facebook::presto
@@ -0,0 +1,62 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstdint>
+
+namespace facebook::velox::cache {
+class AsyncDataCache;
+}
+
+namespace facebook::presto {
+
+/// Decides how much memory the AsyncDataCache may keep when it shares the
+/// node memory with the queries. The cache evicts on its own only when an
+/// allocation does not fit, so a query whose usage grows pays for the
+/// eviction. The policy makes room ahead of the queries instead: it
+/// extrapolates their usage one period ahead from its growth since the last
+/// update and grants the cache what is left, between a floor and a ceiling.
+class CacheMemoryPolicy {
+ public:
+  /// 'capacityBytes' is the memory shared by the cache and the queries. The
+  /// cache is granted at least 'floorBytes' and at most 'ceilingBytes'
+  /// whatever the queries use.
+  CacheMemoryPolicy(
+      int64_t capacityBytes,
+      int64_t floorBytes,
+      int64_t ceilingBytes);
+
+  /// Updates the query demand with 'queryBytes', the current usage of all the
+  /// queries, and returns the bytes the cache may hold.
+  int64_t update(int64_t queryBytes);
+
+  int64_t targetBytes() const {
+    return targetBytes_;
+  }
+
+ private:
+  const int64_t capacityBytes_;
+  const int64_t floorBytes_;
+  const int64_t ceilingBytes_;
+  int64_t lastQueryBytes_{0};
+  int64_t targetBytes_;
+};
+
+/// Evicts the unpinned entries of 'cache' in LRU order until it holds at most
+/// 'targetBytes' or only pinned entries are left. Returns the bytes dropped.
+int64_t shrinkAsyncDataCache(
+    velox::cache::AsyncDataCache& cache,
+    int64_t targetBytes);
+
+} // namespace facebook::presto
@@ -0,0 +1,246 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/CacheWarmer.h"
+#include <fmt/format.h>
+#include <folly/executors/thread_factory/NamedThreadFactory.h>
+#include "presto_cpp/external/json/json.hpp"
+#include "velox/common/caching/FileIds.h"
+#include "velox/common/file/FileSystems.h"
+
+namespace facebook::presto {
+
+using namespace facebook::velox;
+
+std::string CacheWarmer::LoadStats::toString() const {
+  return fmt::format(
+      "loaded {} ranges, {} cached already, {} failed, {} bytes",
+      numLoaded,
+      numCached,
+      numFailed,
+      bytes);
+}
+
+CacheWarmer::CacheWarmer(
+    cache::AsyncDataCache* cache,
+    int32_t numThreads,
+    uint64_t maxPinnedBytes)
+    : cache_(cache),
+      maxPinnedBytes_(maxPinnedBytes),
+      executor_(std::make_unique<folly::IOThreadPoolExecutor>(
+          numThreads,
+          std::make_shared<folly::NamedThreadFactory>("CacheWarmer"))) {
+  VELOX_CHECK_NOT_NULL(cache_);
+}
+
+CacheWarmer::~CacheWarmer() {
+  executor_->join();
+  pinned_.wlock()->clear();
+}
+
+// static
+std::vector<CacheRange> CacheWarmer::parseRanges(const std::string& body) {
+  std::vector<CacheRange> ranges;
+  const auto request = nlohmann::json::parse(body);
+  VELOX_USER_CHECK(
+      request.contains("files") && request["files"].is_array(),
+      "The cache operation body must have an array of 'files'");
+  for (const auto& file : request["files"]) {
+    VELOX_USER_CHECK(file.contains("path"), "A file has no 'path'");
+    const auto path = file["path"].get<std::string>();
+    if (!file.contains("ranges")) {
+      ranges.push_back({path, 0, 0});
+      continue;
+    }
+    for (const auto& range : file["ranges"]) {
+      const auto length = range.at("length").get<uint64_t>();
+      VELOX_USER_CHECK_GT(length, 0, "Empty range of '{}'", path);
+      ranges.push_back({path, range.at("offset").get<uint64_t>(), length});
+    }
+  }
+  return ranges;
+}
+
+folly::SemiFuture<CacheWarmer::LoadStats> CacheWarmer::prefetch(
+    std::vector<CacheRange> ranges) {
+  return folly::via(
+             executor_.get(),
+             [this, ranges = std::move(ranges)]() {
+               auto stats = load(ranges, nullptr);
+               LOG(INFO) << "Prefetched " << stats.toString();
+               return stats;
+             })
+      .semi();
+}
+
+folly::SemiFuture<CacheWarmer::LoadStats> CacheWarmer::pin(
+    const std::string& name,
+    std::vector<CacheRange> ranges) {
+  VELOX_USER_CHECK(!name.empty(), "The pinned ranges must have a name");
+  const auto loadId = nextLoadId_++;
+  PinnedSet loading;
+  loading.loadId = loadId;
+  VELOX_USER_CHECK(
+      pinned_.wlock()->emplace(name, std::move(loading)).second,
+      "'{}' is pinned already",
+      name);
+  return folly::via(
+             executor_.get(),
+             [this, name, loadId, ranges = std::move(ranges)]() {
+               PinnedSet loaded;
+               auto stats = load(ranges, &loaded);
+               auto pinned = pinned_.wlock();
+               auto it = pinned->find(name);
+               if (it == pinned->end() || it->second.loadId != loadId) {
+                 // Unpinned while loading, and maybe pinned again since.
+                 pinnedBytes_ -= loaded.bytes;
+                 return stats;
+               }
+               it->second.pins = std::move(loaded.pins);
+               it->second.bytes = loaded.bytes;
+               it->second.loading = false;
+               LOG(INFO) << "Pinned '" << name << "': " << stats.toString();
+               return stats;
+             })
+      .semi();
+}
+
+uint64_t CacheWarmer::unpin(const std::string& name) {
+  PinnedSet unpinned;
+  {
+    // Releases the bytes under the lock the loads publish their pins under,
+    // so that a pin of the same name is accounted after this.
+    auto pinned = pinned_.wlock();
+    auto it = pinned->find(name);
+    VELOX_USER_CHECK(it != pinned->end(), "'{}' is not pinned", name);
+    unpinned = std::move(it->second);
+    pinned->erase(it);
+    pinnedBytes_ -= unpinned.bytes;
+  }
+  // The entries become evictable when the pins go out of scope.
+  return unpinned.bytes;
+}
+
+std::string CacheWarmer::toString() const {
+  std::stringstream out;
+  out << "Pinned " << pinnedBytes_ << " of " << maxPinnedBytes_ << " bytes";
+  auto pinned = pinned_.rlock();
+  for (const auto& [name, set] : *pinned) {
+    out << "\n  " << name << ": " << set.pins.size() << " entries, "
+        << set.bytes << " bytes" << (set.loading ? " (loading)" : "");
+  }
+  return out.str();
+}
+
+CacheWarmer::LoadStats CacheWarmer::load(
+    const std::vector<CacheRange>& ranges,
+    PinnedSet* pinned) {
+  LoadStats stats;
+  std::string path;
+  std::unique_ptr<ReadFile> file;
+  uint64_t fileId{0};
+  for (const auto& range : ranges) {
+    try {
+      if (file == nullptr || range.path != path) {
+        path = range.path;
+        file = filesystems::getFileSystem(path, nullptr)
+                   ->openFileForRead(path);
+        fileId = fileNum(path);
+      }
+      const uint64_t end =
+          range.length == 0 ? file->size() : range.offset + range.length;
+      VELOX_USER_CHECK_LE(end, file->size(), "Range past the end of {}", path);
+      VELOX_USER_CHECK_LT(range.offset, end, "Empty range of {}", path);
+      // One entry keyed by the offset of the range, as the readers key their
+      // regions. Splitting the range would make entries no reader looks up.
+      const CacheRange entryRange{path, range.offset, end - range.offset};
+      auto pin =
+          loadRange(entryRange, *file, fileId, pinned == nullptr, stats);
+      if (pinned == nullptr || pin.empty()) {
+        continue;
+      }
+      if (pinnedBytes_.fetch_add(entryRange.length) + entryRange.length >
+          maxPinnedBytes_) {
+        pinnedBytes_ -= entryRange.length;
+        continue;
+      }
+      pinned->bytes += entryRange.length;
+      pinned->pins.push_back(std::move(pin));
+    } catch (const std::exception& e) {
+      LOG(WARNING) << "Failed to load " << range.path << " at "
+                   << range.offset << ": " << e.what();
+      ++stats.numFailed;
+      file.reset();
+    }
+  }
+  return stats;
+}
+
+cache::CachePin CacheWarmer::loadRange(
+    const CacheRange& range,
+    const ReadFile& file,
+    uint64_t fileNum,
+    bool prefetch,
+    LoadStats& stats) {
+  const cache::RawFileCacheKey key{fileNum, range.offset};
+  for (;;) {
+    folly::SemiFuture<bool> wait(false);
+    auto pin = cache_->findOrCreate(key, range.length, &wait);
+    if (pin.empty()) {
+      // Another thread is loading the entry.
+      if (prefetch) {
+        ++stats.numCached;
+        return pin;
+      }
+      std::move(wait).wait();
+      continue;
+    }
+    auto* entry = pin.checkedEntry();
+    if (!entry->isExclusive()) {
+      ++stats.numCached;
+      return pin;
+    }
+    // Reads straight into the memory of the entry, like the cache input
+    // streams of the readers.
+    std::vector<folly::Range<char*>> buffers;
+    if (entry->tinyData() != nullptr) {
+      buffers.emplace_back(entry->tinyData(), range.length);
+    } else {
+      auto& allocation = entry->data();
+      uint64_t remaining = range.length;
+      for (auto i = 0; i < allocation.numRuns() && remaining > 0; ++i) {
+        auto run = allocation.runAt(i);
+        const auto bytes = std::min<uint64_t>(run.numBytes(), remaining);
+        buffers.emplace_back(run.data<char>(), bytes);
+        remaining -= bytes;
+      }
+    }
+    file.preadv(range.offset, buffers);
+    entry->setPrefetch(prefetch);
+    entry->setExclusiveToShared();
+    ++stats.numLoaded;
+    stats.bytes += range.length;
+    return pin;
+  }
+}
+
+uint64_t CacheWarmer::fileNum(const std::string& path) {
+  auto ids = fileIds_.wlock();
+  auto it = ids->find(path);
+  if (it == ids->end()) {
+    it = ids->emplace(path, StringIdLease(fileIds(), path)).first;
+  }
+  return it->second.id();
+}
+
+} // namespace facebook::presto
@@ -0,0 +1,125 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <folly/Synchronized.h>
+#include <folly/executors/IOThreadPoolExecutor.h>
+#include <folly/futures/Future.h>
+
+#include "velox/common/caching/AsyncDataCache.h"
+#include "velox/common/caching/StringIdMap.h"
+#include "velox/common/file/File.h"
+
+namespace facebook::presto {
+
+/// A byte range of a file to load into one cache entry. The cache entries are
+/// keyed by the file and the offset, so a range is found by the readers only
+/// if it is one of their regions, e.g. a column stream of a row group.
+struct CacheRange {
+  std::string path;
+  uint64_t offset{0};
+  /// 0 for the rest of the file.
+  uint64_t length{0};
+};
+
+/// Warms up the AsyncDataCache (and through it the SsdCache) ahead of the
+/// queries. Prefetched ranges are cached like the ranges the queries read and
+/// may be evicted. Pinned ranges are held in the cache under a name until
+/// unpinned, so that the hot tables survive the eviction.
+class CacheWarmer {
+ public:
+  /// The outcome of a prefetch or pin.
+  struct LoadStats {
+    int64_t numLoaded{0};
+    int64_t numCached{0};
+    int64_t numFailed{0};
+    int64_t bytes{0};
+
+    std::string toString() const;
+  };
+
+  /// Loads on 'numThreads' threads and pins up to 'maxPinnedBytes' in total.
+  CacheWarmer(
+      velox::cache::AsyncDataCache* cache,
+      int32_t numThreads,
+      uint64_t maxPinnedBytes);
+
+  ~CacheWarmer();
+
+  /// Parses the ranges of the JSON body of a prefetch or pin operation, e.g.
+  /// {"files": [{"path": "/a", "ranges": [{"offset": 0, "length": 100}]},
+  /// {"path": "/b"}]}. A file without ranges is loaded whole.
+  static std::vector<CacheRange> parseRanges(const std::string& body);
+
+  /// Loads 'ranges' into the cache in the background.
+  folly::SemiFuture<LoadStats> prefetch(std::vector<CacheRange> ranges);
+
+  /// Loads 'ranges' into the cache in the background and pins them under
+  /// 'name'. Throws if 'name' is pinned already. The ranges past
+  /// 'maxPinnedBytes' are prefetched but not pinned.
+  folly::SemiFuture<LoadStats> pin(
+      const std::string& name,
+      std::vector<CacheRange> ranges);
+
+  /// Releases the ranges pinned under 'name'. Returns the bytes released.
+  uint64_t unpin(const std::string& name);
+
+  uint64_t pinnedBytes() const {
+    return pinnedBytes_;
+  }
+
+  /// Returns the pinned names with their entries and bytes.
+  std::string toString() const;
+
+ private:
+  struct PinnedSet {
+    std::vector<velox::cache::CachePin> pins;
+    uint64_t bytes{0};
+    // True while the ranges are being loaded.
+    bool loading{true};
+    // Tells the load of this set from the load of a set pinned under the same
+    // name after an unpin.
+    uint64_t loadId{0};
+  };
+
+  // Loads 'ranges' and returns the pins of the cached ones if 'pinned' is not
+  // null.
+  LoadStats load(
+      const std::vector<CacheRange>& ranges,
+      PinnedSet* pinned);
+
+  // Returns the pin of 'range', reading it from the file if not cached.
+  velox::cache::CachePin loadRange(
+      const CacheRange& range,
+      const velox::ReadFile& file,
+      uint64_t fileNum,
+      bool prefetch,
+      LoadStats& stats);
+
+  // Returns the id the cache knows 'path' by. The ids are kept for the
+  // lifetime of the warmer so that the readers get the same ids.
+  uint64_t fileNum(const std::string& path);
+
+  velox::cache::AsyncDataCache* const cache_;
+  const uint64_t maxPinnedBytes_;
+  std::unique_ptr<folly::IOThreadPoolExecutor> executor_;
+
+  folly::Synchronized<std::unordered_map<std::string, velox::StringIdLease>>
+      fileIds_;
+  folly::Synchronized<std::unordered_map<std::string, PinnedSet>> pinned_;
+  std::atomic<uint64_t> pinnedBytes_{0};
+  std::atomic<uint64_t> nextLoadId_{1};
+};
+
+} // namespace facebook::presto
@@ -0,0 +1,105 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/CompressedPagesCache.h"
+#include <folly/hash/Hash.h>
+#include "presto_cpp/main/common/Counters.h"
+#include "velox/common/base/StatsReporter.h"
+
+namespace facebook::presto {
+namespace {
+// Returns the hash of the addresses and sizes of the buffers of 'pages'.
+uint64_t hashPages(
+    const folly::IOBuf& pages,
+    velox::common::CompressionKind codec) {
+  uint64_t hash = folly::hash::hash_combine(static_cast<int>(codec));
+  for (const auto& range : pages) {
+    hash = folly::hash::hash_combine(
+        hash, reinterpret_cast<uintptr_t>(range.data()), range.size());
+  }
+  return hash;
+}
+
+// Returns true if 'left' and 'right' share the same memory.
+bool samePages(const folly::IOBuf& left, const folly::IOBuf& right) {
+  auto leftIt = left.begin();
+  auto rightIt = right.begin();
+  for (; leftIt != left.end() && rightIt != right.end(); ++leftIt, ++rightIt) {
+    if (leftIt->data() != rightIt->data() ||
+        leftIt->size() != rightIt->size()) {
+      return false;
+    }
+  }
+  return leftIt == left.end() && rightIt == right.end();
+}
+
+std::unique_ptr<folly::IOBuf> cloneOrNull(
+    const std::unique_ptr<folly::IOBuf>& iobuf) {
+  return iobuf == nullptr ? nullptr : iobuf->clone();
+}
+} // namespace
+
+std::unique_ptr<folly::IOBuf> CompressedPagesCache::getOrCompress(
+    const std::string& taskId,
+    const folly::IOBuf& pages,
+    velox::common::CompressionKind codec,
+    const std::function<std::unique_ptr<folly::IOBuf>()>& compress) {
+  if (cache_.maxBytes() == 0) {
+    return compress();
+  }
+  const uint64_t hash = hashPages(pages, codec);
+  {
+    std::lock_guard<std::mutex> l(mutex_);
+    auto* entry = cache_.get(hash);
+    if (entry != nullptr && entry->codec == codec &&
+        samePages(*entry->pages, pages)) {
+      REPORT_ADD_STAT_VALUE(kCounterNumCompressedPagesCacheHits);
+      return cloneOrNull(entry->compressed);
+    }
+    if (seen_.count(hash) == 0) {
+      if (seen_.size() >= kMaxSeenResponses) {
+        seen_.clear();
+      }
+      seen_.insert(hash);
+      return compress();
+    }
+  }
+
+  // Compresses outside of the lock. The concurrent misses for the same pages
+  // all compress them.
+  REPORT_ADD_STAT_VALUE(kCounterNumCompressedPagesCacheMisses);
+  auto compressed = compress();
+  const uint64_t bytes = pages.computeChainDataLength() +
+      (compressed == nullptr ? 0 : compressed->computeChainDataLength());
+  if (bytes > cache_.maxBytes()) {
+    return compressed;
+  }
+
+  // Replaces the pages compressed concurrently or different pages with the
+  // same hash.
+  std::lock_guard<std::mutex> l(mutex_);
+  cache_.put(
+      hash,
+      Entry{taskId, pages.clone(), codec, cloneOrNull(compressed)},
+      bytes);
+  return compressed;
+}
+
+void CompressedPagesCache::removeTask(const std::string& taskId) {
+  std::lock_guard<std::mutex> l(mutex_);
+  cache_.eraseIf([&](uint64_t /*hash*/, const Entry& entry) {
+    return entry.taskId == taskId;
+  });
+}
+
+} // namespace facebook::presto
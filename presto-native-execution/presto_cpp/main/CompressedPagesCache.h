@@ -0,0 +1,87 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <folly/io/IOBuf.h>
+#include <functional>
+#include <mutex>
+#include <unordered_set>
+
+#include "presto_cpp/main/common/ByteLruCache.h"
+#include "velox/common/compression/Compression.h"
+
+namespace facebook::presto {
+
+/// A bounded LRU cache of the compressed data responses of the output
+/// buffers whose pages are sent to several consumers, e.g. the broadcast
+/// buffers. Their responses to all the consumers share the memory of the same
+/// pages, so the pages are compressed once and the consumers are sent clones
+/// of the same compressed copy. A response is only cached once the same pages
+/// are compressed a second time, so that the pages of the partitioned buffers,
+/// which are sent once, are not held by the cache.
+class CompressedPagesCache {
+ public:
+  /// The max number of the responses compressed once remembered to detect the
+  /// ones compressed again.
+  static constexpr size_t kMaxSeenResponses = 4'096;
+
+  /// Caches up to 'maxBytes' of responses, counting both the uncompressed
+  /// pages held by the cache and their compressed copies. Caches nothing if
+  /// 'maxBytes' is 0.
+  explicit CompressedPagesCache(uint64_t maxBytes) : cache_(maxBytes) {}
+
+  /// Returns 'pages' compressed with 'codec' or null if they are not worth
+  /// compressing. On a miss, calls 'compress' which returns the same. The
+  /// pages are the output of the task 'taskId'.
+  std::unique_ptr<folly::IOBuf> getOrCompress(
+      const std::string& taskId,
+      const folly::IOBuf& pages,
+      velox::common::CompressionKind codec,
+      const std::function<std::unique_ptr<folly::IOBuf>()>& compress);
+
+  /// Removes the responses of the task 'taskId', so that the memory of its
+  /// pages is released with the task.
+  void removeTask(const std::string& taskId);
+
+  size_t size() const {
+    std::lock_guard<std::mutex> l(mutex_);
+    return cache_.size();
+  }
+
+  uint64_t bytes() const {
+    std::lock_guard<std::mutex> l(mutex_);
+    return cache_.bytes();
+  }
+
+ private:
+  struct Entry {
+    std::string taskId;
+    // A clone of the pages to tell apart the responses with the same hash.
+    // Also keeps the memory of the pages from being reused for other pages
+    // while cached.
+    std::unique_ptr<folly::IOBuf> pages;
+    velox::common::CompressionKind codec;
+    // Null if the pages are not worth compressing.
+    std::unique_ptr<folly::IOBuf> compressed;
+  };
+
+  mutable std::mutex mutex_;
+  // The cached responses keyed by the hashes of the addresses and sizes of
+  // their pages.
+  ByteLruCache<uint64_t, Entry> cache_;
+  // The hashes of the responses compressed once.
+  std::unordered_set<uint64_t> seen_;
+};
+
+} // namespace facebook::presto
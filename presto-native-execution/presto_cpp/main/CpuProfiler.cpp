@@ -0,0 +1,222 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/CpuProfiler.h"
+#include <dlfcn.h>
+#include <folly/Demangle.h>
+#include <folly/ScopeGuard.h>
+#include <folly/executors/CPUThreadPoolExecutor.h>
+#include <folly/executors/thread_factory/NamedThreadFactory.h>
+#include <folly/memory/Malloc.h>
+#include <glog/logging.h>
+#include <signal.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <thread>
+#include <unordered_map>
+#include "velox/common/base/Exceptions.h"
+#include "velox/common/time/Timer.h"
+
+#ifdef PRESTO_ENABLE_LIBUNWIND
+#define UNW_LOCAL_ONLY
+#include <libunwind.h>
+#endif
+
+namespace facebook::presto {
+namespace {
+std::string symbolize(
+    void* address,
+    std::unordered_map<void*, std::string>& symbols) {
+  auto it = symbols.find(address);
+  if (it != symbols.end()) {
+    return it->second;
+  }
+  Dl_info info;
+  std::string symbol;
+  if (dladdr(address, &info) != 0 && info.dli_sname != nullptr) {
+    symbol = folly::demangle(info.dli_sname).toStdString();
+  } else {
+    symbol = fmt::format("{}", address);
+  }
+  symbols.emplace(address, symbol);
+  return symbol;
+}
+
+#ifdef PRESTO_ENABLE_LIBUNWIND
+// The frames of the signal handler and the signal trampoline.
+constexpr int32_t kHandlerFrames{2};
+
+struct Sample {
+  int32_t depth;
+  void* frames[CpuProfiler::kMaxDepth + kHandlerFrames];
+};
+
+std::atomic_bool running{false};
+// Allocated for the duration of a profile since the signal handler may not
+// allocate.
+Sample* samples{nullptr};
+std::atomic<size_t> numSamples{0};
+
+// Unwinds with libunwind as backtrace() is not async-signal-safe: its first
+// call may dlopen the unwinder of libgcc and the unwinder takes locks, so a
+// sample could deadlock the interrupted thread inside malloc or the loader.
+void onProfilingSignal(int /*signal*/) {
+  const auto index = numSamples.fetch_add(1, std::memory_order_relaxed);
+  if (index < CpuProfiler::kMaxSamples) {
+    auto& sample = samples[index];
+    sample.depth =
+        unw_backtrace(sample.frames, CpuProfiler::kMaxDepth + kHandlerFrames);
+  }
+}
+
+// Unwinds once at startup so that the unwinder is loaded and sets up its state
+// outside of the signal handlers.
+[[maybe_unused]] const bool kUnwinderLoaded = []() {
+  void* frames[1];
+  unw_backtrace(frames, 1);
+  return true;
+}();
+
+void setTimer(int32_t frequencyHz) {
+  itimerval timer{};
+  if (frequencyHz > 0) {
+    timer.it_interval.tv_usec = 1'000'000 / frequencyHz;
+    timer.it_value = timer.it_interval;
+  }
+  VELOX_CHECK_EQ(setitimer(ITIMER_PROF, &timer, nullptr), 0);
+}
+#endif
+} // namespace
+
+// static
+std::string CpuProfiler::profile(
+    std::chrono::milliseconds duration,
+    int32_t frequencyHz) {
+  VELOX_USER_CHECK(
+      frequencyHz > 0 && frequencyHz <= 1'000,
+      "Profiling frequency must be between 1 and 1000 Hz: {}",
+      frequencyHz);
+#ifndef PRESTO_ENABLE_LIBUNWIND
+  VELOX_USER_FAIL("CPU profiling needs the server to be built with libunwind");
+#else
+  VELOX_USER_CHECK(!running.exchange(true), "Another CPU profile is running");
+  SCOPE_EXIT {
+    running = false;
+  };
+  std::vector<Sample> buffer(kMaxSamples);
+  samples = buffer.data();
+  numSamples = 0;
+
+  struct sigaction action {};
+  struct sigaction oldAction {};
+  action.sa_handler = onProfilingSignal;
+  action.sa_flags = SA_RESTART;
+  sigemptyset(&action.sa_mask);
+  VELOX_CHECK_EQ(sigaction(SIGPROF, &action, &oldAction), 0);
+  setTimer(frequencyHz);
+  std::this_thread::sleep_for(duration);
+  setTimer(0);
+  // A signal raised before the timer stopped may still be handled.
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  sigaction(SIGPROF, &oldAction, nullptr);
+
+  const auto totalSamples = numSamples.load();
+  const auto kept = std::min(totalSamples, kMaxSamples);
+  std::unordered_map<void*, std::string> symbols;
+  std::vector<std::vector<std::string>> stacks;
+  stacks.reserve(kept);
+  for (size_t i = 0; i < kept; ++i) {
+    const auto& sample = buffer[i];
+    auto& stack = stacks.emplace_back();
+    for (int32_t frame = kHandlerFrames; frame < sample.depth; ++frame) {
+      stack.push_back(symbolize(sample.frames[frame], symbols));
+    }
+  }
+  samples = nullptr;
+  if (totalSamples > kept) {
+    LOG(WARNING) << "CPU profile dropped " << totalSamples - kept
+                 << " of its " << totalSamples << " samples";
+  }
+  return fold(stacks);
+#endif
+}
+
+// static
+folly::Future<std::string> CpuProfiler::profileAsync(
+    std::chrono::milliseconds duration,
+    int32_t frequencyHz) {
+  static folly::CPUThreadPoolExecutor executor(
+      1, std::make_shared<folly::NamedThreadFactory>("Profiler"));
+  return folly::via(&executor, [duration, frequencyHz]() {
+    return profile(duration, frequencyHz);
+  });
+}
+
+// static
+std::string CpuProfiler::fold(
+    const std::vector<std::vector<std::string>>& stacks) {
+  std::map<std::string, uint64_t> counts;
+  for (const auto& stack : stacks) {
+    std::string folded;
+    for (auto it = stack.rbegin(); it != stack.rend(); ++it) {
+      if (!folded.empty()) {
+        folded += ';';
+      }
+      folded += *it;
+    }
+    if (!folded.empty()) {
+      ++counts[folded];
+    }
+  }
+  std::string result;
+  for (const auto& [folded, count] : counts) {
+    result += fmt::format("{} {}\n", folded, count);
+  }
+  return result;
+}
+
+// static
+std::vector<std::string> CpuProfiler::symbolize(
+    void* const* frames,
+    int32_t numFrames) {
+  std::unordered_map<void*, std::string> symbols;
+  std::vector<std::string> stack;
+  stack.reserve(numFrames);
+  for (int32_t frame = 0; frame < numFrames; ++frame) {
+    stack.push_back(presto::symbolize(frames[frame], symbols));
+  }
+  return stack;
+}
+
+// static
+std::string CpuProfiler::dumpHeapProfile(const std::string& directory) {
+  VELOX_USER_CHECK(
+      folly::usingJEMalloc(), "Heap profiling needs the jemalloc allocator");
+  const auto path = fmt::format(
+      "{}/presto_heap_{}_{}.prof",
+      directory,
+      getpid(),
+      velox::getCurrentTimeMs());
+  const char* pathPtr = path.c_str();
+  VELOX_USER_CHECK_EQ(
+      mallctl("prof.dump", nullptr, nullptr, &pathPtr, sizeof(pathPtr)),
+      0,
+      "Heap profiling is not active, start the server with "
+      "MALLOC_CONF=prof:true");
+  return path;
+}
+
+} // namespace facebook::presto
@@ -0,0 +1,62 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <folly/futures/Future.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace facebook::presto {
+
+/// Profiles the CPU usage of the process in place, without external tools.
+/// A SIGPROF timer samples the call stack of the thread being charged CPU
+/// time while the profile runs. The stacks are symbolized after the profile
+/// and returned in the folded format of flamegraph.pl: one line per distinct
+/// stack with its frames from the outermost, separated by ';', followed by the
+/// number of samples. Only one profile runs at a time.
+class CpuProfiler {
+ public:
+  static constexpr int32_t kMaxDepth{48};
+  /// The samples beyond this many are dropped.
+  static constexpr size_t kMaxSamples{1 << 16};
+
+  /// Profiles for 'duration', taking 'frequencyHz' samples per CPU second.
+  /// Blocks for 'duration'. Throws if a profile is running or if the server is
+  /// built without libunwind, which samples the stacks.
+  static std::string profile(
+      std::chrono::milliseconds duration,
+      int32_t frequencyHz);
+
+  /// Runs profile() on a thread of the profiler.
+  static folly::Future<std::string> profileAsync(
+      std::chrono::milliseconds duration,
+      int32_t frequencyHz);
+
+  /// Returns the stacks in the folded format. Each stack lists its frames from
+  /// the innermost.
+  static std::string fold(const std::vector<std::vector<std::string>>& stacks);
+
+  /// Returns the symbols of the first 'numFrames' of 'frames'.
+  static std::vector<std::string> symbolize(
+      void* const* frames,
+      int32_t numFrames);
+
+  /// Writes a heap profile of jemalloc into 'directory' and returns its path.
+  /// Throws if the process does not run with jemalloc heap profiling active,
+  /// e.g. MALLOC_CONF=prof:true.
+  static std::string dumpHeapProfile(const std::string& directory);
+};
+
+} // namespace facebook::presto
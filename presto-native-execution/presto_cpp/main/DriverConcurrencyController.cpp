@@ -0,0 +1,37 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/DriverConcurrencyController.h"
+#include <algorithm>
+#include "velox/common/base/Exceptions.h"
+
+namespace facebook::presto {
+
+DriverConcurrencyController::DriverConcurrencyController(
+    int32_t minDrivers,
+    int32_t maxDrivers)
+    : minDrivers_(minDrivers), maxDrivers_(maxDrivers), drivers_(maxDrivers) {
+  VELOX_CHECK_GT(minDrivers_, 0);
+  VELOX_CHECK_LE(minDrivers_, maxDrivers_);
+}
+
+int32_t DriverConcurrencyController::update(double cpuLoadPct) {
+  if (cpuLoadPct > kHighCPULoadPct) {
+    drivers_ = std::max(minDrivers_, drivers_ - std::max(1, drivers_ / 4));
+  } else if (cpuLoadPct < kLowCPULoadPct) {
+    drivers_ = std::min(maxDrivers_, drivers_ + 1);
+  }
+  return drivers_;
+}
+
+} // namespace facebook::presto
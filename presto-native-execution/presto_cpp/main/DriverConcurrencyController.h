@@ -0,0 +1,47 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstdint>
+
+namespace facebook::presto {
+
+/// Adapts the number of drivers of the new tasks to the CPU load of the node.
+/// When the CPUs are saturated, more drivers only add context switches, so
+/// the driver count is cut by a quarter on each update above
+/// 'kHighCPULoadPct'. It grows back by one driver on each update below
+/// 'kLowCPULoadPct', and holds in between.
+class DriverConcurrencyController {
+ public:
+  static constexpr double kHighCPULoadPct{90};
+  static constexpr double kLowCPULoadPct{60};
+
+  /// The driver count stays between 'minDrivers' and 'maxDrivers' and starts
+  /// at 'maxDrivers'.
+  DriverConcurrencyController(int32_t minDrivers, int32_t maxDrivers);
+
+  /// Updates the driver count with the CPU load and returns it.
+  int32_t update(double cpuLoadPct);
+
+  int32_t drivers() const {
+    return drivers_;
+  }
+
+ private:
+  const int32_t minDrivers_;
+  const int32_t maxDrivers_;
+  int32_t drivers_;
+};
+
+} // namespace facebook::presto
@@ -0,0 +1,238 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/DriverWatchdog.h"
+#include <folly/ScopeGuard.h>
+#include <signal.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <atomic>
+#include <cerrno>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include "presto_cpp/main/CpuProfiler.h"
+#include "velox/common/base/Exceptions.h"
+#include "velox/common/time/Timer.h"
+
+#ifdef PRESTO_ENABLE_LIBUNWIND
+#define UNW_LOCAL_ONLY
+#include <libunwind.h>
+#endif
+
+namespace facebook::presto {
+namespace {
+// The frames of the signal handler and the signal trampoline.
+constexpr int32_t kHandlerFrames{2};
+
+int32_t currentThreadId() {
+  return syscall(SYS_gettid);
+}
+
+// The driver a thread runs for the wrapped executors.
+struct ThreadSlot {
+  const int32_t threadId{currentThreadId()};
+  std::mutex mutex;
+  // The time the running driver got on the thread, 0 if none runs.
+  uint64_t startMs{0};
+  std::shared_ptr<const std::string> queryId;
+};
+
+struct Registry {
+  std::mutex mutex;
+  std::unordered_set<ThreadSlot*> slots;
+};
+
+Registry& registry() {
+  // Never destroyed since the threads may exit after the static destructors.
+  static auto* registry = new Registry();
+  return *registry;
+}
+
+// Registers the slot of its thread while the thread lives.
+struct ThreadSlotHolder {
+  ThreadSlotHolder() {
+    std::lock_guard<std::mutex> l(registry().mutex);
+    registry().slots.insert(&slot);
+  }
+
+  ~ThreadSlotHolder() {
+    std::lock_guard<std::mutex> l(registry().mutex);
+    registry().slots.erase(&slot);
+  }
+
+  ThreadSlot slot;
+};
+
+ThreadSlot& threadSlot() {
+  thread_local ThreadSlotHolder holder;
+  return holder.slot;
+}
+
+class WatchedExecutor : public folly::Executor {
+ public:
+  WatchedExecutor(
+      folly::Executor* executor,
+      const std::string& queryId,
+      std::shared_ptr<folly::Executor> owner)
+      : executor_(executor),
+        owner_(std::move(owner)),
+        queryId_(std::make_shared<const std::string>(queryId)) {}
+
+  void add(folly::Func func) override {
+    executor_->add([queryId = queryId_, func = std::move(func)]() mutable {
+      auto& slot = threadSlot();
+      {
+        std::lock_guard<std::mutex> l(slot.mutex);
+        slot.startMs = velox::getCurrentTimeMs();
+        slot.queryId = queryId;
+      }
+      SCOPE_EXIT {
+        std::lock_guard<std::mutex> l(slot.mutex);
+        slot.startMs = 0;
+        slot.queryId.reset();
+      };
+      func();
+    });
+  }
+
+ private:
+  folly::Executor* const executor_;
+  const std::shared_ptr<folly::Executor> owner_;
+  const std::shared_ptr<const std::string> queryId_;
+};
+
+struct StackRequest {
+  // The thread to capture, 0 if none.
+  std::atomic<int32_t> threadId{0};
+  std::atomic<int32_t> depth{-1};
+  void* frames[DriverWatchdog::kMaxDepth + kHandlerFrames];
+};
+
+// Not allocated per capture since a late signal may still write into it.
+StackRequest stackRequest;
+std::mutex captureMutex;
+
+int stackSignal() {
+  return SIGRTMIN + 3;
+}
+
+// Unwinds the stack of the calling thread into 'frames'. backtrace() is not
+// async-signal-safe, its first call may dlopen the unwinder of libgcc and the
+// unwinder takes locks, so libunwind unwinds the stacks in the signal handler.
+// No stack is captured without libunwind.
+int32_t unwind(void** frames, int32_t maxFrames) {
+#ifdef PRESTO_ENABLE_LIBUNWIND
+  return unw_backtrace(frames, maxFrames);
+#else
+  return 0;
+#endif
+}
+
+void onStackSignal(int /*signal*/) {
+  const auto savedErrno = errno;
+  if (stackRequest.threadId.load() == currentThreadId()) {
+    stackRequest.depth = unwind(
+        stackRequest.frames, DriverWatchdog::kMaxDepth + kHandlerFrames);
+  }
+  errno = savedErrno;
+}
+
+void installStackHandler() {
+  static std::once_flag once;
+  std::call_once(once, []() {
+    // Loads the unwinder outside of the handler.
+    void* warmup[1];
+    unwind(warmup, 1);
+    struct sigaction action {};
+    action.sa_handler = onStackSignal;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    VELOX_CHECK_EQ(sigaction(stackSignal(), &action, nullptr), 0);
+  });
+}
+} // namespace
+
+std::string DriverWatchdog::StuckDriver::toString() const {
+  auto out = fmt::format(
+      "Driver of query {} on thread {} for {} ms",
+      queryId,
+      threadId,
+      onThreadMs);
+  for (const auto& frame : stack) {
+    out += "\n    ";
+    out += frame;
+  }
+  return out;
+}
+
+// static
+std::shared_ptr<folly::Executor> DriverWatchdog::wrap(
+    folly::Executor* executor,
+    const std::string& queryId,
+    std::shared_ptr<folly::Executor> owner) {
+  return std::make_shared<WatchedExecutor>(
+      executor, queryId, std::move(owner));
+}
+
+// static
+std::vector<DriverWatchdog::StuckDriver> DriverWatchdog::stuckDrivers(
+    std::chrono::milliseconds threshold) {
+  const auto nowMs = velox::getCurrentTimeMs();
+  std::vector<StuckDriver> stuck;
+  std::lock_guard<std::mutex> l(registry().mutex);
+  for (auto* slot : registry().slots) {
+    std::lock_guard<std::mutex> slotLock(slot->mutex);
+    if (slot->startMs != 0 && nowMs >= slot->startMs + threshold.count()) {
+      stuck.push_back(
+          {*slot->queryId,
+           slot->threadId,
+           slot->startMs,
+           nowMs - slot->startMs,
+           {}});
+    }
+  }
+  return stuck;
+}
+
+// static
+std::vector<std::string> DriverWatchdog::captureStack(
+    int32_t threadId,
+    std::chrono::milliseconds timeout) {
+  installStackHandler();
+  std::lock_guard<std::mutex> l(captureMutex);
+  stackRequest.depth = -1;
+  stackRequest.threadId = threadId;
+  SCOPE_EXIT {
+    stackRequest.threadId = 0;
+  };
+  if (syscall(SYS_tgkill, getpid(), threadId, stackSignal()) != 0) {
+    // The thread exited.
+    return {};
+  }
+  const auto deadline = std::chrono::steady_clock::now() + timeout;
+  while (stackRequest.depth < 0) {
+    if (std::chrono::steady_clock::now() >= deadline) {
+      return {};
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  const int32_t depth = stackRequest.depth;
+  if (depth <= kHandlerFrames) {
+    return {};
+  }
+  return CpuProfiler::symbolize(
+      stackRequest.frames + kHandlerFrames, depth - kHandlerFrames);
+}
+
+} // namespace facebook::presto
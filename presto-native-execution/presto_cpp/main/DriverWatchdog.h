@@ -0,0 +1,69 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <folly/Executor.h>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace facebook::presto {
+
+/// Finds the drivers that stay on a thread for too long, e.g. in a
+/// pathological regular expression or a livelocked operator. The executors of
+/// the queries are wrapped to record which query each thread runs a driver of
+/// and since when. The stacks of the stuck threads are captured by signaling
+/// them, which is best effort: a thread that moved on meanwhile reports its
+/// new stack.
+class DriverWatchdog {
+ public:
+  static constexpr int32_t kMaxDepth{48};
+
+  struct StuckDriver {
+    std::string queryId;
+    /// The id of the thread in the OS.
+    int32_t threadId;
+    /// The time the driver got on the thread, which tells apart the runs of
+    /// the drivers on the same thread.
+    uint64_t startMs;
+    uint64_t onThreadMs;
+    /// The frames from the innermost, empty if not captured.
+    std::vector<std::string> stack;
+
+    std::string toString() const;
+  };
+
+  /// Returns an executor that runs the drivers of 'queryId' on 'executor' and
+  /// records them. The executor keeps 'owner' alive, if given, otherwise
+  /// 'executor' must outlive it.
+  static std::shared_ptr<folly::Executor> wrap(
+      folly::Executor* executor,
+      const std::string& queryId,
+      std::shared_ptr<folly::Executor> owner = nullptr);
+
+  /// Returns the drivers of the wrapped executors on their threads for at
+  /// least 'threshold', without their stacks.
+  static std::vector<StuckDriver> stuckDrivers(
+      std::chrono::milliseconds threshold);
+
+  /// Returns the stack of the thread 'threadId' of this process, from the
+  /// innermost frame. Returns no frames if the thread does not answer within
+  /// 'timeout' or if the server is built without libunwind.
+  static std::vector<std::string> captureStack(
+      int32_t threadId,
+      std::chrono::milliseconds timeout = std::chrono::milliseconds(100));
+};
+
+} // namespace facebook::presto
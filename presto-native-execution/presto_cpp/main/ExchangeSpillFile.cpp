@@ -0,0 +1,93 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/ExchangeSpillFile.h"
+#include <fcntl.h>
+#include <fmt/format.h>
+#include <unistd.h>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include "velox/common/base/Exceptions.h"
+
+namespace facebook::presto {
+
+ExchangeSpillFile::ExchangeSpillFile(const std::string& directory) {
+  static std::atomic<int64_t> nextId{0};
+  const auto path =
+      fmt::format("{}/exchange_spill_{}_{}", directory, getpid(), nextId++);
+  fd_ = open(path.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  VELOX_CHECK_GE(
+      fd_,
+      0,
+      "Cannot create exchange spill file {}: {}",
+      path,
+      strerror(errno));
+  unlink(path.c_str());
+}
+
+ExchangeSpillFile::~ExchangeSpillFile() {
+  close(fd_);
+}
+
+void ExchangeSpillFile::write(const folly::IOBuf& page) {
+  int64_t pageBytes{0};
+  for (const auto range : page) {
+    size_t written{0};
+    while (written < range.size()) {
+      const auto result = pwrite(
+          fd_,
+          range.data() + written,
+          range.size() - written,
+          writeOffset_ + pageBytes + written);
+      VELOX_CHECK_GT(
+          result, 0, "Cannot write exchange spill file: {}", strerror(errno));
+      written += result;
+    }
+    pageBytes += range.size();
+  }
+  writeOffset_ += pageBytes;
+  pageBytes_.push_back(pageBytes);
+}
+
+void ExchangeSpillFile::read(uint8_t* data) {
+  VELOX_CHECK(!pageBytes_.empty());
+  const auto pageBytes = pageBytes_.front();
+  int64_t bytesRead{0};
+  while (bytesRead < pageBytes) {
+    const auto result = pread(
+        fd_, data + bytesRead, pageBytes - bytesRead, readOffset_ + bytesRead);
+    VELOX_CHECK_GT(
+        result, 0, "Cannot read exchange spill file: {}", strerror(errno));
+    bytesRead += result;
+  }
+  popPage();
+}
+
+void ExchangeSpillFile::skip() {
+  VELOX_CHECK(!pageBytes_.empty());
+  popPage();
+}
+
+void ExchangeSpillFile::popPage() {
+  readOffset_ += pageBytes_.front();
+  pageBytes_.pop_front();
+  if (pageBytes_.empty()) {
+    // Frees the disk space of the pages read.
+    VELOX_CHECK_EQ(ftruncate(fd_, 0), 0);
+    readOffset_ = 0;
+    writeOffset_ = 0;
+  }
+}
+
+} // namespace facebook::presto
@@ -0,0 +1,65 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <folly/io/IOBuf.h>
+#include <cstdint>
+#include <deque>
+#include <string>
+
+namespace facebook::presto {
+
+/// A queue of serialized pages on local disk, read back in the order they
+/// were written. The file is created in 'directory' and unlinked right away,
+/// so it goes away with its descriptor, also on a crash. Not thread safe.
+class ExchangeSpillFile {
+ public:
+  explicit ExchangeSpillFile(const std::string& directory);
+
+  ~ExchangeSpillFile();
+
+  /// Appends the bytes of 'page'.
+  void write(const folly::IOBuf& page);
+
+  /// Reads the next page into 'data' of nextPageBytes() bytes.
+  void read(uint8_t* data);
+
+  /// Drops the next page without reading it.
+  void skip();
+
+  bool empty() const {
+    return pageBytes_.empty();
+  }
+
+  /// Returns the size of the next page. The file must not be empty.
+  int64_t nextPageBytes() const {
+    return pageBytes_.front();
+  }
+
+  /// Returns the bytes written and not read yet.
+  int64_t bytes() const {
+    return writeOffset_ - readOffset_;
+  }
+
+ private:
+  void popPage();
+
+  int fd_;
+  // The sizes of the pages not read yet, from the next one.
+  std::deque<int64_t> pageBytes_;
+  int64_t writeOffset_{0};
+  int64_t readOffset_{0};
+};
+
+} // namespace facebook::presto
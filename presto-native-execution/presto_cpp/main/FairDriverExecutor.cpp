@@ -0,0 +1,161 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/FairDriverExecutor.h"
+#include <folly/system/ThreadName.h>
+#include <glog/logging.h>
+#include "velox/common/base/Exceptions.h"
+#include "velox/common/time/Timer.h"
+
+namespace facebook::presto {
+
+class FairDriverExecutor::QueryExecutor : public folly::Executor {
+ public:
+  QueryExecutor(FairDriverExecutor* scheduler)
+      : scheduler_(scheduler), query_(std::make_shared<QueryQueue>()) {}
+
+  void add(folly::Func func) override {
+    scheduler_->enqueue(query_, std::move(func));
+  }
+
+ private:
+  FairDriverExecutor* const scheduler_;
+  const std::shared_ptr<QueryQueue> query_;
+};
+
+FairDriverExecutor::FairDriverExecutor(int32_t numThreads) {
+  VELOX_CHECK_GT(numThreads, 0);
+  threads_.reserve(numThreads);
+  for (int32_t i = 0; i < numThreads; ++i) {
+    threads_.emplace_back([this, i]() {
+      folly::setThreadName(fmt::format("FairDriver{}", i));
+      run();
+    });
+  }
+}
+
+FairDriverExecutor::~FairDriverExecutor() {
+  {
+    std::lock_guard<std::mutex> l(mutex_);
+    stopped_ = true;
+  }
+  cv_.notify_all();
+  for (auto& thread : threads_) {
+    thread.join();
+  }
+}
+
+std::shared_ptr<folly::Executor> FairDriverExecutor::createQueryExecutor() {
+  return std::make_shared<QueryExecutor>(this);
+}
+
+// static
+int32_t FairDriverExecutor::level(uint64_t runMicros) {
+  int32_t level = kNumLevels - 1;
+  while (level > 0 && runMicros < kLevelThresholdsMs[level] * 1'000) {
+    --level;
+  }
+  return level;
+}
+
+std::array<FairDriverExecutor::LevelStats, FairDriverExecutor::kNumLevels>
+FairDriverExecutor::levelStats() const {
+  std::lock_guard<std::mutex> l(mutex_);
+  return levelStats_;
+}
+
+void FairDriverExecutor::enqueue(
+    const std::shared_ptr<QueryQueue>& query,
+    folly::Func func) {
+  {
+    std::lock_guard<std::mutex> l(mutex_);
+    query->tasks.push_back({std::move(func), velox::getCurrentTimeMicro()});
+    if (!query->queued) {
+      query->queued = true;
+      pushLocked(query);
+    }
+  }
+  cv_.notify_one();
+}
+
+void FairDriverExecutor::pushLocked(const std::shared_ptr<QueryQueue>& query) {
+  const auto queryLevel = level(query->runMicros);
+  auto& queries = levels_[queryLevel];
+  if (queries.empty()) {
+    // A level that was idle does not get to catch up on the time it did not
+    // use, it starts even with the least used active level.
+    const auto activeLevel = nextLevelLocked();
+    if (activeLevel >= 0) {
+      levelUsage_[queryLevel] =
+          std::max(levelUsage_[queryLevel], levelUsage_[activeLevel]);
+    }
+  }
+  queries.push_back(query);
+}
+
+int32_t FairDriverExecutor::nextLevelLocked() const {
+  int32_t bestLevel = -1;
+  for (int32_t level = 0; level < kNumLevels; ++level) {
+    if (!levels_[level].empty() &&
+        (bestLevel < 0 || levelUsage_[level] < levelUsage_[bestLevel])) {
+      bestLevel = level;
+    }
+  }
+  return bestLevel;
+}
+
+void FairDriverExecutor::run() {
+  std::unique_lock<std::mutex> l(mutex_);
+  for (;;) {
+    int32_t runLevel;
+    cv_.wait(l, [&]() {
+      runLevel = nextLevelLocked();
+      return stopped_ || runLevel >= 0;
+    });
+    if (stopped_) {
+      return;
+    }
+    auto query = std::move(levels_[runLevel].front());
+    levels_[runLevel].pop_front();
+    auto task = std::move(query->tasks.front());
+    query->tasks.pop_front();
+    if (query->tasks.empty()) {
+      query->queued = false;
+    } else {
+      // The other drivers of the query wait for their turn.
+      pushLocked(query);
+    }
+    const auto startMicros = velox::getCurrentTimeMicro();
+    l.unlock();
+
+    try {
+      task.func();
+    } catch (const std::exception& e) {
+      LOG(ERROR) << "Uncaught exception in a driver task: " << e.what();
+    }
+    // Releases what the task holds before taking the lock.
+    task.func = nullptr;
+    const auto runMicros = velox::getCurrentTimeMicro() - startMicros;
+
+    l.lock();
+    query->runMicros += runMicros;
+    auto& stats = levelStats_[runLevel];
+    ++stats.numTasks;
+    stats.queuedMicros += startMicros - task.enqueueMicros;
+    stats.runMicros += runMicros;
+    // The share of a level halves with each level.
+    levelUsage_[runLevel] += static_cast<double>(runMicros) * (1 << runLevel);
+  }
+}
+
+} // namespace facebook::presto
@@ -0,0 +1,106 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <folly/Executor.h>
+#include <array>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace facebook::presto {
+
+/// Runs the drivers of the queries on a fixed set of threads, sharing them
+/// fairly between the queries instead of in FIFO order. Each query gets its
+/// own executor. A query starts at priority level 0 and moves down a level as
+/// its cumulative run time passes each of 'kLevelThresholdsMs', so that short
+/// queries keep a low latency next to the long ones. The threads pick the
+/// level that has used the least of its share of the run time, level 'l'
+/// being entitled to twice the time of level 'l + 1', and within a level take
+/// one driver quantum from each runnable query in turn.
+class FairDriverExecutor {
+ public:
+  static constexpr int32_t kNumLevels{5};
+  static constexpr std::array<uint64_t, kNumLevels> kLevelThresholdsMs{
+      0,
+      1'000,
+      10'000,
+      60'000,
+      300'000};
+
+  /// The time spent by the tasks of a level, waiting in the queue and running.
+  struct LevelStats {
+    uint64_t numTasks{0};
+    uint64_t queuedMicros{0};
+    uint64_t runMicros{0};
+  };
+
+  explicit FairDriverExecutor(int32_t numThreads);
+
+  ~FairDriverExecutor();
+
+  /// Returns a new executor for the drivers of a query. It must not be used
+  /// after this FairDriverExecutor is destroyed.
+  std::shared_ptr<folly::Executor> createQueryExecutor();
+
+  /// Returns the priority level of a query that ran for 'runMicros'.
+  static int32_t level(uint64_t runMicros);
+
+  /// Returns the cumulative stats of the tasks of each level.
+  std::array<LevelStats, kNumLevels> levelStats() const;
+
+  int32_t numThreads() const {
+    return threads_.size();
+  }
+
+ private:
+  struct Task {
+    folly::Func func;
+    uint64_t enqueueMicros;
+  };
+
+  struct QueryQueue {
+    std::deque<Task> tasks;
+    uint64_t runMicros{0};
+    // True while the query is in the queue of its level.
+    bool queued{false};
+  };
+
+  class QueryExecutor;
+
+  void enqueue(const std::shared_ptr<QueryQueue>& query, folly::Func func);
+
+  // Appends 'query' to the runnable queries of its level. 'mutex_' is held.
+  void pushLocked(const std::shared_ptr<QueryQueue>& query);
+
+  // Returns the non-empty level to run a task from next. 'mutex_' is held.
+  int32_t nextLevelLocked() const;
+
+  void run();
+
+  mutable std::mutex mutex_;
+  std::condition_variable cv_;
+  bool stopped_{false};
+  // The runnable queries of each level in round robin order.
+  std::array<std::deque<std::shared_ptr<QueryQueue>>, kNumLevels> levels_;
+  std::array<LevelStats, kNumLevels> levelStats_;
+  // The run time of each level relative to its share.
+  std::array<double, kNumLevels> levelUsage_{};
+  std::vector<std::thread> threads_;
+};
+
+} // namespace facebook::presto
@@ -0,0 +1,260 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/FragmentResultCache.h"
+#include <folly/String.h>
+#include <folly/container/F14Map.h>
+#include <map>
+#include "presto_cpp/main/common/Counters.h"
+#include "presto_cpp/main/types/PrestoToVeloxExpr.h"
+#include "velox/common/base/StatsReporter.h"
+#include "velox/connectors/hive/TableHandle.h"
+
+using namespace facebook::velox;
+
+namespace facebook::presto {
+namespace {
+// Returns true if the expressions of 'node' call a non-deterministic
+// function.
+bool callsNonDeterministicFunction(const core::PlanNode& node) {
+  if (auto filter = dynamic_cast<const core::FilterNode*>(&node)) {
+    return isNonDeterministic(filter->filter());
+  }
+  if (auto project = dynamic_cast<const core::ProjectNode*>(&node)) {
+    const auto& projections = project->projections();
+    return std::any_of(
+        projections.begin(), projections.end(), [](const auto& projection) {
+          return isNonDeterministic(projection);
+        });
+  }
+  if (auto aggregation = dynamic_cast<const core::AggregationNode*>(&node)) {
+    const auto& aggregates = aggregation->aggregates();
+    return std::any_of(
+        aggregates.begin(), aggregates.end(), [](const auto& aggregate) {
+          return isNonDeterministic(aggregate);
+        });
+  }
+  if (auto scan = dynamic_cast<const core::TableScanNode*>(&node)) {
+    auto hiveTable =
+        std::dynamic_pointer_cast<const connector::hive::HiveTableHandle>(
+            scan->tableHandle());
+    return hiveTable != nullptr && hiveTable->remainingFilter() != nullptr &&
+        isNonDeterministic(hiveTable->remainingFilter());
+  }
+  return false;
+}
+
+// Adds the leaves of 'node' to 'scans' by id. Returns false if a leaf is not
+// a table scan or if a node calls a non-deterministic function.
+bool collectLeafScans(
+    const core::PlanNodePtr& node,
+    folly::F14FastMap<core::PlanNodeId, const core::TableScanNode*>& scans) {
+  if (callsNonDeterministicFunction(*node)) {
+    return false;
+  }
+  if (node->sources().empty()) {
+    auto scan = dynamic_cast<const core::TableScanNode*>(node.get());
+    if (scan == nullptr) {
+      return false;
+    }
+    scans.emplace(node->id(), scan);
+    return true;
+  }
+  for (const auto& source : node->sources()) {
+    if (!collectLeafScans(source, scans)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Returns the columns that 'scan' reads, one line per output in name order,
+// or std::nullopt if they are not hive columns. The plan does not print them
+// but they tell which columns and subfields the outputs are.
+std::optional<std::string> scanColumns(const core::TableScanNode& scan) {
+  std::map<std::string, std::string> columns;
+  for (const auto& [name, handle] : scan.assignments()) {
+    auto hiveColumn =
+        std::dynamic_pointer_cast<const connector::hive::HiveColumnHandle>(
+            handle);
+    if (hiveColumn == nullptr) {
+      return std::nullopt;
+    }
+    std::vector<std::string> subfields;
+    for (const auto& subfield : hiveColumn->requiredSubfields()) {
+      subfields.push_back(subfield.toString());
+    }
+    columns[name] = fmt::format(
+        "{} {} {} [{}]",
+        hiveColumn->name(),
+        static_cast<int>(hiveColumn->columnType()),
+        hiveColumn->dataType()->toString(),
+        folly::join(", ", subfields));
+  }
+  std::string result;
+  for (const auto& [name, column] : columns) {
+    result += fmt::format("{} {} {}\n", scan.id(), name, column);
+  }
+  return result;
+}
+
+// Returns a copy of 'node' reading from 'source'.
+core::PlanNodePtr withSource(
+    const core::PartitionedOutputNode& node,
+    core::PlanNodePtr source) {
+  return std::make_shared<core::PartitionedOutputNode>(
+      node.id(),
+      node.keys(),
+      node.numPartitions(),
+      node.isBroadcast(),
+      node.isReplicateNullsAndAny(),
+      node.partitionFunctionSpecPtr(),
+      node.outputType(),
+      std::move(source));
+}
+
+const core::PartitionedOutputNode& outputNode(
+    const core::PlanFragment& planFragment) {
+  auto output = std::dynamic_pointer_cast<const core::PartitionedOutputNode>(
+      planFragment.planNode);
+  VELOX_CHECK_NOT_NULL(
+      output, "The fragment must end with a partitioned output");
+  return *output;
+}
+} // namespace
+
+// static
+std::optional<std::string> FragmentResultCache::makeKey(
+    const core::PlanFragment& planFragment,
+    const std::vector<protocol::TaskSource>& sources,
+    const std::string& resultConfigs) {
+  auto output = std::dynamic_pointer_cast<const core::PartitionedOutputNode>(
+      planFragment.planNode);
+  if (output == nullptr || output->isBroadcast() ||
+      planFragment.executionStrategy == core::ExecutionStrategy::kGrouped) {
+    return std::nullopt;
+  }
+  folly::F14FastMap<core::PlanNodeId, const core::TableScanNode*> scans;
+  if (!collectLeafScans(output, scans)) {
+    return std::nullopt;
+  }
+  std::vector<std::string> columns;
+  columns.reserve(scans.size());
+  for (const auto& [_, scan] : scans) {
+    auto scanColumnsKey = scanColumns(*scan);
+    if (!scanColumnsKey.has_value()) {
+      return std::nullopt;
+    }
+    columns.push_back(std::move(*scanColumnsKey));
+  }
+  std::sort(columns.begin(), columns.end());
+
+  // The splits are ordered so that the same splits make the same key in any
+  // order.
+  std::vector<std::string> splits;
+  for (const auto& source : sources) {
+    if (scans.erase(source.planNodeId) == 0 || !source.noMoreSplits) {
+      return std::nullopt;
+    }
+    for (const auto& split : source.splits) {
+      auto hiveSplit = std::dynamic_pointer_cast<const protocol::HiveSplit>(
+          split.split.connectorSplit);
+      if (hiveSplit == nullptr || hiveSplit->fileSplit.fileModifiedTime == 0) {
+        return std::nullopt;
+      }
+      const auto& fileSplit = hiveSplit->fileSplit;
+      splits.push_back(fmt::format(
+          "{} {} {} {} {}",
+          source.planNodeId,
+          fileSplit.path,
+          fileSplit.start,
+          fileSplit.length,
+          fileSplit.fileModifiedTime));
+    }
+  }
+  // More splits may come for the scans missing from 'sources'.
+  if (!scans.empty()) {
+    return std::nullopt;
+  }
+  std::sort(splits.begin(), splits.end());
+
+  std::string key = fmt::format(
+      "{}\n{} {}\n",
+      output->toString(true, true),
+      output->numPartitions(),
+      output->outputType()->toString());
+  for (const auto& scanColumnsKey : columns) {
+    key += scanColumnsKey;
+  }
+  key += resultConfigs;
+  for (const auto& split : splits) {
+    key += split;
+    key += '\n';
+  }
+  return key;
+}
+
+// static
+core::PlanFragment FragmentResultCache::withCachedResult(
+    const core::PlanFragment& planFragment,
+    std::shared_ptr<const operators::FragmentResultPages> pages) {
+  const auto& output = outputNode(planFragment);
+  const auto& source = output.sources()[0];
+  auto result = planFragment;
+  result.planNode = withSource(
+      output,
+      std::make_shared<operators::FragmentResultValuesNode>(
+          fmt::format("{}.fragmentResult", source->id()),
+          source->outputType(),
+          std::move(pages)));
+  return result;
+}
+
+// static
+core::PlanFragment FragmentResultCache::withResultRecorder(
+    const core::PlanFragment& planFragment,
+    std::shared_ptr<operators::FragmentResultRecorder> recorder) {
+  const auto& output = outputNode(planFragment);
+  const auto& source = output.sources()[0];
+  auto result = planFragment;
+  result.planNode = withSource(
+      output,
+      std::make_shared<operators::FragmentResultRecordNode>(
+          fmt::format("{}.fragmentResult", source->id()),
+          source,
+          std::move(recorder)));
+  return result;
+}
+
+std::shared_ptr<const operators::FragmentResultPages> FragmentResultCache::get(
+    const std::string& key) {
+  std::lock_guard<std::mutex> l(mutex_);
+  auto* pages = cache_.get(key);
+  if (pages == nullptr) {
+    REPORT_ADD_STAT_VALUE(kCounterNumFragmentResultCacheMisses);
+    return nullptr;
+  }
+  REPORT_ADD_STAT_VALUE(kCounterNumFragmentResultCacheHits);
+  return *pages;
+}
+
+void FragmentResultCache::put(
+    const std::string& key,
+    std::shared_ptr<const operators::FragmentResultPages> pages) {
+  const uint64_t bytes = key.size() + pages->bytes;
+  // Replaces the results recorded concurrently by another task.
+  std::lock_guard<std::mutex> l(mutex_);
+  cache_.put(key, std::move(pages), bytes);
+}
+
+} // namespace facebook::presto
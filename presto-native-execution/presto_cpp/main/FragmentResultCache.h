@@ -0,0 +1,94 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <mutex>
+#include <optional>
+
+#include "presto_cpp/main/common/ByteLruCache.h"
+#include "presto_cpp/main/operators/FragmentResult.h"
+#include "presto_cpp/presto_protocol/presto_protocol.h"
+#include "velox/core/PlanFragment.h"
+
+namespace facebook::presto {
+
+/// A bounded LRU cache of the result rows of the leaf plan fragments, so that
+/// the tasks that run a fragment again over the same unchanged files, e.g. the
+/// ones of a refreshed dashboard, are served its rows without scanning. The
+/// rows are recorded as they enter the output of the task and replayed into
+/// the same output, which partitions them again.
+class FragmentResultCache {
+ public:
+  /// Caches up to 'maxBytes' of serialized rows. Caches nothing if 'maxBytes'
+  /// is 0.
+  explicit FragmentResultCache(uint64_t maxBytes) : cache_(maxBytes) {}
+
+  uint64_t maxBytes() const {
+    return cache_.maxBytes();
+  }
+
+  /// Returns the key of the results of 'planFragment' over 'sources' or
+  /// std::nullopt if they are not cached. The results are cached if the
+  /// leaves of the fragment are all table scans that get all their hive
+  /// splits in 'sources', the splits have their file modification times, the
+  /// fragment calls no non-deterministic function and its output is
+  /// partitioned. The key is made of the plan, which embeds the filters, of
+  /// the columns of the scans, of 'resultConfigs', the session properties
+  /// which change the results, see QuerySessionConfig, and of the files,
+  /// ranges and modification times of the splits.
+  static std::optional<std::string> makeKey(
+      const velox::core::PlanFragment& planFragment,
+      const std::vector<protocol::TaskSource>& sources,
+      const std::string& resultConfigs = "");
+
+  /// Returns 'planFragment' with the source of its output replaced by the
+  /// rows of 'pages'. The fragment no longer reads its splits.
+  static velox::core::PlanFragment withCachedResult(
+      const velox::core::PlanFragment& planFragment,
+      std::shared_ptr<const operators::FragmentResultPages> pages);
+
+  /// Returns 'planFragment' with the rows entering its output recorded into
+  /// 'recorder'.
+  static velox::core::PlanFragment withResultRecorder(
+      const velox::core::PlanFragment& planFragment,
+      std::shared_ptr<operators::FragmentResultRecorder> recorder);
+
+  /// Returns the results cached for 'key' or null.
+  std::shared_ptr<const operators::FragmentResultPages> get(
+      const std::string& key);
+
+  /// Caches 'pages' for 'key', evicting the least recently used results.
+  void put(
+      const std::string& key,
+      std::shared_ptr<const operators::FragmentResultPages> pages);
+
+  size_t size() const {
+    std::lock_guard<std::mutex> l(mutex_);
+    return cache_.size();
+  }
+
+  uint64_t bytes() const {
+    std::lock_guard<std::mutex> l(mutex_);
+    return cache_.bytes();
+  }
+
+ private:
+  mutable std::mutex mutex_;
+  ByteLruCache<
+      std::string,
+      std::shared_ptr<const operators::FragmentResultPages>>
+      cache_;
+};
+
+} // namespace facebook::presto
@@ -0,0 +1,118 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/HugePages.h"
+#include <folly/String.h>
+#include <glog/logging.h>
+#include <sys/mman.h>
+#include <algorithm>
+#include <fstream>
+#include <set>
+#include <sstream>
+
+namespace facebook::presto {
+
+std::vector<AddressRange> parseAnonymousMappings(std::istream& maps) {
+  // Each line is 'begin-end perms offset dev inode [path]'.
+  std::vector<AddressRange> ranges;
+  std::string line;
+  while (std::getline(maps, line)) {
+    std::istringstream fields(line);
+    std::string addresses;
+    std::string perms;
+    std::string offset;
+    std::string device;
+    uint64_t inode{0};
+    std::string path;
+    if (!(fields >> addresses >> perms >> offset >> device >> inode)) {
+      continue;
+    }
+    fields >> path;
+    if (inode != 0 || (!path.empty() && path != "[anon]")) {
+      continue;
+    }
+    const auto dash = addresses.find('-');
+    if (dash == std::string::npos) {
+      continue;
+    }
+    ranges.push_back(
+        {std::stoull(addresses.substr(0, dash), nullptr, 16),
+         std::stoull(addresses.substr(dash + 1), nullptr, 16)});
+  }
+  return ranges;
+}
+
+std::vector<AddressRange> anonymousMappings() {
+  std::ifstream maps("/proc/self/maps");
+  return parseAnonymousMappings(maps);
+}
+
+std::string transparentHugePageMode() {
+  // The current mode is in brackets, e.g. 'always [madvise] never'.
+  std::ifstream in("/sys/kernel/mm/transparent_hugepage/enabled");
+  std::string modes;
+  if (!std::getline(in, modes)) {
+    return "";
+  }
+  const auto begin = modes.find('[');
+  const auto end = modes.find(']');
+  if (begin == std::string::npos || end == std::string::npos || end < begin) {
+    return "";
+  }
+  return modes.substr(begin + 1, end - begin - 1);
+}
+
+int64_t anonHugePageBytes() {
+  std::ifstream in("/proc/self/smaps_rollup");
+  std::string line;
+  while (std::getline(in, line)) {
+    static const std::string kAnonHugePages = "AnonHugePages:";
+    if (line.compare(0, kAnonHugePages.size(), kAnonHugePages) == 0) {
+      return std::stoll(line.substr(kAnonHugePages.size())) << 10;
+    }
+  }
+  return 0;
+}
+
+HugePageAdvice adviseHugePages(
+    const std::vector<AddressRange>& before,
+    const std::vector<AddressRange>& after,
+    uint64_t minBytes) {
+  // A mapping that grew in place keeps its start, so the lengths are compared
+  // too.
+  std::set<std::pair<uintptr_t, uint64_t>> existing;
+  for (const auto& range : before) {
+    existing.emplace(range.begin, range.size());
+  }
+  HugePageAdvice advice;
+  for (const auto& range : after) {
+    if (range.size() < minBytes ||
+        existing.count({range.begin, range.size()}) > 0) {
+      continue;
+    }
+    if (madvise(
+            reinterpret_cast<void*>(range.begin),
+            range.size(),
+            MADV_HUGEPAGE) != 0) {
+      LOG(WARNING) << "madvise(MADV_HUGEPAGE) of " << range.size()
+                   << " bytes failed: " << folly::errnoStr(errno);
+      ++advice.numFailed;
+      continue;
+    }
+    ++advice.numRanges;
+    advice.bytes += range.size();
+  }
+  return advice;
+}
+
+} // namespace facebook::presto
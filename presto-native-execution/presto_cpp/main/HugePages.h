@@ -0,0 +1,66 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <vector>
+
+namespace facebook::presto {
+
+/// An address range of an anonymous mapping of the process.
+struct AddressRange {
+  uintptr_t begin;
+  uintptr_t end;
+
+  uint64_t size() const {
+    return end - begin;
+  }
+
+  bool operator==(const AddressRange& other) const {
+    return begin == other.begin && end == other.end;
+  }
+};
+
+/// Returns the anonymous mappings of the /proc/<pid>/maps text 'maps'.
+std::vector<AddressRange> parseAnonymousMappings(std::istream& maps);
+
+/// Returns the anonymous mappings of this process.
+std::vector<AddressRange> anonymousMappings();
+
+/// Returns the mode of transparent huge pages of the kernel: "always",
+/// "madvise" or "never", or an empty string if unknown.
+std::string transparentHugePageMode();
+
+/// Returns the bytes of this process backed by transparent huge pages.
+int64_t anonHugePageBytes();
+
+/// The outcome of adviseHugePages().
+struct HugePageAdvice {
+  int32_t numRanges{0};
+  int32_t numFailed{0};
+  uint64_t bytes{0};
+};
+
+/// Advises the kernel to back the anonymous mappings of at least 'minBytes'
+/// that are in 'after' but not in 'before' with transparent huge pages. This
+/// is how the address ranges the MmapAllocator reserves for its size classes
+/// and arena at construction are found, since Velox does not expose them.
+HugePageAdvice adviseHugePages(
+    const std::vector<AddressRange>& before,
+    const std::vector<AddressRange>& after,
+    uint64_t minBytes);
+
+} // namespace facebook::presto
@@ -0,0 +1,205 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/InProcessExchangeSource.h"
+
+#include <folly/Uri.h>
+#include <folly/futures/Future.h>
+#include <re2/re2.h>
+
+#include "presto_cpp/main/PageChecksum.h"
+#include "presto_cpp/main/QueryContextManager.h"
+#include "presto_cpp/main/common/Configs.h"
+#include "presto_cpp/main/common/Counters.h"
+#include "velox/common/base/StatsReporter.h"
+#include "velox/common/time/Timer.h"
+
+using namespace facebook::velox;
+
+namespace facebook::presto {
+namespace {
+// The delay before retrying to read from an output buffer which doesn't
+// exist yet, i.e. the producer task has not been created on this worker yet.
+constexpr std::chrono::milliseconds kBufferNotFoundRetryDelay{10};
+} // namespace
+
+InProcessExchangeSource::InProcessExchangeSource(
+    const std::string& taskId,
+    int destination,
+    std::shared_ptr<exec::ExchangeQueue> queue,
+    memory::MemoryPool* pool,
+    std::chrono::milliseconds bufferNotFoundTimeout)
+    : ExchangeSource(taskId, destination, std::move(queue), pool),
+      bufferManager_(exec::PartitionedOutputBufferManager::getInstance()),
+      maxResponseBytes_(SystemConfig::instance()->exchangeMaxResponseBytes()),
+      bufferNotFoundTimeout_(bufferNotFoundTimeout),
+      checksumPages_(SystemConfig::instance()->enableSerializedPageChecksum()) {
+}
+
+bool InProcessExchangeSource::shouldRequestLocked() {
+  if (atEnd_) {
+    return false;
+  }
+  bool pending = requestPending_;
+  requestPending_ = true;
+  return !pending;
+}
+
+void InProcessExchangeSource::request() {
+  if (closed_.load()) {
+    return;
+  }
+  auto bufferManager = bufferManager_.lock();
+  if (bufferManager == nullptr) {
+    queue_->setError("PartitionedOutputBufferManager is destroyed");
+    return;
+  }
+  VLOG(1) << "Fetching in-process data from " << taskId_ << ", buffer "
+          << destination_ << ", sequence " << sequence_;
+  auto self = getSelfPtr();
+  const bool found = bufferManager->getData(
+      taskId_,
+      destination_,
+      maxResponseBytes_,
+      sequence_,
+      [self](
+          std::vector<std::unique_ptr<folly::IOBuf>> pages, int64_t sequence) {
+        self->processPages(std::move(pages), sequence);
+      });
+  if (found) {
+    bufferNotFoundSinceMs_ = 0;
+    return;
+  }
+  // The consumer may be scheduled before the producer task is created. The
+  // producer may also never show up or be gone already, e.g. if it failed.
+  const auto nowMs = getCurrentTimeMs();
+  if (bufferNotFoundSinceMs_ == 0) {
+    bufferNotFoundSinceMs_ = nowMs;
+  } else if (
+      nowMs - bufferNotFoundSinceMs_ >=
+      static_cast<uint64_t>(bufferNotFoundTimeout_.count())) {
+    queue_->setError(fmt::format(
+        "Output buffer {} of task {} not found for {} ms",
+        destination_,
+        taskId_,
+        nowMs - bufferNotFoundSinceMs_));
+    return;
+  }
+  folly::futures::sleep(kBufferNotFoundRetryDelay)
+      .via(driverCPUExecutor())
+      .thenValue([self](auto&& /*unused*/) { self->request(); });
+}
+
+void InProcessExchangeSource::processPages(
+    std::vector<std::unique_ptr<folly::IOBuf>> pages,
+    int64_t sequence) {
+  // The output buffer notifies with no pages once it is deleted.
+  bool complete = pages.empty();
+  int64_t numPages = 0;
+  std::vector<exec::ContinuePromise> promises;
+  {
+    std::lock_guard<std::mutex> l(queue_->mutex());
+    VELOX_CHECK_EQ(
+        sequence,
+        sequence_,
+        "Received in-process data for an unexpected sequence from {}",
+        taskId_);
+    for (auto& page : pages) {
+      if (page == nullptr) {
+        complete = true;
+        continue;
+      }
+      VLOG(1) << "Enqueuing in-process page for " << taskId_ << "/"
+              << sequence_ << ": " << page->computeChainDataLength()
+              << " bytes";
+      if (checksumPages_) {
+        // The page may also be sent to remote consumers, which set its
+        // checksum in place. Setting it here first keeps the header from
+        // changing while it is deserialized.
+        setPageChecksum(*page);
+      }
+      // The page shares the output buffer memory, which outlives the
+      // acknowledgement as the memory is only freed with the last reference.
+      queue_->enqueueLocked(
+          std::make_unique<exec::SerializedPage>(std::move(page)), promises);
+      ++numPages;
+    }
+    if (complete) {
+      atEnd_ = true;
+      queue_->enqueueLocked(nullptr, promises);
+    }
+    sequence_ += numPages;
+    requestPending_ = false;
+  }
+  for (auto& promise : promises) {
+    promise.setValue();
+  }
+
+  auto bufferManager = bufferManager_.lock();
+  if (bufferManager == nullptr) {
+    return;
+  }
+  if (complete) {
+    bufferManager->deleteResults(taskId_, destination_);
+  } else {
+    bufferManager->acknowledge(taskId_, destination_, sequence_);
+  }
+}
+
+void InProcessExchangeSource::close() {
+  closed_.store(true);
+  if (auto bufferManager = bufferManager_.lock()) {
+    bufferManager->deleteResults(taskId_, destination_);
+  }
+}
+
+std::shared_ptr<InProcessExchangeSource> InProcessExchangeSource::getSelfPtr() {
+  return std::dynamic_pointer_cast<InProcessExchangeSource>(
+      shared_from_this());
+}
+
+// static
+std::unique_ptr<exec::ExchangeSource>
+InProcessExchangeSource::createExchangeSource(
+    const std::string& url,
+    int destination,
+    std::shared_ptr<exec::ExchangeQueue> queue,
+    memory::MemoryPool* pool) {
+  const auto& local = localAddress();
+  if (local.host.empty() ||
+      (strncmp(url.c_str(), "http://", 7) != 0 &&
+       strncmp(url.c_str(), "https://", 8) != 0)) {
+    return nullptr;
+  }
+  const folly::Uri uri(url);
+  if (uri.host() != local.host || uri.port() != local.port) {
+    return nullptr;
+  }
+  static const RE2 kPattern("/v1/task/([^/]*)/results/[0-9]+");
+  std::string taskId;
+  if (!RE2::FullMatch(uri.path(), kPattern, &taskId)) {
+    return nullptr;
+  }
+  REPORT_ADD_STAT_VALUE(kCounterNumInProcessExchangeSources);
+  return std::make_unique<InProcessExchangeSource>(
+      taskId, destination, std::move(queue), pool);
+}
+
+// static
+void InProcessExchangeSource::setLocalAddress(
+    const std::string& host,
+    uint16_t port) {
+  localAddress() = LocalAddress{host, port};
+}
+
+} // namespace facebook::presto
@@ -0,0 +1,90 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include "presto_cpp/main/PrestoExchangeSource.h"
+#include "velox/exec/Exchange.h"
+#include "velox/exec/PartitionedOutputBufferManager.h"
+
+namespace facebook::presto {
+
+/// Reads the pages of an output buffer of a task running on this worker
+/// directly from the PartitionedOutputBufferManager, bypassing http. The pages
+/// are enqueued without copies: they share the memory of the output buffer
+/// pages which is owned by the producer task.
+class InProcessExchangeSource : public velox::exec::ExchangeSource {
+ public:
+  /// The source fails the queue if the output buffer is not found for
+  /// 'bufferNotFoundTimeout', i.e. the producer task is not created in time or
+  /// was already deleted.
+  InProcessExchangeSource(
+      const std::string& taskId,
+      int destination,
+      std::shared_ptr<velox::exec::ExchangeQueue> queue,
+      velox::memory::MemoryPool* pool,
+      std::chrono::milliseconds bufferNotFoundTimeout =
+          PrestoExchangeSource::kRequestTimeout);
+
+  bool shouldRequestLocked() override;
+
+  void request() override;
+
+  void close() override;
+
+  /// Returns an in-process exchange source if 'url' points at the output
+  /// buffer of a task on this worker, i.e. its host and port match the ones
+  /// set by setLocalAddress(). Returns null otherwise.
+  static std::unique_ptr<velox::exec::ExchangeSource> createExchangeSource(
+      const std::string& url,
+      int destination,
+      std::shared_ptr<velox::exec::ExchangeQueue> queue,
+      velox::memory::MemoryPool* pool);
+
+  /// Sets the host and port of the task URIs of this worker. An empty 'host'
+  /// disables the in-process exchange sources.
+  static void setLocalAddress(const std::string& host, uint16_t port);
+
+ private:
+  // Invoked with the 'pages' fetched for 'sequence' from the output buffer.
+  // A null page or no pages at all mark the end of the buffer.
+  void processPages(
+      std::vector<std::unique_ptr<folly::IOBuf>> pages,
+      int64_t sequence);
+
+  std::shared_ptr<InProcessExchangeSource> getSelfPtr();
+
+  struct LocalAddress {
+    std::string host;
+    uint16_t port{0};
+  };
+
+  static LocalAddress& localAddress() {
+    static LocalAddress localAddress;
+    return localAddress;
+  }
+
+  const std::weak_ptr<velox::exec::PartitionedOutputBufferManager>
+      bufferManager_;
+  const int64_t maxResponseBytes_;
+  const std::chrono::milliseconds bufferNotFoundTimeout_;
+  // Whether the result pages carry checksums.
+  const bool checksumPages_;
+  std::atomic_bool closed_{false};
+  // The time in ms the output buffer was first not found since it was last
+  // found, 0 if it was found. Only accessed by request(), which has at most
+  // one call in flight.
+  uint64_t bufferNotFoundSinceMs_{0};
+};
+
+} // namespace facebook::presto
@@ -0,0 +1,46 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/LatencyPercentile.h"
+#include <algorithm>
+#include <cmath>
+#include "velox/common/base/Exceptions.h"
+
+namespace facebook::presto {
+
+LatencyPercentile::LatencyPercentile(double percentile, size_t windowSize)
+    : percentile_(percentile),
+      recomputeInterval_(std::max<size_t>(1, windowSize / 16)),
+      samples_(windowSize) {
+  VELOX_CHECK_GT(percentile, 0);
+  VELOX_CHECK_LE(percentile, 100);
+  VELOX_CHECK_GT(windowSize, 0);
+}
+
+void LatencyPercentile::add(int64_t latencyMs) {
+  std::lock_guard<std::mutex> l(mutex_);
+  samples_[numSamples_++ % samples_.size()] = latencyMs;
+  if (numSamples_ < samples_.size() ||
+      (numSamples_ > samples_.size() &&
+       numSamples_ % recomputeInterval_ != 0)) {
+    return;
+  }
+  auto sorted = samples_;
+  const size_t rank = std::min<size_t>(
+      sorted.size() - 1,
+      std::ceil(sorted.size() * percentile_ / 100) - 1);
+  std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+  value_ = sorted[rank];
+}
+
+} // namespace facebook::presto
@@ -0,0 +1,49 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+namespace facebook::presto {
+
+/// Tracks a percentile of the recent latencies, e.g. of the exchange fetches.
+/// The percentile is recomputed over the last 'windowSize' samples every
+/// 'windowSize' / 16 samples, so that reading it is cheap. Thread safe.
+class LatencyPercentile {
+ public:
+  /// 'percentile' is in (0, 100].
+  explicit LatencyPercentile(double percentile, size_t windowSize = 1024);
+
+  void add(int64_t latencyMs);
+
+  /// Returns the percentile of the recent latencies, or 0 until a window of
+  /// samples is seen.
+  int64_t get() const {
+    return value_;
+  }
+
+ private:
+  const double percentile_;
+  const size_t recomputeInterval_;
+
+  std::mutex mutex_;
+  // Ring buffer of the last samples.
+  std::vector<int64_t> samples_;
+  size_t numSamples_{0};
+  std::atomic<int64_t> value_{0};
+};
+
+} // namespace facebook::presto
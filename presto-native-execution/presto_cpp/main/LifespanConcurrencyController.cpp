@@ -0,0 +1,41 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/LifespanConcurrencyController.h"
+#include <algorithm>
+#include "velox/common/base/Exceptions.h"
+
+namespace facebook::presto {
+
+LifespanConcurrencyController::LifespanConcurrencyController(
+    int32_t minLifespans,
+    int32_t maxLifespans)
+    : minLifespans_(minLifespans),
+      maxLifespans_(maxLifespans),
+      lifespans_(minLifespans) {
+  VELOX_CHECK_GT(minLifespans_, 0);
+  VELOX_CHECK_LE(minLifespans_, maxLifespans_);
+}
+
+int32_t LifespanConcurrencyController::update(
+    double memoryPct,
+    double cpuLoadPct) {
+  if (memoryPct > kHighMemoryPct) {
+    lifespans_ = std::max(minLifespans_, lifespans_ / 2);
+  } else if (memoryPct < kLowMemoryPct && cpuLoadPct < kLowCPULoadPct) {
+    lifespans_ = std::min(maxLifespans_, lifespans_ + 1);
+  }
+  return lifespans_;
+}
+
+} // namespace facebook::presto
@@ -0,0 +1,52 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstdint>
+
+namespace facebook::presto {
+
+/// Adapts the number of concurrent lifespans of the new grouped execution
+/// tasks to the memory and CPU headroom of the node. Each lifespan holds its
+/// own hash tables and buffers, so the lifespans are halved on each update
+/// with the memory usage above 'kHighMemoryPct' before the large buckets run
+/// the node out of memory. One more lifespan is allowed on each update with
+/// the memory usage below 'kLowMemoryPct' and the CPU load below
+/// 'kLowCPULoadPct', i.e. while the running lifespans leave cores idle. The
+/// count holds otherwise.
+class LifespanConcurrencyController {
+ public:
+  static constexpr double kHighMemoryPct{85};
+  static constexpr double kLowMemoryPct{70};
+  static constexpr double kLowCPULoadPct{60};
+
+  /// The lifespan count stays between 'minLifespans' and 'maxLifespans' and
+  /// starts at 'minLifespans'.
+  LifespanConcurrencyController(int32_t minLifespans, int32_t maxLifespans);
+
+  /// Updates the lifespan count with the memory usage and the CPU load and
+  /// returns it.
+  int32_t update(double memoryPct, double cpuLoadPct);
+
+  int32_t lifespans() const {
+    return lifespans_;
+  }
+
+ private:
+  const int32_t minLifespans_;
+  const int32_t maxLifespans_;
+  int32_t lifespans_;
+};
+
+} // namespace facebook::presto
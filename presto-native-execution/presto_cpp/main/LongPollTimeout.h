@@ -0,0 +1,82 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <folly/futures/Future.h>
+#include <folly/io/async/EventBase.h>
+#include <folly/io/async/HHWheelTimer.h>
+#include <chrono>
+
+namespace facebook::presto {
+
+namespace detail {
+template <typename T>
+class LongPollTimeout : public folly::HHWheelTimer::Callback {
+ public:
+  explicit LongPollTimeout(folly::Function<T()> timeoutFn)
+      : timeoutFn_(std::move(timeoutFn)) {}
+
+  folly::SemiFuture<T> getSemiFuture() {
+    return promise_.getSemiFuture();
+  }
+
+  void timeoutExpired() noexcept override {
+    done_ = true;
+    promise_.setWith(std::move(timeoutFn_));
+  }
+
+  void complete(folly::Try<T>&& result) {
+    if (done_) {
+      return;
+    }
+    done_ = true;
+    cancelTimeout();
+    promise_.setTry(std::move(result));
+  }
+
+ private:
+  folly::Function<T()> timeoutFn_;
+  folly::Promise<T> promise_;
+  // Set once the timeout expires or 'future' completes. Both run on the event
+  // base thread.
+  bool done_{false};
+};
+} // namespace detail
+
+/// Returns 'future' continued on 'eventBase', which is completed with
+/// 'timeoutFn()' instead if 'future' does not complete within 'timeout'. The
+/// timeout is on the wheel timer of 'eventBase' with O(1) scheduling and
+/// cancellation and the due timeouts expired in batches, instead of on the
+/// shared timekeeper thread. For the long polls of many concurrent requests.
+/// Must be called on the thread of 'eventBase'.
+template <typename T>
+folly::Future<T> withLongPollTimeout(
+    folly::Future<T> future,
+    folly::EventBase* eventBase,
+    std::chrono::microseconds timeout,
+    folly::Function<T()> timeoutFn) {
+  DCHECK(eventBase->isInEventBaseThread());
+  auto longPoll =
+      std::make_shared<detail::LongPollTimeout<T>>(std::move(timeoutFn));
+  eventBase->timer().scheduleTimeout(
+      longPoll.get(), std::chrono::ceil<std::chrono::milliseconds>(timeout));
+  auto result = longPoll->getSemiFuture().via(eventBase);
+  // Keeps 'longPoll' alive while the wheel timer refers to it.
+  std::move(future).via(eventBase).thenTry([longPoll](folly::Try<T>&& value) {
+    longPoll->complete(std::move(value));
+  });
+  return result;
+}
+
+} // namespace facebook::presto
@@ -0,0 +1,101 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/MemoryTrimmer.h"
+#include <fmt/format.h>
+#include <folly/memory/Malloc.h>
+#include <unistd.h>
+#include <fstream>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+#include "velox/common/caching/AsyncDataCache.h"
+#include "velox/common/memory/MmapAllocator.h"
+
+namespace facebook::presto {
+
+namespace {
+// The size of the machine pages the allocators count.
+constexpr int64_t kPageBytes = 4096;
+
+// Purges the dirty pages of all the jemalloc arenas (MALLCTL_ARENAS_ALL).
+void purgeJemallocArenas() {
+  if (folly::usingJEMalloc()) {
+    mallctl("arena.4096.purge", nullptr, nullptr, nullptr, 0);
+  }
+}
+} // namespace
+
+std::string MemoryTrimStats::toString() const {
+  return fmt::format(
+      "Released {} bytes: resident {} -> {} bytes, dropped {} cache bytes",
+      releasedBytes(),
+      residentBytesBefore,
+      residentBytesAfter,
+      cacheBytesDropped);
+}
+
+int64_t residentBytes() {
+  // The second field of statm is the resident pages.
+  std::ifstream statm("/proc/self/statm");
+  int64_t sizePages{0};
+  int64_t residentPages{0};
+  if (!(statm >> sizePages >> residentPages)) {
+    return 0;
+  }
+  return residentPages * sysconf(_SC_PAGESIZE);
+}
+
+std::string memoryAllocatorDetail(
+    const velox::memory::MemoryAllocator* allocator) {
+  const int64_t mappedBytes = allocator->numMapped() * kPageBytes;
+  const int64_t allocatedBytes = allocator->numAllocated() * kPageBytes;
+  auto detail = fmt::format(
+      "Resident {} bytes, mapped {} bytes, allocated {} bytes, "
+      "mapped but free {} bytes ({:.1f}% of mapped)",
+      residentBytes(),
+      mappedBytes,
+      allocatedBytes,
+      mappedBytes - allocatedBytes,
+      mappedBytes == 0 ? 0.0
+                       : 100.0 * (mappedBytes - allocatedBytes) / mappedBytes);
+  if (auto* mmapAllocator =
+          dynamic_cast<const velox::memory::MmapAllocator*>(allocator)) {
+    detail += fmt::format(
+        "\nExternally mapped {} bytes, malloc {} bytes\n{}",
+        mmapAllocator->numExternalMapped() * kPageBytes,
+        mmapAllocator->numMallocBytes(),
+        mmapAllocator->toString());
+  }
+  return detail;
+}
+
+MemoryTrimStats trimMemory(velox::cache::AsyncDataCache* cache) {
+  MemoryTrimStats stats;
+  stats.residentBytesBefore = residentBytes();
+  if (cache != nullptr) {
+    const auto before = cache->refreshStats();
+    cache->clear();
+    const auto after = cache->refreshStats();
+    stats.cacheBytesDropped = (before.tinySize + before.largeSize) -
+        (after.tinySize + after.largeSize);
+  }
+#ifdef __GLIBC__
+  malloc_trim(0);
+#endif
+  purgeJemallocArenas();
+  stats.residentBytesAfter = residentBytes();
+  return stats;
+}
+
+} // namespace facebook::presto
@@ -0,0 +1,57 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+
+namespace facebook::velox::cache {
+class AsyncDataCache;
+}
+
+namespace facebook::velox::memory {
+class MemoryAllocator;
+}
+
+namespace facebook::presto {
+
+/// The outcome of a trimMemory() call.
+struct MemoryTrimStats {
+  int64_t residentBytesBefore{0};
+  int64_t residentBytesAfter{0};
+  /// The bytes of the memory cache entries dropped.
+  int64_t cacheBytesDropped{0};
+
+  int64_t releasedBytes() const {
+    return std::max<int64_t>(0, residentBytesBefore - residentBytesAfter);
+  }
+
+  std::string toString() const;
+};
+
+/// Returns the resident set size of the process.
+int64_t residentBytes();
+
+/// Returns the mapped, allocated and free pages of 'allocator' and, for the
+/// MmapAllocator, the pages of each size class.
+std::string memoryAllocatorDetail(
+    const velox::memory::MemoryAllocator* allocator);
+
+/// Returns the free memory of the malloc arenas to the OS. Drops the unpinned
+/// entries of 'cache' first if not null, which gives their pages back to the
+/// allocator.
+MemoryTrimStats trimMemory(velox::cache::AsyncDataCache* cache = nullptr);
+
+} // namespace facebook::presto
@@ -0,0 +1,126 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/NumaExecutors.h"
+#include <folly/Conv.h>
+#include <folly/FileUtil.h>
+#include <folly/String.h>
+#include <folly/executors/thread_factory/NamedThreadFactory.h>
+#include <glog/logging.h>
+#include <pthread.h>
+#include <sched.h>
+#include <limits>
+#include "velox/common/base/Exceptions.h"
+
+namespace facebook::presto {
+namespace {
+// Names the threads and pins them to the CPUs of a NUMA node.
+class PinnedThreadFactory : public folly::NamedThreadFactory {
+ public:
+  PinnedThreadFactory(const std::string& prefix, std::vector<int32_t> cpus)
+      : folly::NamedThreadFactory(prefix), cpus_(std::move(cpus)) {}
+
+  std::thread newThread(folly::Func&& func) override {
+    return folly::NamedThreadFactory::newThread(
+        [cpus = cpus_, func = std::move(func)]() mutable {
+          cpu_set_t cpuSet;
+          CPU_ZERO(&cpuSet);
+          for (auto cpu : cpus) {
+            CPU_SET(cpu, &cpuSet);
+          }
+          if (pthread_setaffinity_np(
+                  pthread_self(), sizeof(cpuSet), &cpuSet) != 0) {
+            LOG(WARNING) << "Failed to pin a driver thread to its NUMA node";
+          }
+          func();
+        });
+  }
+
+ private:
+  const std::vector<int32_t> cpus_;
+};
+} // namespace
+
+std::vector<int32_t> parseCpuList(const std::string& cpuList) {
+  std::vector<int32_t> cpus;
+  std::vector<folly::StringPiece> ranges;
+  folly::split(',', folly::trimWhitespace(cpuList), ranges, true);
+  for (const auto& range : ranges) {
+    folly::StringPiece first;
+    folly::StringPiece last;
+    if (folly::split('-', range, first, last)) {
+      const auto begin = folly::to<int32_t>(first);
+      const auto end = folly::to<int32_t>(last);
+      VELOX_CHECK_LE(begin, end, "Invalid CPU range: {}", range);
+      for (auto cpu = begin; cpu <= end; ++cpu) {
+        cpus.push_back(cpu);
+      }
+    } else {
+      cpus.push_back(folly::to<int32_t>(range));
+    }
+  }
+  return cpus;
+}
+
+std::vector<std::vector<int32_t>> numaNodeCpus() {
+  std::vector<std::vector<int32_t>> nodeCpus;
+  for (int32_t node = 0;; ++node) {
+    std::string cpuList;
+    if (!folly::readFile(
+            fmt::format("/sys/devices/system/node/node{}/cpulist", node)
+                .c_str(),
+            cpuList)) {
+      break;
+    }
+    nodeCpus.push_back(parseCpuList(cpuList));
+  }
+  if (nodeCpus.empty()) {
+    nodeCpus.emplace_back();
+  }
+  return nodeCpus;
+}
+
+NumaExecutors::NumaExecutors(
+    const std::vector<std::vector<int32_t>>& nodeCpus,
+    int32_t numThreads) {
+  VELOX_CHECK(!nodeCpus.empty());
+  size_t totalCpus{0};
+  for (const auto& cpus : nodeCpus) {
+    totalCpus += cpus.size();
+  }
+  for (size_t node = 0; node < nodeCpus.size(); ++node) {
+    const auto& cpus = nodeCpus[node];
+    const size_t nodeThreads = totalCpus == 0
+        ? numThreads / nodeCpus.size()
+        : numThreads * cpus.size() / totalCpus;
+    executors_.push_back(std::make_shared<folly::CPUThreadPoolExecutor>(
+        std::max<size_t>(1, nodeThreads),
+        std::make_shared<PinnedThreadFactory>(
+            fmt::format("Driver{}-", node), cpus)));
+  }
+}
+
+size_t NumaExecutors::leastLoadedNode() const {
+  size_t bestNode{0};
+  size_t bestPending = std::numeric_limits<size_t>::max();
+  for (size_t node = 0; node < executors_.size(); ++node) {
+    const auto pending = executors_[node]->getPendingTaskCount();
+    if (pending < bestPending) {
+      bestNode = node;
+      bestPending = pending;
+    }
+  }
+  return bestNode;
+}
+
+} // namespace facebook::presto
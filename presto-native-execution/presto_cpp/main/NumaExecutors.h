@@ -0,0 +1,58 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <folly/executors/CPUThreadPoolExecutor.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace facebook::presto {
+
+/// Returns the CPUs listed in 'cpuList', in the format of the Linux sysfs
+/// cpulist files, e.g. "0-3,8,10-11". Throws on a malformed list.
+std::vector<int32_t> parseCpuList(const std::string& cpuList);
+
+/// Returns the CPUs of each NUMA node of the machine, indexed by node. Returns
+/// a single node with no CPUs when the topology is not available.
+std::vector<std::vector<int32_t>> numaNodeCpus();
+
+/// Driver executors with one thread pool per NUMA node, the threads of each
+/// pinned to the CPUs of their node. The tasks of a query all run on the pool
+/// of its home node, so that the memory they allocate and first touch is
+/// local to the threads that use it.
+class NumaExecutors {
+ public:
+  /// Splits 'numThreads' between the nodes of 'nodeCpus' in proportion to
+  /// their CPUs, with at least one thread per node.
+  NumaExecutors(
+      const std::vector<std::vector<int32_t>>& nodeCpus,
+      int32_t numThreads);
+
+  size_t numNodes() const {
+    return executors_.size();
+  }
+
+  folly::CPUThreadPoolExecutor* executor(size_t node) const {
+    return executors_[node].get();
+  }
+
+  /// Returns the node with the fewest pending tasks, the home of a new query.
+  size_t leastLoadedNode() const;
+
+ private:
+  std::vector<std::shared_ptr<folly::CPUThreadPoolExecutor>> executors_;
+};
+
+} // namespace facebook::presto
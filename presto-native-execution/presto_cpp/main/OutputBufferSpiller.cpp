@@ -0,0 +1,383 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/OutputBufferSpiller.h"
+#include <glog/logging.h>
+#include "presto_cpp/main/common/Counters.h"
+#include "velox/common/base/StatsReporter.h"
+#include "velox/common/time/Timer.h"
+
+namespace facebook::presto {
+namespace {
+// The bytes to move from the output buffer per read.
+constexpr uint64_t kMoveBytes{1 << 20};
+} // namespace
+
+OutputBufferSpiller::OutputBufferSpiller(
+    std::shared_ptr<velox::exec::PartitionedOutputBufferManager> bufferManager,
+    folly::Executor* executor,
+    Options options)
+    : bufferManager_(std::move(bufferManager)),
+      executor_(executor),
+      options_(std::move(options)) {}
+
+bool OutputBufferSpiller::getData(
+    const std::string& taskId,
+    int destination,
+    uint64_t maxBytes,
+    int64_t sequence,
+    velox::exec::DataAvailableCallback notify) {
+  if (options_.spillPath.empty()) {
+    return bufferManager_->getData(
+        taskId, destination, maxBytes, sequence, std::move(notify));
+  }
+  std::vector<std::unique_ptr<folly::IOBuf>> pages;
+  bool resume{false};
+  {
+    auto state = findOrCreate(taskId, destination);
+    std::lock_guard<std::mutex> l(state->mutex);
+    state->lastRequestMs = velox::getCurrentTimeMs();
+    if (state->file == nullptr) {
+      state->sequence = std::max(state->sequence, sequence);
+    } else {
+      acknowledgeLocked(*state, sequence);
+      VELOX_CHECK_EQ(
+          state->sequence,
+          sequence,
+          "Get received for pages not spilled yet: {}, buffer {}",
+          taskId,
+          destination);
+      const bool hasPages =
+          !state->sentPages.empty() || !state->file->empty();
+      if (!hasPages && !state->atEnd) {
+        if (state->moving) {
+          state->pendingNotify = std::move(notify);
+          state->pendingMaxBytes = maxBytes;
+          return true;
+        }
+        // The consumer has caught up with the output buffer.
+        VLOG(1) << "Unspilled " << taskId << ", buffer " << destination;
+        state->file.reset();
+      } else {
+        pages = nextPagesLocked(*state, maxBytes);
+        // Moving stops at the spill limit until half of it is read.
+        resume = !state->moving && !state->atEnd && !state->writeFailed &&
+            state->file->bytes() < options_.maxBytesPerDestination / 2;
+      }
+    }
+  }
+  if (pages.empty()) {
+    return bufferManager_->getData(
+        taskId, destination, maxBytes, sequence, std::move(notify));
+  }
+  notify(std::move(pages), sequence);
+  if (resume) {
+    movePages(taskId, destination);
+  }
+  return true;
+}
+
+void OutputBufferSpiller::acknowledge(
+    const std::string& taskId,
+    int destination,
+    int64_t sequence) {
+  if (!options_.spillPath.empty()) {
+    if (auto state = find(taskId, destination)) {
+      std::lock_guard<std::mutex> l(state->mutex);
+      if (state->file != nullptr) {
+        // The spilled pages are acknowledged in the output buffer on move.
+        acknowledgeLocked(*state, sequence);
+        return;
+      }
+      state->sequence = std::max(state->sequence, sequence);
+    }
+  }
+  bufferManager_->acknowledge(taskId, destination, sequence);
+}
+
+void OutputBufferSpiller::deleteResults(
+    const std::string& taskId,
+    int destination) {
+  if (!options_.spillPath.empty()) {
+    auto& taskShard = shard(taskId);
+    std::lock_guard<std::mutex> l(taskShard.mutex);
+    auto it = taskShard.destinations.find(taskId);
+    if (it != taskShard.destinations.end()) {
+      it->second.erase(destination);
+      if (it->second.empty()) {
+        taskShard.destinations.erase(it);
+      }
+    }
+  }
+  bufferManager_->deleteResults(taskId, destination);
+}
+
+void OutputBufferSpiller::removeTask(const std::string& taskId) {
+  auto& taskShard = shard(taskId);
+  std::lock_guard<std::mutex> l(taskShard.mutex);
+  taskShard.destinations.erase(taskId);
+}
+
+size_t OutputBufferSpiller::maybeSpill(double memoryPct) {
+  if (options_.spillPath.empty() || memoryPct < options_.memoryPct) {
+    return 0;
+  }
+  std::vector<std::pair<std::string, int>> spilled;
+  const auto nowMs = velox::getCurrentTimeMs();
+  const uint64_t minIdleMs = options_.minIdle.count();
+  for (auto& ref : allDestinations()) {
+    auto& state = *ref.state;
+    std::lock_guard<std::mutex> l(state.mutex);
+    if (state.file != nullptr || state.writeFailed ||
+        nowMs - state.lastRequestMs < minIdleMs) {
+      continue;
+    }
+    try {
+      state.file = std::make_unique<ExchangeSpillFile>(options_.spillPath);
+    } catch (const std::exception& e) {
+      LOG(WARNING) << "Cannot spill output buffer " << ref.taskId
+                   << ", buffer " << ref.destination << ": " << e.what();
+      break;
+    }
+    state.nextSequence = state.sequence;
+    state.atEnd = false;
+    spilled.emplace_back(ref.taskId, ref.destination);
+  }
+  for (const auto& [taskId, destination] : spilled) {
+    LOG(INFO) << "Spilling output buffer " << taskId << ", buffer "
+              << destination << " with idle consumer";
+    movePages(taskId, destination);
+  }
+  return spilled.size();
+}
+
+size_t OutputBufferSpiller::numSpilledDestinations() const {
+  size_t count{0};
+  for (const auto& ref : allDestinations()) {
+    std::lock_guard<std::mutex> l(ref.state->mutex);
+    count += ref.state->file != nullptr;
+  }
+  return count;
+}
+
+std::shared_ptr<OutputBufferSpiller::Destination> OutputBufferSpiller::find(
+    const std::string& taskId,
+    int destination) {
+  auto& taskShard = shard(taskId);
+  std::lock_guard<std::mutex> l(taskShard.mutex);
+  auto it = taskShard.destinations.find(taskId);
+  if (it == taskShard.destinations.end()) {
+    return nullptr;
+  }
+  auto destinationIt = it->second.find(destination);
+  return destinationIt == it->second.end() ? nullptr : destinationIt->second;
+}
+
+std::shared_ptr<OutputBufferSpiller::Destination>
+OutputBufferSpiller::findOrCreate(const std::string& taskId, int destination) {
+  auto& taskShard = shard(taskId);
+  std::lock_guard<std::mutex> l(taskShard.mutex);
+  auto& state = taskShard.destinations[taskId][destination];
+  if (state == nullptr) {
+    state = std::make_shared<Destination>();
+  }
+  return state;
+}
+
+std::vector<OutputBufferSpiller::DestinationRef>
+OutputBufferSpiller::allDestinations() const {
+  std::vector<DestinationRef> refs;
+  for (const auto& taskShard : shards_) {
+    std::lock_guard<std::mutex> l(taskShard.mutex);
+    for (const auto& [taskId, destinations] : taskShard.destinations) {
+      for (const auto& [destination, state] : destinations) {
+        refs.push_back({taskId, destination, state});
+      }
+    }
+  }
+  return refs;
+}
+
+// static
+void OutputBufferSpiller::acknowledgeLocked(
+    Destination& state,
+    int64_t sequence) {
+  while (state.sequence < sequence) {
+    if (!state.sentPages.empty()) {
+      state.sentPages.pop_front();
+    } else if (!state.file->empty()) {
+      state.file->skip();
+    } else {
+      break;
+    }
+    ++state.sequence;
+  }
+}
+
+// static
+std::vector<std::unique_ptr<folly::IOBuf>>
+OutputBufferSpiller::nextPagesLocked(Destination& state, uint64_t maxBytes) {
+  std::vector<std::unique_ptr<folly::IOBuf>> pages;
+  uint64_t bytes{0};
+  // The pages sent before are sent again until acknowledged.
+  for (const auto& page : state.sentPages) {
+    bytes += page->length();
+    pages.push_back(page->clone());
+  }
+  while (!state.file->empty() &&
+         (pages.empty() || bytes + state.file->nextPageBytes() <= maxBytes)) {
+    const auto pageBytes = state.file->nextPageBytes();
+    auto page = folly::IOBuf::create(pageBytes);
+    state.file->read(page->writableData());
+    page->append(pageBytes);
+    bytes += pageBytes;
+    pages.push_back(page->clone());
+    state.sentPages.push_back(std::move(page));
+  }
+  if (state.file->empty() && state.atEnd) {
+    pages.push_back(nullptr);
+  }
+  return pages;
+}
+
+void OutputBufferSpiller::movePages(
+    const std::string& taskId,
+    int destination) {
+  auto state = find(taskId, destination);
+  if (state == nullptr) {
+    return;
+  }
+  int64_t sequence;
+  {
+    std::lock_guard<std::mutex> l(state->mutex);
+    if (state->file == nullptr || state->atEnd || state->moving ||
+        state->writeFailed ||
+        state->file->bytes() >= options_.maxBytesPerDestination) {
+      return;
+    }
+    state->moving = true;
+    sequence = state->nextSequence;
+  }
+  std::weak_ptr<OutputBufferSpiller> self = weak_from_this();
+  const bool found = bufferManager_->getData(
+      taskId,
+      destination,
+      kMoveBytes,
+      sequence,
+      [self, executor = executor_, taskId, destination](
+          std::vector<std::unique_ptr<folly::IOBuf>> pages, int64_t sequence) {
+        // Called on the producer thread when the pages are added, so the
+        // pages are written on the executor.
+        executor->add([self,
+                       taskId,
+                       destination,
+                       pages = std::move(pages),
+                       sequence]() mutable {
+          if (auto spiller = self.lock()) {
+            spiller->spillPages(
+                taskId, destination, std::move(pages), sequence);
+          }
+        });
+      });
+  if (!found) {
+    // The task is gone and its state is removed with it.
+    std::lock_guard<std::mutex> l(state->mutex);
+    state->moving = false;
+  }
+}
+
+void OutputBufferSpiller::spillPages(
+    const std::string& taskId,
+    int destination,
+    std::vector<std::unique_ptr<folly::IOBuf>> pages,
+    int64_t sequence) {
+  auto state = find(taskId, destination);
+  if (state == nullptr) {
+    return;
+  }
+  velox::exec::DataAvailableCallback notify;
+  std::vector<std::unique_ptr<folly::IOBuf>> nextPages;
+  int64_t nextSequence;
+  int64_t notifySequence;
+  uint64_t notifyMaxBytes;
+  int64_t spilledBytes{0};
+  bool moveMore;
+  {
+    std::lock_guard<std::mutex> l(state->mutex);
+    if (state->file == nullptr) {
+      state->moving = false;
+      return;
+    }
+    state->moving = false;
+    VELOX_CHECK_EQ(sequence, state->nextSequence);
+    // No pages mean the end of the buffer.
+    bool atEnd = pages.empty();
+    for (const auto& page : pages) {
+      if (page == nullptr) {
+        atEnd = true;
+        continue;
+      }
+      try {
+        state->file->write(*page);
+      } catch (const std::exception& e) {
+        // The pages not written stay in the output buffer, which serves them
+        // once the consumer has read the spilled ones.
+        LOG(WARNING) << "Cannot spill output buffer " << taskId << ", buffer "
+                     << destination << ": " << e.what();
+        state->writeFailed = true;
+        break;
+      }
+      spilledBytes += page->computeChainDataLength();
+      ++state->nextSequence;
+    }
+    state->atEnd = atEnd && !state->writeFailed;
+    nextSequence = state->nextSequence;
+    if (state->pendingNotify != nullptr) {
+      notify = std::move(state->pendingNotify);
+      state->pendingNotify = nullptr;
+      notifySequence = state->sequence;
+      notifyMaxBytes = state->pendingMaxBytes;
+      if (!state->sentPages.empty() || !state->file->empty() ||
+          state->atEnd) {
+        nextPages = nextPagesLocked(*state, notifyMaxBytes);
+      } else {
+        // Nothing was written, the consumer reads from the output buffer.
+        state->file.reset();
+      }
+    }
+    moveMore = !state->atEnd && !state->writeFailed &&
+        state->file != nullptr &&
+        state->file->bytes() < options_.maxBytesPerDestination;
+  }
+  REPORT_ADD_STAT_VALUE(kCounterOutputBufferSpilledBytes, spilledBytes);
+  if (spilledBytes > 0) {
+    bufferManager_->acknowledge(taskId, destination, nextSequence);
+  }
+  if (notify != nullptr) {
+    if (nextPages.empty()) {
+      bufferManager_->getData(
+          taskId,
+          destination,
+          notifyMaxBytes,
+          notifySequence,
+          std::move(notify));
+    } else {
+      notify(std::move(nextPages), notifySequence);
+    }
+  }
+  if (moveMore) {
+    movePages(taskId, destination);
+  }
+}
+
+} // namespace facebook::presto
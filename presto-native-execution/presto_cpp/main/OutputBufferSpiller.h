@@ -0,0 +1,176 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <folly/Executor.h>
+#include <array>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+
+#include "presto_cpp/main/ExchangeSpillFile.h"
+#include "velox/exec/PartitionedOutputBufferManager.h"
+
+namespace facebook::presto {
+
+/// Offloads the pages of the output buffers whose consumers are slow or gone
+/// to local disk, so that the producing tasks keep running instead of waiting
+/// for the memory of the unfetched pages. Once the node memory usage reaches
+/// the limit, the destinations not fetched from for a while are spilled. The
+/// spiller is then the only reader of a spilled destination in the output
+/// buffer: it moves the pages to disk, acknowledging them so that the buffer
+/// frees their memory, and serves the consumer from disk until the consumer
+/// catches up with the buffer. Only the destinations fetched through
+/// getData() are spilled, the pushed and the in-process ones are not.
+///
+/// The destinations are sharded by task and each has its own lock, so the
+/// spill file I/O of one destination does not block the others. The pages
+/// are written on 'executor', not on the producer threads. A destination
+/// whose spill file fails to write stops moving pages and is not spilled
+/// again, the pages not written are served from the output buffer.
+class OutputBufferSpiller
+    : public std::enable_shared_from_this<OutputBufferSpiller> {
+ public:
+  struct Options {
+    /// The directory of the spill files. Empty disables spilling.
+    std::string spillPath;
+    /// The node memory usage in percent of its capacity to spill at.
+    double memoryPct{90};
+    /// The time since the last request of a consumer to spill after.
+    std::chrono::milliseconds minIdle{5'000};
+    /// The spilled bytes of a destination to stop moving its pages at.
+    int64_t maxBytesPerDestination{1L << 30};
+  };
+
+  /// Moves and writes the pages on 'executor'.
+  OutputBufferSpiller(
+      std::shared_ptr<velox::exec::PartitionedOutputBufferManager>
+          bufferManager,
+      folly::Executor* executor,
+      Options options);
+
+  /// Same as PartitionedOutputBufferManager::getData() but serves the spilled
+  /// destinations from disk.
+  bool getData(
+      const std::string& taskId,
+      int destination,
+      uint64_t maxBytes,
+      int64_t sequence,
+      velox::exec::DataAvailableCallback notify);
+
+  void
+  acknowledge(const std::string& taskId, int destination, int64_t sequence);
+
+  void deleteResults(const std::string& taskId, int destination);
+
+  /// Drops the spilled pages of the destinations of 'taskId'.
+  void removeTask(const std::string& taskId);
+
+  /// Starts spilling the idle destinations if 'memoryPct' is at the limit.
+  /// Returns the number of the destinations started.
+  size_t maybeSpill(double memoryPct);
+
+  size_t numSpilledDestinations() const;
+
+ private:
+  struct Destination {
+    std::mutex mutex;
+    // The time of the last consumer request.
+    uint64_t lastRequestMs{0};
+    // The sequence of the first page not acknowledged by the consumer.
+    int64_t sequence{0};
+    // Set while spilled.
+    std::unique_ptr<ExchangeSpillFile> file;
+    // The pages sent to the consumer and not acknowledged, from 'sequence',
+    // followed by the ones in 'file'.
+    std::deque<std::unique_ptr<folly::IOBuf>> sentPages;
+    // The sequence of the next page to move from the output buffer.
+    int64_t nextSequence{0};
+    // True if the end marker is moved.
+    bool atEnd{false};
+    // True while reading from the output buffer and writing the pages read.
+    bool moving{false};
+    // True once a write of 'file' failed.
+    bool writeFailed{false};
+    // A consumer request waiting for the pages being moved.
+    velox::exec::DataAvailableCallback pendingNotify;
+    uint64_t pendingMaxBytes{0};
+  };
+
+  using TaskDestinations = std::unordered_map<
+      std::string,
+      std::unordered_map<int, std::shared_ptr<Destination>>>;
+
+  struct Shard {
+    // Guards the map, not the destinations.
+    mutable std::mutex mutex;
+    TaskDestinations destinations;
+  };
+
+  static constexpr size_t kNumShards{16};
+
+  Shard& shard(const std::string& taskId) {
+    return shards_[std::hash<std::string>{}(taskId) % kNumShards];
+  }
+
+  // Returns the state of 'destination' of 'taskId' or nullptr if not found.
+  std::shared_ptr<Destination> find(
+      const std::string& taskId,
+      int destination);
+
+  std::shared_ptr<Destination> findOrCreate(
+      const std::string& taskId,
+      int destination);
+
+  struct DestinationRef {
+    std::string taskId;
+    int destination;
+    std::shared_ptr<Destination> state;
+  };
+
+  // Returns the states of all the destinations.
+  std::vector<DestinationRef> allDestinations() const;
+
+  // Drops the pages before 'sequence'.
+  static void acknowledgeLocked(Destination& state, int64_t sequence);
+
+  // Returns the pages from 'sequence' up to 'maxBytes', at least one, and the
+  // end marker if all are returned.
+  static std::vector<std::unique_ptr<folly::IOBuf>> nextPagesLocked(
+      Destination& state,
+      uint64_t maxBytes);
+
+  // Reads the next pages of a spilled destination from the output buffer.
+  void movePages(const std::string& taskId, int destination);
+
+  // Spills the 'pages' from 'sequence' read by movePages(). Runs on
+  // 'executor_'.
+  void spillPages(
+      const std::string& taskId,
+      int destination,
+      std::vector<std::unique_ptr<folly::IOBuf>> pages,
+      int64_t sequence);
+
+  const std::shared_ptr<velox::exec::PartitionedOutputBufferManager>
+      bufferManager_;
+  folly::Executor* const executor_;
+  const Options options_;
+
+  // The consumer positions of the fetched destinations by task and
+  // destination.
+  std::array<Shard, kNumShards> shards_;
+};
+
+} // namespace facebook::presto
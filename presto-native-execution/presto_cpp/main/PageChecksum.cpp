@@ -0,0 +1,141 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/PageChecksum.h"
+
+#include <folly/hash/Checksum.h>
+#include <folly/hash/Hash.h>
+#include <folly/io/Cursor.h>
+
+#include <array>
+#include <mutex>
+
+#include "velox/common/base/Exceptions.h"
+
+namespace facebook::presto {
+namespace {
+
+// The layout of a serialized presto page header: int32 position count, int8
+// codec markers, int32 uncompressed size, int32 size and int64 checksum.
+constexpr size_t kCodecMarkersOffset{4};
+constexpr size_t kChecksumOffset{13};
+constexpr size_t kHeaderBytes{21};
+constexpr uint8_t kChecksumBitMask{4};
+
+struct PageHeader {
+  int32_t numRows;
+  uint8_t codecMarkers;
+  int32_t uncompressedSize;
+  int32_t size;
+  int64_t checksum;
+};
+
+PageHeader readHeader(folly::io::Cursor& cursor) {
+  VELOX_CHECK(
+      cursor.canAdvance(kHeaderBytes), "Truncated serialized page header");
+  PageHeader header;
+  header.numRows = cursor.readLE<int32_t>();
+  header.codecMarkers = cursor.read<uint8_t>();
+  header.uncompressedSize = cursor.readLE<int32_t>();
+  header.size = cursor.readLE<int32_t>();
+  header.checksum = cursor.readLE<int64_t>();
+  VELOX_CHECK_GE(header.size, 0, "Invalid serialized page size");
+  return header;
+}
+
+template <typename T>
+uint32_t updateCrc(uint32_t crc, T value) {
+  static_assert(folly::kIsLittleEndian);
+  return folly::crc32(
+      reinterpret_cast<const uint8_t*>(&value), sizeof(T), crc);
+}
+
+// Returns the checksum of the page with 'header' whose payload starts at
+// 'payload', and advances 'payload' past it.
+int64_t checksum(const PageHeader& header, folly::io::Cursor& payload) {
+  uint32_t crc = ~0U;
+  size_t remaining = header.size;
+  while (remaining > 0) {
+    const auto bytes = payload.peekBytes();
+    VELOX_CHECK(!bytes.empty(), "Truncated serialized page");
+    const auto size = std::min(remaining, bytes.size());
+    crc = folly::crc32(bytes.data(), size, crc);
+    payload.skip(size);
+    remaining -= size;
+  }
+  crc = updateCrc(crc, header.codecMarkers);
+  crc = updateCrc(crc, header.numRows);
+  crc = updateCrc(crc, header.uncompressedSize);
+  return ~crc;
+}
+
+// Writes the codec markers and checksum of the page header at 'cursor' and
+// advances 'cursor' past the header.
+void writeHeader(
+    folly::io::RWPrivateCursor& cursor,
+    uint8_t codecMarkers,
+    int64_t checksum) {
+  cursor.skip(kCodecMarkersOffset);
+  cursor.write<uint8_t>(codecMarkers);
+  cursor.skip(kChecksumOffset - kCodecMarkersOffset - 1);
+  cursor.writeLE<int64_t>(checksum);
+}
+
+std::mutex& pageMutex(const folly::IOBuf& page) {
+  static std::array<std::mutex, 64> mutexes;
+  return mutexes
+      [folly::hash::twang_mix64(reinterpret_cast<uintptr_t>(page.data())) %
+       mutexes.size()];
+}
+} // namespace
+
+int64_t computePageChecksum(const folly::IOBuf& page) {
+  folly::io::Cursor cursor(&page);
+  const auto header = readHeader(cursor);
+  return checksum(header, cursor);
+}
+
+void setPageChecksum(folly::IOBuf& page) {
+  std::lock_guard<std::mutex> l(pageMutex(page));
+  folly::io::Cursor cursor(&page);
+  auto header = readHeader(cursor);
+  if (header.codecMarkers & kChecksumBitMask) {
+    return;
+  }
+  header.codecMarkers |= kChecksumBitMask;
+  folly::io::RWPrivateCursor writer(&page);
+  writeHeader(writer, header.codecMarkers, checksum(header, cursor));
+}
+
+void verifyPageChecksums(folly::IOBuf& pages, std::string_view source) {
+  folly::io::Cursor cursor(&pages);
+  folly::io::RWPrivateCursor writer(&pages);
+  while (!cursor.isAtEnd()) {
+    const auto header = readHeader(cursor);
+    if (!(header.codecMarkers & kChecksumBitMask)) {
+      cursor.skip(header.size);
+      writer.skip(kHeaderBytes + header.size);
+      continue;
+    }
+    const auto actual = checksum(header, cursor);
+    VELOX_CHECK_EQ(
+        header.checksum,
+        actual,
+        "Received corrupted serialized page from {}",
+        source);
+    writeHeader(writer, header.codecMarkers & ~kChecksumBitMask, 0);
+    writer.skip(header.size);
+  }
+}
+
+} // namespace facebook::presto
@@ -0,0 +1,38 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <folly/io/IOBuf.h>
+
+namespace facebook::presto {
+
+/// Returns the checksum of the serialized page at the front of 'page': the
+/// CRC32 of its payload, codec markers, position count and uncompressed size,
+/// as computed by the Java workers. Uses the CRC instructions where the CPU
+/// has them.
+int64_t computePageChecksum(const folly::IOBuf& page);
+
+/// Sets the checksum of the serialized page 'page' and its checksum codec
+/// marker, unless already set. Writes the header in place: the page may be
+/// shared, e.g. by the destinations of a broadcast output buffer, and
+/// concurrent calls on the same page are serialized.
+void setPageChecksum(folly::IOBuf& page);
+
+/// Verifies the checksums of the serialized pages in 'pages' received from
+/// 'source'. Throws if one does not match. The verified checksums are then
+/// cleared in place so that deserializing the pages does not compute them
+/// again.
+void verifyPageChecksums(folly::IOBuf& pages, std::string_view source);
+
+} // namespace facebook::presto
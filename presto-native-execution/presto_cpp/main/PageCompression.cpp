@@ -0,0 +1,123 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/PageCompression.h"
+
+#include <folly/String.h>
+
+#include "presto_cpp/main/PrometheusStatsReporter.h"
+#include "presto_cpp/main/common/Counters.h"
+#include "velox/common/base/Exceptions.h"
+#include "velox/common/base/StatsReporter.h"
+#include "velox/common/time/Timer.h"
+
+using facebook::velox::common::CompressionKind;
+
+namespace facebook::presto {
+
+CompressionKind toPageCodec(std::string_view name) {
+  if (name == "none") {
+    return CompressionKind::CompressionKind_NONE;
+  }
+  if (name == "lz4") {
+    return CompressionKind::CompressionKind_LZ4;
+  }
+  if (name == "zstd") {
+    return CompressionKind::CompressionKind_ZSTD;
+  }
+  VELOX_USER_FAIL("Unsupported page codec: {}", name);
+}
+
+std::string_view pageCodecName(CompressionKind codec) {
+  switch (codec) {
+    case CompressionKind::CompressionKind_NONE:
+      return "none";
+    case CompressionKind::CompressionKind_LZ4:
+      return "lz4";
+    case CompressionKind::CompressionKind_ZSTD:
+      return "zstd";
+    default:
+      VELOX_UNREACHABLE(
+          "Unsupported page codec: {}", static_cast<int>(codec));
+  }
+}
+
+const std::string& acceptedPageCodecs() {
+  static const std::string kAccepted{"lz4,zstd"};
+  return kAccepted;
+}
+
+CompressionKind negotiatePageCodec(
+    CompressionKind preferred,
+    std::string_view accepted) {
+  if (preferred == CompressionKind::CompressionKind_NONE) {
+    return preferred;
+  }
+  std::vector<folly::StringPiece> names;
+  folly::split(',', accepted, names);
+  const auto preferredName = pageCodecName(preferred);
+  for (auto name : names) {
+    if (folly::trimWhitespace(name) == preferredName) {
+      return preferred;
+    }
+  }
+  return CompressionKind::CompressionKind_NONE;
+}
+
+std::unique_ptr<folly::IOBuf> compressPages(
+    const folly::IOBuf& pages,
+    CompressionKind codec) {
+  const auto uncompressedSize = pages.computeChainDataLength();
+  std::unique_ptr<folly::IOBuf> compressed;
+  uint64_t compressionTimeUs{0};
+  {
+    velox::MicrosecondTimer timer(&compressionTimeUs);
+    compressed = velox::common::compressionKindToCodec(codec)->compress(&pages);
+  }
+  static const StatsCounter compressionTime(
+      kCounterExchangePageCompressionTimeUs);
+  static const StatsCounter compressionRatio(
+      kCounterExchangePageCompressionRatio);
+  compressionTime.addValue(compressionTimeUs);
+  const auto compressedSize = compressed->computeChainDataLength();
+  compressionRatio.addHistogramValue(
+      compressedSize * 100 / std::max<uint64_t>(1, uncompressedSize));
+  if (compressedSize > uncompressedSize * (1 - kMinPageCompressionSavings)) {
+    REPORT_ADD_STAT_VALUE(kCounterExchangeNumUncompressiblePages);
+    return nullptr;
+  }
+  return compressed;
+}
+
+std::unique_ptr<folly::IOBuf> uncompressPages(
+    const folly::IOBuf& pages,
+    CompressionKind codec,
+    uint64_t uncompressedSize) {
+  std::unique_ptr<folly::IOBuf> uncompressed;
+  uint64_t decompressionTimeUs{0};
+  {
+    velox::MicrosecondTimer timer(&decompressionTimeUs);
+    uncompressed = velox::common::compressionKindToCodec(codec)->uncompress(
+        &pages, uncompressedSize);
+  }
+  static const StatsCounter decompressionTime(
+      kCounterExchangePageDecompressionTimeUs);
+  decompressionTime.addValue(decompressionTimeUs);
+  VELOX_CHECK_EQ(
+      uncompressed->computeChainDataLength(),
+      uncompressedSize,
+      "Unexpected uncompressed page size");
+  return uncompressed;
+}
+
+} // namespace facebook::presto
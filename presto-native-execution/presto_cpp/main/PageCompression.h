@@ -0,0 +1,70 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <folly/io/IOBuf.h>
+
+#include "velox/common/compression/Compression.h"
+
+namespace facebook::presto {
+
+/// The header of a data request listing the comma separated names of the
+/// codecs the consumer can decompress the pages with.
+constexpr std::string_view kPrestoAcceptPageCodecsHeader{
+    "X-Presto-Accept-Page-Codecs"};
+
+/// The header of a data response naming the codec the pages are compressed
+/// with. Absent if the pages are not compressed.
+constexpr std::string_view kPrestoPageCodecHeader{"X-Presto-Page-Codec"};
+
+/// The header of a compressed data response carrying the uncompressed size of
+/// the pages.
+constexpr std::string_view kPrestoUncompressedSizeHeader{
+    "X-Presto-Uncompressed-Size"};
+
+/// Pages are only sent compressed if compression saves at least this fraction
+/// of their size.
+constexpr double kMinPageCompressionSavings{0.1};
+
+/// Returns the page codec named 'name', i.e. 'none', 'lz4' or 'zstd'. Throws
+/// if the codec is not supported.
+velox::common::CompressionKind toPageCodec(std::string_view name);
+
+/// Returns the name of 'codec' used in the page codec headers.
+std::string_view pageCodecName(velox::common::CompressionKind codec);
+
+/// Returns the value of the accept page codecs header listing all the
+/// supported page codecs.
+const std::string& acceptedPageCodecs();
+
+/// Returns 'preferred' if it is listed in the accept page codecs header value
+/// 'accepted', otherwise CompressionKind_NONE.
+velox::common::CompressionKind negotiatePageCodec(
+    velox::common::CompressionKind preferred,
+    std::string_view accepted);
+
+/// Compresses 'pages' with 'codec'. Returns null if the compressed pages
+/// don't save at least kMinPageCompressionSavings of the size.
+std::unique_ptr<folly::IOBuf> compressPages(
+    const folly::IOBuf& pages,
+    velox::common::CompressionKind codec);
+
+/// Decompresses 'pages' compressed with 'codec' into 'uncompressedSize'
+/// bytes.
+std::unique_ptr<folly::IOBuf> uncompressPages(
+    const folly::IOBuf& pages,
+    velox::common::CompressionKind codec,
+    uint64_t uncompressedSize);
+
+} // namespace facebook::presto
@@ -15,11 +15,20 @@
 #include "presto_cpp/main/PeriodicTaskManager.h"
 #include <folly/executors/CPUThreadPoolExecutor.h>
 #include <folly/stop_watch.h>
+#include "presto_cpp/main/CacheMemoryPolicy.h"
+#include "presto_cpp/main/DriverWatchdog.h"
+#include "presto_cpp/main/FairDriverExecutor.h"
+#include "presto_cpp/main/HugePages.h"
+#include "presto_cpp/main/MemoryTrimmer.h"
 #include "presto_cpp/main/PrestoExchangeSource.h"
+#include "presto_cpp/main/QueryContextManager.h"
+#include "presto_cpp/main/SpillDirectoryCleaner.h"
 #include "presto_cpp/main/TaskManager.h"
+#include "presto_cpp/main/common/Configs.h"
 #include "presto_cpp/main/common/Counters.h"
 #include "velox/common/base/StatsReporter.h"
 #include "velox/common/caching/AsyncDataCache.h"
+#include "velox/common/caching/SsdCache.h"
 #include "velox/common/caching/SsdFile.h"
 #include "velox/common/memory/Memory.h"
 #include "velox/common/memory/MemoryAllocator.h"
@@ -28,6 +37,8 @@
 #include "velox/exec/Driver.h"
 
 #include <sys/resource.h>
+#include <set>
+#include <unordered_set>
 
 namespace facebook::presto {
 
@@ -42,19 +53,30 @@ static constexpr size_t kExchangeSourcePeriodGlobalCounters{
 static constexpr size_t kTaskPeriodCleanOldTasks{60'000'000}; // 60 seconds.
 // Every 1 minute we export cache counters.
 static constexpr size_t kCachePeriodGlobalCounters{60'000'000}; // 60 seconds.
+// Every 1 minute we update the SSD cache admission filter.
+static constexpr size_t kSsdCachePeriodAdmission{60'000'000}; // 60 seconds.
+// Every two seconds we check the memory cache against the query demand.
+static constexpr size_t kCachePeriodShrink{2'000'000}; // 2 seconds.
 static constexpr size_t kOsPeriodGlobalCounters{2'000'000}; // 2 seconds
+// Every 10 seconds we check the free space of the spill paths.
+static constexpr size_t kSpillPathPeriodRefresh{10'000'000}; // 10 seconds.
+static constexpr size_t kSpillQuotaPeriod{2'000'000}; // 2 seconds.
+// Every 10 seconds we look for the drivers stuck on their threads.
+static constexpr size_t kDriverWatchdogPeriod{10'000'000}; // 10 seconds.
+// The spill directories of the tasks gone for this long are deleted.
+static constexpr std::chrono::seconds kSpillDirectoryMinAge{600};
 
 PeriodicTaskManager::PeriodicTaskManager(
     folly::CPUThreadPoolExecutor* const driverCPUExecutor,
-    folly::IOThreadPoolExecutor* const httpExecutor,
+    std::vector<folly::IOThreadPoolExecutor*> httpExecutors,
     TaskManager* const taskManager,
     const velox::memory::MemoryAllocator* const memoryAllocator,
-    const velox::cache::AsyncDataCache* const asyncDataCache,
+    velox::cache::AsyncDataCache* const asyncDataCache,
     const std::unordered_map<
         std::string,
         std::shared_ptr<velox::connector::Connector>>& connectors)
     : driverCPUExecutor_(driverCPUExecutor),
-      httpExecutor_(httpExecutor),
+      httpExecutors_(std::move(httpExecutors)),
       taskManager_(taskManager),
       memoryAllocator_(memoryAllocator),
       asyncDataCache_(asyncDataCache),
@@ -62,23 +84,49 @@ PeriodicTaskManager::PeriodicTaskManager(
 
 void PeriodicTaskManager::start() {
   // If executors are null, don't bother starting this task.
-  if (driverCPUExecutor_ or httpExecutor_) {
+  if (driverCPUExecutor_ or !httpExecutors_.empty()) {
     addExecutorStatsTask();
   }
   if (taskManager_) {
     addTaskStatsTask();
     addTaskCleanupTask();
+    addTableCacheStatsTask();
+    if (SystemConfig::instance()->driverStuckThresholdSec() > 0) {
+      addDriverWatchdogTask();
+    }
+    if (!taskManager_->spillPaths().empty()) {
+      addSpillPathStatsTask();
+      if (SystemConfig::instance()->spillCleanupIntervalSec() > 0) {
+        addSpillDirectoryCleanupTask();
+      }
+      if (taskManager_->spillQuota().enabled()) {
+        addSpillQuotaTask();
+      }
+    }
   }
   if (memoryAllocator_) {
     addMemoryAllocatorStatsTask();
   }
+  if (SystemConfig::instance()->memoryTrimIntervalSec() > 0) {
+    addMemoryTrimTask();
+  }
   addPrestoExchangeSourceMemoryStatsTask();
   if (asyncDataCache_) {
     addAsyncDataCacheStatsTask();
+    if (taskManager_ &&
+        SystemConfig::instance()->asyncCacheProactiveShrinkEnabled()) {
+      addAsyncDataCacheShrinkTask();
+    }
+    if (asyncDataCache_->ssdCache() != nullptr &&
+        SystemConfig::instance()->asyncCacheSsdAdmissionEnabled()) {
+      addSsdCacheAdmissionTask();
+    }
   }
   addConnectorStatsTask();
   addOperatingSystemStatsTask();
 
+  cleanupScheduler_.setThreadName("TaskCleanup");
+  cleanupScheduler_.start();
   // This should be the last call in this method.
   scheduler_.start();
 }
@@ -86,11 +134,14 @@ void PeriodicTaskManager::start() {
 void PeriodicTaskManager::stop() {
   scheduler_.cancelAllFunctionsAndWait();
   scheduler_.shutdown();
+  cleanupScheduler_.cancelAllFunctionsAndWait();
+  cleanupScheduler_.shutdown();
 }
 
 void PeriodicTaskManager::addExecutorStatsTask() {
   scheduler_.addFunction(
-      [driverCPUExecutor = driverCPUExecutor_, httpExecutor = httpExecutor_]() {
+      [driverCPUExecutor = driverCPUExecutor_,
+       httpExecutors = httpExecutors_]() {
         if (driverCPUExecutor) {
           // Report the current queue size of the thread pool.
           REPORT_ADD_STAT_VALUE(
@@ -105,8 +156,9 @@ void PeriodicTaskManager::addExecutorStatsTask() {
           });
         }
 
-        if (httpExecutor) {
-          // Report the latency between scheduling the task and its execution.
+        // Report the latency between scheduling the task and its execution
+        // on the io threads of every acceptor group.
+        for (auto* httpExecutor : httpExecutors) {
           folly::stop_watch<std::chrono::milliseconds> timer;
           httpExecutor->add([timer = timer]() {
             REPORT_ADD_STAT_VALUE(
@@ -116,11 +168,44 @@ void PeriodicTaskManager::addExecutorStatsTask() {
       },
       std::chrono::microseconds{kTaskPeriodGlobalCounters},
       "executor_counters");
+
+  if (auto* fairExecutor = fairDriverExecutor()) {
+    std::vector<std::string> metricNames;
+    for (int32_t level = 0; level < FairDriverExecutor::kNumLevels; ++level) {
+      metricNames.push_back(fmt::format(
+          kCounterDriverCPUExecutorLevelLatencyMsFormat, level));
+      REPORT_ADD_STAT_EXPORT_TYPE(
+          metricNames.back(), facebook::velox::StatType::AVG);
+    }
+    scheduler_.addFunction(
+        [fairExecutor,
+         metricNames = std::move(metricNames),
+         lastStats = fairExecutor->levelStats()]() mutable {
+          // Reports the average latency of the tasks since the last run.
+          const auto stats = fairExecutor->levelStats();
+          for (int32_t level = 0; level < FairDriverExecutor::kNumLevels;
+               ++level) {
+            const auto numTasks =
+                stats[level].numTasks - lastStats[level].numTasks;
+            if (numTasks > 0) {
+              REPORT_ADD_STAT_VALUE(
+                  metricNames[level],
+                  (stats[level].queuedMicros -
+                   lastStats[level].queuedMicros) /
+                      numTasks / 1'000);
+            }
+          }
+          lastStats = stats;
+        },
+        std::chrono::microseconds{kTaskPeriodGlobalCounters},
+        "fair_driver_executor_counters");
+  }
 }
 
 void PeriodicTaskManager::addTaskStatsTask() {
   scheduler_.addFunction(
-      [taskManager = taskManager_]() {
+      [taskManager = taskManager_,
+       exportedReasons = std::unordered_set<std::string>()]() mutable {
         // Report the number of tasks and drivers in the system.
         size_t numTasks{0};
         auto taskNumbers = taskManager->getTaskNumbers(numTasks);
@@ -146,6 +231,21 @@ void PeriodicTaskManager::addTaskStatsTask() {
             kCounterNumRunningDrivers, driverCountStats.numRunningDrivers);
         REPORT_ADD_STAT_VALUE(
             kCounterNumBlockedDrivers, driverCountStats.numBlockedDrivers);
+        // The reasons seen before are reported as 0 when no driver is blocked
+        // for them.
+        auto blockedCounts = taskManager->getBlockedDriverCounts();
+        for (const auto& reason : exportedReasons) {
+          blockedCounts.emplace(reason, 0);
+        }
+        for (const auto& [reason, numDrivers] : blockedCounts) {
+          const auto metricName =
+              fmt::format(kCounterNumBlockedDriversFormat, reason);
+          if (exportedReasons.insert(reason).second) {
+            REPORT_ADD_STAT_EXPORT_TYPE(
+                metricName, facebook::velox::StatType::AVG);
+          }
+          REPORT_ADD_STAT_VALUE(metricName, numDrivers);
+        }
         REPORT_ADD_STAT_VALUE(
             kCounterTotalPartitionedOutputBuffer,
             velox::exec::PartitionedOutputBufferManager::getInstance()
@@ -157,7 +257,7 @@ void PeriodicTaskManager::addTaskStatsTask() {
 }
 
 void PeriodicTaskManager::addTaskCleanupTask() {
-  scheduler_.addFunction(
+  cleanupScheduler_.addFunction(
       [taskManager = taskManager_]() {
         // Report the number of tasks and drivers in the system.
         taskManager->cleanOldTasks();
@@ -166,6 +266,43 @@ void PeriodicTaskManager::addTaskCleanupTask() {
       "clean_old_tasks");
 }
 
+void PeriodicTaskManager::addDriverWatchdogTask() {
+  const std::chrono::seconds threshold{
+      SystemConfig::instance()->driverStuckThresholdSec()};
+  const bool cancel = SystemConfig::instance()->driverStuckCancelEnabled();
+  scheduler_.addFunction(
+      [taskManager = taskManager_,
+       threshold,
+       cancel,
+       reported = std::set<std::pair<int32_t, uint64_t>>()]() mutable {
+        auto stuck = DriverWatchdog::stuckDrivers(threshold);
+        REPORT_ADD_STAT_VALUE(kCounterNumStuckDrivers, stuck.size());
+        // Each run of a driver is logged and cancelled once, when first found
+        // stuck.
+        std::set<std::pair<int32_t, uint64_t>> current;
+        for (auto& driver : stuck) {
+          const auto key = std::make_pair(driver.threadId, driver.startMs);
+          current.insert(key);
+          if (reported.count(key) > 0) {
+            continue;
+          }
+          driver.stack = DriverWatchdog::captureStack(driver.threadId);
+          LOG(WARNING) << "Stuck " << driver.toString();
+          if (cancel) {
+            taskManager->failQueryTasks(
+                driver.queryId,
+                fmt::format(
+                    "Query {} has a driver stuck on its thread for {} ms",
+                    driver.queryId,
+                    driver.onThreadMs));
+          }
+        }
+        reported = std::move(current);
+      },
+      std::chrono::microseconds{kDriverWatchdogPeriod},
+      "driver_watchdog");
+}
+
 void PeriodicTaskManager::addMemoryAllocatorStatsTask() {
   scheduler_.addFunction(
       [allocator = memoryAllocator_]() {
@@ -180,12 +317,26 @@ void PeriodicTaskManager::addMemoryAllocatorStatsTask() {
               kCounterMappedMemoryRawAllocBytesSmall,
               (mmapAllocator->numMallocBytes()))
         }
+        REPORT_ADD_STAT_VALUE(kCounterAnonHugePageBytes, anonHugePageBytes());
         // TODO(xiaoxmeng): add memory allocation size stats.
       },
       std::chrono::microseconds{kMemoryPeriodGlobalCounters},
       "mmap_memory_counters");
 }
 
+void PeriodicTaskManager::addMemoryTrimTask() {
+  scheduler_.addFunction(
+      []() {
+        // Leaves the cache alone, its entries are reused by the queries.
+        const auto stats = trimMemory();
+        REPORT_ADD_STAT_VALUE(kCounterNumMemoryTrims, 1);
+        REPORT_ADD_STAT_VALUE(
+            kCounterMemoryTrimReleasedBytes, stats.releasedBytes());
+      },
+      std::chrono::seconds{SystemConfig::instance()->memoryTrimIntervalSec()},
+      "memory_trim");
+}
+
 void PeriodicTaskManager::addPrestoExchangeSourceMemoryStatsTask() {
   scheduler_.addFunction(
       []() {
@@ -204,7 +355,8 @@ void PeriodicTaskManager::addPrestoExchangeSourceMemoryStatsTask() {
 
 void PeriodicTaskManager::addAsyncDataCacheStatsTask() {
   scheduler_.addFunction(
-      [asyncDataCache = asyncDataCache_]() {
+      [asyncDataCache = asyncDataCache_,
+       ssdCapacityBytes = SystemConfig::instance()->asyncCacheSsdGb() << 30]() {
         const auto memoryCacheStats = asyncDataCache->refreshStats();
 
         // Snapshots.
@@ -338,12 +490,211 @@ void PeriodicTaskManager::addAsyncDataCacheStatsTask() {
           REPORT_ADD_STAT_VALUE(
               kCounterSsdCacheCumulativeCachedBytes,
               memoryCacheStats.ssdStats->bytesCached);
+          if (ssdCapacityBytes > 0) {
+            REPORT_ADD_STAT_VALUE(
+                kCounterSsdCacheFillPct,
+                memoryCacheStats.ssdStats->bytesCached * 100 /
+                    ssdCapacityBytes);
+          }
         }
       },
       std::chrono::microseconds{kCachePeriodGlobalCounters},
       "cache_counters");
 }
 
+void PeriodicTaskManager::addAsyncDataCacheShrinkTask() {
+  const auto* systemConfig = SystemConfig::instance();
+  const int64_t capacityBytes = NodeConfig::instance()->nodeMemoryGb([&]() {
+    return systemConfig->systemMemoryGb();
+  }) << 30;
+  const int64_t ceilingGb = systemConfig->asyncCacheCeilingGb();
+  const int64_t floorBytes = systemConfig->asyncCacheFloorGb() << 30;
+  auto policy = std::make_shared<CacheMemoryPolicy>(
+      capacityBytes,
+      floorBytes,
+      ceilingGb == 0 ? capacityBytes : ceilingGb << 30);
+  scheduler_.addFunction(
+      [asyncDataCache = asyncDataCache_,
+       taskManager = taskManager_,
+       policy = std::move(policy),
+       floorBytes]() {
+        int64_t queryBytes{0};
+        taskManager->getQueryContextManager()->visitAllContexts(
+            [&](const protocol::QueryId& /*queryId*/,
+                const velox::core::QueryCtx* queryCtx) {
+              queryBytes += queryCtx->pool()->getCurrentBytes();
+            });
+        const auto targetBytes = policy->update(queryBytes);
+        REPORT_ADD_STAT_VALUE(kCounterMemoryCacheTargetBytes, targetBytes);
+
+        // Only the excess is evicted, the floor stays cached.
+        const int64_t droppedBytes = shrinkAsyncDataCache(
+            *asyncDataCache, std::max(targetBytes, floorBytes));
+        if (droppedBytes == 0) {
+          return;
+        }
+        REPORT_ADD_STAT_VALUE(kCounterMemoryCacheNumProactiveShrinks, 1);
+        REPORT_ADD_STAT_VALUE(
+            kCounterMemoryCacheProactiveShrinkBytes, droppedBytes);
+        LOG(INFO) << "Dropped " << droppedBytes
+                  << " bytes from the memory cache ahead of " << queryBytes
+                  << " bytes of query memory, target " << targetBytes
+                  << " bytes";
+      },
+      std::chrono::microseconds{kCachePeriodShrink},
+      "cache_shrink");
+}
+
+void PeriodicTaskManager::addTableCacheStatsTask() {
+  // The counters of up to this many tables are exported per period.
+  static constexpr size_t kMaxTablesReported{10};
+  // The stats reporter keeps the metrics of a table for the life of the
+  // worker, so the counters of at most this many distinct tables are
+  // exported. The other tables are only served on /v1/cache/tables.
+  static constexpr size_t kMaxTablesExported{100};
+  scheduler_.addFunction(
+      [taskManager = taskManager_,
+       exportedTables = std::unordered_set<std::string>()]() mutable {
+        const auto tables =
+            taskManager->tableCacheStats().topTables(kMaxTablesReported);
+        for (const auto& [table, stats] : tables) {
+          const bool exported = exportedTables.count(table) > 0;
+          if (!exported && exportedTables.size() >= kMaxTablesExported) {
+            continue;
+          }
+          const auto readBytesMetricName =
+              fmt::format(kCounterTableCacheReadBytesFormat, table);
+          const auto hitPctMetricName =
+              fmt::format(kCounterTableCacheHitPctFormat, table);
+          // Exporting metrics types here since the metrics key is dynamic
+          if (!exported) {
+            exportedTables.insert(table);
+            REPORT_ADD_STAT_EXPORT_TYPE(
+                readBytesMetricName, facebook::velox::StatType::AVG);
+            REPORT_ADD_STAT_EXPORT_TYPE(
+                hitPctMetricName, facebook::velox::StatType::AVG);
+          }
+          REPORT_ADD_STAT_VALUE(readBytesMetricName, stats.totalBytes());
+          REPORT_ADD_STAT_VALUE(hitPctMetricName, stats.hitPct());
+        }
+      },
+      std::chrono::microseconds{kCachePeriodGlobalCounters},
+      "table_cache_counters");
+}
+
+void PeriodicTaskManager::addSpillPathStatsTask() {
+  scheduler_.addFunction(
+      [taskManager = taskManager_,
+       numAssignedOld = std::vector<uint64_t>()]() mutable {
+        auto& spillPaths = taskManager->spillPaths();
+        spillPaths.refresh();
+        const auto stats = spillPaths.stats();
+        const bool exportTypes = numAssignedOld.empty();
+        numAssignedOld.resize(stats.size());
+        for (size_t i = 0; i < stats.size(); ++i) {
+          // The paths are numbered in the order of the config.
+          const auto freeBytesMetricName =
+              fmt::format(kCounterSpillPathFreeBytesFormat, i);
+          const auto numTasksMetricName =
+              fmt::format(kCounterSpillPathNumTasksFormat, i);
+          const auto healthyMetricName =
+              fmt::format(kCounterSpillPathHealthyFormat, i);
+          // Exporting metrics types here since the metrics key is dynamic
+          if (exportTypes) {
+            REPORT_ADD_STAT_EXPORT_TYPE(
+                freeBytesMetricName, facebook::velox::StatType::AVG);
+            REPORT_ADD_STAT_EXPORT_TYPE(
+                numTasksMetricName, facebook::velox::StatType::SUM);
+            REPORT_ADD_STAT_EXPORT_TYPE(
+                healthyMetricName, facebook::velox::StatType::AVG);
+          }
+          REPORT_ADD_STAT_VALUE(freeBytesMetricName, stats[i].freeBytes);
+          REPORT_ADD_STAT_VALUE(
+              numTasksMetricName, stats[i].numAssigned - numAssignedOld[i]);
+          REPORT_ADD_STAT_VALUE(healthyMetricName, stats[i].healthy ? 1 : 0);
+          numAssignedOld[i] = stats[i].numAssigned;
+        }
+      },
+      std::chrono::microseconds{kSpillPathPeriodRefresh},
+      "spill_path_counters");
+}
+
+void PeriodicTaskManager::addSpillDirectoryCleanupTask() {
+  scheduler_.addFunction(
+      [taskManager = taskManager_,
+       running = std::make_shared<std::atomic_bool>(false)]() {
+        // Skips a round while the previous one still deletes.
+        if (running->exchange(true)) {
+          return;
+        }
+        // The tasks created after this snapshot have recent directories.
+        std::unordered_set<std::string> liveTaskIds;
+        for (const auto& [taskId, prestoTask] : taskManager->tasks()) {
+          liveTaskIds.insert(taskId);
+        }
+        std::vector<std::string> paths;
+        for (const auto& stats : taskManager->spillPaths().stats()) {
+          paths.push_back(stats.path);
+        }
+        auto cleanup = [paths = std::move(paths),
+                        liveTaskIds = std::move(liveTaskIds),
+                        running]() {
+          SpillCleanupStats total;
+          for (const auto& path : paths) {
+            const auto stats = cleanupSpillDirectories(
+                path,
+                [&](const std::string& taskId) {
+                  return liveTaskIds.count(taskId) > 0;
+                },
+                kSpillDirectoryMinAge);
+            total.numDirectories += stats.numDirectories;
+            total.bytes += stats.bytes;
+          }
+          REPORT_ADD_STAT_VALUE(
+              kCounterNumSpillCleanupDirectories, total.numDirectories);
+          REPORT_ADD_STAT_VALUE(
+              kCounterSpillCleanupReclaimedBytes, total.bytes);
+          *running = false;
+        };
+        // Deletes on the spill executor, off the scheduler thread.
+        if (auto* spillExecutor = spillExecutorPtr()) {
+          spillExecutor->add(std::move(cleanup));
+        } else {
+          cleanup();
+        }
+      },
+      std::chrono::seconds{SystemConfig::instance()->spillCleanupIntervalSec()},
+      "spill_directory_cleanup");
+}
+
+void PeriodicTaskManager::addSpillQuotaTask() {
+  scheduler_.addFunction(
+      [taskManager = taskManager_]() {
+        const auto numFailed = taskManager->enforceSpillQuota();
+        REPORT_ADD_STAT_VALUE(
+            kCounterSpilledBytes, taskManager->spillQuota().nodeBytes());
+        REPORT_ADD_STAT_VALUE(kCounterNumSpillLimitFailedTasks, numFailed);
+      },
+      std::chrono::microseconds{kSpillQuotaPeriod},
+      "spill_quota");
+}
+
+void PeriodicTaskManager::addSsdCacheAdmissionTask() {
+  const auto decayPct =
+      SystemConfig::instance()->asyncCacheSsdAdmissionDecayPct();
+  LOG(INFO) << "STARTUP: SSD cache admission filter with " << decayPct
+            << "% decay";
+  scheduler_.addFunction(
+      [ssdCache = asyncDataCache_->ssdCache(), decayPct]() {
+        // Selects the file groups and columns with the most reads per byte
+        // that fit in the SSD cache. The references are recorded by the
+        // cached reads of the connectors.
+        ssdCache->groupStats().updateSsdFilter(ssdCache->maxBytes(), decayPct);
+      },
+      std::chrono::microseconds{kSsdCachePeriodAdmission},
+      "ssd_cache_admission");
+}
+
 void PeriodicTaskManager::addConnectorStatsTask() {
   for (auto itr : connectors_) {
     static std::unordered_map<std::string, int64_t> oldValues;
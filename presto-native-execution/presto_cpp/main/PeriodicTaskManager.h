@@ -14,6 +14,7 @@
 #pragma once
 
 #include <folly/experimental/FunctionScheduler.h>
+#include <vector>
 #include "velox/common/memory/Memory.h"
 
 namespace folly {
@@ -40,10 +41,10 @@ class PeriodicTaskManager {
  public:
   explicit PeriodicTaskManager(
       folly::CPUThreadPoolExecutor* const driverCPUExecutor,
-      folly::IOThreadPoolExecutor* const httpExecutor,
+      std::vector<folly::IOThreadPoolExecutor*> httpExecutors,
       TaskManager* const taskManager,
       const velox::memory::MemoryAllocator* const memoryAllocator,
-      const velox::cache::AsyncDataCache* const asyncDataCache,
+      velox::cache::AsyncDataCache* const asyncDataCache,
       const std::unordered_map<
           std::string,
           std::shared_ptr<velox::connector::Connector>>& connectors);
@@ -74,18 +75,29 @@ class PeriodicTaskManager {
   void addExecutorStatsTask();
   void addTaskStatsTask();
   void addTaskCleanupTask();
+  void addDriverWatchdogTask();
+  void addTableCacheStatsTask();
+  void addSpillPathStatsTask();
+  void addSpillDirectoryCleanupTask();
+  void addSpillQuotaTask();
   void addMemoryAllocatorStatsTask();
+  void addMemoryTrimTask();
   void addPrestoExchangeSourceMemoryStatsTask();
   void addAsyncDataCacheStatsTask();
+  void addAsyncDataCacheShrinkTask();
+  void addSsdCacheAdmissionTask();
   void addConnectorStatsTask();
   void addOperatingSystemStatsTask();
 
   folly::FunctionScheduler scheduler_;
+  // Runs the task cleanup, which the stats tasks on 'scheduler_' would delay.
+  folly::FunctionScheduler cleanupScheduler_;
   folly::CPUThreadPoolExecutor* const driverCPUExecutor_;
-  folly::IOThreadPoolExecutor* const httpExecutor_;
+  // The io threads of each acceptor group of the http server.
+  const std::vector<folly::IOThreadPoolExecutor*> httpExecutors_;
   TaskManager* const taskManager_;
   const velox::memory::MemoryAllocator* const memoryAllocator_;
-  const velox::cache::AsyncDataCache* const asyncDataCache_;
+  velox::cache::AsyncDataCache* const asyncDataCache_;
   const std::unordered_map<
       std::string,
       std::shared_ptr<velox::connector::Connector>>& connectors_;
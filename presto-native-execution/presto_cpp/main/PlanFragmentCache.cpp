@@ -0,0 +1,75 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/PlanFragmentCache.h"
+#include "presto_cpp/external/xxh3.h"
+#include "presto_cpp/main/common/Counters.h"
+#include "velox/common/base/StatsReporter.h"
+
+namespace facebook::presto {
+
+velox::core::PlanFragment PlanFragmentCache::getOrConvert(
+    std::string_view fragment,
+    std::string_view tableWriteInfo,
+    const std::function<velox::core::PlanFragment(bool& shareable)>&
+        convert) {
+  const uint64_t hash = XXH3_64bits_withSeed(
+      tableWriteInfo.data(),
+      tableWriteInfo.size(),
+      XXH3_64bits(fragment.data(), fragment.size()));
+  if (maxEntries_ > 0) {
+    std::lock_guard<std::mutex> l(mutex_);
+    auto it = entries_.find(hash);
+    if (it != entries_.end() && it->second.fragment == fragment &&
+        it->second.tableWriteInfo == tableWriteInfo) {
+      lru_.splice(lru_.begin(), lru_, it->second.lruPosition);
+      REPORT_ADD_STAT_VALUE(kCounterNumPlanFragmentCacheHits);
+      return it->second.plan;
+    }
+  }
+
+  // Converts outside of the lock. The concurrent misses for the same plan
+  // fragment all convert it.
+  REPORT_ADD_STAT_VALUE(kCounterNumPlanFragmentCacheMisses);
+  bool shareable = true;
+  auto plan = convert(shareable);
+  if (maxEntries_ == 0 || !shareable) {
+    return plan;
+  }
+
+  std::lock_guard<std::mutex> l(mutex_);
+  auto it = entries_.find(hash);
+  if (it != entries_.end()) {
+    // Converted concurrently or a different plan fragment with the same hash.
+    it->second.fragment = fragment;
+    it->second.tableWriteInfo = tableWriteInfo;
+    it->second.plan = plan;
+    lru_.splice(lru_.begin(), lru_, it->second.lruPosition);
+    return plan;
+  }
+  if (entries_.size() >= maxEntries_) {
+    entries_.erase(lru_.back());
+    lru_.pop_back();
+  }
+  lru_.push_front(hash);
+  entries_.emplace(
+      hash,
+      Entry{
+          std::string(fragment),
+          std::string(tableWriteInfo),
+          plan,
+          lru_.begin()});
+  return plan;
+}
+
+} // namespace facebook::presto
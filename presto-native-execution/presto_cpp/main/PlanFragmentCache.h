@@ -0,0 +1,73 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <functional>
+#include <list>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+
+#include "velox/core/PlanFragment.h"
+
+namespace facebook::presto {
+
+/// A bounded LRU cache of the Velox plan fragments converted from the
+/// serialized Presto plan fragments. The tasks of a stage running on the same
+/// worker are sent the same plan fragment, so all but the first of them share
+/// its converted plan instead of converting it again. The converted plan nodes
+/// are immutable and safe to share among the tasks.
+class PlanFragmentCache {
+ public:
+  /// Caches up to 'maxEntries' plans. Caches nothing if 'maxEntries' is 0.
+  explicit PlanFragmentCache(size_t maxEntries) : maxEntries_(maxEntries) {}
+
+  /// Returns the plan converted from the serialized plan fragment 'fragment'
+  /// with the serialized table write info 'tableWriteInfo', empty if none. The
+  /// lookup hashes both in place, they are only copied when a plan is cached.
+  /// On a miss, calls 'convert' which returns the converted plan and sets
+  /// 'shareable' to false if the plan is specific to the task it was
+  /// converted for, in which case the plan is not cached.
+  velox::core::PlanFragment getOrConvert(
+      std::string_view fragment,
+      std::string_view tableWriteInfo,
+      const std::function<velox::core::PlanFragment(bool& shareable)>&
+          convert);
+
+  size_t size() const {
+    std::lock_guard<std::mutex> l(mutex_);
+    return entries_.size();
+  }
+
+ private:
+  struct Entry {
+    // The serialized plan fragment and table write info to tell apart the
+    // fragments with the same hash.
+    std::string fragment;
+    std::string tableWriteInfo;
+    velox::core::PlanFragment plan;
+    std::list<uint64_t>::iterator lruPosition;
+  };
+
+  const size_t maxEntries_;
+
+  mutable std::mutex mutex_;
+  // The cached plans keyed by the hashes of their serialized plan fragments
+  // and table write infos.
+  std::unordered_map<uint64_t, Entry> entries_;
+  // The hashes of the cached plans, the most recently used first.
+  std::list<uint64_t> lru_;
+};
+
+} // namespace facebook::presto
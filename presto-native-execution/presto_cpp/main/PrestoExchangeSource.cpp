@@ -14,15 +14,28 @@
 #include "presto_cpp/main/PrestoExchangeSource.h"
 
 #include <fmt/core.h>
+#include <folly/ScopeGuard.h>
 #include <folly/SocketAddress.h>
+#include <folly/executors/CPUThreadPoolExecutor.h>
+#include <folly/executors/thread_factory/NamedThreadFactory.h>
+#include <folly/io/Cursor.h>
 #include <re2/re2.h>
 #include <sstream>
 
+#include "presto_cpp/main/LatencyPercentile.h"
+#include "presto_cpp/main/PageChecksum.h"
+#include "presto_cpp/main/PageCompression.h"
+#include "presto_cpp/main/PrometheusStatsReporter.h"
+#include "presto_cpp/main/PushExchange.h"
 #include "presto_cpp/main/QueryContextManager.h"
+#include "presto_cpp/main/Tracer.h"
+#include "presto_cpp/main/common/Configs.h"
 #include "presto_cpp/main/common/Counters.h"
+#include "presto_cpp/main/http/HttpServer.h"
 #include "presto_cpp/presto_protocol/presto_protocol.h"
 #include "velox/common/base/Exceptions.h"
 #include "velox/common/base/StatsReporter.h"
+#include "velox/common/time/Timer.h"
 #include "velox/exec/Operator.h"
 
 using namespace facebook::velox;
@@ -50,28 +63,377 @@ void onFinalFailure(
 
   queue->setError(errorMessage);
 }
+
+// The delay before retrying a data request deferred because the node-wide
+// queued memory budget is exceeded.
+constexpr std::chrono::milliseconds kThrottledRequestDelay{10};
+
+// The max number of times a push response waits 'kThrottledRequestDelay' for
+// the consumer to free up credits before granting none. The producer then
+// immediately waits again with an empty push.
+constexpr int kMaxPushCreditWaits{100};
+
+// The number of data requests not accepting compressed pages after the
+// upstream worker sent uncompressed ones to a request which accepted them.
+constexpr int32_t kCompressionProbeInterval{16};
+
+// The layout of a serialized presto page header: int32 position count, int8
+// codec markers, int32 uncompressed size, int32 size and int64 checksum.
+constexpr size_t kSerializedPageSizeOffset{9};
+constexpr size_t kSerializedPageHeaderBytes{21};
+
+// Returns the latencies of the non-empty data responses of all the exchange
+// sources, or null if the data requests are not hedged.
+LatencyPercentile* fetchLatencies() {
+  static auto* latencies = []() -> LatencyPercentile* {
+    const auto percentile =
+        SystemConfig::instance()->exchangeHedgePercentile();
+    return percentile > 0 ? new LatencyPercentile(percentile) : nullptr;
+  }();
+  return latencies;
+}
+
+// Runs the exchange response processing on 'executor' and reports the time
+// it waits for a thread.
+class ResponseExecutor : public folly::Executor {
+ public:
+  explicit ResponseExecutor(folly::Executor* executor) : executor_(executor) {}
+
+  void add(folly::Func func) override {
+    executor_->add(
+        [func = std::move(func), startMs = getCurrentTimeMs()]() mutable {
+          static const StatsCounter queueLatency(
+              kCounterExchangeResponseQueueLatencyMs);
+          queueLatency.addHistogramValue(getCurrentTimeMs() - startMs);
+          func();
+        });
+  }
+
+ private:
+  folly::Executor* const executor_;
+};
+
+// Reports the serialized size of a data response.
+void reportPageSize(int64_t bytes) {
+  static const StatsCounter pageSize(kCounterPrestoExchangeSerializedPageSize);
+  pageSize.addHistogramValue(bytes);
+}
+
+// Frees a http response buffer to 'bufferRecycler' if set, otherwise to
+// 'pool'.
+void freeResponseBuffer(
+    void* data,
+    int64_t capacity,
+    memory::MemoryPool* pool,
+    http::HttpBufferRecycler* bufferRecycler) {
+  if (bufferRecycler != nullptr) {
+    bufferRecycler->free(data, capacity);
+  } else {
+    pool->free(data, capacity);
+  }
+}
+
+// Transfers the ownership of a memory pool allocated http response buffer to
+// an IOBuf. The backed memory is freed when the last reference to it goes
+// away, including the clones created by splitting the buffer at serialized page
+// boundaries.
+std::unique_ptr<folly::IOBuf> takePooledBuffer(
+    std::unique_ptr<folly::IOBuf> buf,
+    memory::MemoryPool* pool,
+    const std::shared_ptr<http::HttpBufferRecycler>& bufferRecycler,
+    const std::string& queryId) {
+  struct FreeContext {
+    memory::MemoryPool* pool;
+    std::shared_ptr<http::HttpBufferRecycler> bufferRecycler;
+    int64_t capacity;
+    std::string queryId;
+  };
+  const int64_t capacity = buf->capacity();
+  PrestoExchangeSource::updateMemoryUsage(capacity);
+  PrestoExchangeSource::updateQueryMemoryUsage(queryId, capacity);
+  return folly::IOBuf::takeOwnership(
+      buf->writableData(),
+      capacity,
+      buf->length(),
+      [](void* data, void* userData) {
+        auto* context = static_cast<FreeContext*>(userData);
+        freeResponseBuffer(
+            data,
+            context->capacity,
+            context->pool,
+            context->bufferRecycler.get());
+        PrestoExchangeSource::updateMemoryUsage(-context->capacity);
+        PrestoExchangeSource::updateQueryMemoryUsage(
+            context->queryId, -context->capacity);
+        delete context;
+      },
+      new FreeContext{pool, bufferRecycler, capacity, queryId});
+}
 } // namespace
 
+// Coalesces the data requests of the exchange sources which fetch from the
+// same upstream worker into the same memory pool into batched results
+// requests. At most one batched request is in flight per fetcher. The sources
+// requesting data meanwhile are fetched together by the next one, which is
+// sent as soon as the in-flight one completes.
+class BatchedResultsFetcher
+    : public std::enable_shared_from_this<BatchedResultsFetcher> {
+ public:
+  BatchedResultsFetcher(
+      std::shared_ptr<http::HttpClient> httpClient,
+      memory::MemoryPool* pool,
+      std::string queryId)
+      : httpClient_(std::move(httpClient)),
+        pool_(pool),
+        queryId_(std::move(queryId)) {}
+
+  // Returns the fetcher shared by the sources fetching from 'address' into
+  // 'pool'.
+  static std::shared_ptr<BatchedResultsFetcher> getInstance(
+      const folly::SocketAddress& address,
+      const std::shared_ptr<http::HttpClient>& httpClient,
+      memory::MemoryPool* pool,
+      const std::string& queryId) {
+    static folly::Synchronized<std::unordered_map<
+        std::string,
+        std::weak_ptr<BatchedResultsFetcher>>>
+        fetchers;
+    const auto key = fmt::format("{}:{}", address.describe(), (void*)pool);
+    auto lockedFetchers = fetchers.wlock();
+    if (auto fetcher = (*lockedFetchers)[key].lock()) {
+      return fetcher;
+    }
+    // Drop the fetchers of the gone sources.
+    for (auto it = lockedFetchers->begin(); it != lockedFetchers->end();) {
+      it = it->second.expired() ? lockedFetchers->erase(it) : std::next(it);
+    }
+    auto fetcher =
+        std::make_shared<BatchedResultsFetcher>(httpClient, pool, queryId);
+    (*lockedFetchers)[key] = fetcher;
+    return fetcher;
+  }
+
+  void request(std::shared_ptr<PrestoExchangeSource> source) {
+    std::vector<std::shared_ptr<PrestoExchangeSource>> sources;
+    {
+      std::lock_guard<std::mutex> l(mutex_);
+      pendingSources_.push_back(std::move(source));
+      if (inFlight_) {
+        return;
+      }
+      inFlight_ = true;
+      sources.swap(pendingSources_);
+    }
+    sendBatch(std::move(sources));
+  }
+
+ private:
+  void sendBatch(std::vector<std::shared_ptr<PrestoExchangeSource>> sources) {
+    std::vector<ResultLocation> locations;
+    locations.reserve(sources.size());
+    int64_t maxResponseBytes{0};
+    for (const auto& source : sources) {
+      locations.push_back(
+          {source->taskId_, source->destination_, source->sequence_});
+      maxResponseBytes += source->maxResponseBytes_;
+    }
+    VLOG(1) << "Fetching batched data for " << sources.size() << " sources";
+    auto self = shared_from_this();
+    auto batchSources =
+        std::make_shared<std::vector<std::shared_ptr<PrestoExchangeSource>>>(
+            std::move(sources));
+    http::RequestBuilder()
+        .method(proxygen::HTTPMethod::POST)
+        .url(std::string(kBatchResultsPath))
+        .header(
+            protocol::PRESTO_MAX_SIZE_HTTP_HEADER,
+            fmt::format("{}B", maxResponseBytes))
+        .send(httpClient_.get(), pool_, serializeResultLocations(locations))
+        .via(PrestoExchangeSource::responseExecutor())
+        .thenValue([self, batchSources](
+                       std::unique_ptr<http::HttpResponse> response) {
+          self->processBatchResponse(std::move(response), *batchSources);
+          self->batchDone();
+        })
+        .thenError(
+            folly::tag_t<std::exception>{},
+            [self, batchSources](const std::exception& e) {
+              self->processBatchError(e.what(), *batchSources);
+              self->batchDone();
+            });
+  }
+
+  void processBatchResponse(
+      std::unique_ptr<http::HttpResponse> response,
+      const std::vector<std::shared_ptr<PrestoExchangeSource>>& sources) {
+    auto* headers = response->headers();
+    if (headers->getStatusCode() != http::kHttpOk) {
+      processBatchError(
+          fmt::format(
+              "Received HTTP {} {}",
+              headers->getStatusCode(),
+              headers->getStatusMessage()),
+          sources);
+      return;
+    }
+    if (response->hasError()) {
+      processBatchError(response->error(), sources, false);
+      return;
+    }
+
+    std::vector<BatchResult> results;
+    try {
+      VELOX_CHECK(
+          !headers->getIsChunked(),
+          "Chunked http transferring encoding is not supported.");
+      folly::IOBufQueue body{folly::IOBufQueue::cacheChainLength()};
+      for (auto& buf : response->consumeBody()) {
+        body.append(takePooledBuffer(std::move(buf), pool_, nullptr, queryId_));
+      }
+      results = parseBatchResults(body.move());
+      VELOX_CHECK_EQ(
+          results.size(),
+          sources.size(),
+          "Unexpected number of batched results");
+    } catch (const std::exception& e) {
+      processBatchError(e.what(), sources, false);
+      return;
+    }
+
+    for (size_t i = 0; i < sources.size(); ++i) {
+      const auto& source = sources[i];
+      if (!results[i].error.empty()) {
+        source->processDataError(source->batchPath(), results[i].error);
+        continue;
+      }
+      try {
+        source->processBatchResult(results[i]);
+      } catch (const std::exception& e) {
+        source->processDataError(source->batchPath(), e.what(), false);
+      }
+    }
+  }
+
+  void processBatchError(
+      const std::string& error,
+      const std::vector<std::shared_ptr<PrestoExchangeSource>>& sources,
+      bool retry = true) {
+    for (const auto& source : sources) {
+      source->processDataError(source->batchPath(), error, retry);
+    }
+  }
+
+  // Sends the next batch for the sources which requested data while the
+  // previous one was in flight.
+  void batchDone() {
+    std::vector<std::shared_ptr<PrestoExchangeSource>> sources;
+    {
+      std::lock_guard<std::mutex> l(mutex_);
+      if (pendingSources_.empty()) {
+        inFlight_ = false;
+        return;
+      }
+      sources.swap(pendingSources_);
+    }
+    sendBatch(std::move(sources));
+  }
+
+  const std::shared_ptr<http::HttpClient> httpClient_;
+  memory::MemoryPool* const pool_;
+  const std::string queryId_;
+
+  std::mutex mutex_;
+  std::vector<std::shared_ptr<PrestoExchangeSource>> pendingSources_;
+  bool inFlight_{false};
+};
+
 PrestoExchangeSource::PrestoExchangeSource(
     const folly::Uri& baseUri,
     int destination,
     std::shared_ptr<exec::ExchangeQueue> queue,
-    memory::MemoryPool* pool)
+    memory::MemoryPool* pool,
+    bool enableStreaming,
+    bool enableBatching,
+    const std::string& pushBaseUri,
+    std::chrono::milliseconds ackDelay)
     : ExchangeSource(extractTaskId(baseUri.path()), destination, queue, pool),
       basePath_(baseUri.path()),
       host_(baseUri.host()),
-      port_(baseUri.port()) {
+      port_(baseUri.port()),
+      queryId_(taskId_.substr(0, taskId_.find('.'))),
+      nodeMaxQueuedBytes_(
+          SystemConfig::instance()->exchangeNodeMaxQueuedBytes()),
+      enableStreaming_(enableStreaming),
+      adaptiveResponseSize_(
+          SystemConfig::instance()->exchangeAdaptiveResponseSize()),
+      minResponseBytes_(SystemConfig::instance()->exchangeMinResponseBytes()),
+      maxResponseBytesLimit_(
+          SystemConfig::instance()->exchangeMaxResponseBytes()),
+      minPrefetchedPages_(
+          SystemConfig::instance()->exchangeMinPrefetchedPages()),
+      maxResponseBytes_(
+          adaptiveResponseSize_
+              ? std::min(minResponseBytes_, maxResponseBytesLimit_)
+              : maxResponseBytesLimit_),
+      bufferRecycler_(
+          SystemConfig::instance()->exchangeMaxRecycledBufferBytes() > 0
+              ? std::make_shared<http::HttpBufferRecycler>(
+                    pool_,
+                    SystemConfig::instance()->exchangeMaxRecycledBufferBytes())
+              : nullptr),
+      pushBaseUri_(pushBaseUri),
+      ackDelay_(ackDelay),
+      spillPath_(SystemConfig::instance()->exchangeSpillPath()),
+      spillMaxBytes_(
+          SystemConfig::instance()->exchangeSpillMaxBytesPerSource()),
+      spillMaxNodeBytes_(
+          SystemConfig::instance()->exchangeSpillMaxBytesPerNode()) {
   folly::SocketAddress address(folly::IPAddress(host_).str(), port_, true);
-  auto* eventBase = folly::getUnsafeMutableGlobalEventBase();
-  httpClient_ = std::make_unique<http::HttpClient>(
-      eventBase,
-      address,
-      std::chrono::milliseconds(10'000),
+  httpClient_ = httpClientPool().getClient(address);
+  // Streamed responses are processed incrementally per source, so they can't
+  // be batched.
+  if (enableBatching && !enableStreaming_) {
+    batchedResultsFetcher_ = BatchedResultsFetcher::getInstance(
+        address, httpClient_, pool_, queryId_);
+  }
+}
+
+// static
+folly::Executor* PrestoExchangeSource::responseExecutor() {
+  // Never destroyed for the same reason as the http client pool.
+  static auto* executor = []() {
+    const auto numThreads =
+        SystemConfig::instance()->exchangeNumResponseThreads();
+    if (numThreads <= 0) {
+      return new ResponseExecutor(driverCPUExecutor());
+    }
+    LOG(INFO) << "Processing exchange responses on " << numThreads
+              << " threads";
+    return new ResponseExecutor(new folly::CPUThreadPoolExecutor(
+        numThreads,
+        std::make_shared<folly::NamedThreadFactory>("ExchangeResponse")));
+  }();
+  return executor;
+}
+
+// static
+http::HttpClientPool& PrestoExchangeSource::httpClientPool() {
+  // Never destroyed as the exchange sources and their in-flight requests may
+  // outlive the static destruction.
+  static auto* pool = new http::HttpClientPool(
+      SystemConfig::instance()->exchangeHttpClientNumIoThreads(),
+      kRequestTimeout,
+      SystemConfig::instance()->exchangeHttpClientMaxIdleSessions(),
       [](size_t bufferBytes) {
-        REPORT_ADD_STAT_VALUE(kCounterHttpClientPrestoExchangeNumOnBody);
-        REPORT_ADD_HISTOGRAM_VALUE(
-            kCounterHttpClientPrestoExchangeOnBodyBytes, bufferBytes);
-      });
+        static const StatsCounter numOnBody(
+            kCounterHttpClientPrestoExchangeNumOnBody);
+        static const StatsCounter onBodyBytes(
+            kCounterHttpClientPrestoExchangeOnBodyBytes);
+        numOnBody.addValue();
+        onBodyBytes.addHistogramValue(bufferBytes);
+      },
+      folly::getUnsafeMutableGlobalEventBase());
+  return *pool;
 }
 
 bool PrestoExchangeSource::shouldRequestLocked() {
@@ -83,58 +445,345 @@ bool PrestoExchangeSource::shouldRequestLocked() {
   return !pending;
 }
 
+PrestoExchangeSource::~PrestoExchangeSource() {
+  if (!pushId_.empty()) {
+    pushSources().wlock()->erase(pushId_);
+  }
+  if (spillFile_ != nullptr) {
+    nodeSpilledBytes() -= spillFile_->bytes();
+  }
+}
+
 void PrestoExchangeSource::request() {
   failedAttempts_ = 0;
+  if (pushMode_) {
+    // The upstream worker pushes the pages as soon as there are credits for
+    // them.
+    return;
+  }
+  if (!pushBaseUri_.empty() && !pushRegistrationSent_) {
+    registerPush();
+    return;
+  }
+  // With spilling, the responses over the queued memory budget are spilled
+  // instead of deferring the requests.
+  if (spillPath_.empty() && maybeThrottleRequest()) {
+    return;
+  }
   doRequest();
 }
 
+bool PrestoExchangeSource::exceedsQueuedMemoryBudget() {
+  if (nodeMaxQueuedBytes_ == 0 || closed_.load()) {
+    return false;
+  }
+  int64_t sourceQueuedBytes;
+  {
+    std::lock_guard<std::mutex> l(queue_->mutex());
+    sourceQueuedBytes = queue_->totalBytes();
+  }
+  int64_t queryQueuedBytes{0};
+  size_t numQueries;
+  {
+    auto queryBytes = queryQueuedMemoryBytes().rlock();
+    auto it = queryBytes->find(queryId_);
+    if (it != queryBytes->end()) {
+      queryQueuedBytes = it->second;
+    }
+    numQueries = queryBytes->size();
+  }
+  return shouldThrottleRequest(
+      currQueuedMemoryBytes(),
+      queryQueuedBytes,
+      numQueries,
+      sourceQueuedBytes,
+      nodeMaxQueuedBytes_);
+}
+
+bool PrestoExchangeSource::maybeThrottleRequest() {
+  if (!exceedsQueuedMemoryBudget()) {
+    return false;
+  }
+
+  VLOG(1) << "Deferring data request for " << basePath_ << "/" << sequence_
+          << ": " << currQueuedMemoryBytes() << " bytes queued on node";
+  REPORT_ADD_STAT_VALUE(kCounterPrestoExchangeNumThrottledRequests);
+  auto self = getSelfPtr();
+  folly::futures::sleep(kThrottledRequestDelay)
+      .via(responseExecutor())
+      .thenValue([self](auto&& /*unused*/) { self->request(); });
+  return true;
+}
+
+void PrestoExchangeSource::registerPush() {
+  static std::atomic<int64_t> nextPushId{0};
+  pushRegistrationSent_ = true;
+  pushId_ = fmt::format("{}.{}.{}", taskId_, destination_, nextPushId++);
+  pushSources().wlock()->emplace(pushId_, getSelfPtr());
+  // The pushes may arrive before the registration response.
+  pushMode_ = true;
+
+  const PushRegistration registration{
+      fmt::format("{}{}/{}", pushBaseUri_, kPushPath, pushId_),
+      sequence_,
+      maxResponseBytes_};
+  auto path = fmt::format("{}/push", basePath_);
+  VLOG(1) << "Registering push to " << registration.uri << " with " << host_
+          << ":" << port_ << " " << path;
+  auto self = getSelfPtr();
+  auto fallBackToPull = [self, path](const std::string& error) {
+    LOG(WARNING) << "Failed to register push with " << self->host_ << ":"
+                 << self->port_ << " " << path
+                 << ", falling back to pulling: " << error;
+    pushSources().wlock()->erase(self->pushId_);
+    self->pushMode_ = false;
+    self->request();
+  };
+  http::RequestBuilder()
+      .method(proxygen::HTTPMethod::POST)
+      .url(path)
+      .send(httpClient_.get(), pool_, serializePushRegistration(registration))
+      .via(responseExecutor())
+      .thenValue(
+          [fallBackToPull](std::unique_ptr<http::HttpResponse> response) {
+            auto* headers = response->headers();
+            if (headers->getStatusCode() != http::kHttpOk) {
+              fallBackToPull(fmt::format(
+                  "Received HTTP {} {}",
+                  headers->getStatusCode(),
+                  headers->getStatusMessage()));
+            }
+          })
+      .thenError(
+          folly::tag_t<std::exception>{},
+          [fallBackToPull](const std::exception& e) {
+            fallBackToPull(e.what());
+          });
+}
+
+void PrestoExchangeSource::processPushedPages(
+    int64_t token,
+    int64_t nextToken,
+    bool complete,
+    const std::vector<std::unique_ptr<folly::IOBuf>>& body) {
+  {
+    std::lock_guard<std::mutex> l(queue_->mutex());
+    if (atEnd_ || token != sequence_) {
+      VLOG(1) << "Ignoring pushed pages for " << basePath_ << "/" << token
+              << ", expecting " << sequence_;
+      return;
+    }
+  }
+  size_t totalBytes{0};
+  for (const auto& buf : body) {
+    totalBytes += buf->computeChainDataLength();
+  }
+  VLOG(1) << "Received pushed data for " << basePath_ << "/" << token << ": "
+          << totalBytes << " bytes";
+
+  std::unique_ptr<exec::SerializedPage> page;
+  if (totalBytes > 0) {
+    // Copies the body out of the http server buffers into the memory pool so
+    // that the queued pages are accounted for.
+    auto* data = static_cast<uint8_t*>(
+        bufferRecycler_ != nullptr ? bufferRecycler_->allocate(totalBytes)
+                                   : pool_->allocate(totalBytes));
+    size_t offset{0};
+    for (const auto& buf : body) {
+      for (const auto range : *buf) {
+        memcpy(data + offset, range.data(), range.size());
+        offset += range.size();
+      }
+    }
+    auto pages = takePooledBuffer(
+        folly::IOBuf::wrapBuffer(data, totalBytes),
+        pool_,
+        bufferRecycler_,
+        queryId_);
+    verifyPageChecksums(*pages, fmt::format("{}/{}", basePath_, token));
+    page = std::make_unique<exec::SerializedPage>(std::move(pages));
+    reportPageSize(totalBytes);
+  }
+  enqueueResponse(
+      std::move(page), nextToken, complete, totalBytes == 0, totalBytes);
+}
+
+folly::SemiFuture<int64_t> PrestoExchangeSource::pushCredits(int attempt) {
+  int64_t credits;
+  bool atEnd;
+  {
+    std::lock_guard<std::mutex> l(queue_->mutex());
+    credits = maxResponseBytes_ - queue_->totalBytes();
+    atEnd = atEnd_;
+  }
+  if (credits > 0 && exceedsQueuedMemoryBudget()) {
+    credits = 0;
+  }
+  if (credits > 0 || atEnd || closed_.load() ||
+      attempt >= kMaxPushCreditWaits) {
+    return folly::makeSemiFuture<int64_t>(std::max<int64_t>(0, credits));
+  }
+  auto self = getSelfPtr();
+  return folly::futures::sleep(kThrottledRequestDelay)
+      .deferValue([self, attempt](auto&& /*unused*/) {
+        return self->pushCredits(attempt + 1);
+      });
+}
+
 void PrestoExchangeSource::doRequest() {
   if (closed_.load()) {
     queue_->setError("PrestoExchangeSource closed");
     return;
   }
+  // The data request for 'sequence_' acknowledges all the pages before it.
+  if (pendingAckSequence_.exchange(-1) != -1) {
+    static const StatsCounter numPiggybackedAcks(
+        kCounterPrestoExchangeNumPiggybackedAcks);
+    numPiggybackedAcks.addValue();
+  }
+  if (batchedResultsFetcher_ != nullptr) {
+    batchedResultsFetcher_->request(getSelfPtr());
+    return;
+  }
   auto path = fmt::format("{}/{}", basePath_, sequence_);
   VLOG(1) << "Fetching data from " << host_ << ":" << port_ << " " << path;
   auto self = getSelfPtr();
-  http::RequestBuilder()
-      .method(proxygen::HTTPMethod::GET)
+  http::ResponseBodyCallback onBody;
+  if (enableStreaming_) {
+    streamingBuffer_.reset();
+    streamingCompleteBytes_ = 0;
+    streamedBytes_ = 0;
+    streamingError_.clear();
+    onBody = [self](http::HttpResponse* response) {
+      self->processStreamingBody(response);
+    };
+  }
+  // Compressed pages can't be enqueued before the entire response is received.
+  acceptCompression_ = !enableStreaming_ && compressionProbeSkips_ == 0;
+  if (!acceptCompression_ && compressionProbeSkips_ > 0) {
+    --compressionProbeSkips_;
+  }
+  auto fetch = std::make_shared<DataFetch>();
+  fetch->maxResponseBytes = maxResponseBytes_;
+  fetch->acceptCompression = acceptCompression_;
+  const auto delayMs = hedgeDelayMs();
+  sendDataRequest(path, fetch, std::move(onBody), false);
+  if (delayMs > 0) {
+    folly::futures::sleep(std::chrono::milliseconds(delayMs))
+        .via(responseExecutor())
+        .thenValue([self, path, fetch](auto&& /*unused*/) {
+          if (self->closed_.load() || !fetch->addLeg()) {
+            return;
+          }
+          VLOG(1) << "Hedging data request to " << self->host_ << ":"
+                  << self->port_ << " " << path;
+          REPORT_ADD_STAT_VALUE(kCounterPrestoExchangeNumHedgedRequests);
+          self->sendDataRequest(path, fetch, nullptr, true);
+        });
+  }
+};
+
+void PrestoExchangeSource::sendDataRequest(
+    const std::string& path,
+    const std::shared_ptr<DataFetch>& fetch,
+    http::ResponseBodyCallback onBody,
+    bool hedge) {
+  http::RequestBuilder builder;
+  builder.method(proxygen::HTTPMethod::GET)
       .url(path)
-      .header(protocol::PRESTO_MAX_SIZE_HTTP_HEADER, "32MB")
-      .send(httpClient_.get(), pool_)
-      .via(driverCPUExecutor())
-      .thenValue([path, self](std::unique_ptr<http::HttpResponse> response) {
+      .header(
+          protocol::PRESTO_MAX_SIZE_HTTP_HEADER,
+          fmt::format("{}B", fetch->maxResponseBytes))
+      .bufferRecycler(bufferRecycler_);
+  if (fetch->acceptCompression) {
+    builder.header(
+        std::string(kPrestoAcceptPageCodecsHeader), acceptedPageCodecs());
+  }
+  auto span = Tracer::instance().startSpan("exchange.fetch", taskId_);
+  const auto startMs = getCurrentTimeMs();
+  // A single continuation handles both the response and the failure, so that
+  // each fetch allocates one callback with one copy of its captures.
+  builder.send(httpClient_.get(), pool_, "", std::move(onBody))
+      .via(responseExecutor())
+      .thenTry([path, self = getSelfPtr(), span, fetch, hedge, startMs](
+                   folly::Try<std::unique_ptr<http::HttpResponse>> result) {
+        Tracer::instance().finishSpan(span);
+        if (result.hasException()) {
+          if (fetch->fail()) {
+            const auto* e = result.exception().get_exception<std::exception>();
+            self->processDataError(
+                path, e != nullptr ? e->what() : "Unknown exception");
+          }
+          return;
+        }
+        auto& response = result.value();
         auto* headers = response->headers();
+        std::string error;
+        bool retry{true};
         if (headers->getStatusCode() != http::kHttpOk &&
             headers->getStatusCode() != http::kHttpNoContent) {
-          self->processDataError(
-              path,
-              fmt::format(
-                  "Received HTTP {} {}",
-                  headers->getStatusCode(),
-                  headers->getStatusMessage()));
+          error = fmt::format(
+              "Received HTTP {} {}",
+              headers->getStatusCode(),
+              headers->getStatusMessage());
         } else if (response->hasError()) {
-          self->processDataError(path, response->error(), false);
-        } else {
+          error = response->error();
+          retry = false;
+        } else if (!self->streamingError_.empty()) {
+          error = self->streamingError_;
+          retry = false;
+        }
+        if (!error.empty()) {
+          if (fetch->fail()) {
+            self->processDataError(path, error, retry);
+          }
+          return;
+        }
+        if (!fetch->succeed()) {
+          // The other leg has been processed.
+          return;
+        }
+        self->lastResponseEmpty_ = response->empty();
+        if (!self->lastResponseEmpty_ && fetchLatencies() != nullptr) {
+          fetchLatencies()->add(getCurrentTimeMs() - startMs);
+        }
+        if (hedge) {
+          REPORT_ADD_STAT_VALUE(kCounterPrestoExchangeNumHedgeWins);
+        }
+        // A corrupt response fails the source instead of escaping the future
+        // and leaving the consumer waiting.
+        try {
           self->processDataResponse(std::move(response));
+        } catch (const std::exception& e) {
+          self->processDataError(path, e.what(), false);
         }
-      })
-      .thenError(
-          folly::tag_t<std::exception>{},
-          [path, self](const std::exception& e) {
-            self->processDataError(path, e.what());
-          });
-};
+      });
+}
+
+int64_t PrestoExchangeSource::hedgeDelayMs() const {
+  // A streamed response is enqueued as it arrives and can't be discarded.
+  if (enableStreaming_ || lastResponseEmpty_ || fetchLatencies() == nullptr) {
+    return 0;
+  }
+  const auto percentileMs = fetchLatencies()->get();
+  return percentileMs == 0
+      ? 0
+      : std::max<int64_t>(
+            percentileMs,
+            SystemConfig::instance()->exchangeHedgeMinDelayMs());
+}
 
 void PrestoExchangeSource::processDataResponse(
     std::unique_ptr<http::HttpResponse> response) {
   auto* headers = response->headers();
   VELOX_CHECK(
-      !headers->getIsChunked(),
+      enableStreaming_ || !headers->getIsChunked(),
       "Chunked http transferring encoding is not supported.")
-  uint64_t contentLength =
-      atol(headers->getHeaders()
-               .getSingleOrEmpty(proxygen::HTTP_HEADER_CONTENT_LENGTH)
-               .c_str());
+  uint64_t contentLength = enableStreaming_
+      ? streamedBytes_
+      : atol(headers->getHeaders()
+                 .getSingleOrEmpty(proxygen::HTTP_HEADER_CONTENT_LENGTH)
+                 .c_str());
   VLOG(1) << "Fetched data for " << basePath_ << "/" << sequence_ << ": "
           << contentLength << " bytes";
 
@@ -153,9 +802,19 @@ void PrestoExchangeSource::processDataResponse(
 
   std::unique_ptr<exec::SerializedPage> page;
   std::unique_ptr<folly::IOBuf> singleChain;
-  const bool empty = response->empty();
+  bool empty = response->empty();
   int64_t totalBytes{0};
-  if (!empty) {
+  if (enableStreaming_) {
+    // All the received pages have been enqueued on arrival. The response is
+    // only considered empty if none has been received.
+    VELOX_CHECK(
+        empty && streamingBuffer_.empty(),
+        "Received incomplete serialized page from {}/{}: {} bytes",
+        basePath_,
+        sequence_,
+        streamingBuffer_.chainLength());
+    empty = streamedBytes_ == 0;
+  } else if (!empty) {
     auto iobufs = response->consumeBody();
     for (auto& buf : iobufs) {
       totalBytes += buf->capacity();
@@ -165,26 +824,154 @@ void PrestoExchangeSource::processDataResponse(
         singleChain->prev()->appendChain(std::move(buf));
       }
     }
+    const auto& codecName = headers->getHeaders().getSingleOrEmpty(
+        std::string(kPrestoPageCodecHeader));
+    if (!codecName.empty()) {
+      const uint64_t uncompressedSize = atol(
+          headers->getHeaders()
+              .getSingleOrEmpty(std::string(kPrestoUncompressedSizeHeader))
+              .c_str());
+      singleChain = uncompressResponse(
+          std::move(singleChain), codecName, uncompressedSize);
+      totalBytes = uncompressedSize;
+    } else if (acceptCompression_) {
+      compressionProbeSkips_ = kCompressionProbeInterval;
+    }
     PrestoExchangeSource::updateMemoryUsage(totalBytes);
+    PrestoExchangeSource::updateQueryMemoryUsage(queryId_, totalBytes);
 
     page = std::make_unique<exec::SerializedPage>(
-        std::move(singleChain), nullptr, [pool = pool_](folly::IOBuf& iobuf) {
+        std::move(singleChain),
+        nullptr,
+        [pool = pool_, bufferRecycler = bufferRecycler_, queryId = queryId_](
+            folly::IOBuf& iobuf) {
           int64_t freedBytes{0};
           // Free the backed memory from MemoryAllocator on page dtor
           folly::IOBuf* start = &iobuf;
           auto curr = start;
           do {
             freedBytes += curr->capacity();
-            pool->free(curr->writableData(), curr->capacity());
+            freeResponseBuffer(
+                curr->writableData(),
+                curr->capacity(),
+                pool,
+                bufferRecycler.get());
             curr = curr->next();
           } while (curr != start);
           PrestoExchangeSource::updateMemoryUsage(-freedBytes);
+          PrestoExchangeSource::updateQueryMemoryUsage(queryId, -freedBytes);
         });
+    // Verified once owned by the page so that the buffers are freed if the
+    // verification fails.
+    verifyPageChecksums(
+        *page->getIOBuf(), fmt::format("{}/{}", basePath_, sequence_));
   }
 
-  REPORT_ADD_HISTOGRAM_VALUE(
-      kCounterPrestoExchangeSerializedPageSize, page ? page->size() : 0);
+  const int64_t responseBytes =
+      enableStreaming_ ? streamedBytes_ : (page ? page->size() : 0);
+  if (!enableStreaming_) {
+    reportPageSize(responseBytes);
+  }
+  enqueueResponse(std::move(page), ackSequence, complete, empty, responseBytes);
+}
 
+std::unique_ptr<folly::IOBuf> PrestoExchangeSource::uncompressResponse(
+    std::unique_ptr<folly::IOBuf> compressed,
+    const std::string& codecName,
+    uint64_t uncompressedSize) {
+  SCOPE_EXIT {
+    folly::IOBuf* start = compressed.get();
+    auto curr = start;
+    do {
+      freeResponseBuffer(
+          curr->writableData(),
+          curr->capacity(),
+          pool_,
+          bufferRecycler_.get());
+      curr = curr->next();
+    } while (curr != start);
+  };
+  VELOX_CHECK_GT(
+      uncompressedSize,
+      0,
+      "Missing uncompressed size of the compressed pages from {}/{}",
+      basePath_,
+      sequence_);
+  auto uncompressed =
+      uncompressPages(*compressed, toPageCodec(codecName), uncompressedSize);
+  auto* data = static_cast<uint8_t*>(
+      bufferRecycler_ != nullptr ? bufferRecycler_->allocate(uncompressedSize)
+                                 : pool_->allocate(uncompressedSize));
+  folly::io::Cursor(uncompressed.get()).pull(data, uncompressedSize);
+  return folly::IOBuf::wrapBuffer(data, uncompressedSize);
+}
+
+void PrestoExchangeSource::processBatchResult(BatchResult& result) {
+  VLOG(1) << "Fetched batched data for " << basePath_ << "/" << sequence_
+          << ": " << (result.data ? result.data->computeChainDataLength() : 0)
+          << " bytes";
+  VELOX_CHECK_EQ(
+      result.sequence,
+      sequence_,
+      "Received batched results for an unexpected sequence from {}",
+      basePath_);
+  std::unique_ptr<exec::SerializedPage> page;
+  int64_t responseBytes{0};
+  if (result.data != nullptr) {
+    verifyPageChecksums(
+        *result.data, fmt::format("{}/{}", basePath_, sequence_));
+    // The backed memory is owned by the batched response buffers which are
+    // freed once all the pages sharing them are destroyed.
+    page = std::make_unique<exec::SerializedPage>(std::move(result.data));
+    responseBytes = page->size();
+  }
+  reportPageSize(responseBytes);
+  const bool empty = page == nullptr;
+  enqueueResponse(
+      std::move(page),
+      result.nextSequence,
+      result.complete,
+      empty,
+      responseBytes);
+}
+
+void PrestoExchangeSource::enqueueResponse(
+    std::unique_ptr<exec::SerializedPage> page,
+    int64_t ackSequence,
+    bool complete,
+    bool empty,
+    int64_t responseBytes) {
+  if (maybeSpill(page, complete)) {
+    {
+      std::lock_guard<std::mutex> l(queue_->mutex());
+      sequence_ = ackSequence;
+    }
+    if (complete) {
+      abortResults();
+      return;
+    }
+    if (!empty) {
+      if (ackDelay_.count() > 0) {
+        scheduleAcknowledge(ackSequence);
+      } else {
+        acknowledgeResults(ackSequence);
+      }
+    }
+    // The consumer does not ask for more while the pages are spilled, so the
+    // source fetches the next ones by itself up to the spill limit.
+    {
+      std::lock_guard<std::mutex> l(spillMutex_);
+      spillPaused_ = spillFullLocked();
+      if (spillPaused_) {
+        return;
+      }
+    }
+    doRequest();
+    return;
+  }
+  // True if the next page is fetched right away instead of on the consumer's
+  // request. The pushed pages are paced by the credits instead.
+  bool prefetch{false};
   {
     std::vector<ContinuePromise> promises;
     {
@@ -202,8 +989,24 @@ void PrestoExchangeSource::processDataResponse(
 
       sequence_ = ackSequence;
 
-      // Reset requestPending_ if the response is complete or have pages.
-      if (complete || !empty) {
+      // Empty responses tell nothing about the producer other than it has no
+      // data available yet, so only adapt on non-empty ones.
+      if (adaptiveResponseSize_ && !empty) {
+        maxResponseBytes_ = nextMaxResponseBytes(
+            maxResponseBytes_,
+            responseBytes,
+            queue_->totalBytes(),
+            minResponseBytes_,
+            maxResponseBytesLimit_);
+      }
+
+      // Reset requestPending_ if the response is complete or have pages. The
+      // request stays pending for a prefetch so that the consumer does not
+      // issue another one concurrently.
+      prefetch = !complete && !empty && !pushMode_ &&
+          shouldPrefetch(
+              queue_->totalBytes(), responseBytes, minPrefetchedPages_);
+      if ((complete || !empty) && !prefetch) {
         requestPending_ = false;
       }
     }
@@ -214,10 +1017,20 @@ void PrestoExchangeSource::processDataResponse(
 
   if (complete) {
     abortResults();
-  } else {
+  } else if (!pushMode_) {
+    // The pushed pages are acknowledged by the push response and the upstream
+    // worker pushes the next ones by itself.
     if (!empty) {
       // Acknowledge results for non-empty content.
-      acknowledgeResults(ackSequence);
+      if (ackDelay_.count() > 0) {
+        scheduleAcknowledge(ackSequence);
+      } else {
+        acknowledgeResults(ackSequence);
+      }
+      if (prefetch) {
+        REPORT_ADD_STAT_VALUE(kCounterPrestoExchangeNumPrefetchRequests);
+        request();
+      }
     } else {
       // Rerequest results for incomplete results with no pages.
       request();
@@ -225,12 +1038,202 @@ void PrestoExchangeSource::processDataResponse(
   }
 }
 
+bool PrestoExchangeSource::maybeSpill(
+    std::unique_ptr<exec::SerializedPage>& page,
+    bool complete) {
+  // The pushed pages are paced by the credits and the streamed ones are
+  // enqueued on arrival.
+  if (spillPath_.empty() || pushMode_ || enableStreaming_) {
+    return false;
+  }
+  const bool overBudget = page != nullptr && exceedsQueuedMemoryBudget();
+  std::lock_guard<std::mutex> l(spillMutex_);
+  const bool hasSpilled = spillFile_ != nullptr && !spillFile_->empty();
+  if (!hasSpilled && !overBudget) {
+    return false;
+  }
+  if (page != nullptr) {
+    if (spillFile_ == nullptr) {
+      spillFile_ = std::make_unique<ExchangeSpillFile>(spillPath_);
+    }
+    VLOG(1) << "Spilling page for " << basePath_ << "/" << sequence_ << ": "
+            << page->size() << " bytes";
+    const auto spilledBytes = spillFile_->bytes();
+    spillFile_->write(*page->getIOBuf());
+    nodeSpilledBytes() += spillFile_->bytes() - spilledBytes;
+    REPORT_ADD_STAT_VALUE(kCounterPrestoExchangeSpilledBytes, page->size());
+    page.reset();
+  }
+  spilledAtEnd_ = complete;
+  scheduleUnspillLocked();
+  return true;
+}
+
+void PrestoExchangeSource::scheduleUnspillLocked() {
+  if (unspillScheduled_) {
+    return;
+  }
+  unspillScheduled_ = true;
+  folly::futures::sleep(kThrottledRequestDelay)
+      .via(responseExecutor())
+      .thenValue([self = getSelfPtr()](auto&& /*unused*/) { self->unspill(); });
+}
+
+bool PrestoExchangeSource::spillFullLocked() const {
+  return spillFile_->bytes() >= spillMaxBytes_ ||
+      (spillMaxNodeBytes_ > 0 && nodeSpilledBytes() >= spillMaxNodeBytes_);
+}
+
+void PrestoExchangeSource::unspill() {
+  std::vector<ContinuePromise> promises;
+  bool resume{false};
+  std::string error;
+  {
+    // Held while enqueuing so that a response sees the spill file empty only
+    // once all the spilled pages are enqueued.
+    std::lock_guard<std::mutex> spillLock(spillMutex_);
+    unspillScheduled_ = false;
+    if (closed_.load()) {
+      return;
+    }
+    try {
+      while (!spillFile_->empty()) {
+        {
+          std::lock_guard<std::mutex> l(queue_->mutex());
+          if (queue_->totalBytes() >= maxResponseBytes_) {
+            break;
+          }
+        }
+        const auto pageBytes = spillFile_->nextPageBytes();
+        auto* data = static_cast<uint8_t*>(
+            bufferRecycler_ != nullptr ? bufferRecycler_->allocate(pageBytes)
+                                       : pool_->allocate(pageBytes));
+        auto pages = takePooledBuffer(
+            folly::IOBuf::wrapBuffer(data, pageBytes),
+            pool_,
+            bufferRecycler_,
+            queryId_);
+        spillFile_->read(data);
+        nodeSpilledBytes() -= pageBytes;
+        std::lock_guard<std::mutex> l(queue_->mutex());
+        queue_->enqueueLocked(
+            std::make_unique<exec::SerializedPage>(std::move(pages)),
+            promises);
+      }
+    } catch (const std::exception& e) {
+      error = e.what();
+    }
+    // On error, the queue is failed below and the pages left are not read.
+    if (error.empty()) {
+      if (!spillFile_->empty()) {
+        scheduleUnspillLocked();
+      } else if (spilledAtEnd_) {
+        std::lock_guard<std::mutex> l(queue_->mutex());
+        atEnd_ = true;
+        queue_->enqueueLocked(nullptr, promises);
+      }
+      if (spillPaused_ && !spilledAtEnd_ &&
+          (spillFile_->empty() ||
+           (spillFile_->bytes() < spillMaxBytes_ / 2 &&
+            (spillMaxNodeBytes_ == 0 ||
+             nodeSpilledBytes() < spillMaxNodeBytes_)))) {
+        spillPaused_ = false;
+        resume = true;
+      }
+    }
+  }
+  for (auto& promise : promises) {
+    promise.setValue();
+  }
+  if (!error.empty()) {
+    onFinalFailure(
+        fmt::format(
+            "Failed to read the spilled pages from {}:{} {}: {}",
+            host_,
+            port_,
+            basePath_,
+            error),
+        queue_);
+    return;
+  }
+  if (resume) {
+    doRequest();
+  }
+}
+
+void PrestoExchangeSource::processStreamingBody(http::HttpResponse* response) {
+  if (response->headers()->getStatusCode() != http::kHttpOk ||
+      response->empty() || !streamingError_.empty()) {
+    return;
+  }
+  for (auto& buf : response->consumeBody()) {
+    streamingBuffer_.append(
+        takePooledBuffer(std::move(buf), pool_, bufferRecycler_, queryId_));
+  }
+  try {
+    enqueueStreamingPages();
+  } catch (const std::exception& e) {
+    streamingError_ = e.what();
+  }
+}
+
+void PrestoExchangeSource::enqueueStreamingPages() {
+  folly::io::Cursor cursor(streamingBuffer_.front());
+  cursor.skip(streamingCompleteBytes_);
+  while (cursor.canAdvance(kSerializedPageHeaderBytes)) {
+    auto header = cursor;
+    header.skip(kSerializedPageSizeOffset);
+    const auto sizeInBytes = header.readLE<int32_t>();
+    VELOX_CHECK_GE(
+        sizeInBytes,
+        0,
+        "Invalid serialized page size received from {}/{}",
+        basePath_,
+        sequence_);
+    const size_t pageBytes = kSerializedPageHeaderBytes + sizeInBytes;
+    if (!cursor.canAdvance(pageBytes)) {
+      break;
+    }
+    cursor.skip(pageBytes);
+    streamingCompleteBytes_ += pageBytes;
+  }
+  if (streamingCompleteBytes_ == 0) {
+    return;
+  }
+
+  // The backed memory is owned by the split IOBuf chain itself, hence there is
+  // no need to free anything on page destruction.
+  auto pages = streamingBuffer_.split(streamingCompleteBytes_);
+  verifyPageChecksums(*pages, fmt::format("{}/{}", basePath_, sequence_));
+  auto page = std::make_unique<exec::SerializedPage>(std::move(pages));
+  streamedBytes_ += streamingCompleteBytes_;
+  streamingCompleteBytes_ = 0;
+  reportPageSize(page->size());
+
+  std::vector<ContinuePromise> promises;
+  {
+    std::lock_guard<std::mutex> l(queue_->mutex());
+    VLOG(1) << "Enqueuing streamed page for " << basePath_ << "/" << sequence_
+            << ": " << page->size() << " bytes";
+    queue_->enqueueLocked(std::move(page), promises);
+  }
+  for (auto& promise : promises) {
+    promise.setValue();
+  }
+}
+
 void PrestoExchangeSource::processDataError(
     const std::string& path,
     const std::string& error,
     bool retry) {
+  // The consumer is gone after close(), so neither retries nor fails.
+  if (closed_.load()) {
+    return;
+  }
   ++failedAttempts_;
-  if (retry && failedAttempts_ < 3) {
+  // Pages streamed from a failed response have already been enqueued, so we
+  // can't retry without delivering them twice.
+  if (retry && failedAttempts_ < 3 && streamedBytes_ == 0) {
     VLOG(1) << "Failed to fetch data from " << host_ << ":" << port_ << " "
             << path << " - Retrying: " << error;
 
@@ -251,21 +1254,38 @@ void PrestoExchangeSource::processDataError(
 void PrestoExchangeSource::acknowledgeResults(int64_t ackSequence) {
   auto ackPath = fmt::format("{}/{}/acknowledge", basePath_, ackSequence);
   VLOG(1) << "Sending ack " << ackPath;
-  auto self = getSelfPtr();
-
+  auto span = Tracer::instance().startSpan("exchange.ack", taskId_);
   http::RequestBuilder()
       .method(proxygen::HTTPMethod::GET)
       .url(ackPath)
       .send(httpClient_.get(), pool_)
-      .via(driverCPUExecutor())
-      .thenValue([self](std::unique_ptr<http::HttpResponse> response) {
-        VLOG(1) << "Ack " << response->headers()->getStatusCode();
-      })
-      .thenError(
-          folly::tag_t<std::exception>{}, [self](const std::exception& e) {
-            // Acks are optional. No need to fail the query.
-            VLOG(1) << "Ack failed: " << e.what();
-          });
+      .via(responseExecutor())
+      .thenTry([self = getSelfPtr(), span](
+                   folly::Try<std::unique_ptr<http::HttpResponse>> response) {
+        Tracer::instance().finishSpan(span);
+        if (response.hasException()) {
+          // Acks are optional. No need to fail the query.
+          VLOG(1) << "Ack failed: " << response.exception().what();
+          return;
+        }
+        VLOG(1) << "Ack " << response.value()->headers()->getStatusCode();
+      });
+}
+
+void PrestoExchangeSource::scheduleAcknowledge(int64_t ackSequence) {
+  pendingAckSequence_.store(ackSequence);
+  auto self = getSelfPtr();
+  folly::futures::sleep(ackDelay_)
+      .via(responseExecutor())
+      .thenValue([self, ackSequence](auto&& /*unused*/) {
+        // Sends the ack only if no data request and no later response has
+        // taken it over in the meantime.
+        auto expected = ackSequence;
+        if (self->pendingAckSequence_.compare_exchange_strong(expected, -1) &&
+            !self->closed_.load()) {
+          self->acknowledgeResults(ackSequence);
+        }
+      });
 }
 
 void PrestoExchangeSource::abortResults() {
@@ -276,7 +1296,7 @@ void PrestoExchangeSource::abortResults() {
       .method(proxygen::HTTPMethod::DELETE)
       .url(basePath_)
       .send(httpClient_.get(), pool_)
-      .via(driverCPUExecutor())
+      .via(responseExecutor())
       .thenValue([queue, self](std::unique_ptr<http::HttpResponse> response) {
         auto statusCode = response->headers()->getStatusCode();
         if (statusCode != http::kHttpOk && statusCode != http::kHttpNoContent) {
@@ -322,11 +1342,94 @@ PrestoExchangeSource::createExchangeSource(
   if (strncmp(url.c_str(), "http://", 7) == 0 ||
       strncmp(url.c_str(), "https://", 8) == 0) {
     return std::make_unique<PrestoExchangeSource>(
-        folly::Uri(url), destination, queue, pool);
+        folly::Uri(url),
+        destination,
+        queue,
+        pool,
+        SystemConfig::instance()->exchangeEnableStreaming(),
+        SystemConfig::instance()->exchangeEnableBatchedResults(),
+        SystemConfig::instance()->exchangeEnablePush() ? pushBaseUri() : "",
+        std::chrono::milliseconds(
+            SystemConfig::instance()->exchangeAckDelayMs()));
   }
   return nullptr;
 }
 
+// static
+void PrestoExchangeSource::registerPushEndpoint(http::HttpServer& server) {
+  server.registerPost(
+      fmt::format("{}/(.+)", kPushPath),
+      [](proxygen::HTTPMessage* message,
+         const std::vector<std::string>& pathMatch) {
+        const std::string pushId = pathMatch[1];
+        auto& headers = message->getHeaders();
+        const int64_t token = atol(
+            headers.getSingleOrEmpty(protocol::PRESTO_PAGE_TOKEN_HEADER)
+                .c_str());
+        const int64_t nextToken = atol(
+            headers.getSingleOrEmpty(protocol::PRESTO_PAGE_NEXT_TOKEN_HEADER)
+                .c_str());
+        const bool complete =
+            headers.getSingleOrEmpty(protocol::PRESTO_BUFFER_COMPLETE_HEADER)
+                .compare("true") == 0;
+        return new http::CallbackRequestHandler(
+            [pushId, token, nextToken, complete](
+                proxygen::HTTPMessage* /*message*/,
+                const std::vector<std::unique_ptr<folly::IOBuf>>& body,
+                proxygen::ResponseHandler* downstream,
+                std::shared_ptr<http::CallbackRequestHandlerState>
+                    handlerState) {
+              std::shared_ptr<PrestoExchangeSource> source;
+              {
+                auto sources = pushSources().rlock();
+                auto it = sources->find(pushId);
+                if (it != sources->end()) {
+                  source = it->second.lock();
+                }
+              }
+              if (source == nullptr || source->closed_.load()) {
+                http::sendErrorResponse(
+                    downstream,
+                    fmt::format("Unknown push id: {}", pushId),
+                    http::kHttpNotFound);
+                return;
+              }
+              try {
+                source->processPushedPages(token, nextToken, complete, body);
+              } catch (const std::exception& e) {
+                // The producer stops pushing on failure, so fail the source.
+                onFinalFailure(
+                    fmt::format(
+                        "Failed to process pushed data for {}/{}: {}",
+                        source->basePath_,
+                        token,
+                        e.what()),
+                    source->queue_);
+                http::sendErrorResponse(downstream, e.what());
+                return;
+              }
+              source->pushCredits()
+                  .via(folly::EventBaseManager::get()->getEventBase())
+                  .thenValue([downstream, handlerState](int64_t credits) {
+                    if (handlerState->requestExpired()) {
+                      return;
+                    }
+                    proxygen::ResponseBuilder(downstream)
+                        .status(http::kHttpOk, "")
+                        .header(
+                            std::string(kPushCreditsHeader),
+                            std::to_string(credits))
+                        .sendWithEOM();
+                  });
+            });
+      });
+}
+
+// static
+void PrestoExchangeSource::setPushBaseUri(const std::string& baseUri) {
+  pushBaseUri() = baseUri;
+}
+
 void PrestoExchangeSource::updateMemoryUsage(int64_t updateBytes) {
   const int64_t newMemoryBytes =
       currQueuedMemoryBytes().fetch_add(updateBytes) + updateBytes;
@@ -338,6 +1441,67 @@ void PrestoExchangeSource::updateMemoryUsage(int64_t updateBytes) {
   }
 }
 
+// static
+int64_t PrestoExchangeSource::nextMaxResponseBytes(
+    int64_t requestedBytes,
+    int64_t responseBytes,
+    int64_t queuedBytes,
+    int64_t minBytes,
+    int64_t maxBytes) {
+  int64_t nextBytes = requestedBytes;
+  if (responseBytes >= requestedBytes / 2) {
+    // The producer has more data than we asked for. Ask for more if the
+    // consumer drains the queue faster than we fill it.
+    if (queuedBytes < requestedBytes) {
+      nextBytes = requestedBytes * 2;
+    }
+  } else if (responseBytes < requestedBytes / 4) {
+    nextBytes = std::max(requestedBytes / 2, responseBytes * 2);
+  }
+  return std::max(minBytes, std::min(maxBytes, nextBytes));
+}
+
+void PrestoExchangeSource::updateQueryMemoryUsage(
+    const std::string& queryId,
+    int64_t updateBytes) {
+  auto queryBytes = queryQueuedMemoryBytes().wlock();
+  auto& bytes = (*queryBytes)[queryId];
+  bytes += updateBytes;
+  VELOX_CHECK_GE(bytes, 0);
+  if (bytes == 0) {
+    queryBytes->erase(queryId);
+  }
+}
+
+// static
+bool PrestoExchangeSource::shouldThrottleRequest(
+    int64_t nodeQueuedBytes,
+    int64_t queryQueuedBytes,
+    size_t numQueries,
+    int64_t sourceQueuedBytes,
+    int64_t maxQueuedBytes) {
+  if (maxQueuedBytes <= 0 || nodeQueuedBytes < maxQueuedBytes) {
+    return false;
+  }
+  if (sourceQueuedBytes == 0) {
+    return false;
+  }
+  const int64_t fairShareBytes =
+      maxQueuedBytes / std::max<size_t>(1, numQueries);
+  return queryQueuedBytes >= fairShareBytes;
+}
+
+// static
+bool PrestoExchangeSource::shouldPrefetch(
+    int64_t queuedBytes,
+    int64_t responseBytes,
+    int32_t minPrefetchedPages) {
+  if (minPrefetchedPages <= 0 || responseBytes <= 0) {
+    return false;
+  }
+  return queuedBytes < minPrefetchedPages * responseBytes;
+}
+
 void PrestoExchangeSource::getMemoryUsage(
     int64_t& currentBytes,
     int64_t& peakBytes) {
@@ -13,20 +13,55 @@
  */
 #pragma once
 
+#include <folly/Synchronized.h>
 #include <folly/Uri.h>
+#include <folly/io/IOBufQueue.h>
 
+#include "presto_cpp/main/BatchResults.h"
+#include "presto_cpp/main/ExchangeSpillFile.h"
 #include "presto_cpp/main/http/HttpClient.h"
 #include "velox/common/memory/Memory.h"
 #include "velox/exec/Exchange.h"
 
 namespace facebook::presto {
+namespace http {
+class HttpServer;
+}
+class BatchedResultsFetcher;
+
 class PrestoExchangeSource : public velox::exec::ExchangeSource {
  public:
+  /// If 'enableStreaming' is true, the serialized pages of a data response are
+  /// enqueued as soon as they are fully received instead of after the entire
+  /// response has been buffered. Chunked transfer encoding is only supported
+  /// in streaming mode.
+  ///
+  /// If 'enableBatching' is true and streaming is disabled, the data requests
+  /// of all the sources fetching from the same upstream worker into the same
+  /// memory pool are coalesced into batched results requests.
+  ///
+  /// If 'pushBaseUri' is not empty, the source asks the upstream worker to
+  /// push the pages to the push endpoint at 'pushBaseUri' instead of pulling
+  /// them. It falls back to pulling if the upstream worker refuses to push.
+  ///
+  /// If 'ackDelay' is non-zero, the pages received in pull mode are not
+  /// acknowledged right away. The next data request carries the token and
+  /// acknowledges them implicitly. A separate ack request is only sent if no
+  /// data request follows within 'ackDelay'.
   PrestoExchangeSource(
       const folly::Uri& baseUri,
       int destination,
       std::shared_ptr<velox::exec::ExchangeQueue> queue,
-      velox::memory::MemoryPool* pool);
+      velox::memory::MemoryPool* pool,
+      bool enableStreaming = false,
+      bool enableBatching = false,
+      const std::string& pushBaseUri = "",
+      std::chrono::milliseconds ackDelay = std::chrono::milliseconds{0});
+
+  /// The timeout of the http requests of the exchange sources.
+  static constexpr std::chrono::milliseconds kRequestTimeout{10'000};
+
+  ~PrestoExchangeSource() override;
 
   bool shouldRequestLocked() override;
 
@@ -47,17 +82,230 @@ class PrestoExchangeSource : public velox::exec::ExchangeSource {
   /// otherwise decrement the usage.
   static void updateMemoryUsage(int64_t updateBytes);
 
+  /// Same as above but tracks the memory usage queued for a given query which
+  /// is used to share the node-wide queued memory budget fairly among queries.
+  static void updateQueryMemoryUsage(
+      const std::string& queryId,
+      int64_t updateBytes);
+
   /// Invoked to get the node-wise queued memory usage from
   /// PrestoExchangeSource.
   static void getMemoryUsage(int64_t& currentBytes, int64_t& peakBytes);
 
+  /// Returns the node-wide bytes of the spilled pages not read back yet.
+  static int64_t spilledBytes() {
+    return nodeSpilledBytes();
+  }
+
+  /// Returns the max response size to ask for in the next data request given
+  /// the 'responseBytes' received for the last request which asked for
+  /// 'requestedBytes', and the 'queuedBytes' not yet consumed from the
+  /// exchange queue. The size doubles if the last response was (almost) full
+  /// and the consumer keeps up, and halves if the producer could only fill a
+  /// small fraction of it. The result is clamped to [minBytes, maxBytes].
+  static int64_t nextMaxResponseBytes(
+      int64_t requestedBytes,
+      int64_t responseBytes,
+      int64_t queuedBytes,
+      int64_t minBytes,
+      int64_t maxBytes);
+
+  /// Returns true if a data request should be deferred to keep the node-wide
+  /// 'nodeQueuedBytes' within 'maxQueuedBytes'. Once the budget is exceeded,
+  /// only the queries holding less than their fair share of it, i.e.
+  /// 'maxQueuedBytes' / 'numQueries', are allowed to fetch more. A source with
+  /// nothing queued for its consumer ('sourceQueuedBytes' is zero) is never
+  /// throttled so that the consumer can always make progress.
+  static bool shouldThrottleRequest(
+      int64_t nodeQueuedBytes,
+      int64_t queryQueuedBytes,
+      size_t numQueries,
+      int64_t sourceQueuedBytes,
+      int64_t maxQueuedBytes);
+
+  /// Returns true if a source should fetch the next page without waiting for
+  /// its consumer to ask for it given the 'queuedBytes' not yet consumed from
+  /// the exchange queue and the 'responseBytes' of the page just received. The
+  /// queue is deemed to hold fewer than 'minPrefetchedPages' while its bytes
+  /// are less than that many pages of the last size.
+  static bool shouldPrefetch(
+      int64_t queuedBytes,
+      int64_t responseBytes,
+      int32_t minPrefetchedPages);
+
+  /// The legs of a data request: the request and its hedge if sent. Only the
+  /// first successful leg is processed, and a failure only once all the legs
+  /// failed.
+  struct DataFetch {
+    /// The request headers of the legs.
+    int64_t maxResponseBytes;
+    bool acceptCompression;
+
+    std::mutex mutex;
+    int32_t numPending{1};
+    bool done{false};
+
+    /// Returns true if the succeeded leg is the first.
+    bool succeed() {
+      std::lock_guard<std::mutex> l(mutex);
+      return !std::exchange(done, true);
+    }
+
+    /// Returns true if the failed leg was the last pending one.
+    bool fail() {
+      std::lock_guard<std::mutex> l(mutex);
+      if (done || --numPending > 0) {
+        return false;
+      }
+      done = true;
+      return true;
+    }
+
+    /// Adds a pending leg. Returns false if a leg succeeded, in which case
+    /// the hedge is not sent.
+    bool addLeg() {
+      std::lock_guard<std::mutex> l(mutex);
+      if (done) {
+        return false;
+      }
+      ++numPending;
+      return true;
+    }
+  };
+
+  int64_t testingMaxResponseBytes() const {
+    return maxResponseBytes_;
+  }
+
+  /// Returns the process-wide pool of the http clients used by all the
+  /// exchange sources, keyed by the upstream address.
+  static http::HttpClientPool& httpClientPool();
+
+  /// Returns the executor processing the responses of all the exchange
+  /// sources: the driver executor unless 'exchange.num-response-threads' is
+  /// set.
+  static folly::Executor* responseExecutor();
+
+  const std::shared_ptr<http::HttpClient>& testingHttpClient() const {
+    return httpClient_;
+  }
+
+  /// Registers the endpoint on 'server' which the upstream workers push the
+  /// pages of the push mode sources to.
+  static void registerPushEndpoint(http::HttpServer& server);
+
+  /// Sets the base URI of the push endpoint of this worker. Enables push mode
+  /// for the sources created by createExchangeSource() if
+  /// 'exchange.enable-push' is true.
+  static void setPushBaseUri(const std::string& baseUri);
+
+  bool testingPushMode() const {
+    return pushMode_;
+  }
+
  private:
+  friend class BatchedResultsFetcher;
+
   void request() override;
 
   void doRequest();
 
+  // Sends a leg of the data request for 'path'. 'hedge' is true for the
+  // duplicate one.
+  void sendDataRequest(
+      const std::string& path,
+      const std::shared_ptr<DataFetch>& fetch,
+      http::ResponseBodyCallback onBody,
+      bool hedge);
+
+  // Returns the time after which a data request is hedged, or 0 if it is not.
+  int64_t hedgeDelayMs() const;
+
+  // Returns true if this source should not fetch more data to keep the
+  // node-wide queued memory within budget.
+  bool exceedsQueuedMemoryBudget();
+
+  // Defers the data request if the node-wide queued memory budget is exceeded.
+  // Returns true if the request is deferred and will be retried later.
+  bool maybeThrottleRequest();
+
+  // Appends 'page' to the spill file if the node-wide queued memory budget is
+  // exceeded or the earlier pages are still spilled, so that the pages stay
+  // in order. The end marker is then held back until the spilled pages are
+  // read. Returns true and resets 'page' if it or the end marker is spilled.
+  bool maybeSpill(
+      std::unique_ptr<velox::exec::SerializedPage>& page,
+      bool complete);
+
+  // Schedules unspill() unless scheduled. 'spillMutex_' is held.
+  void scheduleUnspillLocked();
+
+  // Returns true if fetching ahead must stop since this source or the node
+  // has spilled their max bytes. 'spillMutex_' is held.
+  bool spillFullLocked() const;
+
+  // Moves the spilled pages into the queue while it has room for them, then
+  // the end marker if received. Resumes fetching if paused once half of the
+  // spilled bytes of the source have been read and the node is under its
+  // spill limit, or once all are read. Reschedules itself while pages are
+  // left. Fails the queue if the spill file can't be read.
+  void unspill();
+
+  // Asks the upstream worker to push the pages to this source. Falls back to
+  // pulling them if the push registration fails.
+  void registerPush();
+
+  // Enqueues the pages pushed for 'token' from the push request 'body'. A push
+  // for another token is a retransmission and is ignored.
+  void processPushedPages(
+      int64_t token,
+      int64_t nextToken,
+      bool complete,
+      const std::vector<std::unique_ptr<folly::IOBuf>>& body);
+
+  // Returns the credits to grant in a push response, i.e. the number of bytes
+  // the upstream worker can push next. Waits for the consumer to drain the
+  // queue for up to 'kMaxPushCreditWaits' - 'attempt' times if there are no
+  // credits left.
+  folly::SemiFuture<int64_t> pushCredits(int attempt = 0);
+
   void processDataResponse(std::unique_ptr<http::HttpResponse> response);
 
+  // Decompresses the pooled 'compressed' response buffers into a single
+  // pooled buffer of 'uncompressedSize' bytes. Frees the compressed buffers.
+  std::unique_ptr<folly::IOBuf> uncompressResponse(
+      std::unique_ptr<folly::IOBuf> compressed,
+      const std::string& codecName,
+      uint64_t uncompressedSize);
+
+  // Processes the 'result' of this source from a batched results response.
+  void processBatchResult(BatchResult& result);
+
+  // Enqueues 'page' received for the current sequence, or the end marker if
+  // 'complete', then moves to 'ackSequence' and issues the follow up request.
+  // 'page' is null if 'empty'.
+  void enqueueResponse(
+      std::unique_ptr<velox::exec::SerializedPage> page,
+      int64_t ackSequence,
+      bool complete,
+      bool empty,
+      int64_t responseBytes);
+
+  // Returns the description of the current data request in batched mode for
+  // the error messages.
+  std::string batchPath() const {
+    return fmt::format("{} {}/{}", kBatchResultsPath, basePath_, sequence_);
+  }
+
+  // Invoked in streaming mode on the http client's event base thread each time
+  // a chunk of the data response body is received. Moves the received body
+  // into 'streamingBuffer_' and enqueues all the complete serialized pages.
+  void processStreamingBody(http::HttpResponse* response);
+
+  // Finds the complete serialized pages at the front of 'streamingBuffer_' and
+  // enqueues them as a single SerializedPage.
+  void enqueueStreamingPages();
+
   // If 'retry' is true, then retry the http request failure until reaches the
   // retry limit, otherwise just set exchange source error without retry. As
   // for now, we don't retry on the request failure which is caused by the
@@ -69,6 +317,10 @@ class PrestoExchangeSource : public velox::exec::ExchangeSource {
 
   void acknowledgeResults(int64_t ackSequence);
 
+  // Records 'ackSequence' as pending and sends it after 'ackDelay_' unless a
+  // data request sent in the meantime acknowledges it.
+  void scheduleAcknowledge(int64_t ackSequence);
+
   void abortResults();
 
   // Returns a shared ptr owning the current object.
@@ -87,12 +339,115 @@ class PrestoExchangeSource : public velox::exec::ExchangeSource {
     return peakQueuedMemoryBytes;
   }
 
+  // Tracks the node-wide bytes of the spilled pages not read back yet.
+  static std::atomic<int64_t>& nodeSpilledBytes() {
+    static std::atomic<int64_t> nodeSpilledBytes{0};
+    return nodeSpilledBytes;
+  }
+
+  // Tracks the currently node-wide queued memory usage in bytes per query. A
+  // query is removed once it has no queued memory.
+  static folly::Synchronized<std::unordered_map<std::string, int64_t>>&
+  queryQueuedMemoryBytes() {
+    static folly::Synchronized<std::unordered_map<std::string, int64_t>>
+        queryQueuedMemoryBytes;
+    return queryQueuedMemoryBytes;
+  }
+
+  // The push mode sources of this worker keyed by their push ids.
+  static folly::Synchronized<
+      std::unordered_map<std::string, std::weak_ptr<PrestoExchangeSource>>>&
+  pushSources() {
+    static folly::Synchronized<
+        std::unordered_map<std::string, std::weak_ptr<PrestoExchangeSource>>>
+        pushSources;
+    return pushSources;
+  }
+
+  static std::string& pushBaseUri() {
+    static std::string pushBaseUri;
+    return pushBaseUri;
+  }
+
   const std::string basePath_;
   const std::string host_;
   const uint16_t port_;
+  const std::string queryId_;
+  const int64_t nodeMaxQueuedBytes_;
+
+  const bool enableStreaming_;
+  const bool adaptiveResponseSize_;
+  const int64_t minResponseBytes_;
+  const int64_t maxResponseBytesLimit_;
+  const int32_t minPrefetchedPages_;
+  // The max response size to ask for in the next data request.
+  int64_t maxResponseBytes_;
+  // Recycles the data response buffers across the requests if set. Shared
+  // with the enqueued pages which return their buffers to it on destruction.
+  const std::shared_ptr<http::HttpBufferRecycler> bufferRecycler_;
+
+  // Shared with all the other exchange sources fetching from the same upstream.
+  std::shared_ptr<http::HttpClient> httpClient_;
+  // Set in batched mode to send the data requests of this source.
+  std::shared_ptr<BatchedResultsFetcher> batchedResultsFetcher_;
 
-  std::unique_ptr<http::HttpClient> httpClient_;
+  // The base URI of the push endpoint to register. Empty if push mode is
+  // disabled.
+  const std::string pushBaseUri_;
+  const std::chrono::milliseconds ackDelay_;
+  // The sequence of the received pages which are neither acknowledged by an
+  // ack request nor by a data request yet. -1 if there are none.
+  std::atomic<int64_t> pendingAckSequence_{-1};
+  // The id of this source in 'pushSources()'. Set on the push registration.
+  std::string pushId_;
+  bool pushRegistrationSent_{false};
+  // True while the pages are pushed by the upstream worker, i.e. from the
+  // push registration until it fails.
+  std::atomic_bool pushMode_{false};
   int failedAttempts_;
+  // True if the in-flight data request accepts compressed pages.
+  bool acceptCompression_{false};
+  // The number of data requests to send without accepting compressed pages
+  // before accepting them again. Set when the upstream worker didn't compress
+  // the pages, which it does not if they don't shrink, to spare it the
+  // compression attempts.
+  int32_t compressionProbeSkips_{0};
+  // True if the last data response had no pages, i.e. the upstream had no
+  // data ready and the request waited for it, so a slow one is not hedged.
+  bool lastResponseEmpty_{false};
+
+  // The streaming mode states of the in-flight data request. They are reset on
+  // each request and only accessed by the request callbacks which never run
+  // concurrently.
+  //
+  // Received body of the in-flight data response which has not been enqueued
+  // yet.
+  folly::IOBufQueue streamingBuffer_{folly::IOBufQueue::cacheChainLength()};
+  // Number of bytes at the front of 'streamingBuffer_' which are known to form
+  // complete serialized pages.
+  size_t streamingCompleteBytes_{0};
+  // Number of bytes enqueued from the in-flight data response so far.
+  int64_t streamedBytes_{0};
+  // Set if the received body can't be parsed into serialized pages.
+  std::string streamingError_;
+
+  // The local directory to spill the received pages into. Empty if spilling is
+  // disabled.
+  const std::string spillPath_;
+  const int64_t spillMaxBytes_;
+  // The max spilled bytes of all the sources of the node, 0 for unlimited.
+  const int64_t spillMaxNodeBytes_;
+  // Guards the spill states below. Acquired before the queue mutex.
+  std::mutex spillMutex_;
+  // Created on the first spilled page.
+  std::unique_ptr<ExchangeSpillFile> spillFile_;
+  // True if the end marker was received after the spilled pages.
+  bool spilledAtEnd_{false};
+  // True if fetching stopped because 'spillMaxBytes_' were spilled by this
+  // source or 'spillMaxNodeBytes_' by the node.
+  bool spillPaused_{false};
+  bool unspillScheduled_{false};
+
   std::atomic_bool closed_{false};
   // A boolean indicating whether abortResults() call was issued and was
   // successfully processed by the remote server.
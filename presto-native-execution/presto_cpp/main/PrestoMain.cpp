@@ -16,6 +16,7 @@
 #include <gflags/gflags_declare.h>
 #include <glog/logging.h>
 #include "presto_cpp/main/PrestoServer.h"
+#include "presto_cpp/main/PrometheusStatsReporter.h"
 #include "velox/common/base/StatsReporter.h"
 
 DEFINE_string(etc_dir, ".", "etc directory for presto configuration");
@@ -28,7 +29,8 @@ int main(int argc, char* argv[]) {
   LOG(INFO) << "SHUTDOWN: Exiting main()";
 }
 
-// Initialize singleton for the reporter.
+// Initialize singleton for the reporter. The counters are aggregated in
+// process and served on /v1/metrics.
 folly::Singleton<facebook::velox::BaseStatsReporter> reporter([]() {
-  return new facebook::velox::DummyStatsReporter();
+  return new facebook::presto::PrometheusStatsReporter();
 });
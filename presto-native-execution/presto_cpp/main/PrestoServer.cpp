@@ -16,13 +16,27 @@
 #include <boost/asio/ip/host_name.hpp>
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/lexical_cast.hpp>
+#include <folly/io/async/EventBaseManager.h>
+#include <folly/stop_watch.h>
 #include <glog/logging.h>
+#include <future>
 #include "presto_cpp/main/Announcer.h"
+#include "presto_cpp/main/CacheWarmer.h"
+#include "presto_cpp/main/CpuProfiler.h"
+#include "presto_cpp/main/DriverWatchdog.h"
+#include "presto_cpp/main/HugePages.h"
+#include "presto_cpp/main/InProcessExchangeSource.h"
+#include "presto_cpp/main/MemoryTrimmer.h"
 #include "presto_cpp/main/PeriodicTaskManager.h"
 #include "presto_cpp/main/PrestoExchangeSource.h"
+#include "presto_cpp/main/PrometheusStatsReporter.h"
 #include "presto_cpp/main/ServerOperation.h"
+#include "presto_cpp/main/SharedBroadcastExchangeSource.h"
 #include "presto_cpp/main/SignalHandler.h"
+#include "presto_cpp/main/SsdCacheStriping.h"
 #include "presto_cpp/main/TaskResource.h"
+#include "presto_cpp/main/TaskStatsLog.h"
+#include "presto_cpp/main/Tracer.h"
 #include "presto_cpp/main/common/ConfigReader.h"
 #include "presto_cpp/main/common/Configs.h"
 #include "presto_cpp/main/common/Counters.h"
@@ -30,6 +44,7 @@
 #include "presto_cpp/main/http/HttpServer.h"
 #include "presto_cpp/main/http/filters/AccessLogFilter.h"
 #include "presto_cpp/main/http/filters/StatsFilter.h"
+#include "presto_cpp/main/operators/FragmentResult.h"
 #include "presto_cpp/main/operators/LocalPersistentShuffle.h"
 #include "presto_cpp/main/operators/PartitionAndSerialize.h"
 #include "presto_cpp/main/operators/ShuffleInterface.h"
@@ -43,6 +58,7 @@
 #include "velox/common/caching/SsdCache.h"
 #include "velox/common/file/FileSystems.h"
 #include "velox/common/memory/MmapAllocator.h"
+#include "velox/common/time/Timer.h"
 #include "velox/connectors/Connector.h"
 #include "velox/connectors/hive/HiveConnector.h"
 #include "velox/core/Context.h"
@@ -70,6 +86,18 @@ constexpr char const* kConnectorName = "connector.name";
 constexpr char const* kCacheEnabled = "cache.enabled";
 constexpr char const* kCacheMaxCacheSize = "cache.max-cache-size";
 
+// Runs a startup step, then logs and reports how long it took.
+void timedStartupStep(
+    std::string_view name,
+    folly::StringPiece counter,
+    const std::function<void()>& step) {
+  const auto startMs = velox::getCurrentTimeMs();
+  step();
+  const auto elapsedMs = velox::getCurrentTimeMs() - startMs;
+  LOG(INFO) << "STARTUP: " << name << " took " << elapsedMs << "ms";
+  REPORT_ADD_STAT_VALUE(counter, elapsedMs);
+}
+
 protocol::NodeState convertNodeState(presto::NodeState nodeState) {
   switch (nodeState) {
     case presto::NodeState::ACTIVE:
@@ -99,15 +127,82 @@ std::string getLocalIp() {
       "Could not infer Node IP. Please specify node.ip in the node.properties file.");
 }
 
-void enableChecksum() {
-  velox::exec::PartitionedOutputBufferManager::getInstance()
-      .lock()
-      ->setListenerFactory([]() {
-        return std::make_unique<
-            serializer::presto::PrestoOutputStreamListener>();
+// Returns the handler of a CPU profile request. The profile runs for the
+// 'seconds' query parameter at 'hz' samples per CPU second and the response
+// holds the folded stacks.
+proxygen::RequestHandler* createCpuProfileHandler(
+    proxygen::HTTPMessage* message) {
+  static constexpr int32_t kDefaultProfileSeconds{10};
+  static constexpr int32_t kMaxProfileSeconds{120};
+  static constexpr int32_t kDefaultProfileHz{99};
+  return new http::CallbackRequestHandler(
+      [seconds = message->getQueryParam("seconds"),
+       hz = message->getQueryParam("hz")](
+          proxygen::HTTPMessage* /*message*/,
+          const std::vector<std::unique_ptr<folly::IOBuf>>& /*body*/,
+          proxygen::ResponseHandler* downstream,
+          std::shared_ptr<http::CallbackRequestHandlerState> handlerState) {
+        int32_t durationSec{kDefaultProfileSeconds};
+        int32_t frequencyHz{kDefaultProfileHz};
+        try {
+          if (!seconds.empty()) {
+            durationSec =
+                std::min(folly::to<int32_t>(seconds), kMaxProfileSeconds);
+          }
+          if (!hz.empty()) {
+            frequencyHz = folly::to<int32_t>(hz);
+          }
+        } catch (const std::exception& e) {
+          http::sendErrorResponse(downstream, e.what(), http::kHttpBadRequest);
+          return;
+        }
+        CpuProfiler::profileAsync(
+            std::chrono::seconds(durationSec), frequencyHz)
+            .via(folly::EventBaseManager::get()->getEventBase())
+            .thenValue([downstream, handlerState](std::string folded) {
+              if (!handlerState->requestExpired()) {
+                http::sendOkResponse(downstream, folded);
+              }
+            })
+            .thenError(
+                folly::tag_t<std::exception>{},
+                [downstream, handlerState](const std::exception& e) {
+                  if (!handlerState->requestExpired()) {
+                    http::sendErrorResponse(downstream, e.what());
+                  }
+                });
       });
 }
 
+// Creates an MmapAllocator and advises the kernel to back the address ranges it
+// reserves with transparent huge pages. Falls back to the normal pages if the
+// kernel does not support them.
+std::shared_ptr<memory::MmapAllocator> makeHugePageMmapAllocator(
+    const memory::MmapAllocator::Options& options) {
+  // The size classes and the arena reserve ranges of the memory capacity, far
+  // larger than the other mappings made meanwhile, e.g. thread stacks.
+  static constexpr uint64_t kMinRangeBytes = 64 << 20;
+  const auto mode = transparentHugePageMode();
+  if (mode != "always" && mode != "madvise") {
+    LOG(WARNING) << "STARTUP: Transparent huge pages are '" << mode
+                 << "', the MmapAllocator uses normal pages";
+    return std::make_shared<memory::MmapAllocator>(options);
+  }
+  const auto before = anonymousMappings();
+  auto allocator = std::make_shared<memory::MmapAllocator>(options);
+  const auto advice =
+      adviseHugePages(before, anonymousMappings(), kMinRangeBytes);
+  LOG(INFO) << "STARTUP: Advised huge pages for " << advice.numRanges
+            << " MmapAllocator ranges of " << advice.bytes << " bytes, "
+            << advice.numFailed << " failed";
+  REPORT_ADD_STAT_VALUE(kCounterHugePageAdvisedBytes, advice.bytes);
+  if (advice.numFailed > 0) {
+    REPORT_ADD_STAT_VALUE(
+        kCounterNumHugePageAdviceFailures, advice.numFailed);
+  }
+  return allocator;
+}
+
 std::string clearConnectorCache(proxygen::HTTPMessage* message) {
   const auto name = message->getQueryParam("name");
   const auto id = message->getQueryParam("id");
@@ -159,6 +254,7 @@ void PrestoServer::run() {
   auto nodeConfig = NodeConfig::instance();
   int httpPort{0};
   int httpExecThreads{0};
+  int httpCpuThreads{0};
 
   std::string certPath, keyPath, ciphers;
   std::optional<int> httpsPort;
@@ -201,6 +297,7 @@ void PrestoServer::run() {
 
     nodeVersion_ = systemConfig->prestoVersion();
     httpExecThreads = systemConfig->httpExecThreads();
+    httpCpuThreads = systemConfig->httpCpuThreads();
     environment_ = nodeConfig->nodeEnvironment();
     nodeId_ = nodeConfig->nodeId();
     address_ = nodeConfig->nodeIp(getLocalIp);
@@ -215,9 +312,28 @@ void PrestoServer::run() {
     exit(EXIT_FAILURE);
   }
 
+  const auto startupStartMs = velox::getCurrentTimeMs();
   registerStatsCounters();
+  // The function registration is the longest step and independent of the
+  // others, so it overlaps with them until the task manager needs them.
+  auto functionsRegistered = std::async(std::launch::async, [this]() {
+    timedStartupStep(
+        "Function registration", kCounterStartupFunctionsMs, [this]() {
+          registerFunctions();
+        });
+  });
   registerFileSystems();
-  registerOptionalHiveStorageAdapters();
+  RemoteReadOptions remoteReadOptions;
+  remoteReadOptions.coalesce = systemConfig->storageCoalesceReads();
+  remoteReadOptions.parallelReadBytes =
+      systemConfig->storageParallelReadBytes();
+  if (remoteReadOptions.parallelReadBytes > 0) {
+    storageReadExecutor_ = std::make_unique<folly::IOThreadPoolExecutor>(
+        systemConfig->storageNumParallelReadThreads(),
+        std::make_shared<folly::NamedThreadFactory>("StorageRead"));
+    remoteReadOptions.executor = storageReadExecutor_.get();
+  }
+  registerOptionalHiveStorageAdapters(remoteReadOptions);
   registerShuffleInterfaceFactories();
   registerCustomOperators();
   protocol::registerHiveConnectors();
@@ -228,9 +344,16 @@ void PrestoServer::run() {
       std::make_shared<folly::NamedThreadFactory>("PrestoWorkerNetwork"));
   folly::setUnsafeMutableGlobalIOExecutor(executor);
 
-  initializeVeloxMemory();
+  timedStartupStep(
+      "Memory initialization", kCounterStartupMemoryInitMs, [this]() {
+        initializeVeloxMemory();
+      });
 
-  auto catalogNames = registerConnectors(fs::path(configDirectoryPath_));
+  std::vector<std::string> catalogNames;
+  timedStartupStep(
+      "Connector registration", kCounterStartupConnectorsMs, [&]() {
+        catalogNames = registerConnectors(fs::path(configDirectoryPath_));
+      });
 
   folly::SocketAddress httpSocketAddress;
   httpSocketAddress.setFromLocalPort(httpPort);
@@ -240,9 +363,8 @@ void PrestoServer::run() {
       httpPort,
       address_);
 
-  std::unique_ptr<Announcer> announcer;
   if (auto discoveryAddressLookupFunc = discoveryAddressLookup()) {
-    announcer = std::make_unique<Announcer>(
+    announcer_ = std::make_unique<Announcer>(
         address_,
         httpsPort.has_value(),
         httpsPort.has_value() ? httpsPort.value() : httpPort,
@@ -252,8 +374,9 @@ void PrestoServer::run() {
         nodeId_,
         nodeLocation_,
         catalogNames,
-        30'000 /*milliseconds*/);
-    announcer->start();
+        30'000 /*milliseconds*/,
+        systemConfig->announcementMaxBackoffMs());
+    announcer_->start();
   }
 
   const bool reusePort = SystemConfig::instance()->httpServerReusePort();
@@ -266,11 +389,21 @@ void PrestoServer::run() {
     httpsSocketAddress.setFromLocalPort(httpsPort.value());
 
     httpsConfig = std::make_unique<http::HttpsConfig>(
-        httpsSocketAddress, certPath, keyPath, ciphers, reusePort);
+        httpsSocketAddress,
+        certPath,
+        keyPath,
+        ciphers,
+        reusePort,
+        systemConfig->enableHttp2());
   }
 
   httpServer_ = std::make_unique<http::HttpServer>(
-      std::move(httpConfig), std::move(httpsConfig), httpExecThreads);
+      std::move(httpConfig),
+      std::move(httpsConfig),
+      httpExecThreads,
+      httpCpuThreads,
+      systemConfig->httpServerNumAcceptorGroups(),
+      systemConfig->httpServerPinAcceptorGroups());
 
   httpServer_->registerPost(
       "/v1/memory",
@@ -318,6 +451,58 @@ void PrestoServer::run() {
             .sendWithEOM();
       });
 
+  httpServer_->registerGet(
+      "/v1/cache/tables",
+      [server = this](
+          proxygen::HTTPMessage* message,
+          const std::vector<std::unique_ptr<folly::IOBuf>>& /*body*/,
+          proxygen::ResponseHandler* downstream) {
+        server->reportTableCacheStats(message, downstream);
+      });
+  httpServer_->registerGet(
+      "/v1/trace",
+      [server = this](
+          proxygen::HTTPMessage* message,
+          const std::vector<std::unique_ptr<folly::IOBuf>>& /*body*/,
+          proxygen::ResponseHandler* downstream) {
+        // The spans of the query 'query_id', or all the recorded ones.
+        http::sendOkResponse(
+            downstream,
+            Tracer::toOtlp(
+                Tracer::instance().spans(message->getQueryParam("query_id")),
+                server->nodeId_));
+      });
+  httpServer_->registerGet(
+      "/v1/query-resources",
+      [server = this](
+          proxygen::HTTPMessage* /*message*/,
+          const std::vector<std::unique_ptr<folly::IOBuf>>& /*body*/,
+          proxygen::ResponseHandler* downstream) {
+        server->reportQueryResources(downstream);
+      });
+  httpServer_->registerGet(
+      "/v1/metrics",
+      [](proxygen::HTTPMessage* /*message*/,
+         const std::vector<std::unique_ptr<folly::IOBuf>>& /*body*/,
+         proxygen::ResponseHandler* downstream) {
+        auto reporter = std::dynamic_pointer_cast<PrometheusStatsReporter>(
+            folly::Singleton<velox::BaseStatsReporter>::try_get());
+        if (reporter == nullptr) {
+          http::sendErrorResponse(
+              downstream,
+              "The registered stats reporter does not export metrics",
+              http::kHttpNotFound);
+          return;
+        }
+        proxygen::ResponseBuilder(downstream)
+            .status(http::kHttpOk, "OK")
+            .header(
+                proxygen::HTTP_HEADER_CONTENT_TYPE,
+                http::kMimeTypePrometheusText)
+            .body(reporter->toPrometheusText())
+            .sendWithEOM();
+      });
+
   // The endpoint used by operation in production.
   httpServer_->registerGet(
       "/v1/operation/.*",
@@ -325,23 +510,55 @@ void PrestoServer::run() {
           proxygen::HTTPMessage* message,
           const std::vector<std::unique_ptr<folly::IOBuf>>& /*body*/,
           proxygen::ResponseHandler* downstream) {
-        server->runOperation(message, downstream);
+        server->runOperation(message, "", downstream);
+      });
+  // The operations taking a body, e.g. the ranges to prefetch.
+  httpServer_->registerPost(
+      "/v1/operation/.*",
+      [server = this](
+          proxygen::HTTPMessage* message,
+          const std::vector<std::unique_ptr<folly::IOBuf>>& body,
+          proxygen::ResponseHandler* downstream) {
+        server->runOperation(message, http::bodyToString(body), downstream);
+      });
+  httpServer_->registerGet(
+      "/v1/profile/cpu",
+      [](proxygen::HTTPMessage* message,
+         const std::vector<std::string>& /*pathMatch*/) {
+        return createCpuProfileHandler(message);
+      });
+  httpServer_->registerGet(
+      "/v1/profile/heap",
+      [](proxygen::HTTPMessage* /*message*/,
+         const std::vector<std::unique_ptr<folly::IOBuf>>& /*body*/,
+         proxygen::ResponseHandler* downstream) {
+        try {
+          http::sendOkResponse(
+              downstream,
+              json{
+                  {"path",
+                   CpuProfiler::dumpHeapProfile(
+                       fs::temp_directory_path().string())}});
+        } catch (const std::exception& e) {
+          http::sendErrorResponse(downstream, e.what());
+        }
       });
 
-  static const std::string kPrestoDefaultPrefix{"presto.default."};
-  velox::functions::prestosql::registerAllScalarFunctions(kPrestoDefaultPrefix);
-  velox::aggregate::prestosql::registerAllAggregateFunctions(
-      kPrestoDefaultPrefix);
-  velox::window::prestosql::registerAllWindowFunctions(kPrestoDefaultPrefix);
-  if (SystemConfig::instance()->registerTestFunctions()) {
-    velox::functions::prestosql::registerComparisonFunctions(
-        "json.test_schema.");
-    velox::aggregate::prestosql::registerAllAggregateFunctions(
-        "json.test_schema.");
-  }
   registerVectorSerdes();
   registerPrestoPlanNodeSerDe();
 
+  if (systemConfig->exchangeShareBroadcasts()) {
+    // Registered first to take over the broadcasts fetched by another task.
+    facebook::velox::exec::ExchangeSource::registerFactory(
+        SharedBroadcastExchangeSource::createExchangeSource);
+  }
+  if (systemConfig->exchangeEnableInProcess()) {
+    // Registered first to take over the exchanges from this worker.
+    InProcessExchangeSource::setLocalAddress(
+        address_, httpsPort.has_value() ? httpsPort.value() : httpPort);
+    facebook::velox::exec::ExchangeSource::registerFactory(
+        InProcessExchangeSource::createExchangeSource);
+  }
   facebook::velox::exec::ExchangeSource::registerFactory(
       PrestoExchangeSource::createExchangeSource);
   facebook::velox::exec::ExchangeSource::registerFactory(
@@ -353,8 +570,30 @@ void PrestoServer::run() {
       velox::parquet::ParquetReaderType::NATIVE);
 #endif
 
+  // Rethrows the failure of the function registration, if any.
+  functionsRegistered.get();
   taskManager_ = std::make_unique<TaskManager>(
       systemConfig->values(), nodeConfig->values());
+  Tracer::instance().configure(
+      systemConfig->tracingSampleRate(), systemConfig->tracingMaxSpans());
+  if (systemConfig->adaptiveDriversPerTask()) {
+    driverConcurrencyController_ =
+        std::make_unique<DriverConcurrencyController>(
+            systemConfig->minDriversPerTask(),
+            systemConfig->maxDriversPerTask());
+  }
+  if (systemConfig->adaptiveConcurrentLifespans()) {
+    const int32_t maxLifespans = systemConfig->concurrentLifespansPerTask() > 0
+        ? systemConfig->concurrentLifespansPerTask()
+        : TaskManager::kMaxConcurrentLifespans;
+    lifespanConcurrencyController_ =
+        std::make_unique<LifespanConcurrencyController>(
+            std::min(
+                systemConfig->minConcurrentLifespansPerTask(), maxLifespans),
+            maxLifespans);
+    taskManager_->setConcurrentLifespansPerTask(
+        lifespanConcurrencyController_->lifespans());
+  }
 
   std::string taskUri;
   if (httpsPort.has_value()) {
@@ -365,12 +604,29 @@ void PrestoServer::run() {
 
   taskManager_->setBaseUri(taskUri);
   taskManager_->setNodeId(nodeId_);
+  if (announcer_ != nullptr && systemConfig->announcementLoadInfo()) {
+    announcer_->setPropertiesSupplier([taskManager = taskManager_.get()]() {
+      size_t numTasks{0};
+      const auto taskNumbers = taskManager->getTaskNumbers(numTasks);
+      const auto driverCountStats = taskManager->getDriverCountStats();
+      return std::map<std::string, std::string>{
+          {"running_tasks",
+           std::to_string(taskNumbers[velox::exec::TaskState::kRunning])},
+          {"running_drivers",
+           std::to_string(driverCountStats.numRunningDrivers)},
+          {"blocked_drivers",
+           std::to_string(driverCountStats.numBlockedDrivers)}};
+    });
+  }
   taskResource_ = std::make_unique<TaskResource>(*taskManager_);
   taskResource_->registerUris(*httpServer_);
-  if (systemConfig->enableSerializedPageChecksum()) {
-    enableChecksum();
+  // The pushes are sent by the pooled exchange http clients which don't
+  // support https.
+  if (systemConfig->exchangeEnablePush() && !httpsPort.has_value()) {
+    PrestoExchangeSource::registerPushEndpoint(*httpServer_);
+    PrestoExchangeSource::setPushBaseUri(
+        fmt::format("{}://{}:{}", kHttp, address_, httpPort));
   }
-
   if (systemConfig->enableVeloxTaskLogging()) {
     if (auto listener = getTaskListener()) {
       exec::registerTaskListener(listener);
@@ -389,6 +645,14 @@ void PrestoServer::run() {
     LOG(INFO) << "STARTUP: HTTP Server executor has "
               << httpServer_->getExecutor()->numThreads() << " threads.";
   }
+  if (httpServer_->numAcceptorGroups() > 1) {
+    LOG(INFO) << "STARTUP: HTTP Server has "
+              << httpServer_->numAcceptorGroups() << " acceptor groups.";
+  }
+  if (httpCpuThreads > 0) {
+    LOG(INFO) << "STARTUP: HTTP Server CPU executor has " << httpCpuThreads
+              << " threads.";
+  }
   if (spillExecutorPtr()) {
     LOG(INFO) << "STARTUP: Spill executor has "
               << spillExecutorPtr()->numThreads() << " threads.";
@@ -405,24 +669,45 @@ void PrestoServer::run() {
   auto memoryAllocator = velox::memory::MemoryAllocator::getInstance();
   periodicTaskManager_ = std::make_unique<PeriodicTaskManager>(
       driverCPUExecutor(),
-      httpServer_->getExecutor(),
+      httpServer_->getExecutors(),
       taskManager_.get(),
       memoryAllocator,
-      dynamic_cast<const velox::cache::AsyncDataCache* const>(memoryAllocator),
+      dynamic_cast<velox::cache::AsyncDataCache* const>(memoryAllocator),
       velox::connector::getAllConnectors());
   periodicTaskManager_->addTask(
       [server = this]() { server->populateMemAndCPUInfo(); },
       1'000'000, // 1 second
       "populate_mem_cpu_info");
+  if (const auto reloadIntervalSec = systemConfig->configReloadIntervalSec()) {
+    periodicTaskManager_->addTask(
+        [server = this]() {
+          try {
+            server->applySystemConfigChanges(
+                SystemConfig::instance()->reload());
+          } catch (const std::exception& e) {
+            LOG(WARNING) << "Failed to reload the system config: " << e.what();
+          }
+        },
+        reloadIntervalSec * 1'000'000,
+        "system_config_reload");
+  }
   addAdditionalPeriodicTasks();
   periodicTaskManager_->start();
 
+  const auto startupMs = velox::getCurrentTimeMs() - startupStartMs;
+  LOG(INFO) << "STARTUP: Ready to serve after " << startupMs << "ms";
+  REPORT_ADD_STAT_VALUE(kCounterStartupMs, startupMs);
+
   // Start everything. After the return from the following call we are shutting
   // down.
   httpServer_->start(getHttpServerFilters());
 
   LOG(INFO) << "SHUTDOWN: Stopping all periodic tasks...";
   periodicTaskManager_->stop();
+  if (announcer_ != nullptr) {
+    LOG(INFO) << "SHUTDOWN: Stopping the announcer...";
+    announcer_->stop();
+  }
 
   // Destroy entities here to ensure we won't get any messages after Server
   // object is gone and to have nice log in case shutdown gets stuck.
@@ -447,6 +732,38 @@ void PrestoServer::run() {
             << connectorIoExecutor_->numThreads();
   connectorIoExecutor_->join();
 
+  if (storageReadExecutor_ != nullptr) {
+    LOG(INFO) << "SHUTDOWN: Joining Storage Read Executor '"
+              << storageReadExecutor_->getName() << "': threads: "
+              << storageReadExecutor_->numActiveThreads() << "/"
+              << storageReadExecutor_->numThreads();
+    storageReadExecutor_->join();
+  }
+
+  if (shuffleExchangeExecutor_ != nullptr) {
+    LOG(INFO) << "SHUTDOWN: Joining Shuffle Exchange Executor '"
+              << shuffleExchangeExecutor_->getName() << "': threads: "
+              << shuffleExchangeExecutor_->numActiveThreads() << "/"
+              << shuffleExchangeExecutor_->numThreads();
+    shuffleExchangeExecutor_->join();
+  }
+
+  if (shuffleWriteExecutor_ != nullptr) {
+    LOG(INFO) << "SHUTDOWN: Joining Shuffle Write Executor '"
+              << shuffleWriteExecutor_->getName() << "': threads: "
+              << shuffleWriteExecutor_->numActiveThreads() << "/"
+              << shuffleWriteExecutor_->numThreads();
+    shuffleWriteExecutor_->join();
+  }
+
+  if (shuffleReadExecutor_ != nullptr) {
+    LOG(INFO) << "SHUTDOWN: Joining Shuffle Read Executor '"
+              << shuffleReadExecutor_->getName() << "': threads: "
+              << shuffleReadExecutor_->numActiveThreads() << "/"
+              << shuffleReadExecutor_->numThreads();
+    shuffleReadExecutor_->join();
+  }
+
   LOG(INFO) << "SHUTDOWN: Done joining our executors.";
 
   auto globalCPUKeepAliveExec = folly::getGlobalCPUExecutor();
@@ -478,15 +795,28 @@ void PrestoServer::initializeVeloxMemory() {
   std::unique_ptr<cache::SsdCache> ssd;
   const auto asyncCacheSsdGb = systemConfig->asyncCacheSsdGb();
   if (asyncCacheSsdGb) {
-    constexpr int32_t kNumSsdShards = 16;
-    cacheExecutor_ =
-        std::make_unique<folly::IOThreadPoolExecutor>(kNumSsdShards);
+    const int32_t numSsdShards = systemConfig->asyncCacheSsdShards();
+    VELOX_USER_CHECK_GT(numSsdShards, 0, "The SSD cache needs a shard");
+    const auto ssdPaths = systemConfig->asyncCacheSsdPaths();
+    const auto ssdPath = stripeSsdCacheFiles(ssdPaths, numSsdShards);
+    const int32_t numSsdIoThreads = systemConfig->asyncCacheSsdIoThreads();
+    cacheExecutor_ = std::make_unique<folly::IOThreadPoolExecutor>(
+        numSsdIoThreads > 0 ? numSsdIoThreads : numSsdShards);
+    LOG(INFO) << "STARTUP: SSD cache of " << asyncCacheSsdGb << "GB in "
+              << numSsdShards << " shards on " << ssdPaths.size()
+              << " path(s) with " << cacheExecutor_->numThreads()
+              << " IO threads";
+    // The SSD files recover their contents from their checkpoints, if any,
+    // when created.
+    folly::stop_watch<std::chrono::milliseconds> recoveryTimer;
     ssd = std::make_unique<cache::SsdCache>(
-        systemConfig->asyncCacheSsdPath(),
+        ssdPath,
         asyncCacheSsdGb << 30,
-        kNumSsdShards,
+        numSsdShards,
         cacheExecutor_.get(),
         systemConfig->asyncCacheSsdCheckpointGb() << 30);
+    REPORT_ADD_STAT_VALUE(
+        kCounterSsdCacheRecoveryMs, recoveryTimer.elapsed().count());
   }
   const int64_t memoryBytes = memoryGb << 30;
   std::shared_ptr<memory::MemoryAllocator> allocator;
@@ -495,13 +825,30 @@ void PrestoServer::initializeVeloxMemory() {
     options.capacity = memoryBytes;
     options.useMmapArena = systemConfig->useMmapArena();
     options.mmapArenaCapacityRatio = systemConfig->mmapArenaCapacityRatio();
-    allocator = std::make_shared<memory::MmapAllocator>(options);
+    if (systemConfig->mmapAllocatorHugePages()) {
+      allocator = makeHugePageMmapAllocator(options);
+    } else {
+      allocator = std::make_shared<memory::MmapAllocator>(options);
+    }
   } else {
     allocator = memory::MemoryAllocator::createDefaultInstance();
   }
   cache_ = std::make_shared<cache::AsyncDataCache>(
       allocator, memoryBytes, std::move(ssd));
+  if (const auto ssdStats = cache_->refreshStats().ssdStats) {
+    LOG(INFO) << "STARTUP: SSD cache recovered " << ssdStats->entriesCached
+              << " entries, " << ssdStats->bytesCached
+              << " bytes from its checkpoint";
+    REPORT_ADD_STAT_VALUE(
+        kCounterSsdCacheRecoveredEntries, ssdStats->entriesCached);
+    REPORT_ADD_STAT_VALUE(
+        kCounterSsdCacheRecoveredBytes, ssdStats->bytesCached);
+  }
   memory::MemoryAllocator::setDefaultInstance(cache_.get());
+  cacheWarmer_ = std::make_unique<CacheWarmer>(
+      cache_.get(),
+      systemConfig->asyncCacheWarmerThreads(),
+      memoryBytes / 100 * systemConfig->asyncCacheMaxPinnedPct());
   // Set up velox memory manager.
   memory::MemoryManager::getInstance(
       memory::MemoryManager::Options{.capacity = memoryBytes}, true);
@@ -511,30 +858,39 @@ void PrestoServer::stop() {
   // Make sure we only go here once.
   auto shutdownOnsetSec = SystemConfig::instance()->shutdownOnsetSec();
   if (not shuttingDown_.exchange(true)) {
-    LOG(INFO) << "SHUTDOWN: Initiating shutdown. Will wait for "
-              << shutdownOnsetSec << " seconds.";
+    LOG(INFO) << "SHUTDOWN: Initiating shutdown. Draining the running tasks.";
     this->setNodeState(NodeState::SHUTTING_DOWN);
 
-    // Give coordinator some time to receive our new node state and stop sending
-    // any tasks.
-    std::this_thread::sleep_for(std::chrono::seconds(shutdownOnsetSec));
+    // Leave the discovery service and refuse new tasks right away instead of
+    // waiting for the coordinator to notice the new node state.
+    if (announcer_ != nullptr) {
+      announcer_->unannounce();
+    }
+    taskManager_->setDraining();
 
     size_t numTasks{0};
     auto taskNumbers = taskManager_->getTaskNumbers(numTasks);
     size_t seconds = 0;
     while (taskNumbers[velox::exec::TaskState::kRunning] > 0) {
-      LOG(INFO) << "SHUTDOWN: Waiting (" << seconds
-                << " seconds so far) for 'Running' tasks to complete. "
-                << numTasks << " tasks left: "
-                << PrestoTask::taskNumbersToString(taskNumbers);
+      if (seconds % 10 == 0) {
+        LOG(INFO) << "SHUTDOWN: Waiting (" << seconds
+                  << " seconds so far) for 'Running' tasks to complete. "
+                  << numTasks << " tasks left: "
+                  << PrestoTask::taskNumbersToString(taskNumbers);
+      }
       std::this_thread::sleep_for(std::chrono::seconds(1));
       taskNumbers = taskManager_->getTaskNumbers(numTasks);
       ++seconds;
     }
 
-    // Give coordinator some time to request tasks stats for completed or failed
-    // tasks.
-    std::this_thread::sleep_for(std::chrono::seconds(shutdownOnsetSec));
+    // Give coordinator up to 'shutdownOnsetSec' to request the final stats of
+    // the completed or failed tasks. Stops waiting once it has for all.
+    const auto deadline = std::chrono::steady_clock::now() +
+        std::chrono::seconds(shutdownOnsetSec);
+    while (taskManager_->numUnreportedFinishedTasks() > 0 &&
+           std::chrono::steady_clock::now() < deadline) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
 
     if (httpServer_) {
       LOG(INFO) << "SHUTDOWN: All tasks are completed. Stopping HTTP Server...";
@@ -569,7 +925,16 @@ std::function<folly::SocketAddress()> PrestoServer::discoveryAddressLookup() {
 void PrestoServer::addAdditionalPeriodicTasks() {}
 
 std::shared_ptr<velox::exec::TaskListener> PrestoServer::getTaskListener() {
-  return nullptr;
+  auto* systemConfig = SystemConfig::instance();
+  const auto directory = systemConfig->taskStatsLogDirectory();
+  if (directory.empty()) {
+    return nullptr;
+  }
+  return std::make_shared<TaskStatsLog>(
+      directory,
+      systemConfig->taskStatsLogRowsPerFile(),
+      systemConfig->taskStatsLogMaxFiles(),
+      std::chrono::seconds(systemConfig->taskStatsLogFlushIntervalSec()));
 }
 
 std::shared_ptr<velox::exec::ExprSetListener>
@@ -581,12 +946,19 @@ std::vector<std::unique_ptr<proxygen::RequestHandlerFactory>>
 PrestoServer::getHttpServerFilters() {
   std::vector<std::unique_ptr<proxygen::RequestHandlerFactory>> filters;
 
-  if (SystemConfig::instance()->enableHttpAccessLog()) {
-    filters.push_back(
-        std::make_unique<http::filters::AccessLogFilterFactory>());
+  const auto* systemConfig = SystemConfig::instance();
+  if (systemConfig->enableHttpAccessLog()) {
+    http::filters::AccessLogOptions options;
+    options.sampleRate = systemConfig->httpAccessLogSampleRate();
+    options.parseEndpointSampleRates(
+        systemConfig->httpAccessLogEndpointSampleRates());
+    options.slowRequestMs = systemConfig->httpAccessLogSlowRequestMs();
+    options.path = systemConfig->httpAccessLogPath();
+    filters.push_back(std::make_unique<http::filters::AccessLogFilterFactory>(
+        std::move(options)));
   }
 
-  if (SystemConfig::instance()->enableHttpStatsFilter()) {
+  if (systemConfig->enableHttpStatsFilter()) {
     auto filter = getHttpStatsFilter();
     if (filter != nullptr) {
       filters.push_back(std::move(filter));
@@ -651,9 +1023,39 @@ std::vector<std::string> PrestoServer::registerConnectors(
 }
 
 void PrestoServer::registerShuffleInterfaceFactories() {
+  auto numWriteThreads =
+      SystemConfig::instance()->localShuffleNumWriteThreads();
+  if (numWriteThreads > 0) {
+    shuffleWriteExecutor_ = std::make_unique<folly::IOThreadPoolExecutor>(
+        numWriteThreads,
+        std::make_shared<folly::NamedThreadFactory>("LocalShuffleWriter"));
+  }
+  auto numReadThreads = SystemConfig::instance()->localShuffleNumReadThreads();
+  if (numReadThreads > 0) {
+    shuffleReadExecutor_ = std::make_unique<folly::IOThreadPoolExecutor>(
+        numReadThreads,
+        std::make_shared<folly::NamedThreadFactory>("LocalShuffleReader"));
+  }
+  auto numExchangeReadThreads =
+      SystemConfig::instance()->shuffleNumExchangeReadThreads();
+  if (numExchangeReadThreads > 0) {
+    shuffleExchangeExecutor_ = std::make_unique<folly::IOThreadPoolExecutor>(
+        numExchangeReadThreads,
+        std::make_shared<folly::NamedThreadFactory>("ShuffleExchange"));
+    operators::UnsafeRowExchangeSource::setReadExecutor(
+        shuffleExchangeExecutor_.get());
+  }
   operators::ShuffleInterfaceFactory::registerFactory(
       operators::LocalPersistentShuffleFactory::kShuffleName.toString(),
-      std::make_unique<operators::LocalPersistentShuffleFactory>());
+      std::make_unique<operators::LocalPersistentShuffleFactory>(
+          shuffleWriteExecutor_.get(), shuffleReadExecutor_.get()));
+  operators::ShuffleInterfaceFactory::registerFactory(
+      operators::LocalPersistentShuffleFactory::kMemoryShuffleName.toString(),
+      std::make_unique<operators::LocalPersistentShuffleFactory>(
+          shuffleWriteExecutor_.get(),
+          shuffleReadExecutor_.get(),
+          std::make_shared<operators::LocalShuffleMemoryStore>(
+              SystemConfig::instance()->localShuffleMemoryStoreBytes())));
 }
 
 void PrestoServer::registerCustomOperators() {
@@ -663,6 +1065,22 @@ void PrestoServer::registerCustomOperators() {
       std::make_unique<facebook::presto::operators::ShuffleWriteTranslator>());
   facebook::velox::exec::Operator::registerOperator(
       std::make_unique<operators::ShuffleReadTranslator>());
+  facebook::velox::exec::Operator::registerOperator(
+      std::make_unique<operators::FragmentResultTranslator>());
+}
+
+void PrestoServer::registerFunctions() {
+  static const std::string kPrestoDefaultPrefix{"presto.default."};
+  velox::functions::prestosql::registerAllScalarFunctions(kPrestoDefaultPrefix);
+  velox::aggregate::prestosql::registerAllAggregateFunctions(
+      kPrestoDefaultPrefix);
+  velox::window::prestosql::registerAllWindowFunctions(kPrestoDefaultPrefix);
+  if (SystemConfig::instance()->registerTestFunctions()) {
+    velox::functions::prestosql::registerComparisonFunctions(
+        "json.test_schema.");
+    velox::aggregate::prestosql::registerAllAggregateFunctions(
+        "json.test_schema.");
+  }
 }
 
 void PrestoServer::registerVectorSerdes() {
@@ -725,11 +1143,62 @@ void PrestoServer::populateMemAndCPUInfo() {
   });
   REPORT_ADD_STAT_VALUE(kCounterNumQueryContexts, numContexts);
   cpuMon_.update();
+  if (driverConcurrencyController_ != nullptr) {
+    const auto maxDrivers =
+        driverConcurrencyController_->update(cpuMon_.getCPULoadPct());
+    taskManager_->setMaxDriversPerTask(maxDrivers);
+    REPORT_ADD_STAT_VALUE(kCounterMaxDriversPerTask, maxDrivers);
+  }
+
+  NodeLoad nodeLoad;
+  nodeLoad.cpuLoadPct = cpuMon_.getCPULoadPct();
+  nodeLoad.driverQueueSize = driverCPUExecutor()->getTaskQueueSize();
+  const auto driverCountStats = taskManager_->getDriverCountStats();
+  nodeLoad.numRunningDrivers = driverCountStats.numRunningDrivers;
+  nodeLoad.numBlockedDrivers = driverCountStats.numBlockedDrivers;
+  nodeLoad.numBlockedDriversByReason = taskManager_->getBlockedDriverCounts();
+  int64_t peakQueuedBytes{0};
+  PrestoExchangeSource::getMemoryUsage(
+      nodeLoad.exchangeQueuedBytes, peakQueuedBytes);
+  nodeLoad.memoryHeadroomBytes =
+      std::max<int64_t>(0, poolInfo.maxBytes - poolInfo.reservedBytes);
+  TaskAdmissionController::Load admissionLoad;
+  admissionLoad.numDrivers = nodeLoad.numRunningDrivers;
+  admissionLoad.memoryPct = poolInfo.maxBytes > 0
+      ? 100.0 * poolInfo.reservedBytes / poolInfo.maxBytes
+      : 0;
+  admissionLoad.cpuLoadPct = nodeLoad.cpuLoadPct;
+  taskManager_->updateAdmissionLoad(admissionLoad);
+  if (lifespanConcurrencyController_ != nullptr) {
+    const auto concurrentLifespans = lifespanConcurrencyController_->update(
+        admissionLoad.memoryPct, nodeLoad.cpuLoadPct);
+    taskManager_->setConcurrentLifespansPerTask(concurrentLifespans);
+    REPORT_ADD_STAT_VALUE(
+        kCounterConcurrentLifespansPerTask, concurrentLifespans);
+  }
+  taskManager_->spillIdleOutputBuffers(admissionLoad.memoryPct);
+  REPORT_ADD_STAT_VALUE(
+      kCounterNumSpilledOutputBuffers, taskManager_->numSpilledOutputBuffers());
+  REPORT_ADD_STAT_VALUE(kCounterNumTasksQueued, taskManager_->numQueuedTasks());
+  const auto now = std::chrono::steady_clock::now();
+  const auto spilledBytes = taskManager_->queryResources().totalSpilledBytes();
+  const auto elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+                             now - lastNodeLoadUpdate_)
+                             .count();
+  if (lastNodeLoadUpdate_.time_since_epoch().count() != 0 && elapsedMs > 0) {
+    nodeLoad.spilledBytesPerSec =
+        (spilledBytes - lastSpilledBytes_) * 1'000 / elapsedMs;
+  }
+  lastSpilledBytes_ = spilledBytes;
+  lastNodeLoadUpdate_ = now;
+
   **memoryInfo_.wlock() = std::move(memoryInfo);
+  *nodeLoad_.wlock() = nodeLoad;
 }
 
 void PrestoServer::runOperation(
     proxygen::HTTPMessage* message,
+    const std::string& body,
     proxygen::ResponseHandler* downstream) {
   try {
     ServerOperation op = buildServerOpFromHttpRequest(message);
@@ -737,6 +1206,24 @@ void PrestoServer::runOperation(
       case ServerOperation::Target::kConnector:
         http::sendOkResponse(downstream, connectorOperation(op, message));
         break;
+      case ServerOperation::Target::kCache:
+        http::sendOkResponse(downstream, cacheOperation(op, message, body));
+        break;
+      case ServerOperation::Target::kTask:
+        http::sendOkResponse(downstream, taskOperation(op, message));
+        break;
+      case ServerOperation::Target::kMemory:
+        http::sendOkResponse(downstream, memoryOperation(op));
+        break;
+      case ServerOperation::Target::kAllocator:
+        http::sendOkResponse(downstream, allocatorOperation(op, message));
+        break;
+      case ServerOperation::Target::kServer:
+        http::sendOkResponse(downstream, serverOperation(op));
+        break;
+      case ServerOperation::Target::kSystemConfig:
+        http::sendOkResponse(downstream, systemConfigOperation(op, message));
+        break;
     }
   } catch (const VeloxUserError& ex) {
     http::sendErrorResponse(downstream, ex.what());
@@ -761,6 +1248,246 @@ std::string PrestoServer::connectorOperation(
   }
 }
 
+std::string PrestoServer::cacheOperation(
+    const ServerOperation& op,
+    proxygen::HTTPMessage* message,
+    const std::string& body) {
+  VELOX_USER_CHECK_NOT_NULL(cacheWarmer_, "The AsyncDataCache is not set up");
+  switch (op.action) {
+    case ServerOperation::Action::kClearCache:
+      // The pinned entries stay.
+      cache_->clear();
+      return cache_->toString();
+    case ServerOperation::Action::kGetCacheStats:
+      return fmt::format(
+          "{}\n{}", cache_->toString(), cacheWarmer_->toString());
+    case ServerOperation::Action::kPrefetch: {
+      auto ranges = CacheWarmer::parseRanges(body);
+      const auto numRanges = ranges.size();
+      cacheWarmer_->prefetch(std::move(ranges));
+      return fmt::format("Prefetching {} ranges", numRanges);
+    }
+    case ServerOperation::Action::kPin: {
+      const auto name = message->getQueryParam("name");
+      auto ranges = CacheWarmer::parseRanges(body);
+      const auto numRanges = ranges.size();
+      cacheWarmer_->pin(name, std::move(ranges));
+      return fmt::format("Pinning {} ranges as '{}'", numRanges, name);
+    }
+    case ServerOperation::Action::kUnpin: {
+      const auto name = message->getQueryParam("name");
+      return fmt::format(
+          "Unpinned {} bytes of '{}'", cacheWarmer_->unpin(name), name);
+    }
+    default:
+      VELOX_USER_FAIL(
+          "Target '{}' does not support action '{}'",
+          ServerOperation::targetString(op.target),
+          ServerOperation::actionString(op.action));
+  }
+}
+
+std::string PrestoServer::taskOperation(
+    const ServerOperation& op,
+    proxygen::HTTPMessage* message) {
+  const auto tasks = taskManager_->tasks();
+  switch (op.action) {
+    case ServerOperation::Action::kListAll: {
+      std::stringstream out;
+      for (const auto& [taskId, prestoTask] : tasks) {
+        out << taskId << " "
+            << (prestoTask->task != nullptr
+                    ? exec::taskStateString(prestoTask->task->state())
+                    : "Planned")
+            << "\n";
+      }
+      return out.str();
+    }
+    case ServerOperation::Action::kGetDetail: {
+      const auto id = message->getQueryParam("id");
+      auto it = tasks.find(id);
+      VELOX_USER_CHECK(it != tasks.end(), "No task '{}'", id);
+      VELOX_USER_CHECK_NOT_NULL(
+          it->second->task, "Task '{}' has not started", id);
+      return it->second->task->toString();
+    }
+    case ServerOperation::Action::kListStuck: {
+      // The drivers on their threads for 'thresholdSec', by default the
+      // threshold of the watchdog.
+      const auto configuredSec =
+          SystemConfig::instance()->driverStuckThresholdSec();
+      VELOX_USER_CHECK_GT(
+          configuredSec,
+          0,
+          "The drivers are not watched, set {}",
+          SystemConfig::kDriverStuckThresholdSec);
+      const auto thresholdSec = message->getQueryParam("thresholdSec");
+      const std::chrono::seconds threshold{
+          thresholdSec.empty() ? configuredSec
+                               : folly::to<int32_t>(thresholdSec)};
+      std::stringstream out;
+      for (auto& driver : DriverWatchdog::stuckDrivers(threshold)) {
+        driver.stack = DriverWatchdog::captureStack(driver.threadId);
+        out << driver.toString() << "\n";
+      }
+      return out.str();
+    }
+    default:
+      VELOX_USER_FAIL(
+          "Target '{}' does not support action '{}'",
+          ServerOperation::targetString(op.target),
+          ServerOperation::actionString(op.action));
+  }
+}
+
+std::string PrestoServer::memoryOperation(const ServerOperation& op) {
+  switch (op.action) {
+    case ServerOperation::Action::kGetDetail: {
+      std::stringstream out;
+      out << velox::memory::MemoryAllocator::getInstance()->toString();
+      taskManager_->getQueryContextManager()->visitAllContexts(
+          [&](const protocol::QueryId& queryId,
+              const velox::core::QueryCtx* queryCtx) {
+            out << "\n"
+                << queryId << ": " << queryCtx->pool()->getCurrentBytes()
+                << " bytes";
+          });
+      return out.str();
+    }
+    default:
+      VELOX_USER_FAIL(
+          "Target '{}' does not support action '{}'",
+          ServerOperation::targetString(op.target),
+          ServerOperation::actionString(op.action));
+  }
+}
+
+std::string PrestoServer::serverOperation(const ServerOperation& op) {
+  switch (op.action) {
+    case ServerOperation::Action::kDrain:
+      if (!shuttingDown_) {
+        // Returns now, stop() returns when the tasks have drained.
+        std::thread([server = this]() { server->stop(); }).detach();
+      }
+      return "Draining";
+    case ServerOperation::Action::kGetDetail: {
+      // The remaining work of the running tasks.
+      json status = {
+          {"state", json(convertNodeState(nodeState()))},
+          {"draining", taskManager_->draining()}};
+      auto& tasks = status["tasks"] = json::array();
+      for (const auto& [taskId, prestoTask] : taskManager_->tasks()) {
+        if (prestoTask->task == nullptr ||
+            prestoTask->task->state() != exec::TaskState::kRunning) {
+          continue;
+        }
+        const auto taskStatus = prestoTask->updateStatus();
+        tasks.push_back(
+            {{"taskId", taskId},
+             {"queuedPartitionedDrivers", taskStatus.queuedPartitionedDrivers},
+             {"runningPartitionedDrivers",
+              taskStatus.runningPartitionedDrivers},
+             {"queuedPartitionedSplitsWeight",
+              taskStatus.queuedPartitionedSplitsWeight},
+             {"runningPartitionedSplitsWeight",
+              taskStatus.runningPartitionedSplitsWeight},
+             {"taskAgeInMillis", taskStatus.taskAgeInMillis}});
+      }
+      return status.dump();
+    }
+    default:
+      VELOX_USER_FAIL(
+          "Target '{}' does not support action '{}'",
+          ServerOperation::targetString(op.target),
+          ServerOperation::actionString(op.action));
+  }
+}
+
+std::string PrestoServer::allocatorOperation(
+    const ServerOperation& op,
+    proxygen::HTTPMessage* message) {
+  switch (op.action) {
+    case ServerOperation::Action::kGetDetail:
+      return memoryAllocatorDetail(
+          velox::memory::MemoryAllocator::getInstance());
+    case ServerOperation::Action::kTrim: {
+      // With cache=true the unpinned cache entries are dropped first.
+      const auto stats = trimMemory(
+          message->getQueryParam("cache") == "true" ? cache_.get() : nullptr);
+      REPORT_ADD_STAT_VALUE(kCounterNumMemoryTrims, 1);
+      REPORT_ADD_STAT_VALUE(
+          kCounterMemoryTrimReleasedBytes, stats.releasedBytes());
+      return stats.toString();
+    }
+    default:
+      VELOX_USER_FAIL(
+          "Target '{}' does not support action '{}'",
+          ServerOperation::targetString(op.target),
+          ServerOperation::actionString(op.action));
+  }
+}
+
+std::string PrestoServer::systemConfigOperation(
+    const ServerOperation& op,
+    proxygen::HTTPMessage* message) {
+  auto* systemConfig = SystemConfig::instance();
+  switch (op.action) {
+    case ServerOperation::Action::kSetProperty: {
+      const auto name = message->getQueryParam("name");
+      const auto value = message->getQueryParam("value");
+      VELOX_USER_CHECK(!name.empty(), "Missing 'name' parameter");
+      const auto previous = systemConfig->update({{name, value}});
+      applySystemConfigChanges(previous);
+      if (previous.empty()) {
+        return fmt::format("{} is already '{}'", name, value);
+      }
+      return fmt::format(
+          "Set {} to '{}', was '{}'", name, value, previous.at(name));
+    }
+    case ServerOperation::Action::kGetProperty: {
+      // All the properties without the 'name' parameter.
+      const auto name = message->getQueryParam("name");
+      if (name.empty()) {
+        return json(systemConfig->values()).dump();
+      }
+      return systemConfig->optionalProperty(name).value_or("");
+    }
+    case ServerOperation::Action::kReload: {
+      const auto previous = systemConfig->reload();
+      applySystemConfigChanges(previous);
+      json changes = json::object();
+      for (const auto& [name, value] : previous) {
+        changes[name] = systemConfig->optionalProperty(name).value_or("");
+      }
+      return changes.dump();
+    }
+    default:
+      VELOX_USER_FAIL(
+          "Target '{}' does not support action '{}'",
+          ServerOperation::targetString(op.target),
+          ServerOperation::actionString(op.action));
+  }
+}
+
+void PrestoServer::applySystemConfigChanges(
+    const std::unordered_map<std::string, std::string>& previous) {
+  auto* systemConfig = SystemConfig::instance();
+  if (previous.count(std::string(SystemConfig::kHttpExecThreads)) > 0) {
+    const auto numThreads = systemConfig->httpExecThreads();
+    LOG(INFO) << "Resizing the HTTP executor to " << numThreads << " threads";
+    httpServer_->setNumExecThreads(numThreads);
+  }
+  if (previous.count(std::string(SystemConfig::kMaxDriversPerTask)) > 0) {
+    if (driverConcurrencyController_ != nullptr) {
+      LOG(WARNING) << "The drivers per task are adapted to the CPU load, "
+                   << SystemConfig::kMaxDriversPerTask
+                   << " takes effect on restart";
+    } else {
+      taskManager_->setMaxDriversPerTask(systemConfig->maxDriversPerTask());
+    }
+  }
+}
+
 static protocol::Duration getUptime(
     std::chrono::steady_clock::time_point& start) {
   auto seconds = std::chrono::duration_cast<std::chrono::seconds>(
@@ -793,6 +1520,68 @@ void PrestoServer::reportServerInfo(proxygen::ResponseHandler* downstream) {
   http::sendOkResponse(downstream, json(serverInfo));
 }
 
+void PrestoServer::reportTableCacheStats(
+    proxygen::HTTPMessage* message,
+    proxygen::ResponseHandler* downstream) {
+  // Returns all the tracked tables unless 'limit' is given.
+  const auto& limit = message->getQueryParam("limit");
+  size_t maxTables = std::numeric_limits<size_t>::max();
+  if (!limit.empty()) {
+    try {
+      maxTables = folly::to<size_t>(limit);
+    } catch (const std::exception&) {
+      http::sendErrorResponse(
+          downstream,
+          fmt::format("Invalid limit '{}'", limit),
+          http::kHttpBadRequest);
+      return;
+    }
+  }
+  json tables = json::array();
+  for (const auto& [table, stats] :
+       taskManager_->tableCacheStats().topTables(maxTables)) {
+    tables.push_back(
+        {{"table", table},
+         {"numRamReads", stats.numRamReads},
+         {"ramReadBytes", stats.ramReadBytes},
+         {"numSsdReads", stats.numSsdReads},
+         {"ssdReadBytes", stats.ssdReadBytes},
+         {"numStorageReads", stats.numStorageReads},
+         {"storageReadBytes", stats.storageReadBytes},
+         {"hitPct", stats.hitPct()}});
+  }
+  http::sendOkResponse(downstream, tables);
+}
+
+void PrestoServer::reportQueryResources(proxygen::ResponseHandler* downstream) {
+  // The current memory of the running queries comes from their contexts, one
+  // per query, the rest from the finished tasks.
+  std::unordered_map<std::string, int64_t> currentMemoryBytes;
+  taskManager_->getQueryContextManager()->visitAllContexts(
+      [&](const protocol::QueryId& queryId,
+          const velox::core::QueryCtx* queryCtx) {
+        currentMemoryBytes[queryId] = queryCtx->pool()->getCurrentBytes();
+      });
+  json queries = json::array();
+  for (const auto& [queryId, resources] :
+       taskManager_->queryResources().snapshot(velox::getCurrentTimeMs())) {
+    auto it = currentMemoryBytes.find(queryId);
+    queries.push_back(
+        {{"queryId", queryId},
+         {"numFinishedTasks", resources.numTasks},
+         {"cpuNanos", resources.cpuNanos},
+         {"wallNanos", resources.wallNanos},
+         {"peakMemoryBytes", resources.peakMemoryBytes},
+         {"currentMemoryBytes",
+          it == currentMemoryBytes.end() ? 0 : it->second},
+         {"spilledBytes", resources.spilledBytes},
+         {"exchangeInputBytes", resources.exchangeInputBytes},
+         {"exchangeOutputBytes", resources.exchangeOutputBytes},
+         {"lastUpdateMs", resources.lastUpdateMs}});
+  }
+  http::sendOkResponse(downstream, queries);
+}
+
 void PrestoServer::reportNodeStatus(proxygen::ResponseHandler* downstream) {
   auto systemConfig = SystemConfig::instance();
   const int64_t nodeMemoryGb =
@@ -819,7 +1608,20 @@ void PrestoServer::reportNodeStatus(proxygen::ResponseHandler* downstream) {
       nodeMemoryGb * 1024 * 1024 * 1024,
       nonHeapUsed};
 
-  http::sendOkResponse(downstream, json(nodeStatus));
+  // Appends the load snapshot of the last periodic update. The coordinator
+  // ignores the fields it does not know.
+  json status = nodeStatus;
+  const auto nodeLoad = nodeLoad_.copy();
+  status["load"] = {
+      {"cpuLoadPct", nodeLoad.cpuLoadPct},
+      {"driverQueueSize", nodeLoad.driverQueueSize},
+      {"numRunningDrivers", nodeLoad.numRunningDrivers},
+      {"numBlockedDrivers", nodeLoad.numBlockedDrivers},
+      {"numBlockedDriversByReason", nodeLoad.numBlockedDriversByReason},
+      {"exchangeQueuedBytes", nodeLoad.exchangeQueuedBytes},
+      {"memoryHeadroomBytes", nodeLoad.memoryHeadroomBytes},
+      {"spilledBytesPerSec", nodeLoad.spilledBytesPerSec}};
+  http::sendOkResponse(downstream, status);
 }
 
 } // namespace facebook::presto
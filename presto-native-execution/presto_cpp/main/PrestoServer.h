@@ -20,6 +20,8 @@
 #include <velox/exec/Task.h>
 #include <velox/expression/Expr.h>
 #include "presto_cpp/main/CPUMon.h"
+#include "presto_cpp/main/DriverConcurrencyController.h"
+#include "presto_cpp/main/LifespanConcurrencyController.h"
 #include "velox/common/caching/AsyncDataCache.h"
 #include "velox/common/memory/MemoryAllocator.h"
 #if __has_include("filesystem")
@@ -57,6 +59,8 @@ namespace facebook::presto {
 enum class NodeState { ACTIVE, INACTIVE, SHUTTING_DOWN };
 
 struct ServerOperation;
+class Announcer;
+class CacheWarmer;
 class SignalHandler;
 class TaskManager;
 class TaskResource;
@@ -87,6 +91,8 @@ class PrestoServer {
 
   virtual std::function<folly::SocketAddress()> discoveryAddressLookup();
 
+  /// Returns the listener of the completed tasks, by default the TaskStatsLog
+  /// if its directory is configured.
   virtual std::shared_ptr<velox::exec::TaskListener> getTaskListener();
 
   virtual std::shared_ptr<velox::exec::ExprSetListener> getExprSetListener();
@@ -101,6 +107,11 @@ class PrestoServer {
 
   virtual void registerCustomOperators();
 
+  /// Registers the scalar, aggregate and window functions. Runs on a thread
+  /// of its own concurrently with the rest of the startup, so it must only
+  /// touch the function registries.
+  virtual void registerFunctions();
+
   virtual void registerVectorSerdes();
 
   virtual void registerFileSystems();
@@ -125,17 +136,51 @@ class PrestoServer {
 
   void reportNodeStatus(proxygen::ResponseHandler* downstream);
 
+  void reportTableCacheStats(
+      proxygen::HTTPMessage* message,
+      proxygen::ResponseHandler* downstream);
+
+  void reportQueryResources(proxygen::ResponseHandler* downstream);
+
   void populateMemAndCPUInfo();
 
-  /// Invoked to run operation on this server per http request.
+  /// Invoked to run operation on this server per http request. 'body' is the
+  /// body of a POST request, empty for a GET.
   void runOperation(
       proxygen::HTTPMessage* message,
+      const std::string& body,
       proxygen::ResponseHandler* downstream);
 
   std::string connectorOperation(
       const ServerOperation& op,
       proxygen::HTTPMessage* message);
 
+  std::string cacheOperation(
+      const ServerOperation& op,
+      proxygen::HTTPMessage* message,
+      const std::string& body);
+
+  std::string taskOperation(
+      const ServerOperation& op,
+      proxygen::HTTPMessage* message);
+
+  std::string memoryOperation(const ServerOperation& op);
+
+  std::string allocatorOperation(
+      const ServerOperation& op,
+      proxygen::HTTPMessage* message);
+
+  std::string serverOperation(const ServerOperation& op);
+
+  std::string systemConfigOperation(
+      const ServerOperation& op,
+      proxygen::HTTPMessage* message);
+
+  /// Applies the changes of the system config properties that are not read
+  /// at use. 'previous' are the previous values of the changed properties.
+  void applySystemConfigChanges(
+      const std::unordered_map<std::string, std::string>& previous);
+
   const std::string configDirectoryPath_;
 
   // Executor for background writing into SSD cache.
@@ -144,9 +189,25 @@ class PrestoServer {
   // Executor for async IO for connectors.
   std::unique_ptr<folly::IOThreadPoolExecutor> connectorIoExecutor_;
 
+  // Executor for the ranges of the parallel reads of the remote files.
+  std::unique_ptr<folly::IOThreadPoolExecutor> storageReadExecutor_;
+
+  // Executor for writing the files of the local persistent shuffle.
+  std::unique_ptr<folly::IOThreadPoolExecutor> shuffleWriteExecutor_;
+
+  // Executor for prefetching the blocks of the local persistent shuffle.
+  std::unique_ptr<folly::IOThreadPoolExecutor> shuffleReadExecutor_;
+
+  // Executor for reading the shuffle blocks of the batch exchange sources.
+  std::unique_ptr<folly::IOThreadPoolExecutor> shuffleExchangeExecutor_;
+
   // Instance of AsyncDataCache used for all large allocations.
   std::shared_ptr<velox::cache::AsyncDataCache> cache_;
 
+  // Runs the prefetch and pin operations on 'cache_'. Holds the pinned
+  // entries, so it is destroyed before 'cache_'.
+  std::unique_ptr<CacheWarmer> cacheWarmer_;
+
   std::unique_ptr<http::HttpServer> httpServer_;
   std::unique_ptr<SignalHandler> signalHandler_;
   std::unique_ptr<TaskManager> taskManager_;
@@ -155,12 +216,41 @@ class PrestoServer {
   std::atomic_bool shuttingDown_{false};
   std::chrono::steady_clock::time_point start_;
   std::unique_ptr<PeriodicTaskManager> periodicTaskManager_;
+  // Null if there is no discovery service.
+  std::unique_ptr<Announcer> announcer_;
 
   // We update these members asynchronously and return in http requests w/o
   // delay.
   folly::Synchronized<std::unique_ptr<protocol::MemoryInfo>> memoryInfo_;
   CPUMon cpuMon_;
 
+  // The utilization of the node reported with its status for the load-aware
+  // scheduling on the coordinator.
+  struct NodeLoad {
+    double cpuLoadPct{0};
+    size_t driverQueueSize{0};
+    size_t numRunningDrivers{0};
+    size_t numBlockedDrivers{0};
+    // The blocked drivers by the reason they are blocked for.
+    std::unordered_map<std::string, size_t> numBlockedDriversByReason;
+    int64_t exchangeQueuedBytes{0};
+    // The query memory left before the node memory limit.
+    int64_t memoryHeadroomBytes{0};
+    // The spilled bytes per second of the tasks finished since the last
+    // update.
+    int64_t spilledBytesPerSec{0};
+  };
+  folly::Synchronized<NodeLoad> nodeLoad_;
+  // The spill total and time of the last 'nodeLoad_' update.
+  int64_t lastSpilledBytes_{0};
+  std::chrono::steady_clock::time_point lastNodeLoadUpdate_;
+  // Adapts the drivers of the new tasks to the CPU load if enabled.
+  std::unique_ptr<DriverConcurrencyController> driverConcurrencyController_;
+  // Adapts the concurrent lifespans of the new tasks to the memory and CPU
+  // headroom if enabled.
+  std::unique_ptr<LifespanConcurrencyController>
+      lifespanConcurrencyController_;
+
   std::string environment_;
   std::string nodeVersion_;
   std::string nodeId_;
@@ -13,6 +13,7 @@
  */
 
 #include "PrestoTask.h"
+#include "presto_cpp/external/xxh3.h"
 #include "presto_cpp/main/common/Exception.h"
 #include "presto_cpp/main/common/Utils.h"
 #include "velox/common/base/Exceptions.h"
@@ -160,6 +161,27 @@ static void addSpillingOperatorMetrics(
 
 } // namespace
 
+VersionedJson::Update VersionedJson::update(
+    nlohmann::json document,
+    uint64_t knownVersion) {
+  std::lock_guard<std::mutex> l(mutex_);
+  if (version_ != 0 && document == document_) {
+    if (knownVersion == version_) {
+      return {version_, true, false, nullptr};
+    }
+    return {version_, false, false, document_};
+  }
+
+  const auto previousVersion = version_;
+  auto previous = std::move(document_);
+  document_ = std::move(document);
+  ++version_;
+  if (previousVersion != 0 && knownVersion == previousVersion) {
+    return {version_, false, true, nlohmann::json::diff(previous, document_)};
+  }
+  return {version_, false, false, document_};
+}
+
 PrestoTask::PrestoTask(const std::string& taskId, const std::string& nodeId)
     : id(taskId) {
   info.taskId = taskId;
@@ -206,6 +228,13 @@ protocol::TaskStatus PrestoTask::updateStatusLocked() {
   info.taskStatus.queuedPartitionedDrivers = taskStats.numQueuedSplits;
   info.taskStatus.runningPartitionedDrivers = taskStats.numRunningSplits;
 
+  numBlockedDrivers.clear();
+  for (const auto& [reason, numDrivers] : taskStats.numBlockedDrivers) {
+    if (reason != velox::exec::BlockingReason::kNotBlocked && numDrivers > 0) {
+      numBlockedDrivers.emplace(reason, numDrivers);
+    }
+  }
+
   // TODO(spershin): Note, we dont' clean the stats.completedSplitGroups
   // and it seems not required now, but we might want to do it one day.
   for (auto splitGroupId : taskStats.completedSplitGroups) {
@@ -220,6 +249,19 @@ protocol::TaskStatus PrestoTask::updateStatusLocked() {
       task->queryCtx()->pool()->getMemoryUsageTracker()->peakBytes();
   ;
 
+  // The coordinator adds writer tasks as the written bytes grow. These are
+  // the bytes the data sinks wrote to the files, not the in-memory size of
+  // the rows the writers took.
+  info.taskStatus.physicalWrittenDataSizeInBytes = 0;
+  for (const auto& pipeline : taskStats.pipelineStats) {
+    for (const auto& op : pipeline.operatorStats) {
+      if (op.operatorType == "TableWrite") {
+        info.taskStatus.physicalWrittenDataSizeInBytes +=
+            op.physicalWrittenBytes;
+      }
+    }
+  }
+
   if (task->error() && info.taskStatus.failures.empty()) {
     info.taskStatus.failures.emplace_back(toPrestoError(task->error()));
   }
@@ -253,6 +295,9 @@ protocol::TaskInfo PrestoTask::updateInfoLocked() {
   prestoTaskStats.lastEndTime =
       util::toISOTimestamp(taskStats.executionEndTimeMs);
   prestoTaskStats.endTime = util::toISOTimestamp(taskStats.executionEndTimeMs);
+  prestoTaskStats.queuedTimeInNanos = !taskStarted && admissionQueuedMs > 0
+      ? (velox::getCurrentTimeMs() - admissionQueuedMs) * 1'000'000
+      : admissionWaitNanos;
   if (taskStats.executionEndTimeMs > taskStats.executionStartTimeMs) {
     prestoTaskStats.elapsedTimeInNanos =
         (taskStats.executionEndTimeMs - taskStats.executionStartTimeMs) *
@@ -287,6 +332,7 @@ protocol::TaskInfo PrestoTask::updateInfoLocked() {
   prestoTaskStats.pipelines.resize(taskStats.pipelineStats.size());
 
   std::unordered_map<std::string, RuntimeMetric> taskRuntimeStats;
+  int64_t writtenFiles = 0;
 
   if (taskStats.endTimeMs >= taskStats.executionEndTimeMs) {
     taskRuntimeStats["outputConsumedDelayInNanos"].addValue(
@@ -311,6 +357,7 @@ protocol::TaskInfo PrestoTask::updateInfoLocked() {
     pipelineOut.userMemoryReservationInBytes = {};
     pipelineOut.revocableMemoryReservationInBytes = {};
     pipelineOut.systemMemoryReservationInBytes = {};
+    pipelineOut.physicalWrittenDataSizeInBytes = {};
 
     // tasks may fail before any operators are created;
     // collect stats only when we have operators
@@ -413,6 +460,15 @@ protocol::TaskInfo PrestoTask::updateInfoLocked() {
       opOut.spilledDataSize =
           protocol::DataSize(op.spilledBytes, protocol::DataUnit::BYTE);
 
+      // The table writers write their input into one file per driver, which
+      // outputs one row.
+      if (op.operatorType == "TableWrite") {
+        opOut.physicalWrittenDataSize = protocol::DataSize(
+            op.physicalWrittenBytes, protocol::DataUnit::BYTE);
+        pipelineOut.physicalWrittenDataSizeInBytes += op.physicalWrittenBytes;
+        writtenFiles += op.outputPositions;
+      }
+
       for (const auto& stat : op.runtimeStats) {
         auto statName =
             fmt::format("{}.{}.{}", op.operatorType, op.planNodeId, stat.first);
@@ -466,6 +522,26 @@ protocol::TaskInfo PrestoTask::updateInfoLocked() {
       taskRuntimeStats, "drivers.completed", taskStats.numCompletedDrivers);
   addRuntimeMetricIfNotZero(
       taskRuntimeStats, "drivers.terminated", taskStats.numTerminatedDrivers);
+  if (filterConversionNanos > 0) {
+    addRuntimeMetric(
+        taskRuntimeStats,
+        "filterConversionNanos",
+        createVeloxRuntimeMetric(
+            filterConversionNanos, RuntimeCounter::Unit::kNanos));
+  }
+  addRuntimeMetricIfNotZero(
+      taskRuntimeStats, "numPrunedSplits", numPrunedSplits);
+  prestoTaskStats.physicalWrittenDataSizeInBytes =
+      info.taskStatus.physicalWrittenDataSizeInBytes;
+  if (prestoTaskStats.physicalWrittenDataSizeInBytes > 0) {
+    addRuntimeMetric(
+        taskRuntimeStats,
+        "writtenBytes",
+        createVeloxRuntimeMetric(
+            prestoTaskStats.physicalWrittenDataSizeInBytes,
+            RuntimeCounter::Unit::kBytes));
+  }
+  addRuntimeMetricIfNotZero(taskRuntimeStats, "writtenFiles", writtenFiles);
   for (const auto it : taskStats.numBlockedDrivers) {
     addRuntimeMetricIfNotZero(
         taskRuntimeStats,
@@ -502,6 +578,10 @@ protocol::TaskInfo PrestoTask::updateInfoLocked() {
   return str;
 }
 
+size_t TaskIdHash::operator()(const protocol::TaskId& taskId) const {
+  return XXH3_64bits(taskId.data(), taskId.size());
+}
+
 protocol::RuntimeMetric toRuntimeMetric(
     const std::string& name,
     const RuntimeMetric& metric) {
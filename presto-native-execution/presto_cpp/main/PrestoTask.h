@@ -13,7 +13,11 @@
  */
 #pragma once
 
+#include <atomic>
+#include <optional>
 #include <memory>
+#include "presto_cpp/main/SplitPruner.h"
+#include "presto_cpp/main/operators/FragmentResult.h"
 #include "presto_cpp/main/types/PrestoTaskId.h"
 #include "presto_cpp/presto_protocol/presto_protocol.h"
 #include "velox/exec/Task.h"
@@ -55,6 +59,9 @@ struct Result {
   int64_t nextSequence;
   std::unique_ptr<folly::IOBuf> data;
   bool complete;
+  // Set to the uncompressed size of 'data' if it is compressed for the
+  // consumer.
+  uint64_t uncompressedSize{0};
 };
 
 struct ResultRequest {
@@ -65,6 +72,43 @@ struct ResultRequest {
   protocol::DataSize maxSize;
 };
 
+/// The header carrying the version of the TaskStatus or TaskInfo last seen
+/// by the client in a request and the version of the returned document in a
+/// response. Clients which send it opt into the versioned replies of
+/// VersionedJson.
+constexpr std::string_view kPrestoTaskInfoVersionHeader{
+    "X-Presto-Task-Info-Version"};
+
+/// Tracks the versions of a JSON document polled repeatedly by a client, e.g.
+/// the TaskInfo of a task, to reply with only what changed since the version
+/// the client saw last. Only the latest version is kept.
+class VersionedJson {
+ public:
+  struct Update {
+    /// The version of the current document.
+    uint64_t version;
+    /// True if the document did not change since the version known to the
+    /// client. 'body' is null then.
+    bool notModified{false};
+    /// True if 'body' is a JSON patch (RFC 6902) to apply to the version known
+    /// to the client instead of the whole document.
+    bool delta{false};
+    nlohmann::json body;
+  };
+
+  /// Records 'document' as the current version of the document, which bumps
+  /// the version if it differs from the previous one. Returns the reply to a
+  /// client which knows 'knownVersion' of the document, i.e. the patch from
+  /// 'knownVersion' if it is the previous version, nothing if it is the
+  /// current one and the whole document otherwise.
+  Update update(nlohmann::json document, uint64_t knownVersion);
+
+ private:
+  std::mutex mutex_;
+  uint64_t version_{0};
+  nlohmann::json document_;
+};
+
 struct PrestoTask {
   const PrestoTaskId id;
   std::shared_ptr<velox::exec::Task> task;
@@ -74,7 +118,9 @@ struct PrestoTask {
   // When you create task from 'delete task' - it has never been started.
   // When you create task from any other endpoint, such as 'get result' - it has
   // not been started, until the actual 'create task' message comes.
-  bool taskStarted{false};
+  // Set under both 'mutex' and 'resultRequestsMutex', read without either by
+  // the result requests.
+  std::atomic_bool taskStarted{false};
 
   uint64_t lastHeartbeatMs{0};
   mutable std::mutex mutex;
@@ -85,9 +131,13 @@ struct PrestoTask {
   /// Contains state info but is never returned.
   protocol::TaskInfo info;
 
+  /// Guards 'resultRequests'. Separate from 'mutex' so that the result
+  /// requests never wait for a task update or a TaskInfo rebuild.
+  std::mutex resultRequestsMutex;
+
   /// Pending result requests keyed on buffer ID. May arrive before 'task' is
-  /// created. May be accessed on different threads outside of 'mutex', hence
-  /// shared_ptr to define lifetime.
+  /// created. May be accessed on different threads outside of
+  /// 'resultRequestsMutex', hence shared_ptr to define lifetime.
   std::unordered_map<int64_t, std::shared_ptr<ResultRequest>> resultRequests;
 
   /// Pending status request. May arrive before there is a Task.
@@ -96,6 +146,59 @@ struct PrestoTask {
   /// Info request. May arrive before there is a Task.
   PromiseHolderWeakPtr<std::unique_ptr<protocol::TaskInfo>> infoRequest;
 
+  /// The versions of the TaskStatus and TaskInfo documents returned to the
+  /// clients which poll them with versioned requests.
+  VersionedJson statusVersions;
+  VersionedJson infoVersions;
+
+  /// The state last published to the task state subscribers of the query.
+  /// Unset until the first publication.
+  std::optional<protocol::TaskState> publishedState;
+
+  /// Time spent converting the TupleDomains of the plan to Velox filters.
+  /// Zero if the plan came from the plan fragment cache.
+  uint64_t filterConversionNanos{0};
+
+  /// The state the task is counted in by TaskManager::getTaskNumbers() or -1
+  /// if it is not counted.
+  int countedState{-1};
+
+  /// Skips the splits which produce no rows. Null if the plan has no filters
+  /// to skip splits with.
+  std::shared_ptr<SplitPruner> splitPruner;
+
+  /// The number of splits skipped by 'splitPruner'.
+  uint64_t numPrunedSplits{0};
+
+  /// Records the rows of the task to cache under 'fragmentResultKey' when it
+  /// finishes. Null if the results of the task are not cached.
+  std::shared_ptr<operators::FragmentResultRecorder> fragmentResultRecorder;
+  std::string fragmentResultKey;
+
+  /// True if the task is served its rows by the fragment result cache and
+  /// does not read its splits.
+  bool usesCachedResult{false};
+
+  /// The time in ms at which the task was queued for the load of the node to
+  /// drop or 0 if it was not queued.
+  uint64_t admissionQueuedMs{0};
+
+  /// The time the task waited for admission, set when it starts.
+  uint64_t admissionWaitNanos{0};
+
+  /// The number of drivers of 'task' blocked for each reason, as of the last
+  /// update of the status. Saves the pollers of the node load from copying
+  /// the stats of every task.
+  std::unordered_map<velox::exec::BlockingReason, int64_t> numBlockedDrivers;
+
+  /// The last update of the broadcast output buffers received while the task
+  /// waited for admission, applied when it starts.
+  std::optional<protocol::OutputBuffers> queuedOutputBuffers;
+
+  /// The size of the next result response of a root stage task. Grows while
+  /// the responses fill up. 0 until the first response.
+  std::atomic<uint64_t> resultMaxBytes{0};
+
   explicit PrestoTask(const std::string& taskId, const std::string& nodeId);
 
   /// Updates when this task was touched last time.
@@ -123,8 +226,14 @@ struct PrestoTask {
   protocol::TaskInfo updateInfoLocked();
 };
 
-using TaskMap =
-    std::unordered_map<protocol::TaskId, std::shared_ptr<PrestoTask>>;
+/// Hashes the task ids with xxh3, which is faster than std::hash on strings
+/// as long as the task ids. The task maps are looked up on every request.
+struct TaskIdHash {
+  size_t operator()(const protocol::TaskId& taskId) const;
+};
+
+using TaskMap = std::
+    unordered_map<protocol::TaskId, std::shared_ptr<PrestoTask>, TaskIdHash>;
 
 protocol::RuntimeMetric toRuntimeMetric(
     const std::string& name,
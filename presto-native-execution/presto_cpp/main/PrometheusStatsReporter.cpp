@@ -0,0 +1,190 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/PrometheusStatsReporter.h"
+#include <fmt/format.h>
+#include <algorithm>
+
+namespace facebook::presto {
+
+PrometheusStatsReporter::Metric::Metric(
+    std::string_view _name,
+    int64_t _bucketWidth,
+    int64_t _min,
+    int64_t _max)
+    : name(_name),
+      statType(velox::StatType::AVG),
+      histogram(true),
+      // Widens the buckets to keep at most kMaxHistogramBuckets of them.
+      bucketWidth(std::max<int64_t>(
+          std::max<int64_t>(_bucketWidth, 1),
+          (_max - _min + kMaxHistogramBuckets - 1) / kMaxHistogramBuckets)),
+      min(_min),
+      max(std::max(_min, _max)),
+      buckets((max - min + bucketWidth - 1) / bucketWidth + 1) {}
+
+void PrometheusStatsReporter::Metric::add(int64_t value) {
+  sum.increment(value);
+  count.increment(1);
+  if (!histogram) {
+    return;
+  }
+  size_t bucket;
+  if (value > max) {
+    bucket = buckets.size() - 1;
+  } else if (value <= min) {
+    bucket = 0;
+  } else {
+    bucket = std::min<size_t>(
+        (value - min - 1) / bucketWidth, buckets.size() - 2);
+  }
+  buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+PrometheusStatsReporter::Metric* PrometheusStatsReporter::insertMetric(
+    std::shared_ptr<Metric> metric) const {
+  const std::string_view key = metric->name;
+  return metrics_.insert(key, std::move(metric)).first->second.get();
+}
+
+void PrometheusStatsReporter::registerStat(
+    std::string_view key,
+    velox::StatType statType) const {
+  insertMetric(std::make_shared<Metric>(key, statType));
+}
+
+void PrometheusStatsReporter::registerHistogram(
+    std::string_view key,
+    int64_t bucketWidth,
+    int64_t min,
+    int64_t max) const {
+  insertMetric(std::make_shared<Metric>(key, bucketWidth, min, max));
+}
+
+PrometheusStatsReporter::Metric* PrometheusStatsReporter::findOrAddMetric(
+    std::string_view key) const {
+  auto it = metrics_.find(key);
+  if (it != metrics_.cend()) {
+    return it->second.get();
+  }
+  return insertMetric(std::make_shared<Metric>(key, velox::StatType::AVG));
+}
+
+void PrometheusStatsReporter::addValue(std::string_view key, size_t value)
+    const {
+  findOrAddMetric(key)->add(static_cast<int64_t>(value));
+}
+
+StatsCounter::StatsCounter(
+    folly::StringPiece key,
+    std::shared_ptr<velox::BaseStatsReporter> reporter)
+    : key_(key) {
+  std::call_once(resolved_, [&]() { resolve(std::move(reporter)); });
+}
+
+void StatsCounter::resolve(
+    std::shared_ptr<velox::BaseStatsReporter> reporter) const {
+  auto* prometheusReporter =
+      dynamic_cast<const PrometheusStatsReporter*>(reporter.get());
+  if (prometheusReporter == nullptr) {
+    return;
+  }
+  metric_ = prometheusReporter->findOrAddMetric(
+      std::string_view(key_.data(), key_.size()));
+  reporter_ = std::move(reporter);
+}
+
+std::string PrometheusStatsReporter::sanitizeName(std::string_view name) {
+  std::string sanitized(name);
+  for (size_t i = 0; i < sanitized.size(); ++i) {
+    const char c = sanitized[i];
+    const bool valid = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+        c == '_' || c == ':' || (i > 0 && c >= '0' && c <= '9');
+    if (!valid) {
+      sanitized[i] = '_';
+    }
+  }
+  return sanitized;
+}
+
+std::string PrometheusStatsReporter::toPrometheusText() const {
+  std::vector<std::pair<std::string, const Metric*>> metrics;
+  for (const auto& [key, metric] : metrics_) {
+    metrics.emplace_back(sanitizeName(key), metric.get());
+  }
+  std::sort(metrics.begin(), metrics.end(), [](const auto& a, const auto& b) {
+    return a.first < b.first;
+  });
+
+  std::string text;
+  for (const auto& [name, metric] : metrics) {
+    if (metric->histogram) {
+      fmt::format_to(std::back_inserter(text), "# TYPE {} histogram\n", name);
+      // The counts of the buckets are read one at a time, so the total may
+      // lag the sum and count of a histogram updated while scraped.
+      int64_t cumulative = 0;
+      for (int64_t i = 0; i + 1 < metric->buckets.size(); ++i) {
+        cumulative += metric->buckets[i].load(std::memory_order_relaxed);
+        fmt::format_to(
+            std::back_inserter(text),
+            "{}_bucket{{le=\"{}\"}} {}\n",
+            name,
+            std::min(
+                metric->min + (i + 1) * metric->bucketWidth, metric->max),
+            cumulative);
+      }
+      cumulative += metric->buckets.back().load(std::memory_order_relaxed);
+      fmt::format_to(
+          std::back_inserter(text),
+          "{}_bucket{{le=\"+Inf\"}} {}\n{}_sum {}\n{}_count {}\n",
+          name,
+          cumulative,
+          name,
+          metric->sum.readFull(),
+          name,
+          cumulative);
+      continue;
+    }
+    switch (metric->statType) {
+      case velox::StatType::AVG:
+        fmt::format_to(
+            std::back_inserter(text),
+            "# TYPE {} summary\n{}_sum {}\n{}_count {}\n",
+            name,
+            name,
+            metric->sum.readFull(),
+            name,
+            metric->count.readFull());
+        break;
+      case velox::StatType::COUNT:
+        fmt::format_to(
+            std::back_inserter(text),
+            "# TYPE {} counter\n{} {}\n",
+            name,
+            name,
+            metric->count.readFull());
+        break;
+      default:
+        fmt::format_to(
+            std::back_inserter(text),
+            "# TYPE {} counter\n{} {}\n",
+            name,
+            name,
+            metric->sum.readFull());
+        break;
+    }
+  }
+  return text;
+}
+
+} // namespace facebook::presto
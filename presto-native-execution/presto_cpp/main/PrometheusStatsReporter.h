@@ -0,0 +1,215 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <folly/Singleton.h>
+#include <folly/ThreadCachedInt.h>
+#include <folly/concurrency/ConcurrentHashMap.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "velox/common/base/StatsReporter.h"
+
+namespace facebook::presto {
+
+/// Stats reporter that aggregates the counters in the worker itself and
+/// renders them in the Prometheus text exposition format, served on
+/// /v1/metrics, so a worker is scraped without an extra agent. Adding a value
+/// does not lock: the sums and counts are thread cached and only summed up
+/// over the threads on a scrape, the histogram buckets are relaxed atomics.
+///
+/// AVG stats are exported as summaries (_sum and _count, no quantiles), SUM
+/// and RATE stats as counters of the sum of the values and COUNT stats as
+/// counters of the number of values. Histograms are exported with cumulative
+/// buckets: the quantiles are computed by the Prometheus server, so the
+/// registered percentiles are not used. A value of a key that was not
+/// registered is exported as an AVG stat.
+class PrometheusStatsReporter : public velox::BaseStatsReporter {
+ public:
+  /// The histograms are kept in at most this many buckets, plus the overflow
+  /// one, whatever their registered bucket width.
+  static constexpr int64_t kMaxHistogramBuckets{50};
+
+  void addStatExportType(const char* key, velox::StatType statType)
+      const override {
+    registerStat(key, statType);
+  }
+
+  void addStatExportType(folly::StringPiece key, velox::StatType statType)
+      const override {
+    registerStat(std::string_view(key.data(), key.size()), statType);
+  }
+
+  void addHistogramExportPercentile(
+      const char* key,
+      int64_t bucketWidth,
+      int64_t min,
+      int64_t max,
+      const std::vector<int32_t>& /*pcts*/) const override {
+    registerHistogram(key, bucketWidth, min, max);
+  }
+
+  void addHistogramExportPercentile(
+      folly::StringPiece key,
+      int64_t bucketWidth,
+      int64_t min,
+      int64_t max,
+      const std::vector<int32_t>& /*pcts*/) const override {
+    registerHistogram(
+        std::string_view(key.data(), key.size()), bucketWidth, min, max);
+  }
+
+  void addStatValue(const std::string& key, size_t value = 1) const override {
+    addValue(key, value);
+  }
+
+  void addStatValue(const char* key, size_t value = 1) const override {
+    addValue(key, value);
+  }
+
+  void addStatValue(folly::StringPiece key, size_t value = 1) const override {
+    addValue(std::string_view(key.data(), key.size()), value);
+  }
+
+  void addHistogramValue(const std::string& key, size_t value) const override {
+    addValue(key, value);
+  }
+
+  void addHistogramValue(const char* key, size_t value) const override {
+    addValue(key, value);
+  }
+
+  void addHistogramValue(folly::StringPiece key, size_t value) const override {
+    addValue(std::string_view(key.data(), key.size()), value);
+  }
+
+  /// Returns all the metrics in the Prometheus text exposition format, sorted
+  /// by name.
+  std::string toPrometheusText() const;
+
+  /// Returns 'name' with the characters Prometheus does not allow in metric
+  /// names replaced by '_', e.g. presto_cpp_num_tasks for presto_cpp.num_tasks.
+  static std::string sanitizeName(std::string_view name);
+
+  struct Metric {
+    Metric(std::string_view _name, velox::StatType _statType)
+        : name(_name), statType(_statType) {}
+
+    Metric(
+        std::string_view _name,
+        int64_t _bucketWidth,
+        int64_t _min,
+        int64_t _max);
+
+    void add(int64_t value);
+
+    // The key of the metric in 'metrics_'.
+    const std::string name;
+    const velox::StatType statType;
+    const bool histogram{false};
+    folly::ThreadCachedInt<int64_t> sum;
+    folly::ThreadCachedInt<int64_t> count;
+
+    // The values below 'min' count in the first bucket, the ones above
+    // 'max' in the overflow bucket at the end.
+    const int64_t bucketWidth{0};
+    const int64_t min{0};
+    const int64_t max{0};
+    std::vector<std::atomic<int64_t>> buckets;
+  };
+
+  /// Returns the metric of 'key', registered as an AVG stat if it was not
+  /// registered. The metric is valid for the life of the reporter, so the
+  /// callers may keep it to add values without looking up 'key', see
+  /// StatsCounter.
+  Metric* findOrAddMetric(std::string_view key) const;
+
+ private:
+  void registerStat(std::string_view key, velox::StatType statType) const;
+
+  void registerHistogram(
+      std::string_view key,
+      int64_t bucketWidth,
+      int64_t min,
+      int64_t max) const;
+
+  void addValue(std::string_view key, size_t value) const;
+
+  // Inserts 'metric' unless its key is taken. Returns the metric of the key.
+  Metric* insertMetric(std::shared_ptr<Metric> metric) const;
+
+  // The metrics are never erased or replaced, so a Metric stays valid for the
+  // life of the reporter once found. The keys are views of the names of the
+  // metrics, so that looking up a key does not allocate.
+  mutable folly::ConcurrentHashMap<std::string_view, std::shared_ptr<Metric>>
+      metrics_;
+};
+
+/// A stat or histogram resolved once for the hot paths which report it per
+/// page or per request. With a PrometheusStatsReporter, adding a value is a
+/// thread cached increment of its metric instead of a lookup by key. Other
+/// reporters are called by key. Keep it in a static, e.g.:
+///
+///   static const StatsCounter numOnBody(kCounterNumOnBody);
+///   numOnBody.addValue();
+///
+/// The counter resolves its metric on the first value, after the counters are
+/// registered by registerStatsCounters().
+class StatsCounter {
+ public:
+  explicit StatsCounter(folly::StringPiece key) : key_(key) {}
+
+  /// Resolves the metric of 'key' in 'reporter' right away.
+  StatsCounter(
+      folly::StringPiece key,
+      std::shared_ptr<velox::BaseStatsReporter> reporter);
+
+  void addValue(size_t value = 1) const {
+    if (auto* metric = resolve()) {
+      metric->add(static_cast<int64_t>(value));
+    } else {
+      REPORT_ADD_STAT_VALUE(key_, value);
+    }
+  }
+
+  void addHistogramValue(size_t value) const {
+    if (auto* metric = resolve()) {
+      metric->add(static_cast<int64_t>(value));
+    } else {
+      REPORT_ADD_HISTOGRAM_VALUE(key_, value);
+    }
+  }
+
+ private:
+  void resolve(std::shared_ptr<velox::BaseStatsReporter> reporter) const;
+
+  PrometheusStatsReporter::Metric* resolve() const {
+    std::call_once(resolved_, [&]() {
+      resolve(folly::Singleton<velox::BaseStatsReporter>::try_get());
+    });
+    return metric_;
+  }
+
+  const folly::StringPiece key_;
+  mutable std::once_flag resolved_;
+  // Keeps 'metric_' alive.
+  mutable std::shared_ptr<velox::BaseStatsReporter> reporter_;
+  // Null if the reporter is not a PrometheusStatsReporter.
+  mutable PrometheusStatsReporter::Metric* metric_{nullptr};
+};
+
+} // namespace facebook::presto
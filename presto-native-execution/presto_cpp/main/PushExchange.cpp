@@ -0,0 +1,165 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/PushExchange.h"
+
+#include <folly/SocketAddress.h>
+
+#include "presto_cpp/external/json/json.hpp"
+#include "presto_cpp/main/PageChecksum.h"
+#include "presto_cpp/main/PrestoExchangeSource.h"
+#include "presto_cpp/main/QueryContextManager.h"
+#include "presto_cpp/main/common/Configs.h"
+
+namespace facebook::presto {
+namespace {
+velox::memory::MemoryPool* pushResponsePool() {
+  static auto pool =
+      velox::memory::addDefaultLeafMemoryPool("OutputBufferPusher");
+  return pool.get();
+}
+} // namespace
+
+std::string serializePushRegistration(const PushRegistration& registration) {
+  nlohmann::json json = {
+      {"uri", registration.uri},
+      {"token", registration.token},
+      {"credits", registration.credits}};
+  return json.dump();
+}
+
+PushRegistration parsePushRegistration(const std::string& body) {
+  const auto json = nlohmann::json::parse(body);
+  PushRegistration registration{
+      json.at("uri").get<std::string>(),
+      json.at("token").get<long>(),
+      json.at("credits").get<int64_t>()};
+  VELOX_USER_CHECK_GT(
+      registration.credits, 0, "Push registration must grant credits");
+  return registration;
+}
+
+OutputBufferPusher::OutputBufferPusher(
+    std::shared_ptr<velox::exec::PartitionedOutputBufferManager> bufferManager,
+    const protocol::TaskId& taskId,
+    int destination,
+    const PushRegistration& registration)
+    : bufferManager_(std::move(bufferManager)),
+      taskId_(taskId),
+      destination_(destination),
+      uri_(registration.uri),
+      httpClient_(PrestoExchangeSource::httpClientPool().getClient(
+          folly::SocketAddress(
+              folly::IPAddress(uri_.host()).str(), uri_.port(), true))),
+      checksumPages_(SystemConfig::instance()->enableSerializedPageChecksum()),
+      token_(registration.token),
+      credits_(registration.credits) {}
+
+bool OutputBufferPusher::start() {
+  return fetch();
+}
+
+bool OutputBufferPusher::fetch() {
+  auto bufferManager = bufferManager_.lock();
+  if (bufferManager == nullptr) {
+    return false;
+  }
+  VLOG(1) << "Fetching " << credits_ << " bytes to push for " << taskId_
+          << ", buffer " << destination_ << ", sequence " << token_;
+  auto self = shared_from_this();
+  return bufferManager->getData(
+      taskId_,
+      destination_,
+      credits_,
+      token_,
+      [self](
+          std::vector<std::unique_ptr<folly::IOBuf>> pages, int64_t sequence) {
+        bool complete = pages.empty();
+        int64_t nextSequence = sequence;
+        std::unique_ptr<folly::IOBuf> data;
+        for (auto& page : pages) {
+          if (page == nullptr) {
+            complete = true;
+            continue;
+          }
+          if (self->checksumPages_) {
+            setPageChecksum(*page);
+          }
+          if (data == nullptr) {
+            data = std::move(page);
+          } else {
+            data->prev()->appendChain(std::move(page));
+          }
+          ++nextSequence;
+        }
+        self->push(std::move(data), sequence, nextSequence, complete);
+      });
+}
+
+void OutputBufferPusher::push(
+    std::unique_ptr<folly::IOBuf> data,
+    int64_t sequence,
+    int64_t nextSequence,
+    bool complete) {
+  auto self = shared_from_this();
+  http::RequestBuilder()
+      .method(proxygen::HTTPMethod::POST)
+      .url(uri_.path())
+      .header(protocol::PRESTO_TASK_INSTANCE_ID_HEADER, taskId_)
+      .header(protocol::PRESTO_PAGE_TOKEN_HEADER, std::to_string(sequence))
+      .header(
+          protocol::PRESTO_PAGE_NEXT_TOKEN_HEADER, std::to_string(nextSequence))
+      .header(
+          protocol::PRESTO_BUFFER_COMPLETE_HEADER, complete ? "true" : "false")
+      .send(httpClient_.get(), pushResponsePool(), std::move(data))
+      .via(driverCPUExecutor())
+      .thenValue([self, nextSequence, complete](
+                     std::unique_ptr<http::HttpResponse> response) {
+        auto* headers = response->headers();
+        if (headers->getStatusCode() != http::kHttpOk) {
+          LOG(WARNING) << "Stopped pushing " << self->taskId_ << ", buffer "
+                       << self->destination_ << " to " << self->uri_.str()
+                       << ": HTTP " << headers->getStatusCode();
+          return;
+        }
+        if (auto bufferManager = self->bufferManager_.lock()) {
+          bufferManager->acknowledge(
+              self->taskId_, self->destination_, nextSequence);
+        }
+        if (complete) {
+          return;
+        }
+        self->token_ = nextSequence;
+        self->credits_ =
+            atol(headers->getHeaders()
+                     .getSingleOrEmpty(std::string(kPushCreditsHeader))
+                     .c_str());
+        if (self->credits_ <= 0) {
+          // Wait for the consumer to grant new credits.
+          self->push(nullptr, nextSequence, nextSequence, false);
+          return;
+        }
+        if (!self->fetch()) {
+          LOG(WARNING) << "Stopped pushing " << self->taskId_ << ", buffer "
+                       << self->destination_ << ": buffer not found";
+        }
+      })
+      .thenError(
+          folly::tag_t<std::exception>{}, [self](const std::exception& e) {
+            LOG(WARNING) << "Stopped pushing " << self->taskId_ << ", buffer "
+                         << self->destination_ << " to " << self->uri_.str()
+                         << ": " << e.what();
+          });
+}
+
+} // namespace facebook::presto
@@ -0,0 +1,91 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <folly/Uri.h>
+
+#include "presto_cpp/main/http/HttpClient.h"
+#include "presto_cpp/presto_protocol/presto_protocol.h"
+#include "velox/exec/PartitionedOutputBufferManager.h"
+
+namespace facebook::presto {
+
+/// The consumer endpoint path prefix the producers push the pages to. The
+/// full path is followed by the consumer's push id.
+constexpr std::string_view kPushPath{"/v1/exchange/push"};
+
+/// The header of a push response from the consumer which carries the number
+/// of bytes the consumer can accept next, i.e. the producer's credits.
+constexpr std::string_view kPushCreditsHeader{"X-Presto-Exchange-Credits"};
+
+/// The request of a consumer to have the pages of an output buffer pushed to
+/// 'uri' starting at 'token'. 'credits' is the number of bytes the consumer
+/// can accept in the first push.
+struct PushRegistration {
+  std::string uri;
+  long token;
+  int64_t credits;
+};
+
+std::string serializePushRegistration(const PushRegistration& registration);
+
+PushRegistration parsePushRegistration(const std::string& body);
+
+/// Pushes the pages of an output buffer to a registered consumer with
+/// credit-based flow control. Each push carries at most the credits granted
+/// by the previous push response, and the consumer only responds once it can
+/// accept more data. A push with no credits left is sent without pages to
+/// wait for new credits. The pushed pages are acknowledged on the successful
+/// push, so there are no separate acknowledgement requests or long polls. The
+/// pusher stops after pushing the end of the buffer or on the first failure
+/// which the consumer detects by its pushes stopping before the end.
+///
+/// The pusher keeps itself alive through its pending callbacks.
+class OutputBufferPusher
+    : public std::enable_shared_from_this<OutputBufferPusher> {
+ public:
+  OutputBufferPusher(
+      std::shared_ptr<velox::exec::PartitionedOutputBufferManager>
+          bufferManager,
+      const protocol::TaskId& taskId,
+      int destination,
+      const PushRegistration& registration);
+
+  /// Starts pushing. Returns false if the output buffer is not found.
+  bool start();
+
+ private:
+  // Gets the next pages from the output buffer up to the current credits.
+  bool fetch();
+
+  void push(
+      std::unique_ptr<folly::IOBuf> data,
+      int64_t sequence,
+      int64_t nextSequence,
+      bool complete);
+
+  const std::weak_ptr<velox::exec::PartitionedOutputBufferManager>
+      bufferManager_;
+  const protocol::TaskId taskId_;
+  const int destination_;
+  const folly::Uri uri_;
+  const std::shared_ptr<http::HttpClient> httpClient_;
+  // Whether the pushed pages carry checksums.
+  const bool checksumPages_;
+
+  int64_t token_;
+  int64_t credits_;
+};
+
+} // namespace facebook::presto
@@ -14,7 +14,14 @@
 
 #include "presto_cpp/main/QueryContextManager.h"
 #include <folly/executors/IOThreadPoolExecutor.h>
+#include <glog/logging.h>
+#include <cmath>
+#include "presto_cpp/main/DriverWatchdog.h"
+#include "presto_cpp/main/FairDriverExecutor.h"
+#include "presto_cpp/main/NumaExecutors.h"
+#include "presto_cpp/main/SharedBroadcastExchangeSource.h"
 #include "presto_cpp/main/common/Configs.h"
+#include "presto_cpp/main/operators/LocalPersistentShuffle.h"
 
 using namespace facebook::velox;
 
@@ -30,6 +37,26 @@ static std::shared_ptr<folly::CPUThreadPoolExecutor>& executor() {
   return executor;
 }
 
+// Returns the per NUMA node driver executors or nullptr if they are disabled
+// or the machine has a single node.
+NumaExecutors* numaExecutors() {
+  static auto executors = []() -> std::unique_ptr<NumaExecutors> {
+    const auto* systemConfig = SystemConfig::instance();
+    if (!systemConfig->numaAwareDriverExecutor()) {
+      return nullptr;
+    }
+    const auto nodeCpus = numaNodeCpus();
+    if (nodeCpus.size() <= 1) {
+      return nullptr;
+    }
+    LOG(INFO) << "Starting driver executors on " << nodeCpus.size()
+              << " NUMA nodes";
+    return std::make_unique<NumaExecutors>(
+        nodeCpus, systemConfig->numQueryThreads());
+  }();
+  return executors.get();
+}
+
 std::shared_ptr<folly::IOThreadPoolExecutor> spillExecutor() {
   const int32_t numSpillThreads = SystemConfig::instance()->numSpillThreads();
   if (numSpillThreads <= 0) {
@@ -39,16 +66,64 @@ std::shared_ptr<folly::IOThreadPoolExecutor> spillExecutor() {
       numSpillThreads, std::make_shared<folly::NamedThreadFactory>("Spiller"));
   return executor;
 }
+
+// Returns the 'name=value' lines of the set properties of 'configStrings'
+// which change the results of the expressions.
+std::string toResultConfigs(
+    const std::unordered_map<std::string, std::string>& configStrings) {
+  static const std::vector<std::string> kNames = {
+      core::QueryConfig::kAdjustTimestampToTimezone,
+      core::QueryConfig::kSessionTimezone};
+  std::string result;
+  for (const auto& name : kNames) {
+    auto it = configStrings.find(name);
+    if (it != configStrings.end()) {
+      result += fmt::format("{}={}\n", name, it->second);
+    }
+  }
+  return result;
+}
+
+// Returns the integer value of 'key' or nullopt if it is not set.
+std::optional<int32_t> optionalInt(
+    const std::unordered_map<std::string, std::string>& configStrings,
+    folly::StringPiece key) {
+  auto it = configStrings.find(key.str());
+  if (it == configStrings.end()) {
+    return std::nullopt;
+  }
+  return folly::to<int32_t>(it->second);
+}
 } // namespace
 
 folly::CPUThreadPoolExecutor* driverCPUExecutor() {
   return executor().get();
 }
 
+FairDriverExecutor* fairDriverExecutor() {
+  static auto executor = []() -> std::unique_ptr<FairDriverExecutor> {
+    const auto* systemConfig = SystemConfig::instance();
+    if (!systemConfig->fairDriverScheduler()) {
+      return nullptr;
+    }
+    return std::make_unique<FairDriverExecutor>(
+        systemConfig->numQueryThreads());
+  }();
+  return executor.get();
+}
+
 folly::IOThreadPoolExecutor* spillExecutorPtr() {
   return spillExecutor().get();
 }
 
+QuerySessionConfig::QuerySessionConfig(
+    const std::unordered_map<std::string, std::string>& configStrings)
+    : maxDriversPerTask(optionalInt(configStrings, kMaxDriversPerTask)),
+      concurrentLifespansPerTask(
+          optionalInt(configStrings, kConcurrentLifespansPerTask)),
+      taskWriterCount(optionalInt(configStrings, kTaskWriterCount)),
+      resultConfigs(toResultConfigs(configStrings)) {}
+
 std::shared_ptr<core::QueryCtx> QueryContextManager::findOrCreateQueryCtx(
     const TaskId& taskId,
     std::unordered_map<std::string, std::string>&& configStrings,
@@ -56,13 +131,38 @@ std::shared_ptr<core::QueryCtx> QueryContextManager::findOrCreateQueryCtx(
         std::string,
         std::unordered_map<std::string, std::string>>&&
         connectorConfigStrings) {
+  std::shared_ptr<const QuerySessionConfig> sessionConfig;
+  return findOrCreateQueryCtx(
+      taskId,
+      [&]() {
+        return QueryConfigStrings{
+            std::move(configStrings), std::move(connectorConfigStrings)};
+      },
+      sessionConfig);
+}
+
+std::shared_ptr<core::QueryCtx> QueryContextManager::findOrCreateQueryCtx(
+    const TaskId& taskId,
+    const std::function<QueryConfigStrings()>& makeConfigs,
+    std::shared_ptr<const QuerySessionConfig>& sessionConfig) {
   QueryId queryId = taskId.substr(0, taskId.find('.'));
 
-  auto lockedCache = queryContextCache_.wlock();
-  if (auto queryCtx = lockedCache->get(queryId)) {
-    return queryCtx;
+  const auto shardIndex = std::hash<QueryId>{}(queryId) % kNumCacheShards;
+  auto& shard = (*cacheShards_)[shardIndex];
+  {
+    auto lockedCache = shard.cache.wlock();
+    std::vector<QueryId> expiredQueryIds;
+    shard.expired.lock()->swap(expiredQueryIds);
+    for (const auto& expiredQueryId : expiredQueryIds) {
+      lockedCache->eraseExpired(expiredQueryId);
+    }
+    if (auto queryCtx = lockedCache->get(queryId, &sessionConfig)) {
+      return queryCtx;
+    }
   }
 
+  auto [configStrings, connectorConfigStrings] = makeConfigs();
+
   // If `legacy_timestamp` is true, the coordinator expects timestamp
   // conversions without a timezone to be converted to the user's
   // session_timezone.
@@ -74,6 +174,47 @@ std::shared_ptr<core::QueryCtx> QueryContextManager::findOrCreateQueryCtx(
         core::QueryConfig::kAdjustTimestampToTimezone, "true");
   }
 
+  addPartialAggregationConfigs(configStrings);
+
+  // Open the upcoming splits of the table scans ahead of time to prefetch
+  // their data, unless the session configures it.
+  configStrings.emplace(
+      core::QueryConfig::kMaxSplitPreloadPerDriver,
+      std::to_string(SystemConfig::instance()->taskMaxSplitPreloadPerDriver()));
+
+  const int64_t maxQueryMemoryPerNode =
+      getMaxMemoryPerNode(kQueryMaxMemoryPerNode, kDefaultMaxMemoryPerNode);
+
+  const auto* systemConfig = SystemConfig::instance();
+  if (systemConfig->spillOnMemoryPressure() &&
+      !systemConfig->spillerSpillPath().empty()) {
+    // Visits the other shards, so 'shard' must not be locked.
+    int64_t usedBytes{0};
+    size_t numQueries{0};
+    visitAllContexts(
+        [&](const QueryId& /*queryId*/, const core::QueryCtx* queryCtx) {
+          usedBytes += queryCtx->pool()->getCurrentBytes();
+          ++numQueries;
+        });
+    const auto threshold = std::to_string(spillMemoryThreshold(
+        int64_t(systemConfig->systemMemoryGb()) << 30,
+        usedBytes,
+        numQueries,
+        maxQueryMemoryPerNode));
+    configStrings.emplace(core::QueryConfig::kSpillEnabled, "true");
+    configStrings.emplace(core::QueryConfig::kAggregationSpillEnabled, "true");
+    configStrings.emplace(core::QueryConfig::kJoinSpillEnabled, "true");
+    configStrings.emplace(core::QueryConfig::kOrderBySpillEnabled, "true");
+    configStrings.emplace(
+        core::QueryConfig::kAggregationSpillMemoryThreshold, threshold);
+    configStrings.emplace(
+        core::QueryConfig::kJoinSpillMemoryThreshold, threshold);
+    configStrings.emplace(
+        core::QueryConfig::kOrderBySpillMemoryThreshold, threshold);
+  }
+
+  auto newSessionConfig =
+      std::make_shared<const QuerySessionConfig>(configStrings);
   std::shared_ptr<Config> config =
       std::make_shared<core::MemConfig>(configStrings);
   std::unordered_map<std::string, std::shared_ptr<Config>> connectorConfigs;
@@ -82,30 +223,111 @@ std::shared_ptr<core::QueryCtx> QueryContextManager::findOrCreateQueryCtx(
         {entry.first, std::make_shared<core::MemConfig>(entry.second)});
   }
 
-  const int64_t maxQueryMemoryPerNode =
-      getMaxMemoryPerNode(kQueryMaxMemoryPerNode, kDefaultMaxMemoryPerNode);
+  // Another task of the query may have created its context meanwhile.
+  auto lockedCache = shard.cache.wlock();
+  if (auto queryCtx = lockedCache->get(queryId, &sessionConfig)) {
+    return queryCtx;
+  }
   auto pool = memory::defaultMemoryManager().addRootPool(
       queryId, maxQueryMemoryPerNode);
 
-  auto queryCtx = std::make_shared<core::QueryCtx>(
-      executor().get(),
-      config,
-      connectorConfigs,
-      memory::MemoryAllocator::getInstance(),
-      std::move(pool),
-      spillExecutor(),
-      queryId);
+  // The drivers of a query get their fair share of the query threads or stay
+  // on its home NUMA node.
+  folly::Executor* driverExecutor = executor().get();
+  std::shared_ptr<folly::Executor> queryExecutor;
+  if (auto* fairExecutor = fairDriverExecutor()) {
+    queryExecutor = fairExecutor->createQueryExecutor();
+    driverExecutor = queryExecutor.get();
+  } else if (auto* executors = numaExecutors()) {
+    driverExecutor = executors->executor(executors->leastLoadedNode());
+  }
+  // The stuck driver watchdog looks at the drivers on their threads.
+  if (SystemConfig::instance()->driverStuckThresholdSec() > 0) {
+    queryExecutor = DriverWatchdog::wrap(
+        driverExecutor, queryId, std::move(queryExecutor));
+    driverExecutor = queryExecutor.get();
+  }
+
+  // Queues the erasure of the cache entry when the context is destroyed, so
+  // that the cache only holds the live contexts. The context does not own its
+  // executor, the query executor lives until then.
+  auto deleter = [shards = folly::to_weak_ptr(cacheShards_),
+                  shardIndex,
+                  queryId,
+                  queryExecutor](core::QueryCtx* queryCtx) {
+    delete queryCtx;
+    SharedBroadcastExchangeSource::removeQuery(queryId);
+    operators::LocalShuffleMemoryStore::releaseQuery(queryId);
+    if (auto lockedShards = shards.lock()) {
+      (*lockedShards)[shardIndex].expired.lock()->push_back(queryId);
+    }
+  };
+  std::shared_ptr<core::QueryCtx> queryCtx(
+      new core::QueryCtx(
+          driverExecutor,
+          config,
+          connectorConfigs,
+          memory::MemoryAllocator::getInstance(),
+          std::move(pool),
+          spillExecutor(),
+          queryId),
+      deleter);
+
+  sessionConfig = newSessionConfig;
+  return lockedCache->insert(
+      queryId, std::move(queryCtx), std::move(newSessionConfig));
+}
+
+// static
+void QueryContextManager::addPartialAggregationConfigs(
+    std::unordered_map<std::string, std::string>& configStrings) {
+  const auto* systemConfig = SystemConfig::instance();
+  auto enabled = systemConfig->taskAdaptivePartialAggregation();
+  auto maxUniqueRowsPct =
+      systemConfig->taskAdaptivePartialAggregationMaxUniqueRowsPct();
+  auto it = configStrings.find(kAdaptivePartialAggregation);
+  if (it != configStrings.end()) {
+    enabled = folly::to<bool>(it->second);
+  }
+  it = configStrings.find(kAdaptivePartialAggregationUniqueRowsRatio);
+  if (it != configStrings.end()) {
+    maxUniqueRowsPct = std::lround(folly::to<double>(it->second) * 100);
+  }
+  // A partial aggregation gives up once it has seen the minimum rows and
+  // holds more groups than the percentage of them. Velox reports it in the
+  // abandonedPartialAggregation runtime stat of the operator.
+  configStrings.emplace(
+      core::QueryConfig::kAbandonPartialAggregationMinRows,
+      std::to_string(
+          enabled ? systemConfig->taskAdaptivePartialAggregationMinRows()
+                  : std::numeric_limits<int64_t>::max()));
+  configStrings.emplace(
+      core::QueryConfig::kAbandonPartialAggregationMinPct,
+      std::to_string(maxUniqueRowsPct));
+}
 
-  return lockedCache->insert(queryId, queryCtx);
+// static
+int64_t QueryContextManager::spillMemoryThreshold(
+    int64_t nodeBytes,
+    int64_t usedBytes,
+    size_t numQueries,
+    int64_t maxQueryBytes) {
+  const int64_t freeBytes = std::max<int64_t>(0, nodeBytes - usedBytes);
+  const int64_t share = freeBytes / int64_t(numQueries + 1);
+  return std::max(
+      std::min(share, maxQueryBytes),
+      std::min(kMinSpillMemoryThreshold, maxQueryBytes));
 }
 
 void QueryContextManager::visitAllContexts(
     std::function<void(const protocol::QueryId&, const velox::core::QueryCtx*)>
         visitor) const {
-  auto lockedCache = queryContextCache_.rlock();
-  for (const auto& it : lockedCache->ctxs()) {
-    if (const auto queryCtxSP = it.second.first.lock()) {
-      visitor(it.first, queryCtxSP.get());
+  for (const auto& shard : *cacheShards_) {
+    auto lockedCache = shard.cache.rlock();
+    for (const auto& it : lockedCache->ctxs()) {
+      if (const auto queryCtxSP = it.second.queryCtx.lock()) {
+        visitor(it.first, queryCtxSP.get());
+      }
     }
   }
 }
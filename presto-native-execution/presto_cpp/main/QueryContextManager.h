@@ -16,23 +16,66 @@
 #include <folly/Synchronized.h>
 #include <folly/executors/CPUThreadPoolExecutor.h>
 #include <folly/executors/IOThreadPoolExecutor.h>
+#include <array>
 #include <list>
 #include <memory>
+#include <optional>
 #include <unordered_map>
+#include <vector>
 
 #include "presto_cpp/presto_protocol/presto_protocol.h"
 #include "velox/core/QueryCtx.h"
 
 namespace facebook::presto {
 
+class FairDriverExecutor;
+
 folly::CPUThreadPoolExecutor* driverCPUExecutor();
+/// Returns the executor that shares the query threads fairly between the
+/// queries or nullptr if the fair driver scheduler is disabled.
+FairDriverExecutor* fairDriverExecutor();
 folly::IOThreadPoolExecutor* spillExecutorPtr();
 
+/// The session properties that every task of a query reads, parsed once when
+/// the query context is created. Unset if the session does not set them.
+struct QuerySessionConfig {
+  static constexpr folly::StringPiece kMaxDriversPerTask{
+      "max_drivers_per_task"};
+  static constexpr folly::StringPiece kConcurrentLifespansPerTask{
+      "concurrent_lifespans_per_task"};
+  static constexpr folly::StringPiece kTaskWriterCount{"task_writer_count"};
+
+  QuerySessionConfig() = default;
+
+  /// Throws if a property is not a valid integer.
+  explicit QuerySessionConfig(
+      const std::unordered_map<std::string, std::string>& configStrings);
+
+  std::optional<int32_t> maxDriversPerTask;
+  std::optional<int32_t> concurrentLifespansPerTask;
+  std::optional<int32_t> taskWriterCount;
+  /// The set properties which change the results of the expressions, e.g.
+  /// the session time zone, as 'name=value' lines in name order. Part of the
+  /// key of the cached fragment results.
+  std::string resultConfigs;
+};
+
+/// The config maps a query context is created from.
+struct QueryConfigStrings {
+  std::unordered_map<std::string, std::string> configStrings;
+  std::unordered_map<std::string, std::unordered_map<std::string, std::string>>
+      connectorConfigStrings;
+};
+
 class QueryContextCache {
  public:
   using QueryCtxWeakPtr = std::weak_ptr<velox::core::QueryCtx>;
   using QueryIdList = std::list<protocol::QueryId>;
-  using QueryCtxCacheValue = std::pair<QueryCtxWeakPtr, QueryIdList::iterator>;
+  struct QueryCtxCacheValue {
+    QueryCtxWeakPtr queryCtx;
+    QueryIdList::iterator position;
+    std::shared_ptr<const QuerySessionConfig> sessionConfig;
+  };
   using QueryCtxMap = std::unordered_map<protocol::QueryId, QueryCtxCacheValue>;
 
   QueryContextCache(size_t initial_capacity = kInitialCapacity)
@@ -45,15 +88,23 @@ class QueryContextCache {
     return queryCtxs_.size();
   }
 
-  std::shared_ptr<velox::core::QueryCtx> get(protocol::QueryId queryId) {
+  /// Returns the context of 'queryId' or nullptr if it is gone. Sets
+  /// 'sessionConfig' to the session config inserted with the context if not
+  /// null.
+  std::shared_ptr<velox::core::QueryCtx> get(
+      protocol::QueryId queryId,
+      std::shared_ptr<const QuerySessionConfig>* sessionConfig = nullptr) {
     auto iter = queryCtxs_.find(queryId);
     if (iter != queryCtxs_.end()) {
-      queryIds_.erase(iter->second.second);
+      queryIds_.erase(iter->second.position);
 
-      if (auto queryCtx = iter->second.first.lock()) {
+      if (auto queryCtx = iter->second.queryCtx.lock()) {
         // Move the queryId to front, if queryCtx is still alive.
         queryIds_.push_front(queryId);
-        iter->second.second = queryIds_.begin();
+        iter->second.position = queryIds_.begin();
+        if (sessionConfig != nullptr) {
+          *sessionConfig = iter->second.sessionConfig;
+        }
         return queryCtx;
       } else {
         queryCtxs_.erase(iter);
@@ -64,13 +115,16 @@ class QueryContextCache {
 
   std::shared_ptr<velox::core::QueryCtx> insert(
       protocol::QueryId queryId,
-      std::shared_ptr<velox::core::QueryCtx> queryCtx) {
+      std::shared_ptr<velox::core::QueryCtx> queryCtx,
+      std::shared_ptr<const QuerySessionConfig> sessionConfig = nullptr) {
     if (queryCtxs_.size() >= capacity_) {
       evict();
     }
     queryIds_.push_front(queryId);
-    queryCtxs_[queryId] =
-        std::make_pair(folly::to_weak_ptr(queryCtx), queryIds_.begin());
+    queryCtxs_[queryId] = QueryCtxCacheValue{
+        folly::to_weak_ptr(queryCtx),
+        queryIds_.begin(),
+        std::move(sessionConfig)};
     return queryCtx;
   }
 
@@ -78,7 +132,7 @@ class QueryContextCache {
     // Evict least recently used queryCtx if it is not referenced elsewhere.
     for (auto victim = queryIds_.end(); victim != queryIds_.begin();) {
       --victim;
-      if (!queryCtxs_[*victim].first.lock()) {
+      if (!queryCtxs_[*victim].queryCtx.lock()) {
         queryCtxs_.erase(*victim);
         queryIds_.erase(victim);
         return;
@@ -88,6 +142,19 @@ class QueryContextCache {
     // All queries are still inflight. Increase capacity.
     capacity_ = std::max(kInitialCapacity, capacity_ * 2);
   }
+
+  /// Removes the entry of 'queryId' if its query context is gone. Called for
+  /// the destroyed contexts so that the eviction rarely needs to scan. Returns
+  /// true if the entry was removed.
+  bool eraseExpired(const protocol::QueryId& queryId) {
+    auto iter = queryCtxs_.find(queryId);
+    if (iter == queryCtxs_.end() || !iter->second.queryCtx.expired()) {
+      return false;
+    }
+    queryIds_.erase(iter->second.position);
+    queryCtxs_.erase(iter);
+    return true;
+  }
   const QueryCtxMap& ctxs() const {
     return queryCtxs_;
   }
@@ -116,6 +183,15 @@ class QueryContextManager {
           std::unordered_map<std::string, std::string>>&&
           connectorConfigStrings);
 
+  /// Returns the context of the query of 'taskId' and its parsed session
+  /// config. Creates them from the config maps returned by 'makeConfigs' if
+  /// the query has no context, so that the later tasks of the query skip
+  /// building and processing their configs.
+  std::shared_ptr<velox::core::QueryCtx> findOrCreateQueryCtx(
+      const protocol::TaskId& taskId,
+      const std::function<QueryConfigStrings()>& makeConfigs,
+      std::shared_ptr<const QuerySessionConfig>& sessionConfig);
+
   void overrideProperties(
       const std::string& property,
       const std::string& value) {
@@ -132,6 +208,33 @@ class QueryContextManager {
   static constexpr int64_t kDefaultMaxMemoryPerNode =
       std::numeric_limits<int64_t>::max();
 
+  /// The least memory a query is granted before it spills.
+  static constexpr int64_t kMinSpillMemoryThreshold = 64L << 20;
+
+  /// Returns the memory the operators of a new query may hold before they
+  /// spill: an equal share of what 'numQueries' queries using 'usedBytes'
+  /// leave of 'nodeBytes', between kMinSpillMemoryThreshold and
+  /// 'maxQueryBytes'.
+  static int64_t spillMemoryThreshold(
+      int64_t nodeBytes,
+      int64_t usedBytes,
+      size_t numQueries,
+      int64_t maxQueryBytes);
+
+  /// The session properties of the adaptive partial aggregation, see
+  /// SystemConfig::kTaskAdaptivePartialAggregation.
+  static constexpr const char* kAdaptivePartialAggregation =
+      "adaptive_partial_aggregation";
+  static constexpr const char* kAdaptivePartialAggregationUniqueRowsRatio =
+      "adaptive_partial_aggregation_unique_rows_ratio_threshold";
+
+  /// Adds to 'configStrings' the Velox configs after which the partial
+  /// aggregations pass their input through, from the session properties
+  /// above or else the system config. Keeps the Velox configs the session
+  /// sets.
+  static void addPartialAggregationConfigs(
+      std::unordered_map<std::string, std::string>& configStrings);
+
  private:
   int64_t getMaxMemoryPerNode(
       const std::string& property,
@@ -147,7 +250,24 @@ class QueryContextManager {
     return (maxMemoryInBytes <= 0) ? defaultMaxMemoryPerNode : maxMemoryInBytes;
   }
 
-  folly::Synchronized<QueryContextCache> queryContextCache_;
+  // The query contexts are spread over the shards by query id, so that the
+  // task creations of different queries rarely contend.
+  static constexpr size_t kNumCacheShards = 16;
+
+  struct CacheShard {
+    folly::Synchronized<QueryContextCache> cache;
+    // The ids of the destroyed contexts to erase from 'cache'. The contexts
+    // can be destroyed while 'cache' is locked, so their deleters only lock
+    // this.
+    folly::Synchronized<std::vector<protocol::QueryId>, std::mutex> expired;
+  };
+
+  using CacheShards = std::array<CacheShard, kNumCacheShards>;
+
+  // Shared with the deleters of the query contexts, which may run after this
+  // is destroyed.
+  const std::shared_ptr<CacheShards> cacheShards_{
+      std::make_shared<CacheShards>()};
   std::unordered_map<std::string, std::string> properties_;
   std::unordered_map<std::string, std::string> nodeProperties_;
 };
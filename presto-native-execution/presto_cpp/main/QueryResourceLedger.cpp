@@ -0,0 +1,75 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/QueryResourceLedger.h"
+#include <algorithm>
+
+namespace facebook::presto {
+
+QueryResourceLedger::Resources& QueryResourceLedger::Resources::operator+=(
+    const Resources& other) {
+  numTasks += other.numTasks;
+  cpuNanos += other.cpuNanos;
+  wallNanos += other.wallNanos;
+  peakMemoryBytes = std::max(peakMemoryBytes, other.peakMemoryBytes);
+  spilledBytes += other.spilledBytes;
+  exchangeInputBytes += other.exchangeInputBytes;
+  exchangeOutputBytes += other.exchangeOutputBytes;
+  lastUpdateMs = std::max(lastUpdateMs, other.lastUpdateMs);
+  return *this;
+}
+
+void QueryResourceLedger::record(
+    const std::string& queryId,
+    const Resources& taskResources,
+    uint64_t nowMs) {
+  totalSpilledBytes_ += taskResources.spilledBytes;
+  std::lock_guard<std::mutex> l(mutex_);
+  auto& resources = queries_[queryId];
+  resources += taskResources;
+  resources.lastUpdateMs = nowMs;
+  // Bounds the ledger when no one asks for a snapshot.
+  if (nowMs >= lastPruneMs_ + retentionMs_) {
+    pruneLocked(nowMs);
+  }
+}
+
+void QueryResourceLedger::pruneLocked(uint64_t nowMs) {
+  lastPruneMs_ = nowMs;
+  for (auto it = queries_.begin(); it != queries_.end();) {
+    if (it->second.lastUpdateMs + retentionMs_ < nowMs) {
+      it = queries_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+size_t QueryResourceLedger::numQueries() const {
+  std::lock_guard<std::mutex> l(mutex_);
+  return queries_.size();
+}
+
+std::vector<std::pair<std::string, QueryResourceLedger::Resources>>
+QueryResourceLedger::snapshot(uint64_t nowMs) {
+  std::vector<std::pair<std::string, Resources>> queries;
+  std::lock_guard<std::mutex> l(mutex_);
+  pruneLocked(nowMs);
+  queries.reserve(queries_.size());
+  for (const auto& query : queries_) {
+    queries.push_back(query);
+  }
+  return queries;
+}
+
+} // namespace facebook::presto
@@ -0,0 +1,84 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace facebook::presto {
+
+/// Accumulates the resources used by the tasks of each query on this worker,
+/// as the tasks finish, so that the per query totals are served without
+/// visiting the tasks. A query is forgotten 'retentionMs' after its last task
+/// finished, at the latest by the next record() or snapshot() after another
+/// 'retentionMs'.
+class QueryResourceLedger {
+ public:
+  static constexpr uint64_t kDefaultRetentionMs{10 * 60 * 1'000};
+
+  struct Resources {
+    int64_t numTasks{0};
+    int64_t cpuNanos{0};
+    int64_t wallNanos{0};
+    /// The largest memory reservation of the query seen by its tasks.
+    int64_t peakMemoryBytes{0};
+    int64_t spilledBytes{0};
+    int64_t exchangeInputBytes{0};
+    int64_t exchangeOutputBytes{0};
+    uint64_t lastUpdateMs{0};
+
+    Resources& operator+=(const Resources& other);
+  };
+
+  explicit QueryResourceLedger(uint64_t retentionMs = kDefaultRetentionMs)
+      : retentionMs_(retentionMs) {}
+
+  /// Adds the resources of a finished task of 'queryId' at 'nowMs'. Forgets
+  /// the expired queries at most once per retention time.
+  void record(
+      const std::string& queryId,
+      const Resources& taskResources,
+      uint64_t nowMs);
+
+  /// Returns the totals of the queries updated within the retention time
+  /// before 'nowMs' and forgets the others.
+  std::vector<std::pair<std::string, Resources>> snapshot(uint64_t nowMs);
+
+  /// Returns the bytes spilled by all the tasks recorded so far, including
+  /// those of the forgotten queries.
+  int64_t totalSpilledBytes() const {
+    return totalSpilledBytes_;
+  }
+
+  /// Returns the number of queries held, including the expired ones not
+  /// forgotten yet.
+  size_t numQueries() const;
+
+ private:
+  // Forgets the queries not updated within the retention time before 'nowMs'.
+  void pruneLocked(uint64_t nowMs);
+
+  const uint64_t retentionMs_;
+
+  mutable std::mutex mutex_;
+  uint64_t lastPruneMs_{0};
+  std::unordered_map<std::string, Resources> queries_;
+  std::atomic<int64_t> totalSpilledBytes_{0};
+};
+
+} // namespace facebook::presto
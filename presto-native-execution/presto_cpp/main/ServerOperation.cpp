@@ -19,20 +19,54 @@ namespace facebook::presto {
 const std::unordered_map<std::string, ServerOperation::Action>
     ServerOperation::kActionLookup = {
         {"clearCache", ServerOperation::Action::kClearCache},
-        {"getCacheStats", ServerOperation::Action::kGetCacheStats}};
+        {"getCacheStats", ServerOperation::Action::kGetCacheStats},
+        {"prefetch", ServerOperation::Action::kPrefetch},
+        {"pin", ServerOperation::Action::kPin},
+        {"unpin", ServerOperation::Action::kUnpin},
+        {"getDetail", ServerOperation::Action::kGetDetail},
+        {"listAll", ServerOperation::Action::kListAll},
+        {"listStuck", ServerOperation::Action::kListStuck},
+        {"trim", ServerOperation::Action::kTrim},
+        {"drain", ServerOperation::Action::kDrain},
+        {"setProperty", ServerOperation::Action::kSetProperty},
+        {"getProperty", ServerOperation::Action::kGetProperty},
+        {"reload", ServerOperation::Action::kReload}};
 
 const std::unordered_map<ServerOperation::Action, std::string>
     ServerOperation::kReverseActionLookup = {
         {ServerOperation::Action::kClearCache, "clearCache"},
-        {ServerOperation::Action::kGetCacheStats, "getCacheStats"}};
+        {ServerOperation::Action::kGetCacheStats, "getCacheStats"},
+        {ServerOperation::Action::kPrefetch, "prefetch"},
+        {ServerOperation::Action::kPin, "pin"},
+        {ServerOperation::Action::kUnpin, "unpin"},
+        {ServerOperation::Action::kGetDetail, "getDetail"},
+        {ServerOperation::Action::kListAll, "listAll"},
+        {ServerOperation::Action::kListStuck, "listStuck"},
+        {ServerOperation::Action::kTrim, "trim"},
+        {ServerOperation::Action::kDrain, "drain"},
+        {ServerOperation::Action::kSetProperty, "setProperty"},
+        {ServerOperation::Action::kGetProperty, "getProperty"},
+        {ServerOperation::Action::kReload, "reload"}};
 
 const std::unordered_map<std::string, ServerOperation::Target>
     ServerOperation::kTargetLookup = {
-        {"connector", ServerOperation::Target::kConnector}};
+        {"connector", ServerOperation::Target::kConnector},
+        {"cache", ServerOperation::Target::kCache},
+        {"task", ServerOperation::Target::kTask},
+        {"memory", ServerOperation::Target::kMemory},
+        {"allocator", ServerOperation::Target::kAllocator},
+        {"server", ServerOperation::Target::kServer},
+        {"systemConfig", ServerOperation::Target::kSystemConfig}};
 
 const std::unordered_map<ServerOperation::Target, std::string>
     ServerOperation::kReverseTargetLookup = {
-        {ServerOperation::Target::kConnector, "connector"}};
+        {ServerOperation::Target::kConnector, "connector"},
+        {ServerOperation::Target::kCache, "cache"},
+        {ServerOperation::Target::kTask, "task"},
+        {ServerOperation::Target::kMemory, "memory"},
+        {ServerOperation::Target::kAllocator, "allocator"},
+        {ServerOperation::Target::kServer, "server"},
+        {ServerOperation::Target::kSystemConfig, "systemConfig"}};
 
 ServerOperation::Target ServerOperation::targetFromString(
     const std::string& str) {
@@ -23,10 +23,42 @@ struct ServerOperation {
   /// The target this operation is operating upon
   enum class Target {
     kConnector,
+    /// The AsyncDataCache and the SsdCache behind it.
+    kCache,
+    kTask,
+    /// The memory allocator and the query memory pools.
+    kMemory,
+    /// The pages mapped by the memory allocator.
+    kAllocator,
+    /// The server itself, e.g. its shutdown.
+    kServer,
+    /// The properties of config.properties.
+    kSystemConfig,
   };
 
   /// The action this operation is trying to take
-  enum class Action { kClearCache, kGetCacheStats };
+  enum class Action {
+    kClearCache,
+    kGetCacheStats,
+    /// Loads the files and ranges of the request body into the cache.
+    kPrefetch,
+    /// Loads the files and ranges of the request body into the cache and
+    /// keeps them from eviction under the 'name' parameter.
+    kPin,
+    kUnpin,
+    kGetDetail,
+    kListAll,
+    /// Lists the drivers stuck on their threads with their stacks.
+    kListStuck,
+    /// Returns the free memory to the OS.
+    kTrim,
+    /// Finishes the running tasks, refusing new ones, and shuts down.
+    kDrain,
+    kSetProperty,
+    kGetProperty,
+    /// Rereads the config file and applies the changes.
+    kReload,
+  };
 
   static const std::unordered_map<std::string, Target> kTargetLookup;
   static const std::unordered_map<Target, std::string> kReverseTargetLookup;
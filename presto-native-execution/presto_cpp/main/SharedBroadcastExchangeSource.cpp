@@ -0,0 +1,319 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/SharedBroadcastExchangeSource.h"
+
+#include <algorithm>
+#include <folly/Uri.h>
+#include <re2/re2.h>
+
+#include "presto_cpp/main/InProcessExchangeSource.h"
+#include "presto_cpp/main/PrestoExchangeSource.h"
+#include "presto_cpp/main/QueryContextManager.h"
+#include "presto_cpp/main/common/Configs.h"
+#include "presto_cpp/main/common/Counters.h"
+#include "presto_cpp/main/types/PrestoTaskId.h"
+#include "velox/common/base/StatsReporter.h"
+
+using namespace facebook::velox;
+
+namespace facebook::presto {
+namespace {
+std::shared_ptr<exec::ExchangeSource> createUpstreamSource(
+    const std::string& url,
+    int destination,
+    std::shared_ptr<exec::ExchangeQueue> queue,
+    memory::MemoryPool* pool) {
+  std::shared_ptr<exec::ExchangeSource> source =
+      InProcessExchangeSource::createExchangeSource(
+          url, destination, queue, pool);
+  if (source == nullptr) {
+    source = PrestoExchangeSource::createExchangeSource(
+        url, destination, queue, pool);
+  }
+  VELOX_CHECK_NOT_NULL(source, "No exchange source for broadcast {}", url);
+  return source;
+}
+} // namespace
+
+SharedBroadcastExchangeSource::Broadcast::~Broadcast() {
+  if (upstream_ != nullptr) {
+    upstream_->close();
+  }
+}
+
+void SharedBroadcastExchangeSource::Broadcast::start(
+    const std::string& url,
+    int destination,
+    memory::MemoryPool* pool) {
+  pool_ = pool->shared_from_this();
+  queue_ = std::make_shared<exec::ExchangeQueue>(
+      SystemConfig::instance()->exchangeMaxResponseBytes());
+  {
+    std::lock_guard<std::mutex> l(queue_->mutex());
+    queue_->addSourceLocked();
+  }
+  queue_->noMoreSources();
+  upstream_ = createUpstreamSource(url, destination, queue_, pool_.get());
+  fetch();
+}
+
+void SharedBroadcastExchangeSource::Broadcast::fetch() {
+  std::vector<std::unique_ptr<folly::IOBuf>> pages;
+  bool atEnd = false;
+  std::string error;
+  bool requestMore = false;
+  exec::ContinueFuture future;
+  {
+    std::lock_guard<std::mutex> l(queue_->mutex());
+    try {
+      while (auto page = queue_->dequeueLocked(&atEnd, &future)) {
+        pages.push_back(page->getIOBuf());
+      }
+    } catch (const std::exception& e) {
+      error = e.what();
+    }
+    if (!atEnd && error.empty()) {
+      requestMore = upstream_->shouldRequestLocked();
+    }
+  }
+  if (requestMore) {
+    upstream_->request();
+  }
+  if (!pages.empty() || atEnd || !error.empty()) {
+    publish(std::move(pages), atEnd, error);
+  }
+  if (atEnd || !error.empty()) {
+    return;
+  }
+  // Does not keep the broadcast alive, it is closed once its query is gone.
+  std::move(future)
+      .via(driverCPUExecutor())
+      .thenValue([weak = weak_from_this()](auto&& /*unused*/) {
+        if (auto self = weak.lock()) {
+          self->fetch();
+        }
+      });
+}
+
+void SharedBroadcastExchangeSource::Broadcast::read(
+    const std::shared_ptr<SharedBroadcastExchangeSource>& reader) {
+  std::vector<std::unique_ptr<folly::IOBuf>> pages;
+  bool atEnd;
+  std::string error;
+  {
+    std::lock_guard<std::mutex> l(mutex_);
+    if (reader->nextPage_ == pages_.size() && !atEnd_ && error_.empty()) {
+      waiters_.push_back(reader);
+      return;
+    }
+    for (; reader->nextPage_ < pages_.size(); ++reader->nextPage_) {
+      pages.push_back(pages_[reader->nextPage_]->clone());
+    }
+    atEnd = atEnd_;
+    error = error_;
+  }
+  reader->enqueue(std::move(pages), atEnd, error);
+}
+
+void SharedBroadcastExchangeSource::Broadcast::publish(
+    std::vector<std::unique_ptr<folly::IOBuf>> pages,
+    bool atEnd,
+    const std::string& error) {
+  std::vector<std::shared_ptr<SharedBroadcastExchangeSource>> waiters;
+  {
+    std::lock_guard<std::mutex> l(mutex_);
+    for (auto& page : pages) {
+      pages_.push_back(std::move(page));
+    }
+    atEnd_ = atEnd_ || atEnd;
+    if (!error.empty()) {
+      error_ = error;
+    }
+    waiters.swap(waiters_);
+  }
+  for (const auto& waiter : waiters) {
+    read(waiter);
+  }
+}
+
+void SharedBroadcastExchangeSource::Broadcast::removeWaiter(
+    const SharedBroadcastExchangeSource* reader) {
+  std::lock_guard<std::mutex> l(mutex_);
+  waiters_.erase(
+      std::remove_if(
+          waiters_.begin(),
+          waiters_.end(),
+          [&](const auto& waiter) { return waiter.get() == reader; }),
+      waiters_.end());
+}
+
+SharedBroadcastExchangeSource::SharedBroadcastExchangeSource(
+    const std::string& taskId,
+    int destination,
+    std::shared_ptr<exec::ExchangeQueue> queue,
+    memory::MemoryPool* pool,
+    std::shared_ptr<Broadcast> broadcast,
+    std::shared_ptr<exec::ExchangeSource> bufferDeleter)
+    : ExchangeSource(taskId, destination, std::move(queue), pool),
+      broadcast_(std::move(broadcast)),
+      bufferDeleter_(std::move(bufferDeleter)) {}
+
+bool SharedBroadcastExchangeSource::shouldRequestLocked() {
+  if (atEnd_) {
+    return false;
+  }
+  bool pending = requestPending_;
+  requestPending_ = true;
+  return !pending;
+}
+
+void SharedBroadcastExchangeSource::request() {
+  if (closed_.load()) {
+    return;
+  }
+  broadcast_->read(getSelfPtr());
+}
+
+void SharedBroadcastExchangeSource::enqueue(
+    std::vector<std::unique_ptr<folly::IOBuf>> pages,
+    bool atEnd,
+    const std::string& error) {
+  if (closed_.load()) {
+    return;
+  }
+  if (!error.empty()) {
+    queue_->setError(error);
+    return;
+  }
+  std::vector<exec::ContinuePromise> promises;
+  {
+    std::lock_guard<std::mutex> l(queue_->mutex());
+    for (auto& page : pages) {
+      queue_->enqueueLocked(
+          std::make_unique<exec::SerializedPage>(std::move(page)), promises);
+    }
+    if (atEnd) {
+      atEnd_ = true;
+      queue_->enqueueLocked(nullptr, promises);
+    }
+    requestPending_ = false;
+  }
+  for (auto& promise : promises) {
+    promise.setValue();
+  }
+}
+
+void SharedBroadcastExchangeSource::close() {
+  // The pages stay with the broadcast for the other consumers of the query.
+  closed_.store(true);
+  broadcast_->removeWaiter(this);
+}
+
+std::shared_ptr<SharedBroadcastExchangeSource>
+SharedBroadcastExchangeSource::getSelfPtr() {
+  return std::dynamic_pointer_cast<SharedBroadcastExchangeSource>(
+      shared_from_this());
+}
+
+// static
+std::unique_ptr<exec::ExchangeSource>
+SharedBroadcastExchangeSource::createExchangeSource(
+    const std::string& url,
+    int destination,
+    std::shared_ptr<exec::ExchangeQueue> queue,
+    memory::MemoryPool* pool) {
+  if (!SystemConfig::instance()->exchangeShareBroadcasts() ||
+      (strncmp(url.c_str(), "http://", 7) != 0 &&
+       strncmp(url.c_str(), "https://", 8) != 0)) {
+    return nullptr;
+  }
+  const folly::Uri uri(url);
+  static const RE2 kPattern("/v1/task/([^/]*)/results/[0-9]+");
+  std::string taskId;
+  if (!RE2::FullMatch(uri.path(), kPattern, &taskId)) {
+    return nullptr;
+  }
+  const PrestoTaskId producerId(taskId);
+  std::shared_ptr<Broadcast> broadcast;
+  bool fetch = false;
+  {
+    auto lockedQueries = queries().wlock();
+    auto it = lockedQueries->find(producerId.queryId());
+    if (it == lockedQueries->end() ||
+        it->second.fragmentIds.count(
+            std::to_string(producerId.stageId())) == 0) {
+      return nullptr;
+    }
+    auto& entry = it->second.broadcasts[taskId];
+    if (entry == nullptr) {
+      entry = std::make_shared<Broadcast>();
+      fetch = true;
+    }
+    broadcast = entry;
+  }
+
+  std::shared_ptr<exec::ExchangeSource> bufferDeleter;
+  if (fetch) {
+    broadcast->start(url, destination, pool);
+  } else {
+    // The producer keeps the output buffer of this consumer until it is read
+    // or deleted.
+    bufferDeleter = createUpstreamSource(
+        url,
+        destination,
+        std::make_shared<exec::ExchangeQueue>(
+            SystemConfig::instance()->exchangeMaxResponseBytes()),
+        pool);
+    bufferDeleter->close();
+    REPORT_ADD_STAT_VALUE(kCounterNumSharedBroadcastSources);
+  }
+  return std::make_unique<SharedBroadcastExchangeSource>(
+      taskId,
+      destination,
+      std::move(queue),
+      pool,
+      std::move(broadcast),
+      std::move(bufferDeleter));
+}
+
+// static
+void SharedBroadcastExchangeSource::addQuery(
+    const std::string& queryId,
+    const std::vector<std::string>& fragmentIds) {
+  auto lockedQueries = queries().wlock();
+  auto& query = (*lockedQueries)[queryId];
+  query.fragmentIds.insert(fragmentIds.begin(), fragmentIds.end());
+}
+
+// static
+void SharedBroadcastExchangeSource::removeQuery(const std::string& queryId) {
+  QueryBroadcasts query;
+  {
+    auto lockedQueries = queries().wlock();
+    auto it = lockedQueries->find(queryId);
+    if (it == lockedQueries->end()) {
+      return;
+    }
+    query = std::move(it->second);
+    lockedQueries->erase(it);
+  }
+  // The broadcasts close their upstream sources outside of the lock.
+}
+
+// static
+size_t SharedBroadcastExchangeSource::numQueries() {
+  return queries().rlock()->size();
+}
+
+} // namespace facebook::presto
@@ -0,0 +1,152 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <folly/Synchronized.h>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "velox/exec/Exchange.h"
+
+namespace facebook::presto {
+
+/// Reads the output of a broadcast stage for the tasks of the same query on
+/// this worker. The first source for a producer task fetches the pages of its
+/// output buffer once. All the sources of the query for that producer, i.e.
+/// the exchanges of the build sides of its broadcast joins, read the same
+/// pages, which are kept until the query context is destroyed. The other
+/// sources only delete their own output buffers of the producer.
+class SharedBroadcastExchangeSource : public velox::exec::ExchangeSource {
+ public:
+  /// The pages fetched from the output buffer of one producer task.
+  class Broadcast;
+
+  SharedBroadcastExchangeSource(
+      const std::string& taskId,
+      int destination,
+      std::shared_ptr<velox::exec::ExchangeQueue> queue,
+      velox::memory::MemoryPool* pool,
+      std::shared_ptr<Broadcast> broadcast,
+      std::shared_ptr<velox::exec::ExchangeSource> bufferDeleter);
+
+  bool shouldRequestLocked() override;
+
+  void request() override;
+
+  void close() override;
+
+  /// Returns a shared source if 'url' points at the output buffer of a task
+  /// of a stage registered by addQuery(). Returns null otherwise.
+  static std::unique_ptr<velox::exec::ExchangeSource> createExchangeSource(
+      const std::string& url,
+      int destination,
+      std::shared_ptr<velox::exec::ExchangeQueue> queue,
+      velox::memory::MemoryPool* pool);
+
+  /// Marks the 'fragmentIds' of 'queryId' as broadcast to all the consumer
+  /// tasks so that the tasks on this worker share their output.
+  static void addQuery(
+      const std::string& queryId,
+      const std::vector<std::string>& fragmentIds);
+
+  /// Drops the registered stages and the fetched pages of 'queryId'.
+  static void removeQuery(const std::string& queryId);
+
+  /// Returns the number of queries with registered broadcast stages.
+  static size_t numQueries();
+
+ private:
+  // Enqueues the 'pages' published after the ones read so far. An 'error'
+  // fails the consumer.
+  void enqueue(
+      std::vector<std::unique_ptr<folly::IOBuf>> pages,
+      bool atEnd,
+      const std::string& error);
+
+  std::shared_ptr<SharedBroadcastExchangeSource> getSelfPtr();
+
+  struct QueryBroadcasts {
+    std::unordered_set<std::string> fragmentIds;
+    // Keyed by the producer task id.
+    std::unordered_map<std::string, std::shared_ptr<Broadcast>> broadcasts;
+  };
+
+  using QueryBroadcastsMap =
+      folly::Synchronized<std::unordered_map<std::string, QueryBroadcasts>>;
+
+  static QueryBroadcastsMap& queries() {
+    static QueryBroadcastsMap queries;
+    return queries;
+  }
+
+  const std::shared_ptr<Broadcast> broadcast_;
+  // Deletes the output buffer of this source in the producer if another
+  // source fetches the broadcast pages.
+  const std::shared_ptr<velox::exec::ExchangeSource> bufferDeleter_;
+  // The index of the next broadcast page to enqueue. Guarded by the mutex of
+  // 'broadcast_'.
+  size_t nextPage_{0};
+  std::atomic_bool closed_{false};
+};
+
+/// Fetches the pages of the output buffer at 'url' into an exchange queue of
+/// its own and publishes them to the sources reading them.
+class SharedBroadcastExchangeSource::Broadcast
+    : public std::enable_shared_from_this<Broadcast> {
+ public:
+  /// Creates a broadcast whose pages are published by publish() instead of
+  /// being fetched. Used in tests.
+  Broadcast() = default;
+
+  ~Broadcast();
+
+  /// Starts fetching the pages of the output buffer at 'url' into 'pool', the
+  /// pool of the task of the first source. The broadcast keeps 'pool' alive
+  /// since its pages outlive that task.
+  void start(
+      const std::string& url,
+      int destination,
+      velox::memory::MemoryPool* pool);
+
+  /// Enqueues the pages 'reader' has not read yet into its queue, or enqueues
+  /// them once they are published.
+  void read(const std::shared_ptr<SharedBroadcastExchangeSource>& reader);
+
+  /// Adds 'pages' to the broadcast and notifies the waiting readers.
+  void publish(
+      std::vector<std::unique_ptr<folly::IOBuf>> pages,
+      bool atEnd,
+      const std::string& error);
+
+  /// Stops notifying 'reader' of the published pages. Called when 'reader' is
+  /// closed so that the waiters do not keep it alive.
+  void removeWaiter(const SharedBroadcastExchangeSource* reader);
+
+ private:
+  // Moves the pages of 'queue_' to the broadcast and requests more.
+  void fetch();
+
+  // Declared first so that the pages are freed before it.
+  std::shared_ptr<velox::memory::MemoryPool> pool_;
+  std::shared_ptr<velox::exec::ExchangeQueue> queue_;
+  std::shared_ptr<velox::exec::ExchangeSource> upstream_;
+
+  std::mutex mutex_;
+  std::vector<std::unique_ptr<folly::IOBuf>> pages_;
+  bool atEnd_{false};
+  std::string error_;
+  std::vector<std::shared_ptr<SharedBroadcastExchangeSource>> waiters_;
+};
+
+} // namespace facebook::presto
@@ -0,0 +1,120 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/SpillDirectoryCleaner.h"
+#include <glog/logging.h>
+#include <vector>
+
+#if __has_include("filesystem")
+#include <filesystem>
+namespace fs = std::filesystem;
+#else
+#include <experimental/filesystem>
+namespace fs = std::experimental::filesystem;
+#endif
+
+namespace facebook::presto {
+namespace {
+
+// The directory all the query directories of a date are under.
+constexpr const char* kSpillUserDirectory = "presto_native";
+
+// Returns the bytes of the files under 'path'.
+uint64_t directoryBytes(const fs::path& path) {
+  uint64_t bytes{0};
+  std::error_code ec;
+  for (fs::recursive_directory_iterator it(path, ec), end; !ec && it != end;
+       it.increment(ec)) {
+    std::error_code sizeEc;
+    if (it->is_regular_file(sizeEc)) {
+      const auto size = it->file_size(sizeEc);
+      if (!sizeEc) {
+        bytes += size;
+      }
+    }
+  }
+  return bytes;
+}
+
+// Returns true if 'path' was not modified for 'minAge'.
+bool isOld(const fs::path& path, std::chrono::seconds minAge) {
+  std::error_code ec;
+  const auto modified = fs::last_write_time(path, ec);
+  return !ec && fs::file_time_type::clock::now() - modified >= minAge;
+}
+
+// Removes 'path' if it is an empty directory not modified for 'minAge'. A new
+// task may be creating its directory under a recently changed one.
+void removeIfEmpty(const fs::path& path, std::chrono::seconds minAge) {
+  std::error_code ec;
+  if (fs::is_empty(path, ec) && !ec && isOld(path, minAge)) {
+    fs::remove(path, ec);
+  }
+}
+
+std::vector<fs::path> subdirectories(const fs::path& path) {
+  std::vector<fs::path> directories;
+  std::error_code ec;
+  for (fs::directory_iterator it(path, ec), end; !ec && it != end;
+       it.increment(ec)) {
+    std::error_code typeEc;
+    if (it->is_directory(typeEc)) {
+      directories.push_back(it->path());
+    }
+  }
+  return directories;
+}
+} // namespace
+
+SpillCleanupStats cleanupSpillDirectories(
+    const std::string& basePath,
+    const std::function<bool(const std::string& taskId)>& isLiveTask,
+    std::chrono::seconds minAge) {
+  SpillCleanupStats stats;
+  if (basePath.empty() || basePath[0] != '/') {
+    return stats;
+  }
+  // <base>/<date>/presto_native/<query id>/<task id>/
+  for (const auto& dateDirectory : subdirectories(basePath)) {
+    const auto userDirectory = dateDirectory / kSpillUserDirectory;
+    for (const auto& queryDirectory : subdirectories(userDirectory)) {
+      for (const auto& taskDirectory : subdirectories(queryDirectory)) {
+        if (isLiveTask(taskDirectory.filename().string()) ||
+            !isOld(taskDirectory, minAge)) {
+          continue;
+        }
+        const auto bytes = directoryBytes(taskDirectory);
+        std::error_code ec;
+        fs::remove_all(taskDirectory, ec);
+        if (ec) {
+          LOG(WARNING) << "Cannot delete spill directory " << taskDirectory
+                       << ": " << ec.message();
+          continue;
+        }
+        ++stats.numDirectories;
+        stats.bytes += bytes;
+      }
+      removeIfEmpty(queryDirectory, minAge);
+    }
+    removeIfEmpty(userDirectory, minAge);
+    removeIfEmpty(dateDirectory, minAge);
+  }
+  if (stats.numDirectories > 0) {
+    LOG(INFO) << "Deleted " << stats.numDirectories
+              << " orphaned spill directories of " << stats.bytes
+              << " bytes under " << basePath;
+  }
+  return stats;
+}
+
+} // namespace facebook::presto
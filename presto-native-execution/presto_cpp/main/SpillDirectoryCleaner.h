@@ -0,0 +1,41 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+namespace facebook::presto {
+
+struct SpillCleanupStats {
+  /// The task spill directories deleted.
+  uint64_t numDirectories{0};
+  /// The bytes of the files in them.
+  uint64_t bytes{0};
+};
+
+/// Deletes the task spill directories under the local 'basePath', laid out
+/// as by TaskManager::buildTaskSpillDirectoryPath(), whose task is not
+/// 'isLiveTask' and which were not modified for 'minAge'. These are left by
+/// a crash or by the aborted tasks. The empty query and date directories not
+/// modified for 'minAge' are removed as well. Ignores the paths of the other
+/// file systems.
+SpillCleanupStats cleanupSpillDirectories(
+    const std::string& basePath,
+    const std::function<bool(const std::string& taskId)>& isLiveTask,
+    std::chrono::seconds minAge);
+
+} // namespace facebook::presto
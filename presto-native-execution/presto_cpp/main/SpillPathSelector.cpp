@@ -0,0 +1,174 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/SpillPathSelector.h"
+#include <folly/Random.h>
+#include <glog/logging.h>
+#include "velox/common/base/Exceptions.h"
+#include "velox/common/time/Timer.h"
+
+#if __has_include("filesystem")
+#include <filesystem>
+namespace fs = std::filesystem;
+#else
+#include <experimental/filesystem>
+namespace fs = std::experimental::filesystem;
+#endif
+
+namespace facebook::presto {
+namespace {
+
+// Returns the free space of the file system of a local path, which may not
+// exist yet, 0 if it cannot be read and std::nullopt for the other paths.
+std::optional<uint64_t> localFreeBytes(const std::string& path) {
+  if (path.empty() || path[0] != '/') {
+    return std::nullopt;
+  }
+  std::error_code ec;
+  // The spill directories are created on first use.
+  fs::path existing(path);
+  while (!fs::exists(existing, ec) && existing.has_parent_path() &&
+         existing != existing.parent_path()) {
+    existing = existing.parent_path();
+  }
+  const auto space = fs::space(existing, ec);
+  if (ec) {
+    LOG(WARNING) << "Cannot read the free space of spill path " << path
+                 << ": " << ec.message();
+    return 0;
+  }
+  return space.available;
+}
+} // namespace
+
+SpillPathSelector::SpillPathSelector(
+    std::vector<std::string> paths,
+    Policy policy,
+    uint64_t minFreeBytes,
+    FreeBytesFunc freeBytes,
+    uint64_t retryMs)
+    : policy_(policy),
+      minFreeBytes_(minFreeBytes),
+      freeBytes_(freeBytes ? std::move(freeBytes) : localFreeBytes),
+      retryMs_(retryMs) {
+  paths_.reserve(paths.size());
+  for (auto& path : paths) {
+    paths_.push_back({PathStats{std::move(path)}});
+  }
+}
+
+// static
+SpillPathSelector::Policy SpillPathSelector::policyFromString(
+    const std::string& name) {
+  if (name == "round-robin") {
+    return Policy::kRoundRobin;
+  }
+  if (name == "free-space") {
+    return Policy::kFreeSpace;
+  }
+  VELOX_USER_FAIL("Unknown spill path policy '{}'", name);
+}
+
+bool SpillPathSelector::usableLocked(const Path& path, uint64_t nowMs) const {
+  return path.unhealthyUntilMs <= nowMs;
+}
+
+std::string SpillPathSelector::next() {
+  const auto nowMs = velox::getCurrentTimeMs();
+  std::lock_guard<std::mutex> l(mutex_);
+  if (policy_ == Policy::kFreeSpace) {
+    uint64_t totalFreeBytes{0};
+    for (const auto& path : paths_) {
+      if (usableLocked(path, nowMs)) {
+        totalFreeBytes += path.stats.freeBytes;
+      }
+    }
+    // Falls back to the round robin while the free space is not known.
+    if (totalFreeBytes > 0) {
+      auto point = folly::Random::rand64(totalFreeBytes);
+      for (auto& path : paths_) {
+        if (!usableLocked(path, nowMs)) {
+          continue;
+        }
+        if (point < path.stats.freeBytes) {
+          ++path.stats.numAssigned;
+          return path.stats.path;
+        }
+        point -= path.stats.freeBytes;
+      }
+    }
+  }
+  for (size_t i = 0; i < paths_.size(); ++i) {
+    auto& path = paths_[nextIndex_++ % paths_.size()];
+    if (usableLocked(path, nowMs)) {
+      ++path.stats.numAssigned;
+      return path.stats.path;
+    }
+  }
+  return "";
+}
+
+void SpillPathSelector::markUnhealthy(const std::string& path) {
+  const auto nowMs = velox::getCurrentTimeMs();
+  std::lock_guard<std::mutex> l(mutex_);
+  for (auto& entry : paths_) {
+    if (entry.stats.path == path) {
+      LOG(WARNING) << "Spill path " << path << " is out of the rotation for "
+                   << retryMs_ << "ms";
+      entry.unhealthyUntilMs = nowMs + retryMs_;
+    }
+  }
+}
+
+void SpillPathSelector::refresh() {
+  std::vector<std::string> paths;
+  {
+    std::lock_guard<std::mutex> l(mutex_);
+    for (const auto& path : paths_) {
+      paths.push_back(path.stats.path);
+    }
+  }
+  // Reads the free space outside of the mutex, a slow drive does not hold up
+  // the task creation.
+  std::vector<std::optional<uint64_t>> freeBytes;
+  freeBytes.reserve(paths.size());
+  for (const auto& path : paths) {
+    freeBytes.push_back(freeBytes_(path));
+  }
+  const auto nowMs = velox::getCurrentTimeMs();
+  std::lock_guard<std::mutex> l(mutex_);
+  for (size_t i = 0; i < paths_.size(); ++i) {
+    auto& path = paths_[i];
+    if (!freeBytes[i].has_value()) {
+      continue;
+    }
+    path.stats.freeBytes = freeBytes[i].value();
+    if (path.stats.freeBytes == 0 || path.stats.freeBytes < minFreeBytes_) {
+      path.unhealthyUntilMs = nowMs + retryMs_;
+    }
+  }
+}
+
+std::vector<SpillPathSelector::PathStats> SpillPathSelector::stats() const {
+  const auto nowMs = velox::getCurrentTimeMs();
+  std::lock_guard<std::mutex> l(mutex_);
+  std::vector<PathStats> stats;
+  stats.reserve(paths_.size());
+  for (const auto& path : paths_) {
+    stats.push_back(path.stats);
+    stats.back().healthy = usableLocked(path, nowMs);
+  }
+  return stats;
+}
+
+} // namespace facebook::presto
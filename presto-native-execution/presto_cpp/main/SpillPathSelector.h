@@ -0,0 +1,108 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace facebook::presto {
+
+/// Spreads the spill directories of the tasks over several spill paths, e.g.
+/// one per local drive, so that the spilling tasks use all the drives. A
+/// path is taken out of the rotation for 'retryMs' when a directory cannot be
+/// created on it, or when its free space is found to be 0 or below
+/// 'minFreeBytes'.
+class SpillPathSelector {
+ public:
+  enum class Policy {
+    /// The paths in turn.
+    kRoundRobin,
+    /// A path at random in proportion to its free space, so that the fuller
+    /// drives get fewer tasks.
+    kFreeSpace,
+  };
+
+  /// Returns the free bytes of the file system of a path, 0 if they cannot be
+  /// read and std::nullopt if they are not known, e.g. for a remote path.
+  using FreeBytesFunc = std::function<std::optional<uint64_t>(
+      const std::string& path)>;
+
+  static constexpr uint64_t kDefaultRetryMs{60'000};
+
+  struct PathStats {
+    std::string path;
+    bool healthy{true};
+    /// As of the last refresh(), 0 if never refreshed.
+    uint64_t freeBytes{0};
+    /// The tasks given this path since the start.
+    uint64_t numAssigned{0};
+  };
+
+  /// 'freeBytes' defaults to the free space of the local file system of the
+  /// path, the free space is not checked on the other file systems.
+  SpillPathSelector(
+      std::vector<std::string> paths,
+      Policy policy = Policy::kRoundRobin,
+      uint64_t minFreeBytes = 0,
+      FreeBytesFunc freeBytes = nullptr,
+      uint64_t retryMs = kDefaultRetryMs);
+
+  /// Parses the policy name, 'round-robin' or 'free-space'.
+  static Policy policyFromString(const std::string& name);
+
+  bool empty() const {
+    return paths_.empty();
+  }
+
+  size_t size() const {
+    return paths_.size();
+  }
+
+  /// Returns the path for the next task, empty if there is no healthy path.
+  std::string next();
+
+  /// Takes 'path' out of the rotation for the retry time, e.g. after the
+  /// spill directory of a task could not be created on it.
+  void markUnhealthy(const std::string& path);
+
+  /// Reads the free space of the paths and updates their health. Called
+  /// periodically.
+  void refresh();
+
+  std::vector<PathStats> stats() const;
+
+ private:
+  struct Path {
+    PathStats stats;
+    // The time in ms until which the path is out of the rotation.
+    uint64_t unhealthyUntilMs{0};
+  };
+
+  bool usableLocked(const Path& path, uint64_t nowMs) const;
+
+  const Policy policy_;
+  const uint64_t minFreeBytes_;
+  const FreeBytesFunc freeBytes_;
+  const uint64_t retryMs_;
+
+  mutable std::mutex mutex_;
+  std::vector<Path> paths_;
+  size_t nextIndex_{0};
+};
+
+} // namespace facebook::presto
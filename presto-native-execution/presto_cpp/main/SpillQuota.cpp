@@ -0,0 +1,78 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/SpillQuota.h"
+
+#include <algorithm>
+#include <functional>
+
+namespace facebook::presto {
+
+std::vector<std::string> SpillQuota::update(
+    std::unordered_map<std::string, uint64_t> queryBytes) {
+  uint64_t nodeBytes = 0;
+  for (const auto& [queryId, bytes] : queryBytes) {
+    nodeBytes += bytes;
+  }
+  std::vector<std::pair<uint64_t, std::string>> others;
+  std::vector<std::string> toFail;
+  uint64_t remainingBytes = nodeBytes;
+  for (const auto& [queryId, bytes] : queryBytes) {
+    if (maxBytesPerQuery_ > 0 && bytes > maxBytesPerQuery_) {
+      toFail.push_back(queryId);
+      remainingBytes -= bytes;
+    } else {
+      others.emplace_back(bytes, queryId);
+    }
+  }
+  if (maxBytesPerNode_ > 0 && remainingBytes > maxBytesPerNode_) {
+    std::sort(others.begin(), others.end(), std::greater<>());
+    for (const auto& [bytes, queryId] : others) {
+      if (remainingBytes <= maxBytesPerNode_) {
+        break;
+      }
+      toFail.push_back(queryId);
+      remainingBytes -= bytes;
+    }
+  }
+
+  std::lock_guard<std::mutex> l(mutex_);
+  queryBytes_ = std::move(queryBytes);
+  nodeBytes_ = nodeBytes;
+  return toFail;
+}
+
+bool SpillQuota::canSpill(const std::string& queryId) const {
+  std::lock_guard<std::mutex> l(mutex_);
+  if (maxBytesPerNode_ > 0 && nodeBytes_ >= maxBytesPerNode_) {
+    return false;
+  }
+  if (maxBytesPerQuery_ == 0) {
+    return true;
+  }
+  auto it = queryBytes_.find(queryId);
+  return it == queryBytes_.end() || it->second < maxBytesPerQuery_;
+}
+
+uint64_t SpillQuota::nodeBytes() const {
+  std::lock_guard<std::mutex> l(mutex_);
+  return nodeBytes_;
+}
+
+uint64_t SpillQuota::queryBytes(const std::string& queryId) const {
+  std::lock_guard<std::mutex> l(mutex_);
+  auto it = queryBytes_.find(queryId);
+  return it == queryBytes_.end() ? 0 : it->second;
+}
+
+} // namespace facebook::presto
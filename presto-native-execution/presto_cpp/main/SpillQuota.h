@@ -0,0 +1,62 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace facebook::presto {
+
+/// Caps the bytes the tasks spill on this worker, per query and over all the
+/// queries, like max-spill-per-node and query-max-spill-per-node of the Java
+/// workers. Velox does not account for the spill files as they are written, so
+/// the bytes spilled by the running tasks of each query are reported
+/// periodically. A zero limit means no limit.
+class SpillQuota {
+ public:
+  SpillQuota(uint64_t maxBytesPerNode, uint64_t maxBytesPerQuery)
+      : maxBytesPerNode_(maxBytesPerNode),
+        maxBytesPerQuery_(maxBytesPerQuery) {}
+
+  bool enabled() const {
+    return maxBytesPerNode_ > 0 || maxBytesPerQuery_ > 0;
+  }
+
+  /// Replaces the spilled bytes of the queries with 'queryBytes' and returns
+  /// the queries to fail: those over the per query limit and, while the node
+  /// is over its limit, the largest spillers of the others.
+  std::vector<std::string> update(
+      std::unordered_map<std::string, uint64_t> queryBytes);
+
+  /// Returns true if the new tasks of 'queryId' may spill, i.e. neither the
+  /// query nor the node is at its limit.
+  bool canSpill(const std::string& queryId) const;
+
+  uint64_t nodeBytes() const;
+
+  uint64_t queryBytes(const std::string& queryId) const;
+
+ private:
+  const uint64_t maxBytesPerNode_;
+  const uint64_t maxBytesPerQuery_;
+
+  mutable std::mutex mutex_;
+  std::unordered_map<std::string, uint64_t> queryBytes_;
+  uint64_t nodeBytes_{0};
+};
+
+} // namespace facebook::presto
@@ -0,0 +1,151 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/SplitPruner.h"
+
+#include <folly/Conv.h>
+
+#include "velox/connectors/hive/HiveConnector.h"
+#include "velox/connectors/hive/HiveConnectorSplit.h"
+
+using namespace facebook::velox;
+
+namespace facebook::presto {
+namespace {
+
+// Returns false if 'value' of 'type' fails 'filter'. Returns true if it
+// passes or if the value can't be tested.
+bool testValue(
+    const common::Filter& filter,
+    const TypePtr& type,
+    const std::optional<std::string>& value) {
+  if (!value.has_value()) {
+    return filter.testNull();
+  }
+  switch (type->kind()) {
+    case TypeKind::BOOLEAN: {
+      auto result = folly::tryTo<bool>(*value);
+      return result.hasError() || filter.testBool(result.value());
+    }
+    case TypeKind::TINYINT:
+    case TypeKind::SMALLINT:
+    case TypeKind::INTEGER:
+    case TypeKind::BIGINT: {
+      auto result = folly::tryTo<int64_t>(*value);
+      return result.hasError() || filter.testInt64(result.value());
+    }
+    case TypeKind::REAL: {
+      auto result = folly::tryTo<float>(*value);
+      return result.hasError() || filter.testFloat(result.value());
+    }
+    case TypeKind::DOUBLE: {
+      auto result = folly::tryTo<double>(*value);
+      return result.hasError() || filter.testDouble(result.value());
+    }
+    case TypeKind::VARCHAR:
+      return filter.testBytes(value->data(), value->size());
+    default:
+      return true;
+  }
+}
+} // namespace
+
+std::shared_ptr<SplitPruner> SplitPruner::create(
+    const core::PlanNodePtr& plan) {
+  auto pruner = std::make_shared<SplitPruner>();
+  std::vector<const core::PlanNode*> nodes{plan.get()};
+  while (!nodes.empty()) {
+    const auto* node = nodes.back();
+    nodes.pop_back();
+    if (auto* tableScan = dynamic_cast<const core::TableScanNode*>(node)) {
+      pruner->addTableScan(*tableScan);
+    }
+    for (const auto& source : node->sources()) {
+      nodes.push_back(source.get());
+    }
+  }
+  return pruner->filters_.empty() ? nullptr : pruner;
+}
+
+void SplitPruner::addTableScan(const core::TableScanNode& tableScan) {
+  auto hiveTableHandle =
+      std::dynamic_pointer_cast<const connector::hive::HiveTableHandle>(
+          tableScan.tableHandle());
+  if (hiveTableHandle == nullptr) {
+    return;
+  }
+  // The filters and the partition keys of the splits are keyed by the names
+  // of the columns in the table, the assignments by the output variables.
+  std::unordered_map<std::string, const connector::hive::HiveColumnHandle*>
+      partitionKeys;
+  for (const auto& [variable, handle] : tableScan.assignments()) {
+    auto* column =
+        dynamic_cast<const connector::hive::HiveColumnHandle*>(handle.get());
+    if (column != nullptr &&
+        column->columnType() ==
+            connector::hive::HiveColumnHandle::ColumnType::kPartitionKey) {
+      partitionKeys.emplace(column->name(), column);
+    }
+  }
+  std::vector<ColumnFilter> filters;
+  for (const auto& [subfield, filter] : hiveTableHandle->subfieldFilters()) {
+    if (subfield.path().size() != 1) {
+      continue;
+    }
+    const auto name = subfield.toString();
+    if (name == kBucketColumn) {
+      filters.push_back({name, INTEGER(), filter.get()});
+      continue;
+    }
+    auto it = partitionKeys.find(name);
+    if (it != partitionKeys.end()) {
+      filters.push_back({name, it->second->dataType(), filter.get()});
+    }
+  }
+  if (!filters.empty()) {
+    filters_.emplace(tableScan.id(), std::move(filters));
+    tableHandles_.push_back(std::move(hiveTableHandle));
+  }
+}
+
+bool SplitPruner::canSkip(
+    const core::PlanNodeId& planNodeId,
+    const exec::Split& split) const {
+  auto it = filters_.find(planNodeId);
+  if (it == filters_.end()) {
+    return false;
+  }
+  auto hiveSplit =
+      std::dynamic_pointer_cast<const connector::hive::HiveConnectorSplit>(
+          split.connectorSplit);
+  if (hiveSplit == nullptr) {
+    return false;
+  }
+  for (const auto& column : it->second) {
+    if (column.name == kBucketColumn) {
+      if (hiveSplit->tableBucketNumber.has_value() &&
+          !column.filter->testInt64(*hiveSplit->tableBucketNumber)) {
+        return true;
+      }
+      continue;
+    }
+    auto value = hiveSplit->partitionKeys.find(column.name);
+    if (value != hiveSplit->partitionKeys.end() &&
+        !testValue(*column.filter, column.type, value->second)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+} // namespace facebook::presto
@@ -0,0 +1,61 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+
+#include "velox/connectors/Connector.h"
+#include "velox/core/PlanNode.h"
+#include "velox/exec/Split.h"
+#include "velox/type/Filter.h"
+
+namespace facebook::presto {
+
+/// Skips the hive splits whose partition key values or bucket fail the
+/// filters of their table scan, before they reach the Velox task opens their
+/// files.
+class SplitPruner {
+ public:
+  /// Returns the pruner of the table scans in 'plan' with filters on partition
+  /// keys or on the bucket, or null if there are none.
+  static std::shared_ptr<SplitPruner> create(
+      const velox::core::PlanNodePtr& plan);
+
+  /// Returns true if 'split' of the table scan 'planNodeId' produces no rows.
+  bool canSkip(
+      const velox::core::PlanNodeId& planNodeId,
+      const velox::exec::Split& split) const;
+
+  /// The name of the hidden column of the bucket number of a split.
+  static constexpr std::string_view kBucketColumn{"$bucket"};
+
+ private:
+  struct ColumnFilter {
+    std::string name;
+    velox::TypePtr type;
+    // Owned by the table handle in 'tableHandles_'.
+    const velox::common::Filter* filter;
+  };
+
+  void addTableScan(const velox::core::TableScanNode& tableScan);
+
+  // The filters on the partition keys or bucket of each table scan.
+  std::unordered_map<velox::core::PlanNodeId, std::vector<ColumnFilter>>
+      filters_;
+  std::vector<std::shared_ptr<const velox::connector::ConnectorTableHandle>>
+      tableHandles_;
+};
+
+} // namespace facebook::presto
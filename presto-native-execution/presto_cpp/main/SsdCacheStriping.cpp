@@ -0,0 +1,75 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/SsdCacheStriping.h"
+#include <fmt/format.h>
+#include <glog/logging.h>
+#include "velox/common/base/Exceptions.h"
+#include "velox/common/base/Fs.h"
+
+namespace facebook::presto {
+namespace {
+
+// Moves the shard file 'from' to 'to'. If it cannot be moved, deletes it and
+// the checkpoint files kept next to 'shardFile', the name SsdCache opens.
+void moveShardFile(
+    const fs::path& from,
+    const fs::path& to,
+    const fs::path& shardFile) {
+  std::error_code ec;
+  fs::rename(from, to, ec);
+  if (!ec) {
+    LOG(INFO) << "STARTUP: Moved SSD cache file " << from << " to " << to;
+    return;
+  }
+  LOG(WARNING) << "STARTUP: Deleting SSD cache file " << from
+               << " that cannot be moved to " << to << ": " << ec.message();
+  fs::remove(from, ec);
+  // The checkpoint would refer to the entries of the deleted file.
+  for (const auto* extension : {".cpt", ".log"}) {
+    fs::remove(shardFile.string() + extension, ec);
+  }
+}
+
+} // namespace
+
+std::string stripeSsdCacheFiles(
+    const std::vector<std::string>& paths,
+    int32_t numShards) {
+  VELOX_USER_CHECK(!paths.empty(), "No SSD cache path is configured");
+  for (int32_t shard = 0; shard < numShards; ++shard) {
+    const auto pathIndex = shard % paths.size();
+    const fs::path shardFile = fmt::format("{}{}", paths[0], shard);
+    const fs::path target = fmt::format("{}{}", paths[pathIndex], shard);
+    std::error_code ec;
+    if (fs::is_symlink(shardFile, ec)) {
+      const auto current = fs::read_symlink(shardFile, ec);
+      if (pathIndex != 0 && current == target) {
+        continue;
+      }
+      fs::remove(shardFile, ec);
+      if (fs::exists(current, ec)) {
+        moveShardFile(current, target, shardFile);
+      }
+    } else if (pathIndex != 0 && fs::exists(shardFile, ec)) {
+      // A shard file from before the striping.
+      moveShardFile(shardFile, target, shardFile);
+    }
+    if (pathIndex != 0) {
+      fs::create_symlink(target, shardFile);
+    }
+  }
+  return paths[0];
+}
+
+} // namespace facebook::presto
@@ -0,0 +1,36 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace facebook::presto {
+
+/// Spreads the 'numShards' files of the SSD cache over the file prefixes
+/// 'paths' round-robin, shard i going to paths[i % paths.size()]. SsdCache
+/// names its files by appending the shard number to one prefix, so the files
+/// of the shards placed on the other paths are symlinks from the first path.
+/// The first path also keeps the checkpoints of all the shards.
+///
+/// The shard files of an earlier layout are moved to their current path. A
+/// file that cannot be moved, e.g. to another device, is deleted with its
+/// checkpoint and the shard starts empty. Returns the prefix to create the
+/// SsdCache with.
+std::string stripeSsdCacheFiles(
+    const std::vector<std::string>& paths,
+    int32_t numShards);
+
+} // namespace facebook::presto
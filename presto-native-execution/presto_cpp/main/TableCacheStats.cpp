@@ -0,0 +1,79 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "presto_cpp/main/TableCacheStats.h"
+#include <algorithm>
+
+namespace facebook::presto {
+
+int64_t TableCacheStats::Stats::hitPct() const {
+  const auto bytes = totalBytes();
+  return bytes == 0 ? 0 : (ramReadBytes + ssdReadBytes) * 100 / bytes;
+}
+
+TableCacheStats::Stats& TableCacheStats::Stats::operator+=(
+    const Stats& other) {
+  numRamReads += other.numRamReads;
+  ramReadBytes += other.ramReadBytes;
+  numSsdReads += other.numSsdReads;
+  ssdReadBytes += other.ssdReadBytes;
+  numStorageReads += other.numStorageReads;
+  storageReadBytes += other.storageReadBytes;
+  return *this;
+}
+
+void TableCacheStats::record(const std::string& table, const Stats& stats) {
+  if (maxTables_ == 0) {
+    return;
+  }
+  std::lock_guard<std::mutex> l(mutex_);
+  auto it = tables_.find(table);
+  if (it != tables_.end()) {
+    it->second += stats;
+    return;
+  }
+  if (tables_.size() >= maxTables_) {
+    auto victim = std::min_element(
+        tables_.begin(), tables_.end(), [](const auto& a, const auto& b) {
+          return a.second.totalBytes() < b.second.totalBytes();
+        });
+    if (victim->second.totalBytes() > stats.totalBytes()) {
+      // Reads less than the tables tracked.
+      return;
+    }
+    tables_.erase(victim);
+  }
+  tables_.emplace(table, stats);
+}
+
+std::vector<std::pair<std::string, TableCacheStats::Stats>>
+TableCacheStats::topTables(size_t limit) const {
+  std::vector<std::pair<std::string, Stats>> tables;
+  {
+    std::lock_guard<std::mutex> l(mutex_);
+    tables.assign(tables_.begin(), tables_.end());
+  }
+  const auto numTables = std::min(limit, tables.size());
+  std::partial_sort(
+      tables.begin(),
+      tables.begin() + numTables,
+      tables.end(),
+      [](const auto& a, const auto& b) {
+        return a.second.totalBytes() > b.second.totalBytes();
+      });
+  tables.resize(numTables);
+  return tables;
+}
+
+} // namespace facebook::presto
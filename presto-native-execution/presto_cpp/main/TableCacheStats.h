@@ -0,0 +1,69 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace facebook::presto {
+
+/// Aggregates the reads of the table scans of the finished tasks by table, to
+/// tell which tables are served from the memory and SSD caches and which ones
+/// would gain from more cache capacity. Keeps the 'maxTables' tables with the
+/// most bytes read: a new table replaces the one with the fewest when full.
+class TableCacheStats {
+ public:
+  struct Stats {
+    int64_t numRamReads{0};
+    int64_t ramReadBytes{0};
+    int64_t numSsdReads{0};
+    int64_t ssdReadBytes{0};
+    int64_t numStorageReads{0};
+    int64_t storageReadBytes{0};
+
+    int64_t totalBytes() const {
+      return ramReadBytes + ssdReadBytes + storageReadBytes;
+    }
+
+    /// Percentage of the bytes read from the memory or SSD cache.
+    int64_t hitPct() const;
+
+    Stats& operator+=(const Stats& other);
+  };
+
+  /// Tracks nothing if 'maxTables' is 0.
+  explicit TableCacheStats(size_t maxTables) : maxTables_(maxTables) {}
+
+  void record(const std::string& table, const Stats& stats);
+
+  /// Returns up to 'limit' of the tables with the most bytes read, the most
+  /// first.
+  std::vector<std::pair<std::string, Stats>> topTables(size_t limit) const;
+
+  size_t numTables() const {
+    std::lock_guard<std::mutex> l(mutex_);
+    return tables_.size();
+  }
+
+ private:
+  const size_t maxTables_;
+
+  mutable std::mutex mutex_;
+  std::unordered_map<std::string, Stats> tables_;
+};
+
+} // namespace facebook::presto
@@ -0,0 +1,35 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/TaskAdmissionController.h"
+
+namespace facebook::presto {
+
+void TaskAdmissionController::update(const Load& load) {
+  std::lock_guard<std::mutex> l(mutex_);
+  load_ = load;
+}
+
+bool TaskAdmissionController::tryAdmit(int32_t numDrivers) {
+  std::lock_guard<std::mutex> l(mutex_);
+  if ((limits_.maxDrivers > 0 && load_.numDrivers >= limits_.maxDrivers) ||
+      (limits_.maxMemoryPct > 0 && load_.memoryPct >= limits_.maxMemoryPct) ||
+      (limits_.maxCpuLoadPct > 0 &&
+       load_.cpuLoadPct >= limits_.maxCpuLoadPct)) {
+    return false;
+  }
+  load_.numDrivers += numDrivers;
+  return true;
+}
+
+} // namespace facebook::presto
@@ -0,0 +1,60 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+
+namespace facebook::presto {
+
+/// Decides whether the new tasks start or wait for the load of the node to
+/// drop. A task waits while the drivers of the running tasks, the used query
+/// memory or the CPU load of the node is at or over its limit. The limits
+/// that are 0 are not checked. The load is sampled periodically, so the
+/// drivers of the tasks admitted since the last sample count as running.
+class TaskAdmissionController {
+ public:
+  struct Limits {
+    int64_t maxDrivers{0};
+    double maxMemoryPct{0};
+    double maxCpuLoadPct{0};
+  };
+
+  struct Load {
+    int64_t numDrivers{0};
+    double memoryPct{0};
+    double cpuLoadPct{0};
+  };
+
+  explicit TaskAdmissionController(const Limits& limits) : limits_(limits) {}
+
+  bool enabled() const {
+    return limits_.maxDrivers > 0 || limits_.maxMemoryPct > 0 ||
+        limits_.maxCpuLoadPct > 0;
+  }
+
+  /// Sets the load sampled now.
+  void update(const Load& load);
+
+  /// Returns true if a task of 'numDrivers' drivers may start now and counts
+  /// its drivers until the next update.
+  bool tryAdmit(int32_t numDrivers);
+
+ private:
+  const Limits limits_;
+  std::mutex mutex_;
+  Load load_;
+};
+
+} // namespace facebook::presto
@@ -16,7 +16,12 @@
 #include <boost/uuid/uuid.hpp>
 #include <boost/uuid/uuid_generators.hpp>
 #include <folly/container/F14Set.h>
+#include <condition_variable>
+#include <numeric>
 #include <velox/core/PlanNode.h>
+#include "presto_cpp/main/LongPollTimeout.h"
+#include "presto_cpp/main/PageChecksum.h"
+#include "presto_cpp/main/Tracer.h"
 #include "presto_cpp/main/common/Configs.h"
 #include "presto_cpp/main/common/Counters.h"
 #include "presto_cpp/main/common/Utils.h"
@@ -24,6 +29,8 @@
 #include "velox/common/base/StatsReporter.h"
 #include "velox/common/file/FileSystems.h"
 #include "velox/common/time/Timer.h"
+#include "velox/connectors/hive/HiveConnector.h"
+#include "velox/connectors/hive/HiveConnectorSplit.h"
 #include "velox/exec/Exchange.h"
 
 DEFINE_int32(
@@ -38,29 +45,185 @@ using facebook::presto::protocol::TaskInfo;
 
 namespace facebook::presto {
 
-// Unlimited concurrent lifespans is translated to this limit.
-constexpr uint32_t kMaxConcurrentLifespans{16};
-
 namespace {
 
 // If spilling is enabled and the given Task can spill, then this helper
-// generates the spilling directory path for the Task, creates that directory in
-// the file system and sets the path to it to the Task.
+// generates the spilling directory path for the Task under one of the spill
+// paths, creates that directory in the file system and sets the path to it to
+// the Task. A path the directory cannot be created on is taken out of the
+// rotation and the next one is tried. The Task does not spill if none works,
+// or if its query or the node has spilled up to its limit.
 static void maybeSetupTaskSpillDirectory(
     const core::PlanFragment& planFragment,
-    exec::Task& execTask) {
-  const auto baseSpillPath = SystemConfig::instance()->spillerSpillPath();
-  if (!baseSpillPath.empty() &&
-      planFragment.canSpill(execTask.queryCtx()->queryConfig())) {
+    exec::Task& execTask,
+    SpillPathSelector& spillPaths,
+    const SpillQuota& spillQuota) {
+  if (spillPaths.empty() ||
+      !planFragment.canSpill(execTask.queryCtx()->queryConfig())) {
+    return;
+  }
+  if (!spillQuota.canSpill(execTask.queryCtx()->queryId())) {
+    LOG(WARNING) << "Spill limit reached, task " << execTask.taskId()
+                 << " does not spill";
+    return;
+  }
+  for (size_t i = 0; i < spillPaths.size(); ++i) {
+    const auto baseSpillPath = spillPaths.next();
+    if (baseSpillPath.empty()) {
+      break;
+    }
     const auto taskSpillDirPath = TaskManager::buildTaskSpillDirectoryPath(
         baseSpillPath, execTask.queryCtx()->queryId(), execTask.taskId());
+    try {
+      // Create folder for the task spilling.
+      auto fileSystem =
+          velox::filesystems::getFileSystem(taskSpillDirPath, nullptr);
+      VELOX_CHECK_NOT_NULL(fileSystem, "File System is null!");
+      fileSystem->mkdir(taskSpillDirPath);
+    } catch (const std::exception& e) {
+      LOG(WARNING) << "Cannot create spill directory " << taskSpillDirPath
+                   << ": " << e.what();
+      spillPaths.markUnhealthy(baseSpillPath);
+      continue;
+    }
     execTask.setSpillDirectory(taskSpillDirPath);
-    // Create folder for the task spilling.
-    auto fileSystem =
-        velox::filesystems::getFileSystem(taskSpillDirPath, nullptr);
-    VELOX_CHECK_NOT_NULL(fileSystem, "File System is null!");
-    fileSystem->mkdir(taskSpillDirPath);
+    return;
+  }
+  LOG(WARNING) << "No healthy spill path, task " << execTask.taskId()
+               << " does not spill";
+}
+
+// Maps the ids of the scans of Hive tables under 'node' to their tables.
+void collectScannedTables(
+    const core::PlanNodePtr& node,
+    std::unordered_map<core::PlanNodeId, std::string>& tables) {
+  if (auto scan = std::dynamic_pointer_cast<const core::TableScanNode>(node)) {
+    if (auto hiveTable =
+            std::dynamic_pointer_cast<const connector::hive::HiveTableHandle>(
+                scan->tableHandle())) {
+      tables.emplace(scan->id(), hiveTable->tableName());
+    }
+  }
+  for (const auto& source : node->sources()) {
+    collectScannedTables(source, tables);
+  }
+}
+
+// Adds the memory cache, SSD cache and storage reads of the table scans of
+// 'task' to 'tableCacheStats'.
+void recordTableCacheStats(
+    const exec::Task& task,
+    TableCacheStats& tableCacheStats) {
+  std::unordered_map<core::PlanNodeId, std::string> tables;
+  collectScannedTables(task.planFragment().planNode, tables);
+  if (tables.empty()) {
+    return;
+  }
+  const auto taskStats = task.taskStats();
+  for (const auto& pipelineStats : taskStats.pipelineStats) {
+    for (const auto& operatorStats : pipelineStats.operatorStats) {
+      auto it = tables.find(operatorStats.planNodeId);
+      if (it == tables.end()) {
+        continue;
+      }
+      const auto metric = [&](const std::string& name) -> int64_t {
+        auto metricIt = operatorStats.runtimeStats.find(name);
+        return metricIt == operatorStats.runtimeStats.end()
+            ? 0
+            : metricIt->second.sum;
+      };
+      TableCacheStats::Stats stats;
+      stats.numRamReads = metric("numRamRead");
+      stats.ramReadBytes = metric("ramReadBytes");
+      stats.numSsdReads = metric("numLocalRead");
+      stats.ssdReadBytes = metric("localReadBytes");
+      stats.numStorageReads = metric("numStorageRead");
+      stats.storageReadBytes = metric("storageReadBytes");
+      tableCacheStats.record(it->second, stats);
+    }
+  }
+}
+
+// Adds the ids of the leaves of 'node' to 'scanIds'. Returns false if a leaf
+// is not a table scan.
+bool collectLeafScans(
+    const core::PlanNodePtr& node,
+    folly::F14FastSet<core::PlanNodeId>& scanIds) {
+  if (node->sources().empty()) {
+    if (!std::dynamic_pointer_cast<const core::TableScanNode>(node)) {
+      return false;
+    }
+    scanIds.insert(node->id());
+    return true;
+  }
+  for (const auto& source : node->sources()) {
+    if (!collectLeafScans(source, scanIds)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Returns true if the leaves of 'planFragment' are all table scans that get
+// all their splits in 'sources'.
+bool getsAllScanSplits(
+    const core::PlanFragment& planFragment,
+    const std::vector<protocol::TaskSource>& sources) {
+  folly::F14FastSet<core::PlanNodeId> scanIds;
+  if (!collectLeafScans(planFragment.planNode, scanIds)) {
+    return false;
+  }
+  for (const auto& source : sources) {
+    if (scanIds.erase(source.planNodeId) == 0 || !source.noMoreSplits) {
+      return false;
+    }
+  }
+  // More splits may come for the scans missing from 'sources'.
+  return scanIds.empty();
+}
+
+bool hasTableWrite(const core::PlanNodePtr& node) {
+  if (std::dynamic_pointer_cast<const core::TableWriteNode>(node)) {
+    return true;
+  }
+  for (const auto& source : node->sources()) {
+    if (hasTableWrite(source)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Adds the resources used by 'task' to the totals of its query.
+void recordQueryResources(
+    const exec::Task& task,
+    QueryResourceLedger& queryResources) {
+  const auto taskStats = task.taskStats();
+  QueryResourceLedger::Resources resources;
+  resources.numTasks = 1;
+  for (const auto& pipelineStats : taskStats.pipelineStats) {
+    for (const auto& operatorStats : pipelineStats.operatorStats) {
+      for (const auto* timing :
+           {&operatorStats.addInputTiming,
+            &operatorStats.getOutputTiming,
+            &operatorStats.finishTiming}) {
+        resources.cpuNanos += timing->cpuNanos;
+        resources.wallNanos += timing->wallNanos;
+      }
+      resources.spilledBytes += operatorStats.spilledBytes;
+      if (operatorStats.operatorType == "Exchange" ||
+          operatorStats.operatorType == "MergeExchange") {
+        resources.exchangeInputBytes += operatorStats.rawInputBytes;
+      } else if (operatorStats.operatorType == "PartitionedOutput") {
+        resources.exchangeOutputBytes += operatorStats.inputBytes;
+      }
+    }
   }
+  resources.peakMemoryBytes =
+      task.queryCtx()->pool()->getMemoryUsageTracker()->peakBytes();
+  const auto& taskId = task.taskId();
+  queryResources.record(
+      taskId.substr(0, taskId.find('.')), resources, getCurrentTimeMs());
 }
 
 bool isFinalState(protocol::TaskState state) {
@@ -75,6 +238,98 @@ bool isFinalState(protocol::TaskState state) {
   }
 }
 
+// Converts the splits of a task update to Velox splits in batches. The batches
+// are claimed by the thread receiving the update and by helper tasks on the
+// driver executor. Only the receiving thread waits, and only for the batches
+// to be converted: the helpers which start late find nothing left to claim,
+// hence the shared ownership of the state.
+class SplitConversion : public std::enable_shared_from_this<SplitConversion> {
+ public:
+  SplitConversion(
+      const std::vector<protocol::TaskSource>& sources,
+      int32_t batchSize)
+      : sources_(sources), splits_(sources.size()) {
+    for (size_t i = 0; i < sources.size(); ++i) {
+      const auto numSplits = sources[i].splits.size();
+      splits_[i].resize(numSplits);
+      const size_t step = batchSize > 0 ? batchSize : numSplits;
+      for (size_t begin = 0; begin < numSplits; begin += step) {
+        batches_.push_back({i, begin, std::min(begin + step, numSplits)});
+      }
+    }
+  }
+
+  size_t numBatches() const {
+    return batches_.size();
+  }
+
+  // Returns the Velox splits of each source.
+  std::vector<std::vector<exec::Split>> run(
+      folly::CPUThreadPoolExecutor* executor) {
+    if (executor != nullptr) {
+      const auto numHelpers = std::min<size_t>(
+          batches_.size() > 0 ? batches_.size() - 1 : 0,
+          executor->numThreads());
+      for (size_t i = 0; i < numHelpers; ++i) {
+        executor->add(
+            [self = shared_from_this()]() { self->convertBatches(); });
+      }
+    }
+    convertBatches();
+
+    std::unique_lock<std::mutex> l(mutex_);
+    cv_.wait(l, [&]() { return numConverted_ == batches_.size(); });
+    if (error_) {
+      std::rethrow_exception(error_);
+    }
+    return std::move(splits_);
+  }
+
+ private:
+  struct Batch {
+    size_t source;
+    size_t begin;
+    size_t end;
+  };
+
+  void convertBatches() {
+    for (auto i = nextBatch_++; i < batches_.size(); i = nextBatch_++) {
+      const auto& batch = batches_[i];
+      std::exception_ptr error;
+      try {
+        const auto& protocolSplits = sources_[batch.source].splits;
+        auto& splits = splits_[batch.source];
+        VeloxSplitConverter converter;
+        for (auto j = batch.begin; j < batch.end; ++j) {
+          splits[j] = converter.toVeloxSplit(protocolSplits[j]);
+        }
+      } catch (const std::exception&) {
+        error = std::current_exception();
+      }
+
+      std::lock_guard<std::mutex> l(mutex_);
+      if (error && !error_) {
+        error_ = error;
+      }
+      if (++numConverted_ == batches_.size()) {
+        cv_.notify_one();
+      }
+    }
+  }
+
+  // Only accessed while the receiving thread waits in run().
+  const std::vector<protocol::TaskSource>& sources_;
+  std::vector<std::vector<exec::Split>> splits_;
+
+  std::vector<Batch> batches_;
+  std::atomic<size_t> nextBatch_{0};
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  size_t numConverted_{0};
+  std::exception_ptr error_;
+};
+
 // Keep outstanding Promises in RequestHandler's state itself.
 //
 // If the promise is not fulfilled yet, resetting promiseHolder will
@@ -92,6 +347,18 @@ void keepPromiseAlive(
   handlerState->runOnFinalization(
       [promiseHolder]() mutable { promiseHolder.reset(); });
 }
+
+OutputBufferSpiller::Options outputBufferSpillerOptions() {
+  const auto* systemConfig = SystemConfig::instance();
+  OutputBufferSpiller::Options options;
+  options.spillPath = systemConfig->outputBufferSpillPath();
+  options.memoryPct = systemConfig->outputBufferSpillMemoryPct();
+  options.minIdle =
+      std::chrono::milliseconds(systemConfig->outputBufferSpillMinIdleMs());
+  options.maxBytesPerDestination =
+      systemConfig->outputBufferSpillMaxBytesPerDestination();
+  return options;
+}
 } // namespace
 
 TaskManager::TaskManager(
@@ -99,10 +366,34 @@ TaskManager::TaskManager(
     std::unordered_map<std::string, std::string> nodeProperties)
     : bufferManager_(
           velox::exec::PartitionedOutputBufferManager::getInstance().lock()),
+      outputBufferSpiller_(std::make_shared<OutputBufferSpiller>(
+          bufferManager_,
+          driverCPUExecutor(),
+          outputBufferSpillerOptions())),
       queryContextManager_(properties, nodeProperties),
       maxDriversPerTask_(SystemConfig::instance()->maxDriversPerTask()),
       concurrentLifespansPerTask_(
-          SystemConfig::instance()->concurrentLifespansPerTask()) {
+          SystemConfig::instance()->concurrentLifespansPerTask()),
+      checksumPages_(SystemConfig::instance()->enableSerializedPageChecksum()),
+      rootStageMaxResultBytes_(
+          SystemConfig::instance()->taskRootStageMaxResultBytes()),
+      tableCacheStats_(SystemConfig::instance()->tableCacheStatsMaxTables()),
+      spillPaths_(
+          SystemConfig::instance()->spillerSpillPaths(),
+          SpillPathSelector::policyFromString(
+              SystemConfig::instance()->spillerSpillPathPolicy()),
+          SystemConfig::instance()->spillerSpillPathMinFreeGb() << 30),
+      spillQuota_(
+          SystemConfig::instance()->maxSpillPerNodeGb() << 30,
+          SystemConfig::instance()->queryMaxSpillPerNodeGb() << 30),
+      maxRecentFiles_(SystemConfig::instance()->taskSplitOrderingRecentFiles()),
+      recentFiles_(folly::in_place, std::max<size_t>(maxRecentFiles_, 1)),
+      fragmentResultCache_(
+          SystemConfig::instance()->fragmentResultCacheMaxBytes()),
+      admissionController_(
+          {SystemConfig::instance()->taskAdmissionMaxDrivers(),
+           SystemConfig::instance()->taskAdmissionMaxMemoryPct(),
+           SystemConfig::instance()->taskAdmissionMaxCpuLoadPct()}) {
   VELOX_CHECK_NOT_NULL(
       bufferManager_, "invalid PartitionedOutputBufferManager");
 }
@@ -110,7 +401,7 @@ TaskManager::TaskManager(
 void TaskManager::abortResults(const TaskId& taskId, long bufferId) {
   VLOG(1) << "TaskManager::abortResults " << taskId;
 
-  bufferManager_->deleteResults(taskId, bufferId);
+  outputBufferSpiller_->deleteResults(taskId, bufferId);
 }
 
 void TaskManager::acknowledgeResults(
@@ -119,7 +410,7 @@ void TaskManager::acknowledgeResults(
     long token) {
   VLOG(1) << "TaskManager::acknowledgeResults " << taskId << ", " << bufferId
           << ", " << token;
-  bufferManager_->acknowledge(taskId, bufferId, token);
+  outputBufferSpiller_->acknowledge(taskId, bufferId, token);
 }
 
 namespace {
@@ -138,19 +429,24 @@ void getData(
     long bufferId,
     long token,
     protocol::DataSize maxSize,
-    exec::PartitionedOutputBufferManager& bufferManager) {
+    OutputBufferSpiller& bufferSpiller,
+    bool checksumPages) {
   if (promiseHolder == nullptr) {
     // promise/future is expired.
     return;
   }
 
   int64_t startMs = getCurrentTimeMs();
-  auto bufferFound = bufferManager.getData(
+  auto bufferFound = bufferSpiller.getData(
       taskId,
       bufferId,
       maxSize.getValue(protocol::DataUnit::BYTE),
       token,
-      [taskId = taskId, bufferId = bufferId, promiseHolder, startMs](
+      [taskId = taskId,
+       bufferId = bufferId,
+       promiseHolder,
+       startMs,
+       checksumPages](
           std::vector<std::unique_ptr<folly::IOBuf>> pages,
           int64_t sequence) mutable {
         bool complete = pages.empty();
@@ -160,6 +456,9 @@ void getData(
         for (auto& page : pages) {
           if (page) {
             VELOX_CHECK(!complete, "Received data after end marker");
+            if (checksumPages) {
+              setPageChecksum(*page);
+            }
             if (!iobuf) {
               iobuf = std::move(page);
               bytes = iobuf->length();
@@ -214,7 +513,9 @@ std::unique_ptr<TaskInfo> TaskManager::createOrUpdateErrorTask(
     prestoTask->info.needsPlan = false;
   }
 
-  auto info = prestoTask->updateInfo();
+  std::lock_guard<std::mutex> l(prestoTask->mutex);
+  auto info = prestoTask->updateInfoLocked();
+  publishTaskStateLocked(*prestoTask, info.taskStatus.state);
   return std::make_unique<TaskInfo>(info);
 }
 
@@ -258,7 +559,8 @@ void TaskManager::getDataForResultRequests(
         resultRequest->bufferId,
         resultRequest->token,
         resultRequest->maxSize,
-        *bufferManager_);
+        *outputBufferSpiller_,
+        checksumPages_);
   }
 }
 
@@ -271,7 +573,48 @@ std::unique_ptr<TaskInfo> TaskManager::createOrUpdateTask(
     std::unordered_map<
         std::string,
         std::unordered_map<std::string, std::string>>&&
-        connectorConfigStrings) {
+        connectorConfigStrings,
+    uint64_t filterConversionNanos) {
+  return createOrUpdateTaskWithConfigs(
+      taskId,
+      std::move(planFragment),
+      sources,
+      outputBuffers,
+      [&]() {
+        return QueryConfigStrings{
+            std::move(configStrings), std::move(connectorConfigStrings)};
+      },
+      filterConversionNanos);
+}
+
+std::unique_ptr<TaskInfo> TaskManager::createOrUpdateTaskWithConfigs(
+    const TaskId& taskId,
+    velox::core::PlanFragment planFragment,
+    const std::vector<protocol::TaskSource>& sources,
+    const protocol::OutputBuffers& outputBuffers,
+    const std::function<QueryConfigStrings()>& makeConfigs,
+    uint64_t filterConversionNanos) {
+  // Convert the splits before locking the task. Large updates are converted
+  // in parallel.
+  size_t numSplits{0};
+  for (const auto& source : sources) {
+    numSplits += source.splits.size();
+  }
+  const auto batchSize =
+      SystemConfig::instance()->taskSplitConversionBatchSize();
+  const bool parallel =
+      batchSize > 0 && numSplits > static_cast<size_t>(batchSize);
+  std::vector<std::vector<exec::Split>> veloxSplits;
+  {
+    TraceSpan splitsSpan("task.convertSplits", taskId);
+    auto conversion =
+        std::make_shared<SplitConversion>(sources, parallel ? batchSize : 0);
+    veloxSplits = conversion->run(parallel ? driverCPUExecutor() : nullptr);
+    if (parallel) {
+      numSplitConversionBatches_ += conversion->numBatches();
+    }
+  }
+
   std::shared_ptr<exec::Task> execTask;
   bool startTask = false;
   auto prestoTask = findOrCreateTask(taskId);
@@ -285,13 +628,32 @@ std::unique_ptr<TaskInfo> TaskManager::createOrUpdateTask(
       if (prestoTask->info.taskStatus.state == protocol::TaskState::ABORTED) {
         return std::make_unique<TaskInfo>(prestoTask->updateInfoLocked());
       }
+      VELOX_USER_CHECK(
+          !draining_, "Node is shutting down, refusing new task {}", taskId);
 
+      std::shared_ptr<const QuerySessionConfig> sessionConfig;
       auto queryCtx = queryContextManager_.findOrCreateQueryCtx(
-          taskId, std::move(configStrings), std::move(connectorConfigStrings));
-      maxDrivers =
-          queryCtx->get<int32_t>(kMaxDriversPerTask.data(), maxDriversPerTask_);
-      concurrentLifespans = queryCtx->get<int32_t>(
-          kConcurrentLifespansPerTask.data(), concurrentLifespansPerTask_);
+          taskId, makeConfigs, sessionConfig);
+      maxDrivers = sessionConfig->maxDriversPerTask.value_or(
+          maxDriversPerTask_.load());
+      concurrentLifespans = sessionConfig->concurrentLifespansPerTask.value_or(
+          concurrentLifespansPerTask_.load());
+      maxDrivers = maxDriversForSplits(
+          planFragment,
+          sources,
+          maxDrivers,
+          SystemConfig::instance()->taskSplitsPerDriver());
+      maxDrivers = maxDriversForWriter(
+          planFragment,
+          sources,
+          maxDrivers,
+          sessionConfig->taskWriterCount.value_or(
+              SystemConfig::instance()->taskWriterCount()),
+          SystemConfig::instance()->taskWriterTargetFileBytes());
+      if (fragmentResultCache_.maxBytes() > 0) {
+        useFragmentResultCache(
+            *prestoTask, planFragment, sources, sessionConfig->resultConfigs);
+      }
       // Zero concurrent lifespans means 'unlimited', but we still limit the
       // number to some reasonable one.
       if (concurrentLifespans == 0) {
@@ -300,10 +662,16 @@ std::unique_ptr<TaskInfo> TaskManager::createOrUpdateTask(
 
       execTask = std::make_shared<exec::Task>(
           taskId, planFragment, prestoTask->id.id(), std::move(queryCtx));
-      maybeSetupTaskSpillDirectory(planFragment, *execTask);
+      maybeSetupTaskSpillDirectory(
+          planFragment, *execTask, spillPaths_, spillQuota_);
 
       prestoTask->task = execTask;
+      countTaskStateLocked(*prestoTask, execTask->state());
       prestoTask->info.needsPlan = false;
+      prestoTask->filterConversionNanos = filterConversionNanos;
+      if (SystemConfig::instance()->taskSplitPruningEnabled()) {
+        prestoTask->splitPruner = SplitPruner::create(planFragment.planNode);
+      }
       startTask = true;
     } else {
       execTask = prestoTask->task;
@@ -325,47 +693,62 @@ std::unique_ptr<TaskInfo> TaskManager::createOrUpdateTask(
   std::lock_guard<std::mutex> l(prestoTask->mutex);
 
   if (startTask) {
-    if (execTask->isGroupedExecution()) {
-      LOG(INFO) << "Starting task " << taskId << " with " << maxDrivers
-                << " max drivers and " << concurrentLifespans
-                << " concurrent lifespans (grouped execution).";
-    } else {
-      LOG(INFO) << "Starting task " << taskId << " with " << maxDrivers
-                << " max drivers.";
+    if (admitOrQueue(prestoTask, maxDrivers, concurrentLifespans)) {
+      resultRequests =
+          startTaskLocked(prestoTask, maxDrivers, concurrentLifespans);
     }
-    exec::Task::start(execTask, maxDrivers, concurrentLifespans);
-
-    prestoTask->taskStarted = true;
-    resultRequests = std::move(prestoTask->resultRequests);
     statusRequest = prestoTask->statusRequest;
     infoRequest = prestoTask->infoRequest;
   }
 
   getDataForResultRequests(resultRequests);
 
-  if (outputBuffers.type == protocol::BufferType::BROADCAST &&
-      !execTask->updateBroadcastOutputBuffers(
-          outputBuffers.buffers.size(), outputBuffers.noMoreBufferIds)) {
-    LOG(INFO) << "Failed to update broadcast buffers for task: " << taskId;
+  if (outputBuffers.type == protocol::BufferType::BROADCAST) {
+    // The output buffers of a queued task are created when it starts.
+    if (!prestoTask->taskStarted) {
+      prestoTask->queuedOutputBuffers = outputBuffers;
+    } else if (!execTask->updateBroadcastOutputBuffers(
+                   outputBuffers.buffers.size(),
+                   outputBuffers.noMoreBufferIds)) {
+      LOG(INFO) << "Failed to update broadcast buffers for task: " << taskId;
+    }
   }
 
-  for (const auto& source : sources) {
+  TraceSpan addSplitsSpan("task.addSplits", taskId);
+  for (size_t i = 0; i < sources.size(); ++i) {
+    const auto& source = sources[i];
+    // The scans of the task served by the fragment result cache are gone.
+    if (prestoTask->usesCachedResult) {
+      continue;
+    }
     // Add all splits from the source to the task.
     LOG(INFO) << "Adding " << source.splits.size() << " splits to " << taskId
               << " for node " << source.planNodeId;
     // Keep track of the max sequence for this batch of splits.
     long maxSplitSequenceId{-1};
-    for (const auto& protocolSplit : source.splits) {
-      auto split = toVeloxSplit(protocolSplit);
+    uint64_t numPrunedSplits{0};
+    for (auto j : cacheAwareSplitOrder(veloxSplits[i])) {
+      auto& split = veloxSplits[i][j];
       if (split.hasConnectorSplit()) {
-        maxSplitSequenceId =
-            std::max(maxSplitSequenceId, protocolSplit.sequenceId);
+        const auto sequenceId = source.splits[j].sequenceId;
+        maxSplitSequenceId = std::max(maxSplitSequenceId, sequenceId);
+        if (prestoTask->splitPruner != nullptr &&
+            prestoTask->splitPruner->canSkip(source.planNodeId, split)) {
+          ++numPrunedSplits;
+          continue;
+        }
         execTask->addSplitWithSequence(
-            source.planNodeId, std::move(split), protocolSplit.sequenceId);
+            source.planNodeId, std::move(split), sequenceId);
       }
     }
     // Update task's max split sequence id after all splits have been added.
     execTask->setMaxSplitSequenceId(source.planNodeId, maxSplitSequenceId);
+    if (numPrunedSplits > 0) {
+      LOG(INFO) << "Skipped " << numPrunedSplits << " splits of " << taskId
+                << " for node " << source.planNodeId;
+      prestoTask->numPrunedSplits += numPrunedSplits;
+      REPORT_ADD_STAT_VALUE(kCounterNumPrunedSplits, numPrunedSplits);
+    }
 
     for (const auto& lifespan : source.noMoreSplitsForLifespan) {
       if (lifespan.isgroup) {
@@ -385,6 +768,7 @@ std::unique_ptr<TaskInfo> TaskManager::createOrUpdateTask(
   // 'prestoTask' will exist by virtue of shared_ptr but may for example have
   // been aborted.
   auto info = prestoTask->updateInfoLocked(); // Presto task is locked above.
+  publishTaskStateLocked(*prestoTask, info.taskStatus.state);
   if (auto promiseHolder = infoRequest.lock()) {
     promiseHolder->promise.setValue(std::make_unique<protocol::TaskInfo>(info));
   }
@@ -399,22 +783,21 @@ std::unique_ptr<TaskInfo> TaskManager::deleteTask(
     const TaskId& taskId,
     bool /*abort*/) {
   LOG(INFO) << "Deleting task " << taskId;
-  // Fast. non-blocking delete and cancel serialized on 'taskMap'.
-  auto taskMap = taskMap_.wlock();
-  auto it = taskMap->find(taskId);
-  if (it == taskMap->cend()) {
+  // Fast. non-blocking delete and cancel serialized on the task mutex.
+  std::shared_ptr<PrestoTask> prestoTask;
+  auto it = taskMap_.find(taskId);
+  if (it == taskMap_.cend()) {
     VLOG(1) << "Task not found for delete: " << taskId;
     // If task is not found than we observe DELETE message coming before CREATE.
     // In that case we create the task with ABORTED state, so we know we don't
     // need to do anything on CREATE message and can clean up the cancelled task
-    // later.
-    auto prestoTask = findOrCreateTaskLocked(*taskMap, taskId);
-    prestoTask->info.taskStatus.state = protocol::TaskState::ABORTED;
-    return std::make_unique<TaskInfo>(prestoTask->info);
+    // later. A concurrent CREATE may win the insertion, in which case the task
+    // is aborted below.
+    prestoTask = findOrCreateTask(taskId);
+  } else {
+    prestoTask = it->second;
   }
 
-  auto prestoTask = it->second;
-
   std::lock_guard<std::mutex> l(prestoTask->mutex);
   prestoTask->updateHeartbeatLocked();
   auto execTask = prestoTask->task;
@@ -434,6 +817,7 @@ std::unique_ptr<TaskInfo> TaskManager::deleteTask(
   if (prestoTask->info.taskStatus.state == protocol::TaskState::RUNNING) {
     prestoTask->info.taskStatus.state = protocol::TaskState::ABORTED;
   }
+  publishTaskStateLocked(*prestoTask, prestoTask->info.taskStatus.state);
 
   return std::make_unique<TaskInfo>(prestoTask->info);
 }
@@ -513,32 +897,50 @@ struct ZombieTaskCounts {
 size_t TaskManager::cleanOldTasks() {
   const auto startTimeMs = getCurrentTimeMs();
 
-  // We copy task map locally to avoid locking task map for a potentially long
-  // time. We also lock for 'read'.
-  TaskMap taskMap;
+  // Only the tasks whose expiry is due are visited.
+  folly::F14FastSet<protocol::TaskId> dueTaskIds;
+  {
+    auto expiries = taskExpiries_.wlock();
+    while (!expiries->empty() && expiries->top().first <= startTimeMs) {
+      dueTaskIds.emplace(expiries->top().second);
+      expiries->pop();
+    }
+  }
+
   folly::F14FastSet<protocol::TaskId> taskIdsToClean;
-  { taskMap = *(taskMap_.rlock()); }
+  std::vector<std::pair<protocol::TaskId, uint64_t>> rescheduled;
 
   ZombieTaskCounts zombieTaskCounts;
   ZombieTaskCounts zombiePrestoTaskCounts;
-  for (auto it = taskMap.begin(); it != taskMap.end(); ++it) {
-    bool eraseTask{false};
+  for (const auto& taskId : dueTaskIds) {
+    auto it = taskMap_.find(taskId);
+    if (it == taskMap_.cend()) {
+      // Already cleaned by an earlier entry.
+      continue;
+    }
+    const uint64_t oldTaskMs = FLAGS_old_task_ms;
+    uint64_t ageMs{0};
     if (it->second->task != nullptr) {
-      if (it->second->task->state() != exec::TaskState::kRunning) {
-        if (it->second->task->timeSinceEndMs() >= FLAGS_old_task_ms) {
-          // Not running and old.
-          eraseTask = true;
-        }
+      const auto state = it->second->task->state();
+      if (state == exec::TaskState::kRunning) {
+        // Rescheduled when it stops running. Checking again later in case
+        // the state change is missed.
+        rescheduled.emplace_back(taskId, oldTaskMs);
+        continue;
+      }
+      {
+        // Counts the state changes of the tasks that never started, which
+        // are not watched.
+        std::lock_guard<std::mutex> l(it->second->mutex);
+        countTaskStateLocked(*it->second, state);
       }
+      ageMs = it->second->task->timeSinceEndMs();
     } else {
       // Use heartbeat to determine the task's age.
-      if (it->second->timeSinceLastHeartbeatMs() >= FLAGS_old_task_ms) {
-        eraseTask = true;
-      }
+      ageMs = it->second->timeSinceLastHeartbeatMs();
     }
-
-    // We assume 'not erase' is the 'most common' case.
-    if (not eraseTask) {
+    if (ageMs < oldTaskMs) {
+      rescheduled.emplace_back(taskId, oldTaskMs - ageMs);
       continue;
     }
 
@@ -547,11 +949,9 @@ size_t TaskManager::cleanOldTasks() {
 
     // Do not remove 'zombie' tasks (with outstanding references) from the map.
     // We use it to track the number of tasks.
-    // Note, since we copied the task map, presto tasks should have an extra
-    // reference (2 from two maps).
-    if (prestoTaskRefCount > 2 || taskRefCount > 1) {
+    if (prestoTaskRefCount > 1 || taskRefCount > 1) {
       auto& task = it->second->task;
-      if (prestoTaskRefCount > 2) {
+      if (prestoTaskRefCount > 1) {
         ++zombiePrestoTaskCounts.numTotal;
         if (task != nullptr) {
           zombiePrestoTaskCounts.updateCounts(task);
@@ -561,19 +961,26 @@ size_t TaskManager::cleanOldTasks() {
         ++zombieTaskCounts.numTotal;
         zombieTaskCounts.updateCounts(task);
       }
+      // Counted again by the next cleanup.
+      rescheduled.emplace_back(taskId, 0);
     } else {
       taskIdsToClean.emplace(it->first);
     }
   }
+  for (const auto& [taskId, delayMs] : rescheduled) {
+    scheduleTaskExpiry(taskId, delayMs);
+  }
 
   const auto elapsedMs = (getCurrentTimeMs() - startTimeMs);
   if (not taskIdsToClean.empty()) {
-    {
-      // Remove tasks from the task map. We briefly lock for write here.
-      auto writableTaskMap = taskMap_.wlock();
-      for (const auto& taskId : taskIdsToClean) {
-        writableTaskMap->erase(taskId);
+    for (const auto& taskId : taskIdsToClean) {
+      auto it = taskMap_.find(taskId);
+      if (it != taskMap_.cend()) {
+        std::lock_guard<std::mutex> l(it->second->mutex);
+        countTaskStateLocked(*it->second, -1);
       }
+      taskMap_.erase(taskId);
+      outputBufferSpiller_->removeTask(taskId);
     }
     LOG(INFO) << "cleanOldTasks: Cleaned " << taskIdsToClean.size()
               << " old task(s) in " << elapsedMs << "ms";
@@ -625,8 +1032,11 @@ folly::Future<std::unique_ptr<protocol::TaskInfo>> TaskManager::getTaskInfo(
       keepPromiseAlive(promiseHolder, state);
       prestoTask->infoRequest = folly::to_weak_ptr(promiseHolder);
 
-      return std::move(future).via(eventBase).onTimeout(
-          std::chrono::microseconds(maxWaitMicros), [prestoTask]() {
+      return withLongPollTimeout<std::unique_ptr<protocol::TaskInfo>>(
+          std::move(future),
+          eventBase,
+          std::chrono::microseconds(maxWaitMicros),
+          [prestoTask]() {
             return std::make_unique<protocol::TaskInfo>(
                 prestoTask->updateInfo());
           });
@@ -643,8 +1053,11 @@ folly::Future<std::unique_ptr<protocol::TaskInfo>> TaskManager::getTaskInfo(
       std::make_shared<PromiseHolder<std::unique_ptr<protocol::TaskInfo>>>(
           std::move(promise));
 
-  prestoTask->task->stateChangeFuture(maxWaitMicros)
-      .via(eventBase)
+  withLongPollTimeout<folly::Unit>(
+      prestoTask->task->stateChangeFuture(0).via(eventBase),
+      eventBase,
+      std::chrono::microseconds(maxWaitMicros),
+      []() { return folly::unit; })
       .thenValue([promiseHolder, prestoTask](auto&& /*done*/) {
         promiseHolder->promise.setValue(
             std::make_unique<protocol::TaskInfo>(prestoTask->updateInfo()));
@@ -652,7 +1065,7 @@ folly::Future<std::unique_ptr<protocol::TaskInfo>> TaskManager::getTaskInfo(
       .thenError(
           folly::tag_t<std::exception>{},
           [promiseHolder, prestoTask](const std::exception& /*e*/) {
-            // We come here in the case of maxWait elapsed.
+            // We come here if the task is gone before its state changed.
             promiseHolder->promise.setValue(
                 std::make_unique<protocol::TaskInfo>(prestoTask->updateInfo()));
           });
@@ -665,7 +1078,8 @@ folly::Future<std::unique_ptr<Result>> TaskManager::getResults(
     long token,
     protocol::DataSize maxSize,
     protocol::Duration maxWait,
-    std::shared_ptr<http::CallbackRequestHandlerState> state) {
+    std::shared_ptr<http::CallbackRequestHandlerState> state,
+    bool acceptLargerResults) {
   uint64_t maxWaitMicros =
       std::max(1.0, maxWait.getValue(protocol::TimeUnit::MICROSECONDS));
   VLOG(1) << "TaskManager::getResults " << taskId << ", " << bufferId << ", "
@@ -720,18 +1134,64 @@ folly::Future<std::unique_ptr<Result>> TaskManager::getResults(
       }
     }
 
+    // A consumer accepting larger responses pulls the results of the root
+    // stage in larger responses while they fill up, see
+    // nextResultMaxBytes().
+    const uint64_t requestedBytes = maxSize.getValue(protocol::DataUnit::BYTE);
+    const bool adaptive = acceptLargerResults &&
+        prestoTask->id.stageId() == 0 &&
+        rootStageMaxResultBytes_ > requestedBytes;
+    uint64_t resultBytes = requestedBytes;
+    if (adaptive) {
+      resultBytes = std::clamp<uint64_t>(
+          prestoTask->resultMaxBytes, requestedBytes, rootStageMaxResultBytes_);
+      maxSize = protocol::DataSize(resultBytes, protocol::DataUnit::BYTE);
+    }
+    const auto withResultSizing =
+        [&](folly::Future<std::unique_ptr<Result>> results) {
+          if (!adaptive) {
+            return results;
+          }
+          return std::move(results).thenValue(
+              [prestoTask,
+               requestedBytes,
+               resultBytes,
+               maxBytes = rootStageMaxResultBytes_](
+                  std::unique_ptr<Result> result) {
+                const uint64_t bytes = result->data != nullptr
+                    ? result->data->computeChainDataLength()
+                    : 0;
+                prestoTask->resultMaxBytes = nextResultMaxBytes(
+                    requestedBytes,
+                    resultBytes,
+                    maxBytes,
+                    bytes,
+                    result->complete);
+                return result;
+              });
+        };
+
     for (;;) {
       if (prestoTask->taskStarted) {
         // If task is not running let the request timeout. The task may have
         // failed at creation time and the coordinator hasn't yet caught up.
         if (prestoTask->task->state() == exec::kRunning) {
           getData(
-              promiseHolder, taskId, bufferId, token, maxSize, *bufferManager_);
+              promiseHolder,
+              taskId,
+              bufferId,
+              token,
+              maxSize,
+              *outputBufferSpiller_,
+              checksumPages_);
         }
-        return std::move(future).via(eventBase).onTimeout(
-            std::chrono::microseconds(maxWaitMicros), timeoutFn);
+        return withResultSizing(withLongPollTimeout<std::unique_ptr<Result>>(
+            std::move(future),
+            eventBase,
+            std::chrono::microseconds(maxWaitMicros),
+            timeoutFn));
       }
-      std::lock_guard<std::mutex> l(prestoTask->mutex);
+      std::lock_guard<std::mutex> l(prestoTask->resultRequestsMutex);
       if (prestoTask->taskStarted) {
         continue;
       }
@@ -748,8 +1208,11 @@ folly::Future<std::unique_ptr<Result>> TaskManager::getResults(
       request->token = token;
       request->maxSize = maxSize;
       prestoTask->resultRequests.insert({bufferId, std::move(request)});
-      return std::move(future).via(eventBase).onTimeout(
-          std::chrono::microseconds(maxWaitMicros), timeoutFn);
+      return withResultSizing(withLongPollTimeout<std::unique_ptr<Result>>(
+          std::move(future),
+          eventBase,
+          std::chrono::microseconds(maxWaitMicros),
+          timeoutFn));
     }
   } catch (const velox::VeloxException& e) {
     promiseHolder->promise.setException(e);
@@ -760,6 +1223,91 @@ folly::Future<std::unique_ptr<Result>> TaskManager::getResults(
   }
 }
 
+void TaskManager::startPushResults(
+    const TaskId& taskId,
+    long bufferId,
+    const PushRegistration& registration) {
+  VLOG(1) << "TaskManager::startPushResults " << taskId << ", " << bufferId
+          << " to " << registration.uri;
+  auto pusher = std::make_shared<OutputBufferPusher>(
+      bufferManager_, taskId, bufferId, registration);
+  VELOX_USER_CHECK(
+      pusher->start(),
+      "Output buffer not found for pushing results: {}, buffer {}",
+      taskId,
+      bufferId);
+}
+
+folly::Future<std::vector<folly::Try<std::unique_ptr<Result>>>>
+TaskManager::getBatchResults(
+    const std::vector<ResultLocation>& locations,
+    protocol::DataSize maxSize,
+    protocol::Duration maxWait,
+    std::shared_ptr<http::CallbackRequestHandlerState> state) {
+  using BatchResults = std::vector<folly::Try<std::unique_ptr<Result>>>;
+  VELOX_USER_CHECK(
+      !locations.empty(), "Batched results request has no locations");
+
+  struct BatchState {
+    std::mutex mutex;
+    std::vector<long> tokens;
+    BatchResults results;
+    size_t numPending;
+    bool fulfilled{false};
+    folly::Promise<BatchResults> promise;
+  };
+  auto batchState = std::make_shared<BatchState>();
+  for (const auto& location : locations) {
+    batchState->tokens.push_back(location.token);
+  }
+  batchState->results.resize(locations.size());
+  batchState->numPending = locations.size();
+  auto future = batchState->promise.getFuture();
+
+  const protocol::DataSize locationMaxSize(
+      std::max(
+          1.0, maxSize.getValue(protocol::DataUnit::BYTE) / locations.size()),
+      protocol::DataUnit::BYTE);
+  for (size_t i = 0; i < locations.size(); ++i) {
+    const auto& location = locations[i];
+    getResults(
+        location.taskId,
+        location.bufferId,
+        location.token,
+        locationMaxSize,
+        maxWait,
+        state)
+        .thenTry([batchState, i](folly::Try<std::unique_ptr<Result>>&& result) {
+          std::lock_guard<std::mutex> l(batchState->mutex);
+          --batchState->numPending;
+          if (batchState->fulfilled) {
+            // The batch has already been responded. The pages of this result
+            // are not acknowledged and hence stay in the output buffer for the
+            // next request.
+            return;
+          }
+          const bool ready = result.hasException() ||
+              result.value()->complete ||
+              (result.value()->data != nullptr &&
+               !result.value()->data->empty());
+          batchState->results[i] = std::move(result);
+          if (!ready && batchState->numPending > 0) {
+            return;
+          }
+          batchState->fulfilled = true;
+          for (size_t j = 0; j < batchState->results.size(); ++j) {
+            auto& pending = batchState->results[j];
+            if (!pending.hasValue() && !pending.hasException()) {
+              pending = folly::Try<std::unique_ptr<Result>>(
+                  createTimeOutResult(batchState->tokens[j]));
+            }
+          }
+          batchState->promise.setValue(std::move(batchState->results));
+        });
+  }
+  return future;
+}
+
 folly::Future<std::unique_ptr<protocol::TaskStatus>> TaskManager::getTaskStatus(
     const TaskId& taskId,
     std::optional<protocol::TaskState> currentState,
@@ -789,8 +1337,11 @@ folly::Future<std::unique_ptr<protocol::TaskStatus>> TaskManager::getTaskStatus(
 
       keepPromiseAlive(promiseHolder, state);
       prestoTask->statusRequest = folly::to_weak_ptr(promiseHolder);
-      return std::move(future).via(eventBase).onTimeout(
-          std::chrono::microseconds(maxWaitMicros), [prestoTask]() {
+      return withLongPollTimeout<std::unique_ptr<protocol::TaskStatus>>(
+          std::move(future),
+          eventBase,
+          std::chrono::microseconds(maxWaitMicros),
+          [prestoTask]() {
             return std::make_unique<protocol::TaskStatus>(
                 prestoTask->updateStatus());
           });
@@ -808,8 +1359,11 @@ folly::Future<std::unique_ptr<protocol::TaskStatus>> TaskManager::getTaskStatus(
       std::make_shared<PromiseHolder<std::unique_ptr<protocol::TaskStatus>>>(
           std::move(promise));
 
-  prestoTask->task->stateChangeFuture(maxWaitMicros)
-      .via(eventBase)
+  withLongPollTimeout<folly::Unit>(
+      prestoTask->task->stateChangeFuture(0).via(eventBase),
+      eventBase,
+      std::chrono::microseconds(maxWaitMicros),
+      []() { return folly::unit; })
       .thenValue([promiseHolder, prestoTask](auto&& /*done*/) {
         promiseHolder->promise.setValue(
             std::make_unique<protocol::TaskStatus>(prestoTask->updateStatus()));
@@ -817,7 +1371,7 @@ folly::Future<std::unique_ptr<protocol::TaskStatus>> TaskManager::getTaskStatus(
       .thenError(
           folly::tag_t<std::exception>{},
           [promiseHolder, prestoTask](std::exception const& /*e*/) {
-            // We come here in the case of maxWait elapsed.
+            // We come here if the task is gone before its state changed.
             promiseHolder->promise.setValue(
                 std::make_unique<protocol::TaskStatus>(
                     prestoTask->updateStatus()));
@@ -825,28 +1379,277 @@ folly::Future<std::unique_ptr<protocol::TaskStatus>> TaskManager::getTaskStatus(
   return std::move(future).via(eventBase);
 }
 
+uint64_t TaskManager::subscribeTaskStates(
+    const std::string& queryId,
+    TaskStateListener listener) {
+  const auto id = nextSubscriptionId_++;
+  (*taskStateListeners_.wlock())[queryId][id] = listener;
+  for (const auto& [taskId, prestoTask] : taskMap_) {
+    if (prestoTask->id.queryId() != queryId) {
+      continue;
+    }
+    std::lock_guard<std::mutex> l(prestoTask->mutex);
+    listener(taskId, prestoTask->updateStatusLocked().state);
+  }
+  return id;
+}
+
+void TaskManager::unsubscribeTaskStates(
+    const std::string& queryId,
+    uint64_t id) {
+  auto listeners = taskStateListeners_.wlock();
+  auto it = listeners->find(queryId);
+  if (it == listeners->end()) {
+    return;
+  }
+  it->second.erase(id);
+  if (it->second.empty()) {
+    listeners->erase(it);
+  }
+}
+
+void TaskManager::publishTaskStateLocked(
+    PrestoTask& prestoTask,
+    protocol::TaskState state) {
+  if (prestoTask.publishedState == state) {
+    return;
+  }
+  prestoTask.publishedState = state;
+  const auto& taskId = prestoTask.info.taskId;
+  auto listeners = taskStateListeners_.rlock();
+  auto it = listeners->find(prestoTask.id.queryId());
+  if (it == listeners->end()) {
+    return;
+  }
+  for (const auto& [id, listener] : it->second) {
+    listener(taskId, state);
+  }
+}
+
+bool TaskManager::admitOrQueue(
+    const std::shared_ptr<PrestoTask>& prestoTask,
+    uint32_t maxDrivers,
+    uint32_t concurrentLifespans) {
+  if (!admissionController_.enabled()) {
+    return true;
+  }
+  std::lock_guard<std::mutex> l(admissionQueueMutex_);
+  // The queued tasks start first.
+  if (admissionQueue_.empty() && admissionController_.tryAdmit(maxDrivers)) {
+    return true;
+  }
+  LOG(INFO) << "Queueing task " << prestoTask->info.taskId
+            << " until the load of the node admits it";
+  prestoTask->admissionQueuedMs = velox::getCurrentTimeMs();
+  admissionQueue_.push_back({prestoTask, maxDrivers, concurrentLifespans});
+  return false;
+}
+
+std::unordered_map<int64_t, std::shared_ptr<ResultRequest>>
+TaskManager::startTaskLocked(
+    const std::shared_ptr<PrestoTask>& prestoTask,
+    uint32_t maxDrivers,
+    uint32_t concurrentLifespans) {
+  const auto& taskId = prestoTask->info.taskId;
+  auto execTask = prestoTask->task;
+  if (execTask->isGroupedExecution()) {
+    LOG(INFO) << "Starting task " << taskId << " with " << maxDrivers
+              << " max drivers and " << concurrentLifespans
+              << " concurrent lifespans (grouped execution).";
+  } else {
+    LOG(INFO) << "Starting task " << taskId << " with " << maxDrivers
+              << " max drivers.";
+  }
+  exec::Task::start(execTask, maxDrivers, concurrentLifespans);
+  watchTaskState(prestoTask);
+  if (prestoTask->admissionQueuedMs > 0) {
+    prestoTask->admissionWaitNanos =
+        (velox::getCurrentTimeMs() - prestoTask->admissionQueuedMs) *
+        1'000'000;
+  }
+  if (auto& outputBuffers = prestoTask->queuedOutputBuffers) {
+    if (!execTask->updateBroadcastOutputBuffers(
+            outputBuffers->buffers.size(), outputBuffers->noMoreBufferIds)) {
+      LOG(INFO) << "Failed to update broadcast buffers for task: " << taskId;
+    }
+    outputBuffers.reset();
+  }
+
+  std::lock_guard<std::mutex> resultRequestsLock(
+      prestoTask->resultRequestsMutex);
+  prestoTask->taskStarted = true;
+  return std::move(prestoTask->resultRequests);
+}
+
+size_t TaskManager::updateAdmissionLoad(
+    const TaskAdmissionController::Load& load) {
+  admissionController_.update(load);
+  size_t numStarted = 0;
+  for (;;) {
+    QueuedTask queuedTask;
+    {
+      std::lock_guard<std::mutex> l(admissionQueueMutex_);
+      if (admissionQueue_.empty() ||
+          !admissionController_.tryAdmit(admissionQueue_.front().maxDrivers)) {
+        break;
+      }
+      queuedTask = std::move(admissionQueue_.front());
+      admissionQueue_.pop_front();
+    }
+    auto prestoTask = queuedTask.prestoTask.lock();
+    if (prestoTask == nullptr) {
+      continue;
+    }
+    std::unordered_map<int64_t, std::shared_ptr<ResultRequest>> resultRequests;
+    {
+      std::lock_guard<std::mutex> l(prestoTask->mutex);
+      // Aborted while queued.
+      if (prestoTask->task->state() != exec::kRunning) {
+        continue;
+      }
+      resultRequests = startTaskLocked(
+          prestoTask, queuedTask.maxDrivers, queuedTask.concurrentLifespans);
+      publishTaskStateLocked(
+          *prestoTask, prestoTask->updateStatusLocked().state);
+    }
+    getDataForResultRequests(resultRequests);
+    ++numStarted;
+  }
+  return numStarted;
+}
+
+void TaskManager::useFragmentResultCache(
+    PrestoTask& prestoTask,
+    core::PlanFragment& planFragment,
+    const std::vector<protocol::TaskSource>& sources,
+    const std::string& resultConfigs) {
+  auto key = FragmentResultCache::makeKey(planFragment, sources, resultConfigs);
+  if (!key.has_value()) {
+    return;
+  }
+  if (auto pages = fragmentResultCache_.get(*key)) {
+    LOG(INFO) << "Serving " << pages->pages.size() << " cached pages to "
+              << prestoTask.info.taskId;
+    planFragment =
+        FragmentResultCache::withCachedResult(planFragment, std::move(pages));
+    prestoTask.usesCachedResult = true;
+    return;
+  }
+  prestoTask.fragmentResultRecorder =
+      std::make_shared<operators::FragmentResultRecorder>(
+          fragmentResultCache_.maxBytes());
+  prestoTask.fragmentResultKey = std::move(*key);
+  planFragment = FragmentResultCache::withResultRecorder(
+      planFragment, prestoTask.fragmentResultRecorder);
+}
+
+void TaskManager::watchTaskState(
+    const std::shared_ptr<PrestoTask>& prestoTask) {
+  // No timeout, the future completes on the first state change.
+  prestoTask->task->stateChangeFuture(0)
+      .via(driverCPUExecutor())
+      .thenValue([this, prestoTask](auto&& /*done*/) {
+        scheduleTaskExpiry(prestoTask->info.taskId, FLAGS_old_task_ms);
+        recordTableCacheStats(*prestoTask->task, tableCacheStats_);
+        recordQueryResources(*prestoTask->task, queryResources_);
+        if (prestoTask->fragmentResultRecorder != nullptr &&
+            prestoTask->task->state() == exec::kFinished) {
+          if (auto pages = prestoTask->fragmentResultRecorder->finish()) {
+            fragmentResultCache_.put(prestoTask->fragmentResultKey, pages);
+          }
+        }
+        std::lock_guard<std::mutex> l(prestoTask->mutex);
+        countTaskStateLocked(*prestoTask, prestoTask->task->state());
+        publishTaskStateLocked(
+            *prestoTask, prestoTask->updateStatusLocked().state);
+      })
+      .thenError(folly::tag_t<std::exception>{}, [](const std::exception& e) {
+        // The task is destroyed while running, nothing left to publish.
+        VLOG(1) << "Stopped watching task state: " << e.what();
+      });
+}
+
+void TaskManager::scheduleTaskExpiry(
+    const protocol::TaskId& taskId,
+    uint64_t delayMs) {
+  taskExpiries_.wlock()->emplace(getCurrentTimeMs() + delayMs, taskId);
+}
+
+VersionedJson::Update TaskManager::getVersionedUpdate(
+    const TaskId& taskId,
+    bool info,
+    json document,
+    uint64_t knownVersion) {
+  auto it = taskMap_.find(taskId);
+  if (it == taskMap_.cend()) {
+    return {0, false, false, std::move(document)};
+  }
+  auto& versions =
+      info ? it->second->infoVersions : it->second->statusVersions;
+  return versions.update(std::move(document), knownVersion);
+}
+
+json TaskManager::getOperatorStats(const TaskId& taskId) const {
+  json result;
+  result["taskId"] = taskId;
+  result["operators"] = json::array();
+  auto it = taskMap_.find(taskId);
+  // 'task' is set before 'taskStarted' and never reset, so it may be read
+  // without the mutex once the task is started.
+  if (it == taskMap_.cend() || !it->second->taskStarted) {
+    return result;
+  }
+  const auto taskStats = it->second->task->taskStats();
+  for (const auto& pipelineStats : taskStats.pipelineStats) {
+    for (const auto& stats : pipelineStats.operatorStats) {
+      json op;
+      op["pipelineId"] = stats.pipelineId;
+      op["operatorId"] = stats.operatorId;
+      op["planNodeId"] = stats.planNodeId;
+      op["operatorType"] = stats.operatorType;
+      op["numDrivers"] = stats.numDrivers;
+      op["inputPositions"] = stats.inputPositions;
+      op["outputPositions"] = stats.outputPositions;
+      op["cpuNanos"] = stats.addInputTiming.cpuNanos +
+          stats.getOutputTiming.cpuNanos + stats.finishTiming.cpuNanos;
+      op["blockedWallNanos"] = stats.blockedWallNanos;
+      // Set once a partial aggregation passes its input through.
+      if (stats.runtimeStats.count("abandonedPartialAggregation")) {
+        op["abandonedPartialAggregation"] = true;
+      }
+      result["operators"].push_back(std::move(op));
+    }
+  }
+  return result;
+}
+
 void TaskManager::removeRemoteSource(
     const TaskId& taskId,
     const TaskId& remoteSourceTaskId) {}
 
 std::shared_ptr<PrestoTask> TaskManager::findOrCreateTask(
     const TaskId& taskId) {
-  auto taskMap = taskMap_.wlock();
-  return findOrCreateTaskLocked(*taskMap, taskId);
-}
-
-std::shared_ptr<PrestoTask> TaskManager::findOrCreateTaskLocked(
-    TaskMap& taskMap,
-    const TaskId& taskId) {
-  auto it = taskMap.find(taskId);
-  if (it != taskMap.end()) {
-    auto prestoTask = it->second;
-    std::lock_guard<std::mutex> l(prestoTask->mutex);
-    prestoTask->updateHeartbeatLocked();
-    ++prestoTask->info.taskStatus.version;
-    return prestoTask;
+  std::shared_ptr<PrestoTask> prestoTask;
+  auto it = taskMap_.find(taskId);
+  if (it != taskMap_.cend()) {
+    prestoTask = it->second;
+  } else {
+    auto [insertedIt, inserted] =
+        taskMap_.try_emplace(taskId, createTask(taskId));
+    if (inserted) {
+      scheduleTaskExpiry(taskId, FLAGS_old_task_ms);
+      return insertedIt->second;
+    }
+    // Lost the race to a concurrent creation of the same task.
+    prestoTask = insertedIt->second;
   }
+  std::lock_guard<std::mutex> l(prestoTask->mutex);
+  prestoTask->updateHeartbeatLocked();
+  ++prestoTask->info.taskStatus.version;
+  return prestoTask;
+}
 
+std::shared_ptr<PrestoTask> TaskManager::createTask(const TaskId& taskId) {
   auto prestoTask = std::make_shared<PrestoTask>(taskId, nodeId_);
   prestoTask->info.stats.createTime =
       util::toISOTimestamp(velox::getCurrentTimeMs());
@@ -876,15 +1679,159 @@ std::shared_ptr<PrestoTask> TaskManager::findOrCreateTaskLocked(
   prestoTask->info.taskStatus.outputBufferUtilization = 1;
   prestoTask->updateHeartbeatLocked();
   ++prestoTask->info.taskStatus.version;
-
-  taskMap[taskId] = prestoTask;
   return prestoTask;
 }
 
+// static
+uint64_t TaskManager::nextResultMaxBytes(
+    uint64_t requestedBytes,
+    uint64_t resultBytes,
+    uint64_t maxBytes,
+    uint64_t bytes,
+    bool complete) {
+  if (complete || bytes < resultBytes / 4) {
+    return requestedBytes;
+  }
+  if (bytes >= resultBytes / 2) {
+    return std::min(resultBytes * 2, maxBytes);
+  }
+  return resultBytes;
+}
+
+// static
+uint32_t TaskManager::maxDriversForSplits(
+    const core::PlanFragment& planFragment,
+    const std::vector<protocol::TaskSource>& sources,
+    uint32_t maxDrivers,
+    uint32_t splitsPerDriver) {
+  if (splitsPerDriver == 0 || !planFragment.planNode ||
+      planFragment.executionStrategy == core::ExecutionStrategy::kGrouped) {
+    return maxDrivers;
+  }
+  if (!getsAllScanSplits(planFragment, sources)) {
+    return maxDrivers;
+  }
+  size_t numSplits = 0;
+  for (const auto& source : sources) {
+    numSplits += source.splits.size();
+  }
+  const auto drivers = std::max<size_t>(
+      1, (numSplits + splitsPerDriver - 1) / splitsPerDriver);
+  return std::min<size_t>(maxDrivers, drivers);
+}
+
+// static
+uint32_t TaskManager::maxDriversForWriter(
+    const core::PlanFragment& planFragment,
+    const std::vector<protocol::TaskSource>& sources,
+    uint32_t maxDrivers,
+    uint32_t writerCount,
+    uint64_t targetFileBytes) {
+  if (!planFragment.planNode || !hasTableWrite(planFragment.planNode)) {
+    return maxDrivers;
+  }
+  if (writerCount > 0) {
+    maxDrivers = std::min(maxDrivers, writerCount);
+  }
+  if (targetFileBytes == 0 ||
+      planFragment.executionStrategy == core::ExecutionStrategy::kGrouped ||
+      !getsAllScanSplits(planFragment, sources)) {
+    return maxDrivers;
+  }
+  uint64_t inputBytes = 0;
+  for (const auto& source : sources) {
+    for (const auto& split : source.splits) {
+      auto hiveSplit = std::dynamic_pointer_cast<const protocol::HiveSplit>(
+          split.split.connectorSplit);
+      if (!hiveSplit) {
+        return maxDrivers;
+      }
+      inputBytes += hiveSplit->fileSplit.length;
+    }
+  }
+  const auto drivers = std::max<uint64_t>(
+      1, (inputBytes + targetFileBytes - 1) / targetFileBytes);
+  return std::min<uint64_t>(maxDrivers, drivers);
+}
+
+size_t TaskManager::enforceSpillQuota() {
+  std::unordered_map<std::string, uint64_t> queryBytes;
+  std::vector<std::shared_ptr<exec::Task>> spillingTasks;
+  for (const auto& [taskId, prestoTask] : taskMap_) {
+    std::shared_ptr<exec::Task> task;
+    {
+      std::lock_guard<std::mutex> l(prestoTask->mutex);
+      task = prestoTask->task;
+    }
+    // The spill files of a task are deleted when it finishes.
+    if (!task || !task->isRunning() || task->spillDirectory().empty()) {
+      continue;
+    }
+    uint64_t spilledBytes = 0;
+    for (const auto& pipelineStats : task->taskStats().pipelineStats) {
+      for (const auto& operatorStats : pipelineStats.operatorStats) {
+        spilledBytes += operatorStats.spilledBytes;
+      }
+    }
+    queryBytes[task->queryCtx()->queryId()] += spilledBytes;
+    spillingTasks.push_back(std::move(task));
+  }
+
+  const auto toFail = spillQuota_.update(std::move(queryBytes));
+  if (toFail.empty()) {
+    return 0;
+  }
+  const folly::F14FastSet<std::string> failedQueries(
+      toFail.begin(), toFail.end());
+  size_t numFailed = 0;
+  for (const auto& task : spillingTasks) {
+    const auto& queryId = task->queryCtx()->queryId();
+    if (failedQueries.count(queryId) == 0) {
+      continue;
+    }
+    const auto message = fmt::format(
+        "Query {} exceeded the spill limit: spilled {} bytes on this node",
+        queryId,
+        spillQuota_.queryBytes(queryId));
+    LOG(WARNING) << message << ", failing task " << task->taskId();
+    task->setError(message);
+    ++numFailed;
+  }
+  return numFailed;
+}
+
+size_t TaskManager::failQueryTasks(
+    const std::string& queryId,
+    const std::string& message) {
+  size_t numFailed = 0;
+  for (const auto& [taskId, prestoTask] : taskMap_) {
+    std::shared_ptr<exec::Task> task;
+    {
+      std::lock_guard<std::mutex> l(prestoTask->mutex);
+      task = prestoTask->task;
+    }
+    if (!task || !task->isRunning() ||
+        task->queryCtx()->queryId() != queryId) {
+      continue;
+    }
+    LOG(WARNING) << message << ", failing task " << taskId;
+    task->setError(message);
+    ++numFailed;
+  }
+  return numFailed;
+}
+
+TaskMap TaskManager::tasks() const {
+  TaskMap tasks;
+  for (const auto& pair : taskMap_) {
+    tasks.emplace(pair.first, pair.second);
+  }
+  return tasks;
+}
+
 std::string TaskManager::toString() const {
   std::stringstream out;
-  auto taskMap = taskMap_.rlock();
-  for (const auto& pair : *taskMap) {
+  for (const auto& pair : taskMap_) {
     if (pair.second->task) {
       out << pair.second->task->toString() << std::endl;
     } else {
@@ -897,9 +1844,8 @@ std::string TaskManager::toString() const {
 }
 
 DriverCountStats TaskManager::getDriverCountStats() const {
-  auto taskMap = taskMap_.rlock();
   DriverCountStats driverCountStats;
-  for (const auto& pair : *taskMap) {
+  for (const auto& pair : taskMap_) {
     if (pair.second->task != nullptr) {
       driverCountStats.numRunningDrivers +=
           pair.second->task->numRunningDrivers();
@@ -910,17 +1856,103 @@ DriverCountStats TaskManager::getDriverCountStats() const {
   return driverCountStats;
 }
 
+std::vector<size_t> TaskManager::cacheAwareSplitOrder(
+    const std::vector<exec::Split>& splits) {
+  std::vector<size_t> order(splits.size());
+  std::iota(order.begin(), order.end(), 0);
+  if (maxRecentFiles_ == 0) {
+    return order;
+  }
+
+  std::vector<const std::string*> filePaths(splits.size(), nullptr);
+  for (size_t i = 0; i < splits.size(); ++i) {
+    if (auto hiveSplit =
+            std::dynamic_pointer_cast<connector::hive::HiveConnectorSplit>(
+                splits[i].connectorSplit)) {
+      filePaths[i] = &hiveSplit->filePath;
+    }
+  }
+
+  std::vector<bool> cached(splits.size(), false);
+  {
+    auto files = recentFiles_.wlock();
+    for (size_t i = 0; i < splits.size(); ++i) {
+      cached[i] = filePaths[i] != nullptr && files->exists(*filePaths[i]);
+    }
+    // Remember the files after the lookups so that the splits of the same
+    // file in this update don't count as cached.
+    for (const auto* filePath : filePaths) {
+      if (filePath != nullptr) {
+        files->set(*filePath, true);
+      }
+    }
+  }
+  std::stable_partition(
+      order.begin(), order.end(), [&](size_t i) { return cached[i]; });
+  return order;
+}
+
+std::unordered_map<std::string, size_t> TaskManager::getBlockedDriverCounts()
+    const {
+  std::unordered_map<exec::BlockingReason, int64_t> numBlockedDrivers;
+  for (const auto& [taskId, prestoTask] : taskMap_) {
+    std::lock_guard<std::mutex> l(prestoTask->mutex);
+    if (prestoTask->task == nullptr || !prestoTask->task->isRunning()) {
+      continue;
+    }
+    for (const auto& [reason, numDrivers] : prestoTask->numBlockedDrivers) {
+      numBlockedDrivers[reason] += numDrivers;
+    }
+  }
+  std::unordered_map<std::string, size_t> counts;
+  for (const auto& [reason, numDrivers] : numBlockedDrivers) {
+    // kWaitForExchange becomes waitForExchange.
+    auto name = exec::blockingReasonToString(reason);
+    if (name.size() > 1 && name[0] == 'k') {
+      name = std::string(1, std::tolower(name[1])) + name.substr(2);
+    }
+    counts[name] = numDrivers;
+  }
+  return counts;
+}
+
+size_t TaskManager::numUnreportedFinishedTasks() const {
+  size_t numTasks{0};
+  for (const auto& [taskId, prestoTask] : taskMap_) {
+    std::lock_guard<std::mutex> l(prestoTask->mutex);
+    if (prestoTask->task != nullptr &&
+        prestoTask->task->state() != exec::kRunning &&
+        prestoTask->timeSinceLastHeartbeatMs() >=
+            prestoTask->task->timeSinceEndMs()) {
+      ++numTasks;
+    }
+  }
+  return numTasks;
+}
+
 std::array<size_t, 5> TaskManager::getTaskNumbers(size_t& numTasks) const {
   std::array<size_t, 5> res{0};
-  auto taskMap = taskMap_.rlock();
   numTasks = 0;
-  for (const auto& pair : *taskMap) {
-    if (pair.second->task != nullptr) {
-      ++res[pair.second->task->state()];
-      ++numTasks;
-    }
+  for (size_t i = 0; i < res.size(); ++i) {
+    // The counts of different states are read one at a time, so a task
+    // changing state meanwhile may be missed or counted twice.
+    res[i] = std::max<int64_t>(0, numTasksByState_[i].load());
+    numTasks += res[i];
   }
   return res;
 }
 
+void TaskManager::countTaskStateLocked(PrestoTask& prestoTask, int state) {
+  if (prestoTask.countedState == state) {
+    return;
+  }
+  if (prestoTask.countedState >= 0) {
+    --numTasksByState_[prestoTask.countedState];
+  }
+  if (state >= 0) {
+    ++numTasksByState_[state];
+  }
+  prestoTask.countedState = state;
+}
+
 } // namespace facebook::presto
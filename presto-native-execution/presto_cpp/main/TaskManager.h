@@ -14,9 +14,21 @@
 #pragma once
 
 #include <folly/Synchronized.h>
+#include <folly/concurrency/ConcurrentHashMap.h>
+#include <folly/container/EvictingCacheMap.h>
 #include <memory>
+#include <queue>
+#include "presto_cpp/main/BatchResults.h"
+#include "presto_cpp/main/FragmentResultCache.h"
+#include "presto_cpp/main/OutputBufferSpiller.h"
 #include "presto_cpp/main/PrestoTask.h"
+#include "presto_cpp/main/PushExchange.h"
 #include "presto_cpp/main/QueryContextManager.h"
+#include "presto_cpp/main/QueryResourceLedger.h"
+#include "presto_cpp/main/SpillPathSelector.h"
+#include "presto_cpp/main/SpillQuota.h"
+#include "presto_cpp/main/TaskAdmissionController.h"
+#include "presto_cpp/main/TableCacheStats.h"
 #include "presto_cpp/main/http/HttpServer.h"
 #include "presto_cpp/presto_protocol/presto_protocol.h"
 #include "velox/exec/PartitionedOutputBufferManager.h"
@@ -28,6 +40,17 @@ struct DriverCountStats {
   size_t numRunningDrivers{0};
 };
 
+/// The header of a result request, 'true' if the consumer accepts responses
+/// larger than its X-Presto-Max-Size, see
+/// SystemConfig::kTaskRootStageMaxResultBytes.
+constexpr std::string_view kPrestoAcceptLargerResultsHeader{
+    "X-Presto-Accept-Larger-Results"};
+
+/// Invoked with the id and the new state of a task on each of its state
+/// transitions. Invoked under the task's mutex, so it must not block.
+using TaskStateListener =
+    std::function<void(const protocol::TaskId&, protocol::TaskState)>;
+
 class TaskManager {
  public:
   explicit TaskManager(
@@ -42,10 +65,21 @@ class TaskManager {
     nodeId_ = nodeId;
   }
 
-  TaskMap tasks() const {
-    return taskMap_.withRLock([](const auto& tasks) { return tasks; });
+  /// Sets the number of drivers of the new tasks whose session does not set
+  /// it.
+  void setMaxDriversPerTask(int32_t maxDrivers) {
+    maxDriversPerTask_ = maxDrivers;
   }
 
+  /// Sets the number of concurrent lifespans of the new grouped execution
+  /// tasks whose session does not set it. Zero means unlimited.
+  void setConcurrentLifespansPerTask(int32_t concurrentLifespans) {
+    concurrentLifespansPerTask_ = concurrentLifespans;
+  }
+
+  /// Returns a snapshot of all the tasks.
+  TaskMap tasks() const;
+
   void abortResults(const protocol::TaskId& taskId, long bufferId);
 
   void
@@ -66,7 +100,19 @@ class TaskManager {
       std::unordered_map<
           std::string,
           std::unordered_map<std::string, std::string>>&&
-          connectorConfigStrings);
+          connectorConfigStrings,
+      uint64_t filterConversionNanos = 0);
+
+  /// Same as above but calls 'makeConfigs' for the config maps only if the
+  /// task is the first of its query on this worker. The later tasks reuse the
+  /// query context and its parsed session config.
+  std::unique_ptr<protocol::TaskInfo> createOrUpdateTaskWithConfigs(
+      const protocol::TaskId& taskId,
+      velox::core::PlanFragment planFragment,
+      const std::vector<protocol::TaskSource>& sources,
+      const protocol::OutputBuffers& outputBuffers,
+      const std::function<QueryConfigStrings()>& makeConfigs,
+      uint64_t filterConversionNanos = 0);
 
   // Iterates through a map of resultRequests and fetches data from
   // buffer manager. This method uses the getData() global call to fetch
@@ -83,7 +129,8 @@ class TaskManager {
       bool abort);
 
   /// Remove old Finished, Cancelled, Failed and Aborted tasks.
-  /// Old is being defined by the lifetime of the task.
+  /// Old is being defined by the lifetime of the task. Only visits the tasks
+  /// whose expiry falls due, see 'taskExpiries_'.
   size_t cleanOldTasks();
 
   folly::Future<std::unique_ptr<protocol::TaskInfo>> getTaskInfo(
@@ -99,14 +146,66 @@ class TaskManager {
       long token,
       protocol::DataSize maxSize,
       protocol::Duration maxWait,
+      std::shared_ptr<http::CallbackRequestHandlerState> state,
+      bool acceptLargerResults = false);
+
+  /// Reads the results of the output buffers at 'locations' in one request.
+  /// The returned future is fulfilled as soon as any of them has data, is
+  /// complete or fails, or after 'maxWait' if none does. The locations which
+  /// are not ready by then are reported as empty results at their requested
+  /// token, so the consumer simply asks for them again. 'maxSize' is split
+  /// evenly among the locations.
+  folly::Future<std::vector<folly::Try<std::unique_ptr<Result>>>>
+  getBatchResults(
+      const std::vector<ResultLocation>& locations,
+      protocol::DataSize maxSize,
+      protocol::Duration maxWait,
       std::shared_ptr<http::CallbackRequestHandlerState> state);
 
+  /// Starts pushing the pages of the output buffer 'bufferId' of 'taskId' to
+  /// the consumer registered by 'registration'. Throws if the output buffer
+  /// doesn't exist, in which case the consumer falls back to pulling the
+  /// pages.
+  void startPushResults(
+      const protocol::TaskId& taskId,
+      long bufferId,
+      const PushRegistration& registration);
+
   folly::Future<std::unique_ptr<protocol::TaskStatus>> getTaskStatus(
       const protocol::TaskId& taskId,
       std::optional<protocol::TaskState> currentState,
       std::optional<protocol::Duration> maxWait,
       std::shared_ptr<http::CallbackRequestHandlerState> state);
 
+  /// Subscribes 'listener' to the state transitions of all the tasks of
+  /// 'queryId', including the ones created later. 'listener' is invoked right
+  /// away with the current state of each existing task of the query, so a
+  /// transition racing with the subscription may be reported twice. Returns
+  /// the id to unsubscribe with.
+  uint64_t subscribeTaskStates(
+      const std::string& queryId,
+      TaskStateListener listener);
+
+  void unsubscribeTaskStates(const std::string& queryId, uint64_t id);
+
+  /// Returns the live input and output rows, CPU and blocked time of each
+  /// operator of 'taskId' as a JSON object with an 'operators' array. Reads a
+  /// snapshot of the operator stats of the Velox task without taking the
+  /// PrestoTask mutex or building the TaskInfo, so it is cheap enough to poll
+  /// for progress. The array is empty if the task is not started or doesn't
+  /// exist.
+  json getOperatorStats(const protocol::TaskId& taskId) const;
+
+  /// Returns the reply to a client which last saw 'knownVersion' of the
+  /// TaskStatus or, if 'info' is true, of the TaskInfo of 'taskId', given the
+  /// current 'document'. Returns the whole unversioned document if the task no
+  /// longer exists.
+  VersionedJson::Update getVersionedUpdate(
+      const protocol::TaskId& taskId,
+      bool info,
+      json document,
+      uint64_t knownVersion);
+
   void removeRemoteSource(
       const protocol::TaskId& taskId,
       const protocol::TaskId& remoteSourceTaskId);
@@ -121,17 +220,142 @@ class TaskManager {
     return &queryContextManager_;
   }
 
+  /// The spill paths the spill directories of the tasks are spread over.
+  SpillPathSelector& spillPaths() {
+    return spillPaths_;
+  }
+
+  /// The spill byte limits of the queries and of the node.
+  const SpillQuota& spillQuota() const {
+    return spillQuota_;
+  }
+
+  /// Returns the order in which to add the 'splits' of a source to a task. The
+  /// Hive splits of the files recently scanned by the tasks of this worker
+  /// come first so that the drivers start with the splits whose data is
+  /// likely cached while the others are preloaded. The relative order of the
+  /// splits is kept otherwise. Remembers the files of 'splits' as scanned.
+  std::vector<size_t> cacheAwareSplitOrder(
+      const std::vector<velox::exec::Split>& splits);
+
+  /// Refreshes the bytes spilled by the running tasks of each query and fails
+  /// the tasks of the queries over their spill limits. Returns the number of
+  /// the tasks failed.
+  size_t enforceSpillQuota();
+
+  /// Fails the running tasks of 'queryId' with 'message'. Returns the number
+  /// of the tasks failed.
+  size_t failQueryTasks(
+      const std::string& queryId,
+      const std::string& message);
+
+  /// The cache hits and misses of the table scans of the finished tasks.
+  const TableCacheStats& tableCacheStats() const {
+    return tableCacheStats_;
+  }
+
+  /// Returns the resources used by the finished tasks of each recent query.
+  QueryResourceLedger& queryResources() {
+    return queryResources_;
+  }
+
+  FragmentResultCache& fragmentResultCache() {
+    return fragmentResultCache_;
+  }
+
+  /// Sets the load of the node sampled now and starts the queued tasks that
+  /// the load admits, in the order they were queued. Returns the number of
+  /// the tasks started.
+  size_t updateAdmissionLoad(const TaskAdmissionController::Load& load);
+
+  /// Spills the output buffer pages of the idle consumers if 'memoryPct' of
+  /// the node memory is in use. Returns the number of the destinations
+  /// started spilling.
+  size_t spillIdleOutputBuffers(double memoryPct) {
+    return outputBufferSpiller_->maybeSpill(memoryPct);
+  }
+
+  /// Returns the number of the output buffer destinations served from disk.
+  size_t numSpilledOutputBuffers() const {
+    return outputBufferSpiller_->numSpilledDestinations();
+  }
+
+  /// Returns the number of the batches the splits of the large task updates
+  /// were converted in, see 'task.split-conversion-batch-size'.
+  uint64_t numSplitConversionBatches() const {
+    return numSplitConversionBatches_;
+  }
+
+  /// Returns the number of the tasks waiting for admission.
+  size_t numQueuedTasks() const {
+    std::lock_guard<std::mutex> l(admissionQueueMutex_);
+    return admissionQueue_.size();
+  }
+
   inline size_t getNumTasks() const {
-    return taskMap_.rlock()->size();
+    return taskMap_.size();
   }
 
   // Returns the number of running drivers in all tasks.
   DriverCountStats getDriverCountStats() const;
 
+  /// Returns the number of blocked drivers of the running tasks by the reason
+  /// they are blocked for, e.g. waitForExchange or waitForMemory. The counts
+  /// are those of the last status update of each task.
+  std::unordered_map<std::string, size_t> getBlockedDriverCounts() const;
+
   // Returns array with number of tasks for each of five TaskState (enum defined
-  // in exec/Task.h).
+  // in exec/Task.h). The numbers are maintained as the tasks change state, so
+  // this does not visit the tasks.
   std::array<size_t, 5> getTaskNumbers(size_t& numTasks) const;
 
+  /// Refuses the new tasks from now on, e.g. while the node drains before
+  /// shutdown. The updates of the existing tasks are still accepted.
+  void setDraining() {
+    draining_ = true;
+  }
+
+  bool draining() const {
+    return draining_;
+  }
+
+  /// Returns the number of finished tasks the coordinator has not asked about
+  /// since they finished, i.e. whose final info it may still fetch.
+  size_t numUnreportedFinishedTasks() const;
+
+  /// Returns the drivers to start 'planFragment' with, at most 'maxDrivers'.
+  /// A fragment whose leaves are all table scans that get all their splits in
+  /// 'sources' runs one driver per 'splitsPerDriver' splits. The other
+  /// fragments and 0 'splitsPerDriver' get 'maxDrivers'.
+  static uint32_t maxDriversForSplits(
+      const velox::core::PlanFragment& planFragment,
+      const std::vector<protocol::TaskSource>& sources,
+      uint32_t maxDrivers,
+      uint32_t splitsPerDriver);
+
+  /// Returns the drivers to start 'planFragment' with when it writes a table,
+  /// at most 'maxDrivers' and 'writerCount' if not 0. A writing fragment whose
+  /// leaves are all table scans that get all their hive splits in 'sources'
+  /// runs one driver per 'targetFileBytes' of splits, so that each driver
+  /// writes a file of about that size. The other fragments get 'maxDrivers'.
+  static uint32_t maxDriversForWriter(
+      const velox::core::PlanFragment& planFragment,
+      const std::vector<protocol::TaskSource>& sources,
+      uint32_t maxDrivers,
+      uint32_t writerCount,
+      uint64_t targetFileBytes);
+
+  /// Returns the size of the next result response of a root stage task after
+  /// a response of 'bytes' out of 'resultBytes'. Doubles up to 'maxBytes'
+  /// after a response filled at least half of it, holds after a quarter and
+  /// goes back to 'requestedBytes' below that or once 'complete'.
+  static uint64_t nextResultMaxBytes(
+      uint64_t requestedBytes,
+      uint64_t resultBytes,
+      uint64_t maxBytes,
+      uint64_t bytes,
+      bool complete);
+
   /// Build directory path for spilling for the given task.
   /// Always returns non-empty string.
   static std::string buildTaskSpillDirectoryPath(
@@ -141,25 +365,127 @@ class TaskManager {
 
  public:
   static constexpr folly::StringPiece kMaxDriversPerTask{
-      "max_drivers_per_task"};
+      QuerySessionConfig::kMaxDriversPerTask};
   static constexpr folly::StringPiece kConcurrentLifespansPerTask{
-      "concurrent_lifespans_per_task"};
+      QuerySessionConfig::kConcurrentLifespansPerTask};
+  static constexpr folly::StringPiece kTaskWriterCount{
+      QuerySessionConfig::kTaskWriterCount};
   static constexpr folly::StringPiece kSessionTimezone{"session_timezone"};
+  // Unlimited concurrent lifespans is translated to this limit.
+  static constexpr uint32_t kMaxConcurrentLifespans{16};
 
  private:
   std::shared_ptr<PrestoTask> findOrCreateTask(const protocol::TaskId& taskId);
 
-  std::shared_ptr<PrestoTask> findOrCreateTaskLocked(
-      TaskMap& taskMap,
-      const protocol::TaskId& taskId);
+  // Moves 'prestoTask' to 'state' in 'numTasksByState_'. A negative 'state'
+  // stops counting it. Called under the mutex of 'prestoTask'.
+  void countTaskStateLocked(PrestoTask& prestoTask, int state);
+
+  // Creates a new task which is not added to the task map yet.
+  std::shared_ptr<PrestoTask> createTask(const protocol::TaskId& taskId);
+
+  // Reports 'state' to the task state subscribers of the query of
+  // 'prestoTask' if it differs from the last published one. Must be called
+  // under the task's mutex.
+  void publishTaskStateLocked(
+      PrestoTask& prestoTask,
+      protocol::TaskState state);
+
+  // Replaces the scans of 'planFragment' with the rows cached for it,
+  // 'sources' and the session properties 'resultConfigs', or records its rows
+  // to cache them when 'prestoTask' finishes.
+  void useFragmentResultCache(
+      PrestoTask& prestoTask,
+      velox::core::PlanFragment& planFragment,
+      const std::vector<protocol::TaskSource>& sources,
+      const std::string& resultConfigs);
+
+  // Returns true if the new 'prestoTask' may start now. Otherwise queues it
+  // to start with 'maxDrivers' and 'concurrentLifespans' once the load of the
+  // node admits it.
+  bool admitOrQueue(
+      const std::shared_ptr<PrestoTask>& prestoTask,
+      uint32_t maxDrivers,
+      uint32_t concurrentLifespans);
+
+  // Starts the exec task of 'prestoTask' and returns the result requests
+  // received before. Called under the task's mutex.
+  std::unordered_map<int64_t, std::shared_ptr<ResultRequest>>
+  startTaskLocked(
+      const std::shared_ptr<PrestoTask>& prestoTask,
+      uint32_t maxDrivers,
+      uint32_t concurrentLifespans);
+
+  // Publishes the state of the started 'prestoTask' once it leaves the
+  // running state and schedules its expiry.
+  void watchTaskState(const std::shared_ptr<PrestoTask>& prestoTask);
+
+  // Makes the next cleanOldTasks() after 'delayMs' check whether 'taskId' is
+  // old.
+  void scheduleTaskExpiry(const protocol::TaskId& taskId, uint64_t delayMs);
 
   std::string baseUri_;
   std::string nodeId_;
   std::shared_ptr<velox::exec::PartitionedOutputBufferManager> bufferManager_;
-  folly::Synchronized<TaskMap> taskMap_;
+  // Serves the results from 'bufferManager_' or from disk for the spilled
+  // destinations.
+  std::shared_ptr<OutputBufferSpiller> outputBufferSpiller_;
+  // Sharded with lock-free lookups. The iterators see the concurrent updates
+  // instead of iterating a snapshot.
+  folly::ConcurrentHashMap<
+      protocol::TaskId,
+      std::shared_ptr<PrestoTask>,
+      TaskIdHash>
+      taskMap_;
   QueryContextManager queryContextManager_;
-  int32_t maxDriversPerTask_;
-  int32_t concurrentLifespansPerTask_;
+  std::atomic<int32_t> maxDriversPerTask_;
+  std::atomic_bool draining_{false};
+  // The number of tasks with an exec task by their state.
+  std::array<std::atomic<int64_t>, 5> numTasksByState_{};
+  std::atomic<int32_t> concurrentLifespansPerTask_;
+  std::atomic<uint64_t> numSplitConversionBatches_{0};
+  // Whether the result pages carry checksums.
+  const bool checksumPages_;
+  // The maximum size of the result responses of the root stage tasks.
+  const uint64_t rootStageMaxResultBytes_;
+  // The task state subscribers keyed by query id and subscription id.
+  folly::Synchronized<std::unordered_map<
+      std::string,
+      std::unordered_map<uint64_t, TaskStateListener>>>
+      taskStateListeners_;
+  std::atomic<uint64_t> nextSubscriptionId_{0};
+  TableCacheStats tableCacheStats_;
+  // The spill paths the tasks spill under.
+  SpillPathSelector spillPaths_;
+  // The new tasks of the queries at their spill limit do not spill.
+  SpillQuota spillQuota_;
+  QueryResourceLedger queryResources_;
+  // The files most recently scanned by the tasks, used as a proxy for the
+  // files whose data is in the cache. The splits are not reordered if
+  // 'maxRecentFiles_' is 0.
+  const int32_t maxRecentFiles_;
+  folly::Synchronized<folly::EvictingCacheMap<std::string, bool>> recentFiles_;
+  FragmentResultCache fragmentResultCache_;
+  TaskAdmissionController admissionController_;
+  struct QueuedTask {
+    std::weak_ptr<PrestoTask> prestoTask;
+    uint32_t maxDrivers;
+    uint32_t concurrentLifespans;
+  };
+  // The tasks waiting for admission, the first queued first.
+  mutable std::mutex admissionQueueMutex_;
+  std::deque<QueuedTask> admissionQueue_;
+  // Min-heap of the times in ms at which the tasks may become old, so that
+  // cleanOldTasks() does not scan the running tasks. A task may have several
+  // entries, the stale ones are dropped when they fall due. The entries are
+  // added on task creation and when the Velox task leaves the running state.
+  // The tasks found not old yet are rescheduled, the zombie tasks to the next
+  // cleanup.
+  folly::Synchronized<std::priority_queue<
+      std::pair<uint64_t, protocol::TaskId>,
+      std::vector<std::pair<uint64_t, protocol::TaskId>>,
+      std::greater<>>>
+      taskExpiries_;
 };
 
 } // namespace facebook::presto
@@ -12,14 +12,23 @@
  * limitations under the License.
  */
 #include "presto_cpp/main/TaskResource.h"
+#include <folly/executors/InlineExecutor.h>
 #include <presto_cpp/main/common/Exception.h>
 #include "presto_cpp/external/json/json.hpp"
+#include "presto_cpp/main/QueryContextManager.h"
+#include "presto_cpp/main/SharedBroadcastExchangeSource.h"
+#include "presto_cpp/main/Tracer.h"
 #include "presto_cpp/main/common/Configs.h"
+#include "presto_cpp/main/common/Counters.h"
+#include "presto_cpp/main/http/JsonWriter.h"
 #include "presto_cpp/main/thrift/ProtocolToThrift.h"
 #include "presto_cpp/main/thrift/ThriftIO.h"
 #include "presto_cpp/main/thrift/gen-cpp2/PrestoThrift.h"
+#include "presto_cpp/main/types/PrestoTaskId.h"
 #include "presto_cpp/main/types/PrestoToVeloxQueryPlan.h"
+#include "presto_cpp/presto_protocol/Base64Util.h"
 #include "presto_cpp/presto_protocol/presto_protocol.h"
+#include "velox/common/base/StatsReporter.h"
 #include "velox/common/time/Timer.h"
 #include "velox/type/tz/TimeZoneMap.h"
 
@@ -57,9 +66,200 @@ std::optional<protocol::Duration> getMaxWait(proxygen::HTTPMessage* message) {
   return protocol::Duration(
       headers.getSingleOrEmpty(protocol::PRESTO_MAX_WAIT_HTTP_HEADER));
 }
+
 } // namespace
 
+json parseTaskUpdateJson(
+    const std::string& body,
+    const std::vector<std::string>& fragmentPath,
+    std::shared_ptr<protocol::String>& fragment) {
+  // The keys leading to the value being parsed.
+  std::vector<std::string> keys;
+  bool atFragment = false;
+  json document = json::parse(
+      body, [&](int depth, json::parse_event_t event, json& parsed) {
+        if (event == json::parse_event_t::key) {
+          keys.resize(depth);
+          keys[depth - 1] = parsed.get<std::string>();
+          atFragment = keys == fragmentPath;
+          return true;
+        }
+        if (atFragment && event == json::parse_event_t::value &&
+            parsed.is_string()) {
+          atFragment = false;
+          fragment = std::make_shared<protocol::String>(
+              std::move(parsed.get_ref<std::string&>()));
+          // Keeps a null in place of the fragment. A discarded value is not
+          // removed from the document when it is the last member of its
+          // object, so the key is erased below instead.
+          parsed = nullptr;
+          return true;
+        }
+        atFragment = false;
+        return true;
+      });
+  if (fragment != nullptr) {
+    json* parent = &document;
+    for (size_t i = 0; i + 1 < fragmentPath.size(); ++i) {
+      parent = &parent->at(fragmentPath[i]);
+    }
+    parent->erase(fragmentPath.back());
+  }
+  return document;
+}
+
+namespace {
+
+// Returns the serialized table write info of 'taskUpdateRequest', empty if
+// none. The plan fragment cache keys the conversion on it too.
+std::string planCacheTableWriteInfo(
+    const protocol::TaskUpdateRequest& taskUpdateRequest) {
+  if (taskUpdateRequest.tableWriteInfo == nullptr) {
+    return std::string();
+  }
+  return json(*taskUpdateRequest.tableWriteInfo).dump();
+}
+
+// Returns true if the client accepts Thrift encoded responses.
+bool acceptsThrift(proxygen::HTTPMessage* message) {
+  return message->getHeaders()
+             .getSingleOrEmpty(proxygen::HTTP_HEADER_ACCEPT)
+             .find(http::kMimeTypeApplicationThrift) != std::string::npos;
+}
+
+// Returns true if the request body is Thrift encoded.
+bool hasThriftBody(proxygen::HTTPMessage* message) {
+  return message->getHeaders()
+             .getSingleOrEmpty(proxygen::HTTP_HEADER_CONTENT_TYPE)
+             .find(http::kMimeTypeApplicationThrift) != std::string::npos;
+}
+
+// Returns the Content-Encoding the request body is compressed with, empty if
+// it is not compressed.
+std::string contentEncoding(proxygen::HTTPMessage* message) {
+  return message->getHeaders().getSingleOrEmpty(
+      proxygen::HTTP_HEADER_CONTENT_ENCODING);
+}
+
+// Writes 'taskInfo' as JSON like its to_json() conversion. The stats of the
+// pipelines, which hold the operator stats and make most of the document, are
+// converted one pipeline at a time instead of all at once. Moves the pipelines
+// out of 'taskInfo'.
+std::unique_ptr<folly::IOBuf> taskInfoToJson(protocol::TaskInfo& taskInfo) {
+  const auto pipelines = std::move(taskInfo.stats.pipelines);
+  taskInfo.stats.pipelines.clear();
+  const json taskInfoJson = taskInfo;
+
+  http::JsonWriter writer;
+  writer.beginObject();
+  for (const auto& item : taskInfoJson.items()) {
+    writer.key(item.key());
+    if (item.key() != "stats") {
+      writer.value(item.value());
+      continue;
+    }
+    writer.beginObject();
+    for (const auto& statsItem : item.value().items()) {
+      writer.key(statsItem.key());
+      if (statsItem.key() != "pipelines") {
+        writer.value(statsItem.value());
+        continue;
+      }
+      writer.beginArray();
+      for (const auto& pipeline : pipelines) {
+        writer.value(json(pipeline));
+      }
+      writer.endArray();
+    }
+    writer.endObject();
+  }
+  writer.endObject();
+  return writer.finish();
+}
+
+void sendTaskInfo(
+    proxygen::ResponseHandler* downstream,
+    protocol::TaskInfo& taskInfo,
+    bool useThrift) {
+  if (useThrift) {
+    thrift::TaskInfo thriftTaskInfo;
+    toThrift(taskInfo, thriftTaskInfo);
+    http::sendOkThriftResponse(downstream, thriftWrite(thriftTaskInfo));
+  } else {
+    http::sendOkResponse(downstream, taskInfoToJson(taskInfo));
+  }
+}
+
+// Returns the version of the TaskStatus or TaskInfo last seen by the client if
+// it sends versioned requests.
+std::optional<uint64_t> getKnownVersion(proxygen::HTTPMessage* message) {
+  auto& headers = message->getHeaders();
+  const std::string header(kPrestoTaskInfoVersionHeader);
+  if (!headers.exists(header)) {
+    return std::nullopt;
+  }
+  return folly::to<uint64_t>(headers.getSingleOrEmpty(header));
+}
+
+void sendVersionedResponse(
+    proxygen::ResponseHandler* downstream,
+    const VersionedJson::Update& update) {
+  proxygen::ResponseBuilder builder(downstream);
+  if (update.version != 0) {
+    builder.header(
+        std::string(kPrestoTaskInfoVersionHeader),
+        folly::to<std::string>(update.version));
+  }
+  if (update.notModified) {
+    builder.status(http::kHttpNotModified, "Not Modified").sendWithEOM();
+    return;
+  }
+  builder.status(http::kHttpOk, "OK")
+      .header(
+          proxygen::HTTP_HEADER_CONTENT_TYPE,
+          update.delta ? http::kMimeTypeApplicationJsonPatch
+                       : http::kMimeTypeApplicationJson)
+      .body(update.body.dump())
+      .sendWithEOM();
+}
+} // namespace
+
+protocol::TaskUpdateRequest parseThriftTaskUpdateRequest(
+    const folly::IOBuf& body) {
+  auto thriftRequest = std::make_shared<thrift::TaskUpdateRequest>();
+  thriftRead(body, thriftRequest);
+
+  protocol::TaskUpdateRequest taskUpdateRequest;
+  json::parse(*thriftRequest->session_ref()).get_to(taskUpdateRequest.session);
+  taskUpdateRequest.extraCredentials = *thriftRequest->extraCredentials_ref();
+  if (thriftRequest->fragment_ref().has_value()) {
+    taskUpdateRequest.fragment =
+        std::make_shared<protocol::String>(*thriftRequest->fragment_ref());
+  }
+  json::parse(*thriftRequest->sources_ref()).get_to(taskUpdateRequest.sources);
+  json::parse(*thriftRequest->outputIds_ref())
+      .get_to(taskUpdateRequest.outputIds);
+  if (thriftRequest->tableWriteInfo_ref().has_value()) {
+    taskUpdateRequest.tableWriteInfo =
+        std::make_shared<protocol::TableWriteInfo>();
+    json::parse(*thriftRequest->tableWriteInfo_ref())
+        .get_to(*taskUpdateRequest.tableWriteInfo);
+  }
+  return taskUpdateRequest;
+}
+
+folly::Executor* TaskResource::planningExecutor() const {
+  if (planningExecutor_ != nullptr) {
+    return planningExecutor_.get();
+  }
+  return controlExecutor_ != nullptr ? controlExecutor_
+                                     : &folly::InlineExecutor::instance();
+}
+
 void TaskResource::registerUris(http::HttpServer& server) {
+  controlExecutor_ = server.getCpuExecutor(http::EndpointClass::kControl);
+  dataExecutor_ = server.getCpuExecutor(http::EndpointClass::kData);
+
   server.registerDelete(
       R"(/v1/task/(.+)/results/(.+))",
       [&](proxygen::HTTPMessage* message,
@@ -83,6 +283,21 @@ void TaskResource::registerUris(http::HttpServer& server) {
         return createOrUpdateBatchTask(message, pathMatch);
       });
 
+  // Must come before the /v1/task/(.+) for the same reason as above.
+  server.registerPost(
+      R"(/v1/task/(.+)/results/([0-9]+)/push)",
+      [&](proxygen::HTTPMessage* message,
+          const std::vector<std::string>& pathMatch) {
+        return pushResults(message, pathMatch);
+      });
+
+  server.registerPost(
+      std::string(kBatchResultsPath),
+      [&](proxygen::HTTPMessage* message,
+          const std::vector<std::string>& pathMatch) {
+        return getBatchResults(message, pathMatch);
+      });
+
   server.registerPost(
       R"(/v1/task/(.+))",
       [&](proxygen::HTTPMessage* message,
@@ -90,6 +305,13 @@ void TaskResource::registerUris(http::HttpServer& server) {
         return createOrUpdateTask(message, pathMatch);
       });
 
+  server.registerPost(
+      R"(/v1/tasks)",
+      [&](proxygen::HTTPMessage* message,
+          const std::vector<std::string>& pathMatch) {
+        return createOrUpdateTasks(message, pathMatch);
+      });
+
   server.registerDelete(
       R"(/v1/task/(.+))",
       [&](proxygen::HTTPMessage* message,
@@ -104,6 +326,13 @@ void TaskResource::registerUris(http::HttpServer& server) {
         return getTaskStatus(message, pathMatch);
       });
 
+  server.registerGet(
+      R"(/v1/task/(.+)/operators)",
+      [&](proxygen::HTTPMessage* message,
+          const std::vector<std::string>& pathMatch) {
+        return getOperatorStats(message, pathMatch);
+      });
+
   server.registerGet(
       R"(/v1/task/async/(.+)/results/([0-9]+)/([0-9]+))",
       [&](proxygen::HTTPMessage* message,
@@ -125,6 +354,13 @@ void TaskResource::registerUris(http::HttpServer& server) {
         return getTaskInfo(message, pathMatch);
       });
 
+  server.registerGet(
+      R"(/v1/query/([^/]+)/task-states)",
+      [&](proxygen::HTTPMessage* message,
+          const std::vector<std::string>& pathMatch) {
+        return getTaskStates(message, pathMatch);
+      });
+
   server.registerGet(
       R"(/v1/task/(.+)/remote-source/(.+))",
       [&](proxygen::HTTPMessage* message,
@@ -179,74 +415,126 @@ proxygen::RequestHandler* TaskResource::acknowledgeResults(
 }
 
 proxygen::RequestHandler* TaskResource::createOrUpdateTaskImpl(
-    proxygen::HTTPMessage* /*message*/,
+    proxygen::HTTPMessage* message,
     const std::vector<std::string>& pathMatch,
     const std::function<void(
         const protocol::TaskId&,
-        const std::string&,
+        const folly::IOBuf&,
         protocol::TaskUpdateRequest&,
-        velox::core::PlanFragment&)>& parseFunc) {
+        velox::core::PlanFragment&,
+        uint64_t&)>& parseFunc) {
   protocol::TaskId taskId = pathMatch[1];
+  const bool useThrift = acceptsThrift(message);
+  auto encoding = contentEncoding(message);
 
   return new http::CallbackRequestHandler(
-      [this, taskId, parseFunc](
+      [this, taskId, useThrift, parseFunc, encoding](
           proxygen::HTTPMessage* /*message*/,
           const std::vector<std::unique_ptr<folly::IOBuf>>& body,
-          proxygen::ResponseHandler* downstream) {
-        // TODO Avoid copy
-        std::ostringstream oss;
-        for (auto& buf : body) {
-          oss << std::string((const char*)buf->data(), buf->length());
-        }
-        std::string updateJson = oss.str();
+          proxygen::ResponseHandler* downstream,
+          std::shared_ptr<http::CallbackRequestHandlerState> handlerState) {
+        auto* eventBase = folly::EventBaseManager::get()->getEventBase();
+        folly::via(
+            planningExecutor(),
+            [this,
+             taskId,
+             parseFunc,
+             encoding,
+             updateBody = http::bodyToIOBuf(body),
+             queuedMs = velox::getCurrentTimeMs()]() {
+              REPORT_ADD_HISTOGRAM_VALUE(
+                  kCounterTaskPlanningQueueLatencyMs,
+                  velox::getCurrentTimeMs() - queuedMs);
+              TraceSpan updateSpan("task.update", taskId);
+              std::unique_ptr<protocol::TaskInfo> taskInfo;
+              try {
+                protocol::TaskUpdateRequest taskUpdateRequest;
+                velox::core::PlanFragment planFragment;
+                uint64_t filterConversionNanos{0};
+                uint64_t planningMicros{0};
+                {
+                  // Parses the json and converts the plan.
+                  TraceSpan parseSpan("task.parse", taskId);
+                  velox::MicrosecondTimer timer(&planningMicros);
+                  const auto decodedBody =
+                      http::decodeBody(*updateBody, encoding);
+                  parseFunc(
+                      taskId,
+                      *decodedBody,
+                      taskUpdateRequest,
+                      planFragment,
+                      filterConversionNanos);
+                }
+                REPORT_ADD_HISTOGRAM_VALUE(
+                    kCounterTaskPlanningLatencyMs, planningMicros / 1'000);
+                taskInfo = createOrUpdateTaskFromRequest(
+                    taskId,
+                    std::move(taskUpdateRequest),
+                    std::move(planFragment),
+                    filterConversionNanos);
+              } catch (const velox::VeloxException& e) {
+                // Creating an empty task, putting errors inside so that next
+                // status fetch from coordinator will catch the error and well
+                // categorize it.
+                taskInfo = taskManager_.createOrUpdateErrorTask(
+                    taskId, std::current_exception());
+              }
+              return taskInfo;
+            })
+            .via(eventBase)
+            .thenValue([downstream, handlerState, useThrift](
+                           std::unique_ptr<protocol::TaskInfo> taskInfo) {
+              if (!handlerState->requestExpired()) {
+                sendTaskInfo(downstream, *taskInfo, useThrift);
+              }
+            })
+            .thenError(
+                folly::tag_t<std::exception>{},
+                [downstream, handlerState](const std::exception& e) {
+                  if (!handlerState->requestExpired()) {
+                    http::sendErrorResponse(downstream, e.what());
+                  }
+                });
+      });
+}
 
-        std::unique_ptr<protocol::TaskInfo> taskInfo;
-        try {
-          protocol::TaskUpdateRequest taskUpdateRequest;
-          velox::core::PlanFragment planFragment;
-          parseFunc(taskId, updateJson, taskUpdateRequest, planFragment);
-          const auto& session = taskUpdateRequest.session;
-          auto configs = std::unordered_map<std::string, std::string>(
-              session.systemProperties.begin(), session.systemProperties.end());
-
-          // If there's a timeZoneKey, convert to timezone name and add to the
-          // configs. Throws if timeZoneKey can't be resolved.
-          if (session.timeZoneKey != 0) {
-            configs.emplace(
-                velox::core::QueryConfig::kSessionTimezone,
-                velox::util::getTimeZoneName(session.timeZoneKey));
-          }
-
-          std::unordered_map<
-              std::string,
-              std::unordered_map<std::string, std::string>>
-              connectorConfigs;
-          for (const auto& entry : session.catalogProperties) {
-            connectorConfigs.insert(
-                {entry.first,
-                 std::unordered_map<std::string, std::string>(
-                     entry.second.begin(), entry.second.end())});
-          }
-          taskInfo = taskManager_.createOrUpdateTask(
-              taskId,
-              std::move(planFragment),
-              taskUpdateRequest.sources,
-              taskUpdateRequest.outputIds,
-              std::move(configs),
-              std::move(connectorConfigs));
-        } catch (const velox::VeloxException& e) {
-          // Creating an empty task, putting errors inside so that next status
-          // fetch from coordinator will catch the error and well categorize it.
-          taskInfo = taskManager_.createOrUpdateErrorTask(
-              taskId, std::current_exception());
-        } catch (const std::exception& e) {
-          http::sendErrorResponse(downstream, e.what());
-          return;
-        }
+std::unique_ptr<protocol::TaskInfo> TaskResource::createOrUpdateTaskFromRequest(
+    const protocol::TaskId& taskId,
+    protocol::TaskUpdateRequest taskUpdateRequest,
+    velox::core::PlanFragment planFragment,
+    uint64_t filterConversionNanos) {
+  // Only the first task of the query on this worker converts the session.
+  const auto& session = taskUpdateRequest.session;
+  auto makeConfigs = [&session]() {
+    QueryConfigStrings configs;
+    configs.configStrings = std::unordered_map<std::string, std::string>(
+        session.systemProperties.begin(), session.systemProperties.end());
 
-        json taskInfoJson = *taskInfo;
-        http::sendOkResponse(downstream, taskInfoJson);
-      });
+    // If there's a timeZoneKey, convert to timezone name and add to the
+    // configs. Throws if timeZoneKey can't be resolved.
+    if (session.timeZoneKey != 0) {
+      configs.configStrings.emplace(
+          velox::core::QueryConfig::kSessionTimezone,
+          velox::util::getTimeZoneName(session.timeZoneKey));
+    }
+
+    for (const auto& entry : session.catalogProperties) {
+      configs.connectorConfigStrings.insert(
+          {entry.first,
+           std::unordered_map<std::string, std::string>(
+               entry.second.begin(), entry.second.end())});
+    }
+    return configs;
+  };
+  auto taskInfo = taskManager_.createOrUpdateTaskWithConfigs(
+      taskId,
+      std::move(planFragment),
+      taskUpdateRequest.sources,
+      taskUpdateRequest.outputIds,
+      makeConfigs,
+      filterConversionNanos);
+  releaseLater(std::move(taskUpdateRequest));
+  return taskInfo;
 }
 
 proxygen::RequestHandler* TaskResource::createOrUpdateBatchTask(
@@ -257,12 +545,19 @@ proxygen::RequestHandler* TaskResource::createOrUpdateBatchTask(
       pathMatch,
       [this](
           const protocol::TaskId& taskId,
-          const std::string& updateJson,
+          const folly::IOBuf& updateBody,
           protocol::TaskUpdateRequest& taskUpdateRequest,
-          velox::core::PlanFragment& planFragment) {
-        protocol::BatchTaskUpdateRequest batchTaskUpdateRequest =
-            json::parse(updateJson);
-        taskUpdateRequest = batchTaskUpdateRequest.taskUpdateRequest;
+          velox::core::PlanFragment& planFragment,
+          uint64_t& filterConversionNanos) {
+        std::shared_ptr<protocol::String> fragment;
+        json batchJson = parseTaskUpdateJson(
+            http::bodyToString(updateBody),
+            {"taskUpdateRequest", "fragment"},
+            fragment);
+        protocol::BatchTaskUpdateRequest batchTaskUpdateRequest = batchJson;
+        releaseLater(std::move(batchJson));
+        taskUpdateRequest = std::move(batchTaskUpdateRequest.taskUpdateRequest);
+        taskUpdateRequest.fragment = std::move(fragment);
         if (taskUpdateRequest.fragment == nullptr) {
           return;
         }
@@ -275,13 +570,24 @@ proxygen::RequestHandler* TaskResource::createOrUpdateBatchTask(
               "Shuffle name not provided from 'shuffle.name' property in "
               "config.properties");
         }
-        auto fragment =
-            velox::encoding::Base64::decode(*taskUpdateRequest.fragment);
-        protocol::PlanFragment prestoPlan = json::parse(fragment);
+        json planJson =
+            json::parse(protocol::decodeBase64(*taskUpdateRequest.fragment));
+        protocol::PlanFragment prestoPlan = planJson;
+        releaseLater(std::move(planJson));
         VeloxBatchQueryPlanConverter converter(
-            shuffleName, std::move(serializedShuffleWriteInfo), pool_.get());
+            shuffleName,
+            std::move(serializedShuffleWriteInfo),
+            pool_.get(),
+            operators::toShuffleSerdeFormat(
+                SystemConfig::instance()->shuffleSerdeFormat()),
+            SystemConfig::instance()->shuffleSortByPartitionKeys(),
+            SystemConfig::instance()->shuffleFusePartitionAndWrite(),
+            SystemConfig::instance()->shuffleXxh3HashPartitioning(),
+            &constantBlockCache_);
         planFragment = converter.toVeloxQueryPlan(
             prestoPlan, taskUpdateRequest.tableWriteInfo, taskId);
+        releaseLater(std::move(prestoPlan));
+        filterConversionNanos = converter.filterConversionNanos();
       });
 }
 
@@ -289,26 +595,208 @@ proxygen::RequestHandler* TaskResource::createOrUpdateTask(
     proxygen::HTTPMessage* message,
     const std::vector<std::string>& pathMatch) {
   protocol::TaskId taskId = pathMatch[1];
+  const bool thriftBody = hasThriftBody(message);
   return createOrUpdateTaskImpl(
       message,
       pathMatch,
-      [this](
+      [this, thriftBody](
           const protocol::TaskId& taskId,
-          const std::string& updateJson,
+          const folly::IOBuf& updateBody,
           protocol::TaskUpdateRequest& taskUpdateRequest,
-          velox::core::PlanFragment& planFragment) {
-        taskUpdateRequest = json::parse(updateJson);
+          velox::core::PlanFragment& planFragment,
+          uint64_t& filterConversionNanos) {
+        if (updateCapture_ != nullptr) {
+          updateCapture_->capture(taskId, updateBody, thriftBody);
+        }
+        if (thriftBody) {
+          taskUpdateRequest = parseThriftTaskUpdateRequest(updateBody);
+        } else {
+          std::shared_ptr<protocol::String> fragment;
+          json updateJson = parseTaskUpdateJson(
+              http::bodyToString(updateBody), {"fragment"}, fragment);
+          taskUpdateRequest = updateJson;
+          releaseLater(std::move(updateJson));
+          taskUpdateRequest.fragment = std::move(fragment);
+        }
         if (taskUpdateRequest.fragment != nullptr) {
-          auto fragment =
-              velox::encoding::Base64::decode(*taskUpdateRequest.fragment);
-          protocol::PlanFragment prestoPlan = json::parse(fragment);
-          auto converter = VeloxInteractiveQueryPlanConverter(pool_.get());
-          planFragment = converter.toVeloxQueryPlan(
-              prestoPlan, taskUpdateRequest.tableWriteInfo, taskId);
+          planFragment = planFragmentCache_.getOrConvert(
+              *taskUpdateRequest.fragment,
+              planCacheTableWriteInfo(taskUpdateRequest),
+              [&](bool& shareable) {
+                return toVeloxQueryPlan(
+                    taskId,
+                    taskUpdateRequest,
+                    shareable,
+                    filterConversionNanos);
+              });
         }
       });
 }
 
+velox::core::PlanFragment TaskResource::toVeloxQueryPlan(
+    const protocol::TaskId& taskId,
+    const protocol::TaskUpdateRequest& taskUpdateRequest,
+    bool& shareable,
+    uint64_t& filterConversionNanos) {
+  json planJson =
+      json::parse(protocol::decodeBase64(*taskUpdateRequest.fragment));
+  protocol::PlanFragment prestoPlan = planJson;
+  releaseLater(std::move(planJson));
+  auto converter =
+      VeloxInteractiveQueryPlanConverter(pool_.get(), &constantBlockCache_);
+  auto plan = converter.toVeloxQueryPlan(
+      prestoPlan, taskUpdateRequest.tableWriteInfo, taskId);
+  releaseLater(std::move(prestoPlan));
+  shareable = !converter.taskSpecific();
+  // Every task registers the broadcasts of its query.
+  const auto& broadcasts = converter.broadcastSourceFragmentIds();
+  if (!broadcasts.empty() &&
+      SystemConfig::instance()->exchangeShareBroadcasts()) {
+    SharedBroadcastExchangeSource::addQuery(
+        PrestoTaskId(taskId).queryId(), broadcasts);
+    shareable = false;
+  }
+  filterConversionNanos = converter.filterConversionNanos();
+  return plan;
+}
+
+proxygen::RequestHandler* TaskResource::createOrUpdateTasks(
+    proxygen::HTTPMessage* message,
+    const std::vector<std::string>& /*pathMatch*/) {
+  auto encoding = contentEncoding(message);
+  return new http::CallbackRequestHandler(
+      [this, encoding](
+          proxygen::HTTPMessage* /*message*/,
+          const std::vector<std::unique_ptr<folly::IOBuf>>& body,
+          proxygen::ResponseHandler* downstream,
+          std::shared_ptr<http::CallbackRequestHandlerState> handlerState) {
+        auto* eventBase = folly::EventBaseManager::get()->getEventBase();
+        folly::via(
+            planningExecutor(),
+            [this,
+             encoding,
+             updateBody = http::bodyToIOBuf(body),
+             queuedMs = velox::getCurrentTimeMs()]() {
+              REPORT_ADD_HISTOGRAM_VALUE(
+                  kCounterTaskPlanningQueueLatencyMs,
+                  velox::getCurrentTimeMs() - queuedMs);
+              return createOrUpdateTasks(
+                  *http::decodeBody(*updateBody, encoding));
+            })
+            .via(eventBase)
+            .thenValue([downstream, handlerState](json taskInfos) {
+              if (!handlerState->requestExpired()) {
+                http::sendOkResponse(downstream, taskInfos);
+              }
+            })
+            .thenError(
+                folly::tag_t<std::exception>{},
+                [downstream, handlerState](const std::exception& e) {
+                  if (!handlerState->requestExpired()) {
+                    http::sendErrorResponse(downstream, e.what());
+                  }
+                });
+      });
+}
+
+json TaskResource::createOrUpdateTasks(const folly::IOBuf& updateBody) {
+  TraceSpan updateSpan("tasks.update", "");
+  // The members shared by the tasks. Only the plan fragment is parsed and
+  // converted once for all of them.
+  protocol::TaskUpdateRequest sharedRequest;
+  json tasksJson;
+  // The members shared by the tasks, captured with each task.
+  json captureJson;
+  uint64_t planningMicros{0};
+  {
+    TraceSpan parseSpan("tasks.parse", "");
+    velox::MicrosecondTimer timer(&planningMicros);
+    std::shared_ptr<protocol::String> fragment;
+    json updateJson = parseTaskUpdateJson(
+        http::bodyToString(updateBody), {"fragment"}, fragment);
+    updateJson.at("session").get_to(sharedRequest.session);
+    updateJson.at("extraCredentials").get_to(sharedRequest.extraCredentials);
+    if (updateJson.contains("tableWriteInfo")) {
+      updateJson.at("tableWriteInfo").get_to(sharedRequest.tableWriteInfo);
+    }
+    if (updateCapture_ != nullptr) {
+      for (const auto* key :
+           {"session", "extraCredentials", "tableWriteInfo"}) {
+        if (updateJson.contains(key)) {
+          captureJson[key] = updateJson[key];
+        }
+      }
+      if (fragment != nullptr) {
+        captureJson["fragment"] = *fragment;
+      }
+    }
+    sharedRequest.fragment = std::move(fragment);
+    tasksJson = std::move(updateJson.at("tasks"));
+    releaseLater(std::move(updateJson));
+  }
+  VELOX_USER_CHECK(tasksJson.is_array(), "'tasks' must be an array");
+
+  const std::string tableWriteInfo = planCacheTableWriteInfo(sharedRequest);
+  // Set once the plan converted for a task is known not to be specific to it.
+  std::optional<velox::core::PlanFragment> sharedPlan;
+  json taskInfos = json::array();
+  for (const auto& taskJson : tasksJson) {
+    const protocol::TaskId taskId = taskJson.at("taskId");
+    std::unique_ptr<protocol::TaskInfo> taskInfo;
+    if (updateCapture_ != nullptr) {
+      // Captured like a single task update so that it is replayed the same.
+      auto update = captureJson;
+      for (const auto* key : {"sources", "outputIds"}) {
+        if (taskJson.contains(key)) {
+          update[key] = taskJson[key];
+        }
+      }
+      updateCapture_->capture(taskId, std::move(update));
+    }
+    try {
+      protocol::TaskUpdateRequest taskUpdateRequest = sharedRequest;
+      taskJson.at("sources").get_to(taskUpdateRequest.sources);
+      taskJson.at("outputIds").get_to(taskUpdateRequest.outputIds);
+      velox::core::PlanFragment planFragment;
+      uint64_t filterConversionNanos{0};
+      if (sharedPlan.has_value()) {
+        planFragment = *sharedPlan;
+      } else if (taskUpdateRequest.fragment != nullptr) {
+        velox::MicrosecondTimer timer(&planningMicros);
+        bool converted = false;
+        bool shareable = true;
+        planFragment = planFragmentCache_.getOrConvert(
+            *sharedRequest.fragment, tableWriteInfo, [&](bool& cacheable) {
+              converted = true;
+              auto plan = toVeloxQueryPlan(
+                  taskId, taskUpdateRequest, cacheable, filterConversionNanos);
+              shareable = cacheable;
+              return plan;
+            });
+        // A cached plan is shareable.
+        if (!converted || shareable) {
+          sharedPlan = planFragment;
+        }
+      }
+      taskInfo = createOrUpdateTaskFromRequest(
+          taskId,
+          std::move(taskUpdateRequest),
+          std::move(planFragment),
+          filterConversionNanos);
+    } catch (const std::exception& e) {
+      // Includes the JSON errors of a malformed task, which fail only that
+      // task.
+      taskInfo = taskManager_.createOrUpdateErrorTask(
+          taskId, std::current_exception());
+    }
+    taskInfos.push_back(*taskInfo);
+  }
+  REPORT_ADD_HISTOGRAM_VALUE(
+      kCounterTaskPlanningLatencyMs, planningMicros / 1'000);
+  releaseLater(std::move(tasksJson));
+  return taskInfos;
+}
+
 proxygen::RequestHandler* TaskResource::deleteTask(
     proxygen::HTTPMessage* message,
     const std::vector<std::string>& pathMatch) {
@@ -325,6 +813,8 @@ proxygen::RequestHandler* TaskResource::deleteTask(
           const std::vector<std::unique_ptr<folly::IOBuf>>& /*body*/,
           proxygen::ResponseHandler* downstream) {
         std::unique_ptr<protocol::TaskInfo> taskInfo;
+        // The task is done, its consumers fetch no more pages.
+        compressedPagesCache_.removeTask(taskId);
         try {
           taskInfo = taskManager_.deleteTask(taskId, abort);
         } catch (const velox::VeloxException& e) {
@@ -340,8 +830,7 @@ proxygen::RequestHandler* TaskResource::deleteTask(
           return;
         }
 
-        json taskInfoJson = *taskInfo;
-        http::sendOkResponse(downstream, taskInfoJson);
+        http::sendOkResponse(downstream, taskInfoToJson(*taskInfo));
       });
 }
 
@@ -359,26 +848,77 @@ proxygen::RequestHandler* TaskResource::getResults(
           : protocol::PRESTO_MAX_SIZE_DEFAULT);
   auto maxWait = getMaxWait(message).value_or(
       protocol::Duration(protocol::PRESTO_MAX_WAIT_DEFAULT));
+  const auto pageCodec = negotiatePageCodec(
+      pageCodec_,
+      headers.getSingleOrEmpty(std::string(kPrestoAcceptPageCodecsHeader)));
+  const bool acceptLargerResults =
+      headers.getSingleOrEmpty(std::string(kPrestoAcceptLargerResultsHeader)) ==
+      "true";
 
   return new http::CallbackRequestHandler(
-      [this, taskId, bufferId, token, maxSize, maxWait](
+      [this,
+       taskId,
+       bufferId,
+       token,
+       maxSize,
+       maxWait,
+       pageCodec,
+       acceptLargerResults](
           proxygen::HTTPMessage* /*message*/,
           const std::vector<std::unique_ptr<folly::IOBuf>>& /*body*/,
           proxygen::ResponseHandler* downstream,
           std::shared_ptr<http::CallbackRequestHandlerState> handlerState) {
-        taskManager_
-            .getResults(taskId, bufferId, token, maxSize, maxWait, handlerState)
-            .via(folly::EventBaseManager::get()->getEventBase())
-            .thenValue([downstream, taskId, handlerState](
+        auto* eventBase = folly::EventBaseManager::get()->getEventBase();
+        auto span = Tracer::instance().startSpan("task.results", taskId);
+        auto results = taskManager_.getResults(
+            taskId,
+            bufferId,
+            token,
+            maxSize,
+            maxWait,
+            handlerState,
+            acceptLargerResults);
+        if (pageCodec != velox::common::CompressionKind::CompressionKind_NONE) {
+          // Compresses on the http server's CPU executor behind the queued
+          // control requests, or on the driver threads if it has none, not to
+          // block the http io threads.
+          folly::Executor* executor = dataExecutor_ != nullptr
+              ? dataExecutor_
+              : static_cast<folly::Executor*>(driverCPUExecutor());
+          results =
+              std::move(results)
+                  .via(executor)
+                  .thenValue([this, taskId, pageCodec](
+                                 std::unique_ptr<Result> result) {
+                    if (result->data != nullptr && !result->data->empty()) {
+                      const auto uncompressedSize =
+                          result->data->computeChainDataLength();
+                      // The consumers of a broadcast buffer share the same
+                      // compressed copy of its pages.
+                      if (auto compressed = compressedPagesCache_.getOrCompress(
+                              taskId, *result->data, pageCodec, [&]() {
+                                return compressPages(*result->data, pageCodec);
+                              })) {
+                        result->data = std::move(compressed);
+                        result->uncompressedSize = uncompressedSize;
+                      }
+                    }
+                    return result;
+                  })
+                  .via(eventBase);
+        }
+        std::move(results)
+            .thenValue([downstream, taskId, handlerState, pageCodec, span](
                            std::unique_ptr<Result> result) {
+              Tracer::instance().finishSpan(span);
               if (handlerState->requestExpired()) {
                 return;
               }
               auto status = result->data && result->data->length() == 0
                   ? http::kHttpNoContent
                   : http::kHttpOk;
-              proxygen::ResponseBuilder(downstream)
-                  .status(status, "")
+              proxygen::ResponseBuilder builder(downstream);
+              builder.status(status, "")
                   .header(
                       proxygen::HTTP_HEADER_CONTENT_TYPE,
                       protocol::PRESTO_PAGES_MIME_TYPE)
@@ -391,9 +931,17 @@ proxygen::RequestHandler* TaskResource::getResults(
                       std::to_string(result->nextSequence))
                   .header(
                       protocol::PRESTO_BUFFER_COMPLETE_HEADER,
-                      result->complete ? "true" : "false")
-                  .body(std::move(result->data))
-                  .sendWithEOM();
+                      result->complete ? "true" : "false");
+              if (result->uncompressedSize > 0) {
+                builder
+                    .header(
+                        std::string(kPrestoPageCodecHeader),
+                        std::string(pageCodecName(pageCodec)))
+                    .header(
+                        std::string(kPrestoUncompressedSizeHeader),
+                        std::to_string(result->uncompressedSize));
+              }
+              builder.body(std::move(result->data)).sendWithEOM();
             })
             .thenError(
                 folly::tag_t<velox::VeloxException>{},
@@ -412,6 +960,86 @@ proxygen::RequestHandler* TaskResource::getResults(
       });
 }
 
+proxygen::RequestHandler* TaskResource::getBatchResults(
+    proxygen::HTTPMessage* message,
+    const std::vector<std::string>& /*pathMatch*/) {
+  auto& headers = message->getHeaders();
+  auto maxSize = protocol::DataSize(
+      headers.exists(protocol::PRESTO_MAX_SIZE_HTTP_HEADER)
+          ? headers.getSingleOrEmpty(protocol::PRESTO_MAX_SIZE_HTTP_HEADER)
+          : protocol::PRESTO_MAX_SIZE_DEFAULT);
+  auto maxWait = getMaxWait(message).value_or(
+      protocol::Duration(protocol::PRESTO_MAX_WAIT_DEFAULT));
+
+  return new http::CallbackRequestHandler(
+      [this, maxSize, maxWait](
+          proxygen::HTTPMessage* /*message*/,
+          const std::vector<std::unique_ptr<folly::IOBuf>>& body,
+          proxygen::ResponseHandler* downstream,
+          std::shared_ptr<http::CallbackRequestHandlerState> handlerState) {
+        std::string requestJson;
+        for (auto& buf : body) {
+          requestJson.append((const char*)buf->data(), buf->length());
+        }
+        std::vector<ResultLocation> locations;
+        try {
+          locations = parseResultLocations(requestJson);
+        } catch (const std::exception& e) {
+          http::sendErrorResponse(downstream, e.what());
+          return;
+        }
+        taskManager_
+            .getBatchResults(locations, maxSize, maxWait, handlerState)
+            .via(folly::EventBaseManager::get()->getEventBase())
+            .thenValue(
+                [downstream, handlerState](
+                    std::vector<folly::Try<std::unique_ptr<Result>>> results) {
+                  if (handlerState->requestExpired()) {
+                    return;
+                  }
+                  proxygen::ResponseBuilder(downstream)
+                      .status(http::kHttpOk, "")
+                      .header(
+                          proxygen::HTTP_HEADER_CONTENT_TYPE,
+                          protocol::PRESTO_PAGES_MIME_TYPE)
+                      .body(serializeBatchResults(results))
+                      .sendWithEOM();
+                })
+            .thenError(
+                folly::tag_t<std::exception>{},
+                [downstream, handlerState](const std::exception& e) {
+                  if (!handlerState->requestExpired()) {
+                    http::sendErrorResponse(downstream, e.what());
+                  }
+                });
+      });
+}
+
+proxygen::RequestHandler* TaskResource::pushResults(
+    proxygen::HTTPMessage* /*message*/,
+    const std::vector<std::string>& pathMatch) {
+  protocol::TaskId taskId = pathMatch[1];
+  long bufferId = folly::to<long>(pathMatch[2]);
+  return new http::CallbackRequestHandler(
+      [this, taskId, bufferId](
+          proxygen::HTTPMessage* /*message*/,
+          const std::vector<std::unique_ptr<folly::IOBuf>>& body,
+          proxygen::ResponseHandler* downstream) {
+        std::string registrationJson;
+        for (auto& buf : body) {
+          registrationJson.append((const char*)buf->data(), buf->length());
+        }
+        try {
+          taskManager_.startPushResults(
+              taskId, bufferId, parsePushRegistration(registrationJson));
+        } catch (const std::exception& e) {
+          http::sendErrorResponse(downstream, e.what());
+          return;
+        }
+        http::sendOkResponse(downstream);
+      });
+}
+
 proxygen::RequestHandler* TaskResource::getTaskStatus(
     proxygen::HTTPMessage* message,
     const std::vector<std::string>& pathMatch) {
@@ -419,13 +1047,11 @@ proxygen::RequestHandler* TaskResource::getTaskStatus(
   auto currentState = getCurrentState(message);
   auto maxWait = getMaxWait(message);
 
-  auto& headers = message->getHeaders();
-  auto acceptHeader = headers.getSingleOrEmpty(proxygen::HTTP_HEADER_ACCEPT);
-  auto useThrift =
-      acceptHeader.find(http::kMimeTypeApplicationThrift) != std::string::npos;
+  auto useThrift = acceptsThrift(message);
+  auto knownVersion = getKnownVersion(message);
 
   return new http::CallbackRequestHandler(
-      [this, useThrift, taskId, currentState, maxWait](
+      [this, useThrift, taskId, currentState, maxWait, knownVersion](
           proxygen::HTTPMessage* /*message*/,
           const std::vector<std::unique_ptr<folly::IOBuf>>& /*body*/,
           proxygen::ResponseHandler* downstream,
@@ -434,7 +1060,12 @@ proxygen::RequestHandler* TaskResource::getTaskStatus(
           taskManager_
               .getTaskStatus(taskId, currentState, maxWait, handlerState)
               .via(folly::EventBaseManager::get()->getEventBase())
-              .thenValue([useThrift, downstream, taskId, handlerState](
+              .thenValue([this,
+                          useThrift,
+                          knownVersion,
+                          downstream,
+                          taskId,
+                          handlerState](
                              std::unique_ptr<protocol::TaskStatus> taskStatus) {
                 if (!handlerState->requestExpired()) {
                   if (useThrift) {
@@ -442,6 +1073,11 @@ proxygen::RequestHandler* TaskResource::getTaskStatus(
                     toThrift(*taskStatus, thriftTaskStatus);
                     http::sendOkThriftResponse(
                         downstream, thriftWrite(thriftTaskStatus));
+                  } else if (knownVersion.has_value()) {
+                    sendVersionedResponse(
+                        downstream,
+                        taskManager_.getVersionedUpdate(
+                            taskId, false, *taskStatus, *knownVersion));
                   } else {
                     json taskStatusJson = *taskStatus;
                     http::sendOkResponse(downstream, taskStatusJson);
@@ -475,9 +1111,11 @@ proxygen::RequestHandler* TaskResource::getTaskInfo(
   auto currentState = getCurrentState(message);
   auto maxWait = getMaxWait(message);
   bool summarize = message->hasQueryParam("summarize");
+  auto useThrift = acceptsThrift(message);
+  auto knownVersion = getKnownVersion(message);
 
   return new http::CallbackRequestHandler(
-      [this, taskId, currentState, maxWait, summarize](
+      [this, taskId, currentState, maxWait, summarize, useThrift, knownVersion](
           proxygen::HTTPMessage* /*message*/,
           const std::vector<std::unique_ptr<folly::IOBuf>>& /*body*/,
           proxygen::ResponseHandler* downstream,
@@ -487,11 +1125,22 @@ proxygen::RequestHandler* TaskResource::getTaskInfo(
               .getTaskInfo(
                   taskId, summarize, currentState, maxWait, handlerState)
               .via(folly::EventBaseManager::get()->getEventBase())
-              .thenValue([downstream, taskId, handlerState](
+              .thenValue([this,
+                          useThrift,
+                          knownVersion,
+                          downstream,
+                          taskId,
+                          handlerState](
                              std::unique_ptr<protocol::TaskInfo> taskInfo) {
                 if (!handlerState->requestExpired()) {
-                  json taskInfoJson = *taskInfo;
-                  http::sendOkResponse(downstream, taskInfoJson);
+                  if (!useThrift && knownVersion.has_value()) {
+                    sendVersionedResponse(
+                        downstream,
+                        taskManager_.getVersionedUpdate(
+                            taskId, true, *taskInfo, *knownVersion));
+                  } else {
+                    sendTaskInfo(downstream, *taskInfo, useThrift);
+                  }
                 }
               })
               .thenError(
@@ -515,6 +1164,66 @@ proxygen::RequestHandler* TaskResource::getTaskInfo(
       });
 }
 
+proxygen::RequestHandler* TaskResource::getOperatorStats(
+    proxygen::HTTPMessage* /*message*/,
+    const std::vector<std::string>& pathMatch) {
+  protocol::TaskId taskId = pathMatch[1];
+  return new http::CallbackRequestHandler(
+      [this, taskId](
+          proxygen::HTTPMessage* /*message*/,
+          const std::vector<std::unique_ptr<folly::IOBuf>>& /*body*/,
+          proxygen::ResponseHandler* downstream) {
+        json operatorStats;
+        try {
+          operatorStats = taskManager_.getOperatorStats(taskId);
+        } catch (const std::exception& e) {
+          http::sendErrorResponse(downstream, e.what());
+          return;
+        }
+        http::sendOkResponse(downstream, operatorStats);
+      });
+}
+
+proxygen::RequestHandler* TaskResource::getTaskStates(
+    proxygen::HTTPMessage* /*message*/,
+    const std::vector<std::string>& pathMatch) {
+  const std::string queryId = pathMatch[1];
+  return new http::CallbackRequestHandler(
+      [this, queryId](
+          proxygen::HTTPMessage* /*message*/,
+          const std::vector<std::unique_ptr<folly::IOBuf>>& /*body*/,
+          proxygen::ResponseHandler* downstream,
+          std::shared_ptr<http::CallbackRequestHandlerState> handlerState) {
+        // Headers only, the events follow as chunks.
+        proxygen::ResponseBuilder(downstream)
+            .status(http::kHttpOk, "")
+            .header(
+                proxygen::HTTP_HEADER_CONTENT_TYPE,
+                http::kMimeTypeApplicationJson)
+            .send();
+        auto* eventBase = folly::EventBaseManager::get()->getEventBase();
+        // The listeners run under the task mutex, the chunks are sent on the
+        // event base of the request.
+        const auto id = taskManager_.subscribeTaskStates(
+            queryId,
+            [eventBase, downstream, handlerState](
+                const protocol::TaskId& taskId, protocol::TaskState state) {
+              json event = json::object();
+              event["taskId"] = taskId;
+              event["state"] = state;
+              eventBase->runInEventBaseThread(
+                  [downstream, handlerState, line = event.dump() + "\n"]() {
+                    if (!handlerState->requestExpired()) {
+                      proxygen::ResponseBuilder(downstream).body(line).send();
+                    }
+                  });
+            });
+        handlerState->runOnFinalization([this, queryId, id]() {
+          taskManager_.unsubscribeTaskStates(queryId, id);
+        });
+      });
+}
+
 proxygen::RequestHandler* TaskResource::removeRemoteSource(
     proxygen::HTTPMessage* /*message*/,
     const std::vector<std::string>& pathMatch) {
@@ -13,17 +13,65 @@
  */
 #pragma once
 
+#include <folly/executors/CPUThreadPoolExecutor.h>
+#include <folly/executors/thread_factory/NamedThreadFactory.h>
+
+#include "presto_cpp/main/CompressedPagesCache.h"
+#include "presto_cpp/main/PageCompression.h"
+#include "presto_cpp/main/PlanFragmentCache.h"
 #include "presto_cpp/main/TaskManager.h"
+#include "presto_cpp/main/TaskUpdateCapture.h"
+#include "presto_cpp/main/common/Configs.h"
+#include "presto_cpp/main/types/ConstantBlockCache.h"
 #include "presto_cpp/main/http/HttpServer.h"
 #include "velox/common/memory/Memory.h"
 
 namespace facebook::presto {
 
+/// Parses the JSON 'body' of a task update request. The base64 encoded plan
+/// fragment, which is by far the largest member, is found at the keys
+/// 'fragmentPath' and moved out of the parsed document into 'fragment' so that
+/// it is neither kept in the document nor copied into the request struct.
+json parseTaskUpdateJson(
+    const std::string& body,
+    const std::vector<std::string>& fragmentPath,
+    std::shared_ptr<protocol::String>& fragment);
+
+/// Decodes a Thrift encoded TaskUpdateRequest. The members without a Thrift
+/// equivalent are JSON encoded, see presto_thrift.thrift.
+protocol::TaskUpdateRequest parseThriftTaskUpdateRequest(
+    const folly::IOBuf& body);
+
 class TaskResource {
  public:
   explicit TaskResource(TaskManager& taskManager)
       : taskManager_(taskManager),
-        pool_(velox::memory::addDefaultLeafMemoryPool()) {}
+        pool_(velox::memory::addDefaultLeafMemoryPool()),
+        pageCodec_(toPageCodec(
+            SystemConfig::instance()->exchangeCompressionCodec())),
+        planFragmentCache_(
+            SystemConfig::instance()->planFragmentCacheMaxEntries()),
+        constantBlockCache_(
+            SystemConfig::instance()->constantBlockCacheMaxBytes()),
+        compressedPagesCache_(
+            SystemConfig::instance()->compressedPagesCacheMaxBytes()),
+        planningExecutor_(
+            SystemConfig::instance()->taskPlanningThreads() > 0
+                ? std::make_unique<folly::CPUThreadPoolExecutor>(
+                      SystemConfig::instance()->taskPlanningThreads(),
+                      std::make_shared<folly::NamedThreadFactory>(
+                          "TaskPlanning"))
+                : nullptr),
+        releaseExecutor_(std::make_unique<folly::CPUThreadPoolExecutor>(
+            1,
+            std::make_shared<folly::NamedThreadFactory>("TaskUpdateRelease"))),
+        updateCapture_(
+            SystemConfig::instance()->taskUpdateCaptureDirectory().empty()
+                ? nullptr
+                : std::make_unique<TaskUpdateCapture>(
+                      SystemConfig::instance()->taskUpdateCaptureDirectory(),
+                      SystemConfig::instance()->taskUpdateCaptureMaxFiles())) {
+  }
 
   void registerUris(http::HttpServer& server);
 
@@ -32,6 +80,18 @@ class TaskResource {
   }
 
  private:
+  /// Destroys 'object', e.g. the parsed json and protocol objects of a task
+  /// update, on 'releaseExecutor_'. Their thousands of nodes are freed off
+  /// the task update path.
+  template <typename T>
+  void releaseLater(T object) {
+    releaseExecutor_->add([object = std::move(object)]() {});
+  }
+
+  /// Returns the executor to parse the task updates and convert their plan
+  /// fragments on.
+  folly::Executor* planningExecutor() const;
+
   proxygen::RequestHandler* abortResults(
       proxygen::HTTPMessage* message,
       const std::vector<std::string>& pathMatch);
@@ -66,14 +126,42 @@ class TaskResource {
       proxygen::HTTPMessage* message,
       const std::vector<std::string>& pathMatch);
 
+  /// Creates or updates the tasks of a stage scheduled with several tasks on
+  /// this worker. The JSON body is a TaskUpdateRequest without 'sources' and
+  /// 'outputIds' plus a 'tasks' array of {'taskId', 'sources', 'outputIds'}.
+  /// The plan fragment is parsed and converted once and shared by the tasks
+  /// unless the plan is task specific. Responds with the array of TaskInfos.
+  proxygen::RequestHandler* createOrUpdateTasks(
+      proxygen::HTTPMessage* message,
+      const std::vector<std::string>& pathMatch);
+
+  json createOrUpdateTasks(const folly::IOBuf& updateBody);
+
+  /// Creates or updates 'taskId' from the parsed 'taskUpdateRequest' and its
+  /// converted 'planFragment'.
+  std::unique_ptr<protocol::TaskInfo> createOrUpdateTaskFromRequest(
+      const protocol::TaskId& taskId,
+      protocol::TaskUpdateRequest taskUpdateRequest,
+      velox::core::PlanFragment planFragment,
+      uint64_t filterConversionNanos);
+
+  /// Converts the interactive plan fragment of 'taskUpdateRequest' for
+  /// 'taskId'. Sets 'shareable' to false if the plan is specific to the task.
+  velox::core::PlanFragment toVeloxQueryPlan(
+      const protocol::TaskId& taskId,
+      const protocol::TaskUpdateRequest& taskUpdateRequest,
+      bool& shareable,
+      uint64_t& filterConversionNanos);
+
   proxygen::RequestHandler* createOrUpdateTaskImpl(
       proxygen::HTTPMessage* message,
       const std::vector<std::string>& pathMatch,
       const std::function<void(
           const protocol::TaskId&,
-          const std::string&,
+          const folly::IOBuf&,
           protocol::TaskUpdateRequest&,
-          velox::core::PlanFragment&)>& parseFunc);
+          velox::core::PlanFragment&,
+          uint64_t&)>& parseFunc);
 
   proxygen::RequestHandler* deleteTask(
       proxygen::HTTPMessage* message,
@@ -83,6 +171,19 @@ class TaskResource {
       proxygen::HTTPMessage* message,
       const std::vector<std::string>& pathMatch);
 
+  /// Reads the results of several output buffers in one request. The request
+  /// body lists the buffers and tokens to read, and the response body frames
+  /// their results in the same order. See BatchResults.h for the formats.
+  proxygen::RequestHandler* getBatchResults(
+      proxygen::HTTPMessage* message,
+      const std::vector<std::string>& pathMatch);
+
+  /// Registers a consumer to push the results of an output buffer to. See
+  /// PushExchange.h.
+  proxygen::RequestHandler* pushResults(
+      proxygen::HTTPMessage* message,
+      const std::vector<std::string>& pathMatch);
+
   proxygen::RequestHandler* getTaskStatus(
       proxygen::HTTPMessage* message,
       const std::vector<std::string>& pathMatch);
@@ -91,12 +192,48 @@ class TaskResource {
       proxygen::HTTPMessage* message,
       const std::vector<std::string>& pathMatch);
 
+  /// Responds with the live operator stats of a task, see
+  /// TaskManager::getOperatorStats().
+  proxygen::RequestHandler* getOperatorStats(
+      proxygen::HTTPMessage* message,
+      const std::vector<std::string>& pathMatch);
+
+  /// Streams the state transitions of the tasks of a query on this node as
+  /// newline-delimited JSON objects with 'taskId' and 'state', starting with
+  /// the current states. A state may be repeated. The response does not end
+  /// on its own, clients subscribe again after the idle timeout of the server
+  /// and receive a fresh snapshot.
+  proxygen::RequestHandler* getTaskStates(
+      proxygen::HTTPMessage* message,
+      const std::vector<std::string>& pathMatch);
+
   proxygen::RequestHandler* removeRemoteSource(
       proxygen::HTTPMessage* message,
       const std::vector<std::string>& pathMatch);
 
   TaskManager& taskManager_;
   std::shared_ptr<velox::memory::MemoryPool> pool_;
+  // The codec to compress the data responses with for the consumers which
+  // accept it.
+  const velox::common::CompressionKind pageCodec_;
+  // The converted plan fragments of the regular tasks. The plans hold the
+  // vectors of their values nodes allocated from 'pool_'.
+  PlanFragmentCache planFragmentCache_;
+  // The constant vectors decoded from the blocks of the plan fragments of all
+  // the tasks, allocated from 'pool_'.
+  ConstantBlockCache constantBlockCache_;
+  // The compressed data responses shared by the consumers of the same pages.
+  CompressedPagesCache compressedPagesCache_;
+  // The http server's executors to process the task updates and to compress
+  // the results on. Null if the server has no CPU executor.
+  folly::Executor* controlExecutor_{nullptr};
+  folly::Executor* dataExecutor_{nullptr};
+  // Plans the tasks if 'task.planning-threads' is set.
+  std::unique_ptr<folly::CPUThreadPoolExecutor> planningExecutor_;
+  // Destroys the objects passed to releaseLater().
+  std::unique_ptr<folly::CPUThreadPoolExecutor> releaseExecutor_;
+  // Records the task update bodies if 'task-update-capture.directory' is set.
+  std::unique_ptr<TaskUpdateCapture> updateCapture_;
 };
 
 } // namespace facebook::presto
@@ -0,0 +1,362 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/TaskStatsLog.h"
+#include <glog/logging.h>
+#include <algorithm>
+#include "velox/common/time/Timer.h"
+#include "velox/dwio/common/FileSink.h"
+#include "velox/dwio/dwrf/writer/Writer.h"
+#include "velox/vector/FlatVector.h"
+
+#if __has_include("filesystem")
+#include <filesystem>
+namespace fs = std::filesystem;
+#else
+#include <experimental/filesystem>
+namespace fs = std::experimental::filesystem;
+#endif
+
+using namespace facebook::velox;
+
+namespace facebook::presto {
+namespace {
+constexpr std::string_view kFilePrefix{"task_stats_"};
+constexpr std::string_view kFileSuffix{".dwrf"};
+constexpr std::string_view kTempSuffix{".tmp"};
+
+template <typename T, typename TGetter>
+VectorPtr makeColumn(
+    const TypePtr& type,
+    vector_size_t size,
+    memory::MemoryPool* pool,
+    TGetter getter) {
+  auto vector = BaseVector::create<FlatVector<T>>(type, size, pool);
+  for (vector_size_t i = 0; i < size; ++i) {
+    vector->set(i, getter(i));
+  }
+  return vector;
+}
+} // namespace
+
+TaskStatsLog::TaskStatsLog(
+    std::string directory,
+    int32_t rowsPerFile,
+    int32_t maxFiles,
+    std::chrono::seconds flushInterval)
+    : directory_(std::move(directory)),
+      rowsPerFile_(rowsPerFile),
+      maxFiles_(maxFiles),
+      flushInterval_(flushInterval),
+      rootPool_(memory::defaultMemoryManager().addRootPool("TaskStatsLog")),
+      pool_(rootPool_->addLeafChild("TaskStatsLog")) {
+  VELOX_USER_CHECK_GT(rowsPerFile_, 0);
+  VELOX_USER_CHECK_GT(maxFiles_, 0);
+  fs::create_directories(directory_);
+  // The files of the previous runs count toward 'maxFiles_'. The names start
+  // with the creation time, so they sort from the oldest.
+  std::vector<std::string> existing;
+  for (const auto& entry : fs::directory_iterator(directory_)) {
+    const auto name = entry.path().filename().string();
+    if (name.rfind(kFilePrefix, 0) != 0) {
+      continue;
+    }
+    if (name.size() > kTempSuffix.size() &&
+        name.compare(
+            name.size() - kTempSuffix.size(),
+            kTempSuffix.size(),
+            kTempSuffix) == 0) {
+      // Left by a crash while writing.
+      std::error_code ec;
+      fs::remove(entry.path(), ec);
+      continue;
+    }
+    existing.push_back(entry.path().string());
+  }
+  std::sort(existing.begin(), existing.end());
+  files_.insert(files_.end(), existing.begin(), existing.end());
+  writer_ = std::thread([this]() { writeLoop(); });
+}
+
+TaskStatsLog::~TaskStatsLog() {
+  {
+    std::lock_guard<std::mutex> l(mutex_);
+    stopped_ = true;
+  }
+  rowsAdded_.notify_one();
+  writer_.join();
+  flush();
+}
+
+// static
+const RowTypePtr& TaskStatsLog::rowType() {
+  static const auto type = ROW(
+      {"task_id",
+       "task_state",
+       "task_end_ms",
+       "task_wall_ms",
+       "pipeline_id",
+       "operator_id",
+       "plan_node_id",
+       "operator_type",
+       "cpu_nanos",
+       "wall_nanos",
+       "blocked_wall_nanos",
+       "peak_memory_bytes",
+       "spilled_bytes",
+       "input_rows",
+       "input_bytes",
+       "output_rows",
+       "output_bytes"},
+      {VARCHAR(),
+       VARCHAR(),
+       BIGINT(),
+       BIGINT(),
+       INTEGER(),
+       INTEGER(),
+       VARCHAR(),
+       VARCHAR(),
+       BIGINT(),
+       BIGINT(),
+       BIGINT(),
+       BIGINT(),
+       BIGINT(),
+       BIGINT(),
+       BIGINT(),
+       BIGINT(),
+       BIGINT()});
+  return type;
+}
+
+void TaskStatsLog::onTaskCompletion(
+    const std::string& /*taskUuid*/,
+    const std::string& taskId,
+    exec::TaskState state,
+    std::exception_ptr /*error*/,
+    exec::TaskStats stats) {
+  const auto taskState = exec::taskStateString(state);
+  const int64_t taskWallMs = stats.endTimeMs > stats.executionStartTimeMs
+      ? stats.endTimeMs - stats.executionStartTimeMs
+      : 0;
+  std::lock_guard<std::mutex> l(mutex_);
+  // Wakes up the writer to start the flush interval or to write the batch.
+  rowsAdded_.notify_one();
+  if (rows_.empty()) {
+    oldestRowTime_ = std::chrono::steady_clock::now();
+  }
+  for (const auto& pipelineStats : stats.pipelineStats) {
+    for (const auto& op : pipelineStats.operatorStats) {
+      rows_.push_back(
+          {taskId,
+           taskState,
+           static_cast<int64_t>(stats.endTimeMs),
+           taskWallMs,
+           op.pipelineId,
+           op.operatorId,
+           op.planNodeId,
+           op.operatorType,
+           static_cast<int64_t>(
+               op.addInputTiming.cpuNanos + op.getOutputTiming.cpuNanos +
+               op.finishTiming.cpuNanos),
+           static_cast<int64_t>(
+               op.addInputTiming.wallNanos + op.getOutputTiming.wallNanos +
+               op.finishTiming.wallNanos),
+           static_cast<int64_t>(op.blockedWallNanos),
+           static_cast<int64_t>(op.memoryStats.peakTotalMemoryReservation),
+           static_cast<int64_t>(op.spilledBytes),
+           static_cast<int64_t>(op.inputPositions),
+           static_cast<int64_t>(op.inputBytes),
+           static_cast<int64_t>(op.outputPositions),
+           static_cast<int64_t>(op.outputBytes)});
+    }
+  }
+}
+
+void TaskStatsLog::flush() {
+  std::lock_guard<std::mutex> writeLock(writeMutex_);
+  std::vector<Row> rows;
+  {
+    std::lock_guard<std::mutex> l(mutex_);
+    rows.swap(rows_);
+  }
+  writeLocked(rows);
+}
+
+void TaskStatsLog::writeLoop() {
+  std::unique_lock<std::mutex> l(mutex_);
+  while (!stopped_) {
+    if (rows_.empty()) {
+      rowsAdded_.wait(l, [&]() { return stopped_ || !rows_.empty(); });
+      continue;
+    }
+    const auto deadline = oldestRowTime_ + flushInterval_;
+    if (rows_.size() < static_cast<size_t>(rowsPerFile_) &&
+        std::chrono::steady_clock::now() < deadline) {
+      // Re-checks after each added row, 'deadline' or a spurious wakeup. The
+      // destructor writes the rest once stopped.
+      rowsAdded_.wait_until(l, deadline);
+      continue;
+    }
+    // The rows are taken with 'writeMutex_' held so that flush() also waits
+    // for them.
+    l.unlock();
+    std::lock_guard<std::mutex> writeLock(writeMutex_);
+    std::vector<Row> rows;
+    l.lock();
+    rows.swap(rows_);
+    l.unlock();
+    writeLocked(rows);
+    l.lock();
+  }
+}
+
+std::vector<std::string> TaskStatsLog::files() const {
+  std::lock_guard<std::mutex> l(mutex_);
+  return {files_.begin(), files_.end()};
+}
+
+void TaskStatsLog::writeLocked(const std::vector<Row>& rows) {
+  if (rows.empty()) {
+    return;
+  }
+  const auto path = fmt::format(
+      "{}/{}{}_{:06}{}",
+      directory_,
+      kFilePrefix,
+      getCurrentTimeMs(),
+      fileSequence_++,
+      kFileSuffix);
+  const auto tempPath = fmt::format("{}{}", path, kTempSuffix);
+  try {
+    dwrf::WriterOptions options;
+    options.config = std::make_shared<dwrf::Config>();
+    options.schema = rowType();
+    auto sink = std::make_unique<dwio::common::LocalFileSink>(
+        tempPath, dwio::common::MetricsLog::voidLog());
+    dwrf::Writer writer{options, std::move(sink), *rootPool_};
+    writer.write(makeVector(rows));
+    writer.close();
+    fs::rename(tempPath, path);
+  } catch (const std::exception& e) {
+    LOG(WARNING) << "Dropped the stats of " << rows.size()
+                 << " operators, failed to write " << path << ": "
+                 << e.what();
+    std::error_code ec;
+    fs::remove(tempPath, ec);
+    return;
+  }
+  std::lock_guard<std::mutex> l(mutex_);
+  files_.push_back(path);
+  while (files_.size() > static_cast<size_t>(maxFiles_)) {
+    std::error_code ec;
+    fs::remove(files_.front(), ec);
+    files_.pop_front();
+  }
+}
+
+RowVectorPtr TaskStatsLog::makeVector(const std::vector<Row>& rows) const {
+  const vector_size_t size = rows.size();
+  auto* pool = pool_.get();
+  const auto& type = rowType();
+  std::vector<VectorPtr> columns{
+      makeColumn<StringView>(
+          type->childAt(0),
+          size,
+          pool,
+          [&](auto i) { return StringView(rows[i].taskId); }),
+      makeColumn<StringView>(
+          type->childAt(1),
+          size,
+          pool,
+          [&](auto i) { return StringView(rows[i].taskState); }),
+      makeColumn<int64_t>(
+          type->childAt(2),
+          size,
+          pool,
+          [&](auto i) { return rows[i].taskEndMs; }),
+      makeColumn<int64_t>(
+          type->childAt(3),
+          size,
+          pool,
+          [&](auto i) { return rows[i].taskWallMs; }),
+      makeColumn<int32_t>(
+          type->childAt(4),
+          size,
+          pool,
+          [&](auto i) { return rows[i].pipelineId; }),
+      makeColumn<int32_t>(
+          type->childAt(5),
+          size,
+          pool,
+          [&](auto i) { return rows[i].operatorId; }),
+      makeColumn<StringView>(
+          type->childAt(6),
+          size,
+          pool,
+          [&](auto i) { return StringView(rows[i].planNodeId); }),
+      makeColumn<StringView>(
+          type->childAt(7),
+          size,
+          pool,
+          [&](auto i) { return StringView(rows[i].operatorType); }),
+      makeColumn<int64_t>(
+          type->childAt(8),
+          size,
+          pool,
+          [&](auto i) { return rows[i].cpuNanos; }),
+      makeColumn<int64_t>(
+          type->childAt(9),
+          size,
+          pool,
+          [&](auto i) { return rows[i].wallNanos; }),
+      makeColumn<int64_t>(
+          type->childAt(10),
+          size,
+          pool,
+          [&](auto i) { return rows[i].blockedWallNanos; }),
+      makeColumn<int64_t>(
+          type->childAt(11),
+          size,
+          pool,
+          [&](auto i) { return rows[i].peakMemoryBytes; }),
+      makeColumn<int64_t>(
+          type->childAt(12),
+          size,
+          pool,
+          [&](auto i) { return rows[i].spilledBytes; }),
+      makeColumn<int64_t>(
+          type->childAt(13),
+          size,
+          pool,
+          [&](auto i) { return rows[i].inputRows; }),
+      makeColumn<int64_t>(
+          type->childAt(14),
+          size,
+          pool,
+          [&](auto i) { return rows[i].inputBytes; }),
+      makeColumn<int64_t>(
+          type->childAt(15),
+          size,
+          pool,
+          [&](auto i) { return rows[i].outputRows; }),
+      makeColumn<int64_t>(
+          type->childAt(16),
+          size,
+          pool,
+          [&](auto i) { return rows[i].outputBytes; }),
+  };
+  return std::make_shared<RowVector>(
+      pool, type, nullptr, size, std::move(columns));
+}
+
+} // namespace facebook::presto
@@ -0,0 +1,112 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "velox/common/memory/Memory.h"
+#include "velox/exec/Task.h"
+
+namespace facebook::presto {
+
+/// Records the stats of the completed tasks for offline analysis, one row
+/// per operator with the stats of its task, in the columns of rowType().
+/// The rows are buffered and written as a DWRF file into 'directory' on a
+/// background thread once 'rowsPerFile' rows are buffered or the oldest row
+/// has been buffered for 'flushInterval', so that the completing drivers only
+/// copy their stats. Only the newest 'maxFiles' files are kept.
+class TaskStatsLog : public velox::exec::TaskListener {
+ public:
+  TaskStatsLog(
+      std::string directory,
+      int32_t rowsPerFile,
+      int32_t maxFiles,
+      std::chrono::seconds flushInterval);
+
+  ~TaskStatsLog() override;
+
+  void onTaskCompletion(
+      const std::string& taskUuid,
+      const std::string& taskId,
+      velox::exec::TaskState state,
+      std::exception_ptr error,
+      velox::exec::TaskStats stats) override;
+
+  /// Writes the buffered rows into a new file. Returns once the rows taken by
+  /// the background thread before the call are written too.
+  void flush();
+
+  /// Returns the files written, from the oldest.
+  std::vector<std::string> files() const;
+
+  static const velox::RowTypePtr& rowType();
+
+ private:
+  struct Row {
+    std::string taskId;
+    std::string taskState;
+    int64_t taskEndMs;
+    int64_t taskWallMs;
+    int32_t pipelineId;
+    int32_t operatorId;
+    std::string planNodeId;
+    std::string operatorType;
+    int64_t cpuNanos;
+    int64_t wallNanos;
+    int64_t blockedWallNanos;
+    int64_t peakMemoryBytes;
+    int64_t spilledBytes;
+    int64_t inputRows;
+    int64_t inputBytes;
+    int64_t outputRows;
+    int64_t outputBytes;
+  };
+
+  // Writes the due batches on 'writer_' until destruction.
+  void writeLoop();
+
+  // Writes 'rows' into a new file and deletes the files over 'maxFiles_'.
+  // 'writeMutex_' is held.
+  void writeLocked(const std::vector<Row>& rows);
+
+  velox::RowVectorPtr makeVector(const std::vector<Row>& rows) const;
+
+  const std::string directory_;
+  const int32_t rowsPerFile_;
+  const int32_t maxFiles_;
+  const std::chrono::seconds flushInterval_;
+  const std::shared_ptr<velox::memory::MemoryPool> rootPool_;
+  const std::shared_ptr<velox::memory::MemoryPool> pool_;
+
+  // Serializes the writes, acquired before 'mutex_'.
+  std::mutex writeMutex_;
+  mutable std::mutex mutex_;
+  std::condition_variable rowsAdded_;
+  bool stopped_{false};
+  std::vector<Row> rows_;
+  // The time the oldest row of 'rows_' was added.
+  std::chrono::steady_clock::time_point oldestRowTime_;
+  // The files written, from the oldest.
+  std::deque<std::string> files_;
+  int64_t fileSequence_{0};
+  // Started last once the members above are initialized.
+  std::thread writer_;
+};
+
+} // namespace facebook::presto
@@ -0,0 +1,198 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/TaskUpdateCapture.h"
+#include <glog/logging.h>
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include "velox/common/base/Exceptions.h"
+#include "velox/common/time/Timer.h"
+
+#if __has_include("filesystem")
+#include <filesystem>
+namespace fs = std::filesystem;
+#else
+#include <experimental/filesystem>
+namespace fs = std::experimental::filesystem;
+#endif
+
+namespace facebook::presto {
+namespace {
+constexpr std::string_view kFilePrefix{"task_update_"};
+constexpr std::string_view kJsonSuffix{".json"};
+constexpr std::string_view kThriftSuffix{".thrift"};
+constexpr std::string_view kTempSuffix{".tmp"};
+
+// Orders the captures of the same millisecond. Process wide, so that the
+// captures of successive instances on the same directory sort in order.
+std::atomic<int64_t> fileSequence{0};
+
+bool endsWith(const std::string& name, std::string_view suffix) {
+  return name.size() > suffix.size() &&
+      name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+} // namespace
+
+TaskUpdateCapture::TaskUpdateCapture(std::string directory, int32_t maxFiles)
+    : directory_(std::move(directory)), maxFiles_(maxFiles) {
+  VELOX_USER_CHECK_GT(maxFiles_, 0);
+  if (fs::create_directories(directory_)) {
+    fs::permissions(directory_, fs::perms::owner_all);
+  }
+  for (const auto& entry : fs::directory_iterator(directory_)) {
+    const auto name = entry.path().filename().string();
+    if (name.rfind(kFilePrefix, 0) == 0 && endsWith(name, kTempSuffix)) {
+      // Left by a crash while writing.
+      std::error_code ec;
+      fs::remove(entry.path(), ec);
+    }
+  }
+  // The captures of the previous runs count toward 'maxFiles_'.
+  for (auto& update : list(directory_)) {
+    files_.push_back(std::move(update.path));
+  }
+}
+
+void TaskUpdateCapture::capture(
+    const protocol::TaskId& taskId,
+    const folly::IOBuf& body,
+    bool thrift) {
+  std::string content;
+  content.reserve(body.computeChainDataLength());
+  for (const auto& range : body) {
+    content.append(reinterpret_cast<const char*>(range.data()), range.size());
+  }
+  if (thrift) {
+    write(taskId, content, true);
+    return;
+  }
+  nlohmann::json update;
+  try {
+    update = nlohmann::json::parse(content);
+  } catch (const std::exception& e) {
+    LOG(WARNING) << "Dropped the update of " << taskId
+                 << ", not valid JSON: " << e.what();
+    return;
+  }
+  capture(taskId, std::move(update));
+}
+
+void TaskUpdateCapture::capture(
+    const protocol::TaskId& taskId,
+    nlohmann::json update) {
+  redactCredentials(update);
+  write(taskId, update.dump(), false);
+}
+
+// static
+void TaskUpdateCapture::redactCredentials(nlohmann::json& update) {
+  if (!update.is_object()) {
+    return;
+  }
+  if (update.contains("extraCredentials")) {
+    update["extraCredentials"] = nlohmann::json::object();
+  }
+  auto session = update.find("session");
+  if (session != update.end() && session->is_object()) {
+    session->erase("principal");
+  }
+}
+
+void TaskUpdateCapture::write(
+    const protocol::TaskId& taskId,
+    const std::string& content,
+    bool thrift) {
+  std::lock_guard<std::mutex> l(mutex_);
+  // The creation time comes first so that the names sort from the oldest.
+  const auto path = fmt::format(
+      "{}/{}{}_{:012}_{}{}",
+      directory_,
+      kFilePrefix,
+      velox::getCurrentTimeMs(),
+      fileSequence++,
+      taskId,
+      thrift ? kThriftSuffix : kJsonSuffix);
+  const auto tempPath = fmt::format("{}{}", path, kTempSuffix);
+  {
+    std::ofstream out(tempPath, std::ios::binary);
+    std::error_code ec;
+    // Restricted before any content is written.
+    fs::permissions(
+        tempPath, fs::perms::owner_read | fs::perms::owner_write, ec);
+    if (!ec) {
+      out.write(content.data(), content.size());
+    }
+    out.close();
+    if (ec || out.fail()) {
+      LOG(WARNING) << "Dropped the update of " << taskId
+                   << ", failed to write " << path;
+      fs::remove(tempPath, ec);
+      return;
+    }
+    fs::rename(tempPath, path, ec);
+    if (ec) {
+      LOG(WARNING) << "Dropped the update of " << taskId
+                   << ", failed to write " << path << ": " << ec.message();
+      fs::remove(tempPath, ec);
+      return;
+    }
+  }
+  files_.push_back(path);
+  while (files_.size() > static_cast<size_t>(maxFiles_)) {
+    std::error_code ec;
+    fs::remove(files_.front(), ec);
+    files_.pop_front();
+  }
+}
+
+std::vector<std::string> TaskUpdateCapture::files() const {
+  std::lock_guard<std::mutex> l(mutex_);
+  return {files_.begin(), files_.end()};
+}
+
+// static
+std::vector<TaskUpdateCapture::CapturedUpdate> TaskUpdateCapture::list(
+    const std::string& directory) {
+  std::vector<CapturedUpdate> updates;
+  for (const auto& entry : fs::directory_iterator(directory)) {
+    const auto name = entry.path().filename().string();
+    if (name.rfind(kFilePrefix, 0) != 0) {
+      continue;
+    }
+    const bool thrift = endsWith(name, kThriftSuffix);
+    if (!thrift && !endsWith(name, kJsonSuffix)) {
+      continue;
+    }
+    // Skips the creation time and the sequence number. The task id may
+    // contain '_' itself.
+    auto begin = name.find('_', kFilePrefix.size());
+    if (begin != std::string::npos) {
+      begin = name.find('_', begin + 1);
+    }
+    if (begin == std::string::npos) {
+      continue;
+    }
+    const auto suffixSize = thrift ? kThriftSuffix.size() : kJsonSuffix.size();
+    updates.push_back(
+        {entry.path().string(),
+         name.substr(begin + 1, name.size() - begin - 1 - suffixSize),
+         thrift});
+  }
+  std::sort(updates.begin(), updates.end(), [](const auto& a, const auto& b) {
+    return a.path < b.path;
+  });
+  return updates;
+}
+
+} // namespace facebook::presto
@@ -0,0 +1,81 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <folly/io/IOBuf.h>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "presto_cpp/external/json/json.hpp"
+#include "presto_cpp/presto_protocol/presto_protocol.h"
+
+namespace facebook::presto {
+
+/// Records the bodies of the task update requests for replay, e.g. to
+/// measure the task creation on real plans with presto_task_update_replay.
+/// Each body is written into its own file in 'directory', named after the
+/// capture order and the task id. Only the newest 'maxFiles' files are kept.
+///
+/// The updates carry the credentials of the query. The credentials of the
+/// JSON updates, i.e. 'extraCredentials' and the session principal, are
+/// redacted. The Thrift updates are written as is. All the files are only
+/// readable by the owner of the worker process.
+class TaskUpdateCapture {
+ public:
+  TaskUpdateCapture(std::string directory, int32_t maxFiles);
+
+  /// Writes the update 'body' of 'taskId'. 'thrift' tells if the body is
+  /// Thrift instead of JSON encoded. A failure to write is logged and drops
+  /// the body.
+  void capture(
+      const protocol::TaskId& taskId,
+      const folly::IOBuf& body,
+      bool thrift);
+
+  /// Writes the JSON 'update' of 'taskId', e.g. one task of a batch update
+  /// with the members shared by the tasks.
+  void capture(const protocol::TaskId& taskId, nlohmann::json update);
+
+  /// Removes the credentials from the JSON task update 'update'.
+  static void redactCredentials(nlohmann::json& update);
+
+  /// Returns the files written, from the oldest.
+  std::vector<std::string> files() const;
+
+  struct CapturedUpdate {
+    std::string path;
+    protocol::TaskId taskId;
+    bool thrift;
+  };
+
+  /// Returns the updates captured into 'directory', from the oldest.
+  static std::vector<CapturedUpdate> list(const std::string& directory);
+
+ private:
+  void write(
+      const protocol::TaskId& taskId,
+      const std::string& content,
+      bool thrift);
+
+  const std::string directory_;
+  const int32_t maxFiles_;
+
+  mutable std::mutex mutex_;
+  // The files written, from the oldest.
+  std::deque<std::string> files_;
+};
+
+} // namespace facebook::presto
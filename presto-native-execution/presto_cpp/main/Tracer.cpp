@@ -0,0 +1,178 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/Tracer.h"
+#include <folly/hash/Hash.h>
+#include "velox/common/base/Exceptions.h"
+#include "velox/common/time/Timer.h"
+
+namespace facebook::presto {
+namespace {
+// The query ids and span ids of the spans active on the thread, innermost
+// last. The innermost one of a query is the parent of the spans of that query
+// started on the thread.
+thread_local std::vector<std::pair<const std::string*, uint64_t>> activeSpans;
+
+std::string toQueryId(const std::string& taskId) {
+  return taskId.substr(0, taskId.find('.'));
+}
+
+// 32 hex digits as in the trace ids of OpenTelemetry.
+std::string traceId(const std::string& queryId) {
+  return fmt::format(
+      "{:016x}{:016x}",
+      folly::hash::fnv64(queryId),
+      std::hash<std::string>{}(queryId));
+}
+
+std::string spanId(uint64_t id) {
+  return fmt::format("{:016x}", id);
+}
+
+nlohmann::json stringAttribute(
+    const std::string& key,
+    const std::string& value) {
+  return {{"key", key}, {"value", {{"stringValue", value}}}};
+}
+} // namespace
+
+// static
+Tracer& Tracer::instance() {
+  static Tracer tracer;
+  return tracer;
+}
+
+void Tracer::configure(double sampleRate, size_t maxSpans) {
+  VELOX_USER_CHECK(
+      sampleRate >= 0 && sampleRate <= 1,
+      "The tracing sample rate must be between 0 and 1: {}",
+      sampleRate);
+  std::lock_guard<std::mutex> l(mutex_);
+  maxSpans_ = maxSpans;
+  spans_.clear();
+  spans_.reserve(maxSpans_);
+  nextSpan_ = 0;
+  sampleThreshold_ =
+      maxSpans_ == 0 ? 0 : static_cast<uint32_t>(sampleRate * kSampleScale);
+}
+
+bool Tracer::sampled(const std::string& taskId) const {
+  const auto threshold = sampleThreshold_.load(std::memory_order_relaxed);
+  if (threshold == 0) {
+    return false;
+  }
+  const auto queryIdSize = std::min(taskId.find('.'), taskId.size());
+  return folly::hash::fnv64_buf(taskId.data(), queryIdSize) % kSampleScale <
+      threshold;
+}
+
+std::optional<Tracer::Span> Tracer::startSpan(
+    const char* name,
+    const std::string& taskId) {
+  if (!sampled(taskId)) {
+    return std::nullopt;
+  }
+  auto queryId = toQueryId(taskId);
+  // A span of another trace, e.g. an exchange fetch for another query, is not
+  // a parent.
+  uint64_t parentSpanId{0};
+  for (auto it = activeSpans.rbegin(); it != activeSpans.rend(); ++it) {
+    if (*it->first == queryId) {
+      parentSpanId = it->second;
+      break;
+    }
+  }
+  return Span{
+      std::move(queryId),
+      taskId,
+      name,
+      nextSpanId_++,
+      parentSpanId,
+      velox::getCurrentTimeMicro()};
+}
+
+void Tracer::finishSpan(std::optional<Span> span) {
+  if (!span.has_value()) {
+    return;
+  }
+  span->endMicros = velox::getCurrentTimeMicro();
+  std::lock_guard<std::mutex> l(mutex_);
+  if (maxSpans_ == 0) {
+    return;
+  }
+  if (spans_.size() < maxSpans_) {
+    spans_.push_back(std::move(*span));
+  } else {
+    spans_[nextSpan_] = std::move(*span);
+    nextSpan_ = (nextSpan_ + 1) % maxSpans_;
+  }
+}
+
+std::vector<Tracer::Span> Tracer::spans(const std::string& queryId) const {
+  std::vector<Span> spans;
+  std::lock_guard<std::mutex> l(mutex_);
+  for (size_t i = 0; i < spans_.size(); ++i) {
+    // Oldest first.
+    const auto& span = spans_[(nextSpan_ + i) % spans_.size()];
+    if (queryId.empty() || span.queryId == queryId) {
+      spans.push_back(span);
+    }
+  }
+  return spans;
+}
+
+// static
+nlohmann::json Tracer::toOtlp(
+    const std::vector<Span>& spans,
+    const std::string& nodeId) {
+  nlohmann::json otlpSpans = nlohmann::json::array();
+  for (const auto& span : spans) {
+    nlohmann::json otlpSpan{
+        {"traceId", traceId(span.queryId)},
+        {"spanId", spanId(span.spanId)},
+        {"name", span.name},
+        {"startTimeUnixNano", std::to_string(span.startMicros * 1'000)},
+        {"endTimeUnixNano", std::to_string(span.endMicros * 1'000)},
+        {"attributes",
+         {stringAttribute("presto.query_id", span.queryId),
+          stringAttribute("presto.task_id", span.taskId)}}};
+    if (span.parentSpanId != 0) {
+      otlpSpan["parentSpanId"] = spanId(span.parentSpanId);
+    }
+    otlpSpans.push_back(std::move(otlpSpan));
+  }
+  return {
+      {"resourceSpans",
+       {{{"resource",
+          {{"attributes",
+            {stringAttribute("service.name", "presto-native-worker"),
+             stringAttribute("service.instance.id", nodeId)}}}},
+         {"scopeSpans",
+          {{{"scope", {{"name", "presto_cpp"}}}, {"spans", otlpSpans}}}}}}}};
+}
+
+TraceSpan::TraceSpan(const char* name, const std::string& taskId)
+    : span_(Tracer::instance().startSpan(name, taskId)) {
+  if (span_.has_value()) {
+    activeSpans.emplace_back(&span_->queryId, span_->spanId);
+  }
+}
+
+TraceSpan::~TraceSpan() {
+  if (span_.has_value()) {
+    activeSpans.pop_back();
+    Tracer::instance().finishSpan(std::move(span_));
+  }
+}
+
+} // namespace facebook::presto
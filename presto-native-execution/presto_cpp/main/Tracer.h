@@ -0,0 +1,105 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+#include "presto_cpp/external/json/json.hpp"
+
+namespace facebook::presto {
+
+/// Records sampled tracing spans of the hot paths of the worker in a ring
+/// buffer, to tell where the time of a query went on this worker. The spans
+/// of a query are all sampled or not, by a hash of the query id, so a sampled
+/// query is traced end to end. Checking whether a query is sampled is a single
+/// relaxed load while the tracing is disabled.
+class Tracer {
+ public:
+  struct Span {
+    /// The id of the query, the trace of the span.
+    std::string queryId;
+    std::string taskId;
+    std::string name;
+    uint64_t spanId;
+    /// 0 for a root span.
+    uint64_t parentSpanId;
+    uint64_t startMicros;
+    uint64_t endMicros{0};
+  };
+
+  static Tracer& instance();
+
+  /// Samples 'sampleRate' of the queries, between 0 (disabled) and 1, and
+  /// keeps their last 'maxSpans' spans.
+  void configure(double sampleRate, size_t maxSpans);
+
+  bool enabled() const {
+    return sampleThreshold_.load(std::memory_order_relaxed) > 0;
+  }
+
+  /// Returns true if the spans of the query of 'taskId' are recorded.
+  bool sampled(const std::string& taskId) const;
+
+  /// Starts a span of the task 'taskId' if its query is sampled. The span nests
+  /// in the innermost span of the same query active on the calling thread, if
+  /// any. Used for the spans that end on another thread.
+  std::optional<Span> startSpan(const char* name, const std::string& taskId);
+
+  /// Ends 'span' now and records it.
+  void finishSpan(std::optional<Span> span);
+
+  /// Returns the recorded spans of 'queryId', or all of them if it is empty.
+  std::vector<Span> spans(const std::string& queryId) const;
+
+  /// Returns 'spans' in the OTLP JSON format of OpenTelemetry, the service
+  /// being 'nodeId'.
+  static nlohmann::json toOtlp(
+      const std::vector<Span>& spans,
+      const std::string& nodeId);
+
+ private:
+  static constexpr uint32_t kSampleScale{1'000'000};
+
+  // The sampled queries hash below this, out of 'kSampleScale'.
+  std::atomic<uint32_t> sampleThreshold_{0};
+  std::atomic<uint64_t> nextSpanId_{1};
+
+  mutable std::mutex mutex_;
+  size_t maxSpans_{0};
+  // Ring buffer of the recorded spans, 'nextSpan_' is the oldest once full.
+  std::vector<Span> spans_;
+  size_t nextSpan_{0};
+};
+
+/// Records a span of the task 'taskId' from construction to destruction if
+/// its query is sampled. The spans of the query started on the thread
+/// meanwhile nest in it.
+class TraceSpan {
+ public:
+  TraceSpan(const char* name, const std::string& taskId);
+
+  ~TraceSpan();
+
+  TraceSpan(const TraceSpan&) = delete;
+  TraceSpan& operator=(const TraceSpan&) = delete;
+
+ private:
+  std::optional<Tracer::Span> span_;
+};
+
+} // namespace facebook::presto
@@ -0,0 +1,217 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <folly/Benchmark.h>
+#include <folly/io/IOBuf.h>
+
+#include "presto_cpp/main/PageCompression.h"
+#include "presto_cpp/presto_protocol/Base64Util.h"
+#include "velox/common/encode/Base64.h"
+#include "velox/exec/Exchange.h"
+#include "velox/vector/VectorStream.h"
+#include "velox/vector/tests/utils/VectorMaker.h"
+
+using namespace facebook::presto;
+using namespace facebook::velox;
+
+namespace {
+
+constexpr int32_t kNumRows = 10'000;
+// The size of the IOBufs a data response is received in.
+constexpr size_t kResponseChunkSize = 64 << 10;
+constexpr int32_t kNumBlockRows = 1'000;
+
+memory::MemoryPool* pool() {
+  static auto pool = memory::addDefaultLeafMemoryPool();
+  return pool.get();
+}
+
+RowVectorPtr makeVector() {
+  test::VectorMaker vectorMaker(pool());
+  return vectorMaker.rowVector({
+      vectorMaker.flatVector<int64_t>(kNumRows, [](auto row) { return row; }),
+      vectorMaker.flatVector<double>(
+          kNumRows, [](auto row) { return row * 0.1; }),
+      vectorMaker.flatVector<std::string>(
+          kNumRows, [](auto row) { return fmt::format("value-{}", row % 97); }),
+  });
+}
+
+// Returns 'vector' serialized as a Presto page.
+std::unique_ptr<folly::IOBuf> serializePage(const RowVectorPtr& vector) {
+  VectorStreamGroup group(pool());
+  group.createStreamTree(asRowType(vector->type()), vector->size());
+  const IndexRange range{0, vector->size()};
+  group.append(vector, folly::Range(&range, 1));
+  IOBufOutputStream stream(*pool());
+  group.flush(&stream);
+  return stream.getIOBuf();
+}
+
+// Splits 'pages' into the chunks a data response is received in.
+std::vector<std::unique_ptr<folly::IOBuf>> toResponseChunks(
+    const folly::IOBuf& pages) {
+  const auto data = pages.cloneCoalescedAsValue();
+  std::vector<std::unique_ptr<folly::IOBuf>> chunks;
+  for (size_t offset = 0; offset < data.length();
+       offset += kResponseChunkSize) {
+    chunks.push_back(folly::IOBuf::copyBuffer(
+        data.data() + offset,
+        std::min(kResponseChunkSize, data.length() - offset)));
+  }
+  return chunks;
+}
+
+// Chains the chunks of a data response into a page like PrestoExchangeSource
+// and deserializes it like the Exchange operator.
+size_t processResponse(
+    const std::vector<std::unique_ptr<folly::IOBuf>>& chunks,
+    const RowTypePtr& rowType) {
+  std::unique_ptr<folly::IOBuf> singleChain;
+  for (const auto& chunk : chunks) {
+    if (!singleChain) {
+      singleChain = chunk->clone();
+    } else {
+      singleChain->prev()->appendChain(chunk->clone());
+    }
+  }
+  exec::SerializedPage page(std::move(singleChain));
+  auto input = page.prepareStreamForDeserialize();
+  size_t numRows = 0;
+  while (!input.atEnd()) {
+    RowVectorPtr result;
+    VectorStreamGroup::read(&input, pool(), rowType, &result);
+    numRows += result->size();
+  }
+  return numRows;
+}
+
+template <typename T>
+void appendValue(std::string& block, T value) {
+  block.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+void appendHeader(std::string& block, std::string_view encoding) {
+  appendValue<int32_t>(block, encoding.size());
+  block.append(encoding);
+  appendValue<int32_t>(block, kNumBlockRows);
+}
+
+// Returns a base64 encoded Presto LONG_ARRAY block of 'kNumBlockRows' rows.
+std::string makeLongArrayBlock() {
+  std::string block;
+  appendHeader(block, "LONG_ARRAY");
+  // No nulls.
+  appendValue<bool>(block, false);
+  for (int64_t i = 0; i < kNumBlockRows; ++i) {
+    appendValue<int64_t>(block, i * 31);
+  }
+  return encoding::Base64::encode(block.data(), block.size());
+}
+
+// Returns a base64 encoded Presto VARIABLE_WIDTH block of 'kNumBlockRows'
+// rows.
+std::string makeVariableWidthBlock() {
+  std::string block;
+  appendHeader(block, "VARIABLE_WIDTH");
+  std::string values;
+  for (auto i = 0; i < kNumBlockRows; ++i) {
+    values.append(fmt::format("value-{}", i));
+    appendValue<int32_t>(block, values.size());
+  }
+  // No nulls.
+  appendValue<bool>(block, false);
+  appendValue<int32_t>(block, values.size());
+  block.append(values);
+  return encoding::Base64::encode(block.data(), block.size());
+}
+
+} // namespace
+
+BENCHMARK(exchangeResponse, iterations) {
+  RowTypePtr rowType;
+  std::vector<std::unique_ptr<folly::IOBuf>> chunks;
+  BENCHMARK_SUSPEND {
+    auto vector = makeVector();
+    rowType = asRowType(vector->type());
+    chunks = toResponseChunks(*serializePage(vector));
+  }
+  for (auto i = 0; i < iterations; ++i) {
+    folly::doNotOptimizeAway(processResponse(chunks, rowType));
+  }
+}
+
+void exchangeCompressedResponse(
+    uint32_t iterations,
+    common::CompressionKind codec) {
+  RowTypePtr rowType;
+  std::unique_ptr<folly::IOBuf> compressed;
+  uint64_t uncompressedSize;
+  BENCHMARK_SUSPEND {
+    auto vector = makeVector();
+    rowType = asRowType(vector->type());
+    auto pages = serializePage(vector);
+    uncompressedSize = pages->computeChainDataLength();
+    compressed = compressPages(*pages, codec);
+    VELOX_CHECK_NOT_NULL(compressed, "The pages do not compress");
+  }
+  for (auto i = 0; i < iterations; ++i) {
+    std::vector<std::unique_ptr<folly::IOBuf>> chunks;
+    chunks.push_back(uncompressPages(*compressed, codec, uncompressedSize));
+    folly::doNotOptimizeAway(processResponse(chunks, rowType));
+  }
+}
+
+BENCHMARK_NAMED_PARAM(
+    exchangeCompressedResponse,
+    lz4,
+    common::CompressionKind_LZ4);
+BENCHMARK_NAMED_PARAM(
+    exchangeCompressedResponse,
+    zstd,
+    common::CompressionKind_ZSTD);
+
+BENCHMARK(pageCompressionLz4, iterations) {
+  std::unique_ptr<folly::IOBuf> pages;
+  BENCHMARK_SUSPEND {
+    pages = serializePage(makeVector());
+  }
+  for (auto i = 0; i < iterations; ++i) {
+    folly::doNotOptimizeAway(
+        compressPages(*pages, common::CompressionKind_LZ4));
+  }
+}
+
+BENCHMARK_DRAW_LINE();
+
+BENCHMARK(readBlockLongArray, iterations) {
+  std::string block;
+  BENCHMARK_SUSPEND {
+    block = makeLongArrayBlock();
+  }
+  for (auto i = 0; i < iterations; ++i) {
+    folly::doNotOptimizeAway(protocol::readBlock(BIGINT(), block, pool()));
+  }
+}
+
+BENCHMARK(readBlockVariableWidth, iterations) {
+  std::string block;
+  BENCHMARK_SUSPEND {
+    block = makeVariableWidthBlock();
+  }
+  for (auto i = 0; i < iterations; ++i) {
+    folly::doNotOptimizeAway(protocol::readBlock(VARCHAR(), block, pool()));
+  }
+}
+
+BENCHMARK_DRAW_LINE();
@@ -0,0 +1,340 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <folly/Random.h>
+#include <folly/init/Init.h>
+#include <folly/io/async/EventBaseManager.h>
+#include <gflags/gflags.h>
+#include <proxygen/httpserver/ResponseBuilder.h>
+#include <iostream>
+
+#include "presto_cpp/main/PrestoExchangeSource.h"
+#include "presto_cpp/main/http/HttpServer.h"
+#include "presto_cpp/presto_protocol/presto_protocol.h"
+#include "velox/common/base/SuccinctPrinter.h"
+#include "velox/common/memory/Memory.h"
+#include "velox/common/time/Timer.h"
+#include "velox/exec/Exchange.h"
+#include "velox/serializers/PrestoSerializer.h"
+#include "velox/vector/FlatVector.h"
+
+DEFINE_int32(num_sources, 8, "Number of producer tasks the consumer reads");
+DEFINE_int32(num_pages, 200, "Number of pages per producer task");
+DEFINE_int32(
+    page_bytes,
+    1 << 20,
+    "Approximate size of each page in bytes, a page has one BIGINT column");
+DEFINE_int32(latency_ms, 0, "One way latency added to each data response");
+DEFINE_int64(
+    bandwidth_bytes_per_sec,
+    0,
+    "Capacity of the link shared by the data responses, 0 for unlimited");
+DEFINE_double(
+    loss_pct,
+    0,
+    "Percent of the data responses delayed by a retransmission timeout to "
+    "emulate packet loss");
+DEFINE_int32(
+    retransmit_ms,
+    200,
+    "Delay added to a data response hit by packet loss, the minimum TCP RTO "
+    "by default");
+DEFINE_int64(queue_bytes, 32 << 20, "Capacity of the exchange queue");
+DEFINE_bool(streaming, false, "Receive the data responses streaming");
+DEFINE_int32(ack_delay_ms, 0, "Delay of the acks of the pulled pages");
+
+using namespace facebook::presto;
+using namespace facebook::velox;
+
+// Runs producers and a consumer through HttpServer and PrestoExchangeSource
+// over loopback with injected latency, bandwidth caps and packet loss, and
+// reports the throughput, time to first page and exchange memory peak. Used
+// to evaluate the changes of the fetch protocol before deploying them.
+namespace {
+
+// Returns a PrestoPage of random BIGINTs of about 'FLAGS_page_bytes' so that
+// the consumer parses and verifies the same format as from a worker.
+std::string makePage(memory::MemoryPool* pool) {
+  const vector_size_t numRows =
+      std::max<vector_size_t>(1, FLAGS_page_bytes / sizeof(int64_t));
+  auto values =
+      BaseVector::create<FlatVector<int64_t>>(BIGINT(), numRows, pool);
+  for (auto i = 0; i < numRows; ++i) {
+    values->set(i, folly::Random::rand64());
+  }
+  auto rowType = ROW({"c0"}, {BIGINT()});
+  auto input = std::make_shared<RowVector>(
+      pool,
+      rowType,
+      nullptr,
+      numRows,
+      std::vector<VectorPtr>{std::move(values)});
+
+  serializer::presto::PrestoVectorSerde serde;
+  StreamArena arena(pool);
+  auto serializer = serde.createSerializer(rowType, numRows, &arena);
+  const IndexRange range{0, numRows};
+  serializer->append(input, folly::Range(&range, 1));
+  std::ostringstream out;
+  OStreamOutputStream stream(&out);
+  serializer->flush(&stream);
+  return out.str();
+}
+
+// Serves 'FLAGS_num_pages' pages per task from the results endpoints, as many
+// per response as fit in X-Presto-Max-Size and at least one like a worker.
+// The data responses are delayed on the event base as per the impairment
+// flags.
+class ImpairedProducer {
+ public:
+  explicit ImpairedProducer(memory::MemoryPool* pool)
+      : page_(makePage(pool)) {}
+
+  void registerEndpoints(http::HttpServer& server) {
+    server.registerGet(
+        R"(/v1/task/(.+)/results/([0-9]+)/([0-9]+)/acknowledge)",
+        [](proxygen::HTTPMessage* /*message*/,
+           const std::vector<std::string>& /*pathMatch*/) {
+          return new http::CallbackRequestHandler(
+              [](proxygen::HTTPMessage* /*message*/,
+                 const std::vector<std::unique_ptr<folly::IOBuf>>& /*body*/,
+                 proxygen::ResponseHandler* downstream) {
+                http::sendOkResponse(downstream);
+              });
+        });
+    server.registerGet(
+        R"(/v1/task/(.+)/results/([0-9]+)/([0-9]+))",
+        [this](
+            proxygen::HTTPMessage* message,
+            const std::vector<std::string>& pathMatch) {
+          const auto& headers = message->getHeaders();
+          const auto maxSize = protocol::DataSize(
+              headers.exists(protocol::PRESTO_MAX_SIZE_HTTP_HEADER)
+                  ? headers.getSingleOrEmpty(
+                        protocol::PRESTO_MAX_SIZE_HTTP_HEADER)
+                  : protocol::PRESTO_MAX_SIZE_DEFAULT);
+          return getResults(
+              pathMatch[1],
+              std::stol(pathMatch[3]),
+              maxSize.getValue(protocol::DataUnit::BYTE));
+        });
+    server.registerDelete(
+        R"(/v1/task/(.+)/results/([0-9]+))",
+        [](proxygen::HTTPMessage* /*message*/,
+           const std::vector<std::string>& /*pathMatch*/) {
+          return new http::CallbackRequestHandler(
+              [](proxygen::HTTPMessage* /*message*/,
+                 const std::vector<std::unique_ptr<folly::IOBuf>>& /*body*/,
+                 proxygen::ResponseHandler* downstream) {
+                http::sendOkResponse(downstream);
+              });
+        });
+  }
+
+ private:
+  proxygen::RequestHandler* getResults(
+      const protocol::TaskId& taskId,
+      int64_t token,
+      uint64_t maxBytes) {
+    const int64_t numPages = std::min<int64_t>(
+        std::max<int64_t>(0, FLAGS_num_pages - token),
+        std::max<uint64_t>(1, maxBytes / page_.size()));
+    return new http::CallbackRequestHandler(
+        [this, taskId, token, numPages](
+            proxygen::HTTPMessage* /*message*/,
+            const std::vector<std::unique_ptr<folly::IOBuf>>& /*body*/,
+            proxygen::ResponseHandler* downstream,
+            std::shared_ptr<http::CallbackRequestHandlerState> handlerState) {
+          const auto delayMs = responseDelayMs(numPages * page_.size());
+          auto send =
+              [this, taskId, token, numPages, downstream, handlerState]() {
+                if (!handlerState->requestExpired()) {
+                  sendResponse(downstream, taskId, token, numPages);
+                }
+              };
+          if (delayMs == 0) {
+            send();
+            return;
+          }
+          folly::EventBaseManager::get()->getEventBase()->runAfterDelay(
+              std::move(send), delayMs);
+        });
+  }
+
+  // Returns the delay of a data response of 'bytes' for the latency, the
+  // packet loss and the time to transmit it once the shared link is free.
+  uint32_t responseDelayMs(size_t bytes) {
+    uint64_t delayUs = FLAGS_latency_ms * 1'000;
+    if (FLAGS_loss_pct > 0 &&
+        folly::Random::randDouble01() * 100 < FLAGS_loss_pct) {
+      delayUs += FLAGS_retransmit_ms * 1'000;
+    }
+    if (FLAGS_bandwidth_bytes_per_sec > 0 && bytes > 0) {
+      const auto nowUs = getCurrentTimeMicro();
+      std::lock_guard<std::mutex> l(mutex_);
+      linkFreeUs_ = std::max(linkFreeUs_, nowUs) +
+          bytes * 1'000'000 / FLAGS_bandwidth_bytes_per_sec;
+      delayUs += linkFreeUs_ - nowUs;
+    }
+    return delayUs / 1'000;
+  }
+
+  void sendResponse(
+      proxygen::ResponseHandler* downstream,
+      const protocol::TaskId& taskId,
+      int64_t token,
+      int64_t numPages) {
+    const bool complete = numPages == 0;
+    proxygen::ResponseBuilder builder(downstream);
+    builder.status(http::kHttpOk, "OK")
+        .header(protocol::PRESTO_TASK_INSTANCE_ID_HEADER, taskId)
+        .header(protocol::PRESTO_PAGE_TOKEN_HEADER, std::to_string(token))
+        .header(
+            protocol::PRESTO_PAGE_NEXT_TOKEN_HEADER,
+            std::to_string(token + numPages))
+        .header(
+            protocol::PRESTO_BUFFER_COMPLETE_HEADER,
+            complete ? "true" : "false");
+    if (!complete) {
+      auto body = folly::IOBuf::create(numPages * page_.size());
+      for (auto i = 0; i < numPages; ++i) {
+        memcpy(body->writableTail(), page_.data(), page_.size());
+        body->append(page_.size());
+      }
+      builder
+          .header(
+              proxygen::HTTP_HEADER_CONTENT_TYPE,
+              protocol::PRESTO_PAGES_MIME_TYPE)
+          .body(std::move(body));
+    }
+    builder.sendWithEOM();
+  }
+
+  const std::string page_;
+  std::mutex mutex_;
+  // The time in us at which the link finishes transmitting the responses
+  // sent so far.
+  uint64_t linkFreeUs_{0};
+};
+
+struct ExchangeResult {
+  uint64_t bytes{0};
+  uint64_t numPages{0};
+  uint64_t firstPageUs{0};
+  uint64_t elapsedUs{0};
+};
+
+// Reads all the pages of the producer at 'address' with one
+// PrestoExchangeSource per task into one exchange queue like the Exchange
+// operator.
+ExchangeResult runConsumer(
+    const folly::SocketAddress& address,
+    memory::MemoryPool* pool) {
+  auto queue = std::make_shared<exec::ExchangeQueue>(FLAGS_queue_bytes);
+  std::vector<std::shared_ptr<PrestoExchangeSource>> sources;
+  for (auto i = 0; i < FLAGS_num_sources; ++i) {
+    queue->addSourceLocked();
+  }
+  queue->noMoreSources();
+
+  ExchangeResult result;
+  const auto startUs = getCurrentTimeMicro();
+  for (auto i = 0; i < FLAGS_num_sources; ++i) {
+    sources.push_back(std::make_shared<PrestoExchangeSource>(
+        folly::Uri(fmt::format(
+            "http://{}:{}/v1/task/bench.0.0.{}/results/0",
+            address.getAddressStr(),
+            address.getPort(),
+            i)),
+        0,
+        queue,
+        pool,
+        FLAGS_streaming,
+        false,
+        "",
+        std::chrono::milliseconds(FLAGS_ack_delay_ms)));
+  }
+  for (;;) {
+    std::vector<std::shared_ptr<PrestoExchangeSource>> toRequest;
+    {
+      std::lock_guard<std::mutex> l(queue->mutex());
+      for (auto& source : sources) {
+        if (source->shouldRequestLocked()) {
+          toRequest.push_back(source);
+        }
+      }
+    }
+    for (auto& source : toRequest) {
+      source->request();
+    }
+
+    bool atEnd;
+    ContinueFuture future;
+    auto page = queue->dequeueLocked(&atEnd, &future);
+    if (atEnd) {
+      break;
+    }
+    if (page == nullptr) {
+      std::move(future).wait();
+      continue;
+    }
+    if (result.numPages++ == 0) {
+      result.firstPageUs = getCurrentTimeMicro() - startUs;
+    }
+    result.bytes += page->size();
+  }
+  result.elapsedUs = getCurrentTimeMicro() - startUs;
+  for (auto& source : sources) {
+    source->close();
+  }
+  return result;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  folly::init(&argc, &argv);
+  auto pool = memory::addDefaultLeafMemoryPool("ExchangeNetworkBenchmark");
+
+  ImpairedProducer producer(pool.get());
+  auto server = std::make_unique<http::HttpServer>(
+      std::make_unique<http::HttpConfig>(folly::SocketAddress("127.0.0.1", 0)));
+  producer.registerEndpoints(*server);
+  folly::Promise<folly::SocketAddress> started;
+  auto startedFuture = started.getSemiFuture();
+  std::thread serverThread([&]() {
+    server->start({}, [&](proxygen::HTTPServer* httpServer) {
+      started.setValue(httpServer->addresses()[0].address);
+    });
+  });
+
+  const auto result = runConsumer(std::move(startedFuture).get(), pool.get());
+  int64_t currentBytes;
+  int64_t peakBytes;
+  PrestoExchangeSource::getMemoryUsage(currentBytes, peakBytes);
+  const auto elapsedSecs = std::max<double>(result.elapsedUs, 1) / 1'000'000;
+  std::cout << "Pages: " << result.numPages << " of "
+            << succinctBytes(result.bytes) << " in "
+            << succinctMicros(result.elapsedUs) << std::endl
+            << "Throughput: " << succinctBytes(result.bytes / elapsedSecs)
+            << "/s, " << static_cast<uint64_t>(result.numPages / elapsedSecs)
+            << " pages/s" << std::endl
+            << "Time to first page: " << succinctMicros(result.firstPageUs)
+            << std::endl
+            << "Exchange memory peak: " << succinctBytes(peakBytes)
+            << std::endl;
+
+  server->stop();
+  serverThread.join();
+  return 0;
+}
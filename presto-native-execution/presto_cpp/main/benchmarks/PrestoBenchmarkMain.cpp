@@ -0,0 +1,39 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <folly/Benchmark.h>
+#include <folly/init/Init.h>
+#include <gflags/gflags.h>
+
+#include "presto_cpp/main/operators/PartitionAndSerialize.h"
+#include "presto_cpp/presto_protocol/Connectors.h"
+#include "velox/common/file/FileSystems.h"
+#include "velox/serializers/PrestoSerializer.h"
+
+using namespace facebook;
+
+// Microbenchmarks of the hot paths of the worker which are not covered by the
+// Velox benchmarks: the protocol serde and the plan conversion of the task
+// updates, the shuffle and the exchange pages. Runs from the
+// presto-native-execution directory to find the plan fragments, see
+// --plan_data_dir.
+int main(int argc, char** argv) {
+  folly::init(&argc, &argv);
+  velox::filesystems::registerLocalFileSystem();
+  velox::serializer::presto::PrestoVectorSerde::registerVectorSerde();
+  velox::exec::Operator::registerOperator(
+      std::make_unique<presto::operators::PartitionAndSerializeTranslator>());
+  presto::protocol::registerConnector("hive", "hive");
+  folly::runBenchmarks();
+  return 0;
+}
@@ -0,0 +1,141 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <folly/Benchmark.h>
+#include <gflags/gflags.h>
+#include <re2/re2.h>
+
+#include "presto_cpp/main/common/tests/test_json.h"
+#include "presto_cpp/main/types/PrestoToVeloxQueryPlan.h"
+#include "presto_cpp/presto_protocol/presto_protocol.h"
+#include "velox/common/encode/Base64.h"
+
+DEFINE_string(
+    plan_data_dir,
+    "presto_cpp/main/types/tests/data",
+    "Directory of the plan fragment JSON files");
+
+using namespace facebook::presto;
+using namespace facebook::velox;
+
+namespace {
+
+std::string readPlanFragment(const std::string& fileName) {
+  const auto path = FLAGS_plan_data_dir + "/" + fileName;
+  auto fragment = slurp(path);
+  VELOX_CHECK(!fragment.empty(), "Could not read the plan fragment {}", path);
+  return fragment;
+}
+
+// Returns the JSON of a task update request carrying the plan fragment of
+// 'fileName' the way the coordinator sends it, base64 encoded.
+std::string makeTaskUpdateRequestJson(const std::string& fileName) {
+  const auto fragment = readPlanFragment(fileName);
+  protocol::TaskUpdateRequest request;
+  request.fragment = std::make_shared<std::string>(
+      encoding::Base64::encode(fragment.data(), fragment.size()));
+  json j = request;
+  return j.dump();
+}
+
+void taskUpdateRequestFromJson(uint32_t iterations, const std::string& file) {
+  std::string updateJson;
+  BENCHMARK_SUSPEND {
+    updateJson = makeTaskUpdateRequestJson(file);
+  }
+  for (auto i = 0; i < iterations; ++i) {
+    protocol::TaskUpdateRequest request = json::parse(updateJson);
+    protocol::PlanFragment fragment =
+        json::parse(encoding::Base64::decode(*request.fragment));
+    folly::doNotOptimizeAway(fragment);
+  }
+}
+
+void taskUpdateRequestToJson(uint32_t iterations, const std::string& file) {
+  protocol::TaskUpdateRequest request;
+  protocol::PlanFragment fragment;
+  BENCHMARK_SUSPEND {
+    request = json::parse(makeTaskUpdateRequestJson(file));
+    fragment = json::parse(readPlanFragment(file));
+  }
+  for (auto i = 0; i < iterations; ++i) {
+    json fragmentJson = fragment;
+    json requestJson = request;
+    folly::doNotOptimizeAway(fragmentJson.dump());
+    folly::doNotOptimizeAway(requestJson.dump());
+  }
+}
+
+void toVeloxQueryPlan(uint32_t iterations, const std::string& file) {
+  protocol::PlanFragment fragment;
+  std::shared_ptr<memory::MemoryPool> pool;
+  BENCHMARK_SUSPEND {
+    fragment = json::parse(readPlanFragment(file));
+    pool = memory::addDefaultLeafMemoryPool();
+  }
+  for (auto i = 0; i < iterations; ++i) {
+    VeloxInteractiveQueryPlanConverter converter(pool.get());
+    auto plan = converter.toVeloxQueryPlan(
+        fragment, nullptr, "20201107_130540_00011_wrpkw.1.2.3");
+    folly::doNotOptimizeAway(plan);
+  }
+}
+
+// Parses 'input' with the regex DataSize and Duration used before their
+// hand-written parser, as the baseline.
+void valueAndUnitRe2(uint32_t iterations, const std::string& input) {
+  static const RE2 kPattern(R"(^\s*(\d+(?:\.\d+)?)\s*([a-zA-Z]+)\s*$)");
+  for (auto i = 0; i < iterations; ++i) {
+    double value;
+    std::string unit;
+    folly::doNotOptimizeAway(RE2::FullMatch(input, kPattern, &value, &unit));
+    folly::doNotOptimizeAway(value);
+  }
+}
+
+void dataSize(uint32_t iterations, const std::string& input) {
+  for (auto i = 0; i < iterations; ++i) {
+    folly::doNotOptimizeAway(protocol::DataSize(input));
+  }
+}
+
+void duration(uint32_t iterations, const std::string& input) {
+  for (auto i = 0; i < iterations; ++i) {
+    folly::doNotOptimizeAway(protocol::Duration(input));
+  }
+}
+
+} // namespace
+
+BENCHMARK_NAMED_PARAM(valueAndUnitRe2, maxSize, "32MB");
+BENCHMARK_RELATIVE_NAMED_PARAM(dataSize, maxSize, "32MB");
+BENCHMARK_NAMED_PARAM(valueAndUnitRe2, maxWait, "1.00s");
+BENCHMARK_RELATIVE_NAMED_PARAM(duration, maxWait, "1.00s");
+BENCHMARK_NAMED_PARAM(valueAndUnitRe2, spaced, " 1.5 GB ");
+BENCHMARK_RELATIVE_NAMED_PARAM(dataSize, spaced, " 1.5 GB ");
+
+BENCHMARK_DRAW_LINE();
+
+BENCHMARK_NAMED_PARAM(taskUpdateRequestFromJson, scanAgg, "ScanAgg.json");
+BENCHMARK_NAMED_PARAM(taskUpdateRequestFromJson, finalAgg, "FinalAgg.json");
+BENCHMARK_NAMED_PARAM(taskUpdateRequestToJson, scanAgg, "ScanAgg.json");
+BENCHMARK_NAMED_PARAM(taskUpdateRequestToJson, finalAgg, "FinalAgg.json");
+
+BENCHMARK_DRAW_LINE();
+
+BENCHMARK_NAMED_PARAM(toVeloxQueryPlan, scanAgg, "ScanAgg.json");
+BENCHMARK_NAMED_PARAM(toVeloxQueryPlan, finalAgg, "FinalAgg.json");
+BENCHMARK_NAMED_PARAM(toVeloxQueryPlan, output, "Output.json");
+BENCHMARK_NAMED_PARAM(toVeloxQueryPlan, offsetLimit, "OffsetLimit.json");
+
+BENCHMARK_DRAW_LINE();
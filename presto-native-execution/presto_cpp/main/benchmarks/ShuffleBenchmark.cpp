@@ -0,0 +1,217 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <folly/Benchmark.h>
+
+#include "presto_cpp/main/operators/LocalPersistentShuffle.h"
+#include "presto_cpp/main/operators/PartitionAndSerialize.h"
+#include "velox/connectors/hive/HivePartitionFunction.h"
+#include "velox/exec/tests/utils/Cursor.h"
+#include "velox/exec/tests/utils/PlanBuilder.h"
+#include "velox/exec/tests/utils/TempDirectoryPath.h"
+#include "velox/vector/tests/utils/VectorMaker.h"
+
+using namespace facebook::presto;
+using namespace facebook::presto::operators;
+using namespace facebook::velox;
+
+namespace {
+
+constexpr uint32_t kNumPartitions = 16;
+constexpr uint32_t kNumRows = 100'000;
+constexpr uint32_t kRowSize = 100;
+constexpr uint64_t kMaxBytesPerPartition = 1 << 20;
+
+class HivePartitionFunctionSpec : public core::PartitionFunctionSpec {
+ public:
+  explicit HivePartitionFunctionSpec(const std::vector<column_index_t>& keys)
+      : keys_{keys} {}
+
+  std::unique_ptr<core::PartitionFunction> create(
+      int numPartitions) const override {
+    return std::make_unique<connector::hive::HivePartitionFunction>(
+        numPartitions, std::vector<int>(numPartitions), keys_);
+  }
+
+  std::string toString() const override {
+    return fmt::format("HIVE({})", folly::join(", ", keys_));
+  }
+
+  folly::dynamic serialize() const override {
+    VELOX_UNSUPPORTED();
+  }
+
+ private:
+  const std::vector<column_index_t> keys_;
+};
+
+memory::MemoryPool* pool() {
+  static auto pool = memory::addDefaultLeafMemoryPool();
+  return pool.get();
+}
+
+// Returns 10 batches of 'kNumRows' / 10 rows of an integer, a bigint and a
+// varchar column.
+std::vector<RowVectorPtr> makeInput() {
+  test::VectorMaker vectorMaker(pool());
+  std::vector<RowVectorPtr> batches;
+  const auto batchSize = kNumRows / 10;
+  for (auto i = 0; i < 10; ++i) {
+    batches.push_back(vectorMaker.rowVector({
+        vectorMaker.flatVector<int32_t>(
+            batchSize, [&](auto row) { return i * batchSize + row; }),
+        vectorMaker.flatVector<int64_t>(
+            batchSize, [](auto row) { return row * 7; }),
+        vectorMaker.flatVector<std::string>(
+            batchSize,
+            [](auto row) { return std::string(10 + row % 50, 'x'); }),
+    }));
+  }
+  return batches;
+}
+
+void partitionAndSerialize(uint32_t iterations, ShuffleSerdeFormat format) {
+  core::PlanNodePtr plan;
+  BENCHMARK_SUSPEND {
+    plan = exec::test::PlanBuilder()
+               .values(makeInput())
+               .addNode([format](
+                            core::PlanNodeId nodeId,
+                            core::PlanNodePtr source) -> core::PlanNodePtr {
+                 std::vector<core::TypedExprPtr> keys{
+                     std::make_shared<core::FieldAccessTypedExpr>(
+                         INTEGER(), "c0")};
+                 const auto channels =
+                     exec::toChannels(source->outputType(), keys);
+                 return std::make_shared<PartitionAndSerializeNode>(
+                     nodeId,
+                     keys,
+                     kNumPartitions,
+                     ROW({"p", "d"}, {INTEGER(), VARBINARY()}),
+                     std::move(source),
+                     std::make_shared<HivePartitionFunctionSpec>(channels),
+                     format);
+               })
+               .planNode();
+  }
+  for (auto i = 0; i < iterations; ++i) {
+    exec::test::CursorParameters params;
+    params.planNode = plan;
+    auto [cursor, results] =
+        exec::test::readCursor(params, [](exec::Task* /*task*/) {});
+    folly::doNotOptimizeAway(results);
+  }
+}
+
+// The rows and partitions written to the local shuffle.
+struct ShuffleRows {
+  std::vector<std::string> rows;
+  std::vector<StringView> rowViews;
+  std::vector<int32_t> partitions;
+};
+
+const ShuffleRows& shuffleRows() {
+  static const ShuffleRows shuffleRows = []() {
+    ShuffleRows result;
+    result.rows.reserve(kNumRows);
+    for (auto i = 0; i < kNumRows; ++i) {
+      result.rows.push_back(std::string(kRowSize, 'a' + i % 26));
+      result.partitions.push_back(i % kNumPartitions);
+    }
+    for (const auto& row : result.rows) {
+      result.rowViews.push_back(StringView(row));
+    }
+    return result;
+  }();
+  return shuffleRows;
+}
+
+void writeShuffle(const std::string& rootPath) {
+  const auto& input = shuffleRows();
+  LocalPersistentShuffleWriter writer(
+      rootPath, "query_id", 0, kNumPartitions, kMaxBytesPerPartition, pool());
+  constexpr size_t kBatchSize = 1'000;
+  for (size_t begin = 0; begin < kNumRows; begin += kBatchSize) {
+    const auto size = std::min<size_t>(kBatchSize, kNumRows - begin);
+    writer.collect(
+        folly::Range(input.partitions.data() + begin, size),
+        folly::Range(input.rowViews.data() + begin, size));
+  }
+  writer.noMoreData(true);
+}
+
+uint64_t readShuffle(const std::string& rootPath, bool useMmap) {
+  uint64_t bytes = 0;
+  for (auto partition = 0; partition < kNumPartitions; ++partition) {
+    LocalPersistentShuffleReader reader(
+        rootPath,
+        "query_id",
+        {fmt::format("shuffle_0_0_{}", partition)},
+        partition,
+        pool(),
+        nullptr,
+        0,
+        0,
+        useMmap);
+    while (reader.hasNext()) {
+      bytes += reader.next(true)->size();
+    }
+  }
+  return bytes;
+}
+
+} // namespace
+
+BENCHMARK_NAMED_PARAM(
+    partitionAndSerialize,
+    unsafeRow,
+    ShuffleSerdeFormat::kUnsafeRow);
+BENCHMARK_NAMED_PARAM(
+    partitionAndSerialize,
+    presto,
+    ShuffleSerdeFormat::kPresto);
+
+BENCHMARK_DRAW_LINE();
+
+BENCHMARK(localShuffleWrite, iterations) {
+  for (auto i = 0; i < iterations; ++i) {
+    std::shared_ptr<exec::test::TempDirectoryPath> directory;
+    BENCHMARK_SUSPEND {
+      directory = exec::test::TempDirectoryPath::create();
+      shuffleRows();
+    }
+    writeShuffle(directory->path);
+    BENCHMARK_SUSPEND {
+      directory.reset();
+    }
+  }
+}
+
+void localShuffleRead(uint32_t iterations, bool useMmap) {
+  std::shared_ptr<exec::test::TempDirectoryPath> directory;
+  BENCHMARK_SUSPEND {
+    directory = exec::test::TempDirectoryPath::create();
+    writeShuffle(directory->path);
+  }
+  for (auto i = 0; i < iterations; ++i) {
+    folly::doNotOptimizeAway(readShuffle(directory->path, useMmap));
+  }
+  BENCHMARK_SUSPEND {
+    directory.reset();
+  }
+}
+
+BENCHMARK_NAMED_PARAM(localShuffleRead, copy, false);
+BENCHMARK_NAMED_PARAM(localShuffleRead, mmap, true);
+
+BENCHMARK_DRAW_LINE();
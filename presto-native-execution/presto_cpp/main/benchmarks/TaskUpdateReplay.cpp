@@ -0,0 +1,312 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <folly/FileUtil.h>
+#include <folly/init/Init.h>
+#include <gflags/gflags.h>
+#include <sys/resource.h>
+#include <iostream>
+#include <thread>
+
+#include "presto_cpp/main/PrestoExchangeSource.h"
+#include "presto_cpp/main/TaskResource.h"
+#include "presto_cpp/main/TaskUpdateCapture.h"
+#include "presto_cpp/main/http/HttpClient.h"
+#include "presto_cpp/main/http/HttpServer.h"
+#include "presto_cpp/main/types/PrestoToVeloxQueryPlan.h"
+#include "presto_cpp/presto_protocol/Base64Util.h"
+#include "presto_cpp/presto_protocol/Connectors.h"
+#include "velox/common/base/SuccinctPrinter.h"
+#include "velox/common/file/FileSystems.h"
+#include "velox/common/time/Timer.h"
+#include "velox/connectors/hive/HiveConnector.h"
+#include "velox/dwio/dwrf/reader/DwrfReader.h"
+#include "velox/functions/prestosql/aggregates/RegisterAggregateFunctions.h"
+#include "velox/functions/prestosql/registration/RegistrationFunctions.h"
+#include "velox/parse/TypeResolver.h"
+#include "velox/serializers/PrestoSerializer.h"
+
+DEFINE_string(
+    capture_dir,
+    "",
+    "Directory of the task updates captured with "
+    "task-update-capture.directory");
+DEFINE_string(
+    worker,
+    "",
+    "host:port of the worker to replay the updates against. Empty replays "
+    "them against a TaskManager in this process");
+DEFINE_string(
+    hive_catalogs,
+    "hive",
+    "Comma separated catalogs to register Hive connectors for when replaying "
+    "in this process");
+DEFINE_int32(concurrency, 8, "Number of updates in flight");
+DEFINE_int32(iterations, 1, "Number of times each update is replayed");
+DEFINE_int32(timeout_ms, 60'000, "Timeout of each request");
+
+using namespace facebook::presto;
+using namespace facebook::velox;
+
+// Replays the task update requests captured from a worker against a
+// TaskManager in this process or a standalone worker, and reports the task
+// creation latency, the plan conversion time and the memory, so that the
+// task update path can be measured on real plans. Each replayed task gets its
+// own query id and is aborted right after its creation.
+namespace {
+
+struct ReplayStats {
+  std::mutex mutex;
+  std::vector<uint64_t> latenciesUs;
+  uint64_t numFailed{0};
+};
+
+// Returns 'taskId' with 'suffix' appended to its query id.
+std::string replayTaskId(const std::string& taskId, const std::string& suffix) {
+  const auto dot = taskId.find('.');
+  if (dot == std::string::npos) {
+    return taskId + suffix;
+  }
+  return taskId.substr(0, dot) + suffix + taskId.substr(dot);
+}
+
+uint64_t percentile(const std::vector<uint64_t>& sorted, double pct) {
+  if (sorted.empty()) {
+    return 0;
+  }
+  return sorted[std::min<size_t>(
+      sorted.size() - 1, static_cast<size_t>(sorted.size() * pct / 100))];
+}
+
+void registerInProcessWorker() {
+  functions::prestosql::registerAllScalarFunctions();
+  aggregate::prestosql::registerAllAggregateFunctions();
+  parse::registerTypeResolver();
+  exec::ExchangeSource::registerFactory(
+      PrestoExchangeSource::createExchangeSource);
+  serializer::presto::PrestoVectorSerde::registerVectorSerde();
+  filesystems::registerLocalFileSystem();
+  dwrf::registerDwrfReaderFactory();
+  protocol::registerHiveConnectors();
+  std::vector<std::string> catalogs;
+  folly::split(',', FLAGS_hive_catalogs, catalogs, true);
+  for (const auto& catalog : catalogs) {
+    connector::registerConnector(
+        connector::getConnectorFactory(
+            connector::hive::HiveConnectorFactory::kHiveConnectorName)
+            ->newConnector(catalog, nullptr));
+  }
+}
+
+// Parses the captured JSON updates and converts their plans the way
+// TaskResource does, without creating the tasks.
+void measurePlanConversion(
+    const std::vector<TaskUpdateCapture::CapturedUpdate>& updates) {
+  auto pool = memory::addDefaultLeafMemoryPool("TaskUpdateReplay");
+  uint64_t parseUs{0};
+  uint64_t convertUs{0};
+  int32_t numPlans{0};
+  int32_t numFailed{0};
+  for (const auto& update : updates) {
+    if (update.thrift) {
+      continue;
+    }
+    std::string body;
+    VELOX_CHECK(folly::readFile(update.path.c_str(), body), update.path);
+    try {
+      protocol::TaskUpdateRequest request;
+      protocol::PlanFragment fragment;
+      {
+        MicrosecondTimer timer(&parseUs);
+        request = json::parse(body);
+        if (request.fragment == nullptr) {
+          continue;
+        }
+        fragment = json::parse(protocol::decodeBase64(*request.fragment));
+      }
+      MicrosecondTimer timer(&convertUs);
+      VeloxInteractiveQueryPlanConverter converter(pool.get());
+      converter.toVeloxQueryPlan(
+          fragment, request.tableWriteInfo, update.taskId);
+      ++numPlans;
+    } catch (const std::exception& e) {
+      LOG(WARNING) << "Failed to convert " << update.path << ": " << e.what();
+      ++numFailed;
+    }
+  }
+  std::cout << "Plans: " << numPlans << " converted, " << numFailed
+            << " failed" << std::endl;
+  if (numPlans > 0) {
+    std::cout << "Parse per plan: " << succinctMicros(parseUs / numPlans)
+              << ", conversion per plan: "
+              << succinctMicros(convertUs / numPlans) << std::endl;
+  }
+}
+
+// Sends the update of 'update' as 'taskId', then aborts the task. Records the
+// latency of the update.
+void replayUpdate(
+    http::HttpClientPool& clients,
+    const folly::SocketAddress& address,
+    memory::MemoryPool* pool,
+    const TaskUpdateCapture::CapturedUpdate& update,
+    const std::string& body,
+    const std::string& taskId,
+    ReplayStats& stats) {
+  auto client = clients.getClient(address);
+  const auto startUs = getCurrentTimeMicro();
+  bool ok = false;
+  try {
+    // 'body' is sent to all the tasks, so it is wrapped instead of copied. It
+    // outlives the request, which is waited for.
+    auto response =
+        http::RequestBuilder()
+            .method(proxygen::HTTPMethod::POST)
+            .url(fmt::format("/v1/task/{}", taskId))
+            .header(
+                proxygen::HTTP_HEADER_ACCEPT, http::kMimeTypeApplicationJson)
+            .header(
+                proxygen::HTTP_HEADER_CONTENT_TYPE,
+                update.thrift ? http::kMimeTypeApplicationThrift
+                              : http::kMimeTypeApplicationJson)
+            .send(
+                client.get(),
+                pool,
+                folly::IOBuf::wrapBuffer(body.data(), body.size()))
+            .get();
+    ok = response->headers()->getStatusCode() == http::kHttpOk &&
+        !response->hasError();
+  } catch (const std::exception& e) {
+    LOG(WARNING) << "Failed to create " << taskId << ": " << e.what();
+  }
+  const auto latencyUs = getCurrentTimeMicro() - startUs;
+  {
+    std::lock_guard<std::mutex> l(stats.mutex);
+    stats.latenciesUs.push_back(latencyUs);
+    stats.numFailed += ok ? 0 : 1;
+  }
+  try {
+    http::RequestBuilder()
+        .method(proxygen::HTTPMethod::DELETE)
+        .url(fmt::format("/v1/task/{}?abort=true", taskId))
+        .send(client.get(), pool)
+        .get();
+  } catch (const std::exception& e) {
+    LOG(WARNING) << "Failed to abort " << taskId << ": " << e.what();
+  }
+}
+
+void replay(
+    const folly::SocketAddress& address,
+    const std::vector<TaskUpdateCapture::CapturedUpdate>& updates) {
+  std::vector<std::string> bodies;
+  for (const auto& update : updates) {
+    bodies.emplace_back();
+    VELOX_CHECK(folly::readFile(update.path.c_str(), bodies.back()));
+  }
+  auto pool = memory::addDefaultLeafMemoryPool("TaskUpdateReplayClient");
+  http::HttpClientPool clients(
+      1, std::chrono::milliseconds(FLAGS_timeout_ms), FLAGS_concurrency);
+  ReplayStats stats;
+  std::atomic<int64_t> next{0};
+  const int64_t numUpdates = updates.size() * FLAGS_iterations;
+  const auto startUs = getCurrentTimeMicro();
+  std::vector<std::thread> threads;
+  for (auto i = 0; i < FLAGS_concurrency; ++i) {
+    threads.emplace_back([&]() {
+      for (auto n = next++; n < numUpdates; n = next++) {
+        const auto index = n % updates.size();
+        replayUpdate(
+            clients,
+            address,
+            pool.get(),
+            updates[index],
+            bodies[index],
+            replayTaskId(
+                updates[index].taskId, fmt::format("_replay{}", n)),
+            stats);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  const auto elapsedUs = getCurrentTimeMicro() - startUs;
+
+  auto& latencies = stats.latenciesUs;
+  std::sort(latencies.begin(), latencies.end());
+  std::cout << "Updates: " << latencies.size() << ", failed "
+            << stats.numFailed << ", in " << succinctMicros(elapsedUs)
+            << std::endl
+            << "Throughput: "
+            << static_cast<uint64_t>(
+                   latencies.size() * 1'000'000.0 /
+                   std::max<uint64_t>(elapsedUs, 1))
+            << " updates/s" << std::endl
+            << "Creation latency p50: "
+            << succinctMicros(percentile(latencies, 50))
+            << ", p90: " << succinctMicros(percentile(latencies, 90))
+            << ", p99: " << succinctMicros(percentile(latencies, 99))
+            << ", max: "
+            << succinctMicros(latencies.empty() ? 0 : latencies.back())
+            << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  folly::init(&argc, &argv);
+  VELOX_USER_CHECK(!FLAGS_capture_dir.empty(), "--capture_dir is required");
+  VELOX_USER_CHECK_GT(FLAGS_concurrency, 0);
+  const auto updates = TaskUpdateCapture::list(FLAGS_capture_dir);
+  VELOX_USER_CHECK(
+      !updates.empty(), "No task updates in {}", FLAGS_capture_dir);
+  std::cout << "Captured updates: " << updates.size() << std::endl;
+
+  if (!FLAGS_worker.empty()) {
+    protocol::registerHiveConnectors();
+    measurePlanConversion(updates);
+    folly::SocketAddress address;
+    address.setFromHostPort(FLAGS_worker);
+    replay(address, updates);
+    return 0;
+  }
+
+  registerInProcessWorker();
+  measurePlanConversion(updates);
+  TaskManager taskManager;
+  TaskResource taskResource(taskManager);
+  auto server = std::make_unique<http::HttpServer>(
+      std::make_unique<http::HttpConfig>(folly::SocketAddress("127.0.0.1", 0)));
+  taskResource.registerUris(*server);
+  folly::Promise<folly::SocketAddress> started;
+  auto startedFuture = started.getSemiFuture();
+  std::thread serverThread([&]() {
+    server->start({}, [&](proxygen::HTTPServer* httpServer) {
+      started.setValue(httpServer->addresses()[0].address);
+    });
+  });
+  const auto address = std::move(startedFuture).get();
+  taskManager.setBaseUri(fmt::format(
+      "http://{}:{}", address.getAddressStr(), address.getPort()));
+
+  replay(address, updates);
+
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  std::cout << "Peak RSS: " << succinctBytes(usage.ru_maxrss * 1024)
+            << std::endl;
+  server->stop();
+  serverThread.join();
+  return 0;
+}
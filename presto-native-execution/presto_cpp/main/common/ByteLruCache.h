@@ -0,0 +1,114 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <unordered_map>
+
+namespace facebook::presto {
+
+/// A least recently used cache bounded by the sum of the sizes in bytes of
+/// its values, which the caller gives as it adds them. Not thread-safe: the
+/// caches built on it lock around their calls.
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class ByteLruCache {
+ public:
+  /// Holds up to 'maxBytes' of values.
+  explicit ByteLruCache(uint64_t maxBytes) : maxBytes_(maxBytes) {}
+
+  uint64_t maxBytes() const {
+    return maxBytes_;
+  }
+
+  /// Returns the value of 'key' and makes it the most recently used, or null
+  /// if missing.
+  Value* get(const Key& key) {
+    auto it = entries_.find(key);
+    if (it == entries_.end()) {
+      return nullptr;
+    }
+    lru_.splice(lru_.begin(), lru_, it->second.lruPosition);
+    return &it->second.value;
+  }
+
+  /// Caches 'value' of 'bytes' for 'key' in place of its value if any,
+  /// evicting the least recently used values until it fits. Returns false and
+  /// caches nothing if 'bytes' is over the max bytes.
+  bool put(const Key& key, Value value, uint64_t bytes) {
+    if (bytes > maxBytes_) {
+      return false;
+    }
+    erase(key);
+    while (!lru_.empty() && bytes_ + bytes > maxBytes_) {
+      erase(lru_.back());
+    }
+    lru_.push_front(key);
+    entries_.emplace(key, Entry{std::move(value), bytes, lru_.begin()});
+    bytes_ += bytes;
+    return true;
+  }
+
+  /// Removes the value of 'key' if any.
+  void erase(const Key& key) {
+    auto it = entries_.find(key);
+    if (it != entries_.end()) {
+      eraseEntry(it);
+    }
+  }
+
+  /// Removes the values for which 'predicate(key, value)' is true.
+  template <typename Predicate>
+  void eraseIf(Predicate predicate) {
+    for (auto it = entries_.begin(); it != entries_.end();) {
+      if (predicate(it->first, it->second.value)) {
+        it = eraseEntry(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  size_t size() const {
+    return entries_.size();
+  }
+
+  uint64_t bytes() const {
+    return bytes_;
+  }
+
+ private:
+  struct Entry {
+    Value value;
+    uint64_t bytes;
+    typename std::list<Key>::iterator lruPosition;
+  };
+
+  using EntryMap = std::unordered_map<Key, Entry, Hash>;
+
+  typename EntryMap::iterator eraseEntry(typename EntryMap::iterator it) {
+    bytes_ -= it->second.bytes;
+    lru_.erase(it->second.lruPosition);
+    return entries_.erase(it);
+  }
+
+  const uint64_t maxBytes_;
+  EntryMap entries_;
+  // The keys of the cached values, the most recently used first.
+  std::list<Key> lru_;
+  uint64_t bytes_{0};
+};
+
+} // namespace facebook::presto
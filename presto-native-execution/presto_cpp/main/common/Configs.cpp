@@ -13,6 +13,9 @@
  */
 
 #include "presto_cpp/main/common/Configs.h"
+#include <folly/String.h>
+#include <glog/logging.h>
+#include <unordered_set>
 #include "presto_cpp/main/common/ConfigReader.h"
 
 #if __has_include("filesystem")
@@ -29,17 +32,91 @@ ConfigBase::ConfigBase()
     : config_(std::make_unique<velox::core::MemConfig>()) {}
 
 void ConfigBase::initialize(const std::string& filePath) {
-  config_ = std::make_unique<velox::core::MemConfig>(
+  *config_.wlock() = std::make_unique<velox::core::MemConfig>(
       util::readConfig(fs::path(filePath)));
   filePath_ = filePath;
 }
 
+std::unordered_map<std::string, std::string> ConfigBase::update(
+    const std::unordered_map<std::string, std::string>& updates) {
+  for (const auto& [name, value] : updates) {
+    VELOX_USER_CHECK(
+        isMutable(name), "Property '{}' cannot be changed at runtime", name);
+  }
+  std::unordered_map<std::string, std::string> previous;
+  auto config = config_.wlock();
+  auto values = (*config)->values();
+  for (const auto& [name, value] : updates) {
+    auto it = values.find(name);
+    if (it == values.end()) {
+      if (!value.empty()) {
+        previous.emplace(name, "");
+        values.emplace(name, value);
+      }
+    } else if (value.empty()) {
+      previous.emplace(name, it->second);
+      values.erase(it);
+    } else if (it->second != value) {
+      previous.emplace(name, it->second);
+      it->second = value;
+    }
+  }
+  if (!previous.empty()) {
+    *config = std::make_unique<velox::core::MemConfig>(std::move(values));
+  }
+  for (const auto& [name, value] : previous) {
+    LOG(INFO) << "Config " << filePath_ << ": " << name << " changed from '"
+              << value << "' to '" << updates.at(name) << "'";
+  }
+  return previous;
+}
+
+std::unordered_map<std::string, std::string> ConfigBase::reload() {
+  VELOX_CHECK(!filePath_.empty(), "The config was not read from a file");
+  const auto fileValues = util::readConfig(fs::path(filePath_));
+  const auto current = values();
+  std::unordered_map<std::string, std::string> updates;
+  auto addIfChanged = [&](const std::string& name, const std::string& value) {
+    auto it = current.find(name);
+    const auto& oldValue = it == current.end() ? "" : it->second;
+    if (oldValue == value) {
+      return;
+    }
+    if (isMutable(name)) {
+      updates.emplace(name, value);
+    } else {
+      LOG(WARNING) << "Config " << filePath_ << ": " << name
+                   << " takes effect on restart";
+    }
+  };
+  for (const auto& [name, value] : fileValues) {
+    addIfChanged(name, value);
+  }
+  for (const auto& [name, value] : current) {
+    if (fileValues.count(name) == 0) {
+      addIfChanged(name, "");
+    }
+  }
+  return update(updates);
+}
+
 SystemConfig* SystemConfig::instance() {
   static std::unique_ptr<SystemConfig> instance =
       std::make_unique<SystemConfig>();
   return instance.get();
 }
 
+bool SystemConfig::isMutable(const std::string& propertyName) const {
+  static const std::unordered_set<std::string_view> kMutableProperties{
+      kHttpExecThreads,
+      kMaxDriversPerTask,
+      kHttpMaxAllocateBytes,
+      kExchangeMaxRecycledBufferBytes,
+      kLocalShuffleMaxPartitionBytes,
+  };
+  return kMutableProperties.count(propertyName) > 0;
+}
+
 int SystemConfig::httpServerHttpPort() const {
   return requiredProperty<int>(std::string(kHttpServerHttpPort));
 }
@@ -58,6 +135,11 @@ bool SystemConfig::enableHttps() const {
   return opt.value_or(kHttpServerHttpsEnabledDefault);
 }
 
+bool SystemConfig::enableHttp2() const {
+  auto opt = optionalProperty<bool>(std::string(kHttpServerHttp2Enabled));
+  return opt.value_or(kHttpServerHttp2EnabledDefault);
+}
+
 std::string SystemConfig::httpsSupportedCiphers() const {
   auto opt = optionalProperty<std::string>(std::string(kHttpsSupportedCiphers));
   return opt.value_or(std::string(kHttpsSupportedCiphersDefault));
@@ -92,27 +174,90 @@ int32_t SystemConfig::maxDriversPerTask() const {
   return opt.value_or(kMaxDriversPerTaskDefault);
 }
 
+bool SystemConfig::adaptiveDriversPerTask() const {
+  auto opt = optionalProperty<bool>(std::string(kAdaptiveDriversPerTask));
+  return opt.value_or(kAdaptiveDriversPerTaskDefault);
+}
+
+int32_t SystemConfig::minDriversPerTask() const {
+  auto opt = optionalProperty<int32_t>(std::string(kMinDriversPerTask));
+  return std::min(opt.value_or(kMinDriversPerTaskDefault), maxDriversPerTask());
+}
+
 int32_t SystemConfig::concurrentLifespansPerTask() const {
   auto opt =
       optionalProperty<int32_t>(std::string(kConcurrentLifespansPerTask));
   return opt.value_or(kConcurrentLifespansPerTaskDefault);
 }
 
+bool SystemConfig::adaptiveConcurrentLifespans() const {
+  auto opt = optionalProperty<bool>(std::string(kAdaptiveConcurrentLifespans));
+  return opt.value_or(kAdaptiveConcurrentLifespansDefault);
+}
+
+int32_t SystemConfig::minConcurrentLifespansPerTask() const {
+  auto opt =
+      optionalProperty<int32_t>(std::string(kMinConcurrentLifespansPerTask));
+  return opt.value_or(kMinConcurrentLifespansPerTaskDefault);
+}
+
 int32_t SystemConfig::httpExecThreads() const {
   auto opt = optionalProperty<int32_t>(std::string(kHttpExecThreads));
   return opt.value_or(kHttpExecThreadsDefault);
 }
 
+int32_t SystemConfig::httpCpuThreads() const {
+  auto opt = optionalProperty<int32_t>(std::string(kHttpCpuThreads));
+  return opt.value_or(kHttpCpuThreadsDefault);
+}
+
+int32_t SystemConfig::httpServerNumAcceptorGroups() const {
+  auto opt =
+      optionalProperty<int32_t>(std::string(kHttpServerNumAcceptorGroups));
+  return opt.value_or(kHttpServerNumAcceptorGroupsDefault);
+}
+
+bool SystemConfig::httpServerPinAcceptorGroups() const {
+  auto opt = optionalProperty<bool>(std::string(kHttpServerPinAcceptorGroups));
+  return opt.value_or(kHttpServerPinAcceptorGroupsDefault);
+}
+
 int32_t SystemConfig::numIoThreads() const {
   auto opt = optionalProperty<int32_t>(std::string(kNumIoThreads));
   return opt.value_or(kNumIoThreadsDefault);
 }
 
+bool SystemConfig::storageCoalesceReads() const {
+  auto opt = optionalProperty<bool>(std::string(kStorageCoalesceReads));
+  return opt.value_or(kStorageCoalesceReadsDefault);
+}
+
+uint64_t SystemConfig::storageParallelReadBytes() const {
+  auto opt = optionalProperty<uint64_t>(std::string(kStorageParallelReadBytes));
+  return opt.value_or(kStorageParallelReadBytesDefault);
+}
+
+int32_t SystemConfig::storageNumParallelReadThreads() const {
+  auto opt =
+      optionalProperty<int32_t>(std::string(kStorageNumParallelReadThreads));
+  return opt.value_or(kStorageNumParallelReadThreadsDefault);
+}
+
 int32_t SystemConfig::numQueryThreads() const {
   auto opt = optionalProperty<int32_t>(std::string(kNumQueryThreads));
   return opt.value_or(std::thread::hardware_concurrency() * 4);
 }
 
+bool SystemConfig::numaAwareDriverExecutor() const {
+  auto opt = optionalProperty<bool>(std::string(kNumaAwareDriverExecutor));
+  return opt.value_or(kNumaAwareDriverExecutorDefault);
+}
+
+bool SystemConfig::fairDriverScheduler() const {
+  auto opt = optionalProperty<bool>(std::string(kFairDriverScheduler));
+  return opt.value_or(kFairDriverSchedulerDefault);
+}
+
 int32_t SystemConfig::numSpillThreads() const {
   auto opt = optionalProperty<int32_t>(std::string(kNumSpillThreads));
   return opt.hasValue() ? opt.value() : std::thread::hardware_concurrency();
@@ -123,11 +268,83 @@ std::string SystemConfig::spillerSpillPath() const {
   return opt.hasValue() ? opt.value() : "";
 }
 
+std::vector<std::string> SystemConfig::spillerSpillPaths() const {
+  std::vector<std::string> paths;
+  folly::split(',', spillerSpillPath(), paths, true);
+  for (auto& path : paths) {
+    path = folly::trimWhitespace(path).str();
+  }
+  return paths;
+}
+
+std::string SystemConfig::spillerSpillPathPolicy() const {
+  auto opt =
+      optionalProperty<std::string>(std::string(kSpillerSpillPathPolicy));
+  return opt.value_or(std::string(kSpillerSpillPathPolicyDefault));
+}
+
+uint64_t SystemConfig::spillerSpillPathMinFreeGb() const {
+  auto opt =
+      optionalProperty<uint64_t>(std::string(kSpillerSpillPathMinFreeGb));
+  return opt.value_or(kSpillerSpillPathMinFreeGbDefault);
+}
+
+int32_t SystemConfig::spillCleanupIntervalSec() const {
+  auto opt = optionalProperty<int32_t>(std::string(kSpillCleanupIntervalSec));
+  return opt.value_or(kSpillCleanupIntervalSecDefault);
+}
+
+uint64_t SystemConfig::maxSpillPerNodeGb() const {
+  auto opt = optionalProperty<uint64_t>(std::string(kMaxSpillPerNodeGb));
+  return opt.value_or(kMaxSpillPerNodeGbDefault);
+}
+
+uint64_t SystemConfig::queryMaxSpillPerNodeGb() const {
+  auto opt = optionalProperty<uint64_t>(std::string(kQueryMaxSpillPerNodeGb));
+  return opt.value_or(kQueryMaxSpillPerNodeGbDefault);
+}
+
+bool SystemConfig::spillOnMemoryPressure() const {
+  auto opt = optionalProperty<bool>(std::string(kSpillOnMemoryPressure));
+  return opt.value_or(kSpillOnMemoryPressureDefault);
+}
+
+int32_t SystemConfig::tableCacheStatsMaxTables() const {
+  auto opt = optionalProperty<int32_t>(std::string(kTableCacheStatsMaxTables));
+  return opt.value_or(kTableCacheStatsMaxTablesDefault);
+}
+
+double SystemConfig::tracingSampleRate() const {
+  auto opt = optionalProperty<double>(std::string(kTracingSampleRate));
+  return opt.value_or(kTracingSampleRateDefault);
+}
+
+int32_t SystemConfig::tracingMaxSpans() const {
+  auto opt = optionalProperty<int32_t>(std::string(kTracingMaxSpans));
+  return opt.value_or(kTracingMaxSpansDefault);
+}
+
 int32_t SystemConfig::shutdownOnsetSec() const {
   auto opt = optionalProperty<int32_t>(std::string(kShutdownOnsetSec));
   return opt.value_or(kShutdownOnsetSecDefault);
 }
 
+int32_t SystemConfig::configReloadIntervalSec() const {
+  auto opt = optionalProperty<int32_t>(std::string(kConfigReloadIntervalSec));
+  return opt.value_or(kConfigReloadIntervalSecDefault);
+}
+
+uint64_t SystemConfig::announcementMaxBackoffMs() const {
+  auto opt =
+      optionalProperty<uint64_t>(std::string(kAnnouncementMaxBackoffMs));
+  return opt.value_or(kAnnouncementMaxBackoffMsDefault);
+}
+
+bool SystemConfig::announcementLoadInfo() const {
+  auto opt = optionalProperty<bool>(std::string(kAnnouncementLoadInfo));
+  return opt.value_or(kAnnouncementLoadInfoDefault);
+}
+
 int32_t SystemConfig::systemMemoryGb() const {
   auto opt = optionalProperty<int32_t>(std::string(kSystemMemoryGb));
   return opt.value_or(kSystemMemoryGbDefault);
@@ -144,22 +361,152 @@ uint64_t SystemConfig::asyncCacheSsdCheckpointGb() const {
   return opt.value_or(kAsyncCacheSsdCheckpointGbDefault);
 }
 
+bool SystemConfig::asyncCacheProactiveShrinkEnabled() const {
+  auto opt =
+      optionalProperty<bool>(std::string(kAsyncCacheProactiveShrinkEnabled));
+  return opt.value_or(kAsyncCacheProactiveShrinkEnabledDefault);
+}
+
+uint64_t SystemConfig::asyncCacheFloorGb() const {
+  auto opt = optionalProperty<uint64_t>(std::string(kAsyncCacheFloorGb));
+  return opt.value_or(kAsyncCacheFloorGbDefault);
+}
+
+uint64_t SystemConfig::asyncCacheCeilingGb() const {
+  auto opt = optionalProperty<uint64_t>(std::string(kAsyncCacheCeilingGb));
+  return opt.value_or(kAsyncCacheCeilingGbDefault);
+}
+
+int32_t SystemConfig::asyncCacheWarmerThreads() const {
+  auto opt = optionalProperty<int32_t>(std::string(kAsyncCacheWarmerThreads));
+  return opt.value_or(kAsyncCacheWarmerThreadsDefault);
+}
+
+int32_t SystemConfig::asyncCacheMaxPinnedPct() const {
+  auto opt = optionalProperty<int32_t>(std::string(kAsyncCacheMaxPinnedPct));
+  return opt.value_or(kAsyncCacheMaxPinnedPctDefault);
+}
+
+int32_t SystemConfig::memoryTrimIntervalSec() const {
+  auto opt = optionalProperty<int32_t>(std::string(kMemoryTrimIntervalSec));
+  return opt.value_or(kMemoryTrimIntervalSecDefault);
+}
+
 uint64_t SystemConfig::localShuffleMaxPartitionBytes() const {
   auto opt =
       optionalProperty<uint32_t>(std::string(kLocalShuffleMaxPartitionBytes));
   return opt.value_or(kLocalShuffleMaxPartitionBytesDefault);
 }
 
+int32_t SystemConfig::localShuffleNumWriteThreads() const {
+  auto opt =
+      optionalProperty<int32_t>(std::string(kLocalShuffleNumWriteThreads));
+  return opt.value_or(kLocalShuffleNumWriteThreadsDefault);
+}
+
+uint64_t SystemConfig::localShuffleMaxInFlightWriteBytes() const {
+  auto opt = optionalProperty<uint64_t>(
+      std::string(kLocalShuffleMaxInFlightWriteBytes));
+  return opt.value_or(kLocalShuffleMaxInFlightWriteBytesDefault);
+}
+
+int32_t SystemConfig::localShuffleNumReadThreads() const {
+  auto opt =
+      optionalProperty<int32_t>(std::string(kLocalShuffleNumReadThreads));
+  return opt.value_or(kLocalShuffleNumReadThreadsDefault);
+}
+
+uint32_t SystemConfig::localShuffleMaxPrefetchBlocks() const {
+  auto opt =
+      optionalProperty<uint32_t>(std::string(kLocalShuffleMaxPrefetchBlocks));
+  return opt.value_or(kLocalShuffleMaxPrefetchBlocksDefault);
+}
+
+uint64_t SystemConfig::localShuffleMaxPrefetchBytes() const {
+  auto opt =
+      optionalProperty<uint64_t>(std::string(kLocalShuffleMaxPrefetchBytes));
+  return opt.value_or(kLocalShuffleMaxPrefetchBytesDefault);
+}
+
+bool SystemConfig::localShuffleReadMmap() const {
+  auto opt = optionalProperty<bool>(std::string(kLocalShuffleReadMmap));
+  return opt.value_or(kLocalShuffleReadMmapDefault);
+}
+
+uint64_t SystemConfig::localShuffleMemoryStoreBytes() const {
+  auto opt =
+      optionalProperty<uint64_t>(std::string(kLocalShuffleMemoryStoreBytes));
+  return opt.value_or(kLocalShuffleMemoryStoreBytesDefault);
+}
+
+int32_t SystemConfig::shuffleNumExchangeReadThreads() const {
+  auto opt =
+      optionalProperty<int32_t>(std::string(kShuffleNumExchangeReadThreads));
+  return opt.value_or(kShuffleNumExchangeReadThreadsDefault);
+}
+
 std::string SystemConfig::asyncCacheSsdPath() const {
   auto opt = optionalProperty<std::string>(std::string(kAsyncCacheSsdPath));
   return opt.hasValue() ? opt.value() : std::string(kAsyncCacheSsdPathDefault);
 }
 
+std::vector<std::string> SystemConfig::asyncCacheSsdPaths() const {
+  std::vector<std::string> paths;
+  folly::split(',', asyncCacheSsdPath(), paths, true);
+  for (auto& path : paths) {
+    path = folly::trimWhitespace(path).str();
+  }
+  return paths;
+}
+
+int32_t SystemConfig::asyncCacheSsdShards() const {
+  auto opt = optionalProperty<int32_t>(std::string(kAsyncCacheSsdShards));
+  return opt.value_or(kAsyncCacheSsdShardsDefault);
+}
+
+int32_t SystemConfig::asyncCacheSsdIoThreads() const {
+  auto opt = optionalProperty<int32_t>(std::string(kAsyncCacheSsdIoThreads));
+  return opt.value_or(kAsyncCacheSsdIoThreadsDefault);
+}
+
+bool SystemConfig::asyncCacheSsdAdmissionEnabled() const {
+  auto opt =
+      optionalProperty<bool>(std::string(kAsyncCacheSsdAdmissionEnabled));
+  return opt.value_or(kAsyncCacheSsdAdmissionEnabledDefault);
+}
+
+int32_t SystemConfig::asyncCacheSsdAdmissionDecayPct() const {
+  auto opt =
+      optionalProperty<int32_t>(std::string(kAsyncCacheSsdAdmissionDecayPct));
+  return opt.value_or(kAsyncCacheSsdAdmissionDecayPctDefault);
+}
+
 std::string SystemConfig::shuffleName() const {
   auto opt = optionalProperty<std::string>(std::string(kShuffleName));
   return opt.hasValue() ? opt.value() : std::string(kShuffleNameDefault);
 }
 
+std::string SystemConfig::shuffleSerdeFormat() const {
+  auto opt = optionalProperty<std::string>(std::string(kShuffleSerdeFormat));
+  return opt.hasValue() ? opt.value()
+                        : std::string(kShuffleSerdeFormatDefault);
+}
+
+bool SystemConfig::shuffleSortByPartitionKeys() const {
+  auto opt = optionalProperty<bool>(std::string(kShuffleSortByPartitionKeys));
+  return opt.value_or(kShuffleSortByPartitionKeysDefault);
+}
+
+bool SystemConfig::shuffleFusePartitionAndWrite() const {
+  auto opt = optionalProperty<bool>(std::string(kShuffleFusePartitionAndWrite));
+  return opt.value_or(kShuffleFusePartitionAndWriteDefault);
+}
+
+bool SystemConfig::shuffleXxh3HashPartitioning() const {
+  auto opt = optionalProperty<bool>(std::string(kShuffleXxh3HashPartitioning));
+  return opt.value_or(kShuffleXxh3HashPartitioningDefault);
+}
+
 bool SystemConfig::enableSerializedPageChecksum() const {
   auto opt = optionalProperty<bool>(std::string(kEnableSerializedPageChecksum));
   return opt.value_or(kEnableSerializedPageChecksumDefault);
@@ -190,11 +537,38 @@ bool SystemConfig::useMmapAllocator() const {
   return opt.value_or(kUseMmapAllocatorDefault);
 }
 
+bool SystemConfig::mmapAllocatorHugePages() const {
+  auto opt = optionalProperty<bool>(std::string(kMmapAllocatorHugePages));
+  return opt.value_or(kMmapAllocatorHugePagesDefault);
+}
+
 bool SystemConfig::enableHttpAccessLog() const {
   auto opt = optionalProperty<bool>(std::string(kHttpEnableAccessLog));
   return opt.value_or(kHttpEnableAccessLogDefault);
 }
 
+double SystemConfig::httpAccessLogSampleRate() const {
+  auto opt = optionalProperty<double>(std::string(kHttpAccessLogSampleRate));
+  return opt.value_or(kHttpAccessLogSampleRateDefault);
+}
+
+std::string SystemConfig::httpAccessLogEndpointSampleRates() const {
+  auto opt = optionalProperty<std::string>(
+      std::string(kHttpAccessLogEndpointSampleRates));
+  return opt.value_or("");
+}
+
+int64_t SystemConfig::httpAccessLogSlowRequestMs() const {
+  auto opt =
+      optionalProperty<int64_t>(std::string(kHttpAccessLogSlowRequestMs));
+  return opt.value_or(kHttpAccessLogSlowRequestMsDefault);
+}
+
+std::string SystemConfig::httpAccessLogPath() const {
+  auto opt = optionalProperty<std::string>(std::string(kHttpAccessLogPath));
+  return opt.value_or("");
+}
+
 bool SystemConfig::enableHttpStatsFilter() const {
   auto opt = optionalProperty<bool>(std::string(kHttpEnableStatFilter));
   return opt.value_or(kHttpEnableStatsFilterDefault);
@@ -210,6 +584,295 @@ uint64_t SystemConfig::httpMaxAllocateBytes() const {
   return opt.value_or(kHttpMaxAllocateBytesDefault);
 }
 
+bool SystemConfig::exchangeEnableStreaming() const {
+  auto opt = optionalProperty<bool>(std::string(kExchangeEnableStreaming));
+  return opt.value_or(kExchangeEnableStreamingDefault);
+}
+
+uint64_t SystemConfig::exchangeMaxResponseBytes() const {
+  auto opt = optionalProperty<uint64_t>(std::string(kExchangeMaxResponseBytes));
+  return opt.value_or(kExchangeMaxResponseBytesDefault);
+}
+
+bool SystemConfig::exchangeAdaptiveResponseSize() const {
+  auto opt = optionalProperty<bool>(std::string(kExchangeAdaptiveResponseSize));
+  return opt.value_or(kExchangeAdaptiveResponseSizeDefault);
+}
+
+uint64_t SystemConfig::exchangeMinResponseBytes() const {
+  auto opt = optionalProperty<uint64_t>(std::string(kExchangeMinResponseBytes));
+  return opt.value_or(kExchangeMinResponseBytesDefault);
+}
+
+uint64_t SystemConfig::exchangeNodeMaxQueuedBytes() const {
+  auto opt =
+      optionalProperty<uint64_t>(std::string(kExchangeNodeMaxQueuedBytes));
+  return opt.value_or(kExchangeNodeMaxQueuedBytesDefault);
+}
+
+std::string SystemConfig::exchangeSpillPath() const {
+  auto opt = optionalProperty<std::string>(std::string(kExchangeSpillPath));
+  return opt.hasValue() ? opt.value() : "";
+}
+
+uint64_t SystemConfig::exchangeSpillMaxBytesPerSource() const {
+  auto opt = optionalProperty<uint64_t>(
+      std::string(kExchangeSpillMaxBytesPerSource));
+  return opt.value_or(kExchangeSpillMaxBytesPerSourceDefault);
+}
+
+uint64_t SystemConfig::exchangeSpillMaxBytesPerNode() const {
+  auto opt =
+      optionalProperty<uint64_t>(std::string(kExchangeSpillMaxBytesPerNode));
+  return opt.value_or(kExchangeSpillMaxBytesPerNodeDefault);
+}
+
+int32_t SystemConfig::exchangeMinPrefetchedPages() const {
+  auto opt =
+      optionalProperty<int32_t>(std::string(kExchangeMinPrefetchedPages));
+  return opt.value_or(kExchangeMinPrefetchedPagesDefault);
+}
+
+std::string SystemConfig::outputBufferSpillPath() const {
+  auto opt = optionalProperty<std::string>(std::string(kOutputBufferSpillPath));
+  return opt.hasValue() ? opt.value() : "";
+}
+
+double SystemConfig::outputBufferSpillMemoryPct() const {
+  auto opt =
+      optionalProperty<double>(std::string(kOutputBufferSpillMemoryPct));
+  return opt.value_or(kOutputBufferSpillMemoryPctDefault);
+}
+
+uint64_t SystemConfig::outputBufferSpillMinIdleMs() const {
+  auto opt =
+      optionalProperty<uint64_t>(std::string(kOutputBufferSpillMinIdleMs));
+  return opt.value_or(kOutputBufferSpillMinIdleMsDefault);
+}
+
+uint64_t SystemConfig::outputBufferSpillMaxBytesPerDestination() const {
+  auto opt = optionalProperty<uint64_t>(
+      std::string(kOutputBufferSpillMaxBytesPerDestination));
+  return opt.value_or(kOutputBufferSpillMaxBytesPerDestinationDefault);
+}
+
+int32_t SystemConfig::exchangeHttpClientNumIoThreads() const {
+  auto opt = optionalProperty<int32_t>(
+      std::string(kExchangeHttpClientNumIoThreads));
+  return opt.value_or(kExchangeHttpClientNumIoThreadsDefault);
+}
+
+int32_t SystemConfig::exchangeNumResponseThreads() const {
+  auto opt =
+      optionalProperty<int32_t>(std::string(kExchangeNumResponseThreads));
+  return opt.value_or(kExchangeNumResponseThreadsDefault);
+}
+
+double SystemConfig::exchangeHedgePercentile() const {
+  auto opt = optionalProperty<double>(std::string(kExchangeHedgePercentile));
+  return opt.value_or(kExchangeHedgePercentileDefault);
+}
+
+uint64_t SystemConfig::exchangeHedgeMinDelayMs() const {
+  auto opt = optionalProperty<uint64_t>(std::string(kExchangeHedgeMinDelayMs));
+  return opt.value_or(kExchangeHedgeMinDelayMsDefault);
+}
+
+int32_t SystemConfig::exchangeHttpClientMaxIdleSessions() const {
+  auto opt = optionalProperty<int32_t>(
+      std::string(kExchangeHttpClientMaxIdleSessions));
+  return opt.value_or(kExchangeHttpClientMaxIdleSessionsDefault);
+}
+
+uint64_t SystemConfig::exchangeMaxRecycledBufferBytes() const {
+  auto opt = optionalProperty<uint64_t>(
+      std::string(kExchangeMaxRecycledBufferBytes));
+  return opt.value_or(kExchangeMaxRecycledBufferBytesDefault);
+}
+
+bool SystemConfig::exchangeEnableBatchedResults() const {
+  auto opt =
+      optionalProperty<bool>(std::string(kExchangeEnableBatchedResults));
+  return opt.value_or(kExchangeEnableBatchedResultsDefault);
+}
+
+bool SystemConfig::exchangeEnablePush() const {
+  auto opt = optionalProperty<bool>(std::string(kExchangeEnablePush));
+  return opt.value_or(kExchangeEnablePushDefault);
+}
+
+std::string SystemConfig::exchangeCompressionCodec() const {
+  auto opt =
+      optionalProperty<std::string>(std::string(kExchangeCompressionCodec));
+  return opt.value_or(std::string(kExchangeCompressionCodecDefault));
+}
+
+bool SystemConfig::exchangeEnableInProcess() const {
+  auto opt = optionalProperty<bool>(std::string(kExchangeEnableInProcess));
+  return opt.value_or(kExchangeEnableInProcessDefault);
+}
+
+int32_t SystemConfig::exchangeAckDelayMs() const {
+  auto opt = optionalProperty<int32_t>(std::string(kExchangeAckDelayMs));
+  return opt.value_or(kExchangeAckDelayMsDefault);
+}
+
+bool SystemConfig::exchangeShareBroadcasts() const {
+  auto opt = optionalProperty<bool>(std::string(kExchangeShareBroadcasts));
+  return opt.value_or(kExchangeShareBroadcastsDefault);
+}
+
+int32_t SystemConfig::planFragmentCacheMaxEntries() const {
+  auto opt =
+      optionalProperty<int32_t>(std::string(kPlanFragmentCacheMaxEntries));
+  return opt.value_or(kPlanFragmentCacheMaxEntriesDefault);
+}
+
+int64_t SystemConfig::constantBlockCacheMaxBytes() const {
+  auto opt =
+      optionalProperty<int64_t>(std::string(kConstantBlockCacheMaxBytes));
+  return opt.value_or(kConstantBlockCacheMaxBytesDefault);
+}
+
+int64_t SystemConfig::compressedPagesCacheMaxBytes() const {
+  auto opt =
+      optionalProperty<int64_t>(std::string(kCompressedPagesCacheMaxBytes));
+  return opt.value_or(kCompressedPagesCacheMaxBytesDefault);
+}
+
+uint64_t SystemConfig::fragmentResultCacheMaxBytes() const {
+  auto opt =
+      optionalProperty<uint64_t>(std::string(kFragmentResultCacheMaxBytes));
+  return opt.value_or(kFragmentResultCacheMaxBytesDefault);
+}
+
+int32_t SystemConfig::taskSplitConversionBatchSize() const {
+  auto opt =
+      optionalProperty<int32_t>(std::string(kTaskSplitConversionBatchSize));
+  return opt.value_or(kTaskSplitConversionBatchSizeDefault);
+}
+
+int32_t SystemConfig::taskPlanningThreads() const {
+  auto opt = optionalProperty<int32_t>(std::string(kTaskPlanningThreads));
+  return opt.value_or(kTaskPlanningThreadsDefault);
+}
+
+uint64_t SystemConfig::taskRootStageMaxResultBytes() const {
+  auto opt =
+      optionalProperty<uint64_t>(std::string(kTaskRootStageMaxResultBytes));
+  return opt.value_or(kTaskRootStageMaxResultBytesDefault);
+}
+
+int32_t SystemConfig::taskMaxSplitPreloadPerDriver() const {
+  auto opt =
+      optionalProperty<int32_t>(std::string(kTaskMaxSplitPreloadPerDriver));
+  return opt.value_or(kTaskMaxSplitPreloadPerDriverDefault);
+}
+
+bool SystemConfig::taskAdaptivePartialAggregation() const {
+  auto opt =
+      optionalProperty<bool>(std::string(kTaskAdaptivePartialAggregation));
+  return opt.value_or(kTaskAdaptivePartialAggregationDefault);
+}
+
+int64_t SystemConfig::taskAdaptivePartialAggregationMinRows() const {
+  auto opt = optionalProperty<int64_t>(
+      std::string(kTaskAdaptivePartialAggregationMinRows));
+  return opt.value_or(kTaskAdaptivePartialAggregationMinRowsDefault);
+}
+
+int32_t SystemConfig::taskAdaptivePartialAggregationMaxUniqueRowsPct() const {
+  auto opt = optionalProperty<int32_t>(
+      std::string(kTaskAdaptivePartialAggregationMaxUniqueRowsPct));
+  return opt.value_or(kTaskAdaptivePartialAggregationMaxUniqueRowsPctDefault);
+}
+
+bool SystemConfig::taskSplitPruningEnabled() const {
+  auto opt = optionalProperty<bool>(std::string(kTaskSplitPruningEnabled));
+  return opt.value_or(kTaskSplitPruningEnabledDefault);
+}
+
+int32_t SystemConfig::taskSplitOrderingRecentFiles() const {
+  auto opt =
+      optionalProperty<int32_t>(std::string(kTaskSplitOrderingRecentFiles));
+  return opt.value_or(kTaskSplitOrderingRecentFilesDefault);
+}
+
+int32_t SystemConfig::taskSplitsPerDriver() const {
+  auto opt = optionalProperty<int32_t>(std::string(kTaskSplitsPerDriver));
+  return opt.value_or(kTaskSplitsPerDriverDefault);
+}
+
+int32_t SystemConfig::taskWriterCount() const {
+  auto opt = optionalProperty<int32_t>(std::string(kTaskWriterCount));
+  return opt.value_or(kTaskWriterCountDefault);
+}
+
+uint64_t SystemConfig::taskWriterTargetFileBytes() const {
+  auto opt =
+      optionalProperty<uint64_t>(std::string(kTaskWriterTargetFileBytes));
+  return opt.value_or(kTaskWriterTargetFileBytesDefault);
+}
+
+int64_t SystemConfig::taskAdmissionMaxDrivers() const {
+  auto opt = optionalProperty<int64_t>(std::string(kTaskAdmissionMaxDrivers));
+  return opt.value_or(kTaskAdmissionMaxDriversDefault);
+}
+
+double SystemConfig::taskAdmissionMaxMemoryPct() const {
+  auto opt = optionalProperty<double>(std::string(kTaskAdmissionMaxMemoryPct));
+  return opt.value_or(kTaskAdmissionMaxMemoryPctDefault);
+}
+
+double SystemConfig::taskAdmissionMaxCpuLoadPct() const {
+  auto opt =
+      optionalProperty<double>(std::string(kTaskAdmissionMaxCpuLoadPct));
+  return opt.value_or(kTaskAdmissionMaxCpuLoadPctDefault);
+}
+
+int32_t SystemConfig::driverStuckThresholdSec() const {
+  auto opt = optionalProperty<int32_t>(std::string(kDriverStuckThresholdSec));
+  return opt.value_or(kDriverStuckThresholdSecDefault);
+}
+
+bool SystemConfig::driverStuckCancelEnabled() const {
+  auto opt = optionalProperty<bool>(std::string(kDriverStuckCancelEnabled));
+  return opt.value_or(kDriverStuckCancelEnabledDefault);
+}
+
+std::string SystemConfig::taskStatsLogDirectory() const {
+  auto opt = optionalProperty<std::string>(std::string(kTaskStatsLogDirectory));
+  return opt.hasValue() ? opt.value() : "";
+}
+
+int32_t SystemConfig::taskStatsLogRowsPerFile() const {
+  auto opt = optionalProperty<int32_t>(std::string(kTaskStatsLogRowsPerFile));
+  return opt.value_or(kTaskStatsLogRowsPerFileDefault);
+}
+
+int32_t SystemConfig::taskStatsLogMaxFiles() const {
+  auto opt = optionalProperty<int32_t>(std::string(kTaskStatsLogMaxFiles));
+  return opt.value_or(kTaskStatsLogMaxFilesDefault);
+}
+
+int32_t SystemConfig::taskStatsLogFlushIntervalSec() const {
+  auto opt =
+      optionalProperty<int32_t>(std::string(kTaskStatsLogFlushIntervalSec));
+  return opt.value_or(kTaskStatsLogFlushIntervalSecDefault);
+}
+
+std::string SystemConfig::taskUpdateCaptureDirectory() const {
+  auto opt =
+      optionalProperty<std::string>(std::string(kTaskUpdateCaptureDirectory));
+  return opt.hasValue() ? opt.value() : "";
+}
+
+int32_t SystemConfig::taskUpdateCaptureMaxFiles() const {
+  auto opt =
+      optionalProperty<int32_t>(std::string(kTaskUpdateCaptureMaxFiles));
+  return opt.value_or(kTaskUpdateCaptureMaxFilesDefault);
+}
+
 NodeConfig* NodeConfig::instance() {
   static std::unique_ptr<NodeConfig> instance = std::make_unique<NodeConfig>();
   return instance.get();
@@ -13,10 +13,13 @@
  */
 #pragma once
 
+#include <folly/SharedMutex.h>
+#include <folly/Synchronized.h>
 #include <chrono>
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <vector>
 #include "velox/core/Context.h"
 
 namespace facebook::presto {
@@ -28,9 +31,26 @@ class ConfigBase {
   /// @param filePath Path to configuration file.
   void initialize(const std::string& filePath);
 
+  /// Sets the properties in 'updates' at runtime, an empty value resets the
+  /// property to its default. Throws and sets none if any is not mutable.
+  /// Returns the previous values of the changed properties, empty for the
+  /// ones that were not set.
+  std::unordered_map<std::string, std::string> update(
+      const std::unordered_map<std::string, std::string>& updates);
+
+  /// Rereads the file passed to initialize(). Applies the changes of the
+  /// mutable properties and returns their previous values like update(). The
+  /// changes of the other properties are logged and take effect on restart.
+  std::unordered_map<std::string, std::string> reload();
+
+  /// Returns true if 'propertyName' may be changed while the server runs.
+  virtual bool isMutable(const std::string& /*propertyName*/) const {
+    return false;
+  }
+
   template <typename T>
   T requiredProperty(const std::string& propertyName) const {
-    auto propertyValue = config_->get<T>(propertyName);
+    auto propertyValue = (*config_.rlock())->get<T>(propertyName);
     if (propertyValue.has_value()) {
       return propertyValue.value();
     } else {
@@ -40,7 +60,7 @@ class ConfigBase {
   }
 
   std::string requiredProperty(const std::string& propertyName) const {
-    auto propertyValue = config_->get(propertyName);
+    auto propertyValue = (*config_.rlock())->get(propertyName);
     if (propertyValue.has_value()) {
       return propertyValue.value();
     } else {
@@ -51,22 +71,27 @@ class ConfigBase {
 
   template <typename T>
   folly::Optional<T> optionalProperty(const std::string& propertyName) const {
-    return config_->get<T>(propertyName);
+    return (*config_.rlock())->get<T>(propertyName);
   }
 
   folly::Optional<std::string> optionalProperty(
       const std::string& propertyName) const {
-    return config_->get(propertyName);
+    return (*config_.rlock())->get(propertyName);
   }
 
-  const std::unordered_map<std::string, std::string>& values() const {
-    return config_->values();
+  /// Returns a copy as the values may change at runtime.
+  std::unordered_map<std::string, std::string> values() const {
+    return (*config_.rlock())->values();
   }
 
  protected:
   ConfigBase();
 
-  std::unique_ptr<velox::Config> config_;
+  virtual ~ConfigBase() = default;
+
+  // Replaced as a whole on update.
+  folly::Synchronized<std::unique_ptr<velox::Config>, folly::SharedMutex>
+      config_;
   std::string filePath_;
 };
 
@@ -87,7 +112,40 @@ class SystemConfig : public ConfigBase {
       "task.max-drivers-per-task"};
   static constexpr std::string_view kConcurrentLifespansPerTask{
       "task.concurrent-lifespans-per-task"};
+  /// If true, the concurrent lifespans of the new grouped execution tasks
+  /// start at this minimum and are raised up to
+  /// task.concurrent-lifespans-per-task while the node has memory and CPU
+  /// headroom, and lowered when its memory runs low. The session property
+  /// concurrent_lifespans_per_task still takes precedence.
+  static constexpr std::string_view kAdaptiveConcurrentLifespans{
+      "task.adaptive-concurrent-lifespans"};
+  static constexpr std::string_view kMinConcurrentLifespansPerTask{
+      "task.min-concurrent-lifespans-per-task"};
+  /// If true, the drivers of the new tasks are lowered from
+  /// task.max-drivers-per-task while the CPUs are saturated, down to this
+  /// minimum, and raised back when they are idle. The session property
+  /// max_drivers_per_task still takes precedence.
+  static constexpr std::string_view kAdaptiveDriversPerTask{
+      "task.adaptive-drivers-per-task"};
+  static constexpr std::string_view kMinDriversPerTask{
+      "task.min-drivers-per-task"};
   static constexpr std::string_view kHttpExecThreads{"http_exec_threads"};
+  /// Number of threads the http server processes the task updates and the
+  /// result compression on instead of its io threads. The queued task updates
+  /// run before the queued result compressions. Zero processes the task
+  /// updates on the io threads and compresses the results on the driver
+  /// threads.
+  static constexpr std::string_view kHttpCpuThreads{"http_cpu_threads"};
+  /// Number of acceptor groups of the http server. More than one binds that
+  /// many proxygen servers to the same ports with SO_REUSEPORT, each with its
+  /// own share of the http_exec_threads io threads, so that accepting and
+  /// parsing the requests spreads over the cores.
+  static constexpr std::string_view kHttpServerNumAcceptorGroups{
+      "http-server.num-acceptor-groups"};
+  /// If true, the io threads of each acceptor group are pinned to a
+  /// contiguous share of the CPUs.
+  static constexpr std::string_view kHttpServerPinAcceptorGroups{
+      "http-server.pin-acceptor-groups"};
   static constexpr std::string_view kHttpServerHttpsPort{
       "http-server.https.port"};
   static constexpr std::string_view kHttpServerHttpsEnabled{
@@ -98,32 +156,227 @@ class SystemConfig : public ConfigBase {
   static constexpr std::string_view kHttpsKeyPath{"https-key-path"};
   static constexpr std::string_view kHttpsClientCertAndKeyPath{
       "https-client-cert-key-path"};
+  /// If true, the https connections of the http server and of the http
+  /// clients negotiate HTTP/2 over ALPN, falling back to HTTP/1.1 if the peer
+  /// does not support it. The requests to the same peer are then multiplexed
+  /// over one connection.
+  static constexpr std::string_view kHttpServerHttp2Enabled{
+      "http-server.http2.enabled"};
   static constexpr std::string_view kNumIoThreads{"num-io-threads"};
+  /// If true, the reads of nearby ranges of the S3 and HDFS files are
+  /// coalesced even if the file system does not ask for it.
+  static constexpr std::string_view kStorageCoalesceReads{
+      "storage.coalesce-reads"};
+  /// The reads of S3 and HDFS files of at least twice this many bytes are
+  /// split into ranges of this size read in parallel. 0 disables it.
+  static constexpr std::string_view kStorageParallelReadBytes{
+      "storage.parallel-read-bytes"};
+  /// The number of threads reading the ranges of the parallel reads.
+  static constexpr std::string_view kStorageNumParallelReadThreads{
+      "storage.num-parallel-read-threads"};
   static constexpr std::string_view kNumQueryThreads{"num-query-threads"};
+  /// If true on a machine with several NUMA nodes, the query threads are
+  /// split into a pool per node, pinned to the CPUs of the node, and each
+  /// query runs its drivers on the least loaded node.
+  static constexpr std::string_view kNumaAwareDriverExecutor{
+      "numa-aware-driver-executor"};
+  /// If true, the query threads share their time fairly between the queries
+  /// and favor the queries that ran the least, instead of running the drivers
+  /// in FIFO order. Takes precedence over the NUMA aware executor.
+  static constexpr std::string_view kFairDriverScheduler{
+      "fair-driver-scheduler"};
   static constexpr std::string_view kNumSpillThreads{"num-spill-threads"};
+  /// Comma separated list of spill paths, e.g. one per local drive. Each task
+  /// spills under one of them.
   static constexpr std::string_view kSpillerSpillPath =
       "experimental.spiller-spill-path";
+  /// How the spill path of a task is picked: 'round-robin', or 'free-space'
+  /// for a random path in proportion to the free space of its drive.
+  static constexpr std::string_view kSpillerSpillPathPolicy{
+      "experimental.spiller-spill-path-policy"};
+  /// A local spill path is taken out of the rotation while its drive has less
+  /// free space.
+  static constexpr std::string_view kSpillerSpillPathMinFreeGb{
+      "experimental.spiller-spill-path-min-free-gb"};
+  /// The interval of deleting the spill directories left by the tasks that
+  /// are gone, e.g. before a crash. 0 disables the cleanup.
+  static constexpr std::string_view kSpillCleanupIntervalSec{
+      "experimental.spill-cleanup-interval-sec"};
+  /// The most bytes the running tasks of all the queries may spill on this
+  /// node. At the limit, the new tasks do not spill and the queries spilling
+  /// most are failed until the node is back under it. 0 means no limit.
+  static constexpr std::string_view kMaxSpillPerNodeGb{
+      "experimental.max-spill-per-node-gb"};
+  /// The most bytes the running tasks of a query may spill on this node.
+  /// A query over it is failed. 0 means no limit.
+  static constexpr std::string_view kQueryMaxSpillPerNodeGb{
+      "experimental.query-max-spill-per-node-gb"};
+  /// If true and a spill path is configured, the new queries spill their
+  /// aggregations, joins and order bys beyond their share of the memory of the
+  /// node left by the running queries, instead of running into the per-node
+  /// limit under memory pressure. The session properties take precedence.
+  static constexpr std::string_view kSpillOnMemoryPressure{
+      "experimental.spill-on-memory-pressure"};
+  /// Number of tables whose cache hits and misses are tracked, the ones with
+  /// the most bytes read. 0 disables the tracking.
+  static constexpr std::string_view kTableCacheStatsMaxTables{
+      "table-cache-stats.max-tables"};
+  /// Fraction of the queries whose task updates, split additions, result
+  /// requests and exchange fetches are traced, between 0 (disabled) and 1.
+  /// The last tracing.max-spans spans are kept and served on /v1/trace.
+  static constexpr std::string_view kTracingSampleRate{"tracing.sample-rate"};
+  static constexpr std::string_view kTracingMaxSpans{"tracing.max-spans"};
   static constexpr std::string_view kShutdownOnsetSec{"shutdown-onset-sec"};
+  /// The interval of rereading config.properties to apply the changes of the
+  /// properties mutable at runtime, 0 to apply them only on the
+  /// systemConfig/reload server operation.
+  static constexpr std::string_view kConfigReloadIntervalSec{
+      "config-reload-interval-sec"};
+  /// The longest interval between the retries of a failing announcement.
+  static constexpr std::string_view kAnnouncementMaxBackoffMs{
+      "announcement-max-backoff-ms"};
+  /// If true, the announcements carry the number of running tasks and drivers
+  /// of the node for load-aware scheduling on the coordinator.
+  static constexpr std::string_view kAnnouncementLoadInfo{
+      "announcement-load-info"};
   static constexpr std::string_view kSystemMemoryGb{"system-memory-gb"};
   static constexpr std::string_view kAsyncCacheSsdGb{"async-cache-ssd-gb"};
   static constexpr std::string_view kAsyncCacheSsdCheckpointGb{
       "async-cache-ssd-checkpoint-gb"};
+  /// The prefix of the SSD cache files. A comma-separated list of prefixes on
+  /// different devices stripes the shards over them round-robin.
   static constexpr std::string_view kAsyncCacheSsdPath{"async-cache-ssd-path"};
+  /// Number of files the SSD cache is sharded into.
+  static constexpr std::string_view kAsyncCacheSsdShards{
+      "async-cache-ssd-shards"};
+  /// If true, only the file groups and columns read often enough to fit in
+  /// the SSD cache are written to it, so that large one-off scans do not
+  /// displace the frequently read data. The access frequencies are decayed
+  /// by async-cache-ssd-admission-decay-pct on each update of the filter.
+  static constexpr std::string_view kAsyncCacheSsdAdmissionEnabled{
+      "async-cache-ssd-admission-enabled"};
+  static constexpr std::string_view kAsyncCacheSsdAdmissionDecayPct{
+      "async-cache-ssd-admission-decay-pct"};
+  /// Number of threads writing and checkpointing the SSD cache, 0 for one per
+  /// shard.
+  static constexpr std::string_view kAsyncCacheSsdIoThreads{
+      "async-cache-ssd-io-threads"};
+  /// If true, the memory cache evicts its least recently used entries ahead
+  /// of time down to what the queries leave it, see CacheMemoryPolicy.h.
+  static constexpr std::string_view kAsyncCacheProactiveShrinkEnabled{
+      "async-cache-proactive-shrink-enabled"};
+  /// The memory the cache is always allowed to hold.
+  static constexpr std::string_view kAsyncCacheFloorGb{"async-cache-floor-gb"};
+  /// The most memory the cache may hold, 0 for the node memory.
+  static constexpr std::string_view kAsyncCacheCeilingGb{
+      "async-cache-ceiling-gb"};
+  /// Number of threads loading the ranges of the cache prefetch and pin
+  /// operations.
+  static constexpr std::string_view kAsyncCacheWarmerThreads{
+      "async-cache-warmer-threads"};
+  /// The percentage of the node memory the cache pin operations may hold.
+  static constexpr std::string_view kAsyncCacheMaxPinnedPct{
+      "async-cache-max-pinned-pct"};
+  /// The interval of returning the free memory of the malloc arenas to the
+  /// OS, 0 to trim only on the allocator/trim server operation.
+  static constexpr std::string_view kMemoryTrimIntervalSec{
+      "memory-trim-interval-sec"};
+  /// If true, the result pages sent to the other workers carry the CRC32
+  /// checksums the receivers verify.
   static constexpr std::string_view kEnableSerializedPageChecksum{
       "enable-serialized-page-checksum"};
   static constexpr std::string_view kUseMmapArena{"use-mmap-arena"};
   static constexpr std::string_view kMmapArenaCapacityRatio{
       "mmap-arena-capacity-ratio"};
   static constexpr std::string_view kUseMmapAllocator{"use-mmap-allocator"};
+  /// If true, the address ranges the MmapAllocator reserves for its size
+  /// classes and arena are advised to be backed by transparent huge pages.
+  /// Needs the kernel THP mode 'always' or 'madvise'.
+  static constexpr std::string_view kMmapAllocatorHugePages{
+      "mmap-allocator-huge-pages"};
   static constexpr std::string_view kEnableVeloxTaskLogging{
       "enable_velox_task_logging"};
   static constexpr std::string_view kEnableVeloxExprSetLogging{
       "enable_velox_expression_logging"};
   static constexpr std::string_view kLocalShuffleMaxPartitionBytes{
       "shuffle.local.max-partition-bytes"};
+  /// The number of threads writing the files of the local persistent shuffle
+  /// in the background. The files are written on the driver threads if 0.
+  static constexpr std::string_view kLocalShuffleNumWriteThreads{
+      "shuffle.local.num-write-threads"};
+  /// The maximum size of the blocks being written by each local persistent
+  /// shuffle writer. The shuffle write operator is blocked while more is in
+  /// flight.
+  static constexpr std::string_view kLocalShuffleMaxInFlightWriteBytes{
+      "shuffle.local.max-in-flight-write-bytes"};
+  /// The number of threads prefetching the blocks of the local persistent
+  /// shuffle readers. The blocks are read when requested if 0.
+  static constexpr std::string_view kLocalShuffleNumReadThreads{
+      "shuffle.local.num-read-threads"};
+  /// The maximum number of the next blocks each local persistent shuffle
+  /// reader prefetches.
+  static constexpr std::string_view kLocalShuffleMaxPrefetchBlocks{
+      "shuffle.local.max-prefetch-blocks"};
+  /// The maximum size of the blocks each local persistent shuffle reader
+  /// prefetches beyond the next one.
+  static constexpr std::string_view kLocalShuffleMaxPrefetchBytes{
+      "shuffle.local.max-prefetch-bytes"};
+  /// If true, the local persistent shuffle readers memory map the blocks on
+  /// local disks instead of copying them into memory.
+  static constexpr std::string_view kLocalShuffleReadMmap{
+      "shuffle.local.read-mmap"};
+  /// The maximum size of the blocks the 'local-memory' shuffle keeps in memory
+  /// for the readers of the same process. The blocks beyond it are written to
+  /// the shuffle files as by the 'local' shuffle.
+  static constexpr std::string_view kLocalShuffleMemoryStoreBytes{
+      "shuffle.local.memory-store-bytes"};
+  /// The number of threads reading the shuffle blocks of the batch exchange
+  /// sources so that the reads overlap with their consumption. The blocks are
+  /// read on the driver threads if 0.
+  static constexpr std::string_view kShuffleNumExchangeReadThreads{
+      "shuffle.num-exchange-read-threads"};
   static constexpr std::string_view kShuffleName{"shuffle.name"};
+  /// The format of the data written to and read from the shuffle in batch
+  /// mode. 'unsafe-row' serializes each row separately, 'presto' serializes
+  /// the rows of each partition of an input batch into a single columnar
+  /// PrestoPage.
+  static constexpr std::string_view kShuffleSerdeFormat{
+      "shuffle.serde-format"};
+  /// If true, the rows of each shuffle partition are written in the ascending
+  /// order of the partition keys in batch mode, one sorted run per task. Each
+  /// driver sorts its rows, spilling as configured for the order by, and the
+  /// drivers' rows are merged before they are written. The reads whose remote
+  /// source is ordered merge the runs of the writers on its ordering, e.g.
+  /// for merge joins, instead of concatenating them.
+  static constexpr std::string_view kShuffleSortByPartitionKeys{
+      "shuffle.sort-by-partition-keys"};
+  /// If true, the rows are serialized straight into the shuffle blocks by the
+  /// partition and serialize operator in batch mode, saving a copy of the
+  /// shuffled data. Each driver then has its own shuffle writer.
+  static constexpr std::string_view kShuffleFusePartitionAndWrite{
+      "shuffle.fuse-partition-and-write"};
+  /// If true, the shuffles hash partitioned on BIGINT, INTEGER and VARCHAR
+  /// keys use a partition function based on XXH3 in batch mode. This changes
+  /// the partition of each row, so all the workers writing a shuffle must have
+  /// the same setting.
+  static constexpr std::string_view kShuffleXxh3HashPartitioning{
+      "shuffle.xxh3-hash-partitioning"};
   static constexpr std::string_view kHttpEnableAccessLog{
       "http-server.enable-access-log"};
+  /// Fraction of the requests in the access log, between 0 and 1. The task
+  /// endpoints may override it by class, e.g. "status=0.01,results=0.001"
+  /// with the classes create_task, status, info, results, ack and delete.
+  static constexpr std::string_view kHttpAccessLogSampleRate{
+      "http-server.access-log.sample-rate"};
+  static constexpr std::string_view kHttpAccessLogEndpointSampleRates{
+      "http-server.access-log.endpoint-sample-rates"};
+  /// The requests that take at least this long or fail with a server error
+  /// are logged whatever the sampling. 0 disables.
+  static constexpr std::string_view kHttpAccessLogSlowRequestMs{
+      "http-server.access-log.slow-request-ms"};
+  /// The file the access log is appended to. Empty logs through glog.
+  static constexpr std::string_view kHttpAccessLogPath{
+      "http-server.access-log.path"};
   static constexpr std::string_view kHttpEnableStatFilter{
       "http-server.enable-stats-filter"};
   static constexpr std::string_view kRegisterTestFunctions{
@@ -132,44 +385,403 @@ class SystemConfig : public ConfigBase {
   /// the received http response data.
   static constexpr std::string_view kHttpMaxAllocateBytes{
       "http-server.max-response-allocate-bytes"};
+  /// If true, PrestoExchangeSource enqueues the serialized pages of a data
+  /// response as soon as they are received instead of waiting for the entire
+  /// response. This also enables chunked transfer encoding for data responses.
+  static constexpr std::string_view kExchangeEnableStreaming{
+      "exchange.enable-streaming"};
+  /// The max response size PrestoExchangeSource asks for in a data request.
+  static constexpr std::string_view kExchangeMaxResponseBytes{
+      "exchange.max-response-bytes"};
+  /// If true, PrestoExchangeSource adapts the max response size of each data
+  /// request between 'exchange.min-response-bytes' and
+  /// 'exchange.max-response-bytes' based on the size of the previous responses
+  /// and the bytes still queued for the consumer.
+  static constexpr std::string_view kExchangeAdaptiveResponseSize{
+      "exchange.adaptive-response-size"};
+  /// The lower bound of the adaptive max response size of the data requests
+  /// of PrestoExchangeSource, 1MB by default. Only takes effect if
+  /// 'exchange.adaptive-response-size' is true.
+  static constexpr std::string_view kExchangeMinResponseBytes{
+      "exchange.min-response-bytes"};
+  /// The node-wide budget of bytes queued in all the PrestoExchangeSources.
+  /// Once exceeded, the data requests of the queries holding more than their
+  /// fair share of the budget are deferred until the queued bytes drop. Zero
+  /// means unlimited.
+  static constexpr std::string_view kExchangeNodeMaxQueuedBytes{
+      "exchange.node-max-queued-bytes"};
+  /// The local directory the PrestoExchangeSources spill the received pages
+  /// into while 'exchange.node-max-queued-bytes' is exceeded, instead of
+  /// deferring their data requests. The upstream workers can then finish and
+  /// free their output buffers. The pages are read back as the consumers
+  /// catch up. Empty disables the spilling.
+  static constexpr std::string_view kExchangeSpillPath{"exchange.spill-path"};
+  /// The bytes an exchange source spills before it stops fetching until its
+  /// consumer has read half of them.
+  static constexpr std::string_view kExchangeSpillMaxBytesPerSource{
+      "exchange.spill-max-bytes-per-source"};
+  /// The bytes all the exchange sources of the node spill before they stop
+  /// fetching ahead, until some of them are read back. 0 means unlimited.
+  static constexpr std::string_view kExchangeSpillMaxBytesPerNode{
+      "exchange.spill-max-bytes-per-node"};
+  /// The min number of pages an exchange source keeps queued for its consumer.
+  /// The source fetches the next page by itself without waiting for the
+  /// consumer to ask for it while fewer are queued, so that a merge exchange
+  /// does not stall on a source which has nothing buffered. 0 disables the
+  /// prefetching.
+  static constexpr std::string_view kExchangeMinPrefetchedPages{
+      "exchange.min-prefetched-pages"};
+  /// The local directory the output buffers spill the pages of their idle
+  /// consumers into, so that the producing tasks are not held up by the slow
+  /// or gone consumers. The pages are served from disk until the consumer
+  /// catches up. Empty disables the spilling.
+  static constexpr std::string_view kOutputBufferSpillPath{
+      "output-buffer.spill-path"};
+  /// The node memory usage in percent of its capacity at which the output
+  /// buffers spill.
+  static constexpr std::string_view kOutputBufferSpillMemoryPct{
+      "output-buffer.spill-memory-pct"};
+  /// The time since the last request of a consumer after which its pages may
+  /// be spilled.
+  static constexpr std::string_view kOutputBufferSpillMinIdleMs{
+      "output-buffer.spill-min-idle-ms"};
+  /// The bytes spilled per consumer before the spilling of its pages pauses
+  /// until it has read half of them.
+  static constexpr std::string_view kOutputBufferSpillMaxBytesPerDestination{
+      "output-buffer.spill-max-bytes-per-destination"};
+  /// The number of IO threads shared by the http clients of all the
+  /// PrestoExchangeSources. The exchange sources to the same upstream share a
+  /// single http client and its connections. Zero means to run all the clients
+  /// on the global event base.
+  static constexpr std::string_view kExchangeHttpClientNumIoThreads{
+      "exchange.http-client.num-io-threads"};
+  /// The number of threads processing the responses of the
+  /// PrestoExchangeSources, i.e. enqueuing the pages, acknowledging them and
+  /// retrying. Zero processes them on the driver threads, where they queue
+  /// behind the drivers of the CPU bound stages.
+  static constexpr std::string_view kExchangeNumResponseThreads{
+      "exchange.num-response-threads"};
+  /// The percentile of the recent exchange data response latencies after
+  /// which a data request is sent again to the same upstream if it has not
+  /// completed, e.g. 99. The first of the two responses is taken, so that a
+  /// slow upstream host does not hold up the exchange. The requests of the
+  /// sources whose last response was empty are not hedged, as they wait for
+  /// the upstream to produce. 0 disables the hedging.
+  static constexpr std::string_view kExchangeHedgePercentile{
+      "exchange.hedge-percentile"};
+  /// The min time in ms before a data request is hedged.
+  static constexpr std::string_view kExchangeHedgeMinDelayMs{
+      "exchange.hedge-min-delay-ms"};
+  /// The max number of idle connections kept open to each upstream.
+  static constexpr std::string_view kExchangeHttpClientMaxIdleSessions{
+      "exchange.http-client.max-idle-sessions-per-host"};
+  /// The max bytes of the freed data response buffers each
+  /// PrestoExchangeSource keeps for reuse by its next responses. The kept
+  /// buffers stay allocated from the exchange memory pool. Zero disables the
+  /// buffer recycling.
+  static constexpr std::string_view kExchangeMaxRecycledBufferBytes{
+      "exchange.max-recycled-buffer-bytes"};
+  /// If true, PrestoExchangeSource coalesces the data requests to the same
+  /// upstream worker into batched results requests. Ignored if
+  /// 'exchange.enable-streaming' is true.
+  static constexpr std::string_view kExchangeEnableBatchedResults{
+      "exchange.enable-batched-results"};
+  /// If true, PrestoExchangeSource asks the upstream workers to push the pages
+  /// with credit-based flow control instead of pulling them. The sources fall
+  /// back to pulling from the upstream workers which refuse to push. Only
+  /// supported over http.
+  static constexpr std::string_view kExchangeEnablePush{"exchange.enable-push"};
+  /// The codec to compress the pages of the data responses with, i.e. 'none',
+  /// 'lz4' or 'zstd'. Pages are only compressed for the consumers which accept
+  /// the codec and only if compression shrinks them.
+  static constexpr std::string_view kExchangeCompressionCodec{
+      "exchange.compression-codec"};
+  /// If true, the exchanges from the tasks on this worker read the output
+  /// buffers directly instead of fetching them over http.
+  static constexpr std::string_view kExchangeEnableInProcess{
+      "exchange.enable-in-process"};
+  /// How long PrestoExchangeSource waits for the next data request to
+  /// acknowledge the received pages before sending a separate ack request.
+  /// Zero acknowledges each non-empty response right away.
+  static constexpr std::string_view kExchangeAckDelayMs{
+      "exchange.ack-delay-ms"};
+  /// If true, the tasks of a query on this worker fetch the output of a
+  /// broadcast stage once and share the pages, e.g. for the build sides of
+  /// the broadcast joins.
+  static constexpr std::string_view kExchangeShareBroadcasts{
+      "exchange.share-broadcasts"};
+  /// The max number of converted plan fragments to cache for the tasks of
+  /// the same stage to share. 0 disables the cache.
+  static constexpr std::string_view kPlanFragmentCacheMaxEntries{
+      "plan-fragment-cache.max-entries"};
+  /// The max bytes of the vectors decoded from the constant blocks of the
+  /// plan fragments to cache for the tasks to share. 0 disables the cache.
+  static constexpr std::string_view kConstantBlockCacheMaxBytes{
+      "constant-block-cache.max-bytes"};
+  /// The max bytes of the compressed data responses to cache for the
+  /// consumers of the broadcast output buffers to share, counting both the
+  /// uncompressed and compressed pages. 0 disables the cache.
+  static constexpr std::string_view kCompressedPagesCacheMaxBytes{
+      "compressed-pages-cache.max-bytes"};
+  /// The max bytes of the serialized result rows of the leaf fragments to
+  /// cache for the tasks that run the same fragment over the same unchanged
+  /// files. The fragments must be deterministic. 0 disables the cache.
+  static constexpr std::string_view kFragmentResultCacheMaxBytes{
+      "fragment-result-cache.max-bytes"};
+  /// The task updates with more splits than this are converted to Velox
+  /// splits in batches of this size in parallel on the driver executor. 0
+  /// converts all the splits on the http thread.
+  static constexpr std::string_view kTaskSplitConversionBatchSize{
+      "task.split-conversion-batch-size"};
+  /// The number of threads parsing the task updates and converting their
+  /// plan fragments. Zero plans the tasks on the CPU executor of the http
+  /// server or, if it has none, on the http IO threads, where a heavy plan
+  /// fragment delays the other requests of the same event base.
+  static constexpr std::string_view kTaskPlanningThreads{
+      "task.planning-threads"};
+  /// The maximum size of a response to a consumer pulling the results of the
+  /// root stage. The responses grow from the size the consumer asks for up to
+  /// this size while they keep filling up, so that large results are pulled
+  /// with fewer long polls. Only for the consumers sending
+  /// X-Presto-Accept-Larger-Results: true, the others never get more than
+  /// their X-Presto-Max-Size. 0 sends the requested size.
+  static constexpr std::string_view kTaskRootStageMaxResultBytes{
+      "task.root-stage-max-result-bytes"};
+  /// The number of upcoming splits each table scan driver opens ahead of time
+  /// on the connector IO executor, which prefetches their footers and first
+  /// stripes into the cache. Used unless the session sets
+  /// max_split_preload_per_driver. 0 disables the preloading.
+  static constexpr std::string_view kTaskMaxSplitPreloadPerDriver{
+      "task.max-split-preload-per-driver"};
+  /// If true, a partial aggregation that has seen
+  /// task.adaptive-partial-aggregation.min-rows input rows and has more groups
+  /// than task.adaptive-partial-aggregation.max-unique-rows-pct percent of
+  /// them stops aggregating and passes its input through to the final
+  /// aggregation. Used unless the session sets adaptive_partial_aggregation
+  /// and adaptive_partial_aggregation_unique_rows_ratio_threshold.
+  static constexpr std::string_view kTaskAdaptivePartialAggregation{
+      "task.adaptive-partial-aggregation"};
+  static constexpr std::string_view kTaskAdaptivePartialAggregationMinRows{
+      "task.adaptive-partial-aggregation.min-rows"};
+  static constexpr std::string_view
+      kTaskAdaptivePartialAggregationMaxUniqueRowsPct{
+          "task.adaptive-partial-aggregation.max-unique-rows-pct"};
+  /// If true, the hive splits whose partition key values or bucket fail the
+  /// filters of their table scan are not added to the tasks.
+  static constexpr std::string_view kTaskSplitPruningEnabled{
+      "task.split-pruning-enabled"};
+  /// The number of recently scanned files to remember. The Hive splits of
+  /// these files are added to the tasks ahead of the others since their data
+  /// is likely cached. 0 keeps the splits in the order they arrive.
+  static constexpr std::string_view kTaskSplitOrderingRecentFiles{
+      "task.split-ordering.recent-files"};
+  /// A task that only reads tables and gets all its splits with its plan runs
+  /// at most one driver per this many splits, so that a small input does not
+  /// start all the drivers and repartition a few rows across the local
+  /// exchanges. 0 always runs the max drivers per task.
+  static constexpr std::string_view kTaskSplitsPerDriver{
+      "task.splits-per-driver"};
+  /// The max drivers of a task that writes a table, unless the session sets
+  /// task_writer_count. 0 runs the max drivers per task.
+  static constexpr std::string_view kTaskWriterCount{"task.writer-count"};
+  /// The bytes each writer of a table aims to write into its file. A writing
+  /// task that reads tables and gets all its splits with its plan runs one
+  /// writer per this many bytes of splits, so that a small insert does not
+  /// write a small file per driver. 0 runs the writer count.
+  static constexpr std::string_view kTaskWriterTargetFileBytes{
+      "task.writer-target-file-bytes"};
+  /// The new tasks wait in a queue instead of starting while the drivers of
+  /// the running tasks are at least this many. 0 does not limit the drivers.
+  static constexpr std::string_view kTaskAdmissionMaxDrivers{
+      "task.admission.max-drivers"};
+  /// The new tasks wait while the query memory of the node is at least this
+  /// percentage of its memory. 0 does not limit the memory.
+  static constexpr std::string_view kTaskAdmissionMaxMemoryPct{
+      "task.admission.max-memory-pct"};
+  /// The new tasks wait while the CPU load of the node is at least this
+  /// percentage. 0 does not limit the CPU load.
+  static constexpr std::string_view kTaskAdmissionMaxCpuLoadPct{
+      "task.admission.max-cpu-load-pct"};
+  /// A driver on its thread for this long is logged with its stack as stuck.
+  /// A driver stays on its thread until it blocks or finishes, so this must
+  /// exceed the longest expected run of a driver. 0 does not watch the
+  /// drivers.
+  static constexpr std::string_view kDriverStuckThresholdSec{
+      "driver.stuck-threshold-sec"};
+  /// If true, the tasks of the query of a stuck driver are failed.
+  static constexpr std::string_view kDriverStuckCancelEnabled{
+      "driver.stuck-cancel-enabled"};
+  /// The local directory the stats of the completed tasks and their operators
+  /// are written into as DWRF files, with enable_velox_task_logging. Empty
+  /// does not record the stats.
+  static constexpr std::string_view kTaskStatsLogDirectory{
+      "task-stats-log.directory"};
+  /// The operators of the completed tasks per file of the task stats log.
+  static constexpr std::string_view kTaskStatsLogRowsPerFile{
+      "task-stats-log.rows-per-file"};
+  /// The oldest files of the task stats log beyond this many are deleted.
+  static constexpr std::string_view kTaskStatsLogMaxFiles{
+      "task-stats-log.max-files"};
+  /// The stats of the completed tasks are not buffered for longer than this.
+  static constexpr std::string_view kTaskStatsLogFlushIntervalSec{
+      "task-stats-log.flush-interval-sec"};
+  /// The local directory the bodies of the task update requests are written
+  /// into for replay, see TaskUpdateCapture. Empty does not capture them. The
+  /// credentials of the JSON updates are redacted and the files are only
+  /// readable by the owner, but Thrift updates keep their credentials.
+  static constexpr std::string_view kTaskUpdateCaptureDirectory{
+      "task-update-capture.directory"};
+  /// The oldest captured task updates beyond this many are deleted.
+  static constexpr std::string_view kTaskUpdateCaptureMaxFiles{
+      "task-update-capture.max-files"};
   // Most server nodes today (May 2022) have at least 16 cores.
   // Setting the default maximum drivers per task to this value will
   // provide a better off-shelf experience.
   static constexpr int32_t kMaxDriversPerTaskDefault = 16;
+  static constexpr bool kAdaptiveDriversPerTaskDefault = false;
+  static constexpr int32_t kMinDriversPerTaskDefault = 2;
   static constexpr bool kHttpServerReusePortDefault = false;
   static constexpr int32_t kConcurrentLifespansPerTaskDefault = 1;
+  static constexpr bool kAdaptiveConcurrentLifespansDefault = false;
+  static constexpr int32_t kMinConcurrentLifespansPerTaskDefault = 1;
   static constexpr int32_t kHttpExecThreadsDefault = 8;
+  static constexpr int32_t kHttpCpuThreadsDefault = 0;
+  static constexpr int32_t kHttpServerNumAcceptorGroupsDefault = 1;
+  static constexpr bool kHttpServerPinAcceptorGroupsDefault = false;
   static constexpr bool kHttpServerHttpsEnabledDefault = false;
   static constexpr std::string_view kHttpsSupportedCiphersDefault{
       "AES128-SHA,AES128-SHA256,AES256-GCM-SHA384"};
+  static constexpr bool kHttpServerHttp2EnabledDefault = false;
   static constexpr int32_t kNumIoThreadsDefault = 30;
+  static constexpr bool kStorageCoalesceReadsDefault = false;
+  static constexpr uint64_t kStorageParallelReadBytesDefault = 0;
+  static constexpr int32_t kStorageNumParallelReadThreadsDefault = 16;
+  static constexpr bool kSpillOnMemoryPressureDefault = false;
+  static constexpr bool kNumaAwareDriverExecutorDefault = false;
+  static constexpr bool kFairDriverSchedulerDefault = false;
+  static constexpr int32_t kTableCacheStatsMaxTablesDefault = 100;
+  static constexpr double kTracingSampleRateDefault = 0;
+  static constexpr int32_t kTracingMaxSpansDefault = 100'000;
   static constexpr int32_t kShutdownOnsetSecDefault = 10;
+  static constexpr std::string_view kSpillerSpillPathPolicyDefault{
+      "round-robin"};
+  static constexpr uint64_t kSpillerSpillPathMinFreeGbDefault = 0;
+  static constexpr int32_t kSpillCleanupIntervalSecDefault = 300;
+  static constexpr uint64_t kMaxSpillPerNodeGbDefault = 0;
+  static constexpr uint64_t kQueryMaxSpillPerNodeGbDefault = 0;
+  static constexpr int32_t kConfigReloadIntervalSecDefault = 0;
+  static constexpr uint64_t kAnnouncementMaxBackoffMsDefault = 300'000;
+  static constexpr bool kAnnouncementLoadInfoDefault = false;
   static constexpr int32_t kSystemMemoryGbDefault = 40;
   static constexpr int32_t kMmapArenaCapacityRatioDefault = 10;
   static constexpr uint64_t kLocalShuffleMaxPartitionBytesDefault = 1 << 15;
+  static constexpr int32_t kLocalShuffleNumWriteThreadsDefault = 4;
+  static constexpr uint64_t kLocalShuffleMaxInFlightWriteBytesDefault =
+      16 << 20;
+  static constexpr int32_t kLocalShuffleNumReadThreadsDefault = 4;
+  static constexpr uint32_t kLocalShuffleMaxPrefetchBlocksDefault = 4;
+  static constexpr uint64_t kLocalShuffleMaxPrefetchBytesDefault = 16 << 20;
+  static constexpr bool kLocalShuffleReadMmapDefault = false;
+  static constexpr uint64_t kLocalShuffleMemoryStoreBytesDefault = 1UL << 30;
+  static constexpr int32_t kShuffleNumExchangeReadThreadsDefault = 4;
   static constexpr uint64_t kAsyncCacheSsdGbDefault = 0;
   static constexpr uint64_t kAsyncCacheSsdCheckpointGbDefault = 0;
+  static constexpr bool kAsyncCacheProactiveShrinkEnabledDefault = false;
+  static constexpr uint64_t kAsyncCacheFloorGbDefault = 0;
+  static constexpr uint64_t kAsyncCacheCeilingGbDefault = 0;
+  static constexpr int32_t kAsyncCacheWarmerThreadsDefault = 2;
+  static constexpr int32_t kAsyncCacheMaxPinnedPctDefault = 20;
+  static constexpr int32_t kMemoryTrimIntervalSecDefault = 0;
   static constexpr std::string_view kAsyncCacheSsdPathDefault{
       "/mnt/flash/async_cache."};
+  static constexpr int32_t kAsyncCacheSsdShardsDefault = 16;
+  static constexpr int32_t kAsyncCacheSsdIoThreadsDefault = 0;
+  static constexpr bool kAsyncCacheSsdAdmissionEnabledDefault = false;
+  static constexpr int32_t kAsyncCacheSsdAdmissionDecayPctDefault = 10;
   static constexpr std::string_view kShuffleNameDefault{""};
+  static constexpr std::string_view kShuffleSerdeFormatDefault{"unsafe-row"};
+  static constexpr bool kShuffleSortByPartitionKeysDefault = false;
+  static constexpr bool kShuffleFusePartitionAndWriteDefault = false;
+  static constexpr bool kShuffleXxh3HashPartitioningDefault = false;
   static constexpr bool kEnableSerializedPageChecksumDefault = true;
   static constexpr bool kEnableVeloxTaskLoggingDefault = false;
   static constexpr bool kEnableVeloxExprSetLoggingDefault = false;
   static constexpr bool kUseMmapArenaDefault = false;
+  static constexpr bool kMmapAllocatorHugePagesDefault = false;
   static constexpr bool kUseMmapAllocatorDefault{true};
   static constexpr bool kHttpEnableAccessLogDefault = false;
+  static constexpr double kHttpAccessLogSampleRateDefault = 1;
+  static constexpr int64_t kHttpAccessLogSlowRequestMsDefault = 0;
   static constexpr bool kHttpEnableStatsFilterDefault = false;
   static constexpr bool kRegisterTestFunctionsDefault = false;
   static constexpr uint64_t kHttpMaxAllocateBytesDefault = 64 << 10;
+  static constexpr bool kExchangeEnableStreamingDefault = false;
+  static constexpr uint64_t kExchangeMaxResponseBytesDefault = 32 << 20;
+  static constexpr bool kExchangeAdaptiveResponseSizeDefault = false;
+  static constexpr uint64_t kExchangeMinResponseBytesDefault = 1 << 20;
+  static constexpr uint64_t kExchangeNodeMaxQueuedBytesDefault = 0;
+  static constexpr uint64_t kExchangeSpillMaxBytesPerSourceDefault = 1UL << 30;
+  static constexpr uint64_t kExchangeSpillMaxBytesPerNodeDefault = 64UL << 30;
+  static constexpr int32_t kExchangeMinPrefetchedPagesDefault = 0;
+  static constexpr double kOutputBufferSpillMemoryPctDefault = 90;
+  static constexpr uint64_t kOutputBufferSpillMinIdleMsDefault = 5'000;
+  static constexpr uint64_t kOutputBufferSpillMaxBytesPerDestinationDefault =
+      1UL << 30;
+  static constexpr int32_t kExchangeHttpClientNumIoThreadsDefault = 8;
+  static constexpr int32_t kExchangeNumResponseThreadsDefault = 0;
+  static constexpr double kExchangeHedgePercentileDefault = 0;
+  static constexpr uint64_t kExchangeHedgeMinDelayMsDefault = 100;
+  static constexpr int32_t kExchangeHttpClientMaxIdleSessionsDefault = 64;
+  static constexpr uint64_t kExchangeMaxRecycledBufferBytesDefault = 0;
+  static constexpr bool kExchangeEnableBatchedResultsDefault = false;
+  static constexpr bool kExchangeEnablePushDefault = false;
+  static constexpr std::string_view kExchangeCompressionCodecDefault{"none"};
+  static constexpr bool kExchangeEnableInProcessDefault = false;
+  static constexpr int32_t kExchangeAckDelayMsDefault = 0;
+  static constexpr bool kExchangeShareBroadcastsDefault = false;
+  static constexpr int32_t kPlanFragmentCacheMaxEntriesDefault = 128;
+  static constexpr int64_t kConstantBlockCacheMaxBytesDefault = 64 << 20;
+  static constexpr int64_t kCompressedPagesCacheMaxBytesDefault = 256 << 20;
+  static constexpr uint64_t kFragmentResultCacheMaxBytesDefault = 0;
+  static constexpr int32_t kTaskSplitConversionBatchSizeDefault = 1'000;
+  static constexpr int32_t kTaskPlanningThreadsDefault = 4;
+  static constexpr uint64_t kTaskRootStageMaxResultBytesDefault = 0;
+  static constexpr int32_t kTaskMaxSplitPreloadPerDriverDefault = 2;
+  static constexpr bool kTaskAdaptivePartialAggregationDefault = true;
+  static constexpr int64_t kTaskAdaptivePartialAggregationMinRowsDefault =
+      100'000;
+  static constexpr int32_t
+      kTaskAdaptivePartialAggregationMaxUniqueRowsPctDefault = 80;
+  static constexpr bool kTaskSplitPruningEnabledDefault = true;
+  static constexpr int32_t kTaskSplitOrderingRecentFilesDefault = 10'000;
+  static constexpr int32_t kTaskSplitsPerDriverDefault = 1;
+  static constexpr int32_t kTaskWriterCountDefault = 0;
+  static constexpr uint64_t kTaskWriterTargetFileBytesDefault = 0;
+  static constexpr int64_t kTaskAdmissionMaxDriversDefault = 0;
+  static constexpr double kTaskAdmissionMaxMemoryPctDefault = 0;
+  static constexpr double kTaskAdmissionMaxCpuLoadPctDefault = 0;
+  static constexpr int32_t kDriverStuckThresholdSecDefault = 0;
+  static constexpr bool kDriverStuckCancelEnabledDefault = false;
+  static constexpr int32_t kTaskStatsLogRowsPerFileDefault = 100'000;
+  static constexpr int32_t kTaskStatsLogMaxFilesDefault = 100;
+  static constexpr int32_t kTaskStatsLogFlushIntervalSecDefault = 300;
+  static constexpr int32_t kTaskUpdateCaptureMaxFilesDefault = 1'000;
 
   static SystemConfig* instance();
 
+  /// The properties that are read at use or applied by the server on change:
+  /// the http executor threads, the max drivers of the new tasks and the
+  /// buffer sizes of the new exchanges, http clients and shuffles.
+  bool isMutable(const std::string& propertyName) const override;
+
   int httpServerHttpPort() const;
 
   bool httpServerReusePort() const;
 
   bool enableHttps() const;
 
+  bool enableHttp2() const;
+
   int httpServerHttpsPort() const;
 
   // A list of ciphers (comma separated) that are supported by
@@ -202,33 +814,130 @@ class SystemConfig : public ConfigBase {
 
   int32_t maxDriversPerTask() const;
 
+  bool adaptiveDriversPerTask() const;
+
+  int32_t minDriversPerTask() const;
+
   int32_t concurrentLifespansPerTask() const;
 
+  bool adaptiveConcurrentLifespans() const;
+
+  int32_t minConcurrentLifespansPerTask() const;
+
   int32_t httpExecThreads() const;
 
+  int32_t httpCpuThreads() const;
+
+  int32_t httpServerNumAcceptorGroups() const;
+
+  bool httpServerPinAcceptorGroups() const;
+
   // Process-wide number of query execution threads
   int32_t numIoThreads() const;
 
+  bool storageCoalesceReads() const;
+
+  uint64_t storageParallelReadBytes() const;
+
+  int32_t storageNumParallelReadThreads() const;
+
   int32_t numQueryThreads() const;
 
+  bool numaAwareDriverExecutor() const;
+
+  bool fairDriverScheduler() const;
+
   int32_t numSpillThreads() const;
 
   std::string spillerSpillPath() const;
 
+  std::vector<std::string> spillerSpillPaths() const;
+
+  std::string spillerSpillPathPolicy() const;
+
+  uint64_t spillerSpillPathMinFreeGb() const;
+
+  int32_t spillCleanupIntervalSec() const;
+
+  uint64_t maxSpillPerNodeGb() const;
+
+  uint64_t queryMaxSpillPerNodeGb() const;
+
+  bool spillOnMemoryPressure() const;
+
+  int32_t tableCacheStatsMaxTables() const;
+
+  double tracingSampleRate() const;
+
+  int32_t tracingMaxSpans() const;
+
   int32_t shutdownOnsetSec() const;
 
+  int32_t configReloadIntervalSec() const;
+
+  uint64_t announcementMaxBackoffMs() const;
+
+  bool announcementLoadInfo() const;
+
   int32_t systemMemoryGb() const;
 
   uint64_t asyncCacheSsdGb() const;
 
   uint64_t asyncCacheSsdCheckpointGb() const;
 
+  bool asyncCacheProactiveShrinkEnabled() const;
+
+  uint64_t asyncCacheFloorGb() const;
+
+  uint64_t asyncCacheCeilingGb() const;
+
+  int32_t asyncCacheWarmerThreads() const;
+
+  int32_t asyncCacheMaxPinnedPct() const;
+
+  int32_t memoryTrimIntervalSec() const;
+
   uint64_t localShuffleMaxPartitionBytes() const;
 
+  int32_t localShuffleNumWriteThreads() const;
+
+  uint64_t localShuffleMaxInFlightWriteBytes() const;
+
+  int32_t localShuffleNumReadThreads() const;
+
+  uint32_t localShuffleMaxPrefetchBlocks() const;
+
+  uint64_t localShuffleMaxPrefetchBytes() const;
+
+  bool localShuffleReadMmap() const;
+
+  uint64_t localShuffleMemoryStoreBytes() const;
+
+  int32_t shuffleNumExchangeReadThreads() const;
+
   std::string asyncCacheSsdPath() const;
 
+  /// The prefixes listed by async-cache-ssd-path.
+  std::vector<std::string> asyncCacheSsdPaths() const;
+
+  int32_t asyncCacheSsdShards() const;
+
+  int32_t asyncCacheSsdIoThreads() const;
+
+  bool asyncCacheSsdAdmissionEnabled() const;
+
+  int32_t asyncCacheSsdAdmissionDecayPct() const;
+
   std::string shuffleName() const;
 
+  std::string shuffleSerdeFormat() const;
+
+  bool shuffleSortByPartitionKeys() const;
+
+  bool shuffleFusePartitionAndWrite() const;
+
+  bool shuffleXxh3HashPartitioning() const;
+
   bool enableSerializedPageChecksum() const;
 
   bool enableVeloxTaskLogging() const;
@@ -241,13 +950,127 @@ class SystemConfig : public ConfigBase {
 
   bool useMmapAllocator() const;
 
+  bool mmapAllocatorHugePages() const;
+
   bool enableHttpAccessLog() const;
 
+  double httpAccessLogSampleRate() const;
+
+  std::string httpAccessLogEndpointSampleRates() const;
+
+  int64_t httpAccessLogSlowRequestMs() const;
+
+  std::string httpAccessLogPath() const;
+
   bool enableHttpStatsFilter() const;
 
   bool registerTestFunctions() const;
 
   uint64_t httpMaxAllocateBytes() const;
+
+  bool exchangeEnableStreaming() const;
+
+  uint64_t exchangeMaxResponseBytes() const;
+
+  bool exchangeAdaptiveResponseSize() const;
+
+  uint64_t exchangeMinResponseBytes() const;
+
+  uint64_t exchangeNodeMaxQueuedBytes() const;
+
+  std::string exchangeSpillPath() const;
+
+  uint64_t exchangeSpillMaxBytesPerSource() const;
+
+  uint64_t exchangeSpillMaxBytesPerNode() const;
+
+  int32_t exchangeMinPrefetchedPages() const;
+
+  std::string outputBufferSpillPath() const;
+
+  double outputBufferSpillMemoryPct() const;
+
+  uint64_t outputBufferSpillMinIdleMs() const;
+
+  uint64_t outputBufferSpillMaxBytesPerDestination() const;
+
+  int32_t exchangeHttpClientNumIoThreads() const;
+
+  int32_t exchangeNumResponseThreads() const;
+
+  double exchangeHedgePercentile() const;
+
+  uint64_t exchangeHedgeMinDelayMs() const;
+
+  int32_t exchangeHttpClientMaxIdleSessions() const;
+
+  uint64_t exchangeMaxRecycledBufferBytes() const;
+
+  bool exchangeEnableBatchedResults() const;
+
+  bool exchangeEnablePush() const;
+
+  std::string exchangeCompressionCodec() const;
+
+  bool exchangeEnableInProcess() const;
+
+  int32_t exchangeAckDelayMs() const;
+
+  bool exchangeShareBroadcasts() const;
+
+  int32_t planFragmentCacheMaxEntries() const;
+
+  int64_t constantBlockCacheMaxBytes() const;
+
+  int64_t compressedPagesCacheMaxBytes() const;
+
+  uint64_t fragmentResultCacheMaxBytes() const;
+
+  int32_t taskSplitConversionBatchSize() const;
+
+  int32_t taskPlanningThreads() const;
+
+  uint64_t taskRootStageMaxResultBytes() const;
+
+  int32_t taskMaxSplitPreloadPerDriver() const;
+
+  bool taskAdaptivePartialAggregation() const;
+
+  int64_t taskAdaptivePartialAggregationMinRows() const;
+
+  int32_t taskAdaptivePartialAggregationMaxUniqueRowsPct() const;
+
+  bool taskSplitPruningEnabled() const;
+
+  int32_t taskSplitOrderingRecentFiles() const;
+
+  int32_t taskSplitsPerDriver() const;
+
+  int32_t taskWriterCount() const;
+
+  uint64_t taskWriterTargetFileBytes() const;
+
+  int64_t taskAdmissionMaxDrivers() const;
+
+  double taskAdmissionMaxMemoryPct() const;
+
+  double taskAdmissionMaxCpuLoadPct() const;
+
+  int32_t driverStuckThresholdSec() const;
+
+  bool driverStuckCancelEnabled() const;
+
+  std::string taskStatsLogDirectory() const;
+
+  int32_t taskStatsLogRowsPerFile() const;
+
+  int32_t taskStatsLogMaxFiles() const;
+
+  int32_t taskStatsLogFlushIntervalSec() const;
+
+  std::string taskUpdateCaptureDirectory() const;
+
+  int32_t taskUpdateCaptureMaxFiles() const;
 };
 
 /// Provides access to node properties defined in node.properties file.
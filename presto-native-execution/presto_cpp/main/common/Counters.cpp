@@ -22,6 +22,10 @@ void registerPrestoCppCounters() {
       kCounterDriverCPUExecutorQueueSize, facebook::velox::StatType::AVG);
   REPORT_ADD_STAT_EXPORT_TYPE(
       kCounterDriverCPUExecutorLatencyMs, facebook::velox::StatType::AVG);
+  REPORT_ADD_STAT_EXPORT_TYPE(
+      kCounterMaxDriversPerTask, facebook::velox::StatType::AVG);
+  REPORT_ADD_STAT_EXPORT_TYPE(
+      kCounterConcurrentLifespansPerTask, facebook::velox::StatType::AVG);
   REPORT_ADD_STAT_EXPORT_TYPE(
       kCounterHTTPExecutorLatencyMs, facebook::velox::StatType::AVG);
   REPORT_ADD_STAT_EXPORT_TYPE(
@@ -30,6 +34,8 @@ void registerPrestoCppCounters() {
       kCounterNumHTTPRequestError, facebook::velox::StatType::COUNT);
   REPORT_ADD_STAT_EXPORT_TYPE(
       kCounterHTTPRequestLatencyMs, facebook::velox::StatType::AVG);
+  REPORT_ADD_STAT_EXPORT_TYPE(
+      kCounterHttpAccessLogNumDropped, facebook::velox::StatType::COUNT);
   REPORT_ADD_STAT_EXPORT_TYPE(
       kCounterHttpClientPrestoExchangeNumOnBody,
       facebook::velox::StatType::COUNT);
@@ -53,11 +59,88 @@ void registerPrestoCppCounters() {
       95,
       99,
       100);
+  REPORT_ADD_STAT_EXPORT_TYPE(
+      kCounterPrestoExchangeNumThrottledRequests,
+      facebook::velox::StatType::COUNT);
+  REPORT_ADD_STAT_EXPORT_TYPE(
+      kCounterPrestoExchangeNumPrefetchRequests,
+      facebook::velox::StatType::COUNT);
+  REPORT_ADD_STAT_EXPORT_TYPE(
+      kCounterPrestoExchangeSpilledBytes, facebook::velox::StatType::SUM);
+  REPORT_ADD_STAT_EXPORT_TYPE(
+      kCounterPrestoExchangeNumHedgedRequests,
+      facebook::velox::StatType::COUNT);
+  REPORT_ADD_STAT_EXPORT_TYPE(
+      kCounterPrestoExchangeNumHedgeWins, facebook::velox::StatType::COUNT);
+  REPORT_ADD_HISTOGRAM_EXPORT_PERCENTILE(
+      kCounterExchangeResponseQueueLatencyMs,
+      10,
+      0,
+      1000,
+      50,
+      90,
+      95,
+      99,
+      100);
+  REPORT_ADD_HISTOGRAM_EXPORT_PERCENTILE(
+      kCounterExchangePageCompressionRatio, 5, 0, 100, 50, 90, 95, 99, 100);
+  REPORT_ADD_STAT_EXPORT_TYPE(
+      kCounterExchangePageCompressionTimeUs, facebook::velox::StatType::SUM);
+  REPORT_ADD_STAT_EXPORT_TYPE(
+      kCounterExchangePageDecompressionTimeUs, facebook::velox::StatType::SUM);
+  REPORT_ADD_STAT_EXPORT_TYPE(
+      kCounterExchangeNumUncompressiblePages,
+      facebook::velox::StatType::COUNT);
+  REPORT_ADD_STAT_EXPORT_TYPE(
+      kCounterPrestoExchangeNumPiggybackedAcks,
+      facebook::velox::StatType::COUNT);
+  REPORT_ADD_STAT_EXPORT_TYPE(
+      kCounterNumInProcessExchangeSources, facebook::velox::StatType::COUNT);
+  REPORT_ADD_STAT_EXPORT_TYPE(
+      kCounterNumSharedBroadcastSources, facebook::velox::StatType::COUNT);
+  REPORT_ADD_STAT_EXPORT_TYPE(
+      kCounterHttpControlQueueLatencyUs, facebook::velox::StatType::AVG);
+  REPORT_ADD_STAT_EXPORT_TYPE(
+      kCounterHttpDataQueueLatencyUs, facebook::velox::StatType::AVG);
+  REPORT_ADD_STAT_EXPORT_TYPE(
+      kCounterShuffleWrittenBytes, facebook::velox::StatType::SUM);
+  REPORT_ADD_STAT_EXPORT_TYPE(
+      kCounterShuffleNumCreatedFiles, facebook::velox::StatType::COUNT);
+  REPORT_ADD_STAT_EXPORT_TYPE(
+      kCounterShuffleWriteLatencyUs, facebook::velox::StatType::AVG);
+  REPORT_ADD_STAT_EXPORT_TYPE(
+      kCounterShuffleNumBlockedWrites, facebook::velox::StatType::COUNT);
+  REPORT_ADD_STAT_EXPORT_TYPE(
+      kCounterShuffleReadBytes, facebook::velox::StatType::SUM);
+  REPORT_ADD_STAT_EXPORT_TYPE(
+      kCounterShuffleReadLatencyUs, facebook::velox::StatType::AVG);
+  REPORT_ADD_STAT_EXPORT_TYPE(
+      kCounterNumPlanFragmentCacheHits, facebook::velox::StatType::COUNT);
+  REPORT_ADD_STAT_EXPORT_TYPE(
+      kCounterNumPlanFragmentCacheMisses, facebook::velox::StatType::COUNT);
+  REPORT_ADD_HISTOGRAM_EXPORT_PERCENTILE(
+      kCounterTaskPlanningQueueLatencyMs, 10, 0, 1000, 50, 90, 95, 99, 100);
+  REPORT_ADD_HISTOGRAM_EXPORT_PERCENTILE(
+      kCounterTaskPlanningLatencyMs, 10, 0, 1000, 50, 90, 95, 99, 100);
+  REPORT_ADD_STAT_EXPORT_TYPE(
+      kCounterNumConstantBlockCacheHits, facebook::velox::StatType::COUNT);
+  REPORT_ADD_STAT_EXPORT_TYPE(
+      kCounterNumConstantBlockCacheMisses, facebook::velox::StatType::COUNT);
+  REPORT_ADD_STAT_EXPORT_TYPE(
+      kCounterNumCompressedPagesCacheHits, facebook::velox::StatType::COUNT);
+  REPORT_ADD_STAT_EXPORT_TYPE(
+      kCounterNumCompressedPagesCacheMisses, facebook::velox::StatType::COUNT);
+  REPORT_ADD_STAT_EXPORT_TYPE(
+      kCounterNumFragmentResultCacheHits, facebook::velox::StatType::COUNT);
+  REPORT_ADD_STAT_EXPORT_TYPE(
+      kCounterNumFragmentResultCacheMisses, facebook::velox::StatType::COUNT);
   REPORT_ADD_STAT_EXPORT_TYPE(
       kCounterNumQueryContexts, facebook::velox::StatType::AVG);
   REPORT_ADD_STAT_EXPORT_TYPE(kCounterNumTasks, facebook::velox::StatType::AVG);
   REPORT_ADD_STAT_EXPORT_TYPE(
       kCounterNumTasksRunning, facebook::velox::StatType::AVG);
+  REPORT_ADD_STAT_EXPORT_TYPE(
+      kCounterNumTasksQueued, facebook::velox::StatType::AVG);
   REPORT_ADD_STAT_EXPORT_TYPE(
       kCounterNumTasksFinished, facebook::velox::StatType::AVG);
   REPORT_ADD_STAT_EXPORT_TYPE(
@@ -66,6 +149,8 @@ void registerPrestoCppCounters() {
       kCounterNumTasksAborted, facebook::velox::StatType::AVG);
   REPORT_ADD_STAT_EXPORT_TYPE(
       kCounterNumTasksFailed, facebook::velox::StatType::AVG);
+  REPORT_ADD_STAT_EXPORT_TYPE(
+      kCounterNumPrunedSplits, facebook::velox::StatType::SUM);
   REPORT_ADD_STAT_EXPORT_TYPE(
       kCounterNumZombieTasks, facebook::velox::StatType::AVG);
   REPORT_ADD_STAT_EXPORT_TYPE(
@@ -74,6 +159,8 @@ void registerPrestoCppCounters() {
       kCounterNumRunningDrivers, facebook::velox::StatType::AVG);
   REPORT_ADD_STAT_EXPORT_TYPE(
       kCounterNumBlockedDrivers, facebook::velox::StatType::AVG);
+  REPORT_ADD_STAT_EXPORT_TYPE(
+      kCounterNumStuckDrivers, facebook::velox::StatType::AVG);
   REPORT_ADD_STAT_EXPORT_TYPE(
       kCounterMappedMemoryBytes, facebook::velox::StatType::AVG);
   REPORT_ADD_STAT_EXPORT_TYPE(
@@ -83,6 +170,10 @@ void registerPrestoCppCounters() {
   REPORT_ADD_STAT_EXPORT_TYPE(
       kCounterPartitionedOutputBufferGetDataLatencyMs,
       facebook::velox::StatType::AVG);
+  REPORT_ADD_STAT_EXPORT_TYPE(
+      kCounterOutputBufferSpilledBytes, facebook::velox::StatType::SUM);
+  REPORT_ADD_STAT_EXPORT_TYPE(
+      kCounterNumSpilledOutputBuffers, facebook::velox::StatType::AVG);
   REPORT_ADD_STAT_EXPORT_TYPE(
       kCounterOsUserCpuTimeMicros, facebook::velox::StatType::AVG);
   REPORT_ADD_STAT_EXPORT_TYPE(
@@ -102,6 +193,34 @@ void registerPrestoCppCounters() {
       facebook::velox::StatType::AVG);
   REPORT_ADD_STAT_EXPORT_TYPE(
       kCounterMappedMemoryRawAllocBytesLarge, facebook::velox::StatType::AVG);
+  REPORT_ADD_STAT_EXPORT_TYPE(
+      kCounterMemoryTrimReleasedBytes, facebook::velox::StatType::SUM);
+  REPORT_ADD_STAT_EXPORT_TYPE(
+      kCounterNumMemoryTrims, facebook::velox::StatType::COUNT);
+  REPORT_ADD_STAT_EXPORT_TYPE(
+      kCounterHugePageAdvisedBytes, facebook::velox::StatType::AVG);
+  REPORT_ADD_STAT_EXPORT_TYPE(
+      kCounterNumHugePageAdviceFailures, facebook::velox::StatType::COUNT);
+  REPORT_ADD_STAT_EXPORT_TYPE(
+      kCounterAnonHugePageBytes, facebook::velox::StatType::AVG);
+  REPORT_ADD_STAT_EXPORT_TYPE(
+      kCounterNumAnnouncementFailures, facebook::velox::StatType::COUNT);
+  REPORT_ADD_STAT_EXPORT_TYPE(
+      kCounterStartupMemoryInitMs, facebook::velox::StatType::AVG);
+  REPORT_ADD_STAT_EXPORT_TYPE(
+      kCounterStartupConnectorsMs, facebook::velox::StatType::AVG);
+  REPORT_ADD_STAT_EXPORT_TYPE(
+      kCounterStartupFunctionsMs, facebook::velox::StatType::AVG);
+  REPORT_ADD_STAT_EXPORT_TYPE(
+      kCounterStartupMs, facebook::velox::StatType::AVG);
+  REPORT_ADD_STAT_EXPORT_TYPE(
+      kCounterNumSpillCleanupDirectories, facebook::velox::StatType::SUM);
+  REPORT_ADD_STAT_EXPORT_TYPE(
+      kCounterSpillCleanupReclaimedBytes, facebook::velox::StatType::SUM);
+  REPORT_ADD_STAT_EXPORT_TYPE(
+      kCounterSpilledBytes, facebook::velox::StatType::AVG);
+  REPORT_ADD_STAT_EXPORT_TYPE(
+      kCounterNumSpillLimitFailedTasks, facebook::velox::StatType::SUM);
   REPORT_ADD_STAT_EXPORT_TYPE(
       kCounterExchangeSourceQueuedBytes, facebook::velox::StatType::AVG);
   REPORT_ADD_STAT_EXPORT_TYPE(
@@ -131,6 +250,12 @@ void registerPrestoCppCounters() {
       kCounterMemoryCacheTotalTinyPaddingBytes, facebook::velox::StatType::AVG);
   REPORT_ADD_STAT_EXPORT_TYPE(
       kCounterMemoryCacheSumEvictScore, facebook::velox::StatType::AVG);
+  REPORT_ADD_STAT_EXPORT_TYPE(
+      kCounterMemoryCacheTargetBytes, facebook::velox::StatType::AVG);
+  REPORT_ADD_STAT_EXPORT_TYPE(
+      kCounterMemoryCacheNumProactiveShrinks, facebook::velox::StatType::SUM);
+  REPORT_ADD_STAT_EXPORT_TYPE(
+      kCounterMemoryCacheProactiveShrinkBytes, facebook::velox::StatType::SUM);
   REPORT_ADD_STAT_EXPORT_TYPE(
       kCounterMemoryCacheNumCumulativeHit, facebook::velox::StatType::AVG);
   REPORT_ADD_STAT_EXPORT_TYPE(
@@ -178,6 +303,14 @@ void registerPrestoCppCounters() {
       kCounterSsdCacheCumulativeCachedEntries, facebook::velox::StatType::AVG);
   REPORT_ADD_STAT_EXPORT_TYPE(
       kCounterSsdCacheCachedEntries, facebook::velox::StatType::AVG);
+  REPORT_ADD_STAT_EXPORT_TYPE(
+      kCounterSsdCacheRecoveredEntries, facebook::velox::StatType::AVG);
+  REPORT_ADD_STAT_EXPORT_TYPE(
+      kCounterSsdCacheRecoveredBytes, facebook::velox::StatType::AVG);
+  REPORT_ADD_STAT_EXPORT_TYPE(
+      kCounterSsdCacheRecoveryMs, facebook::velox::StatType::AVG);
+  REPORT_ADD_STAT_EXPORT_TYPE(
+      kCounterSsdCacheFillPct, facebook::velox::StatType::AVG);
   REPORT_ADD_STAT_EXPORT_TYPE(
       kCounterSsdCacheCumulativeCachedBytes, facebook::velox::StatType::AVG);
   REPORT_ADD_STAT_EXPORT_TYPE(
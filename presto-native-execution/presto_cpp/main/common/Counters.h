@@ -26,6 +26,17 @@ constexpr folly::StringPiece kCounterDriverCPUExecutorQueueSize{
     "presto_cpp.driver_cpu_executor_queue_size"};
 constexpr folly::StringPiece kCounterDriverCPUExecutorLatencyMs{
     "presto_cpp.driver_cpu_executor_latency_ms"};
+// The number of drivers of the new tasks, adapted to the CPU load.
+constexpr folly::StringPiece kCounterMaxDriversPerTask{
+    "presto_cpp.max_drivers_per_task"};
+// The concurrent lifespans of the new grouped execution tasks, adapted to the
+// memory and CPU headroom.
+constexpr folly::StringPiece kCounterConcurrentLifespansPerTask{
+    "presto_cpp.concurrent_lifespans_per_task"};
+// The average queue latency of the driver tasks of each priority level of the
+// fair driver scheduler.
+constexpr std::string_view kCounterDriverCPUExecutorLevelLatencyMsFormat{
+    "presto_cpp.driver_cpu_executor_level{}_latency_ms"};
 
 constexpr folly::StringPiece kCounterHTTPExecutorLatencyMs{
     "presto_cpp.http_executor_latency_ms"};
@@ -35,6 +46,17 @@ constexpr folly::StringPiece kCounterNumHTTPRequestError{
     "presto_cpp.num_http_request_error"};
 constexpr folly::StringPiece kCounterHTTPRequestLatencyMs{
     "presto_cpp.http_request_latency_ms"};
+// The access log records dropped because the writer fell behind.
+constexpr folly::StringPiece kCounterHttpAccessLogNumDropped{
+    "presto_cpp.http_access_log_num_dropped"};
+// The latency and payload size histograms of each class of task endpoint:
+// create_task, status, info, results, ack and delete.
+constexpr std::string_view kCounterHTTPEndpointLatencyMsFormat{
+    "presto_cpp.http_{}_latency_ms"};
+constexpr std::string_view kCounterHTTPEndpointRequestBytesFormat{
+    "presto_cpp.http_{}_request_bytes"};
+constexpr std::string_view kCounterHTTPEndpointResponseBytesFormat{
+    "presto_cpp.http_{}_response_bytes"};
 
 // Number of http client onBody calls in PrestoExchangeSource.
 constexpr folly::StringPiece kCounterHttpClientPrestoExchangeNumOnBody{
@@ -47,6 +69,122 @@ constexpr folly::StringPiece kCounterHttpClientPrestoExchangeOnBodyBytes{
 // SerializedPage size in bytes from PrestoExchangeSource.
 constexpr folly::StringPiece kCounterPrestoExchangeSerializedPageSize{
     "presto_cpp.presto_exchange_source.serialized_page_size"};
+// Number of data requests deferred by PrestoExchangeSource because the
+// node-wide queued bytes exceeded the configured budget.
+constexpr folly::StringPiece kCounterPrestoExchangeNumThrottledRequests{
+    "presto_cpp.presto_exchange_source.num_throttled_requests"};
+// Number of data requests sent by PrestoExchangeSource without waiting for the
+// consumer because fewer than the configured min number of pages were queued.
+constexpr folly::StringPiece kCounterPrestoExchangeNumPrefetchRequests{
+    "presto_cpp.presto_exchange_source.num_prefetch_requests"};
+// Bytes of the received pages spilled to disk by PrestoExchangeSource while
+// the node-wide queued bytes exceeded the configured budget.
+constexpr folly::StringPiece kCounterPrestoExchangeSpilledBytes{
+    "presto_cpp.presto_exchange_source.spilled_bytes"};
+// Number of the exchange data requests sent again since the first request
+// took longer than the hedging delay.
+constexpr folly::StringPiece kCounterPrestoExchangeNumHedgedRequests{
+    "presto_cpp.presto_exchange_source.num_hedged_requests"};
+// Number of the hedged exchange data requests which completed first.
+constexpr folly::StringPiece kCounterPrestoExchangeNumHedgeWins{
+    "presto_cpp.presto_exchange_source.num_hedge_wins"};
+// Time in milliseconds the exchange responses wait for a thread of the
+// exchange response executor.
+constexpr folly::StringPiece kCounterExchangeResponseQueueLatencyMs{
+    "presto_cpp.exchange.response_queue_latency_ms"};
+// Compressed size of the exchange data responses in percent of their
+// uncompressed size.
+constexpr folly::StringPiece kCounterExchangePageCompressionRatio{
+    "presto_cpp.exchange.page_compression_ratio_percent"};
+// Time spent compressing the exchange data responses in microseconds.
+constexpr folly::StringPiece kCounterExchangePageCompressionTimeUs{
+    "presto_cpp.exchange.page_compression_time_us"};
+// Time spent decompressing the exchange data responses in microseconds.
+constexpr folly::StringPiece kCounterExchangePageDecompressionTimeUs{
+    "presto_cpp.exchange.page_decompression_time_us"};
+// Number of exchange data responses sent uncompressed because compression
+// did not shrink them enough.
+constexpr folly::StringPiece kCounterExchangeNumUncompressiblePages{
+    "presto_cpp.exchange.num_uncompressible_pages"};
+// Number of ack requests PrestoExchangeSource saved by letting the next data
+// request acknowledge the received pages.
+constexpr folly::StringPiece kCounterPrestoExchangeNumPiggybackedAcks{
+    "presto_cpp.presto_exchange_source.num_piggybacked_acks"};
+// Time in microseconds the control requests to the http server, e.g. the task
+// updates, wait for a thread of its CPU executor.
+constexpr folly::StringPiece kCounterHttpControlQueueLatencyUs{
+    "presto_cpp.http.control_queue_latency_us"};
+// Same as above for the data requests, e.g. the result fetches.
+constexpr folly::StringPiece kCounterHttpDataQueueLatencyUs{
+    "presto_cpp.http.data_queue_latency_us"};
+// Number of requests received by each acceptor group of the http server if it
+// has more than one.
+constexpr std::string_view kCounterHttpAcceptorGroupNumRequestsFormat{
+    "presto_cpp.http.acceptor_group{}_num_requests"};
+// Number of exchange sources reading from the output buffers of the tasks on
+// the same worker without http.
+constexpr folly::StringPiece kCounterNumInProcessExchangeSources{
+    "presto_cpp.exchange.num_in_process_sources"};
+// Number of exchange sources reading the pages of a broadcast fetched by
+// another task of the same query on this worker.
+constexpr folly::StringPiece kCounterNumSharedBroadcastSources{
+    "presto_cpp.exchange.num_shared_broadcast_sources"};
+// The counters of the reads of each remote file system, named
+// presto_cpp.storage.<scheme>.<name>: the number of reads, the bytes read and
+// the read latency in microseconds.
+constexpr folly::StringPiece kCounterStorageNumReads{"num_reads"};
+constexpr folly::StringPiece kCounterStorageReadBytes{"read_bytes"};
+constexpr folly::StringPiece kCounterStorageReadLatencyUs{"read_latency_us"};
+// Bytes of the shuffle blocks written by the local persistent shuffle.
+constexpr folly::StringPiece kCounterShuffleWrittenBytes{
+    "presto_cpp.shuffle.written_bytes"};
+// Number of files created by the local persistent shuffle writers.
+constexpr folly::StringPiece kCounterShuffleNumCreatedFiles{
+    "presto_cpp.shuffle.num_created_files"};
+// Latency in microseconds of writing a shuffle block.
+constexpr folly::StringPiece kCounterShuffleWriteLatencyUs{
+    "presto_cpp.shuffle.write_latency_us"};
+// Number of times a shuffle writer blocked its driver because too many bytes
+// were being written.
+constexpr folly::StringPiece kCounterShuffleNumBlockedWrites{
+    "presto_cpp.shuffle.num_blocked_writes"};
+// Bytes of the shuffle blocks read by the local persistent shuffle.
+constexpr folly::StringPiece kCounterShuffleReadBytes{
+    "presto_cpp.shuffle.read_bytes"};
+// Latency in microseconds of reading a shuffle block.
+constexpr folly::StringPiece kCounterShuffleReadLatencyUs{
+    "presto_cpp.shuffle.read_latency_us"};
+// Number of task updates which reused a cached converted plan fragment.
+constexpr folly::StringPiece kCounterNumPlanFragmentCacheHits{
+    "presto_cpp.plan_fragment_cache.num_hits"};
+// Number of task updates which converted their plan fragment.
+constexpr folly::StringPiece kCounterNumPlanFragmentCacheMisses{
+    "presto_cpp.plan_fragment_cache.num_misses"};
+// Time in milliseconds the task updates wait for a thread of the planning
+// executor.
+constexpr folly::StringPiece kCounterTaskPlanningQueueLatencyMs{
+    "presto_cpp.task_planning.queue_latency_ms"};
+// Time in milliseconds to parse a task update and convert its plan fragment.
+constexpr folly::StringPiece kCounterTaskPlanningLatencyMs{
+    "presto_cpp.task_planning.latency_ms"};
+// Number of constant blocks found decoded in the constant block cache.
+constexpr folly::StringPiece kCounterNumConstantBlockCacheHits{
+    "presto_cpp.constant_block_cache.num_hits"};
+// Number of constant blocks decoded for the constant block cache.
+constexpr folly::StringPiece kCounterNumConstantBlockCacheMisses{
+    "presto_cpp.constant_block_cache.num_misses"};
+// Number of data responses found compressed in the compressed pages cache and
+// number of the ones compressed for the cache.
+constexpr folly::StringPiece kCounterNumCompressedPagesCacheHits{
+    "presto_cpp.compressed_pages_cache.num_hits"};
+constexpr folly::StringPiece kCounterNumCompressedPagesCacheMisses{
+    "presto_cpp.compressed_pages_cache.num_misses"};
+// Number of tasks served their rows from the fragment result cache and number
+// of the cacheable tasks that ran their fragment.
+constexpr folly::StringPiece kCounterNumFragmentResultCacheHits{
+    "presto_cpp.fragment_result_cache.num_hits"};
+constexpr folly::StringPiece kCounterNumFragmentResultCacheMisses{
+    "presto_cpp.fragment_result_cache.num_misses"};
 
 constexpr folly::StringPiece kCounterNumQueryContexts{
     "presto_cpp.num_query_contexts"};
@@ -62,6 +200,13 @@ constexpr folly::StringPiece kCounterNumTasksAborted{
     "presto_cpp.num_tasks_aborted"};
 constexpr folly::StringPiece kCounterNumTasksFailed{
     "presto_cpp.num_tasks_failed"};
+// Number of new tasks waiting for the load of the node to admit them.
+constexpr folly::StringPiece kCounterNumTasksQueued{
+    "presto_cpp.num_tasks_queued"};
+// Number of hive splits not added to the tasks because their partition key
+// values or bucket fail the filters of their table scan.
+constexpr folly::StringPiece kCounterNumPrunedSplits{
+    "presto_cpp.num_pruned_splits"};
 constexpr folly::StringPiece kCounterNumZombieTasks{
     "presto_cpp.num_zombie_tasks"};
 constexpr folly::StringPiece kCounterNumZombiePrestoTasks{
@@ -70,6 +215,14 @@ constexpr folly::StringPiece kCounterNumRunningDrivers{
     "presto_cpp.num_running_drivers"};
 constexpr folly::StringPiece kCounterNumBlockedDrivers{
     "presto_cpp.num_blocked_drivers"};
+// The blocked drivers by the reason they are blocked for, e.g.
+// waitForExchange, waitForConsumer or waitForMemory.
+constexpr std::string_view kCounterNumBlockedDriversFormat{
+    "presto_cpp.num_blocked_drivers.{}"};
+// Number of drivers on their threads for longer than the stuck driver
+// threshold.
+constexpr folly::StringPiece kCounterNumStuckDrivers{
+    "presto_cpp.num_stuck_drivers"};
 
 // Number of total PartitionedOutputBuffer managed by all
 // PartitionedOutputBufferManager
@@ -79,6 +232,12 @@ constexpr folly::StringPiece kCounterTotalPartitionedOutputBuffer{
 // PartitionedOutputBufferManager.
 constexpr folly::StringPiece kCounterPartitionedOutputBufferGetDataLatencyMs{
     "presto_cpp.partitioned_output_buffer_get_data_latency_ms"};
+// Bytes of the output buffer pages spilled to disk for the idle consumers.
+constexpr folly::StringPiece kCounterOutputBufferSpilledBytes{
+    "presto_cpp.output_buffer_spilled_bytes"};
+// Number of the output buffer destinations served from disk.
+constexpr folly::StringPiece kCounterNumSpilledOutputBuffers{
+    "presto_cpp.num_spilled_output_buffers"};
 
 // ================== OS Counters =================
 
@@ -132,6 +291,34 @@ constexpr folly::StringPiece kCounterMappedMemoryRawAllocBytesSizeClass{
 // largest SizeClass cannot accommodate, are counted towards this counter.
 constexpr folly::StringPiece kCounterMappedMemoryRawAllocBytesLarge{
     "presto_cpp.mapped_memory_raw_alloc_bytes_large"};
+// Number of bytes of resident memory returned to the OS by the memory trims.
+constexpr folly::StringPiece kCounterMemoryTrimReleasedBytes{
+    "presto_cpp.memory_trim_released_bytes"};
+// Number of memory trims run.
+constexpr folly::StringPiece kCounterNumMemoryTrims{
+    "presto_cpp.num_memory_trims"};
+// Number of bytes of the MmapAllocator address ranges advised to be backed by
+// transparent huge pages.
+constexpr folly::StringPiece kCounterHugePageAdvisedBytes{
+    "presto_cpp.huge_page_advised_bytes"};
+// Number of MmapAllocator address ranges the huge page advice failed for.
+constexpr folly::StringPiece kCounterNumHugePageAdviceFailures{
+    "presto_cpp.num_huge_page_advice_failures"};
+// Number of bytes of the process backed by transparent huge pages.
+constexpr folly::StringPiece kCounterAnonHugePageBytes{
+    "presto_cpp.anon_huge_page_bytes"};
+// Number of the failed announcements to the discovery service.
+constexpr folly::StringPiece kCounterNumAnnouncementFailures{
+    "presto_cpp.num_announcement_failures"};
+// Time in milliseconds of the worker startup steps, and of the whole startup
+// until the worker serves requests.
+constexpr folly::StringPiece kCounterStartupMemoryInitMs{
+    "presto_cpp.startup_memory_init_ms"};
+constexpr folly::StringPiece kCounterStartupConnectorsMs{
+    "presto_cpp.startup_connectors_ms"};
+constexpr folly::StringPiece kCounterStartupFunctionsMs{
+    "presto_cpp.startup_functions_ms"};
+constexpr folly::StringPiece kCounterStartupMs{"presto_cpp.startup_ms"};
 /// Number of bytes currently queued in PrestoExchangeSource waiting for
 /// consume.
 constexpr folly::StringPiece kCounterExchangeSourceQueuedBytes{
@@ -179,6 +366,16 @@ constexpr folly::StringPiece kCounterMemoryCacheTotalPrefetchBytes{
 // for entries in cache.
 constexpr folly::StringPiece kCounterMemoryCacheSumEvictScore{
     "presto_cpp.memory_cache_sum_evict_score"};
+// The bytes the memory cache may hold given the query memory usage, see
+// CacheMemoryPolicy.h.
+constexpr folly::StringPiece kCounterMemoryCacheTargetBytes{
+    "presto_cpp.memory_cache_target_bytes"};
+// Number of times the memory cache is shrunk ahead of the queries.
+constexpr folly::StringPiece kCounterMemoryCacheNumProactiveShrinks{
+    "presto_cpp.memory_cache_num_proactive_shrinks"};
+// Bytes dropped from the memory cache ahead of the queries.
+constexpr folly::StringPiece kCounterMemoryCacheProactiveShrinkBytes{
+    "presto_cpp.memory_cache_proactive_shrink_bytes"};
 // Cumulated number of hits (saved IO). The first hit to a prefetched entry does
 // not count.
 constexpr folly::StringPiece kCounterMemoryCacheNumCumulativeHit{
@@ -246,6 +443,17 @@ constexpr folly::StringPiece kCounterSsdCacheCumulativeCachedBytes{
     "presto_cpp.ssd_cache_cumulative_cached_bytes"};
 constexpr folly::StringPiece kCounterSsdCacheCachedBytes{
     "presto_cpp.ssd_cache_cached_bytes"};
+// The entries and bytes of the SSD cache recovered from its checkpoint on
+// startup, and the time the recovery took.
+constexpr folly::StringPiece kCounterSsdCacheRecoveredEntries{
+    "presto_cpp.ssd_cache_recovered_entries"};
+constexpr folly::StringPiece kCounterSsdCacheRecoveredBytes{
+    "presto_cpp.ssd_cache_recovered_bytes"};
+constexpr folly::StringPiece kCounterSsdCacheRecoveryMs{
+    "presto_cpp.ssd_cache_recovery_ms"};
+// Percentage of the SSD cache capacity holding data, to follow its warmup.
+constexpr folly::StringPiece kCounterSsdCacheFillPct{
+    "presto_cpp.ssd_cache_fill_pct"};
 
 // ================== HiveConnector Counters ==================
 // Format template strings use 'constexpr std::string_view' to be 'fmt::format'
@@ -265,4 +473,35 @@ constexpr std::string_view kCounterHiveFileHandleCacheNumHitsFormat{
     "presto_cpp.{}.hive_file_handle_cache_num_hits"};
 constexpr std::string_view kCounterHiveFileHandleCacheNumLookupsFormat{
     "presto_cpp.{}.hive_file_handle_cache_num_lookups"};
+
+// ================== Spill Path Counters ==================
+// The free bytes of the drive of a spill path, the number of tasks given the
+// path and 1 if it is in the rotation, 0 if not. Formatted with the index of
+// the path in the config.
+constexpr std::string_view kCounterSpillPathFreeBytesFormat{
+    "presto_cpp.spill_path_{}.free_bytes"};
+constexpr std::string_view kCounterSpillPathNumTasksFormat{
+    "presto_cpp.spill_path_{}.num_tasks"};
+constexpr std::string_view kCounterSpillPathHealthyFormat{
+    "presto_cpp.spill_path_{}.healthy"};
+// Number of the orphaned task spill directories deleted and the bytes of
+// their files.
+constexpr folly::StringPiece kCounterNumSpillCleanupDirectories{
+    "presto_cpp.num_spill_cleanup_directories"};
+constexpr folly::StringPiece kCounterSpillCleanupReclaimedBytes{
+    "presto_cpp.spill_cleanup_reclaimed_bytes"};
+// The bytes spilled by the running tasks on this node and the number of the
+// tasks failed for exceeding the spill limits.
+constexpr folly::StringPiece kCounterSpilledBytes{"presto_cpp.spilled_bytes"};
+constexpr folly::StringPiece kCounterNumSpillLimitFailedTasks{
+    "presto_cpp.num_spill_limit_failed_tasks"};
+
+// ================== Table Cache Counters ==================
+// The bytes read by the scans of a table and the percentage of them served
+// from the memory or SSD cache, for the tables with the most bytes read. Only
+// the first 100 distinct tables reported get the counters.
+constexpr std::string_view kCounterTableCacheReadBytesFormat{
+    "presto_cpp.{}.table_cache_read_bytes"};
+constexpr std::string_view kCounterTableCacheHitPctFormat{
+    "presto_cpp.{}.table_cache_hit_pct"};
 } // namespace facebook::presto
@@ -12,6 +12,11 @@
  * limitations under the License.
  */
 #include <gtest/gtest.h>
+#include <unistd.h>
+#include <filesystem>
+#include <fstream>
+#include "presto_cpp/main/common/ByteLruCache.h"
+#include "presto_cpp/main/common/Configs.h"
 #include "presto_cpp/main/common/Exception.h"
 #include "presto_cpp/main/common/Utils.h"
 #include "presto_cpp/presto_protocol/presto_protocol.h"
@@ -118,7 +123,84 @@ TEST(VeloxToPrestoExceptionTranslatorTest, exceptionTranslation) {
   EXPECT_EQ(failureInfo.errorCode.type, protocol::ErrorType::INTERNAL_ERROR);
 }
 
+TEST(ByteLruCacheTest, evictsLeastRecentlyUsed) {
+  ByteLruCache<std::string, int> cache(100);
+  ASSERT_TRUE(cache.put("a", 1, 40));
+  ASSERT_TRUE(cache.put("b", 2, 40));
+  EXPECT_EQ(cache.size(), 2);
+  EXPECT_EQ(cache.bytes(), 80);
+  ASSERT_NE(cache.get("a"), nullptr);
+  EXPECT_EQ(*cache.get("a"), 1);
+
+  // 'b' is the least recently used.
+  ASSERT_TRUE(cache.put("c", 3, 40));
+  EXPECT_EQ(cache.get("b"), nullptr);
+  EXPECT_EQ(cache.bytes(), 80);
+
+  // A new value of a key replaces the old one.
+  ASSERT_TRUE(cache.put("c", 4, 20));
+  EXPECT_EQ(*cache.get("c"), 4);
+  EXPECT_EQ(cache.bytes(), 60);
+
+  // Too large to cache.
+  EXPECT_FALSE(cache.put("d", 5, 101));
+  EXPECT_EQ(cache.get("d"), nullptr);
+  EXPECT_EQ(cache.size(), 2);
+
+  cache.eraseIf([](const auto& key, int /*value*/) { return key == "a"; });
+  EXPECT_EQ(cache.get("a"), nullptr);
+  cache.erase("c");
+  EXPECT_EQ(cache.size(), 0);
+  EXPECT_EQ(cache.bytes(), 0);
+}
+
 TEST(UtilsTest, general) {
   EXPECT_EQ("2021-05-20T19:18:27.001Z", util::toISOTimestamp(1621538307001l));
   EXPECT_EQ("2021-05-20T19:18:27.000Z", util::toISOTimestamp(1621538307000l));
 }
+
+TEST(ConfigTest, update) {
+  const auto path = std::filesystem::temp_directory_path() /
+      fmt::format("config_test_{}.properties", getpid());
+  auto writeConfig = [&](const std::string& content) {
+    std::ofstream out(path);
+    out << content;
+  };
+  writeConfig(
+      "presto.version=1\n"
+      "task.max-drivers-per-task=4\n");
+  SystemConfig config;
+  config.initialize(path.string());
+  EXPECT_EQ(config.maxDriversPerTask(), 4);
+
+  EXPECT_THROW(
+      config.update({{"presto.version", "2"}}),
+      facebook::velox::VeloxUserError);
+  EXPECT_EQ(config.prestoVersion(), "1");
+
+  auto previous = config.update(
+      {{"task.max-drivers-per-task", "8"},
+       {"http_exec_threads", "16"},
+       {"exchange.max-recycled-buffer-bytes", ""}});
+  EXPECT_EQ(previous.size(), 2);
+  EXPECT_EQ(previous["task.max-drivers-per-task"], "4");
+  EXPECT_EQ(previous["http_exec_threads"], "");
+  EXPECT_EQ(config.maxDriversPerTask(), 8);
+  EXPECT_EQ(config.httpExecThreads(), 16);
+  EXPECT_TRUE(config.update({{"http_exec_threads", "16"}}).empty());
+
+  // The removed 'http_exec_threads' is reset to its default, the changed
+  // 'presto.version' waits for a restart.
+  writeConfig(
+      "presto.version=2\n"
+      "task.max-drivers-per-task=2\n");
+  previous = config.reload();
+  EXPECT_EQ(previous.size(), 2);
+  EXPECT_EQ(previous["task.max-drivers-per-task"], "8");
+  EXPECT_EQ(previous["http_exec_threads"], "16");
+  EXPECT_EQ(config.maxDriversPerTask(), 2);
+  EXPECT_EQ(config.httpExecThreads(), SystemConfig::kHttpExecThreadsDefault);
+  EXPECT_EQ(config.prestoVersion(), "1");
+  EXPECT_TRUE(config.reload().empty());
+  std::filesystem::remove(path);
+}
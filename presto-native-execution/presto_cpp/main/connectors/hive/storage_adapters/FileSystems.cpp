@@ -24,13 +24,15 @@
 
 namespace facebook::presto {
 
-void registerOptionalHiveStorageAdapters() {
+void registerOptionalHiveStorageAdapters(const RemoteReadOptions& options) {
 #ifdef PRESTO_ENABLE_S3
-  velox::filesystems::registerS3FileSystem();
+  registerMeteredFileSystem(
+      "s3", options, []() { velox::filesystems::registerS3FileSystem(); });
 #endif
 
 #ifdef PRESTO_ENABLE_HDFS
-  velox::filesystems::registerHdfsFileSystem();
+  registerMeteredFileSystem(
+      "hdfs", options, []() { velox::filesystems::registerHdfsFileSystem(); });
 #endif
 }
 
@@ -12,8 +12,15 @@
  * limitations under the License.
  */
 
+#pragma once
+
+#include "presto_cpp/main/connectors/hive/storage_adapters/MeteredFileSystem.h"
+
 namespace facebook::presto {
 
-void registerOptionalHiveStorageAdapters();
+/// Registers the S3 and HDFS file systems enabled in the build. Their files
+/// are read according to 'options'.
+void registerOptionalHiveStorageAdapters(
+    const RemoteReadOptions& options = {});
 
 } // namespace facebook::presto
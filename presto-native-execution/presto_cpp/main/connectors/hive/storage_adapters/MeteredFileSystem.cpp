@@ -0,0 +1,268 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/connectors/hive/storage_adapters/MeteredFileSystem.h"
+
+#include <fmt/format.h>
+#include <folly/ScopeGuard.h>
+#include <folly/futures/Future.h>
+
+#include "presto_cpp/main/common/Counters.h"
+#include "velox/common/base/StatsReporter.h"
+#include "velox/common/time/Timer.h"
+
+using namespace facebook::velox;
+
+namespace facebook::presto {
+namespace {
+
+std::string counterName(std::string_view scheme, folly::StringPiece name) {
+  return fmt::format("presto_cpp.storage.{}.{}", scheme, name.str());
+}
+
+// The counters of the reads of a file system.
+struct ReadCounters {
+  explicit ReadCounters(std::string_view scheme)
+      : numReads(counterName(scheme, kCounterStorageNumReads)),
+        readBytes(counterName(scheme, kCounterStorageReadBytes)),
+        readLatencyUs(counterName(scheme, kCounterStorageReadLatencyUs)) {
+    REPORT_ADD_STAT_EXPORT_TYPE(numReads, StatType::SUM);
+    REPORT_ADD_STAT_EXPORT_TYPE(readBytes, StatType::SUM);
+    REPORT_ADD_STAT_EXPORT_TYPE(readLatencyUs, StatType::AVG);
+  }
+
+  void record(uint64_t bytes, uint64_t latencyUs) const {
+    REPORT_ADD_STAT_VALUE(numReads, 1);
+    REPORT_ADD_STAT_VALUE(readBytes, bytes);
+    REPORT_ADD_STAT_VALUE(readLatencyUs, latencyUs);
+  }
+
+  const std::string numReads;
+  const std::string readBytes;
+  const std::string readLatencyUs;
+};
+
+class MeteredReadFile : public ReadFile {
+ public:
+  MeteredReadFile(
+      std::unique_ptr<ReadFile> file,
+      const RemoteReadOptions& options,
+      std::shared_ptr<const ReadCounters> counters)
+      : file_(std::move(file)),
+        options_(options),
+        counters_(std::move(counters)) {}
+
+  using ReadFile::pread;
+
+  std::string_view pread(uint64_t offset, uint64_t length, void* buf)
+      const override {
+    uint64_t latencyUs{0};
+    {
+      MicrosecondTimer timer(&latencyUs);
+      if (options_.parallelReadBytes > 0 && options_.executor != nullptr &&
+          length >= 2 * options_.parallelReadBytes) {
+        parallelRead(offset, length, static_cast<char*>(buf));
+      } else {
+        file_->pread(offset, length, buf);
+      }
+    }
+    counters_->record(length, latencyUs);
+    return {static_cast<char*>(buf), length};
+  }
+
+  uint64_t preadv(
+      uint64_t offset,
+      const std::vector<folly::Range<char*>>& buffers) const override {
+    uint64_t latencyUs{0};
+    uint64_t bytes;
+    {
+      MicrosecondTimer timer(&latencyUs);
+      bytes = file_->preadv(offset, buffers);
+    }
+    counters_->record(bytes, latencyUs);
+    return bytes;
+  }
+
+  uint64_t size() const override {
+    return file_->size();
+  }
+
+  uint64_t memoryUsage() const override {
+    return file_->memoryUsage();
+  }
+
+  bool shouldCoalesce() const override {
+    return options_.coalesce || file_->shouldCoalesce();
+  }
+
+  std::string getName() const override {
+    return file_->getName();
+  }
+
+  uint64_t getNaturalReadSize() const override {
+    return file_->getNaturalReadSize();
+  }
+
+ private:
+  // Reads the first range of 'length' bytes at 'offset' into 'buf' on this
+  // thread and the others in parallel on the executor.
+  void parallelRead(uint64_t offset, uint64_t length, char* buf) const {
+    const auto rangeBytes = options_.parallelReadBytes;
+    std::vector<folly::SemiFuture<folly::Unit>> ranges;
+    for (uint64_t begin = rangeBytes; begin < length; begin += rangeBytes) {
+      const auto size = std::min(rangeBytes, length - begin);
+      ranges.push_back(
+          folly::via(
+              options_.executor,
+              [this, offset, begin, size, buf]() {
+                file_->pread(offset + begin, size, buf + begin);
+              })
+              .semi());
+    }
+    std::exception_ptr error;
+    try {
+      file_->pread(offset, rangeBytes, buf);
+    } catch (const std::exception&) {
+      error = std::current_exception();
+    }
+    // The ranges are read into 'buf', so all are waited for before returning.
+    auto results = folly::collectAll(std::move(ranges)).get();
+    if (error) {
+      std::rethrow_exception(error);
+    }
+    for (auto& result : results) {
+      result.value();
+    }
+  }
+
+  const std::unique_ptr<ReadFile> file_;
+  const RemoteReadOptions options_;
+  const std::shared_ptr<const ReadCounters> counters_;
+};
+
+class MeteredFileSystem : public filesystems::FileSystem {
+ public:
+  MeteredFileSystem(
+      std::shared_ptr<filesystems::FileSystem> fileSystem,
+      const RemoteReadOptions& options,
+      std::shared_ptr<const ReadCounters> counters)
+      : FileSystem(nullptr),
+        fileSystem_(std::move(fileSystem)),
+        options_(options),
+        counters_(std::move(counters)) {}
+
+  std::string name() const override {
+    return fileSystem_->name();
+  }
+
+  std::unique_ptr<ReadFile> openFileForRead(std::string_view path) override {
+    return std::make_unique<MeteredReadFile>(
+        fileSystem_->openFileForRead(path), options_, counters_);
+  }
+
+  std::unique_ptr<WriteFile> openFileForWrite(std::string_view path) override {
+    return fileSystem_->openFileForWrite(path);
+  }
+
+  void remove(std::string_view path) override {
+    fileSystem_->remove(path);
+  }
+
+  void rename(
+      std::string_view oldPath,
+      std::string_view newPath,
+      bool overwrite) override {
+    fileSystem_->rename(oldPath, newPath, overwrite);
+  }
+
+  bool exists(std::string_view path) override {
+    return fileSystem_->exists(path);
+  }
+
+  std::vector<std::string> list(std::string_view path) override {
+    return fileSystem_->list(path);
+  }
+
+  void mkdir(std::string_view path) override {
+    fileSystem_->mkdir(path);
+  }
+
+  void rmdir(std::string_view path) override {
+    fileSystem_->rmdir(path);
+  }
+
+ private:
+  const std::shared_ptr<filesystems::FileSystem> fileSystem_;
+  const RemoteReadOptions options_;
+  const std::shared_ptr<const ReadCounters> counters_;
+};
+
+// Set while the wrapped file system is looked up, so that the registry skips
+// the wrapper.
+thread_local bool lookingUpWrapped{false};
+} // namespace
+
+std::shared_ptr<filesystems::FileSystem> makeMeteredFileSystem(
+    std::shared_ptr<filesystems::FileSystem> fileSystem,
+    std::string_view scheme,
+    const RemoteReadOptions& options) {
+  return std::make_shared<MeteredFileSystem>(
+      std::move(fileSystem),
+      options,
+      std::make_shared<const ReadCounters>(scheme));
+}
+
+void registerMeteredFileSystem(
+    std::string_view scheme,
+    const RemoteReadOptions& options,
+    const std::function<void()>& registerFileSystem) {
+  struct State {
+    std::mutex mutex;
+    // The wrappers keyed by the wrapped file system. The registered file
+    // systems are created once per configuration and kept for the process
+    // lifetime.
+    std::unordered_map<
+        const filesystems::FileSystem*,
+        std::shared_ptr<MeteredFileSystem>>
+        wrappers;
+  };
+  auto state = std::make_shared<State>();
+  auto counters = std::make_shared<const ReadCounters>(scheme);
+  // Registered ahead of the wrapped file system: the first matching file
+  // system is used.
+  filesystems::registerFileSystem(
+      [prefix = std::string(scheme)](std::string_view path) {
+        return !lookingUpWrapped && path.substr(0, prefix.size()) == prefix;
+      },
+      [state, counters, options](
+          std::shared_ptr<const Config> config, std::string_view path) {
+        std::shared_ptr<filesystems::FileSystem> fileSystem;
+        {
+          lookingUpWrapped = true;
+          SCOPE_EXIT {
+            lookingUpWrapped = false;
+          };
+          fileSystem = filesystems::getFileSystem(path, std::move(config));
+        }
+        std::lock_guard<std::mutex> l(state->mutex);
+        auto& wrapper = state->wrappers[fileSystem.get()];
+        if (wrapper == nullptr) {
+          wrapper = std::make_shared<MeteredFileSystem>(
+              std::move(fileSystem), options, counters);
+        }
+        return wrapper;
+      });
+  registerFileSystem();
+}
+
+} // namespace facebook::presto
@@ -0,0 +1,52 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <folly/Executor.h>
+
+#include "velox/common/file/FileSystems.h"
+
+namespace facebook::presto {
+
+/// How the reads of a remote file system are done.
+struct RemoteReadOptions {
+  /// If true, the nearby ranges of a file are coalesced into single reads.
+  bool coalesce{false};
+
+  /// The reads of at least this many bytes are split into ranges of this size
+  /// read in parallel on 'executor'. 0 reads each range with one request.
+  uint64_t parallelReadBytes{0};
+
+  /// Runs the parallel ranged reads. Must not run the callers of the reads.
+  folly::Executor* executor{nullptr};
+};
+
+/// Returns 'fileSystem' of 'scheme' wrapped so that its files are read
+/// according to 'options' and report their read latency and bytes as
+/// presto_cpp.storage.<scheme>.* counters.
+std::shared_ptr<velox::filesystems::FileSystem> makeMeteredFileSystem(
+    std::shared_ptr<velox::filesystems::FileSystem> fileSystem,
+    std::string_view scheme,
+    const RemoteReadOptions& options);
+
+/// Wraps the file system 'scheme' created by the registration of
+/// 'registerFileSystem', e.g. one of the velox::filesystems::registerXxx()
+/// functions. The wrapped files are read according to 'options' and report
+/// their read latency and bytes as presto_cpp.storage.<scheme>.* counters.
+void registerMeteredFileSystem(
+    std::string_view scheme,
+    const RemoteReadOptions& options,
+    const std::function<void()>& registerFileSystem);
+
+} // namespace facebook::presto
@@ -11,7 +11,11 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#include <folly/executors/thread_factory/NamedThreadFactory.h>
+#include <folly/io/async/AsyncSSLSocket.h>
+#include <openssl/ssl.h>
 #include <velox/common/base/Exceptions.h>
+#include <velox/common/base/Fs.h>
 
 #include "presto_cpp/main/common/Configs.h"
 #include "presto_cpp/main/http/HttpClient.h"
@@ -21,7 +25,8 @@ HttpClient::HttpClient(
     folly::EventBase* eventBase,
     const folly::SocketAddress& address,
     std::chrono::milliseconds timeout,
-    std::function<void(int)>&& reportOnBodyStatsFunc)
+    std::function<void(int)>&& reportOnBodyStatsFunc,
+    uint32_t maxIdleSessions)
     : eventBase_(eventBase),
       address_(address),
       timer_(folly::HHWheelTimer::newTimer(
@@ -31,7 +36,8 @@ HttpClient::HttpClient(
           timeout)),
       reportOnBodyStatsFunc_(std::move(reportOnBodyStatsFunc)),
       maxResponseAllocBytes_(SystemConfig::instance()->httpMaxAllocateBytes()) {
-  sessionPool_ = std::make_unique<proxygen::SessionPool>(nullptr, 10);
+  sessionPool_ =
+      std::make_unique<proxygen::SessionPool>(nullptr, maxIdleSessions);
 }
 
 HttpClient::~HttpClient() {
@@ -42,16 +48,55 @@ HttpClient::~HttpClient() {
   }
 }
 
+HttpBufferRecycler::~HttpBufferRecycler() {
+  for (auto& [size, buffers] : buffers_) {
+    for (auto* buffer : buffers) {
+      pool_->free(buffer, size);
+    }
+  }
+}
+
+void* HttpBufferRecycler::allocate(uint64_t size) {
+  {
+    std::lock_guard<std::mutex> l(mutex_);
+    auto it = buffers_.find(size);
+    if ((it != buffers_.end()) && !it->second.empty()) {
+      void* buffer = it->second.back();
+      it->second.pop_back();
+      cachedBytes_ -= size;
+      return buffer;
+    }
+  }
+  return pool_->allocate(size);
+}
+
+void HttpBufferRecycler::free(void* buffer, uint64_t size) {
+  {
+    std::lock_guard<std::mutex> l(mutex_);
+    if (cachedBytes_ + size <= maxCachedBytes_) {
+      buffers_[size].push_back(buffer);
+      cachedBytes_ += size;
+      return;
+    }
+  }
+  pool_->free(buffer, size);
+}
+
 HttpResponse::HttpResponse(
     std::unique_ptr<proxygen::HTTPMessage> headers,
     velox::memory::MemoryPool* pool,
     uint64_t minResponseAllocBytes,
-    uint64_t maxResponseAllocBytes)
+    uint64_t maxResponseAllocBytes,
+    std::shared_ptr<HttpBufferRecycler> bufferRecycler)
     : headers_(std::move(headers)),
       pool_(pool),
       minResponseAllocBytes_(minResponseAllocBytes),
-      maxResponseAllocBytes_(maxResponseAllocBytes) {
+      maxResponseAllocBytes_(maxResponseAllocBytes),
+      bufferRecycler_(std::move(bufferRecycler)) {
   VELOX_CHECK_NOT_NULL(pool_);
+  if (bufferRecycler_ != nullptr) {
+    VELOX_CHECK_EQ(bufferRecycler_->pool(), pool_);
+  }
 }
 
 HttpResponse::~HttpResponse() {
@@ -81,7 +126,8 @@ void HttpResponse::append(std::unique_ptr<folly::IOBuf>&& iobuf) {
   const size_t roundedSize = nextAllocationSize(dataLength);
   void* newBuf{nullptr};
   try {
-    newBuf = pool_->allocate(roundedSize);
+    newBuf = bufferRecycler_ != nullptr ? bufferRecycler_->allocate(roundedSize)
+                                        : pool_->allocate(roundedSize);
   } catch (const velox::VeloxException& ex) {
     // NOTE: we need to catch exception and process it later in driver execution
     // context when processing the data response. Otherwise, the presto server
@@ -126,11 +172,17 @@ class ResponseHandler : public proxygen::HTTPTransactionHandler {
       const proxygen::HTTPMessage& request,
       velox::memory::MemoryPool* pool,
       uint64_t maxResponseAllocBytes,
-      const std::string& body,
-      std::function<void(int)> reportOnBodyStatsFunc)
+      std::unique_ptr<folly::IOBuf> body,
+      RequestBodyGenerator bodyGenerator,
+      std::function<void(int)> reportOnBodyStatsFunc,
+      ResponseBodyCallback onBodyCallback,
+      std::shared_ptr<HttpBufferRecycler> bufferRecycler)
       : request_(request),
-        body_(body),
+        body_(std::move(body)),
+        bodyGenerator_(std::move(bodyGenerator)),
         reportOnBodyStatsFunc_(std::move(reportOnBodyStatsFunc)),
+        onBodyCallback_(std::move(onBodyCallback)),
+        bufferRecycler_(std::move(bufferRecycler)),
         pool_(pool),
         minResponseAllocBytes_(velox::memory::AllocationTraits::pageBytes(
             pool_->sizeClasses().front())),
@@ -148,15 +200,22 @@ class ResponseHandler : public proxygen::HTTPTransactionHandler {
     return std::move(future);
   }
 
-  void setTransaction(proxygen::HTTPTransaction* /* txn */) noexcept override {}
+  void setTransaction(proxygen::HTTPTransaction* txn) noexcept override {
+    txn_ = txn;
+  }
   void detachTransaction() noexcept override {
+    txn_ = nullptr;
     self_.reset();
   }
 
   void onHeadersComplete(
       std::unique_ptr<proxygen::HTTPMessage> msg) noexcept override {
     response_ = std::make_unique<HttpResponse>(
-        std::move(msg), pool_, minResponseAllocBytes_, maxResponseAllocBytes_);
+        std::move(msg),
+        pool_,
+        minResponseAllocBytes_,
+        maxResponseAllocBytes_,
+        bufferRecycler_);
   }
 
   void onBody(std::unique_ptr<folly::IOBuf> chain) noexcept override {
@@ -165,6 +224,9 @@ class ResponseHandler : public proxygen::HTTPTransactionHandler {
         reportOnBodyStatsFunc_(chain->length());
       }
       response_->append(std::move(chain));
+      if ((onBodyCallback_ != nullptr) && !response_->hasError()) {
+        onBodyCallback_(response_.get());
+      }
     }
   }
 
@@ -179,41 +241,175 @@ class ResponseHandler : public proxygen::HTTPTransactionHandler {
   void onUpgrade(proxygen::UpgradeProtocol /* protocol*/) noexcept override {}
 
   void onError(const proxygen::HTTPException& error) noexcept override {
-    promise_.setException(error);
+    setException(error);
   }
 
-  void onEgressPaused() noexcept override {}
+  void onEgressPaused() noexcept override {
+    egressPaused_ = true;
+  }
 
-  void onEgressResumed() noexcept override {}
+  void onEgressResumed() noexcept override {
+    egressPaused_ = false;
+    if (bodyGenerator_ != nullptr) {
+      sendGeneratedBody();
+    }
+  }
 
   void onPushedTransaction(
       proxygen::HTTPTransaction* /* pushedTxn */) noexcept override {}
 
   void connectError(const folly::AsyncSocketException& ex) {
-    promise_.setException(ex);
+    setException(ex);
     self_.reset();
   }
 
   void sendRequest(proxygen::HTTPTransaction* txn) {
+    txn_ = txn;
     txn->sendHeaders(request_);
-    if (!body_.empty()) {
-      txn->sendBody(folly::IOBuf::wrapBuffer(body_.c_str(), body_.size()));
+    if (bodyGenerator_ != nullptr) {
+      sendGeneratedBody();
+      return;
+    }
+    if ((body_ != nullptr) && !body_->empty()) {
+      txn->sendBody(std::move(body_));
     }
     txn->sendEOM();
   }
 
  private:
+  // Sends the chunks produced by 'bodyGenerator_' until the end of the body or
+  // the transaction's egress gets paused. In the latter case, the remaining
+  // chunks are sent once the egress is resumed.
+  void sendGeneratedBody() {
+    while ((txn_ != nullptr) && !egressPaused_ && !bodyComplete_) {
+      std::unique_ptr<folly::IOBuf> chunk;
+      try {
+        chunk = bodyGenerator_();
+      } catch (const std::exception& e) {
+        bodyComplete_ = true;
+        setException(std::runtime_error(
+            fmt::format("Failed to generate request body: {}", e.what())));
+        txn_->sendAbort();
+        return;
+      }
+      if (chunk == nullptr) {
+        bodyComplete_ = true;
+        txn_->sendEOM();
+        return;
+      }
+      if (!chunk->empty()) {
+        txn_->sendBody(std::move(chunk));
+      }
+    }
+  }
+
+  template <typename E>
+  void setException(const E& ex) {
+    if (!promise_.isFulfilled()) {
+      promise_.setException(ex);
+    }
+  }
+
   const proxygen::HTTPMessage request_;
-  const std::string body_;
+  std::unique_ptr<folly::IOBuf> body_;
+  const RequestBodyGenerator bodyGenerator_;
   const std::function<void(int)> reportOnBodyStatsFunc_;
+  const ResponseBodyCallback onBodyCallback_;
+  const std::shared_ptr<HttpBufferRecycler> bufferRecycler_;
   velox::memory::MemoryPool* const pool_;
   const uint64_t minResponseAllocBytes_;
   const uint64_t maxResponseAllocBytes_;
   std::unique_ptr<HttpResponse> response_;
   folly::Promise<std::unique_ptr<HttpResponse>> promise_;
   std::shared_ptr<ResponseHandler> self_;
+  proxygen::HTTPTransaction* txn_{nullptr};
+  bool egressPaused_{false};
+  bool bodyComplete_{false};
+};
+
+namespace {
+// The client SSL state shared by all the connections. Loading the certificate
+// and building a context on every connection costs more than the handshake
+// itself.
+struct ClientSslState {
+  std::mutex mutex;
+  std::shared_ptr<folly::SSLContext> context;
+  // The modification time of the certificate file 'context' was loaded from.
+  // A rotated certificate is loaded by the next connection.
+  fs::file_time_type certTime;
+  // The last session negotiated with each server, keyed on its address. The
+  // next connection to the server resumes it instead of a full handshake.
+  std::unordered_map<std::string, std::shared_ptr<SSL_SESSION>> sessions;
 };
 
+ClientSslState& clientSslState() {
+  static ClientSslState state;
+  return state;
+}
+
+// Returns the shared client SSL context, reloaded when the client
+// certificate file has changed.
+std::shared_ptr<folly::SSLContext> clientSslContext() {
+  auto systemConfig = SystemConfig::instance();
+  const auto clientCertAndKeyPath =
+      systemConfig->httpsClientCertAndKeyPath().value();
+  std::error_code ec;
+  const auto certTime = fs::last_write_time(clientCertAndKeyPath, ec);
+  auto& state = clientSslState();
+  std::lock_guard<std::mutex> l(state.mutex);
+  if (state.context != nullptr && (ec || certTime == state.certTime)) {
+    return state.context;
+  }
+  auto sslContext = std::make_shared<folly::SSLContext>();
+  sslContext->loadCertKeyPairFromFiles(
+      clientCertAndKeyPath.c_str(), clientCertAndKeyPath.c_str());
+  sslContext->setCiphersOrThrow(systemConfig->httpsSupportedCiphers());
+  if (systemConfig->enableHttp2()) {
+    sslContext->setAdvertisedNextProtocols(
+        {proxygen::http2::kProtocolString, "http/1.1"});
+  }
+  state.context = std::move(sslContext);
+  state.certTime = certTime;
+  // The sessions were negotiated with the previous certificate.
+  state.sessions.clear();
+  return state.context;
+}
+
+// Returns a reference to the last session negotiated with 'address' for the
+// connector to take, or nullptr if there is none.
+SSL_SESSION* resumableSslSession(const folly::SocketAddress& address) {
+  auto& state = clientSslState();
+  std::lock_guard<std::mutex> l(state.mutex);
+  auto it = state.sessions.find(address.describe());
+  if (it == state.sessions.end()) {
+    return nullptr;
+  }
+  SSL_SESSION_up_ref(it->second.get());
+  return it->second.get();
+}
+
+// Keeps the session negotiated by 'session' with 'address' for the next
+// connection.
+void saveSslSession(
+    const folly::SocketAddress& address,
+    proxygen::HTTPUpstreamSession* session) {
+  auto* sslSocket = session->getTransport()
+                        ->getUnderlyingTransport<folly::AsyncSSLSocket>();
+  if (sslSocket == nullptr) {
+    return;
+  }
+  // Returns an owned reference.
+  SSL_SESSION* sslSession = sslSocket->getSSLSession();
+  if (sslSession == nullptr) {
+    return;
+  }
+  auto& state = clientSslState();
+  std::lock_guard<std::mutex> l(state.mutex);
+  state.sessions[address.describe()] =
+      std::shared_ptr<SSL_SESSION>(sslSession, SSL_SESSION_free);
+}
+} // namespace
+
 class ConnectionHandler : public proxygen::HTTPConnector::Callback {
  public:
   ConnectionHandler(
@@ -230,22 +426,22 @@ class ConnectionHandler : public proxygen::HTTPConnector::Callback {
 
   void connect() {
     connector_ = std::make_unique<proxygen::HTTPConnector>(this, timer_);
-    auto systemConfig = SystemConfig::instance();
-    if (systemConfig->enableHttps()) {
-      auto ciphers = systemConfig->httpsSupportedCiphers();
-      auto clientCertAndKeyPath =
-          systemConfig->httpsClientCertAndKeyPath().value();
-      auto context = std::make_shared<folly::SSLContext>();
-      context->loadCertKeyPairFromFiles(
-          clientCertAndKeyPath.c_str(), clientCertAndKeyPath.c_str());
-      context->setCiphersOrThrow(ciphers);
-      connector_->connectSSL(eventBase_, address_, context);
+    if (SystemConfig::instance()->enableHttps()) {
+      // The connector takes the reference to the resumed session.
+      connector_->connectSSL(
+          eventBase_,
+          address_,
+          clientSslContext(),
+          resumableSslSession(address_));
     } else {
       connector_->connect(eventBase_, address_);
     }
   }
 
   void connectSuccess(proxygen::HTTPUpstreamSession* session) override {
+    if (SystemConfig::instance()->enableHttps()) {
+      saveSslSession(address_, session);
+    }
     auto txn = session->newTransaction(responseHandler_.get());
     if (txn) {
       responseHandler_->sendRequest(txn);
@@ -272,9 +468,55 @@ class ConnectionHandler : public proxygen::HTTPConnector::Callback {
 folly::SemiFuture<std::unique_ptr<HttpResponse>> HttpClient::sendRequest(
     const proxygen::HTTPMessage& request,
     velox::memory::MemoryPool* pool,
-    const std::string& body) {
-  auto responseHandler = std::make_shared<ResponseHandler>(
-      request, pool, maxResponseAllocBytes_, body, reportOnBodyStatsFunc_);
+    std::string body,
+    ResponseBodyCallback onBody,
+    std::shared_ptr<HttpBufferRecycler> bufferRecycler) {
+  return sendRequest(
+      request,
+      pool,
+      body.empty() ? nullptr : folly::IOBuf::fromString(std::move(body)),
+      std::move(onBody),
+      std::move(bufferRecycler));
+}
+
+folly::SemiFuture<std::unique_ptr<HttpResponse>> HttpClient::sendRequest(
+    const proxygen::HTTPMessage& request,
+    velox::memory::MemoryPool* pool,
+    std::unique_ptr<folly::IOBuf> body,
+    ResponseBodyCallback onBody,
+    std::shared_ptr<HttpBufferRecycler> bufferRecycler) {
+  return doSendRequest(std::make_shared<ResponseHandler>(
+      request,
+      pool,
+      maxResponseAllocBytes_,
+      std::move(body),
+      nullptr,
+      reportOnBodyStatsFunc_,
+      std::move(onBody),
+      std::move(bufferRecycler)));
+}
+
+folly::SemiFuture<std::unique_ptr<HttpResponse>>
+HttpClient::sendStreamingRequest(
+    const proxygen::HTTPMessage& request,
+    velox::memory::MemoryPool* pool,
+    RequestBodyGenerator bodyGenerator,
+    ResponseBodyCallback onBody,
+    std::shared_ptr<HttpBufferRecycler> bufferRecycler) {
+  VELOX_CHECK_NOT_NULL(bodyGenerator);
+  return doSendRequest(std::make_shared<ResponseHandler>(
+      request,
+      pool,
+      maxResponseAllocBytes_,
+      nullptr,
+      std::move(bodyGenerator),
+      reportOnBodyStatsFunc_,
+      std::move(onBody),
+      std::move(bufferRecycler)));
+}
+
+folly::SemiFuture<std::unique_ptr<HttpResponse>> HttpClient::doSendRequest(
+    std::shared_ptr<ResponseHandler> responseHandler) {
   auto future = responseHandler->initialize(responseHandler);
 
   eventBase_->runInEventBaseThreadAlwaysEnqueue([this, responseHandler]() {
@@ -297,4 +539,59 @@ folly::SemiFuture<std::unique_ptr<HttpResponse>> HttpClient::sendRequest(
   return future;
 }
 
+HttpClientPool::HttpClientPool(
+    size_t numIoThreads,
+    std::chrono::milliseconds timeout,
+    uint32_t maxIdleSessions,
+    std::function<void(int)> reportOnBodyStatsFunc,
+    folly::EventBase* eventBase)
+    : timeout_(timeout),
+      maxIdleSessions_(maxIdleSessions),
+      reportOnBodyStatsFunc_(std::move(reportOnBodyStatsFunc)),
+      eventBase_(eventBase) {
+  if (numIoThreads > 0) {
+    ioExecutor_ = std::make_unique<folly::IOThreadPoolExecutor>(
+        numIoThreads,
+        std::make_shared<folly::NamedThreadFactory>("HttpClientIO"));
+  } else {
+    VELOX_CHECK_NOT_NULL(
+        eventBase_, "Event base must be set if there are no IO threads");
+  }
+}
+
+HttpClientPool::~HttpClientPool() {
+  // Destroy the clients while their event base threads are still running.
+  clients_.wlock()->clear();
+}
+
+folly::EventBase* HttpClientPool::nextEventBase() {
+  if (ioExecutor_ == nullptr) {
+    return eventBase_;
+  }
+  return ioExecutor_->getEventBase();
+}
+
+std::shared_ptr<HttpClient> HttpClientPool::getClient(
+    const folly::SocketAddress& address) {
+  {
+    auto clients = clients_.rlock();
+    auto it = clients->find(address);
+    if (it != clients->end()) {
+      return it->second;
+    }
+  }
+  auto clients = clients_.wlock();
+  auto& client = (*clients)[address];
+  if (client == nullptr) {
+    auto reportOnBodyStatsFunc = reportOnBodyStatsFunc_;
+    client = std::make_shared<HttpClient>(
+        nextEventBase(),
+        address,
+        timeout_,
+        std::move(reportOnBodyStatsFunc),
+        maxIdleSessions_);
+  }
+  return client;
+}
+
 } // namespace facebook::presto::http
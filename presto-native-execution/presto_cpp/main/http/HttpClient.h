@@ -12,8 +12,11 @@
  * limitations under the License.
  */
 #pragma once
+#include <folly/Synchronized.h>
+#include <folly/executors/IOThreadPoolExecutor.h>
 #include <folly/futures/Future.h>
 #include <proxygen/lib/http/HTTPConnector.h>
+#include <proxygen/lib/http/codec/HTTP2Constants.h>
 #include <proxygen/lib/http/connpool/SessionPool.h>
 #include <proxygen/lib/http/session/HTTPUpstreamSession.h>
 #include <velox/common/memory/MemoryPool.h>
@@ -22,14 +25,61 @@
 
 namespace facebook::presto::http {
 
+/// Caches the freed http response buffers by size so that the back-to-back
+/// responses of the same caller reuse the hot buffers instead of doing a
+/// memory pool round trip for every body chunk. The cached buffers stay
+/// allocated from 'pool' until they are reused or the recycler is destroyed,
+/// and at most 'maxCachedBytes' are cached.
+///
+/// NOTE: this class is thread safe as the buffers are allocated on the http
+/// client's event base thread and freed by the response consumer.
+class HttpBufferRecycler {
+ public:
+  HttpBufferRecycler(velox::memory::MemoryPool* pool, uint64_t maxCachedBytes)
+      : pool_(pool), maxCachedBytes_(maxCachedBytes) {
+    VELOX_CHECK_NOT_NULL(pool_);
+  }
+
+  ~HttpBufferRecycler();
+
+  /// Returns a buffer of 'size' bytes, either a cached one or a new one
+  /// allocated from the memory pool. Throws if the allocation fails.
+  void* allocate(uint64_t size);
+
+  /// Returns 'buffer' of 'size' bytes to the cache, or frees it to the memory
+  /// pool if the cache is full.
+  void free(void* buffer, uint64_t size);
+
+  velox::memory::MemoryPool* pool() const {
+    return pool_;
+  }
+
+  uint64_t cachedBytes() const {
+    std::lock_guard<std::mutex> l(mutex_);
+    return cachedBytes_;
+  }
+
+ private:
+  velox::memory::MemoryPool* const pool_;
+  const uint64_t maxCachedBytes_;
+
+  mutable std::mutex mutex_;
+  // The cached buffers keyed by their size.
+  std::unordered_map<uint64_t, std::vector<void*>> buffers_;
+  uint64_t cachedBytes_{0};
+};
+
 /// NOTE: this class is not thread safe.
 class HttpResponse {
  public:
+  /// If 'bufferRecycler' is set, the body buffers are allocated from and freed
+  /// to it instead of 'pool'.
   HttpResponse(
       std::unique_ptr<proxygen::HTTPMessage> headers,
       velox::memory::MemoryPool* pool,
       uint64_t minResponseAllocBytes,
-      uint64_t maxResponseAllocBytes);
+      uint64_t maxResponseAllocBytes,
+      std::shared_ptr<HttpBufferRecycler> bufferRecycler = nullptr);
 
   ~HttpResponse();
 
@@ -63,13 +113,17 @@ class HttpResponse {
   }
 
   /// Consumes the response body. The caller is responsible for freeing the
-  /// backed memory of this IOBuf from MappedMemory. Otherwise it could lead to
-  /// memory leak.
+  /// backed memory of this IOBuf from MappedMemory, or to bufferRecycler() if
+  /// set. Otherwise it could lead to memory leak.
   std::vector<std::unique_ptr<folly::IOBuf>> consumeBody() {
     VELOX_CHECK(!hasError());
     return std::move(bodyChain_);
   }
 
+  const std::shared_ptr<HttpBufferRecycler>& bufferRecycler() const {
+    return bufferRecycler_;
+  }
+
   std::string dumpBodyChain() const;
 
  private:
@@ -82,7 +136,12 @@ class HttpResponse {
 
   void freeBuffers() {
     for (auto& iobuf : bodyChain_) {
-      if (iobuf != nullptr) {
+      if (iobuf == nullptr) {
+        continue;
+      }
+      if (bufferRecycler_ != nullptr) {
+        bufferRecycler_->free(iobuf->writableData(), iobuf->capacity());
+      } else {
         pool_->free(iobuf->writableData(), iobuf->capacity());
       }
     }
@@ -96,12 +155,27 @@ class HttpResponse {
   velox::memory::MemoryPool* const pool_;
   const uint64_t minResponseAllocBytes_;
   const uint64_t maxResponseAllocBytes_;
+  const std::shared_ptr<HttpBufferRecycler> bufferRecycler_;
 
   std::string error_{};
   std::vector<std::unique_ptr<folly::IOBuf>> bodyChain_;
   size_t bodyChainBytes_{0};
 };
 
+/// Invoked on the HttpClient's EventBase thread every time a chunk of response
+/// body has been appended to 'response'. It allows the caller to consume the
+/// response body incrementally through HttpResponse::consumeBody() instead of
+/// waiting for the entire response to arrive. The callback must not throw.
+using ResponseBodyCallback = std::function<void(HttpResponse* response)>;
+
+/// Invoked on the HttpClient's EventBase thread to produce the next chunk of a
+/// streamed request body. Returns nullptr at the end of the body. It is only
+/// called while the connection can accept more data so that a large body is
+/// never fully buffered in memory.
+using RequestBodyGenerator = std::function<std::unique_ptr<folly::IOBuf>()>;
+
+class ResponseHandler;
+
 // HttpClient uses proxygen::SessionPool which must be destructed on the
 // EventBase thread. Hence, the destructor of HttpClient must run on the
 // EventBase thread as well. Consider running HttpClient's destructor
@@ -112,17 +186,48 @@ class HttpClient {
       folly::EventBase* FOLLY_NONNULL eventBase,
       const folly::SocketAddress& address,
       std::chrono::milliseconds timeout,
-      std::function<void(int)>&& reportOnBodyStatsFunc = nullptr);
+      std::function<void(int)>&& reportOnBodyStatsFunc = nullptr,
+      uint32_t maxIdleSessions = 10);
 
   ~HttpClient();
 
-  // TODO Avoid copy by using IOBuf for body
+  folly::EventBase* eventBase() const {
+    return eventBase_;
+  }
+
+  /// If 'onBody' is set, it is invoked for each received chunk of the response
+  /// body before the returned future is fulfilled on the end of the message.
+  /// 'body' is moved into the sent IOBuf without copying it.
   folly::SemiFuture<std::unique_ptr<HttpResponse>> sendRequest(
       const proxygen::HTTPMessage& request,
       velox::memory::MemoryPool* pool,
-      const std::string& body = "");
+      std::string body = "",
+      ResponseBodyCallback onBody = nullptr,
+      std::shared_ptr<HttpBufferRecycler> bufferRecycler = nullptr);
+
+  /// Same as above but sends the 'body' chain as is without flattening or
+  /// copying it. 'body' can be nullptr for an empty body.
+  folly::SemiFuture<std::unique_ptr<HttpResponse>> sendRequest(
+      const proxygen::HTTPMessage& request,
+      velox::memory::MemoryPool* pool,
+      std::unique_ptr<folly::IOBuf> body,
+      ResponseBodyCallback onBody = nullptr,
+      std::shared_ptr<HttpBufferRecycler> bufferRecycler = nullptr);
+
+  /// Sends a request whose body is produced incrementally by 'bodyGenerator'.
+  /// 'request' must use chunked transfer encoding as the body size is not
+  /// known upfront.
+  folly::SemiFuture<std::unique_ptr<HttpResponse>> sendStreamingRequest(
+      const proxygen::HTTPMessage& request,
+      velox::memory::MemoryPool* pool,
+      RequestBodyGenerator bodyGenerator,
+      ResponseBodyCallback onBody = nullptr,
+      std::shared_ptr<HttpBufferRecycler> bufferRecycler = nullptr);
 
  private:
+  folly::SemiFuture<std::unique_ptr<HttpResponse>> doSendRequest(
+      std::shared_ptr<ResponseHandler> responseHandler);
+
   folly::EventBase* const eventBase_;
   const folly::SocketAddress address_;
   const folly::HHWheelTimer::UniquePtr timer_;
@@ -132,6 +237,49 @@ class HttpClient {
   std::unique_ptr<proxygen::SessionPool> sessionPool_;
 };
 
+/// A pool of HttpClients shared by all the callers talking to the same
+/// upstream (host, port). Each upstream is served by a single HttpClient which
+/// is pinned to one of the pool's IO event bases, so the concurrent callers
+/// reuse the keep-alive sessions of its proxygen::SessionPool instead of
+/// opening a new connection per caller. The upstreams are assigned to the
+/// event bases in a round robin fashion to spread the IO load.
+///
+/// NOTE: this class is thread safe. The returned clients must not outlive the
+/// pool.
+class HttpClientPool {
+ public:
+  /// If 'numIoThreads' is zero, all the clients run on 'eventBase' which must
+  /// then outlive this pool, otherwise the pool owns 'numIoThreads' event base
+  /// threads.
+  HttpClientPool(
+      size_t numIoThreads,
+      std::chrono::milliseconds timeout,
+      uint32_t maxIdleSessions,
+      std::function<void(int)> reportOnBodyStatsFunc = nullptr,
+      folly::EventBase* eventBase = nullptr);
+
+  ~HttpClientPool();
+
+  /// Returns the client for 'address'. Creates one on first use.
+  std::shared_ptr<HttpClient> getClient(const folly::SocketAddress& address);
+
+  size_t numClients() const {
+    return clients_.rlock()->size();
+  }
+
+ private:
+  folly::EventBase* nextEventBase();
+
+  const std::chrono::milliseconds timeout_;
+  const uint32_t maxIdleSessions_;
+  const std::function<void(int)> reportOnBodyStatsFunc_;
+  folly::EventBase* const eventBase_;
+  std::unique_ptr<folly::IOThreadPoolExecutor> ioExecutor_;
+  folly::Synchronized<
+      std::unordered_map<folly::SocketAddress, std::shared_ptr<HttpClient>>>
+      clients_;
+};
+
 class RequestBuilder {
  public:
   RequestBuilder() {
@@ -160,17 +308,66 @@ class RequestBuilder {
     return *this;
   }
 
+  /// Allocates the response body buffers from 'bufferRecycler'.
+  RequestBuilder& bufferRecycler(
+      std::shared_ptr<HttpBufferRecycler> bufferRecycler) {
+    bufferRecycler_ = std::move(bufferRecycler);
+    return *this;
+  }
+
   folly::SemiFuture<std::unique_ptr<HttpResponse>> send(
       HttpClient* client,
       velox::memory::MemoryPool* pool,
-      const std::string& body = "") {
+      std::string body = "",
+      ResponseBodyCallback onBody = nullptr) {
     header(proxygen::HTTP_HEADER_CONTENT_LENGTH, std::to_string(body.size()));
     headers_.ensureHostHeader();
-    return client->sendRequest(headers_, pool, body);
+    return client->sendRequest(
+        headers_,
+        pool,
+        std::move(body),
+        std::move(onBody),
+        std::move(bufferRecycler_));
+  }
+
+  folly::SemiFuture<std::unique_ptr<HttpResponse>> send(
+      HttpClient* client,
+      velox::memory::MemoryPool* pool,
+      std::unique_ptr<folly::IOBuf> body,
+      ResponseBodyCallback onBody = nullptr) {
+    header(
+        proxygen::HTTP_HEADER_CONTENT_LENGTH,
+        std::to_string(body == nullptr ? 0 : body->computeChainDataLength()));
+    headers_.ensureHostHeader();
+    return client->sendRequest(
+        headers_,
+        pool,
+        std::move(body),
+        std::move(onBody),
+        std::move(bufferRecycler_));
+  }
+
+  /// Sends the body produced by 'bodyGenerator' with chunked transfer
+  /// encoding.
+  folly::SemiFuture<std::unique_ptr<HttpResponse>> sendStreaming(
+      HttpClient* client,
+      velox::memory::MemoryPool* pool,
+      RequestBodyGenerator bodyGenerator,
+      ResponseBodyCallback onBody = nullptr) {
+    headers_.getHeaders().remove(proxygen::HTTP_HEADER_CONTENT_LENGTH);
+    headers_.setIsChunked(true);
+    headers_.ensureHostHeader();
+    return client->sendStreamingRequest(
+        headers_,
+        pool,
+        std::move(bodyGenerator),
+        std::move(onBody),
+        std::move(bufferRecycler_));
   }
 
  private:
   proxygen::HTTPMessage headers_;
+  std::shared_ptr<HttpBufferRecycler> bufferRecycler_;
 };
 
 } // namespace facebook::presto::http
@@ -17,9 +17,13 @@ namespace facebook::presto::http {
 const uint16_t kHttpOk = 200;
 const uint16_t kHttpAccepted = 202;
 const uint16_t kHttpNoContent = 204;
+const uint16_t kHttpNotModified = 304;
+const uint16_t kHttpBadRequest = 400;
 const uint16_t kHttpNotFound = 404;
 const uint16_t kHttpInternalServerError = 500;
 
 const char kMimeTypeApplicationJson[] = "application/json";
+const char kMimeTypeApplicationJsonPatch[] = "application/json-patch+json";
 const char kMimeTypeApplicationThrift[] = "application/x-thrift+binary";
+const char kMimeTypePrometheusText[] = "text/plain; version=0.0.4";
 } // namespace facebook::presto::http
@@ -14,9 +14,177 @@
 
 #include "presto_cpp/main/http/HttpServer.h"
 #include <algorithm>
+#include <cstring>
+#include <folly/compression/Compression.h>
+#include <folly/executors/thread_factory/NamedThreadFactory.h>
+#include <folly/synchronization/Baton.h>
+#include <pthread.h>
+#include <sched.h>
 #include "presto_cpp/main/common/Configs.h"
+#include "presto_cpp/main/common/Counters.h"
+#include "presto_cpp/main/http/JsonWriter.h"
+#include "velox/common/base/StatsReporter.h"
 
 namespace facebook::presto::http {
+namespace {
+// Adds the tasks of an endpoint class to the shared CPU executor at the
+// priority of the class and reports how long they wait in its queue.
+class EndpointClassExecutor : public folly::Executor {
+ public:
+  EndpointClassExecutor(
+      folly::CPUThreadPoolExecutor* executor,
+      EndpointClass endpointClass)
+      : executor_(executor),
+        priority_(
+            endpointClass == EndpointClass::kControl ? folly::Executor::HI_PRI
+                                                     : folly::Executor::LO_PRI),
+        queueLatencyCounter_(
+            endpointClass == EndpointClass::kControl
+                ? kCounterHttpControlQueueLatencyUs
+                : kCounterHttpDataQueueLatencyUs) {}
+
+  void add(folly::Func func) override {
+    addWithPriority(std::move(func), priority_);
+  }
+
+  void addWithPriority(folly::Func func, int8_t priority) override {
+    executor_->addWithPriority(
+        [func = std::move(func),
+         counter = queueLatencyCounter_,
+         enqueueTime = std::chrono::steady_clock::now()]() mutable {
+          REPORT_ADD_STAT_VALUE(
+              counter,
+              std::chrono::duration_cast<std::chrono::microseconds>(
+                  std::chrono::steady_clock::now() - enqueueTime)
+                  .count());
+          func();
+        },
+        priority);
+  }
+
+  uint8_t getNumPriorities() const override {
+    return executor_->getNumPriorities();
+  }
+
+ private:
+  folly::CPUThreadPoolExecutor* const executor_;
+  const int8_t priority_;
+  const folly::StringPiece queueLatencyCounter_;
+};
+
+// Names the io threads of an acceptor group and pins them to 'cpus' if not
+// empty.
+class AcceptorGroupThreadFactory : public folly::NamedThreadFactory {
+ public:
+  AcceptorGroupThreadFactory(
+      const std::string& prefix,
+      std::vector<int32_t> cpus)
+      : folly::NamedThreadFactory(prefix), cpus_(std::move(cpus)) {}
+
+  std::thread newThread(folly::Func&& func) override {
+    return folly::NamedThreadFactory::newThread(
+        [cpus = cpus_, func = std::move(func)]() mutable {
+          if (!cpus.empty()) {
+            cpu_set_t cpuSet;
+            CPU_ZERO(&cpuSet);
+            for (auto cpu : cpus) {
+              CPU_SET(cpu, &cpuSet);
+            }
+            if (pthread_setaffinity_np(
+                    pthread_self(), sizeof(cpuSet), &cpuSet) != 0) {
+              LOG(WARNING) << "Failed to pin an http io thread to its CPUs";
+            }
+          }
+          func();
+        });
+  }
+
+ private:
+  const std::vector<int32_t> cpus_;
+};
+
+// Returns the contiguous share of the CPUs of the acceptor group 'group'.
+std::vector<int32_t> acceptorGroupCpus(int group, int numGroups) {
+  const int numCpus = std::max(1u, std::thread::hardware_concurrency());
+  std::vector<int32_t> cpus;
+  for (int cpu = group * numCpus / numGroups;
+       cpu < (group + 1) * numCpus / numGroups;
+       ++cpu) {
+    cpus.push_back(cpu);
+  }
+  if (cpus.empty()) {
+    // More groups than CPUs.
+    cpus.push_back(group % numCpus);
+  }
+  return cpus;
+}
+
+// Returns the number of io threads of the acceptor group 'group'.
+int acceptorGroupThreads(int group, int numGroups, int numThreads) {
+  return numThreads / numGroups + (group < numThreads % numGroups ? 1 : 0);
+}
+
+void enableReusePort(proxygen::HTTPServer::IPConfig& ipConfig) {
+  folly::SocketOptionKey portReuseOpt = {SOL_SOCKET, SO_REUSEPORT};
+  if (!ipConfig.acceptorSocketOptions.has_value()) {
+    ipConfig.acceptorSocketOptions.emplace();
+  }
+  ipConfig.acceptorSocketOptions->insert({portReuseOpt, 1});
+}
+
+// Lets the servers of the acceptor groups share a handler factory.
+class SharedRequestHandlerFactory : public proxygen::RequestHandlerFactory {
+ public:
+  explicit SharedRequestHandlerFactory(
+      std::shared_ptr<proxygen::RequestHandlerFactory> factory)
+      : factory_(std::move(factory)) {}
+
+  void onServerStart(folly::EventBase* evb) noexcept override {
+    factory_->onServerStart(evb);
+  }
+
+  void onServerStop() noexcept override {
+    factory_->onServerStop();
+  }
+
+  proxygen::RequestHandler* onRequest(
+      proxygen::RequestHandler* handler,
+      proxygen::HTTPMessage* message) noexcept override {
+    return factory_->onRequest(handler, message);
+  }
+
+ private:
+  const std::shared_ptr<proxygen::RequestHandlerFactory> factory_;
+};
+
+// Counts the requests received by an acceptor group. Goes first in the
+// handler chain and passes the handler of the rest through.
+class AcceptorGroupCounter : public proxygen::RequestHandlerFactory {
+ public:
+  AcceptorGroupCounter(int group, std::atomic<uint64_t>& numRequests)
+      : counter_(
+            fmt::format(kCounterHttpAcceptorGroupNumRequestsFormat, group)),
+        numRequests_(numRequests) {
+    REPORT_ADD_STAT_EXPORT_TYPE(counter_, facebook::velox::StatType::SUM);
+  }
+
+  void onServerStart(folly::EventBase* /*evb*/) noexcept override {}
+
+  void onServerStop() noexcept override {}
+
+  proxygen::RequestHandler* onRequest(
+      proxygen::RequestHandler* handler,
+      proxygen::HTTPMessage* /*message*/) noexcept override {
+    numRequests_.fetch_add(1, std::memory_order_relaxed);
+    REPORT_ADD_STAT_VALUE(counter_, 1);
+    return handler;
+  }
+
+ private:
+  const std::string counter_;
+  std::atomic<uint64_t>& numRequests_;
+};
+} // namespace
 
 void sendOkResponse(proxygen::ResponseHandler* downstream) {
   proxygen::ResponseBuilder(downstream)
@@ -29,7 +197,7 @@ void sendOkResponse(proxygen::ResponseHandler* downstream, const json& body) {
       .status(http::kHttpOk, "OK")
       .header(
           proxygen::HTTP_HEADER_CONTENT_TYPE, http::kMimeTypeApplicationJson)
-      .body(body.dump())
+      .body(toJsonIOBuf(body))
       .sendWithEOM();
 }
 
@@ -44,14 +212,25 @@ void sendOkResponse(
       .sendWithEOM();
 }
 
+void sendOkResponse(
+    proxygen::ResponseHandler* downstream,
+    std::unique_ptr<folly::IOBuf> body) {
+  proxygen::ResponseBuilder(downstream)
+      .status(http::kHttpOk, "OK")
+      .header(
+          proxygen::HTTP_HEADER_CONTENT_TYPE, http::kMimeTypeApplicationJson)
+      .body(std::move(body))
+      .sendWithEOM();
+}
+
 void sendOkThriftResponse(
     proxygen::ResponseHandler* downstream,
-    const std::string& body) {
+    std::unique_ptr<folly::IOBuf> body) {
   proxygen::ResponseBuilder(downstream)
       .status(http::kHttpOk, "OK")
       .header(
           proxygen::HTTP_HEADER_CONTENT_TYPE, http::kMimeTypeApplicationThrift)
-      .body(body)
+      .body(std::move(body))
       .sendWithEOM();
 }
 
@@ -76,6 +255,60 @@ void sendErrorResponse(
       .sendWithEOM();
 }
 
+std::string bodyToString(
+    const std::vector<std::unique_ptr<folly::IOBuf>>& body) {
+  size_t size = 0;
+  for (const auto& buf : body) {
+    size += buf->computeChainDataLength();
+  }
+  std::string result;
+  result.reserve(size);
+  for (const auto& buf : body) {
+    for (const auto& range : *buf) {
+      result.append(reinterpret_cast<const char*>(range.data()), range.size());
+    }
+  }
+  return result;
+}
+
+std::string bodyToString(const folly::IOBuf& body) {
+  std::string result;
+  result.reserve(body.computeChainDataLength());
+  for (const auto& range : body) {
+    result.append(reinterpret_cast<const char*>(range.data()), range.size());
+  }
+  return result;
+}
+
+std::unique_ptr<folly::IOBuf> bodyToIOBuf(
+    const std::vector<std::unique_ptr<folly::IOBuf>>& body) {
+  auto result = folly::IOBuf::create(0);
+  for (const auto& buf : body) {
+    // The clones share the buffers of 'body'.
+    result->prev()->appendChain(buf->clone());
+  }
+  return result;
+}
+
+std::unique_ptr<folly::IOBuf> decodeBody(
+    const folly::IOBuf& body,
+    std::string_view contentEncoding) {
+  if (contentEncoding.empty() || contentEncoding == "identity") {
+    return body.clone();
+  }
+  folly::io::CodecType codecType;
+  if (contentEncoding == "gzip") {
+    codecType = folly::io::CodecType::GZIP;
+  } else if (contentEncoding == "zstd") {
+    codecType = folly::io::CodecType::ZSTD;
+  } else {
+    VELOX_USER_FAIL("Unsupported Content-Encoding: {}", contentEncoding);
+  }
+  // The codecs decompress the chain buffer by buffer without coalescing it
+  // and without knowing the decompressed size upfront.
+  return folly::io::getCodec(codecType)->uncompress(&body);
+}
+
 HttpConfig::HttpConfig(const folly::SocketAddress& address, bool reusePort)
     : address_(address), reusePort_(reusePort) {}
 
@@ -83,9 +316,7 @@ proxygen::HTTPServer::IPConfig HttpConfig::ipConfig() const {
   proxygen::HTTPServer::IPConfig ipConfig{
       address_, proxygen::HTTPServer::Protocol::HTTP};
   if (reusePort_) {
-    folly::SocketOptionKey portReuseOpt = {SOL_SOCKET, SO_REUSEPORT};
-    ipConfig.acceptorSocketOptions.emplace();
-    ipConfig.acceptorSocketOptions->insert({portReuseOpt, 1});
+    enableReusePort(ipConfig);
   }
   return ipConfig;
 }
@@ -95,12 +326,14 @@ HttpsConfig::HttpsConfig(
     const std::string& certPath,
     const std::string& keyPath,
     const std::string& supportedCiphers,
-    bool reusePort)
+    bool reusePort,
+    bool http2Enabled)
     : address_(address),
       certPath_(certPath),
       keyPath_(keyPath),
       supportedCiphers_(supportedCiphers),
-      reusePort_(reusePort) {
+      reusePort_(reusePort),
+      http2Enabled_(http2Enabled) {
   // Wangle separates ciphers by ":" where in the config it's separated with ","
   std::replace(supportedCiphers_.begin(), supportedCiphers_.end(), ',', ':');
 }
@@ -115,13 +348,15 @@ proxygen::HTTPServer::IPConfig HttpsConfig::ipConfig() const {
       folly::SSLContext::VerifyClientCertificate::DO_NOT_REQUEST;
   sslCfg.setCertificate(certPath_, keyPath_, "");
   sslCfg.sslCiphers = supportedCiphers_;
+  if (http2Enabled_) {
+    // Proxygen picks the session codec by the negotiated protocol.
+    sslCfg.setNextProtocols({proxygen::http2::kProtocolString, "http/1.1"});
+  }
 
   ipConfig.sslConfigs.push_back(sslCfg);
 
   if (reusePort_) {
-    folly::SocketOptionKey portReuseOpt = {SOL_SOCKET, SO_REUSEPORT};
-    ipConfig.acceptorSocketOptions.emplace();
-    ipConfig.acceptorSocketOptions->insert({portReuseOpt, 1});
+    enableReusePort(ipConfig);
   }
   return ipConfig;
 }
@@ -129,15 +364,83 @@ proxygen::HTTPServer::IPConfig HttpsConfig::ipConfig() const {
 HttpServer::HttpServer(
     std::unique_ptr<HttpConfig> httpConfig,
     std::unique_ptr<HttpsConfig> httpsConfig,
-    int httpExecThreads)
+    int httpExecThreads,
+    int httpCpuThreads,
+    int numAcceptorGroups,
+    bool pinAcceptorGroups)
     : httpConfig_(std::move(httpConfig)),
       httpsConfig_(std::move(httpsConfig)),
       httpExecThreads_(httpExecThreads),
       handlerFactory_(std::make_unique<DispatchingRequestHandlerFactory>()),
-      httpExecutor_{std::make_shared<folly::IOThreadPoolExecutor>(
-          httpExecThreads,
-          std::make_shared<folly::NamedThreadFactory>("HTTPSrvExec"))} {
+      numGroupRequests_(numAcceptorGroups) {
   VELOX_CHECK((httpConfig_ != nullptr) || (httpsConfig_ != nullptr));
+  VELOX_USER_CHECK_GE(numAcceptorGroups, 1);
+  VELOX_USER_CHECK_LE(
+      numAcceptorGroups,
+      httpExecThreads,
+      "Each acceptor group needs at least one http io thread");
+  const bool multipleGroups = numAcceptorGroups > 1;
+  for (int group = 0; group < numAcceptorGroups; ++group) {
+    executors_.push_back(std::make_shared<folly::IOThreadPoolExecutor>(
+        acceptorGroupThreads(group, numAcceptorGroups, httpExecThreads),
+        std::make_shared<AcceptorGroupThreadFactory>(
+            multipleGroups ? fmt::format("HTTPSrvExec{}_", group)
+                           : "HTTPSrvExec",
+            multipleGroups && pinAcceptorGroups
+                ? acceptorGroupCpus(group, numAcceptorGroups)
+                : std::vector<int32_t>{})));
+  }
+  httpExecutor_ = executors_[0];
+  if (httpCpuThreads > 0) {
+    httpCpuExecutor_ = std::make_unique<folly::CPUThreadPoolExecutor>(
+        httpCpuThreads,
+        2,
+        std::make_shared<folly::NamedThreadFactory>("HTTPSrvCpu"));
+    controlExecutor_ = std::make_unique<EndpointClassExecutor>(
+        httpCpuExecutor_.get(), EndpointClass::kControl);
+    dataExecutor_ = std::make_unique<EndpointClassExecutor>(
+        httpCpuExecutor_.get(), EndpointClass::kData);
+  }
+}
+
+namespace {
+bool isRegexSyntax(char c) {
+  return std::strchr("\\.^$|?*+()[]{}", c) != nullptr;
+}
+
+bool isQuantifier(char c) {
+  return c == '?' || c == '*' || c == '+' || c == '{';
+}
+} // namespace
+
+DispatchingRequestHandlerFactory::EndPoint::EndPoint(
+    const std::string& pattern,
+    const EndpointRequestHandlerFactory& factory)
+    : re_(pattern), factory_(factory) {
+  // An alternation may apply to the whole pattern, so nothing is known about
+  // the literal text of the matching paths.
+  if (pattern.find('|') != std::string::npos) {
+    return;
+  }
+  const auto first =
+      std::find_if(pattern.begin(), pattern.end(), isRegexSyntax);
+  if (first == pattern.end()) {
+    literal_ = true;
+    literalPrefix_ = pattern;
+    return;
+  }
+  literalPrefix_.assign(pattern.begin(), first);
+  // A quantifier applies to the character before it.
+  if (isQuantifier(*first) && !literalPrefix_.empty()) {
+    literalPrefix_.pop_back();
+  }
+  const auto last =
+      std::find_if(pattern.rbegin(), pattern.rend(), isRegexSyntax);
+  // The character after a backslash is an escape sequence, e.g. '\d', not
+  // literal text.
+  if (*last != '\\') {
+    literalSuffix_.assign(last.base(), pattern.end());
+  }
 }
 
 proxygen::RequestHandler*
@@ -147,6 +450,22 @@ DispatchingRequestHandlerFactory::EndPoint::checkAndApply(
     std::vector<std::string>& matches,
     std::vector<RE2::Arg>& args,
     std::vector<RE2::Arg*>& argPtrs) const {
+  if (path.size() < literalPrefix_.size() + literalSuffix_.size() ||
+      path.compare(0, literalPrefix_.size(), literalPrefix_) != 0 ||
+      path.compare(
+          path.size() - literalSuffix_.size(),
+          literalSuffix_.size(),
+          literalSuffix_) != 0) {
+    return nullptr;
+  }
+  if (literal_) {
+    if (path.size() != literalPrefix_.size()) {
+      return nullptr;
+    }
+    matches.resize(1);
+    matches[0] = path;
+    return factory_(message, matches);
+  }
   auto numArgs = re_.NumberOfCapturingGroups();
   matches.resize(numArgs + 1);
   args.resize(numArgs);
@@ -211,10 +530,27 @@ void DispatchingRequestHandlerFactory::registerEndPoint(
   }
 }
 
-void HttpServer::start(
-    std::vector<std::unique_ptr<proxygen::RequestHandlerFactory>> filters,
-    std::function<void(proxygen::HTTPServer* /*server*/)> onSuccess,
-    std::function<void(std::exception_ptr)> onError) {
+void HttpServer::setNumExecThreads(int numThreads) {
+  const int numGroups = executors_.size();
+  VELOX_USER_CHECK_GE(numThreads, numGroups);
+  for (int group = 0; group < numGroups; ++group) {
+    executors_[group]->setNumThreads(
+        acceptorGroupThreads(group, numGroups, numThreads));
+  }
+}
+
+std::vector<uint64_t> HttpServer::numRequestsPerAcceptorGroup() const {
+  std::vector<uint64_t> numRequests;
+  for (const auto& groupRequests : numGroupRequests_) {
+    numRequests.push_back(groupRequests.load(std::memory_order_relaxed));
+  }
+  return numRequests;
+}
+
+std::unique_ptr<proxygen::HTTPServer> HttpServer::makeServer(
+    int group,
+    const std::vector<std::shared_ptr<proxygen::RequestHandlerFactory>>&
+        handlerFactories) {
   proxygen::HTTPServerOptions options;
   // The 'threads' field is not used when we provide our own executor (see us
   // passing httpExecutor_ below) to the start() method. In that case we create
@@ -223,17 +559,15 @@ void HttpServer::start(
   options.idleTimeout = std::chrono::milliseconds(60'000);
   options.enableContentCompression = false;
 
-  proxygen::RequestHandlerChain handlerFactories;
-
-  // Register all filters passed to the http server.
-  for (size_t i = 0; i < filters.size(); ++i) {
-    if (filters[i] != nullptr) {
-      handlerFactories.addThen(std::move(filters[i]));
-    }
+  proxygen::RequestHandlerChain chain;
+  if (executors_.size() > 1) {
+    chain.addThen(std::make_unique<AcceptorGroupCounter>(
+        group, numGroupRequests_[group]));
   }
-
-  handlerFactories.addThen(std::move(handlerFactory_));
-  options.handlerFactories = handlerFactories.build();
+  for (const auto& factory : handlerFactories) {
+    chain.addThen(std::make_unique<SharedRequestHandlerFactory>(factory));
+  }
+  options.handlerFactories = chain.build();
 
   // Increase the default flow control to 1MB/10MB
   options.initialReceiveWindow = uint32_t(1 << 20);
@@ -241,7 +575,24 @@ void HttpServer::start(
   options.receiveSessionWindowSize = 10 * (1 << 20);
   options.h2cEnabled = true;
 
-  server_ = std::make_unique<proxygen::HTTPServer>(std::move(options));
+  return std::make_unique<proxygen::HTTPServer>(std::move(options));
+}
+
+void HttpServer::start(
+    std::vector<std::unique_ptr<proxygen::RequestHandlerFactory>> filters,
+    std::function<void(proxygen::HTTPServer* /*server*/)> onSuccess,
+    std::function<void(std::exception_ptr)> onError) {
+  // Register all filters passed to the http server.
+  std::vector<std::shared_ptr<proxygen::RequestHandlerFactory>>
+      handlerFactories;
+  for (auto& filter : filters) {
+    if (filter != nullptr) {
+      handlerFactories.emplace_back(std::move(filter));
+    }
+  }
+  handlerFactories.emplace_back(std::move(handlerFactory_));
+
+  server_ = makeServer(0, handlerFactories);
 
   std::vector<proxygen::HTTPServer::IPConfig> ipConfigs;
 
@@ -253,11 +604,18 @@ void HttpServer::start(
     ipConfigs.push_back(httpsConfig_->ipConfig());
   }
 
+  if (executors_.size() > 1) {
+    for (auto& ipConfig : ipConfigs) {
+      enableReusePort(ipConfig);
+    }
+  }
+
   server_->bind(ipConfigs);
 
   LOG(INFO) << "STARTUP: proxygen::HTTPServer::start()";
   server_->start(
       [&]() {
+        startAcceptorGroups(ipConfigs, handlerFactories, onError);
         if (onSuccess) {
           onSuccess(server_.get());
         }
@@ -266,4 +624,54 @@ void HttpServer::start(
       nullptr,
       httpExecutor_);
 }
+
+void HttpServer::startAcceptorGroups(
+    std::vector<proxygen::HTTPServer::IPConfig> ipConfigs,
+    const std::vector<std::shared_ptr<proxygen::RequestHandlerFactory>>&
+        handlerFactories,
+    const std::function<void(std::exception_ptr)>& onError) {
+  if (numAcceptorGroups() == 1) {
+    return;
+  }
+  // Binds the other groups to the ports the first group got, e.g. for port 0.
+  const auto& addresses = server_->addresses();
+  VELOX_CHECK_EQ(addresses.size(), ipConfigs.size());
+  for (size_t i = 0; i < ipConfigs.size(); ++i) {
+    ipConfigs[i].address = addresses[i].address;
+  }
+  for (int group = 1; group < numAcceptorGroups(); ++group) {
+    groupServers_.push_back(makeServer(group, handlerFactories));
+    auto* server = groupServers_.back().get();
+    server->bind(ipConfigs);
+    auto started = std::make_shared<folly::Baton<>>();
+    groupThreads_.emplace_back(
+        [server, started, onError, executor = executors_[group]]() {
+          server->start(
+              [started]() { started->post(); },
+              [started, onError](std::exception_ptr error) {
+                started->post();
+                if (onError) {
+                  onError(error);
+                }
+              },
+              nullptr,
+              executor);
+        });
+    started->wait();
+  }
+  LOG(INFO) << "STARTUP: Started " << executors_.size()
+            << " http acceptor groups";
+}
+
+void HttpServer::stop() {
+  for (auto& server : groupServers_) {
+    server->stop();
+  }
+  for (auto& thread : groupThreads_) {
+    thread.join();
+  }
+  groupThreads_.clear();
+  groupServers_.clear();
+  server_->stop();
+}
 } // namespace facebook::presto::http
@@ -13,9 +13,14 @@
  */
 #pragma once
 #include <fmt/core.h>
+#include <atomic>
+#include <thread>
+#include <folly/executors/CPUThreadPoolExecutor.h>
+#include <folly/executors/IOThreadPoolExecutor.h>
 #include <proxygen/httpserver/HTTPServer.h>
 #include <proxygen/httpserver/RequestHandlerFactory.h>
 #include <proxygen/httpserver/ResponseBuilder.h>
+#include <proxygen/lib/http/codec/HTTP2Constants.h>
 #include <re2/re2.h>
 #include <wangle/ssl/SSLContextConfig.h>
 #include "presto_cpp/external/json/json.hpp"
@@ -33,15 +38,41 @@ void sendOkResponse(
     proxygen::ResponseHandler* downstream,
     const std::string& body);
 
+/// Sends the JSON document 'body', e.g. written by JsonWriter.
+void sendOkResponse(
+    proxygen::ResponseHandler* downstream,
+    std::unique_ptr<folly::IOBuf> body);
+
+/// Sends the Thrift encoded 'body', e.g. from thriftWrite().
 void sendOkThriftResponse(
     proxygen::ResponseHandler* downstream,
-    const std::string& body);
+    std::unique_ptr<folly::IOBuf> body);
 
 void sendErrorResponse(
     proxygen::ResponseHandler* downstream,
     const std::string& error = "",
     uint16_t status = http::kHttpInternalServerError);
 
+/// Concatenates the request 'body' into a single string.
+std::string bodyToString(
+    const std::vector<std::unique_ptr<folly::IOBuf>>& body);
+
+/// Concatenates the chained 'body' into a single string.
+std::string bodyToString(const folly::IOBuf& body);
+
+/// Chains the request 'body' buffers without copying their bytes, e.g. to
+/// decode it once the request handler is gone.
+std::unique_ptr<folly::IOBuf> bodyToIOBuf(
+    const std::vector<std::unique_ptr<folly::IOBuf>>& body);
+
+/// Decompresses the chained request 'body' as per the value of its
+/// Content-Encoding header, i.e. 'gzip' or 'zstd'. Returns a clone sharing the
+/// buffers of 'body' if 'contentEncoding' is empty or 'identity'. Throws if the
+/// encoding is not supported.
+std::unique_ptr<folly::IOBuf> decodeBody(
+    const folly::IOBuf& body,
+    std::string_view contentEncoding);
+
 class AbstractRequestHandler : public proxygen::RequestHandler {
  public:
   void onRequest(
@@ -177,6 +208,11 @@ using EndpointRequestHandlerFactory = std::function<proxygen::RequestHandler*(
     proxygen::HTTPMessage* message,
     const std::vector<std::string>& args)>;
 
+/// Dispatches the requests to the first endpoint registered for their method
+/// whose pattern fully matches their path. The literal prefix and suffix of
+/// each pattern are extracted on registration so that most of the endpoints
+/// are ruled out by string comparisons. The patterns without any regex syntax
+/// are matched by string equality, only the others run RE2.
 class DispatchingRequestHandlerFactory
     : public proxygen::RequestHandlerFactory {
  public:
@@ -198,8 +234,7 @@ class DispatchingRequestHandlerFactory
    public:
     EndPoint(
         const std::string& pattern,
-        const EndpointRequestHandlerFactory& factory)
-        : re_(pattern), factory_(factory) {}
+        const EndpointRequestHandlerFactory& factory);
 
     proxygen::RequestHandler* checkAndApply(
         const std::string& path,
@@ -211,6 +246,11 @@ class DispatchingRequestHandlerFactory
    private:
     RE2 re_;
     EndpointRequestHandlerFactory factory_;
+    // True if the pattern has no regex syntax, i.e. only matches itself.
+    bool literal_{false};
+    // The literal text every matching path starts and ends with.
+    std::string literalPrefix_;
+    std::string literalSuffix_;
   };
 
   std::unordered_map<
@@ -232,12 +272,14 @@ class HttpConfig {
 
 class HttpsConfig {
  public:
+  /// If 'http2Enabled' is true, HTTP/2 is offered over ALPN ahead of HTTP/1.1.
   HttpsConfig(
       const folly::SocketAddress& address,
       const std::string& certPath,
       const std::string& keyPath,
       const std::string& supportedCiphers,
-      bool reusePort = false);
+      bool reusePort = false,
+      bool http2Enabled = false);
 
   proxygen::HTTPServer::IPConfig ipConfig() const;
 
@@ -247,14 +289,32 @@ class HttpsConfig {
   const std::string keyPath_;
   std::string supportedCiphers_;
   const bool reusePort_;
+  const bool http2Enabled_;
 };
 
+/// The classes of the endpoints which process their requests off the io
+/// threads. The queued control requests, e.g. the task updates from the
+/// coordinator, run before the queued data requests so that a burst of result
+/// fetches does not delay them.
+enum class EndpointClass { kControl, kData };
+
 class HttpServer {
  public:
+  /// If 'httpCpuThreads' is non-zero, the server has a CPU executor of that
+  /// many threads shared by the endpoint classes, see getCpuExecutor().
+  ///
+  /// If 'numAcceptorGroups' is more than one, the server runs that many
+  /// proxygen servers bound to the same ports with SO_REUSEPORT, so that the
+  /// kernel spreads the connections over their acceptors. Each group has its
+  /// own share of the 'httpExecThreads' io threads, pinned to its share of the
+  /// CPUs if 'pinAcceptorGroups' is true.
   explicit HttpServer(
       std::unique_ptr<HttpConfig> httpConfig,
       std::unique_ptr<HttpsConfig> httpsConfig = nullptr,
-      int httpExecThreads = 8);
+      int httpExecThreads = 8,
+      int httpCpuThreads = 0,
+      int numAcceptorGroups = 1,
+      bool pinAcceptorGroups = false);
 
   void start(
       std::vector<std::unique_ptr<proxygen::RequestHandlerFactory>> filters =
@@ -262,14 +322,42 @@ class HttpServer {
       std::function<void(proxygen::HTTPServer* /*server*/)> onSuccess = nullptr,
       std::function<void(std::exception_ptr)> onError = nullptr);
 
+  /// Returns the io threads of the first acceptor group.
   folly::IOThreadPoolExecutor* getExecutor() {
     return httpExecutor_.get();
   }
 
-  void stop() {
-    server_->stop();
+  /// Returns the io threads of all the acceptor groups, the first group first.
+  std::vector<folly::IOThreadPoolExecutor*> getExecutors() const {
+    std::vector<folly::IOThreadPoolExecutor*> executors;
+    executors.reserve(executors_.size());
+    for (const auto& executor : executors_) {
+      executors.push_back(executor.get());
+    }
+    return executors;
+  }
+
+  /// Resizes the io threads of the acceptor groups to 'numThreads' in total.
+  void setNumExecThreads(int numThreads);
+
+  int numAcceptorGroups() const {
+    return executors_.size();
   }
 
+  /// Returns the number of requests received by each acceptor group.
+  std::vector<uint64_t> numRequestsPerAcceptorGroup() const;
+
+  /// Returns the executor to process the requests of 'endpointClass' on
+  /// instead of the io threads, or null if the server has no CPU executor. The
+  /// handlers still respond on the io thread which received the request. The
+  /// time each task waits in the queue is reported per endpoint class.
+  folly::Executor* getCpuExecutor(EndpointClass endpointClass) const {
+    return endpointClass == EndpointClass::kControl ? controlExecutor_.get()
+                                                    : dataExecutor_.get();
+  }
+
+  void stop();
+
   void registerGet(
       const std::string& pattern,
       const EndpointRequestHandlerFactory& endpoint) {
@@ -341,7 +429,34 @@ class HttpServer {
   int httpExecThreads_;
   std::unique_ptr<DispatchingRequestHandlerFactory> handlerFactory_;
   std::unique_ptr<proxygen::HTTPServer> server_;
+  // The io threads of each acceptor group. The first is 'httpExecutor_'.
+  std::vector<std::shared_ptr<folly::IOThreadPoolExecutor>> executors_;
   std::shared_ptr<folly::IOThreadPoolExecutor> httpExecutor_;
+  std::vector<std::atomic<uint64_t>> numGroupRequests_;
+  // The servers of the acceptor groups after the first, which is 'server_',
+  // and the threads their event loops run on.
+  std::vector<std::unique_ptr<proxygen::HTTPServer>> groupServers_;
+  std::vector<std::thread> groupThreads_;
+  // Add to 'httpCpuExecutor_' at the priority of their endpoint class. Declared
+  // first to outlive the tasks draining from 'httpCpuExecutor_' on destruction.
+  std::unique_ptr<folly::Executor> controlExecutor_;
+  std::unique_ptr<folly::Executor> dataExecutor_;
+  std::unique_ptr<folly::CPUThreadPoolExecutor> httpCpuExecutor_;
+
+  // Returns a proxygen server for the acceptor group 'group' that hands the
+  // requests to 'handlerFactories'.
+  std::unique_ptr<proxygen::HTTPServer> makeServer(
+      int group,
+      const std::vector<std::shared_ptr<proxygen::RequestHandlerFactory>>&
+          handlerFactories);
+
+  // Starts the acceptor groups after the first on the ports 'server_' is
+  // bound to.
+  void startAcceptorGroups(
+      std::vector<proxygen::HTTPServer::IPConfig> ipConfigs,
+      const std::vector<std::shared_ptr<proxygen::RequestHandlerFactory>>&
+          handlerFactories,
+      const std::function<void(std::exception_ptr)>& onError);
 
   static EndpointRequestHandlerFactory endPointWrapper(
       const RequestHandlerCallback& callback) {
@@ -0,0 +1,118 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/http/JsonWriter.h"
+#include "velox/common/base/Exceptions.h"
+
+namespace facebook::presto::http {
+namespace {
+// The size of the IOBufs allocated for the written document.
+constexpr size_t kBufferSize = 16 << 10;
+
+// Appends the characters written by the json serializer to an IOBufQueue.
+class IOBufOutputAdapter
+    : public nlohmann::detail::output_adapter_protocol<char> {
+ public:
+  explicit IOBufOutputAdapter(folly::IOBufQueue* queue)
+      : appender_(queue, kBufferSize) {}
+
+  void write_character(char c) override {
+    appender_.push(reinterpret_cast<const uint8_t*>(&c), 1);
+  }
+
+  void write_characters(const char* s, std::size_t length) override {
+    appender_.push(reinterpret_cast<const uint8_t*>(s), length);
+  }
+
+ private:
+  folly::io::QueueAppender appender_;
+};
+} // namespace
+
+JsonWriter::JsonWriter()
+    : output_(std::make_shared<IOBufOutputAdapter>(&queue_)) {}
+
+void JsonWriter::beginValue() {
+  if (afterKey_) {
+    afterKey_ = false;
+    return;
+  }
+  if (!containers_.empty()) {
+    if (!containers_.back().empty) {
+      output_->write_character(',');
+    }
+    containers_.back().empty = false;
+  }
+}
+
+bool JsonWriter::inObject() const {
+  return !containers_.empty() && containers_.back().object;
+}
+
+void JsonWriter::beginObject() {
+  beginValue();
+  output_->write_character('{');
+  containers_.push_back({true});
+}
+
+void JsonWriter::endObject() {
+  VELOX_CHECK(inObject() && !afterKey_, "Unbalanced JSON object");
+  containers_.pop_back();
+  output_->write_character('}');
+}
+
+void JsonWriter::beginArray() {
+  beginValue();
+  output_->write_character('[');
+  containers_.push_back({false});
+}
+
+void JsonWriter::endArray() {
+  VELOX_CHECK(
+      !containers_.empty() && !containers_.back().object,
+      "Unbalanced JSON array");
+  containers_.pop_back();
+  output_->write_character(']');
+}
+
+void JsonWriter::key(std::string_view key) {
+  VELOX_CHECK(inObject() && !afterKey_, "JSON key outside of an object");
+  beginValue();
+  dump(nlohmann::json(std::string(key)));
+  output_->write_character(':');
+  afterKey_ = true;
+}
+
+void JsonWriter::value(const nlohmann::json& value) {
+  beginValue();
+  dump(value);
+}
+
+void JsonWriter::dump(const nlohmann::json& value) {
+  nlohmann::detail::serializer<nlohmann::json> serializer(output_, ' ');
+  serializer.dump(value, false, false, 0);
+}
+
+std::unique_ptr<folly::IOBuf> JsonWriter::finish() {
+  VELOX_CHECK(containers_.empty(), "Unterminated JSON document");
+  output_.reset();
+  return queue_.move();
+}
+
+std::unique_ptr<folly::IOBuf> toJsonIOBuf(const nlohmann::json& value) {
+  JsonWriter writer;
+  writer.value(value);
+  return writer.finish();
+}
+
+} // namespace facebook::presto::http
@@ -0,0 +1,76 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <folly/io/Cursor.h>
+#include <folly/io/IOBufQueue.h>
+#include <string_view>
+#include <vector>
+
+#include "presto_cpp/external/json/json.hpp"
+
+namespace facebook::presto::http {
+
+/// Writes a JSON document into IOBufs without an intermediate string. The
+/// caller streams the brackets and keys of the objects and arrays and writes
+/// their values either as json values or as nested objects and arrays, so
+/// that only the json value written at a time has to be built in memory.
+class JsonWriter {
+ public:
+  JsonWriter();
+
+  void beginObject();
+
+  void endObject();
+
+  void beginArray();
+
+  void endArray();
+
+  /// Writes the 'key' of the next member of the current object.
+  void key(std::string_view key);
+
+  /// Writes 'value' as the next element of the current array, the value of
+  /// the last key or the whole document.
+  void value(const nlohmann::json& value);
+
+  /// Returns the written document.
+  std::unique_ptr<folly::IOBuf> finish();
+
+ private:
+  // Writes the separator before the next element of the current array.
+  void beginValue();
+
+  bool inObject() const;
+
+  // Serializes 'value' as compact JSON like json::dump().
+  void dump(const nlohmann::json& value);
+
+  folly::IOBufQueue queue_{folly::IOBufQueue::cacheChainLength()};
+  std::shared_ptr<nlohmann::detail::output_adapter_protocol<char>> output_;
+  struct Container {
+    bool object;
+    // True until the first element is written.
+    bool empty{true};
+  };
+
+  // The open objects and arrays, the innermost last.
+  std::vector<Container> containers_;
+  bool afterKey_{false};
+};
+
+/// Returns 'value' written as JSON by JsonWriter.
+std::unique_ptr<folly::IOBuf> toJsonIOBuf(const nlohmann::json& value);
+
+} // namespace facebook::presto::http
@@ -12,36 +12,186 @@
  * limitations under the License.
  */
 
-#include <fmt/format.h>
 #include "presto_cpp/main/http/filters/AccessLogFilter.h"
+#include <fmt/format.h>
+#include <folly/Random.h>
+#include <folly/String.h>
+#include <glog/logging.h>
+#include <fstream>
+#include "presto_cpp/external/json/json.hpp"
+#include "presto_cpp/main/common/Counters.h"
+#include "velox/common/base/Exceptions.h"
+#include "velox/common/base/StatsReporter.h"
 
 namespace facebook::presto::http::filters {
 
-AccessLogFilter::AccessLogFilter(proxygen::RequestHandler* upstream)
-    : Filter(upstream) {}
+void AccessLogOptions::parseEndpointSampleRates(const std::string& rates) {
+  std::vector<folly::StringPiece> entries;
+  folly::split(',', rates, entries, true);
+  for (const auto& entry : entries) {
+    folly::StringPiece name;
+    folly::StringPiece rate;
+    VELOX_USER_CHECK(
+        folly::split('=', entry, name, rate),
+        "Invalid access log sample rate: {}",
+        entry);
+    name = folly::trimWhitespace(name);
+    bool found = false;
+    for (size_t i = 0; i < endpointSampleRates.size(); ++i) {
+      if (StatsFilter::endpointClassName(
+              static_cast<StatsFilter::EndpointClass>(i)) ==
+          std::string_view(name.data(), name.size())) {
+        endpointSampleRates[i] = folly::to<double>(folly::trimWhitespace(rate));
+        found = true;
+        break;
+      }
+    }
+    VELOX_USER_CHECK(found, "Unknown endpoint in access log rates: {}", name);
+  }
+}
+
+std::string AccessLogRecord::toJson() const {
+  struct tm formattedTime;
+  localtime_r(&time, &formattedTime);
+  char timeBuf[64];
+  std::strftime(timeBuf, sizeof(timeBuf), "%F %T", &formattedTime);
+  return nlohmann::json{
+      {"time", timeBuf},
+      {"remoteAddr", remoteAddr},
+      {"method", method},
+      {"url", url},
+      {"version", version},
+      {"status", statusCode},
+      {"bytesSent", bytesSent},
+      {"referer", httpReferer},
+      {"userAgent", httpUserAgent},
+      {"latencyMs", latencyMs}}
+      .dump();
+}
+
+AccessLogWriter::AccessLogWriter(size_t bufferSize, Sink sink)
+    : sink_(
+          sink != nullptr ? std::move(sink)
+                          : [](const std::vector<std::string>& lines) {
+                              for (const auto& line : lines) {
+                                LOG(INFO) << line;
+                              }
+                            }),
+      queue_(std::max<size_t>(1, bufferSize)),
+      thread_([this]() { run(); }) {}
+
+AccessLogWriter::~AccessLogWriter() {
+  stopped_ = true;
+  thread_.join();
+}
+
+// static
+AccessLogWriter::Sink AccessLogWriter::fileSink(const std::string& path) {
+  auto file = std::make_shared<std::ofstream>(path, std::ios::app);
+  VELOX_USER_CHECK(file->good(), "Cannot open the access log file {}", path);
+  return [file](const std::vector<std::string>& lines) {
+    for (const auto& line : lines) {
+      *file << line << '\n';
+    }
+    file->flush();
+  };
+}
+
+bool AccessLogWriter::write(AccessLogRecord&& record) {
+  if (!queue_.write(std::move(record))) {
+    REPORT_ADD_STAT_VALUE(kCounterHttpAccessLogNumDropped, 1);
+    return false;
+  }
+  return true;
+}
+
+void AccessLogWriter::run() {
+  std::vector<std::string> lines;
+  AccessLogRecord record;
+  for (;;) {
+    // Stops once all the records queued before the stop are written.
+    const bool stopped = stopped_;
+    const auto deadline = std::chrono::steady_clock::now() +
+        (stopped ? std::chrono::milliseconds(0) : kFlushInterval);
+    while (lines.size() < kMaxBatchSize &&
+           (queue_.read(record) || queue_.tryReadUntil(deadline, record))) {
+      lines.push_back(record.toJson());
+    }
+    if (!lines.empty()) {
+      sink_(lines);
+      lines.clear();
+    } else if (stopped) {
+      return;
+    }
+  }
+}
+
+AccessLogFilter::AccessLogFilter(
+    proxygen::RequestHandler* upstream,
+    const AccessLogOptions& options,
+    AccessLogWriter* writer)
+    : Filter(upstream), options_(options), writer_(writer) {}
+
+// static
+bool AccessLogFilter::isSampled(
+    const AccessLogOptions& options,
+    StatsFilter::EndpointClass endpointClass,
+    double random) {
+  double rate = options.sampleRate;
+  if (endpointClass != StatsFilter::EndpointClass::kOther) {
+    const auto endpointRate =
+        options.endpointSampleRates[static_cast<size_t>(endpointClass)];
+    if (endpointRate >= 0) {
+      rate = endpointRate;
+    }
+  }
+  return random < rate;
+}
+
+// static
+bool AccessLogFilter::shouldLog(
+    const AccessLogOptions& options,
+    bool sampled,
+    uint16_t statusCode,
+    int64_t latencyMs) {
+  if (sampled) {
+    return true;
+  }
+  return options.slowRequestMs > 0 &&
+      (latencyMs >= options.slowRequestMs || statusCode >= 500);
+}
 
 void AccessLogFilter::onRequest(
     std::unique_ptr<proxygen::HTTPMessage> msg) noexcept {
-  startTime_ = msg->getStartTime();
-  method_ = msg->getMethodString();
-  url_ = msg->getURL();
-  version_ = getVersion(*msg);
-  remoteAddr_ = msg->getClientIP();
-
-  const auto& headers = msg->getHeaders();
-  httpReferer_ = headers.getSingleOrEmpty(proxygen::HTTP_HEADER_REFERER);
-  httpUserAgent_ = headers.getSingleOrEmpty(proxygen::HTTP_HEADER_USER_AGENT);
+  const auto endpointClass = msg->getMethod()
+      ? StatsFilter::endpointClass(*msg->getMethod(), msg->getPath())
+      : StatsFilter::EndpointClass::kOther;
+  sampled_ = isSampled(options_, endpointClass, folly::Random::randDouble01());
+  // The requests not sampled are only logged if slow.
+  tracked_ = sampled_ || options_.slowRequestMs > 0;
+  if (tracked_) {
+    startTime_ = msg->getStartTime();
+    method_ = msg->getMethodString();
+    url_ = msg->getURL();
+    version_ = getVersion(*msg);
+    remoteAddr_ = msg->getClientIP();
+
+    const auto& headers = msg->getHeaders();
+    httpReferer_ = headers.getSingleOrEmpty(proxygen::HTTP_HEADER_REFERER);
+    httpUserAgent_ =
+        headers.getSingleOrEmpty(proxygen::HTTP_HEADER_USER_AGENT);
+  }
 
   Filter::onRequest(std::move(msg));
 }
 
 void AccessLogFilter::requestComplete() noexcept {
-  writeLog(generateLog());
+  maybeWriteLog();
   Filter::requestComplete();
 }
 
 void AccessLogFilter::onError(proxygen::ProxygenError err) noexcept {
-  writeLog(generateLog());
+  maybeWriteLog();
   Filter::onError(err);
 }
 
@@ -65,32 +215,26 @@ std::string AccessLogFilter::getVersion(
   }
 }
 
-void AccessLogFilter::writeLog(std::string logLine) const noexcept {
-  LOG(INFO) << logLine;
-}
-
-std::string AccessLogFilter::generateLog() const noexcept {
-  std::time_t requestStartTime = proxygen::toTimeT(proxygen::getCurrentTime());
-  static struct tm formattedStartTime;
-  localtime_r(&requestStartTime, &formattedStartTime);
-  char timeBuf[64];
-  std::strftime(timeBuf, 64, "%F %T", &formattedStartTime);
-  const auto latency = proxygen::millisecondsSince(startTime_);
-
-  std::string logLine = fmt::format(
-      "{} - - [{}] \"{} {} {}\" {:d} {:d} {} {} {:d}",
-      remoteAddr_.c_str(),
-      timeBuf,
-      method_.c_str(),
-      url_.c_str(),
-      version_.c_str(),
-      statusCode_,
-      bytesSent_,
-      httpReferer_.c_str(),
-      httpUserAgent_.c_str(),
-      latency.count());
-
-  return logLine;
+void AccessLogFilter::maybeWriteLog() noexcept {
+  if (!tracked_) {
+    return;
+  }
+  const auto latencyMs = proxygen::millisecondsSince(startTime_).count();
+  if (!shouldLog(options_, sampled_, statusCode_, latencyMs)) {
+    return;
+  }
+  AccessLogRecord record;
+  record.time = proxygen::toTimeT(proxygen::getCurrentTime());
+  record.remoteAddr = std::move(remoteAddr_);
+  record.method = std::move(method_);
+  record.url = std::move(url_);
+  record.version = std::move(version_);
+  record.statusCode = statusCode_;
+  record.bytesSent = bytesSent_;
+  record.httpReferer = std::move(httpReferer_);
+  record.httpUserAgent = std::move(httpUserAgent_);
+  record.latencyMs = latencyMs;
+  writer_->write(std::move(record));
 }
 
 } // namespace facebook::presto::http::filters
@@ -14,15 +14,117 @@
 
 #pragma once
 
+#include <folly/MPMCQueue.h>
 #include <proxygen/httpserver/Filters.h>
 #include <proxygen/httpserver/RequestHandlerFactory.h>
+#include <array>
+#include <atomic>
+#include <functional>
+#include <thread>
+#include "presto_cpp/main/http/filters/StatsFilter.h"
 
 namespace facebook::presto::http::filters {
 
-/// A filter that does access logging in nginx `combined` format
+/// Decides which requests are logged.
+struct AccessLogOptions {
+  /// Fraction of the requests logged, between 0 and 1.
+  double sampleRate{1};
+  /// Overrides 'sampleRate' for the task endpoints by class. Negative for the
+  /// classes without an override.
+  std::array<double, static_cast<size_t>(StatsFilter::EndpointClass::kOther)>
+      endpointSampleRates;
+  /// The requests that take at least this long or fail with a server error
+  /// are always logged. 0 disables.
+  int64_t slowRequestMs{0};
+  /// The records not written yet are dropped beyond this many.
+  size_t bufferSize{1 << 14};
+  /// The file the records are appended to. Empty writes them to glog.
+  std::string path;
+
+  AccessLogOptions() {
+    endpointSampleRates.fill(-1);
+  }
+
+  /// Sets the endpoint sample rates from 'rates', e.g. "status=0.01,ack=0",
+  /// the classes being named as in StatsFilter::endpointClassName().
+  void parseEndpointSampleRates(const std::string& rates);
+};
+
+/// The fields of a logged request.
+struct AccessLogRecord {
+  std::time_t time{0};
+  std::string remoteAddr;
+  std::string method;
+  std::string url;
+  std::string version;
+  uint16_t statusCode{0};
+  size_t bytesSent{0};
+  std::string httpReferer;
+  std::string httpUserAgent;
+  int64_t latencyMs{0};
+
+  /// Returns the record as a single line of json.
+  std::string toJson() const;
+};
+
+/// Writes the access log records on a background thread, off the http
+/// threads. The records are handed over through a bounded lock-free queue
+/// and written in batches of up to 'kMaxBatchSize', at least every
+/// 'kFlushInterval'. The records that do not fit in the queue are dropped
+/// and counted.
+class AccessLogWriter {
+ public:
+  static constexpr size_t kMaxBatchSize{1'024};
+  static constexpr std::chrono::milliseconds kFlushInterval{1'000};
+
+  /// Receives the batches of log lines.
+  using Sink = std::function<void(const std::vector<std::string>& lines)>;
+
+  /// Writes to glog if 'sink' is null.
+  explicit AccessLogWriter(size_t bufferSize, Sink sink = nullptr);
+
+  /// Returns a sink that appends the lines to the file 'path'.
+  static Sink fileSink(const std::string& path);
+
+  /// Writes the queued records and stops.
+  ~AccessLogWriter();
+
+  /// Queues 'record' without blocking. Returns false if it is dropped.
+  bool write(AccessLogRecord&& record);
+
+ private:
+  void run();
+
+  const Sink sink_;
+  folly::MPMCQueue<AccessLogRecord> queue_;
+  std::atomic_bool stopped_{false};
+  std::thread thread_;
+};
+
+/// A filter that does access logging in nginx `combined` format fields, as
+/// one json object per line, for a sample of the requests.
 class AccessLogFilter : public proxygen::Filter {
  public:
-  explicit AccessLogFilter(proxygen::RequestHandler* upstream);
+  AccessLogFilter(
+      proxygen::RequestHandler* upstream,
+      const AccessLogOptions& options,
+      AccessLogWriter* writer);
+
+  /// Returns true if a request of 'endpointClass' that completed with
+  /// 'statusCode' after 'latencyMs' is logged. 'sampled' tells whether the
+  /// request is in the sample of its class, see isSampled().
+  static bool shouldLog(
+      const AccessLogOptions& options,
+      bool sampled,
+      uint16_t statusCode,
+      int64_t latencyMs);
+
+  /// Returns true if a request of 'endpointClass' is in the sample given
+  /// 'random', uniform in [0, 1).
+  static bool isSampled(
+      const AccessLogOptions& options,
+      StatsFilter::EndpointClass endpointClass,
+      double random);
 
   void onRequest(std::unique_ptr<proxygen::HTTPMessage> msg) noexcept override;
 
@@ -37,26 +139,35 @@ class AccessLogFilter : public proxygen::Filter {
  private:
   std::string getVersion(const proxygen::HTTPMessage& msg) const noexcept;
 
-  virtual void writeLog(std::string logLine) const noexcept;
+  void maybeWriteLog() noexcept;
 
-  std::string generateLog() const noexcept;
+  const AccessLogOptions& options_;
+  AccessLogWriter* const writer_;
 
+  // False if the request is logged neither as a sample nor as a slow request.
+  bool tracked_{false};
+  bool sampled_{false};
   proxygen::TimePoint startTime_;
   std::string method_;
   std::string url_;
   std::string version_;
   std::string remoteAddr_;
+  std::string httpReferer_;
+  std::string httpUserAgent_;
 
   uint16_t statusCode_{0};
   size_t bytesSent_{0};
-
-  std::string httpReferer_;
-  std::string httpUserAgent_;
 };
 
 class AccessLogFilterFactory : public proxygen::RequestHandlerFactory {
  public:
-  explicit AccessLogFilterFactory() {}
+  explicit AccessLogFilterFactory(AccessLogOptions options = {})
+      : options_(std::move(options)),
+        writer_(std::make_unique<AccessLogWriter>(
+            options_.bufferSize,
+            options_.path.empty() ? nullptr
+                                  : AccessLogWriter::fileSink(options_.path))) {
+  }
 
   void onServerStart(folly::EventBase* /*evb*/) noexcept override {}
 
@@ -65,8 +176,12 @@ class AccessLogFilterFactory : public proxygen::RequestHandlerFactory {
   proxygen::RequestHandler* onRequest(
       proxygen::RequestHandler* handler,
       proxygen::HTTPMessage*) noexcept override {
-    return new AccessLogFilter(handler);
+    return new AccessLogFilter(handler, options_, writer_.get());
   }
+
+ private:
+  const AccessLogOptions options_;
+  const std::unique_ptr<AccessLogWriter> writer_;
 };
 
 } // namespace facebook::presto::http::filters
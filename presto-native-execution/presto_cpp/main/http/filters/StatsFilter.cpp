@@ -13,27 +13,148 @@
  */
 
 #include "presto_cpp/main/http/filters/StatsFilter.h"
+#include <fmt/format.h>
 #include "presto_cpp/main/common/Counters.h"
 #include "velox/common/base/StatsReporter.h"
 
+#include <array>
+
 namespace facebook::presto::http::filters {
+namespace {
+constexpr std::string_view kTaskPathPrefix{"/v1/task/"};
+
+constexpr size_t kNumEndpointClasses =
+    static_cast<size_t>(StatsFilter::EndpointClass::kOther);
+
+struct EndpointCounters {
+  std::string latencyMs;
+  std::string requestBytes;
+  std::string responseBytes;
+};
+
+// Returns the histogram names of the endpoint classes but kOther, registered
+// on first use.
+const std::array<EndpointCounters, kNumEndpointClasses>& endpointCounters() {
+  static const auto counters = []() {
+    std::array<EndpointCounters, kNumEndpointClasses> counters;
+    for (size_t i = 0; i < kNumEndpointClasses; ++i) {
+      const auto name = StatsFilter::endpointClassName(
+          static_cast<StatsFilter::EndpointClass>(i));
+      counters[i].latencyMs =
+          fmt::format(kCounterHTTPEndpointLatencyMsFormat, name);
+      counters[i].requestBytes =
+          fmt::format(kCounterHTTPEndpointRequestBytesFormat, name);
+      counters[i].responseBytes =
+          fmt::format(kCounterHTTPEndpointResponseBytesFormat, name);
+      REPORT_ADD_HISTOGRAM_EXPORT_PERCENTILE(
+          counters[i].latencyMs, 10, 0, 10'000, 50, 90, 99, 100);
+      REPORT_ADD_HISTOGRAM_EXPORT_PERCENTILE(
+          counters[i].requestBytes, 64 << 10, 0, 32 << 20, 50, 90, 99, 100);
+      REPORT_ADD_HISTOGRAM_EXPORT_PERCENTILE(
+          counters[i].responseBytes, 64 << 10, 0, 32 << 20, 50, 90, 99, 100);
+    }
+    return counters;
+  }();
+  return counters;
+}
+} // namespace
 
 StatsFilter::StatsFilter(proxygen::RequestHandler* upstream)
     : Filter(upstream) {}
 
+// static
+StatsFilter::EndpointClass StatsFilter::endpointClass(
+    proxygen::HTTPMethod method,
+    std::string_view path) {
+  if (path.substr(0, kTaskPathPrefix.size()) != kTaskPathPrefix) {
+    return EndpointClass::kOther;
+  }
+  // The path after the task id: "", "/status", "/results/{buffer}/{token}",
+  // "/results/{buffer}/{token}/acknowledge" or "/batch".
+  path.remove_prefix(kTaskPathPrefix.size());
+  const auto slash = path.find('/');
+  const auto rest =
+      slash == std::string_view::npos ? std::string_view() : path.substr(slash);
+  switch (method) {
+    case proxygen::HTTPMethod::POST:
+      return rest.empty() || rest == "/batch" ? EndpointClass::kCreateTask
+                                              : EndpointClass::kOther;
+    case proxygen::HTTPMethod::DELETE:
+      return EndpointClass::kDelete;
+    case proxygen::HTTPMethod::GET:
+    case proxygen::HTTPMethod::HEAD:
+      if (rest.empty()) {
+        return EndpointClass::kInfo;
+      }
+      if (rest == "/status") {
+        return EndpointClass::kStatus;
+      }
+      if (rest.substr(0, 9) == "/results/") {
+        static constexpr std::string_view kAck{"/acknowledge"};
+        return rest.size() > kAck.size() &&
+                rest.substr(rest.size() - kAck.size()) == kAck
+            ? EndpointClass::kAck
+            : EndpointClass::kResults;
+      }
+      return EndpointClass::kOther;
+    default:
+      return EndpointClass::kOther;
+  }
+}
+
+// static
+std::string_view StatsFilter::endpointClassName(EndpointClass endpointClass) {
+  switch (endpointClass) {
+    case EndpointClass::kCreateTask:
+      return "create_task";
+    case EndpointClass::kStatus:
+      return "status";
+    case EndpointClass::kInfo:
+      return "info";
+    case EndpointClass::kResults:
+      return "results";
+    case EndpointClass::kAck:
+      return "ack";
+    case EndpointClass::kDelete:
+      return "delete";
+    case EndpointClass::kOther:
+      return "other";
+  }
+  return "other";
+}
+
 void StatsFilter::onRequest(
     std::unique_ptr<proxygen::HTTPMessage> msg) noexcept {
   startTime_ = std::chrono::steady_clock::now();
   REPORT_ADD_STAT_VALUE(kCounterNumHTTPRequest, 1);
+  if (auto method = msg->getMethod()) {
+    endpointClass_ = endpointClass(*method, msg->getPath());
+  }
   Filter::onRequest(std::move(msg));
 }
 
+void StatsFilter::onBody(std::unique_ptr<folly::IOBuf> body) noexcept {
+  requestBytes_ += body->computeChainDataLength();
+  Filter::onBody(std::move(body));
+}
+
+void StatsFilter::sendBody(std::unique_ptr<folly::IOBuf> body) noexcept {
+  responseBytes_ += body->computeChainDataLength();
+  Filter::sendBody(std::move(body));
+}
+
 void StatsFilter::requestComplete() noexcept {
-  REPORT_ADD_STAT_VALUE(
-      kCounterHTTPRequestLatencyMs,
-      std::chrono::duration_cast<std::chrono::milliseconds>(
-          std::chrono::steady_clock::now() - startTime_)
-          .count());
+  const auto latencyMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+                             std::chrono::steady_clock::now() - startTime_)
+                             .count();
+  REPORT_ADD_STAT_VALUE(kCounterHTTPRequestLatencyMs, latencyMs);
+  if (endpointClass_ != EndpointClass::kOther) {
+    const auto& counters =
+        endpointCounters()[static_cast<size_t>(endpointClass_)];
+    REPORT_ADD_HISTOGRAM_VALUE(counters.latencyMs, latencyMs);
+    REPORT_ADD_HISTOGRAM_VALUE(counters.requestBytes, requestBytes_);
+    REPORT_ADD_HISTOGRAM_VALUE(counters.responseBytes, responseBytes_);
+  }
   delete this;
 }
 
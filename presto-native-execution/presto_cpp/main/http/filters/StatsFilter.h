@@ -17,21 +17,52 @@
 #include <proxygen/httpserver/Filters.h>
 #include <proxygen/httpserver/RequestHandlerFactory.h>
 #include <time.h>
+#include <string_view>
 
 namespace facebook::presto::http::filters {
 
+/// Reports the number, errors and latency of all the requests, and the
+/// latency and payload size histograms of each class of task endpoint.
 class StatsFilter : public proxygen::Filter {
  public:
+  /// The task endpoints with their own histograms.
+  enum class EndpointClass {
+    kCreateTask,
+    kStatus,
+    kInfo,
+    kResults,
+    kAck,
+    kDelete,
+    kOther,
+  };
+
   explicit StatsFilter(proxygen::RequestHandler* upstream);
 
+  /// Returns the class of a request for 'method' on 'path', with string
+  /// comparisons only since it runs on every request.
+  static EndpointClass endpointClass(
+      proxygen::HTTPMethod method,
+      std::string_view path);
+
+  /// Returns the name of 'endpointClass' in the counters and configs, e.g.
+  /// "create_task".
+  static std::string_view endpointClassName(EndpointClass endpointClass);
+
   void onRequest(std::unique_ptr<proxygen::HTTPMessage> msg) noexcept override;
 
+  void onBody(std::unique_ptr<folly::IOBuf> body) noexcept override;
+
+  void sendBody(std::unique_ptr<folly::IOBuf> body) noexcept override;
+
   void requestComplete() noexcept override;
 
   void onError(proxygen::ProxygenError err) noexcept override;
 
  private:
   std::chrono::steady_clock::time_point startTime_;
+  EndpointClass endpointClass_{EndpointClass::kOther};
+  uint64_t requestBytes_{0};
+  uint64_t responseBytes_{0};
 };
 
 class StatsFilterFactory : public proxygen::RequestHandlerFactory {
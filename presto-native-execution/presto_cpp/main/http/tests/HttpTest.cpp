@@ -13,13 +13,17 @@
  */
 #include <boost/algorithm/string.hpp>
 #include <boost/filesystem.hpp>
+#include <folly/compression/Compression.h>
 #include <folly/init/Init.h>
+#include <folly/synchronization/Baton.h>
 #include <gtest/gtest.h>
 #include <velox/common/base/VeloxException.h>
 #include <velox/common/base/tests/GTestUtils.h>
 #include <velox/common/memory/Memory.h>
 #include "presto_cpp/main/http/HttpClient.h"
 #include "presto_cpp/main/http/HttpServer.h"
+#include "presto_cpp/main/http/filters/AccessLogFilter.h"
+#include "presto_cpp/main/http/filters/StatsFilter.h"
 #include "velox/common/base/StatsReporter.h"
 
 namespace fs = boost::filesystem;
@@ -99,6 +103,7 @@ class AsyncSSLSockAutoCloseCallback
 
   void connectSuccess() noexcept override {
     succeeded_ = true;
+    applicationProtocol_ = sock_->getApplicationProtocol();
     sock_->close();
   }
 
@@ -110,9 +115,15 @@ class AsyncSSLSockAutoCloseCallback
     return succeeded_;
   }
 
+  // The protocol negotiated over ALPN.
+  const std::string& applicationProtocol() const {
+    return applicationProtocol_;
+  }
+
  private:
   folly::AsyncSSLSocket* const sock_{nullptr};
   bool succeeded_{false};
+  std::string applicationProtocol_;
 };
 
 void ping(
@@ -228,6 +239,40 @@ TEST_F(HttpTest, ssl) {
   EXPECT_TRUE(cb.succeeded());
 }
 
+TEST_F(HttpTest, sslHttp2) {
+  std::string certPath = getCertsPath("test_cert1.pem");
+  std::string keyPath = getCertsPath("test_key1.pem");
+  std::string ciphers = "AES128-SHA,AES128-SHA256,AES256-GCM-SHA384";
+
+  for (bool http2Enabled : {false, true}) {
+    SCOPED_TRACE(fmt::format("http2Enabled {}", http2Enabled));
+    auto httpsConfig = std::make_unique<http::HttpsConfig>(
+        folly::SocketAddress("127.0.0.1", 0),
+        certPath,
+        keyPath,
+        ciphers,
+        false,
+        http2Enabled);
+    auto server =
+        std::make_unique<http::HttpServer>(nullptr, std::move(httpsConfig));
+
+    HttpServerWrapper wrapper(std::move(server));
+    auto serverAddress = wrapper.start().get();
+
+    folly::EventBase evb;
+    auto ctx = std::make_shared<folly::SSLContext>();
+    ctx->setAdvertisedNextProtocols({"h2", "http/1.1"});
+    folly::AsyncSSLSocket::UniquePtr sock(
+        new folly::AsyncSSLSocket(ctx, &evb));
+    AsyncSSLSockAutoCloseCallback cb(sock.get());
+    sock->connect(&cb, serverAddress, 1000);
+    evb.loop();
+    EXPECT_TRUE(cb.succeeded());
+    // A server without ALPN leaves the protocol to the default, HTTP/1.1.
+    EXPECT_EQ(cb.applicationProtocol() == "h2", http2Enabled);
+  }
+}
+
 TEST_F(HttpTest, basic) {
   auto memoryPool = defaultMemoryManager().addLeafPool("basic");
   auto server = std::make_unique<http::HttpServer>(
@@ -284,6 +329,130 @@ TEST_F(HttpTest, basic) {
   ASSERT_EQ(socketException->getType(), folly::AsyncSocketException::NOT_OPEN);
 }
 
+TEST_F(HttpTest, iobufAndStreamingRequestBody) {
+  auto memoryPool = defaultMemoryManager().addLeafPool("requestBody");
+  auto server = std::make_unique<http::HttpServer>(
+      std::make_unique<http::HttpConfig>(folly::SocketAddress("127.0.0.1", 0)));
+  server->registerPost(R"(/echo.*)", echo);
+
+  HttpServerWrapper wrapper(std::move(server));
+  auto serverAddress = wrapper.start().get();
+
+  HttpClientFactory clientFactory;
+  auto client =
+      clientFactory.newClient(serverAddress, std::chrono::milliseconds(1'000));
+
+  auto body = folly::IOBuf::copyBuffer("Good ");
+  body->appendToChain(folly::IOBuf::copyBuffer("morning"));
+  body->appendToChain(folly::IOBuf::copyBuffer("!"));
+  auto response = http::RequestBuilder()
+                      .method(proxygen::HTTPMethod::POST)
+                      .url("/echo")
+                      .send(client.get(), memoryPool.get(), std::move(body))
+                      .get();
+  ASSERT_EQ(response->headers()->getStatusCode(), http::kHttpOk);
+  ASSERT_EQ(bodyAsString(*response, memoryPool.get()), "Good morning!");
+
+  std::string expectedBody;
+  int numChunks = 0;
+  response =
+      http::RequestBuilder()
+          .method(proxygen::HTTPMethod::POST)
+          .url("/echo")
+          .sendStreaming(
+              client.get(),
+              memoryPool.get(),
+              [&]() -> std::unique_ptr<folly::IOBuf> {
+                if (numChunks == 100) {
+                  return nullptr;
+                }
+                auto chunk = fmt::format("chunk{}-", numChunks++);
+                expectedBody += chunk;
+                return folly::IOBuf::copyBuffer(chunk);
+              })
+          .get();
+  ASSERT_EQ(response->headers()->getStatusCode(), http::kHttpOk);
+  ASSERT_EQ(numChunks, 100);
+  ASSERT_EQ(bodyAsString(*response, memoryPool.get()), expectedBody);
+
+  // A failure to produce the body fails the request.
+  auto tryResponse = http::RequestBuilder()
+                         .method(proxygen::HTTPMethod::POST)
+                         .url("/echo")
+                         .sendStreaming(
+                             client.get(),
+                             memoryPool.get(),
+                             []() -> std::unique_ptr<folly::IOBuf> {
+                               VELOX_FAIL("Body generator failure");
+                             })
+                         .getTry();
+  ASSERT_TRUE(tryResponse.hasException());
+  ASSERT_NE(
+      tryResponse.exception().what().find("Body generator failure"),
+      std::string::npos);
+
+  wrapper.stop();
+}
+
+TEST_F(HttpTest, bufferRecycler) {
+  auto memoryPool = defaultMemoryManager().addLeafPool("bufferRecycler");
+  {
+    http::HttpBufferRecycler recycler(memoryPool.get(), 8 << 10);
+    auto* buffer = recycler.allocate(4 << 10);
+    ASSERT_EQ(memoryPool->getCurrentBytes(), 4 << 10);
+    recycler.free(buffer, 4 << 10);
+    ASSERT_EQ(recycler.cachedBytes(), 4 << 10);
+    ASSERT_EQ(memoryPool->getCurrentBytes(), 4 << 10);
+
+    // The freed buffer is reused for the same size only.
+    ASSERT_EQ(recycler.allocate(4 << 10), buffer);
+    ASSERT_EQ(recycler.cachedBytes(), 0);
+    auto* otherBuffer = recycler.allocate(8 << 10);
+    ASSERT_EQ(memoryPool->getCurrentBytes(), 12 << 10);
+
+    // The buffers beyond the cache capacity are freed to the memory pool.
+    recycler.free(otherBuffer, 8 << 10);
+    recycler.free(buffer, 4 << 10);
+    ASSERT_EQ(recycler.cachedBytes(), 8 << 10);
+    ASSERT_EQ(memoryPool->getCurrentBytes(), 8 << 10);
+  }
+  // The cached buffers are freed on destruction.
+  ASSERT_EQ(memoryPool->getCurrentBytes(), 0);
+
+  auto server = std::make_unique<http::HttpServer>(
+      std::make_unique<http::HttpConfig>(folly::SocketAddress("127.0.0.1", 0)));
+  server->registerGet(R"(/echo.*)", echo);
+  HttpServerWrapper wrapper(std::move(server));
+  auto serverAddress = wrapper.start().get();
+
+  HttpClientFactory clientFactory;
+  auto client =
+      clientFactory.newClient(serverAddress, std::chrono::milliseconds(1'000));
+  auto recycler =
+      std::make_shared<http::HttpBufferRecycler>(memoryPool.get(), 1 << 20);
+  for (int i = 0; i < 3; ++i) {
+    auto response = http::RequestBuilder()
+                        .method(proxygen::HTTPMethod::GET)
+                        .url("/echo/recycled")
+                        .bufferRecycler(recycler)
+                        .send(client.get(), memoryPool.get())
+                        .get();
+    ASSERT_EQ(response->headers()->getStatusCode(), http::kHttpOk);
+    ASSERT_EQ(response->bufferRecycler(), recycler);
+    auto body = response->consumeBody();
+    ASSERT_EQ(body.size(), 1);
+    ASSERT_EQ(
+        std::string((const char*)body[0]->data(), body[0]->length()),
+        "/echo/recycled");
+    recycler->free(body[0]->writableData(), body[0]->capacity());
+    // The same buffer is recycled across the responses.
+    ASSERT_EQ(memoryPool->getCurrentBytes(), recycler->cachedBytes());
+  }
+  recycler.reset();
+  ASSERT_EQ(memoryPool->getCurrentBytes(), 0);
+  wrapper.stop();
+}
+
 TEST_F(HttpTest, httpResponseAllocationFailure) {
   const int64_t memoryCapBytes = 1 << 10;
   auto rootPool = defaultMemoryManager().addRootPool(
@@ -563,6 +732,327 @@ TEST_F(HttpTest, testReportOnBodyStatsFunc) {
   wrapper.stop();
 }
 
+TEST_F(HttpTest, clientPool) {
+  auto memoryPool = defaultMemoryManager().addLeafPool("clientPool");
+
+  std::vector<std::unique_ptr<HttpServerWrapper>> wrappers;
+  std::vector<folly::SocketAddress> serverAddresses;
+  for (int i = 0; i < 2; ++i) {
+    auto server = std::make_unique<http::HttpServer>(
+        std::make_unique<http::HttpConfig>(
+            folly::SocketAddress("127.0.0.1", 0)));
+    server->registerGet("/ping", ping);
+    wrappers.push_back(std::make_unique<HttpServerWrapper>(std::move(server)));
+    serverAddresses.push_back(wrappers.back()->start().get());
+  }
+
+  http::HttpClientPool clientPool(2, std::chrono::milliseconds(1'000), 10);
+  auto client = clientPool.getClient(serverAddresses[0]);
+  ASSERT_EQ(clientPool.getClient(serverAddresses[0]), client);
+  ASSERT_EQ(clientPool.numClients(), 1);
+
+  auto otherClient = clientPool.getClient(serverAddresses[1]);
+  ASSERT_NE(otherClient, client);
+  ASSERT_NE(otherClient->eventBase(), client->eventBase());
+  ASSERT_EQ(clientPool.numClients(), 2);
+
+  // Concurrent requests to the same upstream go through the shared client.
+  std::vector<folly::SemiFuture<std::unique_ptr<http::HttpResponse>>> futures;
+  for (int i = 0; i < 10; ++i) {
+    futures.push_back(sendGet(
+        clientPool.getClient(serverAddresses[i % 2]).get(),
+        "/ping",
+        memoryPool.get()));
+  }
+  for (auto& future : futures) {
+    auto response = std::move(future).get();
+    ASSERT_EQ(response->headers()->getStatusCode(), http::kHttpOk);
+  }
+  ASSERT_EQ(clientPool.numClients(), 2);
+
+  client.reset();
+  otherClient.reset();
+  for (auto& wrapper : wrappers) {
+    wrapper->stop();
+  }
+}
+
+TEST_F(HttpTest, dispatching) {
+  http::DispatchingRequestHandlerFactory factory;
+  std::string matched;
+  std::vector<std::string> matchedArgs;
+  auto endpoint = [&](const std::string& name) {
+    return [&, name](
+               proxygen::HTTPMessage* /*message*/,
+               const std::vector<std::string>& args) {
+      matched = name;
+      matchedArgs = args;
+      return new http::ErrorRequestHandler(http::kHttpOk, name);
+    };
+  };
+  const auto get = proxygen::HTTPMethod::GET;
+  factory.registerEndPoint(get, "/v1/info", endpoint("info"));
+  factory.registerEndPoint(get, "/v1/info/state", endpoint("state"));
+  factory.registerEndPoint(get, "/v1/tasks?", endpoint("tasks"));
+  factory.registerEndPoint(
+      get, R"(/v1/task/(.+)/results/([0-9]+)/ack)", endpoint("ack"));
+  factory.registerEndPoint(get, R"(/v1/task/(.+)/status)", endpoint("status"));
+  factory.registerEndPoint(
+      get, R"(/v1/task/(.+)/results/([0-9]+))", endpoint("results"));
+  factory.registerEndPoint(get, R"(/v1/task/(.+))", endpoint("task"));
+  factory.registerEndPoint(get, R"(/v1/(a|b)/x)", endpoint("alternation"));
+  factory.registerEndPoint(get, R"(/v1/file/(.+)\.json)", endpoint("file"));
+
+  auto dispatch = [&](proxygen::HTTPMethod method, const std::string& url) {
+    matched.clear();
+    matchedArgs.clear();
+    proxygen::HTTPMessage message;
+    message.setMethod(method);
+    message.setURL(url);
+    std::unique_ptr<proxygen::RequestHandler> handler(
+        factory.onRequest(nullptr, &message));
+    return matched;
+  };
+
+  EXPECT_EQ(dispatch(get, "/v1/info"), "info");
+  EXPECT_EQ(dispatch(get, "/v1/info/state"), "state");
+  EXPECT_EQ(dispatch(get, "/v1/info/stat"), "");
+  EXPECT_EQ(dispatch(get, "/v1/info?x=1"), "info");
+  EXPECT_EQ(dispatch(get, "/v1/task"), "tasks");
+  EXPECT_EQ(dispatch(get, "/v1/tasks"), "tasks");
+  EXPECT_EQ(dispatch(get, "/v1/task/t.0/results/1/ack"), "ack");
+  EXPECT_EQ(
+      matchedArgs,
+      std::vector<std::string>({"/v1/task/t.0/results/1/ack", "t.0", "1"}));
+  EXPECT_EQ(dispatch(get, "/v1/task/t.0/status"), "status");
+  EXPECT_EQ(dispatch(get, "/v1/task/t.0/results/1"), "results");
+  EXPECT_EQ(dispatch(get, "/v1/task/t.0"), "task");
+  EXPECT_EQ(dispatch(get, "/v1/b/x"), "alternation");
+  EXPECT_EQ(dispatch(get, "/v1/file/a.json"), "file");
+  EXPECT_EQ(dispatch(get, "/v1/file/ajson"), "");
+  EXPECT_EQ(dispatch(get, "/v2/info"), "");
+  EXPECT_EQ(dispatch(proxygen::HTTPMethod::POST, "/v1/info"), "");
+}
+
+TEST_F(HttpTest, cpuExecutor) {
+  auto server = std::make_unique<http::HttpServer>(
+      std::make_unique<http::HttpConfig>(folly::SocketAddress("127.0.0.1", 0)));
+  ASSERT_EQ(server->getCpuExecutor(http::EndpointClass::kControl), nullptr);
+  ASSERT_EQ(server->getCpuExecutor(http::EndpointClass::kData), nullptr);
+
+  server = std::make_unique<http::HttpServer>(
+      std::make_unique<http::HttpConfig>(folly::SocketAddress("127.0.0.1", 0)),
+      nullptr,
+      8,
+      1);
+  auto* controlExecutor =
+      server->getCpuExecutor(http::EndpointClass::kControl);
+  auto* dataExecutor = server->getCpuExecutor(http::EndpointClass::kData);
+  ASSERT_NE(controlExecutor, nullptr);
+  ASSERT_NE(dataExecutor, nullptr);
+
+  // Occupies the only thread while the data and then the control tasks are
+  // queued. The queued control tasks run first.
+  folly::Baton<> started;
+  folly::Baton<> blocked;
+  controlExecutor->add([&]() {
+    started.post();
+    blocked.wait();
+  });
+  started.wait();
+
+  std::mutex mutex;
+  std::vector<std::string> order;
+  folly::Baton<> done;
+  for (int i = 0; i < 2; ++i) {
+    dataExecutor->add([&, i]() {
+      std::lock_guard<std::mutex> l(mutex);
+      order.push_back(fmt::format("data{}", i));
+      if (order.size() == 4) {
+        done.post();
+      }
+    });
+  }
+  for (int i = 0; i < 2; ++i) {
+    controlExecutor->add([&, i]() {
+      std::lock_guard<std::mutex> l(mutex);
+      order.push_back(fmt::format("control{}", i));
+      if (order.size() == 4) {
+        done.post();
+      }
+    });
+  }
+  blocked.post();
+  done.wait();
+  ASSERT_EQ(
+      order,
+      std::vector<std::string>({"control0", "control1", "data0", "data1"}));
+}
+
+TEST_F(HttpTest, acceptorGroups) {
+  auto memoryPool = defaultMemoryManager().addLeafPool("acceptorGroups");
+  VELOX_ASSERT_THROW(
+      http::HttpServer(
+          std::make_unique<http::HttpConfig>(
+              folly::SocketAddress("127.0.0.1", 0)),
+          nullptr,
+          2,
+          0,
+          3),
+      "Each acceptor group needs at least one http io thread");
+
+  auto server = std::make_unique<http::HttpServer>(
+      std::make_unique<http::HttpConfig>(folly::SocketAddress("127.0.0.1", 0)),
+      nullptr,
+      5,
+      0,
+      2);
+  ASSERT_EQ(server->numAcceptorGroups(), 2);
+  ASSERT_EQ(server->getExecutor()->numThreads(), 3);
+  server->registerGet("/ping", ping);
+  auto* serverPtr = server.get();
+
+  HttpServerWrapper wrapper(std::move(server));
+  auto serverAddress = wrapper.start().get();
+
+  // Each client opens its own connection, which the kernel assigns to one of
+  // the groups listening on the port.
+  constexpr int kNumClients = 16;
+  HttpClientFactory clientFactory;
+  for (int i = 0; i < kNumClients; ++i) {
+    auto client = clientFactory.newClient(
+        serverAddress, std::chrono::milliseconds(1'000));
+    auto response = sendGet(client.get(), "/ping", memoryPool.get()).get();
+    ASSERT_EQ(response->headers()->getStatusCode(), http::kHttpOk);
+  }
+  const auto numRequests = serverPtr->numRequestsPerAcceptorGroup();
+  ASSERT_EQ(numRequests.size(), 2);
+  ASSERT_EQ(numRequests[0] + numRequests[1], kNumClients);
+
+  serverPtr->setNumExecThreads(4);
+  ASSERT_EQ(serverPtr->getExecutor()->numThreads(), 2);
+  wrapper.stop();
+}
+
+TEST(HttpBodyTest, decodeBody) {
+  std::string plain;
+  for (auto i = 0; i < 10'000; ++i) {
+    plain += fmt::format("split{},", i);
+  }
+  const auto plainBody = folly::IOBuf::copyBuffer(plain);
+  EXPECT_EQ(http::bodyToString(*http::decodeBody(*plainBody, "")), plain);
+  EXPECT_EQ(
+      http::bodyToString(*http::decodeBody(*plainBody, "identity")), plain);
+
+  for (const auto& [encoding, codecType] :
+       std::vector<std::pair<std::string, folly::io::CodecType>>{
+           {"gzip", folly::io::CodecType::GZIP},
+           {"zstd", folly::io::CodecType::ZSTD}}) {
+    SCOPED_TRACE(encoding);
+    const auto compressed = http::bodyToString(
+        *folly::io::getCodec(codecType)->compress(plainBody.get()));
+    // Splits the compressed body into a chain like received from the network.
+    auto body = folly::IOBuf::copyBuffer(compressed.substr(0, 7));
+    for (size_t offset = 7; offset < compressed.size(); offset += 100) {
+      body->appendToChain(
+          folly::IOBuf::copyBuffer(compressed.substr(offset, 100)));
+    }
+    EXPECT_EQ(http::bodyToString(*http::decodeBody(*body, encoding)), plain);
+  }
+
+  VELOX_ASSERT_THROW(
+      http::decodeBody(*plainBody, "br"), "Unsupported Content-Encoding: br");
+}
+
+TEST(StatsFilterTest, endpointClass) {
+  using http::filters::StatsFilter;
+  using EndpointClass = StatsFilter::EndpointClass;
+  using proxygen::HTTPMethod;
+  const auto endpointClass = [](HTTPMethod method, std::string_view path) {
+    return StatsFilter::endpointClass(method, path);
+  };
+  EXPECT_EQ(
+      endpointClass(HTTPMethod::POST, "/v1/task/q.1.0.0"),
+      EndpointClass::kCreateTask);
+  EXPECT_EQ(
+      endpointClass(HTTPMethod::POST, "/v1/task/q.1.0.0/batch"),
+      EndpointClass::kCreateTask);
+  EXPECT_EQ(
+      endpointClass(HTTPMethod::GET, "/v1/task/q.1.0.0/status"),
+      EndpointClass::kStatus);
+  EXPECT_EQ(
+      endpointClass(HTTPMethod::GET, "/v1/task/q.1.0.0"), EndpointClass::kInfo);
+  EXPECT_EQ(
+      endpointClass(HTTPMethod::GET, "/v1/task/q.1.0.0/results/0/12"),
+      EndpointClass::kResults);
+  EXPECT_EQ(
+      endpointClass(
+          HTTPMethod::GET, "/v1/task/q.1.0.0/results/0/12/acknowledge"),
+      EndpointClass::kAck);
+  EXPECT_EQ(
+      endpointClass(HTTPMethod::DELETE, "/v1/task/q.1.0.0"),
+      EndpointClass::kDelete);
+  EXPECT_EQ(
+      endpointClass(HTTPMethod::DELETE, "/v1/task/q.1.0.0/results/0"),
+      EndpointClass::kDelete);
+  EXPECT_EQ(endpointClass(HTTPMethod::GET, "/v1/info"), EndpointClass::kOther);
+  EXPECT_EQ(
+      endpointClass(HTTPMethod::POST, "/v1/task/q.1.0.0/remote-source/x"),
+      EndpointClass::kOther);
+}
+
+TEST(AccessLogFilterTest, sampling) {
+  using http::filters::AccessLogFilter;
+  using EndpointClass = http::filters::StatsFilter::EndpointClass;
+  http::filters::AccessLogOptions options;
+  options.sampleRate = 0.5;
+  options.parseEndpointSampleRates("status=0, results = 0.1");
+  EXPECT_TRUE(AccessLogFilter::isSampled(options, EndpointClass::kInfo, 0.4));
+  EXPECT_FALSE(AccessLogFilter::isSampled(options, EndpointClass::kInfo, 0.6));
+  EXPECT_FALSE(
+      AccessLogFilter::isSampled(options, EndpointClass::kStatus, 0.0));
+  EXPECT_TRUE(
+      AccessLogFilter::isSampled(options, EndpointClass::kResults, 0.05));
+  EXPECT_FALSE(
+      AccessLogFilter::isSampled(options, EndpointClass::kResults, 0.2));
+  EXPECT_THROW(options.parseEndpointSampleRates("unknown=1"), VeloxUserError);
+
+  // Slow and failed requests are logged when not sampled.
+  EXPECT_FALSE(AccessLogFilter::shouldLog(options, false, 200, 5'000));
+  options.slowRequestMs = 1'000;
+  EXPECT_TRUE(AccessLogFilter::shouldLog(options, true, 200, 10));
+  EXPECT_FALSE(AccessLogFilter::shouldLog(options, false, 200, 10));
+  EXPECT_TRUE(AccessLogFilter::shouldLog(options, false, 200, 5'000));
+  EXPECT_TRUE(AccessLogFilter::shouldLog(options, false, 500, 10));
+}
+
+TEST(AccessLogFilterTest, writer) {
+  std::mutex mutex;
+  std::vector<std::string> lines;
+  {
+    http::filters::AccessLogWriter writer(
+        2, [&](const std::vector<std::string>& batch) {
+          std::lock_guard<std::mutex> l(mutex);
+          lines.insert(lines.end(), batch.begin(), batch.end());
+        });
+    for (int i = 0; i < 100; ++i) {
+      http::filters::AccessLogRecord record;
+      record.method = "GET";
+      record.url = fmt::format("/v1/task/{}", i);
+      record.statusCode = 200;
+      writer.write(std::move(record));
+    }
+  }
+  // The records beyond the buffer size are dropped, the rest are written by
+  // the time the writer is destroyed.
+  ASSERT_FALSE(lines.empty());
+  ASSERT_LE(lines.size(), 100);
+  const auto record = nlohmann::json::parse(lines.front());
+  EXPECT_EQ(record["method"], "GET");
+  EXPECT_EQ(record["url"], "/v1/task/0");
+  EXPECT_EQ(record["status"], 200);
+}
+
 // Initialize singleton for the reporter
 folly::Singleton<facebook::velox::BaseStatsReporter> reporter([]() {
   return new facebook::velox::DummyStatsReporter();
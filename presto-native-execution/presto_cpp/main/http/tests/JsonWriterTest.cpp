@@ -0,0 +1,69 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/http/JsonWriter.h"
+#include <gtest/gtest.h>
+
+using namespace facebook::presto::http;
+using json = nlohmann::json;
+
+namespace {
+std::string toString(std::unique_ptr<folly::IOBuf> iobuf) {
+  return iobuf->moveToFbString().toStdString();
+}
+} // namespace
+
+TEST(JsonWriterTest, value) {
+  const json value = {{"b", {1, 2.5, "x"}}, {"a", nullptr}, {"c", true}};
+  EXPECT_EQ(toString(toJsonIOBuf(value)), value.dump());
+  EXPECT_EQ(toString(toJsonIOBuf(json::object())), "{}");
+}
+
+TEST(JsonWriterTest, streamedDocument) {
+  JsonWriter writer;
+  writer.beginObject();
+  writer.key("id");
+  writer.value("task.1");
+  writer.key("pipelines");
+  writer.beginArray();
+  for (int32_t i = 0; i < 3; ++i) {
+    writer.value({{"pipelineId", i}});
+  }
+  writer.beginArray();
+  writer.endArray();
+  writer.beginObject();
+  writer.endObject();
+  writer.endArray();
+  writer.key("quoted \"key\"");
+  writer.beginObject();
+  writer.key("empty");
+  writer.value(json::array());
+  writer.endObject();
+  writer.endObject();
+
+  const auto written = toString(writer.finish());
+  EXPECT_EQ(
+      written,
+      "{\"id\":\"task.1\",\"pipelines\":[{\"pipelineId\":0},"
+      "{\"pipelineId\":1},{\"pipelineId\":2},[],{}],"
+      "\"quoted \\\"key\\\"\":{\"empty\":[]}}");
+  EXPECT_EQ(json::parse(written)["pipelines"].size(), 5);
+}
+
+TEST(JsonWriterTest, unbalanced) {
+  JsonWriter writer;
+  writer.beginArray();
+  EXPECT_THROW(writer.key("key"), std::exception);
+  EXPECT_THROW(writer.endObject(), std::exception);
+  EXPECT_THROW(writer.finish(), std::exception);
+}
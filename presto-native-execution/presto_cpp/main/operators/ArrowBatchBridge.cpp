@@ -0,0 +1,57 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/operators/ArrowBatchBridge.h"
+
+using namespace facebook::velox;
+
+namespace facebook::presto::operators {
+
+void exportBatchToArrow(
+    const RowVectorPtr& batch,
+    ArrowSchema& schema,
+    ArrowArray& array,
+    memory::MemoryPool* pool) {
+  VELOX_CHECK_NOT_NULL(batch);
+  exportToArrow(batch, schema);
+  try {
+    exportToArrow(batch, array, pool);
+  } catch (const std::exception&) {
+    // The consumer doesn't get the schema if the array fails.
+    schema.release(&schema);
+    throw;
+  }
+}
+
+RowVectorPtr importBatchFromArrow(
+    ArrowSchema& schema,
+    ArrowArray& array,
+    memory::MemoryPool* pool,
+    const RowTypePtr& rowType) {
+  auto vector = importFromArrowAsOwner(schema, array, pool);
+  auto batch = std::dynamic_pointer_cast<RowVector>(vector);
+  VELOX_USER_CHECK_NOT_NULL(
+      batch, "Expected an Arrow struct batch: {}", vector->type()->toString());
+  if (rowType != nullptr) {
+    // Arrow doesn't keep all the Velox types, e.g. the JSON strings, so the
+    // columns are checked by kind.
+    VELOX_USER_CHECK(
+        batch->type()->kindEquals(rowType),
+        "Arrow batch of type {} doesn't match {}",
+        batch->type()->toString(),
+        rowType->toString());
+  }
+  return batch;
+}
+
+} // namespace facebook::presto::operators
@@ -0,0 +1,44 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include "velox/vector/ComplexVector.h"
+#include "velox/vector/arrow/Bridge.h"
+
+namespace facebook::presto::operators {
+
+/// Hands the batches of the native worker to and from a host in the same
+/// process, e.g. the Spark operators in the JVM over JNI, as Arrow C Data
+/// Interface structs. The buffers are shared, not serialized into rows.
+///
+/// Exports 'batch' to 'schema' and 'array'. The array references the buffers
+/// of 'batch', which stay alive until the consumer calls its release callback.
+/// The consumer owns both structs and must release them.
+void exportBatchToArrow(
+    const velox::RowVectorPtr& batch,
+    ArrowSchema& schema,
+    ArrowArray& array,
+    velox::memory::MemoryPool* pool);
+
+/// Imports the batch in 'schema' and 'array' exported by the host. Takes the
+/// ownership of both structs. The vectors of the batch wrap the Arrow buffers
+/// and release them once freed. Throws if the batch is not of 'rowType' when
+/// set.
+velox::RowVectorPtr importBatchFromArrow(
+    ArrowSchema& schema,
+    ArrowArray& array,
+    velox::memory::MemoryPool* pool,
+    const velox::RowTypePtr& rowType = nullptr);
+
+} // namespace facebook::presto::operators
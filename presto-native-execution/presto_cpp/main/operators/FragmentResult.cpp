@@ -0,0 +1,167 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/operators/FragmentResult.h"
+#include "velox/serializers/PrestoSerializer.h"
+
+using namespace facebook::velox::exec;
+using namespace facebook::velox;
+
+namespace facebook::presto::operators {
+namespace {
+class FragmentResultRecordOperator : public Operator {
+ public:
+  FragmentResultRecordOperator(
+      int32_t operatorId,
+      DriverCtx* FOLLY_NONNULL ctx,
+      const std::shared_ptr<const FragmentResultRecordNode>& planNode)
+      : Operator(
+            ctx,
+            planNode->outputType(),
+            operatorId,
+            planNode->id(),
+            "FragmentResultRecord"),
+        recorder_(planNode->recorder()) {}
+
+  bool needsInput() const override {
+    return !noMoreInput_ && !input_;
+  }
+
+  void addInput(RowVectorPtr input) override {
+    if (!recorder_->full()) {
+      recorder_->add(serialize(input));
+    }
+    input_ = std::move(input);
+  }
+
+  RowVectorPtr getOutput() override {
+    return std::move(input_);
+  }
+
+  BlockingReason isBlocked(ContinueFuture* /* future */) override {
+    return BlockingReason::kNotBlocked;
+  }
+
+  bool isFinished() override {
+    return noMoreInput_ && !input_;
+  }
+
+ private:
+  std::string serialize(const RowVectorPtr& input) {
+    const auto numRows = input->size();
+    const IndexRange range{0, numRows};
+    StreamArena arena(pool());
+    auto serializer =
+        serde_.createSerializer(asRowType(input->type()), numRows, &arena);
+    serializer->append(input, folly::Range(&range, 1));
+    std::ostringstream out;
+    OStreamOutputStream stream(&out);
+    serializer->flush(&stream);
+    return out.str();
+  }
+
+  const std::shared_ptr<FragmentResultRecorder> recorder_;
+  serializer::presto::PrestoVectorSerde serde_;
+};
+
+class FragmentResultValuesOperator : public Operator {
+ public:
+  FragmentResultValuesOperator(
+      int32_t operatorId,
+      DriverCtx* FOLLY_NONNULL ctx,
+      const std::shared_ptr<const FragmentResultValuesNode>& planNode)
+      : Operator(
+            ctx,
+            planNode->outputType(),
+            operatorId,
+            planNode->id(),
+            "FragmentResultValues"),
+        planNode_(planNode) {}
+
+  bool needsInput() const override {
+    return false;
+  }
+
+  void addInput(RowVectorPtr /* input */) override {
+    VELOX_FAIL("FragmentResultValues does not take input");
+  }
+
+  RowVectorPtr getOutput() override {
+    const auto* page = planNode_->nextPage();
+    if (page == nullptr) {
+      finished_ = true;
+      return nullptr;
+    }
+    ByteRange byteRange{
+        reinterpret_cast<uint8_t*>(const_cast<char*>(page->data())),
+        static_cast<int32_t>(page->size()),
+        0};
+    ByteStream input;
+    input.resetInput({byteRange});
+    RowVectorPtr result;
+    serde_.deserialize(&input, pool(), outputType_, &result, nullptr);
+    return result;
+  }
+
+  BlockingReason isBlocked(ContinueFuture* /* future */) override {
+    return BlockingReason::kNotBlocked;
+  }
+
+  bool isFinished() override {
+    return finished_;
+  }
+
+ private:
+  const std::shared_ptr<const FragmentResultValuesNode> planNode_;
+  serializer::presto::PrestoVectorSerde serde_;
+  bool finished_{false};
+};
+} // namespace
+
+void FragmentResultRecorder::add(std::string page) {
+  std::lock_guard<std::mutex> l(mutex_);
+  if (full_) {
+    return;
+  }
+  result_.bytes += page.size();
+  if (result_.bytes > maxBytes_) {
+    full_ = true;
+    result_.pages.clear();
+    return;
+  }
+  result_.pages.push_back(std::move(page));
+}
+
+std::shared_ptr<const FragmentResultPages> FragmentResultRecorder::finish() {
+  std::lock_guard<std::mutex> l(mutex_);
+  if (full_) {
+    return nullptr;
+  }
+  return std::make_shared<const FragmentResultPages>(std::move(result_));
+}
+
+std::unique_ptr<Operator> FragmentResultTranslator::toOperator(
+    DriverCtx* ctx,
+    int32_t id,
+    const core::PlanNodePtr& node) {
+  if (auto recordNode =
+          std::dynamic_pointer_cast<const FragmentResultRecordNode>(node)) {
+    return std::make_unique<FragmentResultRecordOperator>(id, ctx, recordNode);
+  }
+  if (auto valuesNode =
+          std::dynamic_pointer_cast<const FragmentResultValuesNode>(node)) {
+    return std::make_unique<FragmentResultValuesOperator>(id, ctx, valuesNode);
+  }
+  return nullptr;
+}
+} // namespace facebook::presto::operators
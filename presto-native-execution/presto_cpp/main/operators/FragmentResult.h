@@ -0,0 +1,138 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <atomic>
+#include <mutex>
+
+#include "velox/core/PlanNode.h"
+#include "velox/exec/Operator.h"
+
+namespace facebook::presto::operators {
+
+/// The result rows of a plan fragment serialized as PrestoPages.
+struct FragmentResultPages {
+  std::vector<std::string> pages;
+  uint64_t bytes{0};
+};
+
+/// Collects the rows that the drivers of a task pass through their
+/// FragmentResultRecordNode. Stops collecting once the rows exceed 'maxBytes'.
+class FragmentResultRecorder {
+ public:
+  explicit FragmentResultRecorder(uint64_t maxBytes) : maxBytes_(maxBytes) {}
+
+  /// Returns true if the rows exceeded the max bytes, after which the pages
+  /// are dropped.
+  bool full() const {
+    std::lock_guard<std::mutex> l(mutex_);
+    return full_;
+  }
+
+  void add(std::string page);
+
+  /// Returns the recorded pages or null if the rows exceeded the max bytes.
+  std::shared_ptr<const FragmentResultPages> finish();
+
+ private:
+  const uint64_t maxBytes_;
+  mutable std::mutex mutex_;
+  FragmentResultPages result_;
+  bool full_{false};
+};
+
+/// Passes the rows of its source through and records them into 'recorder'.
+class FragmentResultRecordNode : public velox::core::PlanNode {
+ public:
+  FragmentResultRecordNode(
+      const velox::core::PlanNodeId& id,
+      velox::core::PlanNodePtr source,
+      std::shared_ptr<FragmentResultRecorder> recorder)
+      : velox::core::PlanNode(id),
+        sources_{std::move(source)},
+        recorder_(std::move(recorder)) {}
+
+  const velox::RowTypePtr& outputType() const override {
+    return sources_[0]->outputType();
+  }
+
+  const std::vector<velox::core::PlanNodePtr>& sources() const override {
+    return sources_;
+  }
+
+  const std::shared_ptr<FragmentResultRecorder>& recorder() const {
+    return recorder_;
+  }
+
+  std::string_view name() const override {
+    return "FragmentResultRecord";
+  }
+
+ private:
+  void addDetails(std::stringstream& /* stream */) const override {}
+
+  const std::vector<velox::core::PlanNodePtr> sources_;
+  const std::shared_ptr<FragmentResultRecorder> recorder_;
+};
+
+/// Returns the rows of 'pages'. The drivers of the node share the pages, each
+/// page is returned once.
+class FragmentResultValuesNode : public velox::core::PlanNode {
+ public:
+  FragmentResultValuesNode(
+      const velox::core::PlanNodeId& id,
+      velox::RowTypePtr outputType,
+      std::shared_ptr<const FragmentResultPages> pages)
+      : velox::core::PlanNode(id),
+        outputType_(std::move(outputType)),
+        pages_(std::move(pages)) {}
+
+  const velox::RowTypePtr& outputType() const override {
+    return outputType_;
+  }
+
+  const std::vector<velox::core::PlanNodePtr>& sources() const override {
+    static const std::vector<velox::core::PlanNodePtr> kEmptySources;
+    return kEmptySources;
+  }
+
+  /// Returns the next page to return or null after the last page.
+  const std::string* nextPage() const {
+    const auto index = nextPage_++;
+    return index < pages_->pages.size() ? &pages_->pages[index] : nullptr;
+  }
+
+  std::string_view name() const override {
+    return "FragmentResultValues";
+  }
+
+ private:
+  void addDetails(std::stringstream& stream) const override {
+    stream << pages_->pages.size() << " pages";
+  }
+
+  const velox::RowTypePtr outputType_;
+  const std::shared_ptr<const FragmentResultPages> pages_;
+  mutable std::atomic<size_t> nextPage_{0};
+};
+
+class FragmentResultTranslator
+    : public velox::exec::Operator::PlanNodeTranslator {
+ public:
+  std::unique_ptr<velox::exec::Operator> toOperator(
+      velox::exec::DriverCtx* ctx,
+      int32_t id,
+      const velox::core::PlanNodePtr& node) override;
+};
+} // namespace facebook::presto::operators
@@ -12,101 +12,732 @@
  * limitations under the License.
  */
 #include "presto_cpp/main/operators/LocalPersistentShuffle.h"
+#include <fcntl.h>
+#include <folly/Synchronized.h>
+#include <folly/container/EvictingCacheMap.h>
+#include <folly/Conv.h>
+#include <folly/String.h>
+#include <folly/executors/SerialExecutor.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <boost/lexical_cast.hpp>
+#include <boost/uuid/uuid_generators.hpp>
+#include <boost/uuid/uuid_io.hpp>
 #include "presto_cpp/external/json/json.hpp"
 #include "presto_cpp/main/common/Configs.h"
+#include "presto_cpp/main/common/Counters.h"
+#include "velox/common/base/StatsReporter.h"
+#include "velox/common/time/Timer.h"
 
 using namespace facebook::velox::exec;
 using namespace facebook::velox;
+using json = nlohmann::json;
 
 namespace facebook::presto::operators {
 
 namespace {
-inline std::string createShuffleFileName(
+// The prefix of the manifest files of the writers of 'queryId'.
+inline std::string manifestFilePrefix(
     const std::string& rootPath,
-    const std::string& queryId,
-    uint32_t shuffleId,
-    int32_t partition,
-    int fileIndex,
-    const std::thread::id& id) {
-  // Follow Spark's shuffle file name format: shuffle_shuffleId_0_reduceId
-  return fmt::format(
-      "{}/{}_shuffle_{}_0_{}_{}_{}.bin",
-      rootPath,
-      queryId,
-      shuffleId,
-      partition,
-      fileIndex,
+    const std::string& queryId) {
+  return fmt::format("{}/{}_manifest_", rootPath, queryId);
+}
+
+// The prefix of the manifest files being written. Doesn't start with
+// manifestFilePrefix() so that the readers don't see them.
+inline std::string tmpManifestFilePrefix(
+    const std::string& rootPath,
+    const std::string& queryId) {
+  return fmt::format("{}/{}_tmp_manifest_", rootPath, queryId);
+}
+
+// The manifest of a writer lists the byte ranges of its data file holding the
+// blocks of each partition as flattened offset and size pairs, and the number
+// of rows of each partition, e.g. {"blocks": {"shuffle_0_0_3": [0, 1024, 4096,
+// 512]}, "rows": {"shuffle_0_0_3": 27}}. The manifest
+// <root>/<queryId>_manifest_<shuffleId>_<writerId>.json indexes the data file
+// <root>/<queryId>_data_<shuffleId>_<writerId>.bin and is written once all
+// the blocks of the writer are written. The manifest of an attempt of a map
+// task also has its "mapId" and "attemptId".
+const std::string kManifestFileExtension = ".json";
+
+// The contents of a manifest keyed by partition ids. The row counts are
+// missing in the manifests of the older writers.
+struct Manifest {
+  std::unordered_map<std::string, std::vector<uint64_t>> blocks;
+  std::unordered_map<std::string, uint64_t> rows;
+  // Empty if the writer is not an attempt of a map task.
+  std::string mapId;
+  uint32_t attemptId{0};
+};
+
+// The manifests are immutable once written, so the readers of the process
+// share their parsed contents keyed by the manifest file paths instead of
+// each reading all the manifests.
+constexpr size_t kMaxCachedManifests = 10'000;
+
+using ManifestCache =
+    folly::EvictingCacheMap<std::string, std::shared_ptr<const Manifest>>;
+
+folly::Synchronized<ManifestCache>& manifestCache() {
+  static folly::Synchronized<ManifestCache> manifestCache(
+      folly::in_place, kMaxCachedManifests);
+  return manifestCache;
+}
+
+std::shared_ptr<const Manifest> readManifest(
+    velox::filesystems::FileSystem& fileSystem,
+    const std::string& manifestFile) {
+  {
+    auto cache = manifestCache().rlock();
+    auto it = cache->findWithoutPromotion(manifestFile);
+    if (it != cache->end()) {
+      return it->second;
+    }
+  }
+  auto readFile = fileSystem.openFileForRead(manifestFile);
+  const auto manifestJson = json::parse(readFile->pread(0, readFile->size()));
+  auto manifest = std::make_shared<Manifest>();
+  for (const auto& [partitionId, ranges] : manifestJson.at("blocks").items()) {
+    auto& partitionRanges = manifest->blocks[partitionId];
+    ranges.get_to(partitionRanges);
+    VELOX_CHECK_EQ(
+        partitionRanges.size() % 2,
+        0,
+        "Invalid byte ranges of {} in shuffle manifest {}",
+        partitionId,
+        manifestFile);
+  }
+  if (manifestJson.contains("rows")) {
+    manifestJson.at("rows").get_to(manifest->rows);
+  }
+  if (manifestJson.contains("mapId")) {
+    manifestJson.at("mapId").get_to(manifest->mapId);
+    manifestJson.at("attemptId").get_to(manifest->attemptId);
+  }
+  manifestCache().wlock()->set(manifestFile, manifest);
+  return manifest;
+}
+
+// The parsed shuffle infos keyed by their JSON. Bounded since the infos of
+// the finished queries are not used again.
+constexpr size_t kMaxCachedShuffleInfos = 1'000;
+
+template <typename T>
+using ShuffleInfoCache =
+    folly::Synchronized<folly::EvictingCacheMap<std::string, T>>;
+
+// Returns the entry of 'serializedInfo' in 'cache'. Creates it with 'make'
+// if missing.
+template <typename T>
+T getOrMakeShuffleInfo(
+    ShuffleInfoCache<T>& cache,
+    const std::string& serializedInfo,
+    const std::function<T()>& make) {
+  {
+    auto lockedCache = cache.wlock();
+    auto it = lockedCache->find(serializedInfo);
+    if (it != lockedCache->end()) {
+      return it->second;
+    }
+  }
+  // Parsed outside of the lock. The concurrent parses of the same info are
+  // equivalent.
+  auto entry = make();
+  cache.wlock()->set(serializedInfo, entry);
+  return entry;
+}
+
+// Get rid of excess '/' characters in the path.
+std::string trimRootPath(const std::string& rootPath) {
+  auto trimmedRootPath = rootPath;
+  while (trimmedRootPath.length() > 0 &&
+         trimmedRootPath[trimmedRootPath.length() - 1] == '/') {
+    trimmedRootPath.erase(trimmedRootPath.length() - 1, 1);
+  }
+  return trimmedRootPath;
+}
+
+constexpr char kSplitSeparator = '@';
+
+// A partition id, or a split of it if 'numSplits' > 1.
+struct SplitPartitionId {
+  std::string partitionId;
+  uint32_t splitIndex{0};
+  uint32_t numSplits{1};
+
+  // Returns true if the 'blockIndex'-th block of the partition is in this
+  // split.
+  bool contains(uint64_t blockIndex) const {
+    return blockIndex % numSplits == splitIndex;
+  }
+};
+
+// Parses a partition id, or the id of a split of it formatted as
+// <partitionId>@<splitIndex>/<numSplits>.
+SplitPartitionId parseSplitPartitionId(const std::string& id) {
+  const auto separator = id.find(kSplitSeparator);
+  if (separator == std::string::npos) {
+    return {id};
+  }
+  SplitPartitionId split{id.substr(0, separator)};
+  const auto slash = id.find('/', separator);
+  VELOX_USER_CHECK_NE(
+      slash, std::string::npos, "Invalid shuffle partition id: {}", id);
+  split.splitIndex = folly::to<uint32_t>(
+      folly::StringPiece(id).subpiece(separator + 1, slash - separator - 1));
+  split.numSplits =
+      folly::to<uint32_t>(folly::StringPiece(id).subpiece(slash + 1));
+  VELOX_USER_CHECK_LT(
+      split.splitIndex,
+      split.numSplits,
+      "Invalid shuffle partition id: {}",
       id);
+  return split;
+}
+
+// Returns the manifest files of 'queryId' in 'files' in the same order for all
+// the readers so that the splits of a partition read disjoint blocks. Keeps
+// the files of the writers which are not attempts of a map task and, for each
+// map task, the files of all the writers of its lowest attempt. An attempt
+// has several writers if its drivers write the shuffle, e.g. with
+// shuffle.fuse-partition-and-write.
+std::vector<std::pair<std::string, std::shared_ptr<const Manifest>>>
+readManifests(
+    velox::filesystems::FileSystem& fileSystem,
+    std::vector<std::string> files,
+    const std::string& manifestPrefix) {
+  files.erase(
+      std::remove_if(
+          files.begin(),
+          files.end(),
+          [&](const auto& file) { return file.find(manifestPrefix) != 0; }),
+      files.end());
+  std::sort(files.begin(), files.end());
+
+  std::vector<std::pair<std::string, std::shared_ptr<const Manifest>>>
+      manifests;
+  manifests.reserve(files.size());
+  // The lowest attempt of each map task.
+  std::unordered_map<std::string, uint32_t> mapAttempts;
+  for (auto& file : files) {
+    auto manifest = readManifest(fileSystem, file);
+    if (!manifest->mapId.empty()) {
+      auto [it, inserted] =
+          mapAttempts.emplace(manifest->mapId, manifest->attemptId);
+      if (!inserted) {
+        it->second = std::min(it->second, manifest->attemptId);
+      }
+    }
+    manifests.emplace_back(std::move(file), std::move(manifest));
+  }
+  manifests.erase(
+      std::remove_if(
+          manifests.begin(),
+          manifests.end(),
+          [&](const auto& entry) {
+            const auto& manifest = *entry.second;
+            return !manifest.mapId.empty() &&
+                manifest.attemptId != mapAttempts.at(manifest.mapId);
+          }),
+      manifests.end());
+  return manifests;
+}
+
+// The read info and the listing its readers share.
+struct ReadInfoEntry {
+  explicit ReadInfoEntry(LocalShuffleReadInfo readInfo)
+      : info(std::move(readInfo)) {}
+
+  // Returns the listing of the live readers, or a new one if there are none.
+  // A reader created later, e.g. by a retry of the task, lists the files
+  // again to see the attempts of the map tasks committed since.
+  std::shared_ptr<LocalShuffleListing> listing() const {
+    std::lock_guard<std::mutex> l(mutex);
+    auto shared = sharedListing.lock();
+    if (shared == nullptr) {
+      shared = std::make_shared<LocalShuffleListing>();
+      sharedListing = shared;
+    }
+    return shared;
+  }
+
+  const LocalShuffleReadInfo info;
+  mutable std::mutex mutex;
+  mutable std::weak_ptr<LocalShuffleListing> sharedListing;
+};
+
+ShuffleInfoCache<std::shared_ptr<const ReadInfoEntry>>& readInfoCache() {
+  static ShuffleInfoCache<std::shared_ptr<const ReadInfoEntry>> cache(
+      folly::in_place, kMaxCachedShuffleInfos);
+  return cache;
 }
 
+ShuffleInfoCache<std::shared_ptr<const LocalShuffleWriteInfo>>&
+writeInfoCache() {
+  static ShuffleInfoCache<std::shared_ptr<const LocalShuffleWriteInfo>> cache(
+      folly::in_place, kMaxCachedShuffleInfos);
+  return cache;
+}
+
+// Appends the blocks to the data file in the order they are stored.
+folly::Executor::KeepAlive<> makeSerialExecutor(folly::Executor* executor) {
+  if (executor == nullptr) {
+    return {};
+  }
+  return folly::SerialExecutor::create(folly::getKeepAliveToken(executor));
+}
+
+// Unmaps the memory mapped file range of a block once its buffer is freed.
+class MmapReleaser {
+ public:
+  MmapReleaser(void* address, size_t length)
+      : address_(address), length_(length) {}
+
+  void addRef() const {}
+
+  void release() const {
+    ::munmap(address_, length_);
+  }
+
+ private:
+  void* const address_;
+  const size_t length_;
+};
+
+// Maps the 'size' bytes at 'offset' of the local file 'path' and asks the
+// kernel to read them ahead.
+BufferPtr
+mmapFileRange(const std::string& path, uint64_t offset, uint64_t size) {
+  static const uint64_t kPageSize = ::sysconf(_SC_PAGESIZE);
+  const auto mapOffset = offset - offset % kPageSize;
+  const auto length = size + offset - mapOffset;
+  const int fd = ::open(path.c_str(), O_RDONLY);
+  VELOX_CHECK_GE(
+      fd, 0, "Cannot open shuffle file {}: {}", path, folly::errnoStr(errno));
+  auto* address =
+      ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, mapOffset);
+  const auto mmapErrno = errno;
+  ::close(fd);
+  VELOX_CHECK(
+      address != MAP_FAILED,
+      "Cannot map {} bytes at {} of shuffle file {}: {}",
+      size,
+      offset,
+      path,
+      folly::errnoStr(mmapErrno));
+  ::madvise(address, length, MADV_WILLNEED);
+  return BufferView<MmapReleaser>::create(
+      reinterpret_cast<const uint8_t*>(address) + offset - mapOffset,
+      size,
+      MmapReleaser(address, length));
+}
+
+// Marks the offsets of the blocks kept in the memory store in the manifest.
+// The rest of the offset is the key of the block in the store.
+constexpr uint64_t kMemoryBlockFlag = 1ULL << 63;
+
 // This file is used to indicate that the shuffle system is ready to be used for
 // reading (acts as a sync point between readers if needed). Mostly used for
 // test purposes.
 const static std::string kReadyForReadFilename = "readyForRead";
 }; // namespace
 
+struct LocalShuffleListing {
+  std::once_flag listed;
+  // All the files under the root path.
+  std::vector<std::string> files;
+  // The committed manifests of the query, see readManifests().
+  std::vector<std::pair<std::string, std::shared_ptr<const Manifest>>>
+      manifests;
+};
+
+namespace {
+folly::Synchronized<std::unordered_set<LocalShuffleMemoryStore*>>&
+memoryStores() {
+  static folly::Synchronized<std::unordered_set<LocalShuffleMemoryStore*>>
+      stores;
+  return stores;
+}
+} // namespace
+
+LocalShuffleMemoryStore::LocalShuffleMemoryStore(uint64_t capacity)
+    : capacity_(capacity),
+      rootPool_(memory::defaultMemoryManager().addRootPool(
+          "LocalShuffleMemoryStore")),
+      pool_(rootPool_->addLeafChild("LocalShuffleMemoryStore")) {
+  memoryStores().wlock()->insert(this);
+}
+
+LocalShuffleMemoryStore::~LocalShuffleMemoryStore() {
+  memoryStores().wlock()->erase(this);
+}
+
+// static
+void LocalShuffleMemoryStore::releaseQuery(const std::string& queryId) {
+  auto stores = memoryStores().rlock();
+  for (auto* store : *stores) {
+    store->removeQuery(queryId);
+  }
+}
+
+bool LocalShuffleMemoryStore::add(
+    const std::string& queryId,
+    const std::string& dataFile,
+    uint64_t offset,
+    std::string_view block) {
+  std::lock_guard<std::mutex> l(mutex_);
+  if (bytes_ + block.size() > capacity_) {
+    return false;
+  }
+  auto buffer = AlignedBuffer::allocate<char>(block.size(), pool_.get());
+  memcpy(buffer->asMutable<char>(), block.data(), block.size());
+  bytes_ += block.size();
+  blocks_.emplace(std::make_pair(dataFile, offset), std::move(buffer));
+  queryFiles_[queryId].insert(dataFile);
+  return true;
+}
+
+BufferPtr LocalShuffleMemoryStore::get(
+    const std::string& dataFile,
+    uint64_t offset) const {
+  std::lock_guard<std::mutex> l(mutex_);
+  auto it = blocks_.find(std::make_pair(dataFile, offset));
+  VELOX_CHECK(
+      it != blocks_.end(),
+      "Shuffle block at {} of {} not found in memory",
+      offset,
+      dataFile);
+  return it->second;
+}
+
+void LocalShuffleMemoryStore::remove(const std::string& prefix) {
+  std::lock_guard<std::mutex> l(mutex_);
+  removeLocked(prefix);
+}
+
+void LocalShuffleMemoryStore::removeLocked(const std::string& prefix) {
+  auto it = blocks_.lower_bound(std::make_pair(prefix, 0));
+  while (it != blocks_.end() &&
+         it->first.first.compare(0, prefix.size(), prefix) == 0) {
+    bytes_ -= it->second->size();
+    it = blocks_.erase(it);
+  }
+}
+
+void LocalShuffleMemoryStore::removeQuery(const std::string& queryId) {
+  std::lock_guard<std::mutex> l(mutex_);
+  auto it = queryFiles_.find(queryId);
+  if (it == queryFiles_.end()) {
+    return;
+  }
+  for (const auto& dataFile : it->second) {
+    removeLocked(dataFile);
+  }
+  queryFiles_.erase(it);
+}
+
+uint64_t LocalShuffleMemoryStore::bytes() const {
+  std::lock_guard<std::mutex> l(mutex_);
+  return bytes_;
+}
+
 LocalPersistentShuffleWriter::LocalPersistentShuffleWriter(
     const std::string& rootPath,
     const std::string& queryId,
     uint32_t shuffleId,
     uint32_t numPartitions,
     uint64_t maxBytesPerPartition,
-    velox::memory::MemoryPool* FOLLY_NONNULL pool)
+    velox::memory::MemoryPool* FOLLY_NONNULL pool,
+    folly::Executor* writeExecutor,
+    uint64_t maxInFlightBytes,
+    const std::string& mapId,
+    uint32_t attemptId,
+    std::shared_ptr<LocalShuffleMemoryStore> memoryStore)
     : maxBytesPerPartition_(maxBytesPerPartition),
-      threadId_(std::this_thread::get_id()),
       pool_(pool),
       numPartitions_(numPartitions),
+      memoryStore_(std::move(memoryStore)),
+      writeExecutor_(makeSerialExecutor(writeExecutor)),
+      inFlight_(std::make_shared<InFlightWrites>()),
       rootPath_(std::move(rootPath)),
+      queryId_(std::move(queryId)),
       shuffleId_(shuffleId),
-      queryId_(std::move(queryId)) {
+      mapId_(mapId),
+      attemptId_(attemptId),
+      writerId_(
+          boost::lexical_cast<std::string>(boost::uuids::random_generator()())),
+      // Named as by the readers, which key the blocks in memory by it.
+      dataFileName_(fmt::format(
+          "{}/{}_data_{}_{}.bin",
+          trimRootPath(rootPath_),
+          queryId_,
+          shuffleId_,
+          writerId_)),
+      manifestFileName_(fmt::format(
+          "{}{}_{}{}",
+          manifestFilePrefix(rootPath_, queryId_),
+          shuffleId_,
+          writerId_,
+          kManifestFileExtension)),
+      tmpManifestFileName_(fmt::format(
+          "{}{}_{}{}",
+          tmpManifestFilePrefix(rootPath_, queryId_),
+          shuffleId_,
+          writerId_,
+          kManifestFileExtension)) {
   // Use resize/assign instead of resize(size, val).
   inProgressPartitions_.resize(numPartitions_);
   inProgressPartitions_.assign(numPartitions_, nullptr);
   inProgressSizes_.resize(numPartitions_);
   inProgressSizes_.assign(numPartitions_, 0);
+  partitionRanges_.resize(numPartitions_);
+  partitionRows_.resize(numPartitions_);
+  partitionRows_.assign(numPartitions_, 0);
+  inFlight_->maxBytes = maxInFlightBytes;
   fileSystem_ = velox::filesystems::getFileSystem(rootPath_, nullptr);
 }
 
-std::unique_ptr<velox::WriteFile>
-LocalPersistentShuffleWriter::getNextOutputFile(int32_t partition) {
-  auto filename = nextAvailablePartitionFileName(rootPath_, partition);
-  return fileSystem_->openFileForWrite(filename);
+LocalPersistentShuffleWriter::~LocalPersistentShuffleWriter() {
+  waitForWrites();
 }
 
-std::string LocalPersistentShuffleWriter::nextAvailablePartitionFileName(
-    const std::string& root,
-    int32_t partition) const {
-  int fileCount = 0;
-  std::string filename;
-  // TODO: consider to maintain the next to create file count in memory as we
-  // always do cleanup when switch to a new root directory path.
-  do {
-    filename = createShuffleFileName(
-        root, queryId_, shuffleId_, partition, fileCount, threadId_);
-    if (!fileSystem_->exists(filename)) {
-      break;
+void LocalPersistentShuffleWriter::waitForWrites() {
+  std::unique_lock<std::mutex> l(inFlight_->mutex);
+  inFlight_->allWritten.wait(l, [&]() { return inFlight_->bytes == 0; });
+}
+
+void LocalPersistentShuffleWriter::checkWriteError() {
+  std::lock_guard<std::mutex> l(inFlight_->mutex);
+  if (inFlight_->error) {
+    std::rethrow_exception(inFlight_->error);
+  }
+}
+
+// static
+void LocalPersistentShuffleWriter::appendBlock(
+    InFlightWrites& inFlight,
+    velox::filesystems::FileSystem& fileSystem,
+    const std::string& dataFileName,
+    const BufferPtr& buffer) {
+  uint64_t writeMicros{0};
+  {
+    velox::MicrosecondTimer timer(&writeMicros);
+    if (inFlight.dataFile == nullptr) {
+      inFlight.dataFile = fileSystem.openFileForWrite(dataFileName);
+      ++inFlight.numCreatedFiles;
+      REPORT_ADD_STAT_VALUE(kCounterShuffleNumCreatedFiles);
     }
-    ++fileCount;
-  } while (true);
+    inFlight.dataFile->append(
+        std::string_view(buffer->as<char>(), buffer->size()));
+  }
+  inFlight.writtenBytes += buffer->size();
+  ++inFlight.numWrittenBlocks;
+  inFlight.writeMicros += writeMicros;
+  REPORT_ADD_STAT_VALUE(kCounterShuffleWrittenBytes, buffer->size());
+  REPORT_ADD_STAT_VALUE(kCounterShuffleWriteLatencyUs, writeMicros);
+}
+
+void LocalPersistentShuffleWriter::scheduleWrite(
+    uint64_t size,
+    std::function<void()> write) {
+  if (writeExecutor_.get() == nullptr) {
+    write();
+    return;
+  }
 
-  return filename;
+  // The partitions fill new blocks while this one is written.
+  checkWriteError();
+  {
+    std::lock_guard<std::mutex> l(inFlight_->mutex);
+    inFlight_->bytes += size;
+  }
+  writeExecutor_->add(
+      [inFlight = inFlight_, size, write = std::move(write)]() mutable {
+        bool failed;
+        {
+          std::lock_guard<std::mutex> l(inFlight->mutex);
+          failed = inFlight->error != nullptr;
+        }
+        // Skips the writes after a failed one, which would leave a manifest
+        // pointing at missing data.
+        std::exception_ptr error;
+        if (!failed) {
+          try {
+            write();
+          } catch (const std::exception&) {
+            error = std::current_exception();
+          }
+        }
+        // Frees the block before the writer can be destroyed.
+        write = nullptr;
+
+        std::vector<ContinuePromise> promises;
+        {
+          std::lock_guard<std::mutex> l(inFlight->mutex);
+          inFlight->bytes -= size;
+          if (error != nullptr && inFlight->error == nullptr) {
+            inFlight->error = error;
+          }
+          if (inFlight->bytes <= inFlight->maxBytes ||
+              inFlight->error != nullptr) {
+            promises = std::move(inFlight->promises);
+            inFlight->promises.clear();
+          }
+          if (inFlight->bytes == 0) {
+            inFlight->allWritten.notify_all();
+          }
+        }
+        for (auto& promise : promises) {
+          promise.setValue();
+        }
+      });
 }
 
 void LocalPersistentShuffleWriter::storePartitionBlock(int32_t partition) {
-  auto& buffer = inProgressPartitions_[partition];
-  auto file = getNextOutputFile(partition);
-  file->append(
-      std::string_view(buffer->as<char>(), inProgressSizes_[partition]));
-  file->close();
+  auto buffer = std::move(inProgressPartitions_[partition]);
+  const auto size = inProgressSizes_[partition];
+  buffer->setSize(size);
   inProgressPartitions_[partition].reset();
   inProgressSizes_[partition] = 0;
+
+  auto& ranges = partitionRanges_[partition];
+  if (memoryStore_ != nullptr &&
+      memoryStore_->add(
+          queryId_,
+          dataFileName_,
+          memoryBytes_,
+          std::string_view(buffer->as<char>(), size))) {
+    ranges.push_back(memoryBytes_ | kMemoryBlockFlag);
+    ranges.push_back(size);
+    memoryBytes_ += size;
+    ++numMemoryBlocks_;
+    return;
+  }
+
+  // The blocks are appended in the order they are scheduled.
+  ranges.push_back(dataFileSize_);
+  ranges.push_back(size);
+  dataFileSize_ += size;
+  scheduleWrite(
+      size,
+      [inFlight = inFlight_,
+       fileSystem = fileSystem_,
+       dataFileName = dataFileName_,
+       buffer = std::move(buffer)]() {
+        appendBlock(*inFlight, *fileSystem, dataFileName, buffer);
+      });
+}
+
+void LocalPersistentShuffleWriter::storeManifest() {
+  json::object_t blocks;
+  json::object_t rows;
+  for (auto partition = 0; partition < numPartitions_; ++partition) {
+    if (!partitionRanges_[partition].empty()) {
+      const auto partitionId =
+          fmt::format("shuffle_{}_0_{}", shuffleId_, partition);
+      blocks[partitionId] = partitionRanges_[partition];
+      rows[partitionId] = partitionRows_[partition];
+    }
+  }
+  json manifestJson = json::object();
+  manifestJson["blocks"] = std::move(blocks);
+  manifestJson["rows"] = std::move(rows);
+  if (!mapId_.empty()) {
+    manifestJson["mapId"] = mapId_;
+    manifestJson["attemptId"] = attemptId_;
+  }
+  const auto content = manifestJson.dump();
+
+  auto manifest = AlignedBuffer::allocate<char>(content.size(), pool_);
+  ::memcpy(manifest->asMutable<char>(), content.data(), content.size());
+  // Runs after all the blocks are appended to the data file.
+  scheduleWrite(
+      manifest->size(),
+      [inFlight = inFlight_,
+       fileSystem = fileSystem_,
+       manifestFile = manifestFileName_,
+       tmpManifestFile = tmpManifestFileName_,
+       manifest = std::move(manifest)]() {
+        if (inFlight->dataFile != nullptr) {
+          inFlight->dataFile->close();
+          inFlight->dataFile.reset();
+        }
+        uint64_t writeMicros{0};
+        {
+          velox::MicrosecondTimer timer(&writeMicros);
+          auto file = fileSystem->openFileForWrite(tmpManifestFile);
+          file->append(
+              std::string_view(manifest->as<char>(), manifest->size()));
+          file->close();
+          // Commits the output of the writer.
+          fileSystem->rename(tmpManifestFile, manifestFile);
+        }
+        ++inFlight->numCreatedFiles;
+        inFlight->writeMicros += writeMicros;
+        REPORT_ADD_STAT_VALUE(kCounterShuffleNumCreatedFiles);
+      });
+}
+
+std::unordered_map<std::string, RuntimeCounter>
+LocalPersistentShuffleWriter::stats() const {
+  return {
+      {"shuffleWrittenBytes",
+       RuntimeCounter(inFlight_->writtenBytes, RuntimeCounter::Unit::kBytes)},
+      {"shuffleWrittenBlocks", RuntimeCounter(inFlight_->numWrittenBlocks)},
+      {"shuffleCreatedFiles", RuntimeCounter(inFlight_->numCreatedFiles)},
+      {"shuffleWriteWallNanos",
+       RuntimeCounter(
+           inFlight_->writeMicros * 1'000, RuntimeCounter::Unit::kNanos)},
+      {"shuffleBlockedWrites", RuntimeCounter(numBlockedWrites_)},
+      {"shuffleMemoryBytes",
+       RuntimeCounter(memoryBytes_, RuntimeCounter::Unit::kBytes)},
+      {"shuffleMemoryBlocks", RuntimeCounter(numMemoryBlocks_)},
+  };
+}
+
+bool LocalPersistentShuffleWriter::isBlocked(ContinueFuture* future) {
+  if (writeExecutor_.get() == nullptr) {
+    return false;
+  }
+  std::lock_guard<std::mutex> l(inFlight_->mutex);
+  if (inFlight_->error != nullptr) {
+    std::rethrow_exception(inFlight_->error);
+  }
+  if (inFlight_->bytes <= inFlight_->maxBytes) {
+    return false;
+  }
+  ++numBlockedWrites_;
+  REPORT_ADD_STAT_VALUE(kCounterShuffleNumBlockedWrites);
+  auto [promise, blockedFuture] = makeVeloxContinuePromiseContract(
+      "LocalPersistentShuffleWriter::isBlocked");
+  inFlight_->promises.push_back(std::move(promise));
+  *future = std::move(blockedFuture);
+  return true;
+}
+
+bool LocalPersistentShuffleWriter::hasPendingWrites() const {
+  if (writeExecutor_.get() == nullptr) {
+    return false;
+  }
+  std::lock_guard<std::mutex> l(inFlight_->mutex);
+  if (inFlight_->error != nullptr) {
+    std::rethrow_exception(inFlight_->error);
+  }
+  return inFlight_->bytes > inFlight_->maxBytes;
 }
 
 void LocalPersistentShuffleWriter::collect(
     int32_t partition,
     std::string_view data) {
+  ::memcpy(reserve(partition, data.size(), 1), data.data(), data.size());
+}
+
+char* LocalPersistentShuffleWriter::reserve(
+    int32_t partition,
+    size_t size,
+    uint32_t numRows) {
   auto& buffer = inProgressPartitions_[partition];
-  const auto size = data.size();
 
   // Check if there is enough space in the buffer.
   if ((buffer != nullptr) &&
@@ -123,25 +754,90 @@ void LocalPersistentShuffleWriter::collect(
     inProgressPartitions_[partition] = buffer;
   }
 
-  // Copy data.
-  auto rawBuffer = buffer->asMutable<char>();
-  auto offset = inProgressSizes_[partition];
+  auto data = buffer->asMutable<char>() + inProgressSizes_[partition];
+  inProgressSizes_[partition] += size;
+  partitionRows_[partition] += numRows;
+  return data;
+}
+
+void LocalPersistentShuffleWriter::collect(
+    folly::Range<const int32_t*> partitions,
+    folly::Range<const StringView*> rows) {
+  VELOX_CHECK_EQ(partitions.size(), rows.size());
+  const auto numRows = partitions.size();
 
-  ::memcpy(rawBuffer + offset, data.data(), size);
+  // Counting sort the rows by partition.
+  partitionOffsets_.assign(numPartitions_ + 1, 0);
+  partitionBytes_.assign(numPartitions_, 0);
+  for (auto row = 0; row < numRows; ++row) {
+    ++partitionOffsets_[partitions[row] + 1];
+    partitionBytes_[partitions[row]] += rows[row].size();
+  }
+  for (auto partition = 1; partition <= numPartitions_; ++partition) {
+    partitionOffsets_[partition] += partitionOffsets_[partition - 1];
+  }
+  // Moves the start offset of each partition to its end offset.
+  sortedRows_.resize(numRows);
+  for (auto row = 0; row < numRows; ++row) {
+    sortedRows_[partitionOffsets_[partitions[row]]++] = row;
+  }
 
-  inProgressSizes_[partition] += size;
+  uint32_t begin = 0;
+  for (auto partition = 0; partition < numPartitions_; ++partition) {
+    const auto end = partitionOffsets_[partition];
+    if (begin == end) {
+      continue;
+    }
+    auto& buffer = inProgressPartitions_[partition];
+    // Same condition as in the single row collect() which would not store the
+    // in-progress block for any of the rows.
+    if (buffer != nullptr &&
+        inProgressSizes_[partition] + partitionBytes_[partition] <
+            buffer->capacity()) {
+      auto rawBuffer = buffer->asMutable<char>();
+      auto offset = inProgressSizes_[partition];
+      for (auto i = begin; i < end; ++i) {
+        const auto& data = rows[sortedRows_[i]];
+        ::memcpy(rawBuffer + offset, data.data(), data.size());
+        offset += data.size();
+      }
+      inProgressSizes_[partition] = offset;
+      partitionRows_[partition] += end - begin;
+    } else {
+      for (auto i = begin; i < end; ++i) {
+        const auto& data = rows[sortedRows_[i]];
+        collect(partition, std::string_view(data.data(), data.size()));
+      }
+    }
+    begin = end;
+  }
 }
 
 void LocalPersistentShuffleWriter::noMoreData(bool success) {
-  // Delete all shuffle files on failure.
+  // Delete the files of this writer on failure. The other writers, e.g. the
+  // other attempts of the same map task, keep theirs.
   if (!success) {
+    waitForWrites();
+    // All the writes are done, so the data file is no longer shared.
+    inFlight_->dataFile.reset();
+    for (auto i = 0; i < numPartitions_; ++i) {
+      inProgressPartitions_[i].reset();
+      inProgressSizes_[i] = 0;
+    }
     cleanup();
+    return;
   }
   for (auto i = 0; i < numPartitions_; ++i) {
     if (inProgressSizes_[i] > 0) {
       storePartitionBlock(i);
     }
   }
+  {
+    // Blocks the writer until all the blocks and the manifest are written.
+    std::lock_guard<std::mutex> l(inFlight_->mutex);
+    inFlight_->maxBytes = 0;
+  }
+  storeManifest();
 }
 
 LocalPersistentShuffleReader::LocalPersistentShuffleReader(
@@ -149,70 +845,299 @@ LocalPersistentShuffleReader::LocalPersistentShuffleReader(
     const std::string& queryId,
     std::vector<std::string> partitionIds,
     const int32_t partition,
-    velox::memory::MemoryPool* FOLLY_NONNULL pool)
+    velox::memory::MemoryPool* FOLLY_NONNULL pool,
+    folly::Executor* readExecutor,
+    uint32_t maxPrefetchBlocks,
+    uint64_t maxPrefetchBytes,
+    bool useMmap,
+    std::shared_ptr<LocalShuffleMemoryStore> memoryStore,
+    std::shared_ptr<LocalShuffleListing> listing,
+    std::string runFile)
     : rootPath_(rootPath),
       queryId_(queryId),
       partitionIds_(std::move(partitionIds)),
       partition_(partition),
-      pool_(pool) {
+      pool_(pool),
+      runFile_(std::move(runFile)),
+      readExecutor_(maxPrefetchBlocks > 0 ? readExecutor : nullptr),
+      maxPrefetchBlocks_(maxPrefetchBlocks),
+      maxPrefetchBytes_(maxPrefetchBytes),
+      // Only the files on a local disk can be mapped.
+      useMmap_(useMmap && !rootPath.empty() && rootPath[0] == '/'),
+      memoryStore_(std::move(memoryStore)),
+      listing_(
+          listing != nullptr ? std::move(listing)
+                             : std::make_shared<LocalShuffleListing>()),
+      readStats_(std::make_shared<ReadStats>()) {
   fileSystem_ = velox::filesystems::getFileSystem(rootPath_, nullptr);
 }
 
+LocalPersistentShuffleReader::~LocalPersistentShuffleReader() {
+  clearPrefetches();
+}
+
+std::vector<std::string> LocalPersistentShuffleReader::runFiles() {
+  hasNext();
+  std::vector<std::string> files;
+  for (const auto& block : readPartitionBlocks_) {
+    if (files.empty() || files.back() != block.file) {
+      files.push_back(block.file);
+    }
+  }
+  return files;
+}
+
 bool LocalPersistentShuffleReader::hasNext() {
-  if (readPartitionFiles_.empty()) {
-    readPartitionFiles_ = getReadPartitionFiles();
+  if (readPartitionBlocks_.empty()) {
+    readPartitionBlocks_ = getReadPartitionBlocks();
   }
 
-  return readPartitionFileIndex_ < readPartitionFiles_.size();
+  return readPartitionBlockIndex_ < readPartitionBlocks_.size();
 }
 
 BufferPtr LocalPersistentShuffleReader::next(bool success) {
-  // On failure, reset the index of the files to be read.
+  // On failure, reset the index of the blocks to be read.
   if (!success) {
-    readPartitionFileIndex_ = 0;
+    clearPrefetches();
+    readPartitionBlockIndex_ = 0;
   }
 
-  auto filename = readPartitionFiles_[readPartitionFileIndex_];
-  auto file = fileSystem_->openFileForRead(filename);
-  auto buffer = AlignedBuffer::allocate<char>(file->size(), pool_, 0);
-  file->pread(0, file->size(), buffer->asMutable<void>());
-  ++readPartitionFileIndex_;
+  if (readExecutor_ == nullptr) {
+    const auto& block = readPartitionBlocks_[readPartitionBlockIndex_];
+    if (block.inMemory) {
+      ++readPartitionBlockIndex_;
+      return readMemoryBlock(block);
+    }
+    auto file = openFile(block);
+    auto buffer = readBlock(
+        file,
+        block.file,
+        block.offset,
+        block.size.value_or(file->size()),
+        useMmap_,
+        pool_,
+        *readStats_);
+    ++readPartitionBlockIndex_;
+    return buffer;
+  }
+
+  return nextPrefetch().get();
+}
+
+folly::SemiFuture<BufferPtr> LocalPersistentShuffleReader::nextAsync(
+    uint64_t /*maxBytes*/) {
+  if (readExecutor_ == nullptr || !hasNext()) {
+    return ShuffleReader::nextAsync(0);
+  }
+  return nextPrefetch().semi();
+}
+
+folly::Future<BufferPtr> LocalPersistentShuffleReader::nextPrefetch() {
+  prefetch();
+  auto future = std::move(prefetches_.front());
+  prefetches_.pop_front();
+  prefetchBytes_ -= prefetchSizes_.front();
+  prefetchSizes_.pop_front();
+  ++readPartitionBlockIndex_;
+  // Starts reading the next block before waiting for this one.
+  prefetch();
+  return future;
+}
+
+std::shared_ptr<velox::ReadFile> LocalPersistentShuffleReader::openFile(
+    const ReadBlock& block) {
+  if (readFile_ == nullptr || readFileName_ != block.file) {
+    readFile_ = fileSystem_->openFileForRead(block.file);
+    readFileName_ = block.file;
+    ++readStats_->numOpenedFiles;
+  }
+  return readFile_;
+}
+
+BufferPtr LocalPersistentShuffleReader::readMemoryBlock(
+    const ReadBlock& block) {
+  VELOX_CHECK_NOT_NULL(
+      memoryStore_,
+      "Shuffle block of {} is in memory but the reader has no memory store",
+      block.file);
+  auto buffer = memoryStore_->get(block.file, block.offset);
+  readStats_->readBytes += buffer->size();
+  ++readStats_->numReadBlocks;
+  REPORT_ADD_STAT_VALUE(kCounterShuffleReadBytes, buffer->size());
   return buffer;
 }
 
-std::vector<std::string> LocalPersistentShuffleReader::getReadPartitionFiles()
-    const {
-  // Get rid of excess '/' characters in the path.
-  auto trimmedRootPath = rootPath_;
-  while (trimmedRootPath.length() > 0 &&
-         trimmedRootPath[trimmedRootPath.length() - 1] == '/') {
-    trimmedRootPath.erase(trimmedRootPath.length() - 1, 1);
+// static
+BufferPtr LocalPersistentShuffleReader::readBlock(
+    const std::shared_ptr<velox::ReadFile>& file,
+    const std::string& fileName,
+    uint64_t offset,
+    uint64_t size,
+    bool useMmap,
+    velox::memory::MemoryPool* pool,
+    ReadStats& stats) {
+  BufferPtr buffer;
+  uint64_t readMicros{0};
+  {
+    velox::MicrosecondTimer timer(&readMicros);
+    // An empty range can't be mapped.
+    if (useMmap && size > 0) {
+      buffer = mmapFileRange(fileName, offset, size);
+    } else {
+      buffer = AlignedBuffer::allocate<char>(size, pool, 0);
+      file->pread(offset, size, buffer->asMutable<void>());
+    }
   }
+  stats.readBytes += size;
+  ++stats.numReadBlocks;
+  stats.readMicros += readMicros;
+  REPORT_ADD_STAT_VALUE(kCounterShuffleReadBytes, size);
+  REPORT_ADD_STAT_VALUE(kCounterShuffleReadLatencyUs, readMicros);
+  return buffer;
+}
 
-  std::vector<std::string> partitionFiles;
+std::unordered_map<std::string, RuntimeCounter>
+LocalPersistentShuffleReader::stats() const {
+  return {
+      {"shuffleReadBytes",
+       RuntimeCounter(readStats_->readBytes, RuntimeCounter::Unit::kBytes)},
+      {"shuffleReadBlocks", RuntimeCounter(readStats_->numReadBlocks)},
+      {"shuffleOpenedFiles", RuntimeCounter(readStats_->numOpenedFiles)},
+      {"shuffleReadWallNanos",
+       RuntimeCounter(
+           readStats_->readMicros * 1'000, RuntimeCounter::Unit::kNanos)},
+  };
+}
+
+void LocalPersistentShuffleReader::prefetch() {
+  auto index = readPartitionBlockIndex_ + prefetches_.size();
+  while (prefetches_.size() < maxPrefetchBlocks_ &&
+         index < readPartitionBlocks_.size()) {
+    const auto& block = readPartitionBlocks_[index];
+    if (block.inMemory) {
+      // Nothing to read ahead.
+      prefetches_.push_back(folly::makeFuture(readMemoryBlock(block)));
+      prefetchSizes_.push_back(0);
+      ++index;
+      continue;
+    }
+    auto file = openFile(block);
+    const auto size = block.size.value_or(file->size());
+    // Always reads the next block regardless of its size.
+    if (!prefetches_.empty() && prefetchBytes_ + size > maxPrefetchBytes_) {
+      break;
+    }
+    prefetches_.push_back(folly::via(
+        readExecutor_,
+        [file = std::move(file),
+         fileName = block.file,
+         offset = block.offset,
+         size,
+         useMmap = useMmap_,
+         pool = pool_,
+         stats = readStats_]() {
+          return readBlock(
+              file, fileName, offset, size, useMmap, pool, *stats);
+        }));
+    prefetchSizes_.push_back(size);
+    prefetchBytes_ += size;
+    ++index;
+  }
+}
+
+void LocalPersistentShuffleReader::clearPrefetches() {
+  for (auto& future : prefetches_) {
+    // The errors of the dropped blocks are ignored.
+    future.wait();
+  }
+  prefetches_.clear();
+  prefetchSizes_.clear();
+  prefetchBytes_ = 0;
+}
+
+std::vector<LocalPersistentShuffleReader::ReadBlock>
+LocalPersistentShuffleReader::getReadPartitionBlocks() const {
+  const auto trimmedRootPath = trimRootPath(rootPath_);
+  std::vector<SplitPartitionId> splits;
   for (const auto& partitionId : partitionIds_) {
-    auto prefix =
-        fmt::format("{}/{}_{}_", trimmedRootPath, queryId_, partitionId);
-    auto files = fileSystem_->list(fmt::format("{}/", rootPath_));
-    for (const auto& file : files) {
-      if (file.find(prefix) == 0) {
-        partitionFiles.push_back(file);
+    splits.push_back(parseSplitPartitionId(partitionId));
+  }
+  // The number of blocks of the partition of each of 'splits' seen so far.
+  std::vector<uint64_t> numBlocks(splits.size(), 0);
+
+  // Reads the byte ranges of the partitions in the data files of the writers
+  // from their manifests.
+  const auto manifestPrefix = manifestFilePrefix(trimmedRootPath, queryId_);
+  std::call_once(listing_->listed, [&]() {
+    listing_->files = fileSystem_->list(fmt::format("{}/", rootPath_));
+    listing_->manifests =
+        readManifests(*fileSystem_, listing_->files, manifestPrefix);
+  });
+  const auto& files = listing_->files;
+  const auto& manifests = listing_->manifests;
+  std::vector<ReadBlock> partitionBlocks;
+  for (const auto& [file, manifest] : manifests) {
+    // The manifest file name is <prefix><shuffleId>_<writerId>.json and its
+    // data file is <root>/<queryId>_data_<shuffleId>_<writerId>.bin.
+    const auto fileId = file.substr(
+        manifestPrefix.size(),
+        file.size() - manifestPrefix.size() - kManifestFileExtension.size());
+    const auto dataFile =
+        fmt::format("{}/{}_data_{}.bin", trimmedRootPath, queryId_, fileId);
+    if (!runFile_.empty() && dataFile != runFile_) {
+      continue;
+    }
+    for (size_t i = 0; i < splits.size(); ++i) {
+      auto it = manifest->blocks.find(splits[i].partitionId);
+      if (it == manifest->blocks.end()) {
+        continue;
+      }
+      const auto& ranges = it->second;
+      for (size_t j = 0; j < ranges.size(); j += 2) {
+        if (splits[i].contains(numBlocks[i]++)) {
+          const bool inMemory = (ranges[j] & kMemoryBlockFlag) != 0;
+          partitionBlocks.push_back(
+              {dataFile,
+               ranges[j] & ~kMemoryBlockFlag,
+               ranges[j + 1],
+               inMemory});
+        }
+      }
+    }
+  }
+  if (!manifests.empty()) {
+    return partitionBlocks;
+  }
+
+  // Finds the block files of the partitions written without manifests, one
+  // file per block.
+  auto sortedFiles = files;
+  std::sort(sortedFiles.begin(), sortedFiles.end());
+  for (size_t i = 0; i < splits.size(); ++i) {
+    auto prefix = fmt::format(
+        "{}/{}_{}_", trimmedRootPath, queryId_, splits[i].partitionId);
+    for (const auto& file : sortedFiles) {
+      if (file.find(prefix) == 0 && splits[i].contains(numBlocks[i]++) &&
+          (runFile_.empty() || file == runFile_)) {
+        partitionBlocks.push_back({file, 0, std::nullopt});
       }
     }
   }
 
-  return partitionFiles;
+  return partitionBlocks;
 }
 
 void LocalPersistentShuffleWriter::cleanup() {
-  auto files = fileSystem_->list(rootPath_);
-  for (auto& file : files) {
-    fileSystem_->remove(file);
+  if (memoryStore_ != nullptr) {
+    memoryStore_->remove(dataFileName_);
+  }
+  for (const auto& file : {dataFileName_, tmpManifestFileName_}) {
+    if (fileSystem_->exists(file)) {
+      fileSystem_->remove(file);
+    }
   }
 }
 
-using json = nlohmann::json;
-
 // static
 LocalShuffleWriteInfo LocalShuffleWriteInfo::deserialize(
     const std::string& info) {
@@ -222,6 +1147,12 @@ LocalShuffleWriteInfo LocalShuffleWriteInfo::deserialize(
   jsonReadInfo.at("queryId").get_to(shuffleInfo.queryId);
   jsonReadInfo.at("shuffleId").get_to(shuffleInfo.shuffleId);
   jsonReadInfo.at("numPartitions").get_to(shuffleInfo.numPartitions);
+  if (jsonReadInfo.contains("mapId")) {
+    jsonReadInfo.at("mapId").get_to(shuffleInfo.mapId);
+    if (jsonReadInfo.contains("attemptId")) {
+      jsonReadInfo.at("attemptId").get_to(shuffleInfo.attemptId);
+    }
+  }
   return shuffleInfo;
 }
 
@@ -240,16 +1171,53 @@ std::shared_ptr<ShuffleReader> LocalPersistentShuffleFactory::createReader(
     const std::string& serializedStr,
     const int32_t partition,
     velox::memory::MemoryPool* pool) {
-  static const uint64_t maxBytesPerPartition =
-      SystemConfig::instance()->localShuffleMaxPartitionBytes();
-  const operators::LocalShuffleReadInfo readInfo =
-      operators::LocalShuffleReadInfo::deserialize(serializedStr);
+  return makeReader(serializedStr, partition, pool, "");
+}
+
+std::vector<std::shared_ptr<ShuffleReader>>
+LocalPersistentShuffleFactory::createRunReaders(
+    const std::string& serializedStr,
+    const int32_t partition,
+    velox::memory::MemoryPool* pool) {
+  // The listing is shared with the run readers, so the files are listed once.
+  auto reader = makeReader(serializedStr, partition, pool, "");
+  std::vector<std::shared_ptr<ShuffleReader>> readers;
+  for (const auto& file : reader->runFiles()) {
+    readers.push_back(makeReader(serializedStr, partition, pool, file));
+  }
+  return readers;
+}
+
+std::shared_ptr<LocalPersistentShuffleReader>
+LocalPersistentShuffleFactory::makeReader(
+    const std::string& serializedStr,
+    const int32_t partition,
+    velox::memory::MemoryPool* pool,
+    const std::string& runFile) {
+  static const uint32_t maxPrefetchBlocks =
+      SystemConfig::instance()->localShuffleMaxPrefetchBlocks();
+  static const uint64_t maxPrefetchBytes =
+      SystemConfig::instance()->localShuffleMaxPrefetchBytes();
+  static const bool useMmap = SystemConfig::instance()->localShuffleReadMmap();
+  const auto entry = getOrMakeShuffleInfo<std::shared_ptr<const ReadInfoEntry>>(
+      readInfoCache(), serializedStr, [&]() {
+        return std::make_shared<const ReadInfoEntry>(
+            LocalShuffleReadInfo::deserialize(serializedStr));
+      });
+  const auto& readInfo = entry->info;
   return std::make_shared<operators::LocalPersistentShuffleReader>(
       readInfo.rootPath,
       readInfo.queryId,
       readInfo.partitionIds,
       partition,
-      pool);
+      pool,
+      readExecutor_,
+      maxPrefetchBlocks,
+      maxPrefetchBytes,
+      useMmap,
+      memoryStore_,
+      entry->listing(),
+      runFile);
 }
 
 std::shared_ptr<ShuffleWriter> LocalPersistentShuffleFactory::createWriter(
@@ -257,15 +1225,27 @@ std::shared_ptr<ShuffleWriter> LocalPersistentShuffleFactory::createWriter(
     velox::memory::MemoryPool* pool) {
   static const uint64_t maxBytesPerPartition =
       SystemConfig::instance()->localShuffleMaxPartitionBytes();
-  const operators::LocalShuffleWriteInfo writeInfo =
-      operators::LocalShuffleWriteInfo::deserialize(serializedStr);
+  const auto writeInfoPtr =
+      getOrMakeShuffleInfo<std::shared_ptr<const LocalShuffleWriteInfo>>(
+          writeInfoCache(), serializedStr, [&]() {
+            return std::make_shared<const LocalShuffleWriteInfo>(
+                LocalShuffleWriteInfo::deserialize(serializedStr));
+          });
+  const auto& writeInfo = *writeInfoPtr;
+  static const uint64_t maxInFlightBytes =
+      SystemConfig::instance()->localShuffleMaxInFlightWriteBytes();
   return std::make_shared<operators::LocalPersistentShuffleWriter>(
       writeInfo.rootPath,
       writeInfo.queryId,
       writeInfo.shuffleId,
       writeInfo.numPartitions,
       maxBytesPerPartition,
-      pool);
+      pool,
+      writeExecutor_,
+      maxInFlightBytes,
+      writeInfo.mapId,
+      writeInfo.attemptId,
+      memoryStore_);
 }
 
 } // namespace facebook::presto::operators
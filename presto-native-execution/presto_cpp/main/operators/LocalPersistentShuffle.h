@@ -13,6 +13,16 @@
  */
 #pragma once
 
+#include <folly/Executor.h>
+#include <folly/futures/Future.h>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
 #include "presto_cpp/main/operators/ShuffleInterface.h"
 #include "velox/buffer/Buffer.h"
 #include "velox/common/file/File.h"
@@ -27,11 +37,17 @@ namespace facebook::presto::operators {
 // Please refrain changes to this API class. If any changes have to be made to
 // this struct, one should make sure to make corresponding changes in the above
 // Java classes and its corresponding serde functionalities.
+//
+// The optional 'mapId' and 'attemptId' identify the attempt of a map task if
+// the task may run more than once, e.g. when it is retried or speculated. The
+// readers read the output of a single committed attempt of each map task.
 struct LocalShuffleWriteInfo {
   std::string rootPath;
   std::string queryId;
   uint32_t numPartitions;
   uint32_t shuffleId;
+  std::string mapId;
+  uint32_t attemptId{0};
 
   /// Deserializes shuffle information that is used by LocalPersistentShuffle.
   /// Structures are assumed to be encoded in JSON format.
@@ -55,21 +71,101 @@ struct LocalShuffleReadInfo {
   static LocalShuffleReadInfo deserialize(const std::string& info);
 };
 
+/// The manifests and files of a shuffle listed by the first of the readers
+/// sharing it.
+struct LocalShuffleListing;
+
+/// Keeps the blocks of the local persistent shuffle writers in memory for the
+/// readers of the same process, up to 'capacity' bytes in total. The blocks
+/// which fit are copied to a root pool of the store so that they outlive the
+/// tasks writing them and are accounted by the memory manager. The blocks
+/// which don't fit are written to the data files.
+///
+/// The blocks of a query stay until its query context on this worker is
+/// destroyed, see releaseQuery(). The readers must then run while a task of
+/// the query is alive on the worker, like the map tasks in the same stage.
+class LocalShuffleMemoryStore {
+ public:
+  explicit LocalShuffleMemoryStore(uint64_t capacity);
+
+  ~LocalShuffleMemoryStore();
+
+  /// Drops the blocks of 'queryId' from all the stores of the process. Called
+  /// when the query context is destroyed.
+  static void releaseQuery(const std::string& queryId);
+
+  /// The pool of the blocks.
+  velox::memory::MemoryPool* pool() const {
+    return pool_.get();
+  }
+
+  /// Adds a copy of 'block' of 'queryId' as the block at 'offset' of
+  /// 'dataFile'. Returns false without allocating if the store has no room
+  /// for it.
+  bool add(
+      const std::string& queryId,
+      const std::string& dataFile,
+      uint64_t offset,
+      std::string_view block);
+
+  /// Returns the block at 'offset' of 'dataFile'. Throws if not found.
+  velox::BufferPtr get(const std::string& dataFile, uint64_t offset) const;
+
+  /// Drops the blocks of the data files starting with 'prefix'.
+  void remove(const std::string& prefix);
+
+  /// Drops the blocks of 'queryId'.
+  void removeQuery(const std::string& queryId);
+
+  /// The total size of the blocks in the store.
+  uint64_t bytes() const;
+
+ private:
+  void removeLocked(const std::string& prefix);
+
+  const uint64_t capacity_;
+  const std::shared_ptr<velox::memory::MemoryPool> rootPool_;
+  const std::shared_ptr<velox::memory::MemoryPool> pool_;
+  mutable std::mutex mutex_;
+  uint64_t bytes_{0};
+  // Keyed by data file and offset, ordered to remove the blocks by prefix.
+  std::map<std::pair<std::string, uint64_t>, velox::BufferPtr> blocks_;
+  // The data files of each query with blocks in the store.
+  std::unordered_map<std::string, std::unordered_set<std::string>>
+      queryFiles_;
+};
+
 /// This class is a persistent shuffle server that implements
 /// ShuffleInterface for read and write and also uses generalized Velox
 /// file system to maintain its state and data.
 ///
-/// Except for in-progress blocks of current output vectors in the writer,
-/// each produced vector is stored as a binary file of unsafe rows. Each block
-/// filename reflects the partition and sequence number of the block (vector)
-/// for that partition. For example <ROOT_PATH>/10_12.bin is the 12th (block)
-/// vector in partition #10.
+/// Each writer appends the blocks of unsafe rows of all its partitions to a
+/// single data file as they fill up, like Spark's consolidated shuffle. Once
+/// done, the writer stores a manifest which indexes the byte ranges of the
+/// data file holding each partition. For a writer with the unique id
+/// <WRITER_ID> of shuffle 0, these are the files <QUERY_ID>_data_0_<WRITER_ID>
+/// .bin and <QUERY_ID>_manifest_0_<WRITER_ID>.json under <ROOT_PATH>. The
+/// readers find the ranges of their partitions from the manifests and read
+/// them with pread(). This enables the multi-threaded or multi-process use
+/// scenarios. Each of them can create an instance of this class (pointing to
+/// the same root path) to read and write shuffle data.
+///
+/// If 'writeExecutor' is set, the full blocks are appended to the data file
+/// in order on 'writeExecutor' while the partitions fill new blocks. The
+/// writer is blocked while more than 'maxInFlightBytes' are being written.
 ///
-/// The class also uses Velox filesystem to figure out the number of written
-/// shuffle files for each partition. This enables the multi-threaded or
-/// multi-process use scenarios as long as each producer or consumer is assigned
-/// to a distinct group of partition IDs. Each of them can create an instance of
-/// this class (pointing to the same root path) to read and write shuffle data.
+/// The manifest commits the output of the writer. It is written to a temporary
+/// file which is renamed once complete, so the readers never see a partial
+/// output. If 'mapId' is set, the writer is the attempt 'attemptId' of the map
+/// task 'mapId', and the readers only read the lowest committed attempt of
+/// each map task, from all the writers of that attempt. The attempts of a map
+/// task can then run concurrently or be retried, but the readers must be
+/// scheduled once the map tasks are done to all see the same attempts. A
+/// failed writer only deletes its own files.
+///
+/// If 'memoryStore' is set, the blocks are kept in it for the readers of the
+/// same process while it has room, and only the others go to the data file.
+/// The manifest marks the blocks in memory.
 class LocalPersistentShuffleWriter : public ShuffleWriter {
  public:
   LocalPersistentShuffleWriter(
@@ -78,31 +174,89 @@ class LocalPersistentShuffleWriter : public ShuffleWriter {
       uint32_t shuffleId,
       uint32_t numPartitions,
       uint64_t maxBytesPerPartition,
-      velox::memory::MemoryPool* FOLLY_NONNULL pool);
+      velox::memory::MemoryPool* FOLLY_NONNULL pool,
+      folly::Executor* writeExecutor = nullptr,
+      uint64_t maxInFlightBytes = 0,
+      const std::string& mapId = "",
+      uint32_t attemptId = 0,
+      std::shared_ptr<LocalShuffleMemoryStore> memoryStore = nullptr);
+
+  /// Waits for the in-flight writes which still use the memory of 'pool'.
+  ~LocalPersistentShuffleWriter() override;
 
   void collect(int32_t partition, std::string_view data) override;
 
+  /// Counting sorts the rows by partition and copies the rows of each
+  /// partition which fit in its in-progress block without further checks.
+  void collect(
+      folly::Range<const int32_t*> partitions,
+      folly::Range<const velox::StringView*> rows) override;
+
+  /// Returns the space at the end of the in-progress block of 'partition'.
+  /// Stores the block and starts a new one first if it is too small.
+  char* reserve(int32_t partition, size_t size, uint32_t numRows) override;
+
   void noMoreData(bool success) override;
 
+  bool isBlocked(velox::ContinueFuture* future) override;
+
+  bool hasPendingWrites() const override;
+
+  /// Returns the bytes and blocks written, the files created, the time spent
+  /// writing, the number of times the writer was blocked and the bytes and
+  /// blocks kept in memory.
+  std::unordered_map<std::string, velox::RuntimeCounter> stats()
+      const override;
+
  private:
-  // Finds and creates the next file for writing the next block of the
-  // given 'partition'.
-  std::unique_ptr<velox::WriteFile> getNextOutputFile(int32_t partition);
+  // The state of the writes shared with the asynchronous write tasks.
+  struct InFlightWrites {
+    std::mutex mutex;
+    std::condition_variable allWritten;
+    // Total size of the blocks being written.
+    uint64_t bytes{0};
+    // The writer is blocked while more bytes are being written.
+    uint64_t maxBytes;
+    // The first write error.
+    std::exception_ptr error;
+    // Fulfilled once 'bytes' is within 'maxBytes'.
+    std::vector<velox::ContinuePromise> promises;
+    // The data file. Opened by the first write. Only accessed by the write
+    // tasks which run one at a time.
+    std::unique_ptr<velox::WriteFile> dataFile;
+    // The stats of the writes.
+    std::atomic<uint64_t> writtenBytes{0};
+    std::atomic<uint64_t> numWrittenBlocks{0};
+    std::atomic<uint64_t> numCreatedFiles{0};
+    std::atomic<uint64_t> writeMicros{0};
+  };
+
+  // Runs 'write' on 'writeExecutor_' if set, or in place otherwise. 'size'
+  // is the number of bytes 'write' writes for the in-flight accounting.
+  void scheduleWrite(uint64_t size, std::function<void()> write);
+
+  // Appends 'buffer' to the data file 'dataFileName_'.
+  static void appendBlock(
+      InFlightWrites& inFlight,
+      velox::filesystems::FileSystem& fileSystem,
+      const std::string& dataFileName,
+      const velox::BufferPtr& buffer);
+
+  // Closes the data file and writes the manifest after all the blocks.
+  void storeManifest();
 
-  // Returns the number of stored files for a given partition.
-  int getWritePartitionFilesCount(int32_t partition) const;
+  // Rethrows the error of a failed asynchronous write.
+  void checkWriteError();
 
-  // Writes the in-progress block to the given partition.
+  // Waits for all the scheduled writes to finish.
+  void waitForWrites();
+
+  // Appends the in-progress block of the given partition to the data file.
   void storePartitionBlock(int32_t partition);
 
-  // Deletes all the files in the root directory.
+  // Deletes the files of this writer.
   void cleanup();
 
-  // find next available partition file name to store shuffle data
-  std::string nextAvailablePartitionFileName(
-      const std::string& root,
-      int32_t partition) const;
-
   const uint64_t maxBytesPerPartition_;
 
   velox::memory::MemoryPool* FOLLY_NONNULL pool_;
@@ -110,15 +264,68 @@ class LocalPersistentShuffleWriter : public ShuffleWriter {
   /// The latest written block buffers and sizes.
   std::vector<velox::BufferPtr> inProgressPartitions_;
   std::vector<size_t> inProgressSizes_;
+  // The byte ranges of the blocks of each partition in the data file as
+  // flattened offset and size pairs.
+  std::vector<std::vector<uint64_t>> partitionRanges_;
+  // The number of rows of each partition. Recorded in the manifest with the
+  // byte ranges for the skew detection.
+  std::vector<uint64_t> partitionRows_;
+  // The size of the data file once all the scheduled blocks are written.
+  uint64_t dataFileSize_{0};
+  const std::shared_ptr<LocalShuffleMemoryStore> memoryStore_;
+  // The total size of the blocks in 'memoryStore_'. The blocks are keyed by
+  // their offsets in this sequence.
+  uint64_t memoryBytes_{0};
+  uint64_t numMemoryBlocks_{0};
+  // Runs the write tasks one at a time in order. Null if the writes are
+  // synchronous.
+  folly::Executor::KeepAlive<> writeExecutor_;
+  const std::shared_ptr<InFlightWrites> inFlight_;
+  std::atomic<uint64_t> numBlockedWrites_{0};
+  // Reused by the batch collect(). The end offsets of the partitions in
+  // 'sortedRows_' and their total row sizes.
+  std::vector<uint32_t> partitionOffsets_;
+  std::vector<size_t> partitionBytes_;
+  // The rows of the batch ordered by partition.
+  std::vector<uint32_t> sortedRows_;
   // The top directory of the shuffle files and its file system.
   std::string rootPath_;
   std::string queryId_;
   uint32_t shuffleId_;
   std::shared_ptr<velox::filesystems::FileSystem> fileSystem_;
-  // Used to make sure files created by this thread have unique names.
-  std::thread::id threadId_;
+  const std::string mapId_;
+  const uint32_t attemptId_;
+  // Used to make sure files created by this writer have unique names.
+  const std::string writerId_;
+  const std::string dataFileName_;
+  // The manifest is written to 'tmpManifestFileName_' and renamed to
+  // 'manifestFileName_' once complete.
+  const std::string manifestFileName_;
+  const std::string tmpManifestFileName_;
 };
 
+/// If 'readExecutor' is set, the reader keeps up to 'maxPrefetchBlocks' of
+/// the next blocks, but no more than 'maxPrefetchBytes' beyond the first one,
+/// being read on 'readExecutor' so that next() rarely waits for the disk.
+///
+/// If 'useMmap' is true and the shuffle files are on a local disk, the blocks
+/// are returned as views of memory mapped file ranges instead of being copied
+/// into buffers of 'pool'. The prefetch then asks the kernel to read the
+/// ranges ahead.
+///
+/// The blocks marked in memory by the writers are taken from 'memoryStore'.
+///
+/// The readers of a shuffle sharing 'listing' list the shuffle files and read
+/// the manifests once with the first of them to look for its blocks.
+///
+/// If 'runFile' is set, only the blocks of that data file are read, i.e. the
+/// run of a single writer, see runFiles().
+///
+/// A partition id may name a split of a partition, e.g. 'shuffle_0_0_3@1/4'
+/// for the split 1 of 4. A split has every 4th block of the partition starting
+/// at the block 1, so that the driver can fan a skewed partition out to
+/// several readers. The driver finds the skewed partitions by the bytes and
+/// rows of each partition in the manifests of the writers.
 class LocalPersistentShuffleReader : public ShuffleReader {
  public:
   LocalPersistentShuffleReader(
@@ -126,27 +333,116 @@ class LocalPersistentShuffleReader : public ShuffleReader {
       const std::string& queryId,
       std::vector<std::string> partitionIds_,
       const int32_t partition,
-      velox::memory::MemoryPool* FOLLY_NONNULL pool);
+      velox::memory::MemoryPool* FOLLY_NONNULL pool,
+      folly::Executor* readExecutor = nullptr,
+      uint32_t maxPrefetchBlocks = 0,
+      uint64_t maxPrefetchBytes = 0,
+      bool useMmap = false,
+      std::shared_ptr<LocalShuffleMemoryStore> memoryStore = nullptr,
+      std::shared_ptr<LocalShuffleListing> listing = nullptr,
+      std::string runFile = "");
+
+  /// Returns the data files with blocks to read, in the order they are read.
+  /// The blocks of each file are in the order written.
+  std::vector<std::string> runFiles();
+
+  /// Waits for the prefetches which still use the memory of 'pool'.
+  ~LocalPersistentShuffleReader() override;
 
   bool hasNext() override;
 
   velox::BufferPtr next(bool success) override;
 
+  /// Returns the bytes and blocks read, the files opened and the time spent
+  /// reading.
+  std::unordered_map<std::string, velox::RuntimeCounter> stats()
+      const override;
+
+  /// Returns the prefetched future of the next block if 'readExecutor' is
+  /// set. Reads the block inline otherwise.
+  folly::SemiFuture<velox::BufferPtr> nextAsync(uint64_t maxBytes) override;
+
  private:
-  // Returns all created shuffle files for 'partition_'.
-  std::vector<std::string> getReadPartitionFiles() const;
+  // The stats of the reads, shared with the prefetches.
+  struct ReadStats {
+    std::atomic<uint64_t> readBytes{0};
+    std::atomic<uint64_t> numReadBlocks{0};
+    std::atomic<uint64_t> numOpenedFiles{0};
+    std::atomic<uint64_t> readMicros{0};
+  };
+
+  // A byte range of a shuffle file to read as a block.
+  struct ReadBlock {
+    std::string file;
+    uint64_t offset;
+    // The whole file if not set.
+    std::optional<uint64_t> size;
+    // True if the block is in 'memoryStore_' at 'offset' of 'file'.
+    bool inMemory{false};
+  };
+
+  // Returns all the blocks of 'partitionIds_'. A split partition id has only
+  // the blocks of its split.
+  std::vector<ReadBlock> getReadPartitionBlocks() const;
+
+  // Returns the open file of 'block'. Reuses the file of the last block.
+  std::shared_ptr<velox::ReadFile> openFile(const ReadBlock& block);
+
+  // Returns the block in 'memoryStore_'. Adds the read to 'readStats_'.
+  velox::BufferPtr readMemoryBlock(const ReadBlock& block);
+
+  // Reads 'size' bytes at 'offset' of 'file' into a buffer of 'pool', or maps
+  // them if 'useMmap'. Adds the read to 'stats'.
+  static velox::BufferPtr readBlock(
+      const std::shared_ptr<velox::ReadFile>& file,
+      const std::string& fileName,
+      uint64_t offset,
+      uint64_t size,
+      bool useMmap,
+      velox::memory::MemoryPool* pool,
+      ReadStats& stats);
+
+  // Starts the reads of the next blocks up to the prefetch limits.
+  void prefetch();
+
+  // Returns the read of the next block and starts the read of the one after.
+  folly::Future<velox::BufferPtr> nextPrefetch();
+
+  // Waits for and drops the prefetched blocks.
+  void clearPrefetches();
 
   std::string rootPath_;
   std::string queryId_;
   std::vector<std::string> partitionIds_;
   int32_t partition_;
   velox::memory::MemoryPool* FOLLY_NONNULL pool_;
+  const std::string runFile_;
 
-  // Latest read block (file) index in 'readPartitionFiles_' for 'partition_'.
-  size_t readPartitionFileIndex_{0};
+  // Latest read block index in 'readPartitionBlocks_' for 'partition_'.
+  size_t readPartitionBlockIndex_{0};
 
-  // List of generated files for 'partition_'.
-  std::vector<std::string> readPartitionFiles_;
+  // List of the blocks to read for 'partition_'.
+  std::vector<ReadBlock> readPartitionBlocks_;
+
+  folly::Executor* const readExecutor_;
+  const uint32_t maxPrefetchBlocks_;
+  const uint64_t maxPrefetchBytes_;
+  const bool useMmap_;
+  const std::shared_ptr<LocalShuffleMemoryStore> memoryStore_;
+  const std::shared_ptr<LocalShuffleListing> listing_;
+  const std::shared_ptr<ReadStats> readStats_;
+
+  // The reads of the blocks from 'readPartitionBlockIndex_' on, in order.
+  std::deque<folly::Future<velox::BufferPtr>> prefetches_;
+  // The sizes of the blocks in 'prefetches_'.
+  std::deque<uint64_t> prefetchSizes_;
+  // The total size of 'prefetchSizes_'.
+  uint64_t prefetchBytes_{0};
+
+  // The file of the last opened block. Kept open for the next blocks in the
+  // same file.
+  std::string readFileName_;
+  std::shared_ptr<velox::ReadFile> readFile_;
 
   // The top directory of the shuffle files and its file system.
   std::shared_ptr<velox::filesystems::FileSystem> fileSystem_;
@@ -155,6 +451,26 @@ class LocalPersistentShuffleReader : public ShuffleReader {
 class LocalPersistentShuffleFactory : public ShuffleInterfaceFactory {
  public:
   static constexpr folly::StringPiece kShuffleName{"local"};
+
+  /// The shuffle which keeps the blocks in 'memoryStore' while it has room.
+  static constexpr folly::StringPiece kMemoryShuffleName{"local-memory"};
+
+  /// The writers write their files on 'writeExecutor' if set, or on the
+  /// driver threads otherwise. The readers prefetch their blocks on
+  /// 'readExecutor' if set. The writers and readers share 'memoryStore' if
+  /// set.
+  ///
+  /// The shuffle infos are parsed once for all the readers or writers created
+  /// with the same info, e.g. by the drivers of a task. The live readers
+  /// created with the same info also share the listing of the shuffle files.
+  explicit LocalPersistentShuffleFactory(
+      folly::Executor* writeExecutor = nullptr,
+      folly::Executor* readExecutor = nullptr,
+      std::shared_ptr<LocalShuffleMemoryStore> memoryStore = nullptr)
+      : writeExecutor_(writeExecutor),
+        readExecutor_(readExecutor),
+        memoryStore_(std::move(memoryStore)) {}
+
   std::shared_ptr<ShuffleReader> createReader(
       const std::string& serializedStr,
       const int32_t partition,
@@ -163,6 +479,23 @@ class LocalPersistentShuffleFactory : public ShuffleInterfaceFactory {
   std::shared_ptr<ShuffleWriter> createWriter(
       const std::string& serializedStr,
       velox::memory::MemoryPool* FOLLY_NONNULL pool) override;
+
+  /// Returns a reader per data file with blocks of 'partition'.
+  std::vector<std::shared_ptr<ShuffleReader>> createRunReaders(
+      const std::string& serializedStr,
+      const int32_t partition,
+      velox::memory::MemoryPool* FOLLY_NONNULL pool) override;
+
+ private:
+  std::shared_ptr<LocalPersistentShuffleReader> makeReader(
+      const std::string& serializedStr,
+      const int32_t partition,
+      velox::memory::MemoryPool* FOLLY_NONNULL pool,
+      const std::string& runFile);
+
+  folly::Executor* const writeExecutor_;
+  folly::Executor* const readExecutor_;
+  const std::shared_ptr<LocalShuffleMemoryStore> memoryStore_;
 };
 
 } // namespace facebook::presto::operators
@@ -12,7 +12,10 @@
  * limitations under the License.
  */
 #include "presto_cpp/main/operators/PartitionAndSerialize.h"
+#include <numeric>
 #include "velox/row/UnsafeRowSerializers.h"
+#include "velox/serializers/PrestoSerializer.h"
+#include "velox/vector/DecodedVector.h"
 
 using namespace facebook::velox::exec;
 using namespace facebook::velox;
@@ -23,9 +26,32 @@ velox::core::PlanNodeId deserializePlanNodeId(const folly::dynamic& obj) {
   return obj["id"].asString();
 }
 
+// Returns true if all the columns of 'rowType' are stored in the fixed width
+// slots of an UnsafeRow as is. All the UnsafeRows of such a type have the same
+// size.
+bool isFixedWidth(const RowType& rowType) {
+  for (const auto& child : rowType.children()) {
+    switch (child->kind()) {
+      case TypeKind::BOOLEAN:
+      case TypeKind::TINYINT:
+      case TypeKind::SMALLINT:
+      case TypeKind::INTEGER:
+      case TypeKind::BIGINT:
+      case TypeKind::REAL:
+      case TypeKind::DOUBLE:
+        break;
+      default:
+        return false;
+    }
+  }
+  return true;
+}
+
 /// The output of this operator has 2 columns:
 /// (1) partition number (INTEGER);
-/// (2) serialized row (VARBINARY)
+/// (2) serialized row (VARBINARY), or serialized page of the rows of the
+/// partition in the Presto format.
+/// There is no output if the rows are written to a shuffle.
 class PartitionAndSerializeOperator : public Operator {
  public:
   PartitionAndSerializeOperator(
@@ -39,10 +65,18 @@ class PartitionAndSerializeOperator : public Operator {
             planNode->id(),
             "PartitionAndSerialize"),
         numPartitions_(planNode->numPartitions()),
+        serdeFormat_(planNode->serdeFormat()),
+        fixedWidth_(isFixedWidth(*planNode->sources()[0]->outputType())),
         partitionFunction_(
             numPartitions_ == 1 ? nullptr
                                 : planNode->partitionFunctionFactory()->create(
-                                      planNode->numPartitions())) {}
+                                      planNode->numPartitions())) {
+    if (!planNode->shuffleName().empty()) {
+      shuffle_ =
+          ShuffleInterfaceFactory::factory(planNode->shuffleName())
+              ->createWriter(planNode->serializedShuffleWriteInfo(), pool());
+    }
+  }
 
   bool needsInput() const override {
     return !input_;
@@ -57,43 +91,262 @@ class PartitionAndSerializeOperator : public Operator {
       return nullptr;
     }
 
-    const auto numInput = input_->size();
-
-    // TODO Reuse output vector.
-    auto output = std::dynamic_pointer_cast<RowVector>(
-        BaseVector::create(outputType_, numInput, pool()));
+    computePartitions();
 
-    computePartitions(*output->childAt(0)->asFlatVector<int32_t>());
+    if (shuffle_ != nullptr) {
+      writeToShuffle();
+      input_.reset();
+      maybeFinishShuffle();
+      return nullptr;
+    }
 
-    serializeRows(*output->childAt(1)->asFlatVector<StringView>());
+    auto output = serdeFormat_ == ShuffleSerdeFormat::kPresto
+        ? serializePages()
+        : serializeRows();
 
     input_.reset();
 
     return output;
   }
 
+  void noMoreInput() override {
+    Operator::noMoreInput();
+    maybeFinishShuffle();
+  }
+
   BlockingReason isBlocked(ContinueFuture* future) override {
+    if (shuffle_ != nullptr && shuffle_->isBlocked(future)) {
+      return BlockingReason::kWaitForConsumer;
+    }
     return BlockingReason::kNotBlocked;
   }
 
   bool isFinished() override {
-    return noMoreInput_;
+    if (shuffle_ == nullptr) {
+      return noMoreInput_;
+    }
+    if (!shuffleFinished_) {
+      return false;
+    }
+    // Not finished until all the data is written.
+    return !shuffle_->hasPendingWrites();
+  }
+
+  void close() override {
+    if (shuffle_ != nullptr) {
+      for (const auto& [name, counter] : shuffle_->stats()) {
+        addRuntimeStat(name, counter);
+      }
+    }
+    Operator::close();
   }
 
  private:
-  void computePartitions(FlatVector<int32_t>& partitionsVector) {
-    auto numInput = input_->size();
-    partitions_.resize(numInput);
-    if (numPartitions_ == 1) {
-      std::fill(partitions_.begin(), partitions_.end(), 0);
+  // Tells the shuffle writer that there is no more data once all the input is
+  // written.
+  void maybeFinishShuffle() {
+    if (shuffle_ != nullptr && noMoreInput_ && input_ == nullptr &&
+        !shuffleFinished_) {
+      shuffleFinished_ = true;
+      shuffle_->noMoreData(true);
+    }
+  }
+
+  // Writes the rows of the input to the shuffle. The UnsafeRows are serialized
+  // straight into the space reserved in the shuffle if the writer supports
+  // it. Otherwise the serialized rows or pages are collected by the writer.
+  void writeToShuffle() {
+    if (serdeFormat_ == ShuffleSerdeFormat::kUnsafeRow && writeRowsInPlace()) {
+      return;
+    }
+    auto output = serdeFormat_ == ShuffleSerdeFormat::kPresto
+        ? serializePages()
+        : serializeRows();
+    const auto numOutput = output->size();
+    shuffle_->collect(
+        folly::Range(
+            output->childAt(0)->asFlatVector<int32_t>()->rawValues(),
+            numOutput),
+        folly::Range(
+            output->childAt(1)->asFlatVector<StringView>()->rawValues(),
+            numOutput));
+  }
+
+  // Reserves the space of the rows of each partition in the shuffle and
+  // serializes the rows into it. Returns false if the writer doesn't support
+  // reserving space.
+  bool writeRowsInPlace() {
+    const auto numInput = input_->size();
+    sortRowsByPartition();
+    const size_t fixedRowStride =
+        fixedWidth_ ? sizeof(size_t) + fixedWidthRowSize() : 0;
+    if (!fixedWidth_) {
+      computeRowSizes();
+    }
+
+    rowAddresses_.resize(numInput);
+    uint32_t begin = 0;
+    for (uint32_t partition = 0; partition < numPartitions_; ++partition) {
+      const auto end = partitionOffsets_[partition];
+      if (begin == end) {
+        continue;
+      }
+      size_t size = 0;
+      if (fixedWidth_) {
+        size = fixedRowStride * (end - begin);
+      } else {
+        for (auto i = begin; i < end; ++i) {
+          size += sizeof(size_t) + rowSizes_[sortedRows_[i]];
+        }
+      }
+      auto* buffer = shuffle_->reserve(partition, size, end - begin);
+      if (buffer == nullptr) {
+        VELOX_CHECK(begin == 0, "Shuffle writer stopped reserving space");
+        return false;
+      }
+      for (auto i = begin; i < end; ++i) {
+        const auto row = sortedRows_[i];
+        rowAddresses_[row] = buffer;
+        buffer += fixedWidth_ ? fixedRowStride
+                              : sizeof(size_t) + rowSizes_[row];
+      }
+      begin = end;
+    }
+
+    if (fixedWidth_) {
+      serializeFixedWidthRows();
     } else {
+      serializeVariableWidthRows();
+    }
+    return true;
+  }
+
+  // Orders the rows of the input by partition in 'sortedRows_', keeping the
+  // order of the rows of each partition. 'partitionOffsets_[i]' is set to the
+  // end offset of partition i in 'sortedRows_'.
+  void sortRowsByPartition() {
+    const auto numInput = input_->size();
+    sortedRows_.resize(numInput);
+    partitionOffsets_.assign(numPartitions_ + 1, 0);
+    if (numPartitions_ == 1) {
+      std::iota(sortedRows_.begin(), sortedRows_.end(), 0);
+      partitionOffsets_[0] = numInput;
+      return;
+    }
+    for (vector_size_t row = 0; row < numInput; ++row) {
+      ++partitionOffsets_[partitions_[row] + 1];
+    }
+    for (uint32_t partition = 1; partition <= numPartitions_; ++partition) {
+      partitionOffsets_[partition] += partitionOffsets_[partition - 1];
+    }
+    // Moves the start offset of each partition to its end offset.
+    for (vector_size_t row = 0; row < numInput; ++row) {
+      sortedRows_[partitionOffsets_[partitions_[row]]++] = row;
+    }
+  }
+
+  // Computes the partitions of the input rows into 'partitions_'. All the
+  // rows go to partition 0 if there is a single partition and 'partitions_'
+  // is not used.
+  void computePartitions() {
+    if (numPartitions_ > 1) {
+      partitions_.resize(input_->size());
       partitionFunction_->partition(*input_, partitions_);
     }
+  }
+
+  // Returns the output vector of the previous batch resized to 'size' if it is
+  // no longer referenced downstream, or a new vector otherwise. The reused
+  // vector keeps its buffers, including the string buffer of the data column.
+  RowVectorPtr prepareOutput(vector_size_t size) {
+    if (output_ != nullptr && output_.use_count() == 1) {
+      VectorPtr output = std::move(output_);
+      BaseVector::prepareForReuse(output, size);
+      output_ = std::static_pointer_cast<RowVector>(output);
+    } else {
+      output_ = std::static_pointer_cast<RowVector>(
+          BaseVector::create(outputType_, size, pool()));
+    }
+    return output_;
+  }
+
+  RowVectorPtr serializeRows() {
+    const auto numInput = input_->size();
 
-    // TODO Avoid copy.
+    auto output = prepareOutput(numInput);
+
+    auto& partitionsVector = *output->childAt(0)->asFlatVector<int32_t>();
     partitionsVector.resize(numInput);
     auto rawPartitions = partitionsVector.mutableRawValues();
-    ::memcpy(rawPartitions, partitions_.data(), sizeof(int32_t) * numInput);
+    if (numPartitions_ == 1) {
+      std::fill(rawPartitions, rawPartitions + numInput, 0);
+    } else {
+      // The partition function only computes into a std::vector.
+      ::memcpy(rawPartitions, partitions_.data(), sizeof(int32_t) * numInput);
+    }
+
+    serializeRows(*output->childAt(1)->asFlatVector<StringView>());
+    return output;
+  }
+
+  // Serializes the rows of each partition into a PrestoPage. Returns a row per
+  // non-empty partition.
+  RowVectorPtr serializePages() {
+    const auto numInput = input_->size();
+
+    // Collect the rows of each partition, keeping the runs of consecutive rows
+    // as single ranges.
+    partitionRanges_.resize(numPartitions_);
+    for (auto& ranges : partitionRanges_) {
+      ranges.clear();
+    }
+    if (numPartitions_ == 1) {
+      partitionRanges_[0].push_back({0, numInput});
+    } else {
+      for (vector_size_t row = 0; row < numInput; ++row) {
+        auto& ranges = partitionRanges_[partitions_[row]];
+        if (!ranges.empty() &&
+            ranges.back().begin + ranges.back().size == row) {
+          ++ranges.back().size;
+        } else {
+          ranges.push_back({row, 1});
+        }
+      }
+    }
+
+    const auto numOutput = std::count_if(
+        partitionRanges_.begin(),
+        partitionRanges_.end(),
+        [](const auto& ranges) { return !ranges.empty(); });
+    auto output = prepareOutput(numOutput);
+    auto partitionsVector = output->childAt(0)->asFlatVector<int32_t>();
+    auto dataVector = output->childAt(1)->asFlatVector<StringView>();
+
+    const auto rowType = asRowType(input_->type());
+    vector_size_t index = 0;
+    for (uint32_t partition = 0; partition < numPartitions_; ++partition) {
+      const auto& ranges = partitionRanges_[partition];
+      if (ranges.empty()) {
+        continue;
+      }
+      vector_size_t numRows = 0;
+      for (const auto& range : ranges) {
+        numRows += range.size;
+      }
+
+      StreamArena arena(pool());
+      auto serializer = serde_.createSerializer(rowType, numRows, &arena);
+      serializer->append(input_, folly::Range(ranges.data(), ranges.size()));
+      std::ostringstream out;
+      OStreamOutputStream stream(&out);
+      serializer->flush(&stream);
+
+      const auto page = out.str();
+      partitionsVector->set(index, partition);
+      dataVector->set(index, StringView(page));
+      ++index;
+    }
+    return output;
   }
 
   // The logic of this method is logically identical with
@@ -102,20 +355,13 @@ class PartitionAndSerializeOperator : public Operator {
   // that contents are directly written into passed in vector.
   void serializeRows(FlatVector<StringView>& dataVector) {
     const auto numInput = input_->size();
+    const size_t fixedRowStride =
+        fixedWidth_ ? sizeof(size_t) + fixedWidthRowSize() : 0;
+    const size_t totalSize =
+        fixedWidth_ ? fixedRowStride * numInput : computeRowSizes();
 
     dataVector.resize(numInput);
 
-    // Compute row sizes.
-    rowSizes_.resize(numInput);
-
-    size_t totalSize = 0;
-    for (auto i = 0; i < numInput; ++i) {
-      const size_t rowSize =
-          velox::row::UnsafeRowSerializer::getSizeRow(input_.get(), i);
-      rowSizes_[i] = rowSize;
-      totalSize += (sizeof(size_t) + rowSize);
-    }
-
     // Allocate memory.
     auto buffer = dataVector.getBufferWithSpace(totalSize);
     // getBufferWithSpace() may return a buffer that already has content, so we
@@ -123,29 +369,162 @@ class PartitionAndSerializeOperator : public Operator {
     auto rawBuffer = buffer->asMutable<char>() + buffer->size();
     buffer->setSize(buffer->size() + totalSize);
 
-    // Serialize rows.
+    rowAddresses_.resize(numInput);
     size_t offset = 0;
     for (auto i = 0; i < numInput; ++i) {
-      dataVector.setNoCopy(
-          i, StringView(rawBuffer + offset, rowSizes_[i] + sizeof(size_t)));
+      const auto size =
+          fixedWidth_ ? fixedRowStride : sizeof(size_t) + rowSizes_[i];
+      rowAddresses_[i] = rawBuffer + offset;
+      dataVector.setNoCopy(i, StringView(rawBuffer + offset, size));
+      offset += size;
+    }
 
+    if (fixedWidth_) {
+      serializeFixedWidthRows();
+    } else {
+      serializeVariableWidthRows();
+    }
+  }
+
+  // Computes the sizes of the UnsafeRows of the input into 'rowSizes_'.
+  // Returns their total size with the size prefixes.
+  size_t computeRowSizes() {
+    const auto numInput = input_->size();
+    rowSizes_.resize(numInput);
+    size_t totalSize = 0;
+    for (auto i = 0; i < numInput; ++i) {
+      const size_t rowSize =
+          velox::row::UnsafeRowSerializer::getSizeRow(input_.get(), i);
+      rowSizes_[i] = rowSize;
+      totalSize += (sizeof(size_t) + rowSize);
+    }
+    return totalSize;
+  }
+
+  // Serializes each row of the input prefixed with its size from 'rowSizes_'
+  // to its address in 'rowAddresses_'.
+  void serializeVariableWidthRows() {
+    const auto numInput = input_->size();
+    for (auto i = 0; i < numInput; ++i) {
+      auto row = rowAddresses_[i];
       // Write size
-      *(size_t*)(rawBuffer + offset) = rowSizes_[i];
-      offset += sizeof(size_t);
+      *(size_t*)row = rowSizes_[i];
 
       // Write row data.
       auto size = velox::row::UnsafeRowSerializer::serialize(
-                      input_, rawBuffer + offset, i)
+                      input_, row + sizeof(size_t), i)
                       .value_or(0);
       VELOX_DCHECK_EQ(size, rowSizes_[i]);
-      offset += size;
+    }
+  }
+
+  // Returns the size of the UnsafeRows of an input of fixed width columns.
+  size_t fixedWidthRowSize() const {
+    const auto numColumns = input_->childrenSize();
+    return bits::nwords(numColumns) * sizeof(uint64_t) +
+        numColumns * sizeof(uint64_t);
+  }
+
+  // Serializes the rows of an input of fixed width columns one column at a
+  // time to their addresses in 'rowAddresses_'. The rows have the same size
+  // and each column is written to the same offset of every row, so there is
+  // no per row size computation nor type dispatch.
+  void serializeFixedWidthRows() {
+    const auto numInput = input_->size();
+    const auto numColumns = input_->childrenSize();
+    const size_t nullBytes = bits::nwords(numColumns) * sizeof(uint64_t);
+    const size_t rowSize = fixedWidthRowSize();
+
+    // The null flags and the slots of the null values are zeros.
+    for (auto i = 0; i < numInput; ++i) {
+      auto row = rowAddresses_[i];
+      ::memset(row, 0, sizeof(size_t) + rowSize);
+      *reinterpret_cast<size_t*>(row) = rowSize;
+    }
+
+    rows_.resize(numInput);
+    rows_.setAll();
+    for (column_index_t column = 0; column < numColumns; ++column) {
+      const auto& child = input_->childAt(column);
+      decoded_.decode(*child, rows_);
+      const auto offset =
+          sizeof(size_t) + nullBytes + column * sizeof(uint64_t);
+      switch (child->typeKind()) {
+        case TypeKind::BOOLEAN:
+          serializeFixedWidthColumn<bool>(column, offset);
+          break;
+        case TypeKind::TINYINT:
+          serializeFixedWidthColumn<int8_t>(column, offset);
+          break;
+        case TypeKind::SMALLINT:
+          serializeFixedWidthColumn<int16_t>(column, offset);
+          break;
+        case TypeKind::INTEGER:
+          serializeFixedWidthColumn<int32_t>(column, offset);
+          break;
+        case TypeKind::BIGINT:
+          serializeFixedWidthColumn<int64_t>(column, offset);
+          break;
+        case TypeKind::REAL:
+          serializeFixedWidthColumn<float>(column, offset);
+          break;
+        case TypeKind::DOUBLE:
+          serializeFixedWidthColumn<double>(column, offset);
+          break;
+        default:
+          VELOX_UNREACHABLE();
+      }
+    }
+  }
+
+  // Writes the values of 'decoded_' to 'offset' of the rows at
+  // 'rowAddresses_', and sets the null flags of the nulls.
+  template <typename T>
+  void serializeFixedWidthColumn(column_index_t column, size_t offset) {
+    const auto numInput = input_->size();
+    if constexpr (!std::is_same_v<T, bool>) {
+      if (decoded_.isIdentityMapping() && !decoded_.mayHaveNulls()) {
+        const auto rawValues = decoded_.data<T>();
+        for (auto i = 0; i < numInput; ++i) {
+          ::memcpy(rowAddresses_[i] + offset, &rawValues[i], sizeof(T));
+        }
+        return;
+      }
+    }
+    for (auto i = 0; i < numInput; ++i) {
+      auto row = rowAddresses_[i];
+      if (decoded_.isNullAt(i)) {
+        bits::setBit(reinterpret_cast<uint8_t*>(row + sizeof(size_t)), column);
+      } else {
+        const T value = decoded_.valueAt<T>(i);
+        ::memcpy(row + offset, &value, sizeof(T));
+      }
     }
   }
 
   const uint32_t numPartitions_;
+  const ShuffleSerdeFormat serdeFormat_;
+  // True if all the input columns are fixed width in the UnsafeRow format.
+  const bool fixedWidth_;
   std::unique_ptr<core::PartitionFunction> partitionFunction_;
   std::vector<uint32_t> partitions_;
   std::vector<size_t> rowSizes_;
+  // The addresses to serialize the UnsafeRows of the input to.
+  std::vector<char*> rowAddresses_;
+  SelectivityVector rows_;
+  DecodedVector decoded_;
+  // The output of the previous batch. Reused if the consumer released it.
+  RowVectorPtr output_;
+  // The rows of each partition of the input in the Presto format.
+  std::vector<std::vector<IndexRange>> partitionRanges_;
+  serializer::presto::PrestoVectorSerde serde_;
+  // Set if the rows are written to the shuffle instead of being returned.
+  std::shared_ptr<ShuffleWriter> shuffle_;
+  bool shuffleFinished_{false};
+  // The rows of the input ordered by partition and the end offset of each
+  // partition in them when writing to the shuffle.
+  std::vector<uint32_t> sortedRows_;
+  std::vector<uint32_t> partitionOffsets_;
 };
 } // namespace
 
@@ -180,6 +559,12 @@ void PartitionAndSerializeNode::addDetails(std::stringstream& stream) const {
     }
   }
   stream << ") " << numPartitions_ << " " << partitionFunctionSpec_->toString();
+  if (serdeFormat_ != ShuffleSerdeFormat::kUnsafeRow) {
+    stream << " " << shuffleSerdeFormatName(serdeFormat_);
+  }
+  if (!shuffleName_.empty()) {
+    stream << " " << shuffleName_;
+  }
 }
 
 folly::dynamic PartitionAndSerializeNode::serialize() const {
@@ -189,6 +574,11 @@ folly::dynamic PartitionAndSerializeNode::serialize() const {
   obj["outputType"] = outputType_->serialize();
   obj["sources"] = ISerializable::serialize(sources_);
   obj["partitionFunctionSpec"] = partitionFunctionSpec_->serialize();
+  obj["serdeFormat"] = shuffleSerdeFormatName(serdeFormat_);
+  if (!shuffleName_.empty()) {
+    obj["shuffleName"] = shuffleName_;
+    obj["shuffleWriteInfo"] = serializedShuffleWriteInfo_;
+  }
   return obj;
 }
 
@@ -204,6 +594,12 @@ velox::core::PlanNodePtr PartitionAndSerializeNode::create(
       ISerializable::deserialize<std::vector<velox::core::PlanNode>>(
           obj["sources"], context)[0],
       ISerializable::deserialize<velox::core::PartitionFunctionSpec>(
-          obj["partitionFunctionSpec"], context));
+          obj["partitionFunctionSpec"], context),
+      obj.count("serdeFormat")
+          ? toShuffleSerdeFormat(obj["serdeFormat"].asString())
+          : ShuffleSerdeFormat::kUnsafeRow,
+      obj.count("shuffleName") ? obj["shuffleName"].asString() : "",
+      obj.count("shuffleWriteInfo") ? obj["shuffleWriteInfo"].asString()
+                                    : "");
 }
 } // namespace facebook::presto::operators
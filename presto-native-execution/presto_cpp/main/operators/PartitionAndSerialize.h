@@ -13,13 +13,22 @@
  */
 #pragma once
 
+#include "presto_cpp/main/operators/ShuffleInterface.h"
 #include "velox/core/PlanNode.h"
 #include "velox/exec/Operator.h"
 
 namespace facebook::presto::operators {
 
 /// Partitions the input row based on partition function and serializes the
-/// entire row.
+/// entire row. In the UnsafeRow format, each output row holds an input row. In
+/// the Presto format, each output row holds the rows of a partition of an input
+/// batch.
+///
+/// If 'shuffleName' is set, the node also does the work of a ShuffleWriteNode:
+/// the rows are written to a writer of the shuffle 'shuffleName' created with
+/// 'serializedShuffleWriteInfo' instead of being returned. The UnsafeRows are
+/// then serialized straight into the blocks of the writer. Each driver has its
+/// own writer.
 class PartitionAndSerializeNode : public velox::core::PlanNode {
  public:
   static constexpr std::string_view kPartitionColumnNameDefault = "partition";
@@ -31,13 +40,19 @@ class PartitionAndSerializeNode : public velox::core::PlanNode {
       uint32_t numPartitions,
       velox::RowTypePtr outputType,
       velox::core::PlanNodePtr source,
-      velox::core::PartitionFunctionSpecPtr partitionFunctionFactory)
+      velox::core::PartitionFunctionSpecPtr partitionFunctionFactory,
+      ShuffleSerdeFormat serdeFormat = ShuffleSerdeFormat::kUnsafeRow,
+      std::string shuffleName = "",
+      std::string serializedShuffleWriteInfo = "")
       : velox::core::PlanNode(id),
         keys_(std::move(keys)),
         numPartitions_(numPartitions),
         outputType_{std::move(outputType)},
         sources_({std::move(source)}),
-        partitionFunctionSpec_(std::move(partitionFunctionFactory)) {
+        partitionFunctionSpec_(std::move(partitionFunctionFactory)),
+        serdeFormat_(serdeFormat),
+        shuffleName_(std::move(shuffleName)),
+        serializedShuffleWriteInfo_(std::move(serializedShuffleWriteInfo)) {
     // Only verify output types are correct. Note column names are not enforced
     // in the following check.
     VELOX_USER_CHECK(
@@ -75,6 +90,19 @@ class PartitionAndSerializeNode : public velox::core::PlanNode {
     return partitionFunctionSpec_;
   }
 
+  ShuffleSerdeFormat serdeFormat() const {
+    return serdeFormat_;
+  }
+
+  /// The shuffle to write the rows to. Empty if the rows are returned.
+  const std::string& shuffleName() const {
+    return shuffleName_;
+  }
+
+  const std::string& serializedShuffleWriteInfo() const {
+    return serializedShuffleWriteInfo_;
+  }
+
   std::string_view name() const override {
     return "PartitionAndSerialize";
   }
@@ -87,6 +115,9 @@ class PartitionAndSerializeNode : public velox::core::PlanNode {
   const velox::RowTypePtr outputType_;
   const std::vector<velox::core::PlanNodePtr> sources_;
   const velox::core::PartitionFunctionSpecPtr partitionFunctionSpec_;
+  const ShuffleSerdeFormat serdeFormat_;
+  const std::string shuffleName_;
+  const std::string serializedShuffleWriteInfo_;
 };
 
 class PartitionAndSerializeTranslator
@@ -0,0 +1,233 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/operators/RangePartitionFunction.h"
+#include <numeric>
+#include "velox/core/Expressions.h"
+
+using namespace facebook::velox;
+
+namespace facebook::presto::operators {
+namespace {
+std::vector<CompareFlags> toCompareFlags(
+    const std::vector<core::SortOrder>& sortOrders) {
+  std::vector<CompareFlags> flags;
+  flags.reserve(sortOrders.size());
+  for (const auto& order : sortOrders) {
+    flags.push_back({order.isNullsFirst(), order.isAscending(), false});
+  }
+  return flags;
+}
+
+vector_size_t numRows(const std::vector<VectorPtr>& boundaries) {
+  return boundaries.empty() ? 0 : boundaries[0]->size();
+}
+} // namespace
+
+RangePartitionFunction::RangePartitionFunction(
+    int numPartitions,
+    std::vector<column_index_t> keyChannels,
+    std::vector<core::SortOrder> sortOrders,
+    std::vector<VectorPtr> boundaries)
+    : keyChannels_(std::move(keyChannels)),
+      compareFlags_(toCompareFlags(sortOrders)),
+      boundaries_(std::move(boundaries)),
+      numBoundaries_(numRows(boundaries_)) {
+  VELOX_CHECK_GT(numPartitions, 0);
+  VELOX_CHECK_EQ(keyChannels_.size(), compareFlags_.size());
+  VELOX_CHECK(
+      boundaries_.empty() || boundaries_.size() == keyChannels_.size(),
+      "Expected a boundary vector per key: {} vs. {}",
+      boundaries_.size(),
+      keyChannels_.size());
+  for (const auto& boundary : boundaries_) {
+    VELOX_CHECK_EQ(boundary->size(), numBoundaries_);
+  }
+  VELOX_USER_CHECK_LT(
+      numBoundaries_,
+      numPartitions,
+      "Too many range boundaries for {} partitions",
+      numPartitions);
+}
+
+int32_t RangePartitionFunction::compare(
+    const RowVector& input,
+    vector_size_t row,
+    vector_size_t boundary) const {
+  for (auto i = 0; i < keyChannels_.size(); ++i) {
+    const auto result =
+        input.childAt(keyChannels_[i])
+            ->compare(boundaries_[i].get(), row, boundary, compareFlags_[i]);
+    if (result.value() != 0) {
+      return result.value();
+    }
+  }
+  return 0;
+}
+
+std::optional<uint32_t> RangePartitionFunction::partition(
+    const RowVector& input,
+    std::vector<uint32_t>& partitions) {
+  if (numBoundaries_ == 0) {
+    return 0;
+  }
+  const auto size = input.size();
+  partitions.resize(size);
+  for (vector_size_t row = 0; row < size; ++row) {
+    // The number of boundaries less than the row.
+    vector_size_t low = 0;
+    vector_size_t high = numBoundaries_;
+    while (low < high) {
+      const auto middle = low + (high - low) / 2;
+      if (compare(input, row, middle) > 0) {
+        low = middle + 1;
+      } else {
+        high = middle;
+      }
+    }
+    partitions[row] = low;
+  }
+  return std::nullopt;
+}
+
+// static
+std::vector<VectorPtr> RangePartitionFunction::sampleBoundaries(
+    const RowVector& sample,
+    const std::vector<column_index_t>& keyChannels,
+    const std::vector<core::SortOrder>& sortOrders,
+    int numPartitions,
+    memory::MemoryPool* pool) {
+  VELOX_CHECK_GT(numPartitions, 0);
+  VELOX_CHECK_EQ(keyChannels.size(), sortOrders.size());
+  const auto flags = toCompareFlags(sortOrders);
+  const auto compareRows = [&](vector_size_t left, vector_size_t right) {
+    for (auto i = 0; i < keyChannels.size(); ++i) {
+      const auto& key = sample.childAt(keyChannels[i]);
+      const auto result = key->compare(key.get(), left, right, flags[i]);
+      if (result.value() != 0) {
+        return result.value();
+      }
+    }
+    return 0;
+  };
+
+  std::vector<vector_size_t> rows(sample.size());
+  std::iota(rows.begin(), rows.end(), 0);
+  std::sort(rows.begin(), rows.end(), [&](auto left, auto right) {
+    return compareRows(left, right) < 0;
+  });
+
+  // The last row of each of the first 'numPartitions' - 1 equal slices of
+  // the sorted sample, skipping the repeats of the previous boundary.
+  std::vector<vector_size_t> boundaryRows;
+  for (auto i = 1; i < numPartitions && !rows.empty(); ++i) {
+    const auto index = static_cast<int64_t>(i) * rows.size() / numPartitions;
+    if (index == 0) {
+      continue;
+    }
+    const auto row = rows[index - 1];
+    if (!boundaryRows.empty() && compareRows(boundaryRows.back(), row) == 0) {
+      continue;
+    }
+    boundaryRows.push_back(row);
+  }
+
+  std::vector<VectorPtr> boundaries;
+  boundaries.reserve(keyChannels.size());
+  for (const auto channel : keyChannels) {
+    const auto& key = sample.childAt(channel);
+    auto boundary = BaseVector::create(key->type(), boundaryRows.size(), pool);
+    for (auto i = 0; i < boundaryRows.size(); ++i) {
+      boundary->copy(key.get(), i, boundaryRows[i], 1);
+    }
+    boundaries.push_back(std::move(boundary));
+  }
+  return boundaries;
+}
+
+std::string RangePartitionFunctionSpec::toString() const {
+  std::vector<std::string> keys;
+  keys.reserve(keyChannels_.size());
+  for (auto i = 0; i < keyChannels_.size(); ++i) {
+    keys.push_back(
+        fmt::format("{} {}", keyChannels_[i], sortOrders_[i].toString()));
+  }
+  return fmt::format(
+      "RANGE({}) with {} boundaries",
+      folly::join(", ", keys),
+      numRows(boundaries_));
+}
+
+folly::dynamic RangePartitionFunctionSpec::serialize() const {
+  folly::dynamic obj = folly::dynamic::object;
+  obj["name"] = "RangePartitionFunctionSpec";
+  obj["keys"] = ISerializable::serialize(keyChannels_);
+  folly::dynamic orders = folly::dynamic::array;
+  for (const auto& order : sortOrders_) {
+    folly::dynamic orderObj = folly::dynamic::object;
+    orderObj["ascending"] = order.isAscending();
+    orderObj["nullsFirst"] = order.isNullsFirst();
+    orders.push_back(std::move(orderObj));
+  }
+  obj["sortOrders"] = std::move(orders);
+  // The boundaries row by row, a constant per key.
+  const auto numBoundaries = numRows(boundaries_);
+  std::vector<core::ConstantTypedExpr> values;
+  values.reserve(numBoundaries * boundaries_.size());
+  for (vector_size_t row = 0; row < numBoundaries; ++row) {
+    for (const auto& boundary : boundaries_) {
+      values.emplace_back(BaseVector::wrapInConstant(1, row, boundary));
+    }
+  }
+  obj["boundaries"] = ISerializable::serialize(values);
+  return obj;
+}
+
+// static
+core::PartitionFunctionSpecPtr RangePartitionFunctionSpec::deserialize(
+    const folly::dynamic& obj,
+    void* context) {
+  auto keys =
+      ISerializable::deserialize<std::vector<column_index_t>>(obj["keys"]);
+  std::vector<core::SortOrder> sortOrders;
+  for (const auto& order : obj["sortOrders"]) {
+    sortOrders.emplace_back(
+        order["ascending"].asBool(), order["nullsFirst"].asBool());
+  }
+  VELOX_CHECK_EQ(keys.size(), sortOrders.size());
+
+  const auto values =
+      ISerializable::deserialize<std::vector<core::ConstantTypedExpr>>(
+          obj["boundaries"]);
+  VELOX_CHECK(keys.empty() || values.size() % keys.size() == 0);
+  const vector_size_t numBoundaries =
+      keys.empty() ? 0 : values.size() / keys.size();
+  auto* pool = static_cast<memory::MemoryPool*>(context);
+  std::vector<VectorPtr> boundaries;
+  if (numBoundaries > 0) {
+    for (auto i = 0; i < keys.size(); ++i) {
+      boundaries.push_back(
+          BaseVector::create(values[i]->type(), numBoundaries, pool));
+    }
+    for (vector_size_t row = 0; row < numBoundaries; ++row) {
+      for (auto i = 0; i < keys.size(); ++i) {
+        const auto& value = values[row * keys.size() + i];
+        boundaries[i]->copy(value->toConstantVector(pool).get(), row, 0, 1);
+      }
+    }
+  }
+  return std::make_shared<RangePartitionFunctionSpec>(
+      std::move(keys), std::move(sortOrders), std::move(boundaries));
+}
+
+} // namespace facebook::presto::operators
@@ -0,0 +1,97 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include "velox/core/PlanNode.h"
+#include "velox/vector/ComplexVector.h"
+
+namespace facebook::presto::operators {
+
+/// Assigns the rows to the partitions by the ranges of their keys. The ranges
+/// are given by a sorted array of N - 1 boundary keys for N partitions,
+/// typically picked from a sample of the data so that the partitions get about
+/// the same number of rows. A row goes to the partition of the first boundary
+/// that is not less than its keys, or to the last partition if there is none.
+/// The keys of the partitions are then ordered, so sorting within each
+/// partition gives a global order without a single sort of all the rows.
+class RangePartitionFunction : public velox::core::PartitionFunction {
+ public:
+  /// 'boundaries' holds a vector per key channel, each with the same number
+  /// of rows, in the order given by 'sortOrders'.
+  RangePartitionFunction(
+      int numPartitions,
+      std::vector<velox::column_index_t> keyChannels,
+      std::vector<velox::core::SortOrder> sortOrders,
+      std::vector<velox::VectorPtr> boundaries);
+
+  std::optional<uint32_t> partition(
+      const velox::RowVector& input,
+      std::vector<uint32_t>& partitions) override;
+
+  /// Picks the boundaries of 'numPartitions' ranges of about the same size
+  /// from the rows of 'sample'. Returns a vector per key channel with at
+  /// most 'numPartitions' - 1 rows, without duplicate boundaries.
+  static std::vector<velox::VectorPtr> sampleBoundaries(
+      const velox::RowVector& sample,
+      const std::vector<velox::column_index_t>& keyChannels,
+      const std::vector<velox::core::SortOrder>& sortOrders,
+      int numPartitions,
+      velox::memory::MemoryPool* pool);
+
+ private:
+  // Returns the comparison of the keys of 'row' in 'input' with the boundary
+  // at 'boundary'.
+  int32_t compare(
+      const velox::RowVector& input,
+      velox::vector_size_t row,
+      velox::vector_size_t boundary) const;
+
+  const std::vector<velox::column_index_t> keyChannels_;
+  const std::vector<velox::CompareFlags> compareFlags_;
+  const std::vector<velox::VectorPtr> boundaries_;
+  const velox::vector_size_t numBoundaries_;
+};
+
+class RangePartitionFunctionSpec : public velox::core::PartitionFunctionSpec {
+ public:
+  RangePartitionFunctionSpec(
+      std::vector<velox::column_index_t> keyChannels,
+      std::vector<velox::core::SortOrder> sortOrders,
+      std::vector<velox::VectorPtr> boundaries)
+      : keyChannels_(std::move(keyChannels)),
+        sortOrders_(std::move(sortOrders)),
+        boundaries_(std::move(boundaries)) {}
+
+  std::unique_ptr<velox::core::PartitionFunction> create(
+      int numPartitions) const override {
+    return std::make_unique<RangePartitionFunction>(
+        numPartitions, keyChannels_, sortOrders_, boundaries_);
+  }
+
+  std::string toString() const override;
+
+  folly::dynamic serialize() const override;
+
+  /// 'context' is the memory pool of the boundaries.
+  static velox::core::PartitionFunctionSpecPtr deserialize(
+      const folly::dynamic& obj,
+      void* context);
+
+ private:
+  const std::vector<velox::column_index_t> keyChannels_;
+  const std::vector<velox::core::SortOrder> sortOrders_;
+  const std::vector<velox::VectorPtr> boundaries_;
+};
+
+} // namespace facebook::presto::operators
@@ -14,10 +14,41 @@
 #pragma once
 
 #include <fmt/format.h>
+#include <folly/Range.h>
+#include <folly/futures/Future.h>
 #include "velox/exec/Operator.h"
 
 namespace facebook::presto::operators {
 
+/// The serialization format of the shuffled data. The ShuffleReadNodes must use
+/// the format of the PartitionAndSerializeNodes which write the shuffle.
+enum class ShuffleSerdeFormat {
+  /// Each row is an UnsafeRow prefixed with its size.
+  kUnsafeRow,
+  /// The rows of each partition of an input batch form a PrestoPage.
+  kPresto,
+};
+
+inline std::string shuffleSerdeFormatName(ShuffleSerdeFormat format) {
+  switch (format) {
+    case ShuffleSerdeFormat::kUnsafeRow:
+      return "unsafe-row";
+    case ShuffleSerdeFormat::kPresto:
+      return "presto";
+  }
+  VELOX_UNREACHABLE();
+}
+
+inline ShuffleSerdeFormat toShuffleSerdeFormat(const std::string& name) {
+  if (name == "unsafe-row") {
+    return ShuffleSerdeFormat::kUnsafeRow;
+  }
+  if (name == "presto") {
+    return ShuffleSerdeFormat::kPresto;
+  }
+  VELOX_USER_FAIL("Unknown shuffle serde format: {}", name);
+}
+
 class ShuffleWriter {
  public:
   virtual ~ShuffleWriter() = default;
@@ -25,9 +56,52 @@ class ShuffleWriter {
   /// Write to the shuffle one row at a time.
   virtual void collect(int32_t partition, std::string_view data) = 0;
 
+  /// Write a batch of rows to the shuffle. 'partitions[i]' is the partition
+  /// of 'rows[i]'. The default implementation calls the above for each row.
+  /// Implementations can override it to scatter the whole batch into their
+  /// partition buffers at once.
+  virtual void collect(
+      folly::Range<const int32_t*> partitions,
+      folly::Range<const velox::StringView*> rows) {
+    VELOX_CHECK_EQ(partitions.size(), rows.size());
+    for (auto i = 0; i < partitions.size(); ++i) {
+      collect(partitions[i], std::string_view(rows[i].data(), rows[i].size()));
+    }
+  }
+
+  /// Returns 'size' bytes at the end of the data of 'partition' for the caller
+  /// to serialize 'numRows' rows into, which saves copying them with
+  /// collect(). The bytes stay valid until the next call for 'partition' or
+  /// noMoreData(). Returns null if the writer doesn't support it, in which
+  /// case the caller passes the rows to collect() instead.
+  virtual char* FOLLY_NULLABLE
+  reserve(int32_t /*partition*/, size_t /*size*/, uint32_t /*numRows*/) {
+    return nullptr;
+  }
+
   /// Tell the shuffle system the writer is done.
   /// @param success set to false to indicate aborted client.
   virtual void noMoreData(bool success) = 0;
+
+  /// Returns the stats of the writer, e.g. the bytes written, reported as the
+  /// runtime stats of the shuffle write operator.
+  virtual std::unordered_map<std::string, velox::RuntimeCounter> stats()
+      const {
+    return {};
+  }
+
+  /// Returns true and sets 'future' if the writer can't take more data until
+  /// 'future' completes, e.g. because too many of its writes are in flight.
+  /// After noMoreData(), returns true until all the data is written.
+  virtual bool isBlocked(velox::ContinueFuture* /*future*/) {
+    return false;
+  }
+
+  /// Returns true if isBlocked() would block, without creating a future or
+  /// counting a blocked write. Used by isFinished() checks.
+  virtual bool hasPendingWrites() const {
+    return false;
+  }
 };
 
 class ShuffleReader {
@@ -40,6 +114,24 @@ class ShuffleReader {
   /// Read the next block of data.
   /// @param success set to false to indicate aborted client.
   virtual velox::BufferPtr next(bool success) = 0;
+
+  /// Returns the stats of the reader, e.g. the bytes read.
+  virtual std::unordered_map<std::string, velox::RuntimeCounter> stats()
+      const {
+    return {};
+  }
+
+  /// Returns a future of the next block of data, or of null if there are no
+  /// more blocks. 'maxBytes' is a hint of the max size of the block to return.
+  /// There is at most one call in flight at a time. Adapts the synchronous
+  /// readers by calling hasNext() and next() inline. The readers which fetch
+  /// the blocks remotely or in the background override it to not block the
+  /// calling thread.
+  virtual folly::SemiFuture<velox::BufferPtr> nextAsync(uint64_t maxBytes) {
+    return folly::makeSemiFutureWith([this]() -> velox::BufferPtr {
+      return hasNext() ? next(true) : nullptr;
+    });
+  }
 };
 
 class ShuffleInterfaceFactory {
@@ -55,6 +147,17 @@ class ShuffleInterfaceFactory {
       const std::string& serializedShuffleInfo,
       velox::memory::MemoryPool* pool) = 0;
 
+  /// Returns a reader per run of 'partition', i.e. per sequence of blocks
+  /// written by one writer in order, for the reads merging the sorted runs.
+  /// The shuffles whose readers return the blocks of one writer only return
+  /// the reader of createReader().
+  virtual std::vector<std::shared_ptr<ShuffleReader>> createRunReaders(
+      const std::string& serializedShuffleInfo,
+      const int32_t partition,
+      velox::memory::MemoryPool* pool) {
+    return {createReader(serializedShuffleInfo, partition, pool)};
+  }
+
   /// Register ShuffleInterfaceFactory to its registry. It returns true if the
   /// registration is successful, false if a factory with the name already
   /// exists.
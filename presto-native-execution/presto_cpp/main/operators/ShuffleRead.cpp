@@ -12,7 +12,13 @@
  * limitations under the License.
  */
 #include "presto_cpp/main/operators/ShuffleRead.h"
+#include <folly/executors/QueuedImmediateExecutor.h>
+#include "presto_cpp/main/common/Configs.h"
+#include "presto_cpp/main/operators/UnsafeRowExchangeSource.h"
 #include "velox/exec/Exchange.h"
+#include "velox/exec/Merge.h"
+#include "velox/exec/MergeSource.h"
+#include "velox/serializers/PrestoSerializer.h"
 #include "velox/serializers/UnsafeRowSerializer.h"
 
 using namespace facebook::velox::exec;
@@ -24,6 +30,16 @@ velox::core::PlanNodeId deserializePlanNodeId(const folly::dynamic& obj) {
 }
 
 namespace {
+std::unique_ptr<VectorSerde> createSerde(ShuffleSerdeFormat format) {
+  switch (format) {
+    case ShuffleSerdeFormat::kUnsafeRow:
+      return std::make_unique<serializer::spark::UnsafeRowVectorSerde>();
+    case ShuffleSerdeFormat::kPresto:
+      return std::make_unique<serializer::presto::PrestoVectorSerde>();
+  }
+  VELOX_UNREACHABLE();
+}
+
 class ShuffleReadOperator : public Exchange {
  public:
   ShuffleReadOperator(
@@ -39,7 +55,7 @@ class ShuffleReadOperator : public Exchange {
                 shuffleReadNode->outputType()),
             exchangeClient,
             "ShuffleRead"),
-        serde_(std::make_unique<serializer::spark::UnsafeRowVectorSerde>()) {}
+        serde_(createSerde(shuffleReadNode->serdeFormat())) {}
 
  protected:
   VectorSerde* getSerde() override {
@@ -47,22 +63,259 @@ class ShuffleReadOperator : public Exchange {
   }
 
  private:
-  std::unique_ptr<serializer::spark::UnsafeRowVectorSerde> serde_;
+  std::unique_ptr<VectorSerde> serde_;
+};
+
+// Returns the rows of a sorted run of a shuffle partition to the merge. The
+// next block is read with ShuffleReader::nextAsync() while the merge blocks
+// on it.
+class ShuffleRunMergeSource : public MergeSource {
+ public:
+  ShuffleRunMergeSource(
+      std::shared_ptr<ShuffleReader> reader,
+      VectorSerde* serde,
+      RowTypePtr type,
+      memory::MemoryPool* pool,
+      uint64_t maxBlockBytes)
+      : reader_(std::move(reader)),
+        serde_(serde),
+        type_(std::move(type)),
+        pool_(pool),
+        maxBlockBytes_(maxBlockBytes),
+        read_(std::make_shared<Read>()) {}
+
+  BlockingReason next(RowVectorPtr& data, ContinueFuture* future) override {
+    for (;;) {
+      if (!vectors_.empty()) {
+        data = std::move(vectors_.front());
+        vectors_.pop_front();
+        return BlockingReason::kNotBlocked;
+      }
+      if (atEnd_) {
+        data = nullptr;
+        return BlockingReason::kNotBlocked;
+      }
+      std::optional<folly::Try<BufferPtr>> block;
+      {
+        std::lock_guard<std::mutex> l(read_->mutex);
+        if (read_->block.has_value()) {
+          block = std::move(read_->block);
+          read_->block.reset();
+          read_->pending = false;
+        } else if (read_->pending) {
+          auto [promise, blockFuture] = makeVeloxContinuePromiseContract(
+              "ShuffleRunMergeSource::next");
+          read_->promises.push_back(std::move(promise));
+          *future = std::move(blockFuture);
+          return BlockingReason::kWaitForProducer;
+        } else {
+          read_->pending = true;
+        }
+      }
+      if (!block.has_value()) {
+        startRead();
+        continue;
+      }
+      if (block->hasException()) {
+        VELOX_FAIL(
+            "Failed to read a shuffle block: {}",
+            block->exception().what().toStdString());
+      }
+      if (block->value() == nullptr) {
+        atEnd_ = true;
+        continue;
+      }
+      deserialize(block->value());
+    }
+  }
+
+  BlockingReason enqueue(RowVectorPtr /*input*/, ContinueFuture* /*future*/)
+      override {
+    VELOX_UNREACHABLE("The shuffle runs are read, not enqueued");
+  }
+
+  void close() override {
+    vectors_.clear();
+  }
+
+ private:
+  // The block being read, shared with the read callback.
+  struct Read {
+    std::mutex mutex;
+    bool pending{false};
+    std::optional<folly::Try<BufferPtr>> block;
+    // Fulfilled once 'block' is set.
+    std::vector<ContinuePromise> promises;
+  };
+
+  // Reads the next block into 'read_'. May complete inline.
+  void startRead() {
+    folly::makeSemiFutureWith(
+        [&]() { return reader_->nextAsync(maxBlockBytes_); })
+        .via(&folly::QueuedImmediateExecutor::instance())
+        .thenTry([read = read_, reader = reader_](
+                     folly::Try<BufferPtr> block) {
+          std::vector<ContinuePromise> promises;
+          {
+            std::lock_guard<std::mutex> l(read->mutex);
+            read->block = std::move(block);
+            promises.swap(read->promises);
+          }
+          for (auto& promise : promises) {
+            promise.setValue();
+          }
+        });
+  }
+
+  // Deserializes the rows of 'block' into 'vectors_'.
+  void deserialize(const BufferPtr& block) {
+    ByteStream input;
+    input.resetInput({ByteRange{
+        const_cast<uint8_t*>(block->as<uint8_t>()),
+        static_cast<int32_t>(block->size()),
+        0}});
+    while (!input.atEnd()) {
+      RowVectorPtr vector;
+      serde_->deserialize(&input, pool_, type_, &vector);
+      if (vector->size() > 0) {
+        vectors_.push_back(std::move(vector));
+      }
+    }
+  }
+
+  const std::shared_ptr<ShuffleReader> reader_;
+  VectorSerde* const serde_;
+  const RowTypePtr type_;
+  memory::MemoryPool* const pool_;
+  const uint64_t maxBlockBytes_;
+  const std::shared_ptr<Read> read_;
+  // The rows deserialized from the last block, in order.
+  std::deque<RowVectorPtr> vectors_;
+  bool atEnd_{false};
+};
+
+// Merges the sorted runs of the shuffle partition splits. Each split is read
+// as a merge source per run.
+class ShuffleMergeReadOperator : public Merge {
+ public:
+  ShuffleMergeReadOperator(
+      int32_t operatorId,
+      DriverCtx* FOLLY_NONNULL ctx,
+      const std::shared_ptr<const ShuffleReadNode>& shuffleReadNode)
+      : Merge(
+            operatorId,
+            ctx,
+            shuffleReadNode->outputType(),
+            shuffleReadNode->sortingKeys(),
+            shuffleReadNode->sortingOrders(),
+            shuffleReadNode->id(),
+            "ShuffleMergeRead"),
+        shuffleName_(shuffleReadNode->shuffleName()),
+        serde_(createSerde(shuffleReadNode->serdeFormat())),
+        maxBlockBytes_(SystemConfig::instance()->exchangeMaxResponseBytes()) {}
+
+ protected:
+  BlockingReason addMergeSources(ContinueFuture* future) override {
+    if (noMoreSplits_) {
+      return BlockingReason::kNotBlocked;
+    }
+    for (;;) {
+      exec::Split split;
+      const auto reason = operatorCtx_->task()->getSplitOrFuture(
+          operatorCtx_->driverCtx()->splitGroupId,
+          planNodeId(),
+          split,
+          *future);
+      if (reason != BlockingReason::kNotBlocked) {
+        return reason;
+      }
+      if (!split.hasConnectorSplit()) {
+        noMoreSplits_ = true;
+        return BlockingReason::kNotBlocked;
+      }
+      auto remoteSplit =
+          std::dynamic_pointer_cast<RemoteConnectorSplit>(split.connectorSplit);
+      VELOX_CHECK_NOT_NULL(remoteSplit, "Wrong type of split");
+      for (auto& reader : UnsafeRowExchangeSource::createRunReaders(
+               shuffleName_,
+               remoteSplit->taskId,
+               operatorCtx_->task()->destination(),
+               pool())) {
+        sources_.push_back(std::make_shared<ShuffleRunMergeSource>(
+            std::move(reader),
+            serde_.get(),
+            outputType_,
+            pool(),
+            maxBlockBytes_));
+      }
+    }
+  }
+
+ private:
+  const std::string shuffleName_;
+  const std::unique_ptr<VectorSerde> serde_;
+  const uint64_t maxBlockBytes_;
+  bool noMoreSplits_{false};
 };
 } // namespace
 
 folly::dynamic ShuffleReadNode::serialize() const {
   auto obj = PlanNode::serialize();
   obj["outputType"] = outputType_->serialize();
+  obj["serdeFormat"] = shuffleSerdeFormatName(serdeFormat_);
+  if (!sortingKeys_.empty()) {
+    auto sortingKeys = folly::dynamic::array();
+    auto sortingOrders = folly::dynamic::array();
+    for (size_t i = 0; i < sortingKeys_.size(); ++i) {
+      sortingKeys.push_back(sortingKeys_[i]->serialize());
+      sortingOrders.push_back(sortingOrders_[i].serialize());
+    }
+    obj["sortingKeys"] = std::move(sortingKeys);
+    obj["sortingOrders"] = std::move(sortingOrders);
+    obj["shuffleName"] = shuffleName_;
+  }
   return obj;
 }
 
 velox::core::PlanNodePtr ShuffleReadNode::create(
     const folly::dynamic& obj,
     void* context) {
+  std::vector<core::FieldAccessTypedExprPtr> sortingKeys;
+  std::vector<core::SortOrder> sortingOrders;
+  std::string shuffleName;
+  if (obj.count("sortingKeys")) {
+    for (const auto& key : obj["sortingKeys"]) {
+      sortingKeys.push_back(
+          ISerializable::deserialize<core::FieldAccessTypedExpr>(key, context));
+    }
+    for (const auto& order : obj["sortingOrders"]) {
+      sortingOrders.push_back(core::SortOrder::deserialize(order));
+    }
+    shuffleName = obj["shuffleName"].asString();
+  }
   return std::make_shared<ShuffleReadNode>(
       deserializePlanNodeId(obj),
-      ISerializable::deserialize<RowType>(obj["outputType"], context));
+      ISerializable::deserialize<RowType>(obj["outputType"], context),
+      obj.count("serdeFormat")
+          ? toShuffleSerdeFormat(obj["serdeFormat"].asString())
+          : ShuffleSerdeFormat::kUnsafeRow,
+      std::move(sortingKeys),
+      std::move(sortingOrders),
+      std::move(shuffleName));
+}
+
+std::unique_ptr<Operator> ShuffleReadTranslator::toOperator(
+    DriverCtx* ctx,
+    int32_t id,
+    const core::PlanNodePtr& node) {
+  if (auto shuffleReadNode =
+          std::dynamic_pointer_cast<const ShuffleReadNode>(node)) {
+    if (!shuffleReadNode->sortingKeys().empty()) {
+      return std::make_unique<ShuffleMergeReadOperator>(
+          id, ctx, shuffleReadNode);
+    }
+  }
+  return nullptr;
 }
 
 std::unique_ptr<Operator> ShuffleReadTranslator::toOperator(
@@ -72,9 +325,24 @@ std::unique_ptr<Operator> ShuffleReadTranslator::toOperator(
     std::shared_ptr<ExchangeClient> exchangeClient) {
   if (auto shuffleReadNode =
           std::dynamic_pointer_cast<const ShuffleReadNode>(node)) {
+    if (!shuffleReadNode->sortingKeys().empty()) {
+      return std::make_unique<ShuffleMergeReadOperator>(
+          id, ctx, shuffleReadNode);
+    }
     return std::make_unique<ShuffleReadOperator>(
         id, ctx, shuffleReadNode, exchangeClient);
   }
   return nullptr;
 }
+
+std::optional<uint32_t> ShuffleReadTranslator::maxDrivers(
+    const core::PlanNodePtr& node) {
+  if (auto shuffleReadNode =
+          std::dynamic_pointer_cast<const ShuffleReadNode>(node)) {
+    if (!shuffleReadNode->sortingKeys().empty()) {
+      return 1;
+    }
+  }
+  return std::nullopt;
+}
 } // namespace facebook::presto::operators
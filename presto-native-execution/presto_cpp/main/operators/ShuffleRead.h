@@ -13,14 +13,36 @@
  */
 #pragma once
 
+#include "presto_cpp/main/operators/ShuffleInterface.h"
 #include "velox/core/PlanNode.h"
 #include "velox/exec/Operator.h"
 
 namespace facebook::presto::operators {
+/// Reads a shuffle partition. If 'sortingKeys' are set, the runs written
+/// sorted on them by the writers of the shuffle named 'shuffleName' are
+/// merged into one sorted stream on a single driver, see
+/// ShuffleInterfaceFactory::createRunReaders(). Otherwise the blocks are
+/// returned in the order read.
 class ShuffleReadNode : public velox::core::PlanNode {
  public:
-  ShuffleReadNode(const velox::core::PlanNodeId& id, velox::RowTypePtr type)
-      : PlanNode(id), outputType_(type) {}
+  ShuffleReadNode(
+      const velox::core::PlanNodeId& id,
+      velox::RowTypePtr type,
+      ShuffleSerdeFormat serdeFormat = ShuffleSerdeFormat::kUnsafeRow,
+      std::vector<velox::core::FieldAccessTypedExprPtr> sortingKeys = {},
+      std::vector<velox::core::SortOrder> sortingOrders = {},
+      std::string shuffleName = "")
+      : PlanNode(id),
+        outputType_(type),
+        serdeFormat_(serdeFormat),
+        sortingKeys_(std::move(sortingKeys)),
+        sortingOrders_(std::move(sortingOrders)),
+        shuffleName_(std::move(shuffleName)) {
+    VELOX_CHECK_EQ(sortingKeys_.size(), sortingOrders_.size());
+    VELOX_CHECK(
+        sortingKeys_.empty() || !shuffleName_.empty(),
+        "The merging shuffle read needs the shuffle name");
+  }
 
   folly::dynamic serialize() const override;
 
@@ -32,13 +54,31 @@ class ShuffleReadNode : public velox::core::PlanNode {
     return outputType_;
   }
 
+  ShuffleSerdeFormat serdeFormat() const {
+    return serdeFormat_;
+  }
+
+  const std::vector<velox::core::FieldAccessTypedExprPtr>& sortingKeys()
+      const {
+    return sortingKeys_;
+  }
+
+  const std::vector<velox::core::SortOrder>& sortingOrders() const {
+    return sortingOrders_;
+  }
+
+  const std::string& shuffleName() const {
+    return shuffleName_;
+  }
+
   const std::vector<velox::core::PlanNodePtr>& sources() const override {
     static const std::vector<velox::core::PlanNodePtr> kEmptySources;
     return kEmptySources;
   }
 
+  /// The merging read creates the readers of the runs itself.
   bool requiresExchangeClient() const override {
-    return true;
+    return sortingKeys_.empty();
   }
 
   bool requiresSplits() const override {
@@ -51,18 +91,42 @@ class ShuffleReadNode : public velox::core::PlanNode {
 
  private:
   void addDetails(std::stringstream& stream) const override {
-    // Nothing to add
+    if (serdeFormat_ != ShuffleSerdeFormat::kUnsafeRow) {
+      stream << shuffleSerdeFormatName(serdeFormat_);
+    }
+    if (!sortingKeys_.empty()) {
+      stream << "merge on [";
+      for (size_t i = 0; i < sortingKeys_.size(); ++i) {
+        stream << (i > 0 ? ", " : "") << sortingKeys_[i]->name() << " "
+               << sortingOrders_[i].toString();
+      }
+      stream << "]";
+    }
   }
 
   velox::RowTypePtr outputType_;
+  const ShuffleSerdeFormat serdeFormat_;
+  const std::vector<velox::core::FieldAccessTypedExprPtr> sortingKeys_;
+  const std::vector<velox::core::SortOrder> sortingOrders_;
+  const std::string shuffleName_;
 };
 
 class ShuffleReadTranslator : public velox::exec::Operator::PlanNodeTranslator {
  public:
+  /// Translates the merging reads.
+  std::unique_ptr<velox::exec::Operator> toOperator(
+      velox::exec::DriverCtx* ctx,
+      int32_t id,
+      const velox::core::PlanNodePtr& node) override;
+
   std::unique_ptr<velox::exec::Operator> toOperator(
       velox::exec::DriverCtx* ctx,
       int32_t id,
       const velox::core::PlanNodePtr& node,
       std::shared_ptr<velox::exec::ExchangeClient> exchangeClient) override;
+
+  /// Returns 1 for the merging reads.
+  std::optional<uint32_t> maxDrivers(
+      const velox::core::PlanNodePtr& node) override;
 };
 } // namespace facebook::presto::operators
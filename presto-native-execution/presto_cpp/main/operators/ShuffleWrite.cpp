@@ -51,13 +51,27 @@ class ShuffleWriteOperator : public Operator {
   }
 
   void addInput(RowVectorPtr input) override {
+    const auto numRows = input->size();
+    auto flatPartitions = input->childAt(0)->asFlatVector<int32_t>();
+    auto flatRows = input->childAt(1)->asFlatVector<StringView>();
+    if (flatPartitions != nullptr && flatRows != nullptr) {
+      shuffle_->collect(
+          folly::Range(flatPartitions->rawValues(), numRows),
+          folly::Range(flatRows->rawValues(), numRows));
+      return;
+    }
+
     auto partitions = input->childAt(0)->as<SimpleVector<int32_t>>();
     auto serializedRows = input->childAt(1)->as<SimpleVector<StringView>>();
-    for (auto i = 0; i < input->size(); ++i) {
-      auto partition = partitions->valueAt(i);
-      auto data = serializedRows->valueAt(i);
-      shuffle_->collect(partition, std::string_view(data.data(), data.size()));
+    partitions_.resize(numRows);
+    serializedRows_.resize(numRows);
+    for (auto i = 0; i < numRows; ++i) {
+      partitions_[i] = partitions->valueAt(i);
+      serializedRows_[i] = serializedRows->valueAt(i);
     }
+    shuffle_->collect(
+        folly::Range(partitions_.data(), numRows),
+        folly::Range(serializedRows_.data(), numRows));
   }
 
   void noMoreInput() override {
@@ -70,15 +84,33 @@ class ShuffleWriteOperator : public Operator {
   }
 
   BlockingReason isBlocked(ContinueFuture* future) override {
+    if (shuffle_->isBlocked(future)) {
+      return BlockingReason::kWaitForConsumer;
+    }
     return BlockingReason::kNotBlocked;
   }
 
   bool isFinished() override {
-    return noMoreInput_;
+    if (!noMoreInput_) {
+      return false;
+    }
+    // Not finished until all the data is written.
+    return !shuffle_->hasPendingWrites();
+  }
+
+  void close() override {
+    // Reports the stats of the writer as the runtime stats of this operator.
+    for (const auto& [name, counter] : shuffle_->stats()) {
+      addRuntimeStat(name, counter);
+    }
+    Operator::close();
   }
 
  private:
   std::shared_ptr<ShuffleWriter> shuffle_;
+  // The partitions and rows of the non-flat inputs.
+  std::vector<int32_t> partitions_;
+  std::vector<StringView> serializedRows_;
 };
 } // namespace
 
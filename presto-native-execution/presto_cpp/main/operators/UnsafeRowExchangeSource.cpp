@@ -13,35 +13,121 @@
  */
 #include <fmt/format.h>
 #include <folly/Uri.h>
+#include <folly/executors/QueuedImmediateExecutor.h>
 
 #include "presto_cpp/main/common/Configs.h"
 #include "presto_cpp/main/operators/UnsafeRowExchangeSource.h"
 
 namespace facebook::presto::operators {
 
+UnsafeRowExchangeSource::UnsafeRowExchangeSource(
+    const std::string& taskId,
+    int destination,
+    std::shared_ptr<velox::exec::ExchangeQueue> queue,
+    std::vector<std::shared_ptr<ShuffleReader>> shuffles,
+    velox::memory::MemoryPool* FOLLY_NONNULL pool,
+    folly::Executor* executor)
+    : ExchangeSource(taskId, destination, std::move(queue), pool),
+      executor_(executor),
+      maxBlockBytes_(SystemConfig::instance()->exchangeMaxResponseBytes()) {
+  VELOX_CHECK(!shuffles.empty());
+  for (auto& shuffle : shuffles) {
+    shards_.push_back({std::move(shuffle)});
+  }
+}
+
+bool UnsafeRowExchangeSource::shouldRequestLocked() {
+  if (atEnd_) {
+    return false;
+  }
+  for (const auto& shard : shards_) {
+    if (!shard.pending && !shard.atEnd) {
+      return true;
+    }
+  }
+  return false;
+}
+
 void UnsafeRowExchangeSource::request() {
-  std::vector<velox::ContinuePromise> promises;
+  std::vector<size_t> shards;
   {
     std::lock_guard<std::mutex> l(queue_->mutex());
-    if (atEnd_) {
+    if (atEnd_ || closed_) {
       return;
     }
+    // Claims the idle shards. The concurrent requests claim the others.
+    for (size_t i = 0; i < shards_.size(); ++i) {
+      if (!shards_[i].pending && !shards_[i].atEnd) {
+        shards_[i].pending = true;
+        shards.push_back(i);
+      }
+    }
+  }
 
-    if (!shuffle_->hasNext()) {
-      atEnd_ = true;
-      queue_->enqueueLocked(nullptr, promises);
-    } else {
-      auto buffer = shuffle_->next(true);
+  for (auto shard : shards) {
+    if (executor_ == nullptr) {
+      readShard(shard);
+      continue;
+    }
+    executor_->add([self = getSelfPtr(), shard]() { self->readShard(shard); });
+  }
+}
+
+void UnsafeRowExchangeSource::readShard(size_t shard) {
+  // The shard is not read by anyone else while it is pending.
+  auto future = folly::makeSemiFutureWith([&]() {
+    return shards_[shard].reader->nextAsync(maxBlockBytes_);
+  });
+  if (future.isReady()) {
+    enqueueBlock(shard, std::move(future).getTry());
+    return;
+  }
+  // Enqueues the block on the thread which completes the read.
+  std::move(future)
+      .via(&folly::QueuedImmediateExecutor::instance())
+      .thenTry(
+          [self = getSelfPtr(), shard](folly::Try<velox::BufferPtr> buffer) {
+            self->enqueueBlock(shard, std::move(buffer));
+          });
+}
+
+void UnsafeRowExchangeSource::enqueueBlock(
+    size_t shard,
+    folly::Try<velox::BufferPtr> buffer) {
+  if (buffer.hasException()) {
+    {
+      std::lock_guard<std::mutex> l(queue_->mutex());
+      shards_[shard].pending = false;
+    }
+    queue_->setError(buffer.exception().what().toStdString());
+    return;
+  }
 
-      auto ioBuf = folly::IOBuf::wrapBuffer(buffer->as<char>(), buffer->size());
+  std::vector<velox::ContinuePromise> promises;
+  {
+    std::lock_guard<std::mutex> l(queue_->mutex());
+    shards_[shard].pending = false;
+    if (closed_) {
+      return;
+    }
+    if (buffer.value() == nullptr) {
+      shards_[shard].atEnd = true;
+      if (++numShardsAtEnd_ == shards_.size()) {
+        atEnd_ = true;
+        queue_->enqueueLocked(nullptr, promises);
+      }
+    } else {
+      auto block = std::move(buffer.value());
+      auto ioBuf = folly::IOBuf::wrapBuffer(block->as<char>(), block->size());
       // NOTE: SerializedPage's onDestructionCb_ captures one reference on
-      // 'buffer' to keep its alive until SerializedPage destruction. Also note
-      // that 'buffer' should have been allocated from memory pool. Hence, we
-      // don't need to update the memory usage counting for the associated
-      // 'ioBuf' attached to SerializedPage on destruction.
+      // 'block' to keep its alive until SerializedPage destruction. Also note
+      // that 'block' is either allocated from memory pool or a view of a
+      // memory mapped file range. Hence, we don't need to update the memory
+      // usage counting for the associated 'ioBuf' attached to SerializedPage
+      // on destruction.
       queue_->enqueueLocked(
           std::make_unique<velox::exec::SerializedPage>(
-              std::move(ioBuf), pool_, [buffer](auto&) {}),
+              std::move(ioBuf), pool_, [block](auto&) {}),
           promises);
     }
   }
@@ -50,14 +136,20 @@ void UnsafeRowExchangeSource::request() {
   }
 }
 
+std::shared_ptr<UnsafeRowExchangeSource> UnsafeRowExchangeSource::getSelfPtr() {
+  return std::dynamic_pointer_cast<UnsafeRowExchangeSource>(
+      shared_from_this());
+}
+
 namespace {
-std::optional<std::string> getSerializedShuffleInfo(folly::Uri& uri) {
+std::vector<std::string> getSerializedShuffleInfos(folly::Uri& uri) {
+  std::vector<std::string> shuffleInfos;
   for (auto& pair : uri.getQueryParams()) {
     if (pair.first == "shuffleInfo") {
-      return std::make_optional(pair.second);
+      shuffleInfos.push_back(pair.second);
     }
   }
-  return std::nullopt;
+  return shuffleInfos;
 }
 } // namespace
 
@@ -78,17 +170,47 @@ UnsafeRowExchangeSource::createExchangeSource(
       "interface.");
   auto shuffleFactory = ShuffleInterfaceFactory::factory(shuffleName);
   auto uri = folly::Uri(url);
-  auto serializedShuffleInfo = getSerializedShuffleInfo(uri);
+  const auto serializedShuffleInfos = getSerializedShuffleInfos(uri);
   VELOX_USER_CHECK(
-      serializedShuffleInfo.has_value(),
+      !serializedShuffleInfos.empty(),
       "Cannot find shuffleInfo parameter in split url '{}'",
       url);
+  std::vector<std::shared_ptr<ShuffleReader>> shuffles;
+  for (const auto& serializedShuffleInfo : serializedShuffleInfos) {
+    shuffles.push_back(
+        shuffleFactory->createReader(serializedShuffleInfo, destination, pool));
+  }
   return std::make_unique<UnsafeRowExchangeSource>(
       uri.host(),
       destination,
       std::move(queue),
-      shuffleFactory->createReader(
-          serializedShuffleInfo.value(), destination, pool),
-      pool);
+      std::move(shuffles),
+      pool,
+      readExecutor());
+}
+
+// static
+std::vector<std::shared_ptr<ShuffleReader>>
+UnsafeRowExchangeSource::createRunReaders(
+    const std::string& shuffleName,
+    const std::string& url,
+    int32_t destination,
+    velox::memory::MemoryPool* FOLLY_NONNULL pool) {
+  VELOX_USER_CHECK_EQ(
+      ::strncmp(url.c_str(), "batch://", 8), 0, "Not a shuffle split: {}", url);
+  auto shuffleFactory = ShuffleInterfaceFactory::factory(shuffleName);
+  auto uri = folly::Uri(url);
+  const auto serializedShuffleInfos = getSerializedShuffleInfos(uri);
+  VELOX_USER_CHECK(
+      !serializedShuffleInfos.empty(),
+      "Cannot find shuffleInfo parameter in split url '{}'",
+      url);
+  std::vector<std::shared_ptr<ShuffleReader>> readers;
+  for (const auto& serializedShuffleInfo : serializedShuffleInfos) {
+    auto runReaders = shuffleFactory->createRunReaders(
+        serializedShuffleInfo, destination, pool);
+    readers.insert(readers.end(), runReaders.begin(), runReaders.end());
+  }
+  return readers;
 }
 }; // namespace facebook::presto::operators
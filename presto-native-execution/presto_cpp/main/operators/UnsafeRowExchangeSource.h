@@ -13,6 +13,7 @@
  */
 #pragma once
 
+#include <folly/Executor.h>
 #include "presto_cpp/main/operators/ShuffleWrite.h"
 #include "velox/core/PlanNode.h"
 #include "velox/exec/Exchange.h"
@@ -20,33 +21,104 @@
 
 namespace facebook::presto::operators {
 
+/// Reads the blocks of a destination partition from one or more shuffle
+/// reader shards with ShuffleReader::nextAsync(). The blocks are enqueued
+/// once their futures complete so that the drivers don't wait for the blocks
+/// in flight. If a read executor is set, see setReadExecutor(), the blocks
+/// are requested on it so that the synchronous readers read the next block
+/// while the consumer deserializes the last one, and the shards are read in
+/// parallel. Otherwise, the synchronous readers are read on the requesting
+/// thread.
 class UnsafeRowExchangeSource : public velox::exec::ExchangeSource {
  public:
+  UnsafeRowExchangeSource(
+      const std::string& taskId,
+      int destination,
+      std::shared_ptr<velox::exec::ExchangeQueue> queue,
+      std::vector<std::shared_ptr<ShuffleReader>> shuffles,
+      velox::memory::MemoryPool* FOLLY_NONNULL pool,
+      folly::Executor* executor = nullptr);
+
   UnsafeRowExchangeSource(
       const std::string& taskId,
       int destination,
       std::shared_ptr<velox::exec::ExchangeQueue> queue,
       const std::shared_ptr<ShuffleReader>& shuffle,
-      velox::memory::MemoryPool* FOLLY_NONNULL pool)
-      : ExchangeSource(taskId, destination, queue, pool), shuffle_(shuffle) {}
+      velox::memory::MemoryPool* FOLLY_NONNULL pool,
+      folly::Executor* executor = nullptr)
+      : UnsafeRowExchangeSource(
+            taskId,
+            destination,
+            std::move(queue),
+            std::vector<std::shared_ptr<ShuffleReader>>{shuffle},
+            pool,
+            executor) {}
 
-  bool shouldRequestLocked() override {
-    return !atEnd_;
-  }
+  /// Returns true if there is a shard without a read in flight.
+  bool shouldRequestLocked() override;
 
+  /// Requests the next block from each shard without a read in flight,
+  /// outside of the queue lock. There is at most one read in flight per
+  /// shard.
   void request() override;
 
-  void close() override {}
+  void close() override {
+    closed_ = true;
+  }
 
   /// url needs to follow below format:
   /// batch://<taskid>?shuffleInfo=<serialized-shuffle-info>
+  /// A reader shard is created for each shuffleInfo parameter.
   static std::unique_ptr<velox::exec::ExchangeSource> createExchangeSource(
       const std::string& url,
       int32_t destination,
       std::shared_ptr<velox::exec::ExchangeQueue> queue,
       velox::memory::MemoryPool* FOLLY_NONNULL pool);
 
+  /// Returns the readers of the sorted runs of 'destination' of the shuffle
+  /// named 'shuffleName' at 'url', in the format of createExchangeSource().
+  static std::vector<std::shared_ptr<ShuffleReader>> createRunReaders(
+      const std::string& shuffleName,
+      const std::string& url,
+      int32_t destination,
+      velox::memory::MemoryPool* FOLLY_NONNULL pool);
+
+  /// Sets the executor to read the blocks of the sources created by
+  /// createExchangeSource() on. The blocks are read on the requesting threads
+  /// if null.
+  static void setReadExecutor(folly::Executor* executor) {
+    readExecutor() = executor;
+  }
+
  private:
-  const std::shared_ptr<ShuffleReader> shuffle_;
+  struct Shard {
+    std::shared_ptr<ShuffleReader> reader;
+    // True while a block is being read.
+    bool pending{false};
+    bool atEnd{false};
+  };
+
+  static folly::Executor*& readExecutor() {
+    static folly::Executor* readExecutor{nullptr};
+    return readExecutor;
+  }
+
+  // Requests the next block of 'shards_[shard]' and enqueues it once read.
+  void readShard(size_t shard);
+
+  // Enqueues the 'buffer' read from 'shards_[shard]', or the end marker if
+  // null and all the shards are at end. Sets the error of the queue if the
+  // read failed.
+  void enqueueBlock(size_t shard, folly::Try<velox::BufferPtr> buffer);
+
+  std::shared_ptr<UnsafeRowExchangeSource> getSelfPtr();
+
+  folly::Executor* const executor_;
+  // The max size of the blocks to ask the shards for.
+  const uint64_t maxBlockBytes_;
+  // Guarded by the queue lock.
+  std::vector<Shard> shards_;
+  size_t numShardsAtEnd_{0};
+  std::atomic_bool closed_{false};
 };
 } // namespace facebook::presto::operators
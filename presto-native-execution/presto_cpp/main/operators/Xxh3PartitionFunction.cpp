@@ -0,0 +1,130 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/operators/Xxh3PartitionFunction.h"
+#include "presto_cpp/external/xxh3.h"
+
+using namespace facebook::velox;
+
+namespace facebook::presto::operators {
+namespace {
+// Chains the hash of the values of 'decoded' for 'size' rows into 'hashes'.
+// The hash of the first key column is seeded with 0.
+template <typename T>
+void hashFixedWidth(
+    const DecodedVector& decoded,
+    vector_size_t size,
+    uint64_t* hashes) {
+  if (decoded.isIdentityMapping() && !decoded.mayHaveNulls()) {
+    const auto* values = decoded.data<T>();
+    for (vector_size_t row = 0; row < size; ++row) {
+      hashes[row] = XXH3_64bits_withSeed(&values[row], sizeof(T), hashes[row]);
+    }
+    return;
+  }
+  for (vector_size_t row = 0; row < size; ++row) {
+    if (decoded.isNullAt(row)) {
+      hashes[row] = XXH3_64bits_withSeed(nullptr, 0, hashes[row]);
+      continue;
+    }
+    const T value = decoded.valueAt<T>(row);
+    hashes[row] = XXH3_64bits_withSeed(&value, sizeof(T), hashes[row]);
+  }
+}
+
+void hashStrings(
+    const DecodedVector& decoded,
+    vector_size_t size,
+    uint64_t* hashes) {
+  for (vector_size_t row = 0; row < size; ++row) {
+    if (decoded.isNullAt(row)) {
+      hashes[row] = XXH3_64bits_withSeed(nullptr, 0, hashes[row]);
+      continue;
+    }
+    const auto value = decoded.valueAt<StringView>(row);
+    hashes[row] = XXH3_64bits_withSeed(value.data(), value.size(), hashes[row]);
+  }
+}
+} // namespace
+
+Xxh3PartitionFunction::Xxh3PartitionFunction(
+    int numPartitions,
+    std::vector<column_index_t> keyChannels)
+    : numPartitions_(numPartitions), keyChannels_(std::move(keyChannels)) {
+  VELOX_CHECK_GT(numPartitions_, 0);
+}
+
+std::optional<uint32_t> Xxh3PartitionFunction::partition(
+    const RowVector& input,
+    std::vector<uint32_t>& partitions) {
+  const auto size = input.size();
+  hashes_.assign(size, 0);
+  rows_.resize(size);
+  rows_.setAll();
+  for (const auto channel : keyChannels_) {
+    const auto& key = input.childAt(channel);
+    decoded_.decode(*key, rows_);
+    switch (key->typeKind()) {
+      case TypeKind::BIGINT:
+        hashFixedWidth<int64_t>(decoded_, size, hashes_.data());
+        break;
+      case TypeKind::INTEGER:
+        hashFixedWidth<int32_t>(decoded_, size, hashes_.data());
+        break;
+      case TypeKind::VARCHAR:
+        hashStrings(decoded_, size, hashes_.data());
+        break;
+      default:
+        VELOX_UNSUPPORTED(
+            "Unsupported XXH3 partition key type: {}", key->type()->toString());
+    }
+  }
+  partitions.resize(size);
+  for (vector_size_t row = 0; row < size; ++row) {
+    partitions[row] = hashes_[row] % numPartitions_;
+  }
+  return std::nullopt;
+}
+
+// static
+bool Xxh3PartitionFunction::supportsType(const Type& type) {
+  switch (type.kind()) {
+    case TypeKind::BIGINT:
+    case TypeKind::INTEGER:
+    case TypeKind::VARCHAR:
+      return true;
+    default:
+      return false;
+  }
+}
+
+std::string Xxh3PartitionFunctionSpec::toString() const {
+  return fmt::format("XXH3({})", folly::join(", ", keyChannels_));
+}
+
+folly::dynamic Xxh3PartitionFunctionSpec::serialize() const {
+  folly::dynamic obj = folly::dynamic::object;
+  obj["name"] = "Xxh3PartitionFunctionSpec";
+  obj["keys"] = ISerializable::serialize(keyChannels_);
+  return obj;
+}
+
+// static
+core::PartitionFunctionSpecPtr Xxh3PartitionFunctionSpec::deserialize(
+    const folly::dynamic& obj,
+    void* /*context*/) {
+  return std::make_shared<Xxh3PartitionFunctionSpec>(
+      ISerializable::deserialize<std::vector<column_index_t>>(obj["keys"]));
+}
+
+} // namespace facebook::presto::operators
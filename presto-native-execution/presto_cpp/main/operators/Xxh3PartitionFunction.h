@@ -0,0 +1,76 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include "velox/core/PlanNode.h"
+#include "velox/vector/ComplexVector.h"
+
+namespace facebook::presto::operators {
+
+/// Hash partitions the rows by their BIGINT, INTEGER and VARCHAR key columns
+/// with XXH3. Each key column is hashed over the whole batch in a loop
+/// specialized for its type, reading the flat values directly, instead of
+/// dispatching on the type per row. The hashes of the keys are chained
+/// through the XXH3 seed.
+///
+/// The partitions differ from the ones of the HashPartitionFunction, so all
+/// the writers of a shuffle must use the same function.
+class Xxh3PartitionFunction : public velox::core::PartitionFunction {
+ public:
+  Xxh3PartitionFunction(
+      int numPartitions,
+      std::vector<velox::column_index_t> keyChannels);
+
+  std::optional<uint32_t> partition(
+      const velox::RowVector& input,
+      std::vector<uint32_t>& partitions) override;
+
+  /// Returns true if the keys of 'type' can be hashed by this function.
+  static bool supportsType(const velox::Type& type);
+
+ private:
+  const int numPartitions_;
+  const std::vector<velox::column_index_t> keyChannels_;
+
+  // Reused across the batches.
+  std::vector<uint64_t> hashes_;
+  velox::SelectivityVector rows_;
+  velox::DecodedVector decoded_;
+};
+
+class Xxh3PartitionFunctionSpec : public velox::core::PartitionFunctionSpec {
+ public:
+  explicit Xxh3PartitionFunctionSpec(
+      std::vector<velox::column_index_t> keyChannels)
+      : keyChannels_(std::move(keyChannels)) {}
+
+  std::unique_ptr<velox::core::PartitionFunction> create(
+      int numPartitions) const override {
+    return std::make_unique<Xxh3PartitionFunction>(
+        numPartitions, keyChannels_);
+  }
+
+  std::string toString() const override;
+
+  folly::dynamic serialize() const override;
+
+  static velox::core::PartitionFunctionSpecPtr deserialize(
+      const folly::dynamic& obj,
+      void* context);
+
+ private:
+  const std::vector<velox::column_index_t> keyChannels_;
+};
+
+} // namespace facebook::presto::operators
@@ -0,0 +1,60 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <gtest/gtest.h>
+
+#include "presto_cpp/main/operators/ArrowBatchBridge.h"
+#include "velox/common/base/tests/GTestUtils.h"
+#include "velox/vector/tests/utils/VectorTestBase.h"
+
+using namespace facebook::velox;
+using namespace facebook::presto::operators;
+
+namespace {
+class ArrowBatchBridgeTest : public testing::Test,
+                             public velox::test::VectorTestBase {};
+
+TEST_F(ArrowBatchBridgeTest, roundTrip) {
+  auto batch = makeRowVector(
+      {"id", "name"},
+      {
+          makeFlatVector<int64_t>({1, 2, 3, 4}),
+          makeNullableFlatVector<std::string>(
+              {"a", std::nullopt, "a longer string than inlined", "d"}),
+      });
+
+  ArrowSchema schema;
+  ArrowArray array;
+  exportBatchToArrow(batch, schema, array, pool());
+  ASSERT_EQ(array.length, 4);
+  ASSERT_EQ(schema.n_children, 2);
+
+  auto copy = importBatchFromArrow(
+      schema, array, pool(), asRowType(batch->type()));
+  test::assertEqualVectors(batch, copy);
+  // The fixed width values are not copied.
+  ASSERT_EQ(
+      copy->childAt(0)->asFlatVector<int64_t>()->rawValues(),
+      batch->childAt(0)->asFlatVector<int64_t>()->rawValues());
+}
+
+TEST_F(ArrowBatchBridgeTest, typeMismatch) {
+  auto batch = makeRowVector({makeFlatVector<int32_t>({1, 2})});
+  ArrowSchema schema;
+  ArrowArray array;
+  exportBatchToArrow(batch, schema, array, pool());
+  VELOX_ASSERT_THROW(
+      importBatchFromArrow(schema, array, pool(), ROW({"c0"}, {BIGINT()})),
+      "doesn't match");
+}
+} // namespace
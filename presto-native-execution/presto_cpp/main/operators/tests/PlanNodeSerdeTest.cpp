@@ -14,9 +14,12 @@
 #include <gtest/gtest.h>
 
 #include "presto_cpp/main/operators/PartitionAndSerialize.h"
+#include "presto_cpp/main/operators/RangePartitionFunction.h"
 #include "presto_cpp/main/operators/ShuffleRead.h"
 #include "presto_cpp/main/operators/ShuffleWrite.h"
+#include "presto_cpp/main/operators/Xxh3PartitionFunction.h"
 #include "presto_cpp/main/types/PrestoToVeloxQueryPlan.h"
+#include "velox/common/base/tests/GTestUtils.h"
 #include "velox/core/PlanNode.h"
 #include "velox/exec/HashPartitionFunction.h"
 #include "velox/exec/tests/utils/PlanBuilder.h"
@@ -121,29 +124,47 @@ class PlanNodeSerdeTest : public testing::Test,
     ASSERT_EQ(plan->toString(true, true), copy->toString(true, true));
   }
 
-  auto addPartitionAndSerializeNode(uint32_t numPartitions) {
-    return [numPartitions](
+  auto addPartitionAndSerializeNode(
+      uint32_t numPartitions,
+      ShuffleSerdeFormat serdeFormat = ShuffleSerdeFormat::kUnsafeRow,
+      const std::string& shuffleName = "",
+      const std::string& serializedWriteInfo = "",
+      bool xxh3 = false) {
+    return [numPartitions, serdeFormat, shuffleName, serializedWriteInfo, xxh3](
                core::PlanNodeId nodeId,
                core::PlanNodePtr source) -> core::PlanNodePtr {
       const auto outputType = source->outputType();
       const std::vector<velox::core::TypedExprPtr> keys = {
           std::make_shared<core::FieldAccessTypedExpr>(INTEGER(), "c0")};
+      core::PartitionFunctionSpecPtr partitionFunctionSpec;
+      if (xxh3) {
+        partitionFunctionSpec = std::make_shared<Xxh3PartitionFunctionSpec>(
+            std::vector<column_index_t>{0});
+      } else {
+        partitionFunctionSpec = std::make_shared<HashPartitionFunctionSpec>(
+            outputType, std::vector<column_index_t>{0});
+      }
       return std::make_shared<PartitionAndSerializeNode>(
           nodeId,
           keys,
           numPartitions,
           ROW({"p", "d"}, {INTEGER(), VARBINARY()}),
           std::move(source),
-          std::make_shared<HashPartitionFunctionSpec>(
-              outputType, std::vector<column_index_t>{0}));
+          std::move(partitionFunctionSpec),
+          serdeFormat,
+          shuffleName,
+          serializedWriteInfo);
     };
   }
 
-  auto addShuffleReadNode(velox::RowTypePtr& outputType) {
-    return [&outputType](
+  auto addShuffleReadNode(
+      velox::RowTypePtr& outputType,
+      ShuffleSerdeFormat serdeFormat = ShuffleSerdeFormat::kUnsafeRow) {
+    return [&outputType, serdeFormat](
                core::PlanNodeId nodeId,
                core::PlanNodePtr /* source */) -> core::PlanNodePtr {
-      return std::make_shared<ShuffleReadNode>(nodeId, outputType);
+      return std::make_shared<ShuffleReadNode>(
+          nodeId, outputType, serdeFormat);
     };
   }
 
@@ -169,6 +190,118 @@ TEST_F(PlanNodeSerdeTest, partitionAndSerializeNode) {
                   .localPartition({})
                   .planNode();
   testSerde(plan);
+
+  plan =
+      exec::test::PlanBuilder()
+          .values(data_, true)
+          .addNode(addPartitionAndSerializeNode(4, ShuffleSerdeFormat::kPresto))
+          .localPartition({})
+          .planNode();
+  testSerde(plan);
+
+  // Fused with the shuffle write.
+  plan = exec::test::PlanBuilder()
+             .values(data_, true)
+             .addNode(addPartitionAndSerializeNode(
+                 4,
+                 ShuffleSerdeFormat::kUnsafeRow,
+                 "local",
+                 "{\"rootPath\": \"/tmp\"}"))
+             .planNode();
+  testSerde(plan);
+
+  // Partitioned by XXH3.
+  plan = exec::test::PlanBuilder()
+             .values(data_, true)
+             .addNode(addPartitionAndSerializeNode(
+                 4, ShuffleSerdeFormat::kUnsafeRow, "", "", true))
+             .localPartition({})
+             .planNode();
+  testSerde(plan);
+}
+
+TEST_F(PlanNodeSerdeTest, xxh3PartitionFunction) {
+  auto flat = makeRowVector({
+      makeNullableFlatVector<int64_t>({1, 2, std::nullopt, 1, 2, 3}),
+      makeFlatVector<std::string>({"a", "b", "c", "a", "b", "a"}),
+  });
+  // The same rows in the order 3, 0, 4, 1, 5, 2 behind dictionaries.
+  auto indices = makeIndices({3, 0, 4, 1, 5, 2});
+  auto dictionary = makeRowVector({
+      wrapInDictionary(indices, flat->childAt(0)),
+      wrapInDictionary(indices, flat->childAt(1)),
+  });
+
+  auto function = Xxh3PartitionFunctionSpec({0, 1}).create(16);
+  std::vector<uint32_t> partitions;
+  ASSERT_FALSE(function->partition(*flat, partitions).has_value());
+  ASSERT_EQ(partitions.size(), 6);
+  for (auto partition : partitions) {
+    ASSERT_LT(partition, 16);
+  }
+  // Equal keys go to the same partition.
+  ASSERT_EQ(partitions[0], partitions[3]);
+  ASSERT_EQ(partitions[1], partitions[4]);
+
+  std::vector<uint32_t> dictionaryPartitions;
+  function->partition(*dictionary, dictionaryPartitions);
+  const std::vector<vector_size_t> order = {3, 0, 4, 1, 5, 2};
+  for (auto i = 0; i < order.size(); ++i) {
+    ASSERT_EQ(dictionaryPartitions[i], partitions[order[i]]);
+  }
+
+  ASSERT_TRUE(Xxh3PartitionFunction::supportsType(*VARCHAR()));
+  ASSERT_FALSE(Xxh3PartitionFunction::supportsType(*DOUBLE()));
+}
+
+TEST_F(PlanNodeSerdeTest, rangePartitionFunction) {
+  auto sample = makeRowVector({
+      makeFlatVector<int64_t>({9, 1, 7, 3, 5, 2, 8, 4, 6, 0, 5, 5}),
+  });
+  const std::vector<core::SortOrder> ascending = {core::SortOrder(true, true)};
+  auto boundaries = RangePartitionFunction::sampleBoundaries(
+      *sample, {0}, ascending, 4, pool());
+  ASSERT_EQ(boundaries.size(), 1);
+  ASSERT_EQ(boundaries[0]->size(), 3);
+  auto* values = boundaries[0]->asFlatVector<int64_t>();
+  ASSERT_EQ(values->valueAt(0), 2);
+  ASSERT_EQ(values->valueAt(1), 5);
+  ASSERT_EQ(values->valueAt(2), 6);
+
+  // Rows equal to a boundary go to its partition.
+  auto input = makeRowVector({
+      makeNullableFlatVector<int64_t>({0, 2, 3, 5, 6, 7, 100, std::nullopt}),
+  });
+  const std::vector<uint32_t> expected = {0, 0, 1, 1, 2, 3, 3, 0};
+  RangePartitionFunctionSpec spec({0}, ascending, boundaries);
+  std::vector<uint32_t> partitions;
+  ASSERT_FALSE(spec.create(4)->partition(*input, partitions).has_value());
+  ASSERT_EQ(partitions, expected);
+
+  // Same after a serde round trip.
+  auto copy = RangePartitionFunctionSpec::deserialize(spec.serialize(), pool());
+  ASSERT_EQ(copy->toString(), spec.toString());
+  partitions.clear();
+  copy->create(4)->partition(*input, partitions);
+  ASSERT_EQ(partitions, expected);
+
+  // Descending order reverses the partitions.
+  const std::vector<core::SortOrder> descending = {
+      core::SortOrder(false, false)};
+  boundaries = RangePartitionFunction::sampleBoundaries(
+      *sample, {0}, descending, 2, pool());
+  ASSERT_EQ(boundaries[0]->size(), 1);
+  ASSERT_EQ(boundaries[0]->asFlatVector<int64_t>()->valueAt(0), 5);
+  RangePartitionFunctionSpec({0}, descending, boundaries)
+      .create(2)
+      ->partition(*input, partitions);
+  ASSERT_EQ(partitions, std::vector<uint32_t>({1, 1, 1, 0, 0, 0, 0, 1}));
+
+  // Too many boundaries for the partitions.
+  VELOX_ASSERT_THROW(
+      RangePartitionFunctionSpec({0}, ascending, {makeFlatVector<int64_t>({1})})
+          .create(1),
+      "Too many range boundaries for 1 partitions");
 }
 
 TEST_F(PlanNodeSerdeTest, shuffleReadNode) {
@@ -177,6 +310,24 @@ TEST_F(PlanNodeSerdeTest, shuffleReadNode) {
                   .project(type_->names())
                   .planNode();
   testSerde(plan);
+
+  plan = exec::test::PlanBuilder()
+             .addNode(addShuffleReadNode(type_, ShuffleSerdeFormat::kPresto))
+             .project(type_->names())
+             .planNode();
+  testSerde(plan);
+
+  // A merging read.
+  auto sortedRead = std::make_shared<ShuffleReadNode>(
+      "0",
+      type_,
+      ShuffleSerdeFormat::kUnsafeRow,
+      std::vector<core::FieldAccessTypedExprPtr>{
+          std::make_shared<core::FieldAccessTypedExpr>(
+              type_->childAt(0), type_->nameOf(0))},
+      std::vector<core::SortOrder>{core::SortOrder(false, true)},
+      "local");
+  testSerde(sortedRead);
 }
 
 TEST_F(PlanNodeSerdeTest, shuffleWriteNode) {
@@ -12,6 +12,7 @@
  * limitations under the License.
  */
 #include <folly/Uri.h>
+#include <folly/executors/IOThreadPoolExecutor.h>
 #include "folly/init/Init.h"
 #include "presto_cpp/external/json/json.hpp"
 #include "presto_cpp/main/operators/LocalPersistentShuffle.h"
@@ -19,12 +20,14 @@
 #include "presto_cpp/main/operators/ShuffleRead.h"
 #include "presto_cpp/main/operators/ShuffleWrite.h"
 #include "presto_cpp/main/operators/UnsafeRowExchangeSource.h"
+#include "velox/common/base/tests/GTestUtils.h"
 #include "velox/connectors/hive/HivePartitionFunction.h"
 #include "velox/exec/Exchange.h"
 #include "velox/exec/tests/utils/OperatorTestBase.h"
 #include "velox/exec/tests/utils/PlanBuilder.h"
 #include "velox/exec/tests/utils/TempDirectoryPath.h"
 #include "velox/expression/VectorFunction.h"
+#include "velox/serializers/PrestoSerializer.h"
 #include "velox/serializers/UnsafeRowSerializer.h"
 #include "velox/vector/fuzzer/VectorFuzzer.h"
 
@@ -265,8 +268,12 @@ void registerExchangeSource(const std::string& shuffleName) {
       });
 }
 
-auto addPartitionAndSerializeNode(uint32_t numPartitions) {
-  return [numPartitions](
+auto addPartitionAndSerializeNode(
+    uint32_t numPartitions,
+    ShuffleSerdeFormat serdeFormat = ShuffleSerdeFormat::kUnsafeRow,
+    const std::string& shuffleName = "",
+    const std::string& serializedWriteInfo = "") {
+  return [numPartitions, serdeFormat, shuffleName, serializedWriteInfo](
              core::PlanNodeId nodeId,
              core::PlanNodePtr source) -> core::PlanNodePtr {
     std::vector<core::TypedExprPtr> keys;
@@ -280,7 +287,10 @@ auto addPartitionAndSerializeNode(uint32_t numPartitions) {
         ROW({"p", "d"}, {INTEGER(), VARBINARY()}),
         std::move(source),
         std::make_shared<HivePartitionFunctionSpec>(
-            exec::toChannels(outputType, keys)));
+            exec::toChannels(outputType, keys)),
+        serdeFormat,
+        shuffleName,
+        serializedWriteInfo);
   };
 }
 
@@ -295,11 +305,13 @@ auto addShuffleWriteNode(
   };
 }
 
-auto addShuffleReadNode(velox::RowTypePtr& outputType) {
-  return [&outputType](
+auto addShuffleReadNode(
+    velox::RowTypePtr& outputType,
+    ShuffleSerdeFormat serdeFormat = ShuffleSerdeFormat::kUnsafeRow) {
+  return [&outputType, serdeFormat](
              core::PlanNodeId nodeId,
              core::PlanNodePtr /* source */) -> core::PlanNodePtr {
-    return std::make_shared<ShuffleReadNode>(nodeId, outputType);
+    return std::make_shared<ShuffleReadNode>(nodeId, outputType, serdeFormat);
   };
 }
 } // namespace
@@ -421,6 +433,44 @@ class UnsafeRowShuffleTest : public exec::test::OperatorTestBase {
     return result;
   }
 
+  // Deserializes the PrestoPages in the data column of 'serializedResult'.
+  std::vector<RowVectorPtr> deserializePages(
+      const RowVectorPtr& serializedResult,
+      const RowTypePtr& rowType) {
+    auto serializedData =
+        serializedResult->childAt(1)->as<FlatVector<StringView>>();
+    serializer::presto::PrestoVectorSerde serde;
+    std::vector<RowVectorPtr> pages;
+    for (auto i = 0; i < serializedData->size(); ++i) {
+      auto value = serializedData->valueAt(i);
+      ByteRange byteRange = {
+          reinterpret_cast<uint8_t*>(const_cast<char*>(value.data())),
+          (int32_t)value.size(),
+          0};
+      auto input = std::make_unique<ByteStream>();
+      input->resetInput({byteRange});
+
+      RowVectorPtr result;
+      serde.deserialize(input.get(), pool(), rowType, &result, nullptr);
+      pages.push_back(copyResultVector(result));
+    }
+    return pages;
+  }
+
+  // Returns the total size of the data column of 'serializedResults'.
+  static size_t serializedBytes(
+      const std::vector<RowVectorPtr>& serializedResults) {
+    size_t numBytes = 0;
+    for (auto& serializedResult : serializedResults) {
+      auto serializedData =
+          serializedResult->childAt(1)->as<FlatVector<StringView>>();
+      for (auto i = 0; i < serializedData->size(); ++i) {
+        numBytes += serializedData->valueAt(i).size();
+      }
+    }
+    return numBytes;
+  }
+
   RowVectorPtr copyResultVector(const RowVectorPtr& result) {
     auto vector = std::static_pointer_cast<RowVector>(
         BaseVector::create(result->type(), result->size(), pool()));
@@ -435,7 +485,9 @@ class UnsafeRowShuffleTest : public exec::test::OperatorTestBase {
       const std::string& serializedShuffleReadInfo,
       size_t numPartitions,
       size_t numMapDrivers,
-      const std::vector<RowVectorPtr>& data) {
+      const std::vector<RowVectorPtr>& data,
+      ShuffleSerdeFormat serdeFormat = ShuffleSerdeFormat::kUnsafeRow,
+      bool fusedWrite = false) {
     // Register new shuffle related operators.
     exec::Operator::registerOperator(
         std::make_unique<PartitionAndSerializeTranslator>());
@@ -453,13 +505,23 @@ class UnsafeRowShuffleTest : public exec::test::OperatorTestBase {
       flattenInputs.push_back(vectorMaker_.flatten<RowVector>(input));
     }
 
-    auto writerPlan = exec::test::PlanBuilder()
-                          .values(flattenInputs, true)
-                          .addNode(addPartitionAndSerializeNode(numPartitions))
-                          .localPartition({})
-                          .addNode(addShuffleWriteNode(
-                              shuffleName, serializedShuffleWriteInfo))
-                          .planNode();
+    auto writerPlan = fusedWrite
+        ? exec::test::PlanBuilder()
+              .values(flattenInputs, true)
+              .addNode(addPartitionAndSerializeNode(
+                  numPartitions,
+                  serdeFormat,
+                  shuffleName,
+                  serializedShuffleWriteInfo))
+              .planNode()
+        : exec::test::PlanBuilder()
+              .values(flattenInputs, true)
+              .addNode(
+                  addPartitionAndSerializeNode(numPartitions, serdeFormat))
+              .localPartition({})
+              .addNode(
+                  addShuffleWriteNode(shuffleName, serializedShuffleWriteInfo))
+              .planNode();
 
     auto writerTaskId = makeTaskId("leaf", 0);
     auto writerTask = makeTask(writerTaskId, writerPlan, 0);
@@ -479,7 +541,7 @@ class UnsafeRowShuffleTest : public exec::test::OperatorTestBase {
     // from shuffle.
     for (auto i = 0; i < numPartitions; ++i) {
       auto plan = exec::test::PlanBuilder()
-                      .addNode(addShuffleReadNode(dataType))
+                      .addNode(addShuffleReadNode(dataType, serdeFormat))
                       .project(dataType->names())
                       .planNode();
 
@@ -505,6 +567,46 @@ class UnsafeRowShuffleTest : public exec::test::OperatorTestBase {
     velox::exec::test::assertEqualResults(expectedOutputVectors, outputVectors);
   }
 
+  // Returns the contents of the shuffle files in 'rootPath' keyed by the file
+  // names without the writer ids.
+  static std::map<std::string, std::string> readShuffleFiles(
+      const std::string& rootPath) {
+    auto fileSystem = velox::filesystems::getFileSystem(rootPath, nullptr);
+    std::map<std::string, std::string> contents;
+    for (auto& file : fileSystem->list(rootPath)) {
+      auto readFile = fileSystem->openFileForRead(file);
+      const auto nameEnd = file.rfind('_');
+      contents[file.substr(rootPath.size(), nameEnd - rootPath.size())] =
+          readFile->pread(0, readFile->size());
+    }
+    return contents;
+  }
+
+  // Returns the rows and bytes of each partition summed over the manifests
+  // in 'rootPath'.
+  static std::map<std::string, std::pair<uint64_t, uint64_t>>
+  readManifestPartitionSizes(const std::string& rootPath) {
+    auto fileSystem = velox::filesystems::getFileSystem(rootPath, nullptr);
+    std::map<std::string, std::pair<uint64_t, uint64_t>> sizes;
+    for (auto& file : fileSystem->list(rootPath)) {
+      if (file.find("_manifest_") == std::string::npos) {
+        continue;
+      }
+      auto readFile = fileSystem->openFileForRead(file);
+      const auto manifest =
+          nlohmann::json::parse(readFile->pread(0, readFile->size()));
+      for (const auto& [partitionId, rows] : manifest["rows"].items()) {
+        sizes[partitionId].first += rows.get<uint64_t>();
+      }
+      for (const auto& [partitionId, ranges] : manifest["blocks"].items()) {
+        for (size_t i = 1; i < ranges.size(); i += 2) {
+          sizes[partitionId].second += ranges[i].get<uint64_t>();
+        }
+      }
+    }
+    return sizes;
+  }
+
   void cleanupDirectory(const std::string& rootPath) {
     auto fileSystem = velox::filesystems::getFileSystem(rootPath, nullptr);
     auto files = fileSystem->list(rootPath);
@@ -563,6 +665,203 @@ TEST_F(UnsafeRowShuffleTest, endToEnd) {
   TestShuffleWriter::reset();
 }
 
+TEST_F(UnsafeRowShuffleTest, endToEndPrestoFormat) {
+  size_t numPartitions = 5;
+  size_t numMapDrivers = 2;
+
+  auto data = vectorMaker_.rowVector({
+      makeFlatVector<int32_t>({1, 2, 3, 4, 5, 6}),
+      makeFlatVector<int64_t>({10, 20, 30, 40, 50, 60}),
+      makeNullableFlatVector<std::string>(
+          {"a", std::nullopt, "ccc", "dd", std::nullopt, "ffffff"}),
+  });
+
+  velox::exec::ExchangeSource::factories().clear();
+  const std::string kShuffleInfo =
+      fmt::format(kTestShuffleInfoFormat, numPartitions, 1 << 20);
+  TestShuffleWriter::createWriter(kShuffleInfo, pool());
+  registerExchangeSource(std::string(TestShuffleFactory::kShuffleName));
+  runShuffleTest(
+      std::string(TestShuffleFactory::kShuffleName),
+      kShuffleInfo,
+      kShuffleInfo,
+      numPartitions,
+      numMapDrivers,
+      {data},
+      ShuffleSerdeFormat::kPresto);
+  TestShuffleWriter::reset();
+}
+
+TEST_F(UnsafeRowShuffleTest, endToEndMultipleBatches) {
+  // The output vectors of PartitionAndSerialize are reused across the batches
+  // once ShuffleWrite has consumed them.
+  size_t numPartitions = 3;
+  size_t numMapDrivers = 1;
+
+  std::vector<std::string> strings;
+  for (auto i = 0; i < 25; ++i) {
+    strings.push_back(std::string(i, 'x'));
+  }
+  std::vector<RowVectorPtr> data;
+  for (auto i = 0; i < 5; ++i) {
+    data.push_back(vectorMaker_.rowVector({
+        makeFlatVector<int32_t>(100, [i](auto row) { return row + i; }),
+        makeFlatVector<StringView>(
+            100,
+            [&, i](auto row) { return StringView(strings[row % 20 + i]); }),
+    }));
+  }
+
+  for (auto serdeFormat :
+       {ShuffleSerdeFormat::kUnsafeRow, ShuffleSerdeFormat::kPresto}) {
+    SCOPED_TRACE(shuffleSerdeFormatName(serdeFormat));
+    velox::exec::ExchangeSource::factories().clear();
+    const std::string kShuffleInfo =
+        fmt::format(kTestShuffleInfoFormat, numPartitions, 1 << 20);
+    TestShuffleWriter::createWriter(kShuffleInfo, pool());
+    registerExchangeSource(std::string(TestShuffleFactory::kShuffleName));
+    runShuffleTest(
+        std::string(TestShuffleFactory::kShuffleName),
+        kShuffleInfo,
+        kShuffleInfo,
+        numPartitions,
+        numMapDrivers,
+        data,
+        serdeFormat);
+    TestShuffleWriter::reset();
+  }
+}
+
+TEST_F(UnsafeRowShuffleTest, endToEndFusedWrite) {
+  // The test shuffle writer doesn't reserve space, so the rows are collected.
+  size_t numPartitions = 3;
+  size_t numMapDrivers = 1;
+
+  auto data = vectorMaker_.rowVector({
+      makeFlatVector<int32_t>({1, 2, 3, 4, 5, 6}),
+      makeNullableFlatVector<std::string>(
+          {"a", std::nullopt, "ccc", "dd", std::nullopt, "ffffff"}),
+  });
+
+  for (auto serdeFormat :
+       {ShuffleSerdeFormat::kUnsafeRow, ShuffleSerdeFormat::kPresto}) {
+    SCOPED_TRACE(shuffleSerdeFormatName(serdeFormat));
+    velox::exec::ExchangeSource::factories().clear();
+    const std::string kShuffleInfo =
+        fmt::format(kTestShuffleInfoFormat, numPartitions, 1 << 20);
+    TestShuffleWriter::createWriter(kShuffleInfo, pool());
+    registerExchangeSource(std::string(TestShuffleFactory::kShuffleName));
+    runShuffleTest(
+        std::string(TestShuffleFactory::kShuffleName),
+        kShuffleInfo,
+        kShuffleInfo,
+        numPartitions,
+        numMapDrivers,
+        {data},
+        serdeFormat,
+        true);
+    TestShuffleWriter::reset();
+  }
+}
+
+TEST_F(UnsafeRowShuffleTest, persistentShuffleFusedWrite) {
+  // The rows are serialized into the blocks of the local persistent shuffle
+  // writer of each driver.
+  velox::filesystems::registerLocalFileSystem();
+  exec::Operator::registerOperator(
+      std::make_unique<PartitionAndSerializeTranslator>());
+  exec::Operator::registerOperator(std::make_unique<ShuffleWriteTranslator>());
+  const uint32_t numPartitions = 4;
+  const uint32_t numMapDrivers = 2;
+  const auto shuffleName =
+      std::string(LocalPersistentShuffleFactory::kShuffleName);
+
+  std::vector<RowVectorPtr> fixedWidthData;
+  std::vector<RowVectorPtr> variableWidthData;
+  for (auto i = 0; i < 3; ++i) {
+    fixedWidthData.push_back(vectorMaker_.rowVector({
+        makeFlatVector<int32_t>(100, [i](auto row) { return row * 3 + i; }),
+        makeFlatVector<int64_t>(
+            100, [](auto row) { return row; }, nullEvery(7)),
+        makeFlatVector<double>(100, [](auto row) { return row * 0.5; }),
+    }));
+    variableWidthData.push_back(vectorMaker_.rowVector({
+        makeFlatVector<int32_t>(100, [i](auto row) { return row * 3 + i; }),
+        makeFlatVector<std::string>(
+            100,
+            [](auto row) { return std::string(row % 17, 'a' + row % 26); },
+            nullEvery(5)),
+    }));
+  }
+
+  // Writes 'data' to the shuffle in 'rootPath' with or without a separate
+  // shuffle write.
+  auto write = [&](const std::vector<RowVectorPtr>& data,
+                   const std::string& rootPath,
+                   bool fused) {
+    const auto writeInfo =
+        fmt::format(kLocalShuffleWriteInfoFormat, rootPath, numPartitions);
+    auto plan = fused
+        ? exec::test::PlanBuilder()
+              .values(data, true)
+              .addNode(addPartitionAndSerializeNode(
+                  numPartitions,
+                  ShuffleSerdeFormat::kUnsafeRow,
+                  shuffleName,
+                  writeInfo))
+              .planNode()
+        : exec::test::PlanBuilder()
+              .values(data, true)
+              .addNode(addPartitionAndSerializeNode(numPartitions))
+              .localPartition({})
+              .addNode(addShuffleWriteNode(shuffleName, writeInfo))
+              .planNode();
+    auto task = makeTask(makeTaskId("leaf", 0), plan, 0);
+    exec::Task::start(task, numMapDrivers);
+    ASSERT_TRUE(exec::test::waitForTaskCompletion(task.get(), 3'000'000));
+  };
+
+  // Returns the sorted size prefixed rows of 'partition' in 'rootPath'.
+  auto readRows = [&](const std::string& rootPath, uint32_t partition) {
+    LocalPersistentShuffleReader reader(
+        rootPath,
+        "query_id",
+        {fmt::format("shuffle_0_0_{}", partition)},
+        partition,
+        pool());
+    std::vector<std::string> rows;
+    while (reader.hasNext()) {
+      auto buffer = reader.next(true);
+      const auto* data = buffer->as<char>();
+      size_t offset = 0;
+      while (offset < buffer->size()) {
+        const auto size =
+            sizeof(size_t) + *reinterpret_cast<const size_t*>(data + offset);
+        rows.emplace_back(data + offset, size);
+        offset += size;
+      }
+      EXPECT_EQ(offset, buffer->size());
+    }
+    std::sort(rows.begin(), rows.end());
+    return rows;
+  };
+
+  for (const auto& data : {fixedWidthData, variableWidthData}) {
+    auto fusedDirectory = velox::exec::test::TempDirectoryPath::create();
+    auto expectedDirectory = velox::exec::test::TempDirectoryPath::create();
+    write(data, fusedDirectory->path, true);
+    write(data, expectedDirectory->path, false);
+    size_t numRows = 0;
+    for (auto partition = 0; partition < numPartitions; ++partition) {
+      const auto rows = readRows(fusedDirectory->path, partition);
+      EXPECT_EQ(rows, readRows(expectedDirectory->path, partition));
+      numRows += rows.size();
+    }
+    // Each driver writes all the input.
+    EXPECT_EQ(numRows, 3 * 100 * numMapDrivers);
+  }
+}
+
 TEST_F(UnsafeRowShuffleTest, persistentShuffleDeser) {
   std::string serializedWriteInfo =
       "{\n"
@@ -663,6 +962,75 @@ TEST_F(UnsafeRowShuffleTest, persistentShuffle) {
   cleanupDirectory(rootPath);
 }
 
+TEST_F(UnsafeRowShuffleTest, persistentShuffleMergeSortedRuns) {
+  exec::Operator::registerOperator(
+      std::make_unique<PartitionAndSerializeTranslator>());
+  exec::Operator::registerOperator(std::make_unique<ShuffleWriteTranslator>());
+  exec::Operator::registerOperator(std::make_unique<ShuffleReadTranslator>());
+  velox::filesystems::registerLocalFileSystem();
+  auto rootDirectory = velox::exec::test::TempDirectoryPath::create();
+  const auto rootPath = rootDirectory->path;
+  const std::string shuffleName(LocalPersistentShuffleFactory::kShuffleName);
+  const std::string writeInfo =
+      fmt::format(kLocalShuffleWriteInfoFormat, rootPath, 1);
+  const std::string readInfo =
+      fmt::format(kLocalShuffleReadInfoFormat, rootPath, 1);
+
+  // Two writers write interleaved sorted runs of the single partition.
+  constexpr int32_t kRunSize = 1'000;
+  for (int32_t run = 0; run < 2; ++run) {
+    auto data = makeRowVector({makeFlatVector<int32_t>(
+        kRunSize, [run](auto row) { return 2 * row + run; })});
+    auto plan = exec::test::PlanBuilder()
+                    .values({data})
+                    .addNode(addPartitionAndSerializeNode(1))
+                    .addNode(addShuffleWriteNode(shuffleName, writeInfo))
+                    .planNode();
+    auto task = makeTask(makeTaskId("leaf", run), plan, 0);
+    exec::Task::start(task, 1);
+    ASSERT_TRUE(exec::test::waitForTaskCompletion(task.get(), 3'000'000));
+  }
+  auto reader = std::dynamic_pointer_cast<LocalPersistentShuffleReader>(
+      ShuffleInterfaceFactory::factory(shuffleName)
+          ->createReader(readInfo, 0, pool()));
+  ASSERT_EQ(reader->runFiles().size(), 2);
+
+  auto rowType = ROW({"c0"}, {INTEGER()});
+  exec::test::CursorParameters params;
+  params.planNode = std::make_shared<ShuffleReadNode>(
+      "0",
+      rowType,
+      ShuffleSerdeFormat::kUnsafeRow,
+      std::vector<core::FieldAccessTypedExprPtr>{
+          std::make_shared<core::FieldAccessTypedExpr>(INTEGER(), "c0")},
+      std::vector<core::SortOrder>{core::SortOrder(true, true)},
+      shuffleName);
+  params.destination = 0;
+  bool noMoreSplits = false;
+  auto [taskCursor, results] = readCursor(params, [&](auto* task) {
+    if (noMoreSplits) {
+      return;
+    }
+    addRemoteSplits(task, {makeTaskId("read", 0, readInfo)});
+    noMoreSplits = true;
+  });
+
+  // The runs are merged in order.
+  std::vector<int32_t> values;
+  for (const auto& resultVector : results) {
+    auto result = copyResultVector(resultVector);
+    auto* column = result->childAt(0)->as<SimpleVector<int32_t>>();
+    for (vector_size_t i = 0; i < result->size(); ++i) {
+      values.push_back(column->valueAt(i));
+    }
+  }
+  ASSERT_EQ(values.size(), 2 * kRunSize);
+  for (int32_t i = 0; i < values.size(); ++i) {
+    ASSERT_EQ(values[i], i);
+  }
+  cleanupDirectory(rootPath);
+}
+
 TEST_F(UnsafeRowShuffleTest, persistentShuffleFuzz) {
   // For unit testing, these numbers are set to relatively small values.
   // For stress testing, the following parameters and the fuzzer vector,
@@ -741,6 +1109,678 @@ TEST_F(UnsafeRowShuffleTest, persistentShuffleFuzz) {
   }
 }
 
+TEST_F(UnsafeRowShuffleTest, persistentShuffleBatchCollect) {
+  velox::filesystems::registerLocalFileSystem();
+  const uint32_t numPartitions = 3;
+  const uint64_t maxBytesPerPartition = 64;
+
+  std::vector<int32_t> partitions;
+  std::vector<std::string> rows;
+  for (auto i = 0; i < 100; ++i) {
+    partitions.push_back((i * 7) % numPartitions);
+    rows.push_back(std::string(1 + i % 13, 'a' + i % 26));
+  }
+  std::vector<StringView> rowViews;
+  for (const auto& row : rows) {
+    rowViews.push_back(StringView(row));
+  }
+
+  // Writes the rows one at a time.
+  auto rowDirectory = velox::exec::test::TempDirectoryPath::create();
+  {
+    LocalPersistentShuffleWriter writer(
+        rowDirectory->path,
+        "query_id",
+        0,
+        numPartitions,
+        maxBytesPerPartition,
+        pool());
+    for (auto i = 0; i < rows.size(); ++i) {
+      writer.collect(partitions[i], rows[i]);
+    }
+    writer.noMoreData(true);
+  }
+
+  // Writes the same rows in batches.
+  auto batchDirectory = velox::exec::test::TempDirectoryPath::create();
+  {
+    LocalPersistentShuffleWriter writer(
+        batchDirectory->path,
+        "query_id",
+        0,
+        numPartitions,
+        maxBytesPerPartition,
+        pool());
+    for (auto begin = 0; begin < rows.size(); begin += 30) {
+      const auto size = std::min<size_t>(30, rows.size() - begin);
+      writer.collect(
+          folly::Range(partitions.data() + begin, size),
+          folly::Range(rowViews.data() + begin, size));
+    }
+    writer.noMoreData(true);
+  }
+
+  auto rowFiles = readShuffleFiles(rowDirectory->path);
+  // A data file and its manifest.
+  ASSERT_EQ(rowFiles.size(), 2);
+  ASSERT_EQ(rowFiles, readShuffleFiles(batchDirectory->path));
+
+  // The reader finds the blocks of a partition from the manifest.
+  std::string expected;
+  for (auto i = 0; i < rows.size(); ++i) {
+    if (partitions[i] == 1) {
+      expected += rows[i];
+    }
+  }
+  LocalPersistentShuffleReader reader(
+      batchDirectory->path, "query_id", {"shuffle_0_0_1"}, 1, pool());
+  std::string actual;
+  while (reader.hasNext()) {
+    auto buffer = reader.next(true);
+    actual.append(buffer->as<char>(), buffer->size());
+  }
+  ASSERT_EQ(expected, actual);
+}
+
+TEST_F(UnsafeRowShuffleTest, persistentShuffleManifests) {
+  velox::filesystems::registerLocalFileSystem();
+  const uint32_t numPartitions = 4;
+  auto rootDirectory = velox::exec::test::TempDirectoryPath::create();
+
+  // Two writers, each writes a few blocks to partitions 0 and 2 only.
+  std::vector<std::string> expected(numPartitions);
+  for (auto writerIndex = 0; writerIndex < 2; ++writerIndex) {
+    LocalPersistentShuffleWriter writer(
+        rootDirectory->path, "query_id", 0, numPartitions, 16, pool());
+    for (auto i = 0; i < 20; ++i) {
+      const auto partition = (i % 2) * 2;
+      const auto row = fmt::format("{}-{}.", writerIndex, i);
+      writer.collect(partition, row);
+      expected[partition] += row;
+    }
+    writer.noMoreData(true);
+  }
+
+  auto sortedRows = [](const std::string& data) {
+    std::vector<std::string> rows;
+    folly::split('.', data, rows, true);
+    std::sort(rows.begin(), rows.end());
+    return rows;
+  };
+  // Returns the sorted rows read for 'partitionIds'.
+  auto read = [&](const std::vector<std::string>& partitionIds) {
+    LocalPersistentShuffleReader reader(
+        rootDirectory->path, "query_id", partitionIds, 0, pool());
+    std::string data;
+    while (reader.hasNext()) {
+      auto buffer = reader.next(true);
+      data.append(buffer->as<char>(), buffer->size());
+    }
+    return sortedRows(data);
+  };
+
+  EXPECT_EQ(read({"shuffle_0_0_0"}), sortedRows(expected[0]));
+  EXPECT_TRUE(read({"shuffle_0_0_1"}).empty());
+  EXPECT_EQ(
+      read({"shuffle_0_0_0", "shuffle_0_0_2"}),
+      sortedRows(expected[0] + expected[2]));
+  // The blocks of another shuffle are not read.
+  EXPECT_TRUE(read({"shuffle_1_0_0"}).empty());
+}
+
+TEST_F(UnsafeRowShuffleTest, persistentShuffleAsyncWrite) {
+  velox::filesystems::registerLocalFileSystem();
+  const uint32_t numPartitions = 3;
+  const uint64_t maxBytesPerPartition = 64;
+
+  std::vector<int32_t> partitions;
+  std::vector<std::string> rows;
+  for (auto i = 0; i < 200; ++i) {
+    partitions.push_back((i * 7) % numPartitions);
+    rows.push_back(std::string(1 + i % 13, 'a' + i % 26));
+  }
+
+  auto syncDirectory = velox::exec::test::TempDirectoryPath::create();
+  {
+    LocalPersistentShuffleWriter writer(
+        syncDirectory->path,
+        "query_id",
+        0,
+        numPartitions,
+        maxBytesPerPartition,
+        pool());
+    for (auto i = 0; i < rows.size(); ++i) {
+      writer.collect(partitions[i], rows[i]);
+    }
+    writer.noMoreData(true);
+    ContinueFuture future;
+    ASSERT_FALSE(writer.isBlocked(&future));
+  }
+
+  // Writes the blocks in the background with at most 2 blocks in flight.
+  folly::IOThreadPoolExecutor executor(2);
+  auto asyncDirectory = velox::exec::test::TempDirectoryPath::create();
+  {
+    LocalPersistentShuffleWriter writer(
+        asyncDirectory->path,
+        "query_id",
+        0,
+        numPartitions,
+        maxBytesPerPartition,
+        pool(),
+        &executor,
+        2 * maxBytesPerPartition);
+    for (auto i = 0; i < rows.size(); ++i) {
+      ContinueFuture future;
+      if (writer.isBlocked(&future)) {
+        future.wait();
+      }
+      writer.collect(partitions[i], rows[i]);
+    }
+    writer.noMoreData(true);
+    // Checking for pending writes does not count as a blocked write.
+    const auto numBlockedWrites =
+        writer.stats().at("shuffleBlockedWrites").value;
+    for (auto i = 0; i < 10; ++i) {
+      writer.hasPendingWrites();
+    }
+    ASSERT_EQ(
+        writer.stats().at("shuffleBlockedWrites").value, numBlockedWrites);
+    ContinueFuture future;
+    while (writer.isBlocked(&future)) {
+      future.wait();
+    }
+    ASSERT_FALSE(writer.hasPendingWrites());
+  }
+
+  auto syncFiles = readShuffleFiles(syncDirectory->path);
+  ASSERT_EQ(syncFiles.size(), 2);
+  ASSERT_EQ(syncFiles, readShuffleFiles(asyncDirectory->path));
+}
+
+TEST_F(UnsafeRowShuffleTest, persistentShuffleReadAhead) {
+  velox::filesystems::registerLocalFileSystem();
+  const uint32_t numPartitions = 3;
+  auto rootDirectory = velox::exec::test::TempDirectoryPath::create();
+  {
+    LocalPersistentShuffleWriter writer(
+        rootDirectory->path, "query_id", 0, numPartitions, 64, pool());
+    for (auto i = 0; i < 300; ++i) {
+      writer.collect(
+          (i * 7) % numPartitions, std::string(1 + i % 13, 'a' + i % 26));
+    }
+    writer.noMoreData(true);
+  }
+
+  folly::IOThreadPoolExecutor executor(2);
+  // Returns the blocks of partition 1.
+  auto readBlocks = [&](folly::Executor* readExecutor, bool useMmap) {
+    LocalPersistentShuffleReader reader(
+        rootDirectory->path,
+        "query_id",
+        {"shuffle_0_0_1"},
+        1,
+        pool(),
+        readExecutor,
+        3,
+        128,
+        useMmap);
+    std::vector<std::string> blocks;
+    while (reader.hasNext()) {
+      auto buffer = reader.next(true);
+      blocks.emplace_back(buffer->as<char>(), buffer->size());
+    }
+    return blocks;
+  };
+
+  const auto expected = readBlocks(nullptr, false);
+  ASSERT_GT(expected.size(), 3);
+  EXPECT_EQ(readBlocks(&executor, false), expected);
+  EXPECT_EQ(readBlocks(nullptr, true), expected);
+  EXPECT_EQ(readBlocks(&executor, true), expected);
+
+  // The prefetched blocks are dropped on failure and read again.
+  LocalPersistentShuffleReader reader(
+      rootDirectory->path,
+      "query_id",
+      {"shuffle_0_0_1"},
+      1,
+      pool(),
+      &executor,
+      3,
+      128);
+  ASSERT_TRUE(reader.hasNext());
+  reader.next(true);
+  reader.next(true);
+  auto buffer = reader.next(false);
+  EXPECT_EQ(std::string(buffer->as<char>(), buffer->size()), expected[0]);
+}
+
+TEST_F(UnsafeRowShuffleTest, persistentShuffleStats) {
+  velox::filesystems::registerLocalFileSystem();
+  const uint32_t numPartitions = 2;
+  auto rootDirectory = velox::exec::test::TempDirectoryPath::create();
+  LocalPersistentShuffleWriter writer(
+      rootDirectory->path, "query_id", 0, numPartitions, 64, pool());
+  for (auto i = 0; i < 100; ++i) {
+    writer.collect(i % numPartitions, std::string(10, 'a'));
+  }
+  writer.noMoreData(true);
+
+  const auto writeStats = writer.stats();
+  const auto writtenBytes = writeStats.at("shuffleWrittenBytes");
+  EXPECT_EQ(writtenBytes.unit, velox::RuntimeCounter::Unit::kBytes);
+  EXPECT_GE(writtenBytes.value, 100 * 10);
+  EXPECT_GT(writeStats.at("shuffleWrittenBlocks").value, numPartitions);
+  // The data file and the manifest.
+  EXPECT_EQ(writeStats.at("shuffleCreatedFiles").value, 2);
+  EXPECT_EQ(writeStats.at("shuffleBlockedWrites").value, 0);
+
+  int64_t readBytes = 0;
+  int64_t numReadBlocks = 0;
+  for (auto partition = 0; partition < numPartitions; ++partition) {
+    LocalPersistentShuffleReader reader(
+        rootDirectory->path,
+        "query_id",
+        {fmt::format("shuffle_0_0_{}", partition)},
+        1,
+        pool());
+    while (reader.hasNext()) {
+      reader.next(true);
+    }
+    const auto readStats = reader.stats();
+    EXPECT_EQ(readStats.at("shuffleOpenedFiles").value, 1);
+    readBytes += readStats.at("shuffleReadBytes").value;
+    numReadBlocks += readStats.at("shuffleReadBlocks").value;
+  }
+  EXPECT_EQ(readBytes, writtenBytes.value);
+  EXPECT_EQ(numReadBlocks, writeStats.at("shuffleWrittenBlocks").value);
+}
+
+TEST_F(UnsafeRowShuffleTest, persistentShuffleMemoryStore) {
+  velox::filesystems::registerLocalFileSystem();
+  const uint32_t numPartitions = 2;
+  auto rootDirectory = velox::exec::test::TempDirectoryPath::create();
+  auto diskDirectory = velox::exec::test::TempDirectoryPath::create();
+  // Room for a few blocks only, so the others go to the data file.
+  auto memoryStore = std::make_shared<LocalShuffleMemoryStore>(600);
+  const auto writeRows = [&](LocalPersistentShuffleWriter& writer) {
+    for (auto i = 0; i < 100; ++i) {
+      writer.collect(i % numPartitions, std::string(10, 'a' + i % 26));
+    }
+    writer.noMoreData(true);
+  };
+  LocalPersistentShuffleWriter writer(
+      rootDirectory->path,
+      "query_id",
+      0,
+      numPartitions,
+      64,
+      pool(),
+      nullptr,
+      0,
+      "",
+      0,
+      memoryStore);
+  writeRows(writer);
+  LocalPersistentShuffleWriter diskWriter(
+      diskDirectory->path, "query_id", 0, numPartitions, 64, pool());
+  writeRows(diskWriter);
+
+  const auto writeStats = writer.stats();
+  EXPECT_GT(writeStats.at("shuffleMemoryBlocks").value, 0);
+  EXPECT_GT(writeStats.at("shuffleWrittenBlocks").value, 0);
+  EXPECT_EQ(
+      writeStats.at("shuffleMemoryBlocks").value +
+          writeStats.at("shuffleWrittenBlocks").value,
+      diskWriter.stats().at("shuffleWrittenBlocks").value);
+  EXPECT_GT(memoryStore->bytes(), 0);
+  EXPECT_LE(memoryStore->bytes(), 600);
+  // The kept blocks are allocated from the store.
+  EXPECT_GE(memoryStore->pool()->getCurrentBytes(), memoryStore->bytes());
+
+  const auto readPartition = [&](const std::string& path, int32_t partition) {
+    LocalPersistentShuffleReader reader(
+        path,
+        "query_id",
+        {fmt::format("shuffle_0_0_{}", partition)},
+        partition,
+        pool(),
+        nullptr,
+        0,
+        0,
+        false,
+        memoryStore);
+    std::string data;
+    while (reader.hasNext()) {
+      auto buffer = reader.next(true);
+      data.append(buffer->as<char>(), buffer->size());
+    }
+    return data;
+  };
+  for (auto partition = 0; partition < numPartitions; ++partition) {
+    EXPECT_EQ(
+        readPartition(rootDirectory->path, partition),
+        readPartition(diskDirectory->path, partition));
+  }
+
+  // The blocks are gone once the query context is destroyed.
+  LocalShuffleMemoryStore::releaseQuery("other_query_id");
+  EXPECT_GT(memoryStore->bytes(), 0);
+  LocalShuffleMemoryStore::releaseQuery("query_id");
+  EXPECT_EQ(memoryStore->bytes(), 0);
+  EXPECT_EQ(memoryStore->pool()->getCurrentBytes(), 0);
+  VELOX_ASSERT_THROW(
+      readPartition(rootDirectory->path, 0), "not found in memory");
+}
+
+TEST_F(UnsafeRowShuffleTest, persistentShuffleSharedListing) {
+  velox::filesystems::registerLocalFileSystem();
+  auto rootDirectory = velox::exec::test::TempDirectoryPath::create();
+  const auto readInfo =
+      fmt::format(kLocalShuffleReadInfoFormat, rootDirectory->path, 1);
+  auto* factory = ShuffleInterfaceFactory::factory(
+      std::string(LocalPersistentShuffleFactory::kShuffleName));
+  const auto writeBlock = [&]() {
+    auto writer = factory->createWriter(
+        fmt::format(kLocalShuffleWriteInfoFormat, rootDirectory->path, 1),
+        pool());
+    writer->collect(0, "abc");
+    writer->noMoreData(true);
+  };
+  const auto countBlocks = [](ShuffleReader& reader) {
+    int32_t numBlocks = 0;
+    while (reader.hasNext()) {
+      reader.next(true);
+      ++numBlocks;
+    }
+    return numBlocks;
+  };
+
+  writeBlock();
+  auto reader = factory->createReader(readInfo, 0, pool());
+  ASSERT_EQ(countBlocks(*reader), 1);
+
+  // The readers created while 'reader' is alive use its listing.
+  writeBlock();
+  auto otherReader = factory->createReader(readInfo, 0, pool());
+  ASSERT_EQ(countBlocks(*otherReader), 1);
+
+  // A reader created once they are gone lists the files again.
+  reader.reset();
+  otherReader.reset();
+  auto laterReader = factory->createReader(readInfo, 0, pool());
+  ASSERT_EQ(countBlocks(*laterReader), 2);
+}
+
+TEST_F(UnsafeRowShuffleTest, persistentShuffleMapAttempts) {
+  velox::filesystems::registerLocalFileSystem();
+  const uint32_t numPartitions = 2;
+  auto rootDirectory = velox::exec::test::TempDirectoryPath::create();
+  auto fileSystem =
+      velox::filesystems::getFileSystem(rootDirectory->path, nullptr);
+  // Writes 20 rows of 'row' with the attempt 'attemptId' of 'mapId'.
+  auto writeAttempt = [&](const std::string& mapId,
+                          uint32_t attemptId,
+                          const std::string& row,
+                          bool success) {
+    LocalPersistentShuffleWriter writer(
+        rootDirectory->path,
+        "query_id",
+        0,
+        numPartitions,
+        64,
+        pool(),
+        nullptr,
+        0,
+        mapId,
+        attemptId);
+    for (auto i = 0; i < 20; ++i) {
+      writer.collect(i % numPartitions, row);
+    }
+    writer.noMoreData(success);
+  };
+
+  writeAttempt("map_0", 1, "b.", true);
+  writeAttempt("map_0", 0, "a.", true);
+  // A failed attempt only deletes its own files.
+  writeAttempt("map_0", 2, "c.", false);
+  writeAttempt("", 0, "x.", true);
+  // Two drivers of the attempt 1 of 'map_1' write the shuffle, e.g. with
+  // shuffle.fuse-partition-and-write. Both are read.
+  writeAttempt("map_1", 1, "d.", true);
+  writeAttempt("map_1", 1, "e.", true);
+  writeAttempt("map_1", 2, "f.", true);
+  EXPECT_EQ(fileSystem->list(rootDirectory->path).size(), 12);
+
+  // Reads the lowest committed attempt of each map task and the writer which
+  // is not an attempt of a map task.
+  LocalPersistentShuffleReader reader(
+      rootDirectory->path, "query_id", {"shuffle_0_0_1"}, 1, pool());
+  std::string data;
+  while (reader.hasNext()) {
+    auto buffer = reader.next(true);
+    data.append(buffer->as<char>(), buffer->size());
+  }
+  std::sort(data.begin(), data.end());
+  EXPECT_EQ(
+      data,
+      std::string(40, '.') + std::string(10, 'a') + std::string(10, 'd') +
+          std::string(10, 'e') + std::string(10, 'x'));
+}
+
+TEST_F(UnsafeRowShuffleTest, persistentShuffleSkewedPartitionSplits) {
+  velox::filesystems::registerLocalFileSystem();
+  const uint32_t numPartitions = 3;
+  auto rootDirectory = velox::exec::test::TempDirectoryPath::create();
+
+  // Two writers, each writes 90% of the rows to partition 1.
+  std::vector<std::vector<std::string>> expected(numPartitions);
+  for (auto writerIndex = 0; writerIndex < 2; ++writerIndex) {
+    LocalPersistentShuffleWriter writer(
+        rootDirectory->path, "query_id", 0, numPartitions, 64, pool());
+    for (auto i = 0; i < 200; ++i) {
+      const auto partition = i % 10 == 0 ? (i / 10) % 2 * 2 : 1;
+      const auto row = fmt::format("{}-{}.", writerIndex, i);
+      writer.collect(partition, row);
+      expected[partition].push_back(row);
+    }
+    writer.noMoreData(true);
+  }
+
+  // The manifests give the driver the size of each partition to find the
+  // skewed ones with.
+  const auto sizes = readManifestPartitionSizes(rootDirectory->path);
+  ASSERT_EQ(sizes.size(), numPartitions);
+  uint64_t totalBytes = 0;
+  for (auto partition = 0; partition < numPartitions; ++partition) {
+    const auto& [rows, bytes] =
+        sizes.at(fmt::format("shuffle_0_0_{}", partition));
+    EXPECT_EQ(rows, expected[partition].size());
+    totalBytes += bytes;
+  }
+  const auto skewedBytes = sizes.at("shuffle_0_0_1").second;
+  EXPECT_GT(skewedBytes, totalBytes / 2);
+
+  // The splits read disjoint blocks which together make up the partition.
+  const uint32_t numSplits = 3;
+  std::vector<std::string> rows;
+  for (auto i = 0; i < numSplits; ++i) {
+    LocalPersistentShuffleReader reader(
+        rootDirectory->path,
+        "query_id",
+        {fmt::format("shuffle_0_0_1@{}/{}", i, numSplits)},
+        1,
+        pool());
+    std::string data;
+    while (reader.hasNext()) {
+      auto buffer = reader.next(true);
+      data.append(buffer->as<char>(), buffer->size());
+    }
+    EXPECT_FALSE(data.empty());
+    EXPECT_LT(data.size(), skewedBytes);
+    std::vector<std::string> splitRows;
+    folly::split('.', data, splitRows, true);
+    rows.insert(rows.end(), splitRows.begin(), splitRows.end());
+  }
+  auto expectedRows = expected[1];
+  for (auto& row : expectedRows) {
+    row.pop_back();
+  }
+  std::sort(rows.begin(), rows.end());
+  std::sort(expectedRows.begin(), expectedRows.end());
+  EXPECT_EQ(rows, expectedRows);
+
+  EXPECT_THROW(
+      LocalPersistentShuffleReader(
+          rootDirectory->path, "query_id", {"shuffle_0_0_1@4/4"}, 1, pool())
+          .hasNext(),
+      VeloxUserError);
+}
+
+TEST_F(UnsafeRowShuffleTest, exchangeSourceShards) {
+  velox::filesystems::registerLocalFileSystem();
+  auto rootDirectory = velox::exec::test::TempDirectoryPath::create();
+  std::vector<std::string> expected;
+  {
+    LocalPersistentShuffleWriter writer(
+        rootDirectory->path, "query_id", 0, 2, 16, pool());
+    for (auto i = 0; i < 100; ++i) {
+      const auto row = fmt::format("{}.", i);
+      writer.collect(i % 2, row);
+      expected.push_back(row);
+    }
+    writer.noMoreData(true);
+  }
+
+  // Returns the rows read by a source with a shard for each partition.
+  auto readRows = [&](folly::Executor* executor) {
+    auto queue = std::make_shared<exec::ExchangeQueue>(1 << 20);
+    queue->addSourceLocked();
+    queue->noMoreSources();
+    std::vector<std::shared_ptr<ShuffleReader>> shuffles;
+    for (const auto& partitionId : {"shuffle_0_0_0", "shuffle_0_0_1"}) {
+      shuffles.push_back(std::make_shared<LocalPersistentShuffleReader>(
+          rootDirectory->path,
+          "query_id",
+          std::vector<std::string>{partitionId},
+          0,
+          pool()));
+    }
+    auto source = std::make_shared<UnsafeRowExchangeSource>(
+        "task_id", 0, queue, std::move(shuffles), pool(), executor);
+
+    std::vector<std::string> rows;
+    for (;;) {
+      bool request;
+      {
+        std::lock_guard<std::mutex> l(queue->mutex());
+        request = source->shouldRequestLocked();
+      }
+      if (request) {
+        source->request();
+      }
+      bool atEnd;
+      ContinueFuture future;
+      std::unique_ptr<exec::SerializedPage> page;
+      {
+        std::lock_guard<std::mutex> l(queue->mutex());
+        page = queue->dequeueLocked(&atEnd, &future);
+      }
+      if (page != nullptr) {
+        ByteStream input;
+        page->prepareStreamForDeserialize(&input);
+        std::string data(page->size(), '\0');
+        input.readBytes(data.data(), data.size());
+        std::vector<std::string> pageRows;
+        folly::split('.', data, pageRows, true);
+        for (auto& row : pageRows) {
+          rows.push_back(row + ".");
+        }
+      } else if (atEnd) {
+        break;
+      } else {
+        future.wait();
+      }
+    }
+    std::sort(rows.begin(), rows.end());
+    return rows;
+  };
+
+  std::sort(expected.begin(), expected.end());
+  EXPECT_EQ(readRows(nullptr), expected);
+  folly::IOThreadPoolExecutor executor(2);
+  EXPECT_EQ(readRows(&executor), expected);
+}
+
+TEST_F(UnsafeRowShuffleTest, exchangeSourceAsyncReader) {
+  // Returns the blocks from the futures completed by the test.
+  class AsyncShuffleReader : public ShuffleReader {
+   public:
+    bool hasNext() override {
+      VELOX_UNREACHABLE();
+    }
+
+    BufferPtr next(bool /*success*/) override {
+      VELOX_UNREACHABLE();
+    }
+
+    folly::SemiFuture<BufferPtr> nextAsync(uint64_t maxBytes) override {
+      EXPECT_GT(maxBytes, 0);
+      auto [promise, future] = folly::makePromiseContract<BufferPtr>();
+      promise_ = std::move(promise);
+      return std::move(future);
+    }
+
+    void complete(BufferPtr buffer) {
+      promise_.setValue(std::move(buffer));
+    }
+
+   private:
+    folly::Promise<BufferPtr> promise_;
+  };
+
+  auto queue = std::make_shared<exec::ExchangeQueue>(1 << 20);
+  queue->addSourceLocked();
+  queue->noMoreSources();
+  auto reader = std::make_shared<AsyncShuffleReader>();
+  auto source = std::make_shared<UnsafeRowExchangeSource>(
+      "task_id", 0, queue, reader, pool());
+  auto dequeue = [&](bool& atEnd) {
+    ContinueFuture future;
+    std::lock_guard<std::mutex> l(queue->mutex());
+    return queue->dequeueLocked(&atEnd, &future);
+  };
+  auto shouldRequest = [&]() {
+    std::lock_guard<std::mutex> l(queue->mutex());
+    return source->shouldRequestLocked();
+  };
+
+  // The request returns while the block is in flight.
+  ASSERT_TRUE(shouldRequest());
+  source->request();
+  ASSERT_FALSE(shouldRequest());
+  bool atEnd;
+  ASSERT_EQ(dequeue(atEnd), nullptr);
+  ASSERT_FALSE(atEnd);
+
+  const std::string data = "block";
+  auto buffer = AlignedBuffer::allocate<char>(data.size(), pool());
+  ::memcpy(buffer->asMutable<char>(), data.data(), data.size());
+  reader->complete(buffer);
+  auto page = dequeue(atEnd);
+  ASSERT_NE(page, nullptr);
+  EXPECT_EQ(page->size(), data.size());
+
+  // A null block marks the end.
+  ASSERT_TRUE(shouldRequest());
+  source->request();
+  reader->complete(nullptr);
+  ASSERT_EQ(dequeue(atEnd), nullptr);
+  EXPECT_TRUE(atEnd);
+  EXPECT_FALSE(shouldRequest());
+}
+
 TEST_F(UnsafeRowShuffleTest, partitionAndSerializeOperator) {
   auto data = makeRowVector({
       makeFlatVector<int32_t>(1'000, [](auto row) { return row; }),
@@ -795,6 +1835,110 @@ TEST_F(UnsafeRowShuffleTest, partitionAndSerializeOperatorWhenSinglePartition) {
   }
 }
 
+TEST_F(UnsafeRowShuffleTest, partitionAndSerializeFixedWidthColumns) {
+  // All the columns are fixed width, some have nulls and some are not flat.
+  auto data = makeRowVector({
+      makeFlatVector<int32_t>(1'000, [](auto row) { return row; }),
+      makeFlatVector<bool>(
+          1'000, [](auto row) { return row % 3 == 0; }, nullEvery(7)),
+      makeFlatVector<int8_t>(1'000, [](auto row) { return row % 128; }),
+      makeFlatVector<int16_t>(
+          1'000, [](auto row) { return row * 3; }, nullEvery(5)),
+      makeFlatVector<int64_t>(1'000, [](auto row) { return row * 10; }),
+      makeFlatVector<float>(
+          1'000, [](auto row) { return row * 0.5; }, nullEvery(11)),
+      makeConstant<double>(1.25, 1'000),
+      wrapInDictionary(
+          makeIndicesInReverse(1'000),
+          1'000,
+          makeFlatVector<int64_t>(
+              1'000, [](auto row) { return row; }, nullEvery(3))),
+  });
+
+  auto plan = exec::test::PlanBuilder()
+                  .values({data}, true)
+                  .addNode(addPartitionAndSerializeNode(4))
+                  .planNode();
+
+  exec::test::CursorParameters params;
+  params.planNode = plan;
+  params.maxDrivers = 2;
+
+  auto [taskCursor, serializedResults] =
+      readCursor(params, [](auto /*task*/) {});
+  EXPECT_EQ(serializedResults.size(), 2);
+
+  for (auto& serializedResult : serializedResults) {
+    auto deserialized = deserialize(serializedResult, asRowType(data->type()));
+    velox::test::assertEqualVectors(data, deserialized);
+  }
+}
+
+TEST_F(UnsafeRowShuffleTest, partitionAndSerializeOperatorPrestoFormat) {
+  auto data = makeRowVector({
+      makeFlatVector<int32_t>(1'000, [](auto row) { return row; }),
+      makeFlatVector<int64_t>(1'000, [](auto row) { return row * 10; }),
+  });
+
+  auto plan =
+      exec::test::PlanBuilder()
+          .values({data}, true)
+          .addNode(addPartitionAndSerializeNode(4, ShuffleSerdeFormat::kPresto))
+          .planNode();
+
+  exec::test::CursorParameters params;
+  params.planNode = plan;
+  params.maxDrivers = 2;
+
+  auto [taskCursor, serializedResults] =
+      readCursor(params, [](auto /*task*/) {});
+  EXPECT_EQ(serializedResults.size(), 2);
+
+  for (auto& serializedResult : serializedResults) {
+    // There is a single page per partition.
+    ASSERT_EQ(serializedResult->size(), 4);
+    auto partitions = serializedResult->childAt(0)->as<FlatVector<int32_t>>();
+    for (auto i = 0; i < 4; ++i) {
+      EXPECT_EQ(partitions->valueAt(i), i);
+    }
+
+    auto pages = deserializePages(serializedResult, asRowType(data->type()));
+    velox::exec::test::assertEqualResults({data}, pages);
+  }
+}
+
+TEST_F(UnsafeRowShuffleTest, serializedSizeByFormat) {
+  // A wide table of mostly null columns. UnsafeRow spends a fixed width slot
+  // on each field of each row while the Presto format only stores the null
+  // flags and the non-null values of each column.
+  std::vector<VectorPtr> columns;
+  columns.push_back(
+      makeFlatVector<int32_t>(1'000, [](auto row) { return row; }));
+  for (auto i = 0; i < 20; ++i) {
+    columns.push_back(makeFlatVector<int64_t>(
+        1'000,
+        [](auto row) { return row; },
+        [i](auto row) { return (row + i) % 10 != 0; }));
+  }
+  auto data = makeRowVector(columns);
+
+  auto serialize = [&](ShuffleSerdeFormat serdeFormat) {
+    exec::test::CursorParameters params;
+    params.planNode =
+        exec::test::PlanBuilder()
+            .values({data})
+            .addNode(addPartitionAndSerializeNode(4, serdeFormat))
+            .planNode();
+    return readCursor(params, [](auto /*task*/) {}).second;
+  };
+
+  const auto unsafeRowBytes =
+      serializedBytes(serialize(ShuffleSerdeFormat::kUnsafeRow));
+  const auto prestoBytes =
+      serializedBytes(serialize(ShuffleSerdeFormat::kPresto));
+  EXPECT_LT(prestoBytes * 4, unsafeRowBytes);
+}
+
 TEST_F(UnsafeRowShuffleTest, shuffleWriterToString) {
   auto data = makeRowVector({
       makeFlatVector<int32_t>(1'000, [](auto row) { return row; }),
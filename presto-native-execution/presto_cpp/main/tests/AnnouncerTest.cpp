@@ -13,6 +13,7 @@
  */
 #include "presto_cpp/main/Announcer.h"
 #include <gtest/gtest.h>
+#include "presto_cpp/external/json/json.hpp"
 #include "presto_cpp/main/tests/HttpServerWrapper.h"
 
 using namespace facebook::presto;
@@ -32,21 +33,39 @@ struct PromiseHolder {
 };
 
 std::unique_ptr<facebook::presto::test::HttpServerWrapper> makeDiscoveryServer(
-    std::function<void()> onAnnouncement) {
+    std::function<void()> onAnnouncement,
+    std::function<void(const std::string&)> onUnannouncement = nullptr,
+    std::function<void(const std::string&)> onAnnouncementBody = nullptr) {
   auto httpServer = std::make_unique<http::HttpServer>(
       std::make_unique<http::HttpConfig>(folly::SocketAddress("127.0.0.1", 0)));
 
   httpServer->registerPut(
       R"(/v1/announcement/(.+))",
-      [onAnnouncement](
+      [onAnnouncement, onAnnouncementBody](
           proxygen::HTTPMessage* /*message*/,
-          const std::vector<std::unique_ptr<folly::IOBuf>>& /*body*/,
+          const std::vector<std::unique_ptr<folly::IOBuf>>& body,
           proxygen::ResponseHandler* downstream) mutable {
+        if (onAnnouncementBody) {
+          onAnnouncementBody(http::bodyToString(body));
+        }
         onAnnouncement();
         proxygen::ResponseBuilder(downstream)
             .status(http::kHttpAccepted, "Accepted")
             .sendWithEOM();
       });
+  httpServer->registerDelete(
+      R"(/v1/announcement/(.+))",
+      [onUnannouncement](
+          proxygen::HTTPMessage* message,
+          const std::vector<std::unique_ptr<folly::IOBuf>>& /*body*/,
+          proxygen::ResponseHandler* downstream) mutable {
+        if (onUnannouncement) {
+          onUnannouncement(message->getPath());
+        }
+        proxygen::ResponseBuilder(downstream)
+            .status(http::kHttpOk, "OK")
+            .sendWithEOM();
+      });
   return std::make_unique<facebook::presto::test::HttpServerWrapper>(
       std::move(httpServer));
 }
@@ -107,3 +126,121 @@ TEST(AnnouncerTest, basic) {
   ASSERT_GE(addressLookupCnt, 8);
   announcer.stop();
 }
+
+TEST(AnnouncerTest, unannounce) {
+  auto [promise, future] = folly::makePromiseContract<bool>();
+  auto onAnnouncement = [promiseHolder = std::make_shared<PromiseHolder<bool>>(
+                             std::move(promise))]() {
+    if (!promiseHolder->get().isFulfilled()) {
+      promiseHolder->get().setValue(true);
+    }
+  };
+  std::atomic_int announcementCnt(0);
+  std::string unannouncedPath;
+  auto discoveryServer = makeDiscoveryServer(
+      [&]() {
+        ++announcementCnt;
+        onAnnouncement();
+      },
+      [&](const std::string& path) { unannouncedPath = path; });
+  auto serverAddress = discoveryServer->start().get();
+
+  Announcer announcer(
+      "127.0.0.1",
+      false,
+      1234,
+      [&]() { return serverAddress; },
+      "testversion",
+      "testing",
+      "test-node",
+      "test-node-location",
+      {"hive", "tpch"},
+      100 /*milliseconds*/);
+
+  announcer.start();
+  ASSERT_TRUE(std::move(future).getTry().hasValue());
+  announcer.unannounce();
+  ASSERT_EQ(unannouncedPath, "/v1/announcement/test-node");
+
+  // No more announcements once unannounced.
+  const auto numAnnouncements = announcementCnt.load();
+  std::this_thread::sleep_for(std::chrono::milliseconds(300));
+  ASSERT_LE(announcementCnt, numAnnouncements + 1);
+
+  // A second call is a no-op.
+  unannouncedPath.clear();
+  announcer.unannounce();
+  ASSERT_TRUE(unannouncedPath.empty());
+  announcer.stop();
+}
+
+TEST(AnnouncerTest, properties) {
+  auto [promise, future] = folly::makePromiseContract<std::string>();
+  auto promiseHolder =
+      std::make_shared<PromiseHolder<std::string>>(std::move(promise));
+  std::atomic_int numAnnouncements(0);
+  auto discoveryServer = makeDiscoveryServer(
+      [&]() { ++numAnnouncements; },
+      nullptr,
+      [promiseHolder](const std::string& body) {
+        // Waits for an announcement with the changed properties.
+        if (body.find("\"running_tasks\":\"2\"") != std::string::npos &&
+            !promiseHolder->get().isFulfilled()) {
+          promiseHolder->get().setValue(body);
+        }
+      });
+  auto serverAddress = discoveryServer->start().get();
+
+  Announcer announcer(
+      "127.0.0.1",
+      false,
+      1234,
+      [&]() { return serverAddress; },
+      "testversion",
+      "testing",
+      "test-node",
+      "test-node-location",
+      {"hive", "tpch"},
+      50 /*milliseconds*/);
+  std::atomic_int numCalls(0);
+  announcer.setPropertiesSupplier([&]() {
+    return std::map<std::string, std::string>{
+        {"running_tasks", std::to_string(std::min(++numCalls, 2))}};
+  });
+  announcer.start();
+
+  auto body = nlohmann::json::parse(std::move(future).get());
+  const auto& properties = body["services"][0]["properties"];
+  ASSERT_EQ(properties["running_tasks"], "2");
+  ASSERT_EQ(properties["connectorIds"], "hive,tpch");
+  ASSERT_EQ(properties["http"], "http://127.0.0.1:1234");
+  announcer.stop();
+}
+
+TEST(AnnouncerTest, backoff) {
+  std::atomic_int addressLookupCnt(0);
+  Announcer announcer(
+      "127.0.0.1",
+      false,
+      1234,
+      [&]() -> folly::SocketAddress {
+        ++addressLookupCnt;
+        throw std::runtime_error("Server is down");
+      },
+      "testversion",
+      "testing",
+      "test-node",
+      "test-node-location",
+      {"hive", "tpch"},
+      10 /*milliseconds*/,
+      80 /*maxBackoffMs*/);
+
+  announcer.start();
+  std::this_thread::sleep_for(std::chrono::seconds(1));
+  announcer.stop();
+  // A fixed 10ms interval would retry about 100 times in a second, the
+  // backoff retries at least every 80ms and at most every 40ms after the
+  // first 3 failures.
+  ASSERT_GE(addressLookupCnt, 12);
+  ASSERT_LE(addressLookupCnt, 40);
+}
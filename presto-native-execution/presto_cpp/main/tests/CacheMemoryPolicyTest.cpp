@@ -0,0 +1,93 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/CacheMemoryPolicy.h"
+#include <gtest/gtest.h>
+#include <fstream>
+#include "presto_cpp/main/CacheWarmer.h"
+#include "velox/common/base/Exceptions.h"
+#include "velox/common/caching/AsyncDataCache.h"
+#include "velox/common/file/FileSystems.h"
+#include "velox/common/memory/MmapAllocator.h"
+#include "velox/exec/tests/utils/TempFilePath.h"
+
+using namespace facebook::presto;
+
+namespace {
+constexpr int64_t kGB = 1L << 30;
+}
+
+TEST(CacheMemoryPolicyTest, targetBytes) {
+  CacheMemoryPolicy policy(64 * kGB, 4 * kGB, 48 * kGB);
+  // The ceiling applies while the queries use little.
+  EXPECT_EQ(policy.targetBytes(), 48 * kGB);
+  EXPECT_EQ(policy.update(0), 48 * kGB);
+  EXPECT_EQ(policy.update(8 * kGB), 48 * kGB);
+
+  // The growth since the last update is expected again.
+  EXPECT_EQ(policy.update(20 * kGB), 64 * kGB - 32 * kGB);
+  // No growth, the demand is the current usage.
+  EXPECT_EQ(policy.update(20 * kGB), 44 * kGB);
+  // The cache keeps its floor under pressure.
+  EXPECT_EQ(policy.update(62 * kGB), 4 * kGB);
+  // Shrinking query usage gives the memory back to the cache.
+  EXPECT_EQ(policy.update(30 * kGB), 34 * kGB);
+}
+
+TEST(CacheMemoryPolicyTest, shrinkAsyncDataCache) {
+  using namespace facebook::velox;
+  filesystems::registerLocalFileSystem();
+  memory::MmapAllocator::Options options;
+  options.capacity = 256 << 20;
+  auto cache = std::make_shared<cache::AsyncDataCache>(
+      std::make_shared<memory::MmapAllocator>(options), options.capacity);
+  const auto cachedBytes = [&]() {
+    const auto stats = cache->refreshStats();
+    return stats.tinySize + stats.largeSize;
+  };
+  constexpr int64_t kFileSize = 64 << 20;
+  auto file = exec::test::TempFilePath::create();
+  {
+    std::ofstream out(file->path, std::ios::binary);
+    std::string data(kFileSize, 'x');
+    out.write(data.data(), data.size());
+  }
+  CacheWarmer warmer(cache.get(), 2, 64 << 20);
+  warmer.prefetch({{file->path, 0, 0}}).get();
+  const int64_t fullBytes = cachedBytes();
+  ASSERT_GE(fullBytes, kFileSize);
+
+  // Nothing is dropped under the target.
+  EXPECT_EQ(shrinkAsyncDataCache(*cache, fullBytes), 0);
+  EXPECT_EQ(cachedBytes(), fullBytes);
+
+  // Only the excess is dropped, not the whole cache.
+  const int64_t targetBytes = 32 << 20;
+  const auto droppedBytes = shrinkAsyncDataCache(*cache, targetBytes);
+  EXPECT_GT(droppedBytes, 0);
+  EXPECT_EQ(droppedBytes, fullBytes - cachedBytes());
+  EXPECT_LE(cachedBytes(), targetBytes);
+  EXPECT_GT(cachedBytes(), 0);
+
+  EXPECT_GT(shrinkAsyncDataCache(*cache, 0), 0);
+  EXPECT_EQ(cachedBytes(), 0);
+}
+
+TEST(CacheMemoryPolicyTest, invalidBounds) {
+  EXPECT_THROW(
+      CacheMemoryPolicy(64 * kGB, 8 * kGB, 4 * kGB),
+      facebook::velox::VeloxRuntimeError);
+  EXPECT_THROW(
+      CacheMemoryPolicy(4 * kGB, 8 * kGB, 16 * kGB),
+      facebook::velox::VeloxRuntimeError);
+}
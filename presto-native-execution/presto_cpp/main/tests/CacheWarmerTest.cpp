@@ -0,0 +1,130 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/CacheWarmer.h"
+#include <gtest/gtest.h>
+#include <fstream>
+#include "velox/common/base/Exceptions.h"
+#include "velox/common/caching/FileIds.h"
+#include "velox/common/file/FileSystems.h"
+#include "velox/common/memory/MmapAllocator.h"
+#include "velox/exec/tests/utils/TempFilePath.h"
+
+using namespace facebook::presto;
+using namespace facebook::velox;
+
+class CacheWarmerTest : public testing::Test {
+ protected:
+  static constexpr uint64_t kFileSize = 20 << 20;
+
+  void SetUp() override {
+    filesystems::registerLocalFileSystem();
+    memory::MmapAllocator::Options options;
+    options.capacity = 256 << 20;
+    cache_ = std::make_shared<cache::AsyncDataCache>(
+        std::make_shared<memory::MmapAllocator>(options), options.capacity);
+    file_ = exec::test::TempFilePath::create();
+    std::ofstream out(file_->path, std::ios::binary);
+    std::string data(kFileSize, 'x');
+    out.write(data.data(), data.size());
+  }
+
+  int64_t cachedBytes() {
+    const auto stats = cache_->refreshStats();
+    return stats.tinySize + stats.largeSize;
+  }
+
+  std::shared_ptr<cache::AsyncDataCache> cache_;
+  std::shared_ptr<exec::test::TempFilePath> file_;
+};
+
+TEST_F(CacheWarmerTest, parseRanges) {
+  auto ranges = CacheWarmer::parseRanges(R"({"files": [
+      {"path": "/a", "ranges": [{"offset": 0, "length": 100},
+                                {"offset": 1000, "length": 10}]},
+      {"path": "/b"}]})");
+  ASSERT_EQ(ranges.size(), 3);
+  EXPECT_EQ(ranges[0].path, "/a");
+  EXPECT_EQ(ranges[1].offset, 1000);
+  EXPECT_EQ(ranges[1].length, 10);
+  EXPECT_EQ(ranges[2].path, "/b");
+  EXPECT_EQ(ranges[2].length, 0);
+
+  EXPECT_THROW(CacheWarmer::parseRanges(R"({"paths": []})"), VeloxUserError);
+  EXPECT_THROW(
+      CacheWarmer::parseRanges(R"({"files": [
+          {"path": "/a", "ranges": [{"offset": 1, "length": 0}]}]})"),
+      VeloxUserError);
+}
+
+TEST_F(CacheWarmerTest, prefetch) {
+  CacheWarmer warmer(cache_.get(), 2, 64 << 20);
+  auto stats =
+      warmer.prefetch({{file_->path, 0, 0}, {file_->path, 0, 1 << 20}}).get();
+  // The whole file is loaded into one entry, which the second range finds.
+  EXPECT_EQ(stats.numLoaded, 1);
+  EXPECT_EQ(stats.numCached, 1);
+  EXPECT_EQ(stats.numFailed, 0);
+  EXPECT_EQ(stats.bytes, kFileSize);
+  EXPECT_GE(cachedBytes(), kFileSize);
+
+  // The entries are keyed by the offsets of the ranges, like the regions of
+  // the readers.
+  stats = warmer.prefetch({{file_->path, 1000, 100}}).get();
+  EXPECT_EQ(stats.numLoaded, 1);
+  const StringIdLease fileId(fileIds(), file_->path);
+  EXPECT_TRUE(cache_->exists({fileId.id(), 1000}));
+  EXPECT_FALSE(cache_->exists({fileId.id(), 8 << 20}));
+
+  stats = warmer.prefetch({{"/no/such/file", 0, 0}}).get();
+  EXPECT_EQ(stats.numFailed, 1);
+}
+
+TEST_F(CacheWarmerTest, pin) {
+  CacheWarmer warmer(cache_.get(), 2, 16 << 20);
+  auto stats = warmer
+                   .pin(
+                       "hot",
+                       {{file_->path, 0, 8 << 20},
+                        {file_->path, 8 << 20, 8 << 20},
+                        {file_->path, 16 << 20, 0}})
+                   .get();
+  EXPECT_EQ(stats.numLoaded, 3);
+  // The last range is past the pinned bytes limit.
+  EXPECT_EQ(warmer.pinnedBytes(), 16 << 20);
+  EXPECT_THROW(warmer.pin("hot", {}), VeloxUserError);
+
+  // The pinned entries survive clearing the cache.
+  cache_->clear();
+  EXPECT_GE(cachedBytes(), 16 << 20);
+
+  EXPECT_EQ(warmer.unpin("hot"), 16 << 20);
+  EXPECT_EQ(warmer.pinnedBytes(), 0);
+  cache_->clear();
+  EXPECT_EQ(cachedBytes(), 0);
+  EXPECT_THROW(warmer.unpin("hot"), VeloxUserError);
+}
+
+TEST_F(CacheWarmerTest, repinWhileLoading) {
+  CacheWarmer warmer(cache_.get(), 1, 64 << 20);
+  auto first = warmer.pin("hot", {{file_->path, 0, 8 << 20}});
+  // Unpinned and pinned again before or after the first load finished. The
+  // first load must not publish its pins into the second set.
+  warmer.unpin("hot");
+  auto second = warmer.pin("hot", {{file_->path, 8 << 20, 1 << 20}});
+  std::move(first).get();
+  std::move(second).get();
+  EXPECT_EQ(warmer.pinnedBytes(), 1 << 20);
+  EXPECT_EQ(warmer.unpin("hot"), 1 << 20);
+  EXPECT_EQ(warmer.pinnedBytes(), 0);
+}
@@ -0,0 +1,156 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <gtest/gtest.h>
+
+#include "presto_cpp/main/CompressedPagesCache.h"
+
+using namespace facebook::presto;
+using facebook::velox::common::CompressionKind;
+
+class CompressedPagesCacheTest : public ::testing::Test {
+ protected:
+  // Returns the compressed 'pages', which are "compressed" to the first byte
+  // of each page unless 'compressible_' is false.
+  std::unique_ptr<folly::IOBuf> getOrCompress(
+      CompressedPagesCache& cache,
+      const folly::IOBuf& pages,
+      CompressionKind codec = CompressionKind::CompressionKind_LZ4,
+      const std::string& taskId = "task") {
+    return cache.getOrCompress(taskId, pages, codec, [&]() {
+      ++numCompressions_;
+      if (!compressible_) {
+        return std::unique_ptr<folly::IOBuf>();
+      }
+      std::string compressed;
+      for (const auto& range : pages) {
+        compressed.push_back(range.empty() ? ' ' : range[0]);
+      }
+      return folly::IOBuf::copyBuffer(compressed);
+    });
+  }
+
+  // Returns two pages in one chain.
+  static std::unique_ptr<folly::IOBuf> makePages() {
+    auto pages = folly::IOBuf::copyBuffer("abcdefgh");
+    pages->appendChain(folly::IOBuf::copyBuffer("ijklmnop"));
+    return pages;
+  }
+
+  int32_t numCompressions_{0};
+  bool compressible_{true};
+};
+
+TEST_F(CompressedPagesCacheTest, sharesCompressedPages) {
+  CompressedPagesCache cache(1 << 20);
+  auto pages = makePages();
+
+  // The consumers get clones of the same pages. The first two compress them.
+  auto first = getOrCompress(cache, *pages->clone());
+  EXPECT_EQ(cache.size(), 0);
+  auto second = getOrCompress(cache, *pages->clone());
+  EXPECT_EQ(numCompressions_, 2);
+  EXPECT_EQ(cache.size(), 1);
+  EXPECT_EQ(cache.bytes(), 16 + 2);
+
+  auto third = getOrCompress(cache, *pages->clone());
+  auto fourth = getOrCompress(cache, *pages->clone());
+  EXPECT_EQ(numCompressions_, 2);
+  ASSERT_NE(third, nullptr);
+  EXPECT_EQ(third->data(), fourth->data());
+  EXPECT_EQ(
+      std::string(
+          reinterpret_cast<const char*>(third->data()), third->length()),
+      "ai");
+}
+
+TEST_F(CompressedPagesCacheTest, differentPages) {
+  CompressedPagesCache cache(1 << 20);
+  // The same contents in other memory, e.g. a partitioned buffer, and a
+  // prefix of the pages, e.g. for a consumer asking for less, are not shared.
+  auto pages = makePages();
+  auto prefix = folly::IOBuf::wrapBuffer(pages->data(), pages->length());
+  std::vector<std::unique_ptr<folly::IOBuf>> copies;
+  for (int32_t i = 0; i < 3; ++i) {
+    copies.push_back(makePages());
+    getOrCompress(cache, *copies.back());
+    getOrCompress(cache, *pages);
+    getOrCompress(cache, *prefix);
+    getOrCompress(cache, *pages, CompressionKind::CompressionKind_ZSTD);
+  }
+  // The pages compressed twice with a codec are cached.
+  EXPECT_EQ(numCompressions_, 3 + 2 + 2 + 2);
+  EXPECT_EQ(cache.size(), 3);
+}
+
+TEST_F(CompressedPagesCacheTest, uncompressiblePages) {
+  CompressedPagesCache cache(1 << 20);
+  compressible_ = false;
+  auto pages = makePages();
+  for (int32_t i = 0; i < 4; ++i) {
+    EXPECT_EQ(getOrCompress(cache, *pages), nullptr);
+  }
+  EXPECT_EQ(numCompressions_, 2);
+  EXPECT_EQ(cache.bytes(), 16);
+}
+
+TEST_F(CompressedPagesCacheTest, evictsLeastRecentlyUsed) {
+  CompressedPagesCache cache(40);
+  auto first = makePages();
+  auto second = makePages();
+  auto third = makePages();
+  for (auto* pages : {first.get(), first.get(), second.get(), second.get()}) {
+    getOrCompress(cache, *pages);
+  }
+  EXPECT_EQ(cache.size(), 2);
+  // Makes 'second' the least recently used.
+  getOrCompress(cache, *first);
+  getOrCompress(cache, *third);
+  getOrCompress(cache, *third);
+  EXPECT_EQ(cache.size(), 2);
+  EXPECT_EQ(cache.bytes(), 36);
+  EXPECT_EQ(numCompressions_, 6);
+
+  getOrCompress(cache, *first);
+  EXPECT_EQ(numCompressions_, 6);
+  getOrCompress(cache, *second);
+  EXPECT_EQ(numCompressions_, 7);
+}
+
+TEST_F(CompressedPagesCacheTest, removesTask) {
+  CompressedPagesCache cache(1 << 20);
+  auto first = makePages();
+  auto second = makePages();
+  for (int32_t i = 0; i < 2; ++i) {
+    getOrCompress(cache, *first, CompressionKind::CompressionKind_LZ4, "a");
+    getOrCompress(cache, *second, CompressionKind::CompressionKind_LZ4, "b");
+  }
+  EXPECT_EQ(cache.size(), 2);
+
+  // The pages of the deleted task are released, the others stay cached.
+  cache.removeTask("a");
+  EXPECT_EQ(cache.size(), 1);
+  EXPECT_EQ(cache.bytes(), 18);
+  getOrCompress(cache, *second, CompressionKind::CompressionKind_LZ4, "b");
+  EXPECT_EQ(numCompressions_, 4);
+}
+
+TEST_F(CompressedPagesCacheTest, disabled) {
+  CompressedPagesCache cache(0);
+  auto pages = makePages();
+  for (int32_t i = 0; i < 3; ++i) {
+    getOrCompress(cache, *pages);
+  }
+  EXPECT_EQ(numCompressions_, 3);
+  EXPECT_EQ(cache.size(), 0);
+}
@@ -0,0 +1,49 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/CpuProfiler.h"
+#include <gtest/gtest.h>
+#include "velox/common/base/Exceptions.h"
+
+using namespace facebook::presto;
+
+TEST(CpuProfilerTest, fold) {
+  EXPECT_EQ(
+      CpuProfiler::fold(
+          {{"read", "scan", "main"},
+           {"hash", "join", "main"},
+           {"read", "scan", "main"},
+           {}}),
+      "main;join;hash 1\nmain;scan;read 2\n");
+  EXPECT_EQ(CpuProfiler::fold({}), "");
+}
+
+TEST(CpuProfilerTest, profile) {
+#ifndef PRESTO_ENABLE_LIBUNWIND
+  GTEST_SKIP() << "CPU profiling needs libunwind";
+#endif
+  auto future = CpuProfiler::profileAsync(std::chrono::milliseconds(300), 997);
+  // Keeps a CPU busy while the profile runs.
+  volatile uint64_t sum{0};
+  while (!future.isReady()) {
+    for (int i = 0; i < 1'000; ++i) {
+      sum = sum + i;
+    }
+  }
+  const auto folded = std::move(future).get();
+  EXPECT_FALSE(folded.empty());
+
+  EXPECT_THROW(
+      CpuProfiler::profile(std::chrono::milliseconds(1), 0),
+      facebook::velox::VeloxUserError);
+}
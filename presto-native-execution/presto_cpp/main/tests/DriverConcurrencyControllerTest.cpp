@@ -0,0 +1,46 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/DriverConcurrencyController.h"
+#include <gtest/gtest.h>
+#include "velox/common/base/Exceptions.h"
+
+using namespace facebook::presto;
+
+TEST(DriverConcurrencyControllerTest, update) {
+  DriverConcurrencyController controller(2, 16);
+  EXPECT_EQ(controller.drivers(), 16);
+  // An idle node stays at the maximum.
+  EXPECT_EQ(controller.update(10), 16);
+
+  // A saturated node cuts the drivers by a quarter down to the minimum.
+  EXPECT_EQ(controller.update(95), 12);
+  EXPECT_EQ(controller.update(95), 9);
+  EXPECT_EQ(controller.update(75), 9);
+  EXPECT_EQ(controller.update(100), 7);
+  EXPECT_EQ(controller.update(100), 6);
+  EXPECT_EQ(controller.update(100), 5);
+  EXPECT_EQ(controller.update(100), 4);
+  EXPECT_EQ(controller.update(100), 3);
+  EXPECT_EQ(controller.update(100), 2);
+  EXPECT_EQ(controller.update(100), 2);
+
+  // The drivers grow back one at a time.
+  EXPECT_EQ(controller.update(30), 3);
+  EXPECT_EQ(controller.update(30), 4);
+
+  EXPECT_THROW(
+      DriverConcurrencyController(0, 16), facebook::velox::VeloxRuntimeError);
+  EXPECT_THROW(
+      DriverConcurrencyController(8, 4), facebook::velox::VeloxRuntimeError);
+}
@@ -0,0 +1,61 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/DriverWatchdog.h"
+#include <folly/executors/CPUThreadPoolExecutor.h>
+#include <folly/futures/Future.h>
+#include <gtest/gtest.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <thread>
+
+using namespace facebook::presto;
+
+TEST(DriverWatchdogTest, stuckDriver) {
+  folly::CPUThreadPoolExecutor threads(1);
+  auto executor = DriverWatchdog::wrap(&threads, "q1");
+  folly::Promise<folly::Unit> release;
+  auto released = release.getSemiFuture();
+  folly::Promise<folly::Unit> started;
+  auto running = started.getSemiFuture();
+  executor->add([&]() {
+    started.setValue();
+    std::move(released).wait();
+  });
+  std::move(running).wait();
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+  auto stuck = DriverWatchdog::stuckDrivers(std::chrono::milliseconds(20));
+  ASSERT_EQ(stuck.size(), 1);
+  EXPECT_EQ(stuck[0].queryId, "q1");
+  EXPECT_GE(stuck[0].onThreadMs, 20);
+  EXPECT_TRUE(
+      DriverWatchdog::stuckDrivers(std::chrono::seconds(60)).empty());
+
+  stuck[0].stack = DriverWatchdog::captureStack(stuck[0].threadId);
+#ifdef PRESTO_ENABLE_LIBUNWIND
+  EXPECT_FALSE(stuck[0].stack.empty());
+#endif
+  EXPECT_NE(stuck[0].toString().find("q1"), std::string::npos);
+
+  release.setValue();
+  threads.join();
+  EXPECT_TRUE(DriverWatchdog::stuckDrivers(std::chrono::milliseconds(0))
+                  .empty());
+}
+
+TEST(DriverWatchdogTest, exitedThread) {
+  int32_t threadId{0};
+  std::thread([&]() { threadId = syscall(SYS_gettid); }).join();
+  EXPECT_TRUE(DriverWatchdog::captureStack(threadId).empty());
+}
@@ -0,0 +1,66 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/ExchangeSpillFile.h"
+#include <gtest/gtest.h>
+#include <filesystem>
+#include "velox/common/base/tests/GTestUtils.h"
+#include "velox/exec/tests/utils/TempDirectoryPath.h"
+
+using namespace facebook::presto;
+using namespace facebook::velox;
+
+TEST(ExchangeSpillFileTest, writeAndRead) {
+  auto directory = exec::test::TempDirectoryPath::create();
+  ExchangeSpillFile file(directory->path);
+  EXPECT_TRUE(file.empty());
+  // The file is unlinked on creation.
+  EXPECT_TRUE(std::filesystem::is_empty(directory->path));
+
+  auto first = folly::IOBuf::copyBuffer("first page");
+  first->appendToChain(folly::IOBuf::copyBuffer(" and its tail"));
+  file.write(*first);
+  file.write(*folly::IOBuf::copyBuffer("second"));
+  EXPECT_FALSE(file.empty());
+  EXPECT_EQ(file.bytes(), 29);
+
+  std::string data(file.nextPageBytes(), '\0');
+  file.read(reinterpret_cast<uint8_t*>(data.data()));
+  EXPECT_EQ(data, "first page and its tail");
+  EXPECT_EQ(file.bytes(), 6);
+
+  file.write(*folly::IOBuf::copyBuffer("third"));
+  for (const auto* expected : {"second", "third"}) {
+    data.assign(file.nextPageBytes(), '\0');
+    file.read(reinterpret_cast<uint8_t*>(data.data()));
+    EXPECT_EQ(data, expected);
+  }
+  EXPECT_TRUE(file.empty());
+  EXPECT_EQ(file.bytes(), 0);
+
+  file.write(*folly::IOBuf::copyBuffer("skipped"));
+  file.write(*folly::IOBuf::copyBuffer("last"));
+  file.skip();
+  EXPECT_EQ(file.bytes(), 4);
+  data.assign(file.nextPageBytes(), '\0');
+  file.read(reinterpret_cast<uint8_t*>(data.data()));
+  EXPECT_EQ(data, "last");
+  EXPECT_TRUE(file.empty());
+}
+
+TEST(ExchangeSpillFileTest, missingDirectory) {
+  auto directory = exec::test::TempDirectoryPath::create();
+  VELOX_ASSERT_THROW(
+      ExchangeSpillFile(directory->path + "/missing"),
+      "Cannot create exchange spill file");
+}
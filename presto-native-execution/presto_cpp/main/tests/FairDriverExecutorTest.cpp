@@ -0,0 +1,66 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/FairDriverExecutor.h"
+#include <folly/synchronization/Baton.h>
+#include <gtest/gtest.h>
+#include <mutex>
+
+using namespace facebook::presto;
+
+TEST(FairDriverExecutorTest, level) {
+  EXPECT_EQ(FairDriverExecutor::level(0), 0);
+  EXPECT_EQ(FairDriverExecutor::level(999'999), 0);
+  EXPECT_EQ(FairDriverExecutor::level(1'000'000), 1);
+  EXPECT_EQ(FairDriverExecutor::level(59'000'000), 2);
+  EXPECT_EQ(FairDriverExecutor::level(3'600'000'000), 4);
+}
+
+TEST(FairDriverExecutorTest, roundRobin) {
+  std::mutex mutex;
+  std::vector<std::string> order;
+  auto record = [&](const std::string& name) {
+    std::lock_guard<std::mutex> l(mutex);
+    order.push_back(name);
+  };
+
+  // Declared after what its tasks use, so that its threads stop first.
+  FairDriverExecutor executor(1);
+  auto longQuery = executor.createQueryExecutor();
+  auto shortQuery = executor.createQueryExecutor();
+
+  // Blocks the only thread while the queries queue their tasks.
+  folly::Baton<> started;
+  folly::Baton<> release;
+  longQuery->add([&]() {
+    started.post();
+    release.wait();
+    record("long");
+  });
+  started.wait();
+  for (int i = 0; i < 10; ++i) {
+    longQuery->add([&]() { record("long"); });
+  }
+  folly::Baton<> done;
+  shortQuery->add([&]() {
+    record("short");
+    done.post();
+  });
+  release.post();
+  done.wait();
+
+  // The short query does not wait for the 10 tasks queued ahead of it.
+  std::lock_guard<std::mutex> l(mutex);
+  ASSERT_GE(order.size(), 3);
+  EXPECT_EQ(order[2], "short");
+}
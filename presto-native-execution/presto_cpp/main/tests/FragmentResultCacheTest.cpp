@@ -0,0 +1,278 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/FragmentResultCache.h"
+#include <gtest/gtest.h>
+#include "velox/connectors/hive/TableHandle.h"
+#include "velox/exec/tests/utils/OperatorTestBase.h"
+#include "velox/exec/tests/utils/PlanBuilder.h"
+
+using namespace facebook::presto;
+using namespace facebook::velox;
+
+class FragmentResultCacheTest : public exec::test::OperatorTestBase {
+ protected:
+  void SetUp() override {
+    exec::test::OperatorTestBase::SetUp();
+    exec::Operator::registerOperator(
+        std::make_unique<operators::FragmentResultTranslator>());
+    data_ = {
+        makeRowVector({
+            makeFlatVector<int64_t>(100, [](auto row) { return row; }),
+            makeFlatVector<StringView>(
+                100, [](auto row) { return StringView(row % 2 ? "a" : "b"); }),
+        }),
+        makeRowVector({
+            makeFlatVector<int64_t>(10, [](auto row) { return -row; }),
+            makeFlatVector<StringView>(
+                10, [](auto /*row*/) { return StringView("c"); }),
+        }),
+    };
+    rowType_ = asRowType(data_[0]->type());
+    createDuckDbTable(data_);
+  }
+
+  static protocol::ScheduledSplit makeSplit(
+      const std::string& path,
+      int64_t fileModifiedTime) {
+    auto hiveSplit = std::make_shared<protocol::HiveSplit>();
+    hiveSplit->fileSplit.path = path;
+    hiveSplit->fileSplit.length = 100;
+    hiveSplit->fileSplit.fileModifiedTime = fileModifiedTime;
+    protocol::ScheduledSplit split;
+    split.split.connectorSplit = hiveSplit;
+    return split;
+  }
+
+  static protocol::TaskSource makeSource(
+      std::vector<protocol::ScheduledSplit> splits,
+      bool noMoreSplits = true) {
+    protocol::TaskSource source;
+    source.planNodeId = "0";
+    source.splits = std::move(splits);
+    source.noMoreSplits = noMoreSplits;
+    return source;
+  }
+
+  core::PlanFragment makeScanFragment() {
+    return exec::test::PlanBuilder()
+        .tableScan(rowType_)
+        .partitionedOutput({"c0"}, 4)
+        .planFragment();
+  }
+
+  std::vector<RowVectorPtr> data_;
+  RowTypePtr rowType_;
+};
+
+TEST_F(FragmentResultCacheTest, makeKey) {
+  const auto fragment = makeScanFragment();
+  const auto key = FragmentResultCache::makeKey(
+      fragment, {makeSource({makeSplit("/a", 1), makeSplit("/b", 2)})});
+  ASSERT_TRUE(key.has_value());
+
+  // The order of the splits does not matter.
+  EXPECT_EQ(
+      key,
+      FragmentResultCache::makeKey(
+          fragment, {makeSource({makeSplit("/b", 2), makeSplit("/a", 1)})}));
+
+  // A modified file changes the key.
+  EXPECT_NE(
+      key,
+      FragmentResultCache::makeKey(
+          fragment, {makeSource({makeSplit("/a", 1), makeSplit("/b", 3)})}));
+
+  // More splits may come.
+  EXPECT_FALSE(FragmentResultCache::makeKey(
+                   fragment, {makeSource({makeSplit("/a", 1)}, false)})
+                   .has_value());
+  EXPECT_FALSE(FragmentResultCache::makeKey(fragment, {}).has_value());
+
+  // The modification time is needed to tell whether a file changed.
+  EXPECT_FALSE(
+      FragmentResultCache::makeKey(fragment, {makeSource({makeSplit("/a", 0)})})
+          .has_value());
+
+  // The fragments reading other leaves are not cached.
+  const auto valuesFragment = exec::test::PlanBuilder()
+                                  .values(data_)
+                                  .partitionedOutput({"c0"}, 4)
+                                  .planFragment();
+  EXPECT_FALSE(FragmentResultCache::makeKey(valuesFragment, {}).has_value());
+
+  // The session properties which change the results are in the key.
+  const std::vector<protocol::TaskSource> sources = {
+      makeSource({makeSplit("/a", 1)})};
+  EXPECT_NE(
+      FragmentResultCache::makeKey(fragment, sources, "session_timezone=UTC\n"),
+      FragmentResultCache::makeKey(
+          fragment, sources, "session_timezone=America/Los_Angeles\n"));
+}
+
+TEST_F(FragmentResultCacheTest, makeKeyOfNonDeterministicFragment) {
+  const std::vector<protocol::TaskSource> sources = {
+      makeSource({makeSplit("/a", 1)})};
+  // Returns the key of the scan projecting 'projections' of the rows passing
+  // 'filter'.
+  auto makeKey = [&](const std::string& filter,
+                     const std::vector<std::string>& projections) {
+    return FragmentResultCache::makeKey(
+        exec::test::PlanBuilder()
+            .tableScan(rowType_)
+            .filter(filter)
+            .project(projections)
+            .partitionedOutput({"c0"}, 4)
+            .planFragment(),
+        sources);
+  };
+
+  EXPECT_TRUE(makeKey("c0 < 50", {"c0", "c0 + 1"}).has_value());
+  // A different result may be computed from the same splits.
+  EXPECT_FALSE(makeKey("rand() < 0.5", {"c0", "c0 + 1"}).has_value());
+  EXPECT_FALSE(
+      makeKey("c0 < 50", {"c0", "c0 + cast(rand() * 10 as bigint)"})
+          .has_value());
+}
+
+TEST_F(FragmentResultCacheTest, makeKeyOfScanColumns) {
+  // Returns a fragment reading the column 'column' of the table as c0.
+  auto makeFragment = [](const std::string& column) {
+    return exec::test::PlanBuilder()
+        .addNode([&](auto id, auto /*source*/) {
+          std::unordered_map<
+              std::string,
+              std::shared_ptr<connector::ColumnHandle>>
+              assignments{
+                  {"c0",
+                   std::make_shared<connector::hive::HiveColumnHandle>(
+                       column,
+                       connector::hive::HiveColumnHandle::ColumnType::kRegular,
+                       BIGINT(),
+                       std::vector<common::Subfield>{})}};
+          return std::make_shared<core::TableScanNode>(
+              id,
+              ROW({"c0"}, {BIGINT()}),
+              std::make_shared<connector::hive::HiveTableHandle>(
+                  "hive",
+                  "t",
+                  true,
+                  connector::hive::SubfieldFilters{},
+                  nullptr),
+              assignments);
+        })
+        .partitionedOutput({"c0"}, 4)
+        .planFragment();
+  };
+  const std::vector<protocol::TaskSource> sources = {
+      makeSource({makeSplit("/a", 1)})};
+
+  const auto key = FragmentResultCache::makeKey(makeFragment("a"), sources);
+  ASSERT_TRUE(key.has_value());
+  EXPECT_EQ(key, FragmentResultCache::makeKey(makeFragment("a"), sources));
+  // The plan prints the same but reads another column.
+  EXPECT_NE(key, FragmentResultCache::makeKey(makeFragment("b"), sources));
+}
+
+TEST_F(FragmentResultCacheTest, evictsLeastRecentlyUsed) {
+  auto makePages = [](uint64_t bytes) {
+    auto pages = std::make_shared<operators::FragmentResultPages>();
+    pages->pages.push_back(std::string(bytes, 'x'));
+    pages->bytes = bytes;
+    return pages;
+  };
+  FragmentResultCache cache(1'000);
+  cache.put("a", makePages(400));
+  cache.put("b", makePages(400));
+  EXPECT_EQ(cache.size(), 2);
+  EXPECT_EQ(cache.bytes(), 802);
+  ASSERT_NE(cache.get("a"), nullptr);
+
+  // 'b' is the least recently used.
+  cache.put("c", makePages(400));
+  EXPECT_EQ(cache.size(), 2);
+  EXPECT_EQ(cache.get("b"), nullptr);
+  EXPECT_NE(cache.get("a"), nullptr);
+  EXPECT_NE(cache.get("c"), nullptr);
+
+  // Too large to cache.
+  cache.put("d", makePages(1'000));
+  EXPECT_EQ(cache.get("d"), nullptr);
+  EXPECT_EQ(cache.size(), 2);
+}
+
+TEST_F(FragmentResultCacheTest, recordAndReplay) {
+  auto recorder = std::make_shared<operators::FragmentResultRecorder>(1 << 20);
+  auto recordPlan = exec::test::PlanBuilder()
+                        .values(data_)
+                        .addNode([&](auto id, auto source) {
+                          return std::make_shared<
+                              operators::FragmentResultRecordNode>(
+                              id, std::move(source), recorder);
+                        })
+                        .planNode();
+  assertQuery(recordPlan, "SELECT * FROM tmp");
+  auto pages = recorder->finish();
+  ASSERT_NE(pages, nullptr);
+  EXPECT_EQ(pages->pages.size(), 2);
+
+  auto replayPlan = exec::test::PlanBuilder()
+                        .addNode([&](auto id, auto /*source*/) {
+                          return std::make_shared<
+                              operators::FragmentResultValuesNode>(
+                              id, rowType_, pages);
+                        })
+                        .planNode();
+  assertQuery(replayPlan, "SELECT * FROM tmp");
+
+  // The rows over the max bytes are not recorded.
+  auto smallRecorder = std::make_shared<operators::FragmentResultRecorder>(10);
+  recordPlan = exec::test::PlanBuilder()
+                   .values(data_)
+                   .addNode([&](auto id, auto source) {
+                     return std::make_shared<
+                         operators::FragmentResultRecordNode>(
+                         id, std::move(source), smallRecorder);
+                   })
+                   .planNode();
+  assertQuery(recordPlan, "SELECT * FROM tmp");
+  EXPECT_TRUE(smallRecorder->full());
+  EXPECT_EQ(smallRecorder->finish(), nullptr);
+}
+
+TEST_F(FragmentResultCacheTest, rewritesPlan) {
+  const auto fragment = makeScanFragment();
+  auto recorder = std::make_shared<operators::FragmentResultRecorder>(1 << 20);
+  auto recording =
+      FragmentResultCache::withResultRecorder(fragment, recorder);
+  auto output = std::dynamic_pointer_cast<const core::PartitionedOutputNode>(
+      recording.planNode);
+  ASSERT_NE(output, nullptr);
+  EXPECT_EQ(output->numPartitions(), 4);
+  auto record =
+      std::dynamic_pointer_cast<const operators::FragmentResultRecordNode>(
+          output->sources()[0]);
+  ASSERT_NE(record, nullptr);
+  EXPECT_EQ(record->sources()[0], fragment.planNode->sources()[0]);
+
+  auto cached = FragmentResultCache::withCachedResult(
+      fragment, std::make_shared<operators::FragmentResultPages>());
+  output = std::dynamic_pointer_cast<const core::PartitionedOutputNode>(
+      cached.planNode);
+  ASSERT_NE(output, nullptr);
+  EXPECT_NE(
+      std::dynamic_pointer_cast<const operators::FragmentResultValuesNode>(
+          output->sources()[0]),
+      nullptr);
+  EXPECT_EQ(*output->outputType(), *fragment.planNode->outputType());
+}
@@ -0,0 +1,87 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/HugePages.h"
+#include <gtest/gtest.h>
+#include <sys/mman.h>
+#include <sstream>
+
+using namespace facebook::presto;
+
+TEST(HugePagesTest, parseAnonymousMappings) {
+  std::istringstream maps(
+      "558b8d3f6000-558b8d3f8000 r--p 00000000 fe:00 463547 /usr/bin/cat\n"
+      "7f0000000000-7f0000800000 rw-p 00000000 00:00 0 \n"
+      "7f1000000000-7f1000001000 rw-p 00000000 00:00 0 [heap]\n"
+      "7f2000000000-7f2000001000 rw-p 00000000 00:00 0 [anon]\n"
+      "garbage\n");
+  const auto ranges = parseAnonymousMappings(maps);
+  ASSERT_EQ(ranges.size(), 2);
+  EXPECT_EQ(ranges[0], (AddressRange{0x7f0000000000, 0x7f0000800000}));
+  EXPECT_EQ(ranges[0].size(), 8 << 20);
+  EXPECT_EQ(ranges[1].begin, 0x7f2000000000);
+}
+
+TEST(HugePagesTest, adviseNewMappings) {
+  constexpr uint64_t kSize = 64 << 20;
+  const auto before = anonymousMappings();
+  void* data = mmap(
+      nullptr,
+      kSize,
+      PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+      -1,
+      0);
+  ASSERT_NE(data, MAP_FAILED);
+  const auto after = anonymousMappings();
+
+  // Nothing is new from one snapshot to itself.
+  const auto none = adviseHugePages(after, after, kSize);
+  EXPECT_EQ(none.numRanges + none.numFailed, 0);
+
+  const auto advice = adviseHugePages(before, after, kSize);
+  if (transparentHugePageMode() == "always" ||
+      transparentHugePageMode() == "madvise") {
+    EXPECT_EQ(advice.numFailed, 0);
+    EXPECT_GE(advice.numRanges, 1);
+    EXPECT_GE(advice.bytes, kSize);
+  }
+  munmap(data, kSize);
+}
+
+TEST(HugePagesTest, adviseGrownMappings) {
+  constexpr uint64_t kSize = 64 << 20;
+  const int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
+  auto* data = reinterpret_cast<char*>(
+      mmap(nullptr, 2 * kSize, PROT_READ | PROT_WRITE, flags, -1, 0));
+  ASSERT_NE(data, MAP_FAILED);
+  munmap(data + kSize, kSize);
+  const auto before = anonymousMappings();
+
+  // The kernel usually merges the new mapping into the one before it, which
+  // keeps its start.
+  ASSERT_EQ(
+      mmap(
+          data + kSize,
+          kSize,
+          PROT_READ | PROT_WRITE,
+          flags | MAP_FIXED,
+          -1,
+          0),
+      data + kSize);
+  const auto after = anonymousMappings();
+
+  const auto advice = adviseHugePages(before, after, kSize);
+  EXPECT_GE(advice.numRanges + advice.numFailed, 1);
+  munmap(data, 2 * kSize);
+}
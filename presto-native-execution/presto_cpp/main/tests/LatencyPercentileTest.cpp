@@ -0,0 +1,39 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/LatencyPercentile.h"
+#include <gtest/gtest.h>
+
+using namespace facebook::presto;
+
+TEST(LatencyPercentileTest, basic) {
+  LatencyPercentile p99(99, 100);
+  for (int i = 1; i < 100; ++i) {
+    p99.add(i);
+    EXPECT_EQ(p99.get(), 0);
+  }
+  p99.add(100);
+  EXPECT_EQ(p99.get(), 99);
+
+  // The window moves on: the recent samples are all 1000.
+  for (int i = 0; i < 100; ++i) {
+    p99.add(1'000);
+  }
+  EXPECT_EQ(p99.get(), 1'000);
+
+  LatencyPercentile median(50, 4);
+  for (auto latency : {4, 1, 3, 2}) {
+    median.add(latency);
+  }
+  EXPECT_EQ(median.get(), 2);
+}
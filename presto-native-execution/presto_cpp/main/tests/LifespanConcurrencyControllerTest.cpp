@@ -0,0 +1,49 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/LifespanConcurrencyController.h"
+#include <gtest/gtest.h>
+#include "velox/common/base/Exceptions.h"
+
+using namespace facebook::presto;
+
+TEST(LifespanConcurrencyControllerTest, update) {
+  LifespanConcurrencyController controller(1, 8);
+  EXPECT_EQ(controller.lifespans(), 1);
+
+  // The lifespans grow one at a time while memory and cores are free.
+  EXPECT_EQ(controller.update(10, 10), 2);
+  EXPECT_EQ(controller.update(10, 10), 3);
+  EXPECT_EQ(controller.update(50, 50), 4);
+  // Saturated cores or moderate memory usage hold the count.
+  EXPECT_EQ(controller.update(10, 95), 4);
+  EXPECT_EQ(controller.update(75, 10), 4);
+  EXPECT_EQ(controller.update(10, 10), 5);
+
+  // Up to the maximum.
+  for (int i = 0; i < 10; ++i) {
+    controller.update(10, 10);
+  }
+  EXPECT_EQ(controller.lifespans(), 8);
+
+  // High memory usage halves the lifespans down to the minimum.
+  EXPECT_EQ(controller.update(90, 10), 4);
+  EXPECT_EQ(controller.update(90, 10), 2);
+  EXPECT_EQ(controller.update(95, 10), 1);
+  EXPECT_EQ(controller.update(95, 10), 1);
+
+  EXPECT_THROW(
+      LifespanConcurrencyController(0, 8), facebook::velox::VeloxRuntimeError);
+  EXPECT_THROW(
+      LifespanConcurrencyController(4, 2), facebook::velox::VeloxRuntimeError);
+}
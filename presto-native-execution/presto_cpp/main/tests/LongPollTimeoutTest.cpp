@@ -0,0 +1,55 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/LongPollTimeout.h"
+#include <gtest/gtest.h>
+
+using namespace facebook::presto;
+
+TEST(LongPollTimeoutTest, expired) {
+  folly::EventBase eventBase;
+  auto [promise, future] = folly::makePromiseContract<int>();
+  auto result = withLongPollTimeout<int>(
+      std::move(future), &eventBase, std::chrono::milliseconds(10), []() {
+        return -1;
+      });
+  EXPECT_EQ(std::move(result).getVia(&eventBase), -1);
+  // The late value is dropped.
+  promise.setValue(1);
+  eventBase.loopOnce();
+}
+
+TEST(LongPollTimeoutTest, completed) {
+  folly::EventBase eventBase;
+  auto [promise, future] = folly::makePromiseContract<int>();
+  auto result = withLongPollTimeout<int>(
+      std::move(future), &eventBase, std::chrono::milliseconds(50), []() {
+        return -1;
+      });
+  promise.setValue(1);
+  EXPECT_EQ(std::move(result).getVia(&eventBase), 1);
+  // The cancelled timeout does not fire.
+  eventBase.runAfterDelay([&]() { eventBase.terminateLoopSoon(); }, 100);
+  eventBase.loop();
+}
+
+TEST(LongPollTimeoutTest, exception) {
+  folly::EventBase eventBase;
+  auto [promise, future] = folly::makePromiseContract<int>();
+  auto result = withLongPollTimeout<int>(
+      std::move(future), &eventBase, std::chrono::seconds(10), []() {
+        return -1;
+      });
+  promise.setException(std::runtime_error("failed"));
+  EXPECT_THROW(std::move(result).getVia(&eventBase), std::runtime_error);
+}
@@ -0,0 +1,52 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/MemoryTrimmer.h"
+#include <gtest/gtest.h>
+#include "velox/common/memory/MmapAllocator.h"
+
+using namespace facebook::presto;
+using namespace facebook::velox;
+
+TEST(MemoryTrimmerTest, residentBytes) {
+  EXPECT_GT(residentBytes(), 0);
+}
+
+TEST(MemoryTrimmerTest, allocatorDetail) {
+  memory::MmapAllocator::Options options;
+  options.capacity = 64 << 20;
+  memory::MmapAllocator allocator(options);
+  memory::Allocation allocation;
+  ASSERT_TRUE(allocator.allocateNonContiguous(100, allocation));
+  const auto detail = memoryAllocatorDetail(&allocator);
+  EXPECT_NE(detail.find("allocated 409600 bytes"), std::string::npos)
+      << detail;
+  EXPECT_NE(detail.find("Externally mapped"), std::string::npos) << detail;
+  allocator.freeNonContiguous(allocation);
+}
+
+TEST(MemoryTrimmerTest, trim) {
+  {
+    // Leaves free memory in the malloc arenas.
+    std::vector<std::unique_ptr<char[]>> blocks;
+    for (auto i = 0; i < 1'000; ++i) {
+      blocks.emplace_back(new char[64 << 10]);
+      memset(blocks.back().get(), 1, 64 << 10);
+    }
+  }
+  const auto stats = trimMemory();
+  EXPECT_GT(stats.residentBytesBefore, 0);
+  EXPECT_GT(stats.residentBytesAfter, 0);
+  EXPECT_EQ(stats.cacheBytesDropped, 0);
+  EXPECT_NE(stats.toString().find("Released"), std::string::npos);
+}
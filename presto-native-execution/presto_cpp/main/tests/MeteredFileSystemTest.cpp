@@ -0,0 +1,99 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/connectors/hive/storage_adapters/MeteredFileSystem.h"
+#include <folly/executors/CPUThreadPoolExecutor.h>
+#include <gtest/gtest.h>
+#include <fstream>
+#include "velox/common/file/File.h"
+#include "velox/exec/tests/utils/TempDirectoryPath.h"
+
+using namespace facebook::presto;
+using namespace facebook::velox;
+
+class MeteredFileSystemTest : public testing::Test {
+ protected:
+  static constexpr uint64_t kFileSize = 1 << 20;
+
+  static void SetUpTestCase() {
+    filesystems::registerLocalFileSystem();
+    executor_ = std::make_unique<folly::CPUThreadPoolExecutor>(4);
+  }
+
+  static void TearDownTestCase() {
+    executor_.reset();
+  }
+
+  void SetUp() override {
+    directory_ = exec::test::TempDirectoryPath::create();
+    path_ = directory_->path + "/file";
+    std::ofstream out(path_, std::ios::binary);
+    data_.resize(kFileSize);
+    for (auto i = 0; i < kFileSize; ++i) {
+      data_[i] = 'a' + i % 23;
+    }
+    out.write(data_.data(), data_.size());
+  }
+
+  // Opens the local file as if from a remote file system.
+  std::unique_ptr<ReadFile> openFile() {
+    RemoteReadOptions options;
+    options.coalesce = true;
+    options.parallelReadBytes = 64 << 10;
+    options.executor = executor_.get();
+    auto fileSystem = makeMeteredFileSystem(
+        filesystems::getFileSystem(path_, nullptr), "test", options);
+    return fileSystem->openFileForRead(path_);
+  }
+
+  static std::unique_ptr<folly::CPUThreadPoolExecutor> executor_;
+  std::shared_ptr<exec::test::TempDirectoryPath> directory_;
+  std::string path_;
+  std::string data_;
+};
+
+std::unique_ptr<folly::CPUThreadPoolExecutor> MeteredFileSystemTest::executor_;
+
+TEST_F(MeteredFileSystemTest, read) {
+  auto file = openFile();
+  EXPECT_EQ(file->size(), kFileSize);
+  EXPECT_TRUE(file->shouldCoalesce());
+
+  // Read in one range.
+  std::string buffer(1000, '\0');
+  EXPECT_EQ(file->pread(100, 1000, buffer.data()), data_.substr(100, 1000));
+
+  // Read in 16 parallel ranges, the last of which is not full.
+  buffer.resize(kFileSize - 1000);
+  EXPECT_EQ(
+      file->pread(1000, buffer.size(), buffer.data()), data_.substr(1000));
+
+  std::string first(10, '\0');
+  std::string second(20, '\0');
+  EXPECT_EQ(
+      file->preadv(5, {folly::Range<char*>(first.data(), first.size()),
+                       folly::Range<char*>(nullptr, 10),
+                       folly::Range<char*>(second.data(), second.size())}),
+      40);
+  EXPECT_EQ(first, data_.substr(5, 10));
+  EXPECT_EQ(second, data_.substr(25, 20));
+}
+
+TEST_F(MeteredFileSystemTest, parallelReadError) {
+  auto file = openFile();
+  // The ranges past the end of the file fail.
+  std::string buffer(kFileSize, '\0');
+  EXPECT_THROW(
+      file->pread(kFileSize / 2, buffer.size(), buffer.data()),
+      std::exception);
+}
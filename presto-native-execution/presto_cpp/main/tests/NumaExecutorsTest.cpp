@@ -0,0 +1,36 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/NumaExecutors.h"
+#include <gtest/gtest.h>
+#include "velox/common/base/Exceptions.h"
+
+using namespace facebook::presto;
+
+TEST(NumaExecutorsTest, parseCpuList) {
+  EXPECT_EQ(
+      parseCpuList("0-3,8,10-11\n"),
+      (std::vector<int32_t>{0, 1, 2, 3, 8, 10, 11}));
+  EXPECT_EQ(parseCpuList("5"), std::vector<int32_t>{5});
+  EXPECT_TRUE(parseCpuList("").empty());
+  EXPECT_THROW(parseCpuList("3-1"), facebook::velox::VeloxRuntimeError);
+}
+
+TEST(NumaExecutorsTest, threadsPerNode) {
+  NumaExecutors executors({{0, 1, 2}, {3}}, 8);
+  ASSERT_EQ(executors.numNodes(), 2);
+  EXPECT_EQ(executors.executor(0)->numThreads(), 6);
+  // Every node gets a thread.
+  EXPECT_EQ(executors.executor(1)->numThreads(), 2);
+  EXPECT_EQ(executors.leastLoadedNode(), 0);
+}
@@ -0,0 +1,127 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <gtest/gtest.h>
+
+#include <folly/io/Cursor.h>
+
+#include "presto_cpp/main/PageChecksum.h"
+#include "velox/common/base/tests/GTestUtils.h"
+
+using namespace facebook::presto;
+
+class PageChecksumTest : public ::testing::Test {
+ protected:
+  // Returns a serialized page of 'numRows' rows and 'payload' without a
+  // checksum.
+  static std::unique_ptr<folly::IOBuf> makePage(
+      int32_t numRows,
+      const std::string& payload) {
+    auto page = folly::IOBuf::create(kHeaderBytes + payload.size());
+    folly::io::Appender appender(page.get(), 0);
+    appender.writeLE<int32_t>(numRows);
+    appender.write<uint8_t>(0);
+    appender.writeLE<int32_t>(payload.size());
+    appender.writeLE<int32_t>(payload.size());
+    appender.writeLE<int64_t>(0);
+    appender.push(
+        reinterpret_cast<const uint8_t*>(payload.data()), payload.size());
+    return page;
+  }
+
+  static uint8_t codecMarkers(const folly::IOBuf& page) {
+    folly::io::Cursor cursor(&page);
+    cursor.skip(4);
+    return cursor.read<uint8_t>();
+  }
+
+  static int64_t checksum(const folly::IOBuf& page) {
+    folly::io::Cursor cursor(&page);
+    cursor.skip(13);
+    return cursor.readLE<int64_t>();
+  }
+
+  static constexpr size_t kHeaderBytes{21};
+};
+
+TEST_F(PageChecksumTest, javaCompatible) {
+  auto page = makePage(3, "123456789");
+  // The CRC32 of the payload followed by the codec markers, the position
+  // count and the uncompressed size.
+  EXPECT_EQ(computePageChecksum(*page), 0x95f91f05);
+
+  setPageChecksum(*page);
+  EXPECT_EQ(codecMarkers(*page), 4);
+  EXPECT_EQ(checksum(*page), 0xc8154e09);
+  EXPECT_EQ(computePageChecksum(*page), 0xc8154e09);
+}
+
+TEST_F(PageChecksumTest, chained) {
+  auto page = makePage(3, "123456789");
+  setPageChecksum(*page);
+
+  // The same page split across buffers, with the header split too.
+  folly::io::Cursor cursor(page.get());
+  auto chained = folly::IOBuf::create(0);
+  for (const size_t size : {7, 20, 3}) {
+    std::unique_ptr<folly::IOBuf> part;
+    cursor.clone(part, size);
+    chained->prependChain(std::move(part));
+  }
+  EXPECT_EQ(computePageChecksum(*chained), checksum(*page));
+}
+
+TEST_F(PageChecksumTest, setOnce) {
+  auto page = makePage(1, "abc");
+  setPageChecksum(*page);
+  const auto expected = checksum(*page);
+
+  // A shared page is only stamped by the first caller.
+  auto clone = page->clone();
+  setPageChecksum(*clone);
+  EXPECT_EQ(codecMarkers(*page), 4);
+  EXPECT_EQ(checksum(*page), expected);
+}
+
+TEST_F(PageChecksumTest, verify) {
+  auto pages = makePage(1, "abc");
+  pages->prependChain(makePage(2, "defgh"));
+  pages->prependChain(makePage(0, ""));
+  setPageChecksum(*pages);
+  setPageChecksum(*pages->next());
+  // The last page is sent without a checksum.
+  pages->coalesce();
+
+  verifyPageChecksums(*pages, "test");
+  folly::io::Cursor cursor(pages.get());
+  for (const size_t payloadBytes : {3, 5, 0}) {
+    std::unique_ptr<folly::IOBuf> page;
+    cursor.clone(page, kHeaderBytes + payloadBytes);
+    EXPECT_EQ(codecMarkers(*page), 0);
+    EXPECT_EQ(checksum(*page), 0);
+  }
+  EXPECT_TRUE(cursor.isAtEnd());
+}
+
+TEST_F(PageChecksumTest, corrupted) {
+  auto page = makePage(1, "abc");
+  setPageChecksum(*page);
+  page->writableData()[kHeaderBytes + 1] = 'x';
+  VELOX_ASSERT_THROW(
+      verifyPageChecksums(*page, "worker/1"),
+      "Received corrupted serialized page from worker/1");
+
+  page = makePage(1, "abc");
+  page->trimEnd(1);
+  EXPECT_THROW(verifyPageChecksums(*page, "worker/1"), std::exception);
+}
@@ -0,0 +1,115 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/PlanFragmentCache.h"
+#include <gtest/gtest.h>
+
+using namespace facebook::velox;
+using namespace facebook::presto;
+
+namespace {
+// Returns a plan fragment convert function which counts its calls in
+// 'numConverts' and tells apart its plans by 'numSplitGroups'.
+std::function<core::PlanFragment(bool&)>
+makeConvert(int& numConverts, int numSplitGroups, bool shareable = true) {
+  return [&numConverts, numSplitGroups, shareable](bool& isShareable) {
+    ++numConverts;
+    isShareable = shareable;
+    core::PlanFragment plan;
+    plan.numSplitGroups = numSplitGroups;
+    return plan;
+  };
+}
+} // namespace
+
+TEST(PlanFragmentCacheTest, basic) {
+  PlanFragmentCache cache(2);
+  int numConverts = 0;
+
+  EXPECT_EQ(
+      cache.getOrConvert("a", "", makeConvert(numConverts, 1)).numSplitGroups,
+      1);
+  EXPECT_EQ(
+      cache.getOrConvert("a", "", makeConvert(numConverts, 2)).numSplitGroups,
+      1);
+  EXPECT_EQ(numConverts, 1);
+  EXPECT_EQ(cache.size(), 1);
+
+  EXPECT_EQ(
+      cache.getOrConvert("b", "", makeConvert(numConverts, 2)).numSplitGroups,
+      2);
+  EXPECT_EQ(numConverts, 2);
+  EXPECT_EQ(cache.size(), 2);
+
+  // Touch "a" so that "b" is the least recently used and gets evicted.
+  cache.getOrConvert("a", "", makeConvert(numConverts, 1));
+  EXPECT_EQ(numConverts, 2);
+  EXPECT_EQ(
+      cache.getOrConvert("c", "", makeConvert(numConverts, 3)).numSplitGroups,
+      3);
+  EXPECT_EQ(numConverts, 3);
+  EXPECT_EQ(cache.size(), 2);
+
+  cache.getOrConvert("a", "", makeConvert(numConverts, 1));
+  EXPECT_EQ(numConverts, 3);
+  EXPECT_EQ(
+      cache.getOrConvert("b", "", makeConvert(numConverts, 4)).numSplitGroups,
+      4);
+  EXPECT_EQ(numConverts, 4);
+}
+
+TEST(PlanFragmentCacheTest, tableWriteInfo) {
+  PlanFragmentCache cache(2);
+  int numConverts = 0;
+
+  // The same plan fragment is converted again for a different table write
+  // info, also if the two concatenate to the same bytes.
+  cache.getOrConvert("ab", "", makeConvert(numConverts, 1));
+  EXPECT_EQ(
+      cache.getOrConvert("a", "b", makeConvert(numConverts, 2)).numSplitGroups,
+      2);
+  EXPECT_EQ(
+      cache.getOrConvert("a", "c", makeConvert(numConverts, 3)).numSplitGroups,
+      3);
+  EXPECT_EQ(
+      cache.getOrConvert("a", "b", makeConvert(numConverts, 4)).numSplitGroups,
+      2);
+  EXPECT_EQ(numConverts, 3);
+  EXPECT_EQ(cache.size(), 2);
+}
+
+TEST(PlanFragmentCacheTest, taskSpecificPlan) {
+  PlanFragmentCache cache(2);
+  int numConverts = 0;
+
+  EXPECT_EQ(
+      cache.getOrConvert("a", "", makeConvert(numConverts, 1, false))
+          .numSplitGroups,
+      1);
+  EXPECT_EQ(
+      cache.getOrConvert("a", "", makeConvert(numConverts, 2, false))
+          .numSplitGroups,
+      2);
+  EXPECT_EQ(numConverts, 2);
+  EXPECT_EQ(cache.size(), 0);
+}
+
+TEST(PlanFragmentCacheTest, disabled) {
+  PlanFragmentCache cache(0);
+  int numConverts = 0;
+
+  cache.getOrConvert("a", "", makeConvert(numConverts, 1));
+  cache.getOrConvert("a", "", makeConvert(numConverts, 1));
+  EXPECT_EQ(numConverts, 2);
+  EXPECT_EQ(cache.size(), 0);
+}
@@ -11,19 +11,25 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#include <folly/Random.h>
 #include <folly/executors/ThreadedExecutor.h>
 #include <folly/init/Init.h>
 #include <gtest/gtest.h>
+#include <thread>
 
 #include <velox/common/memory/MemoryAllocator.h>
+#include "presto_cpp/main/PageCompression.h"
 #include "presto_cpp/main/PrestoExchangeSource.h"
+#include "presto_cpp/main/PushExchange.h"
 #include "presto_cpp/main/common/Configs.h"
 #include "presto_cpp/main/http/HttpClient.h"
 #include "presto_cpp/main/http/HttpServer.h"
 #include "presto_cpp/main/tests/HttpServerWrapper.h"
+#include "presto_cpp/main/tests/ScopedSystemConfig.h"
 #include "presto_cpp/presto_protocol/presto_protocol.h"
 #include "velox/common/base/tests/GTestUtils.h"
 #include "velox/common/memory/MmapAllocator.h"
+#include "velox/exec/tests/utils/TempDirectoryPath.h"
 
 using namespace facebook::presto;
 using namespace facebook::velox;
@@ -104,6 +110,7 @@ class Producer {
           auto lastAckPromise = folly::Promise<bool>::makeEmpty();
           {
             std::lock_guard<std::mutex> l(mutex_);
+            ++numAcks_;
             if (sequence > startSequence_) {
               for (int i = startSequence_; i < sequence && !queue_.empty();
                    ++i) {
@@ -174,6 +181,28 @@ class Producer {
     noMoreData_ = true;
   }
 
+  // Returns the data at 'sequence' of this producer as a batched result.
+  std::unique_ptr<Result> getBatchResult(int64_t sequence) {
+    auto [data, noMoreData] = getData(sequence);
+    auto result = std::make_unique<Result>();
+    result->sequence = sequence;
+    result->nextSequence = data.empty() ? sequence : sequence + 1;
+    result->complete = data.empty() && noMoreData;
+    if (!data.empty()) {
+      result->data = folly::IOBuf::create(4 + data.size());
+      int32_t dataSize = data.size();
+      memcpy(result->data->writableData(), &dataSize, 4);
+      memcpy(result->data->writableData() + 4, data.data(), dataSize);
+      result->data->append(4 + dataSize);
+    }
+    return result;
+  }
+
+  int numAcks() {
+    std::lock_guard<std::mutex> l(mutex_);
+    return numAcks_;
+  }
+
   void waitForDeleteResults() {
     folly::SemiFuture<bool> future(false);
     {
@@ -247,6 +276,7 @@ class Producer {
   folly::Promise<bool> deleteResultsPromise_ =
       folly::Promise<bool>::makeEmpty();
   bool receivedDeleteResults_ = false;
+  int numAcks_ = 0;
 };
 
 std::string toString(exec::SerializedPage* page) {
@@ -260,6 +290,35 @@ std::string toString(exec::SerializedPage* page) {
   return std::string(data);
 }
 
+// Returns a serialized presto page with 'data' as its content.
+std::string makePrestoPage(const std::string& data) {
+  const int32_t positionCount = 1;
+  const int32_t dataSize = data.size();
+  std::string page(21 + dataSize, '\0');
+  memcpy(page.data(), &positionCount, 4);
+  memcpy(page.data() + 5, &dataSize, 4);
+  memcpy(page.data() + 9, &dataSize, 4);
+  memcpy(page.data() + 21, data.data(), dataSize);
+  return page;
+}
+
+// Returns the contents of the serialized presto pages in 'page'.
+std::vector<std::string> toPrestoPageContents(exec::SerializedPage* page) {
+  ByteStream input;
+  page->prepareStreamForDeserialize(&input);
+
+  std::vector<std::string> contents;
+  while (!input.atEnd()) {
+    input.skip(9);
+    auto numBytes = input.read<int32_t>();
+    input.skip(8);
+    std::string data(numBytes, '\0');
+    input.readBytes(data.data(), numBytes);
+    contents.push_back(std::move(data));
+  }
+  return contents;
+}
+
 std::unique_ptr<exec::SerializedPage> waitForNextPage(
     const std::shared_ptr<exec::ExchangeQueue>& queue) {
   bool atEnd;
@@ -287,11 +346,14 @@ void waitForEndMarker(const std::shared_ptr<exec::ExchangeQueue>& queue) {
   }
 }
 
-folly::Uri makeProducerUri(const folly::SocketAddress& address) {
+folly::Uri makeProducerUri(
+    const folly::SocketAddress& address,
+    const std::string& taskId = "20201007_190402_00000_r5erw.1.0.0") {
   return folly::Uri(fmt::format(
-      "http://{}:{}/v1/task/20201007_190402_00000_r5erw.1.0.0/results/3",
+      "http://{}:{}/v1/task/{}/results/3",
       address.getAddressStr(),
-      address.getPort()));
+      address.getPort(),
+      taskId));
 }
 
 class PrestoExchangeSourceTest : public testing::Test {
@@ -365,6 +427,87 @@ TEST_F(PrestoExchangeSourceTest, basic) {
   EXPECT_EQ(pool_->getCurrentBytes(), 0);
 }
 
+TEST_F(PrestoExchangeSourceTest, delayedAcks) {
+  std::vector<std::string> pages = {"page1 - xx", "page2 - xxxxx"};
+  auto producer = std::make_unique<Producer>();
+  for (auto& page : pages) {
+    producer->enqueue(page);
+  }
+  producer->noMoreData();
+
+  auto producerServer = std::make_unique<http::HttpServer>(
+      std::make_unique<http::HttpConfig>(folly::SocketAddress("127.0.0.1", 0)));
+  producer->registerEndpoints(producerServer.get());
+
+  test::HttpServerWrapper serverWrapper(std::move(producerServer));
+  auto producerAddress = serverWrapper.start().get();
+
+  // The data requests which follow right away acknowledge the pages, so no
+  // ack request is sent.
+  {
+    auto queue = std::make_shared<exec::ExchangeQueue>(1 << 20);
+    queue->addSourceLocked();
+    queue->noMoreSources();
+    auto exchangeSource = std::make_shared<PrestoExchangeSource>(
+        makeProducerUri(producerAddress),
+        3,
+        queue,
+        pool_.get(),
+        false,
+        false,
+        "",
+        std::chrono::seconds(60));
+
+    requestNextPage(queue, exchangeSource);
+    for (int i = 0; i < pages.size(); i++) {
+      auto page = waitForNextPage(queue);
+      ASSERT_EQ(toString(page.get()), pages[i]) << "at " << i;
+      requestNextPage(queue, exchangeSource);
+    }
+    waitForEndMarker(queue);
+    producer->waitForDeleteResults();
+    EXPECT_EQ(producer->numAcks(), 0);
+  }
+
+  // A consumer which does not ask for more gets the pages acknowledged by a
+  // separate ack request once the delay expires.
+  auto producer2 = std::make_unique<Producer>();
+  producer2->enqueue(pages[0]);
+  auto producerServer2 = std::make_unique<http::HttpServer>(
+      std::make_unique<http::HttpConfig>(folly::SocketAddress("127.0.0.1", 0)));
+  producer2->registerEndpoints(producerServer2.get());
+  test::HttpServerWrapper serverWrapper2(std::move(producerServer2));
+  auto producerAddress2 = serverWrapper2.start().get();
+  {
+    auto queue = std::make_shared<exec::ExchangeQueue>(1 << 20);
+    queue->addSourceLocked();
+    queue->noMoreSources();
+    auto exchangeSource = std::make_shared<PrestoExchangeSource>(
+        makeProducerUri(producerAddress2),
+        3,
+        queue,
+        pool_.get(),
+        false,
+        false,
+        "",
+        std::chrono::milliseconds(10));
+
+    requestNextPage(queue, exchangeSource);
+    auto page = waitForNextPage(queue);
+    ASSERT_EQ(toString(page.get()), pages[0]);
+    for (int i = 0; i < 1'000 && producer2->numAcks() == 0; ++i) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_EQ(producer2->numAcks(), 1);
+    exchangeSource->close();
+    producer2->waitForDeleteResults();
+  }
+
+  serverWrapper2.stop();
+  serverWrapper.stop();
+  EXPECT_EQ(pool_->getCurrentBytes(), 0);
+}
+
 TEST_F(PrestoExchangeSourceTest, earlyTerminatingConsumer) {
   std::vector<std::string> pages = {"page1 - xx", "page2 - xxxxx"};
   auto producer = std::make_unique<Producer>();
@@ -458,6 +601,62 @@ TEST_F(PrestoExchangeSourceTest, failedProducer) {
   EXPECT_THROW(waitForNextPage(queue), std::runtime_error);
 }
 
+TEST_F(PrestoExchangeSourceTest, spillAndUnspill) {
+  auto spillDirectory = exec::test::TempDirectoryPath::create();
+  // Any page queued while another one is goes over the node budget.
+  test::ScopedSystemConfig config(
+      {{SystemConfig::kExchangeSpillPath, spillDirectory->path},
+       {SystemConfig::kExchangeNodeMaxQueuedBytes, "1"}});
+
+  std::vector<std::string> pages;
+  for (auto i = 0; i < 5; ++i) {
+    pages.push_back(fmt::format("page{} - {}", i, std::string(100 * i, 'x')));
+  }
+  auto producer = std::make_unique<Producer>();
+  for (auto& page : pages) {
+    producer->enqueue(page);
+  }
+  producer->noMoreData();
+
+  auto producerServer = std::make_unique<http::HttpServer>(
+      std::make_unique<http::HttpConfig>(folly::SocketAddress("127.0.0.1", 0)));
+  producer->registerEndpoints(producerServer.get());
+  test::HttpServerWrapper serverWrapper(std::move(producerServer));
+  auto producerAddress = serverWrapper.start().get();
+
+  auto queue = std::make_shared<exec::ExchangeQueue>(1 << 20);
+  queue->addSourceLocked();
+  queue->noMoreSources();
+  auto exchangeSource = std::make_shared<PrestoExchangeSource>(
+      makeProducerUri(producerAddress), 3, queue, pool_.get());
+
+  // Waits for the first page without consuming it, so that the next ones are
+  // spilled.
+  requestNextPage(queue, exchangeSource);
+  for (;;) {
+    {
+      std::lock_guard<std::mutex> l(queue->mutex());
+      if (queue->totalBytes() > 0) {
+        break;
+      }
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  // The source fetches the others without being asked and reads them back in
+  // order, followed by the end marker.
+  requestNextPage(queue, exchangeSource);
+  for (auto i = 0; i < pages.size(); ++i) {
+    auto page = waitForNextPage(queue);
+    ASSERT_EQ(toString(page.get()), pages[i]) << "at " << i;
+  }
+  waitForEndMarker(queue);
+  EXPECT_EQ(PrestoExchangeSource::spilledBytes(), 0);
+
+  producer->waitForDeleteResults();
+  serverWrapper.stop();
+  EXPECT_EQ(pool_->getCurrentBytes(), 0);
+}
+
 TEST_F(PrestoExchangeSourceTest, exceedingMemoryCapacityForHttpResponse) {
   const int64_t memoryCapBytes = 1 << 10;
   auto rootPool = defaultMemoryManager().addRootPool(
@@ -567,3 +766,793 @@ TEST_F(PrestoExchangeSourceTest, memoryAllocationAndUsageCheck) {
   ASSERT_EQ(0, currMemoryBytes);
   ASSERT_EQ(192512, peakMemoryBytes);
 }
+
+TEST_F(PrestoExchangeSourceTest, streamingChunkedResponse) {
+  const std::vector<std::string> pages = {
+      "page1 - xx", "page2 - xxxxx", "page3 - xxxxxxxx"};
+  std::string payload;
+  for (const auto& page : pages) {
+    payload.append(makePrestoPage(page));
+  }
+  // The first chunk ends in the middle of the second page.
+  const size_t firstChunkBytes = 21 + pages[0].size() + 7;
+
+  folly::Promise<bool> restPromise;
+  auto restFuture = restPromise.getSemiFuture();
+  folly::Promise<bool> deleteResultsPromise;
+  auto deleteResultsFuture = deleteResultsPromise.getSemiFuture();
+
+  auto producerServer = std::make_unique<http::HttpServer>(
+      std::make_unique<http::HttpConfig>(folly::SocketAddress("127.0.0.1", 0)));
+  producerServer->registerGet(
+      R"(/v1/task/(.*)/results/([0-9]+)/([0-9]+))",
+      [&](proxygen::HTTPMessage* /*message*/,
+          const std::vector<std::string>& /*pathMatch*/) {
+        return new http::CallbackRequestHandler(
+            [&](proxygen::HTTPMessage* /*message*/,
+                const std::vector<std::unique_ptr<folly::IOBuf>>& /*body*/,
+                proxygen::ResponseHandler* downstream) {
+              // Send the headers and the first chunk without EOM, which makes
+              // proxygen use chunked transfer encoding.
+              proxygen::ResponseBuilder(downstream)
+                  .status(http::kHttpOk, "OK")
+                  .header(protocol::PRESTO_PAGE_TOKEN_HEADER, "0")
+                  .header(
+                      protocol::PRESTO_PAGE_NEXT_TOKEN_HEADER,
+                      std::to_string(pages.size()))
+                  .header(protocol::PRESTO_BUFFER_COMPLETE_HEADER, "true")
+                  .header(
+                      proxygen::HTTP_HEADER_CONTENT_TYPE,
+                      protocol::PRESTO_PAGES_MIME_TYPE)
+                  .body(folly::IOBuf::copyBuffer(
+                      payload.data(), firstChunkBytes))
+                  .send();
+              std::move(restFuture)
+                  .via(folly::EventBaseManager::get()->getEventBase())
+                  .thenValue([&, downstream](bool /*value*/) {
+                    proxygen::ResponseBuilder(downstream)
+                        .body(folly::IOBuf::copyBuffer(
+                            payload.data() + firstChunkBytes,
+                            payload.size() - firstChunkBytes))
+                        .sendWithEOM();
+                  });
+            });
+      });
+  producerServer->registerDelete(
+      R"(/v1/task/(.+)/results/([0-9]+))",
+      [&](proxygen::HTTPMessage* /*message*/,
+          const std::vector<std::string>& /*pathMatch*/) {
+        return new http::CallbackRequestHandler(
+            [&](proxygen::HTTPMessage* /*message*/,
+                const std::vector<std::unique_ptr<folly::IOBuf>>& /*body*/,
+                proxygen::ResponseHandler* downstream) {
+              proxygen::ResponseBuilder(downstream)
+                  .status(http::kHttpOk, "OK")
+                  .sendWithEOM();
+              deleteResultsPromise.setValue(true);
+            });
+      });
+
+  test::HttpServerWrapper serverWrapper(std::move(producerServer));
+  auto producerAddress = serverWrapper.start().get();
+
+  auto queue = std::make_shared<exec::ExchangeQueue>(1 << 20);
+  queue->addSourceLocked();
+  queue->noMoreSources();
+  auto exchangeSource = std::make_shared<PrestoExchangeSource>(
+      makeProducerUri(producerAddress), 3, queue, pool_.get(), true);
+
+  requestNextPage(queue, exchangeSource);
+  // The first page is delivered while the rest of the response is held back
+  // by the producer.
+  auto page = waitForNextPage(queue);
+  ASSERT_EQ(
+      toPrestoPageContents(page.get()), std::vector<std::string>{pages[0]});
+  page.reset();
+
+  restPromise.setValue(true);
+  std::vector<std::string> contents;
+  for (;;) {
+    bool atEnd;
+    facebook::velox::ContinueFuture future;
+    auto next = queue->dequeueLocked(&atEnd, &future);
+    if (atEnd) {
+      break;
+    }
+    if (next == nullptr) {
+      std::move(future).get();
+      continue;
+    }
+    for (auto& content : toPrestoPageContents(next.get())) {
+      contents.push_back(std::move(content));
+    }
+  }
+  ASSERT_EQ(contents, std::vector<std::string>(pages.begin() + 1, pages.end()));
+
+  std::move(deleteResultsFuture).get(std::chrono::seconds(10));
+  serverWrapper.stop();
+  EXPECT_EQ(pool_->getCurrentBytes(), 0);
+  int64_t currMemoryBytes;
+  int64_t peakMemoryBytes;
+  PrestoExchangeSource::getMemoryUsage(currMemoryBytes, peakMemoryBytes);
+  ASSERT_EQ(0, currMemoryBytes);
+}
+
+TEST_F(PrestoExchangeSourceTest, sharedHttpClient) {
+  auto queue = std::make_shared<exec::ExchangeQueue>(1 << 20);
+  const folly::SocketAddress address("127.0.0.1", 8081);
+  const folly::SocketAddress otherAddress("127.0.0.1", 8082);
+
+  auto source = std::make_shared<PrestoExchangeSource>(
+      makeProducerUri(address), 3, queue, pool_.get());
+  auto sameUpstreamSource = std::make_shared<PrestoExchangeSource>(
+      makeProducerUri(address), 4, queue, pool_.get());
+  auto otherUpstreamSource = std::make_shared<PrestoExchangeSource>(
+      makeProducerUri(otherAddress), 3, queue, pool_.get());
+
+  ASSERT_EQ(
+      source->testingHttpClient(), sameUpstreamSource->testingHttpClient());
+  ASSERT_NE(
+      source->testingHttpClient(), otherUpstreamSource->testingHttpClient());
+  ASSERT_EQ(
+      PrestoExchangeSource::httpClientPool().getClient(address),
+      source->testingHttpClient());
+}
+
+TEST_F(PrestoExchangeSourceTest, batchResultsSerde) {
+  std::vector<ResultLocation> locations = {
+      {"q.1.0.0", 3, 5}, {"q.1.1.0", 0, 7}};
+  auto parsedLocations =
+      parseResultLocations(serializeResultLocations(locations));
+  ASSERT_EQ(parsedLocations.size(), 2);
+  for (int i = 0; i < locations.size(); ++i) {
+    ASSERT_EQ(parsedLocations[i].taskId, locations[i].taskId);
+    ASSERT_EQ(parsedLocations[i].bufferId, locations[i].bufferId);
+    ASSERT_EQ(parsedLocations[i].token, locations[i].token);
+  }
+  VELOX_ASSERT_THROW(parseResultLocations("[]"), "non-empty json array");
+
+  std::vector<folly::Try<std::unique_ptr<Result>>> results;
+  auto result = std::make_unique<Result>();
+  result->sequence = 5;
+  result->nextSequence = 7;
+  result->complete = false;
+  result->data = folly::IOBuf::copyBuffer("page1");
+  result->data->appendToChain(folly::IOBuf::copyBuffer("page2"));
+  results.emplace_back(std::move(result));
+  result = std::make_unique<Result>();
+  result->sequence = result->nextSequence = 7;
+  result->complete = true;
+  result->data = folly::IOBuf::create(0);
+  results.emplace_back(std::move(result));
+  results.emplace_back(std::runtime_error("Task not found"));
+
+  auto body = serializeBatchResults(results);
+  // Split the body to verify the frames spanning several buffers.
+  folly::IOBufQueue queue;
+  queue.append(std::move(body));
+  auto head = queue.split(10);
+  head->appendToChain(queue.move());
+  auto batchResults = parseBatchResults(std::move(head));
+  ASSERT_EQ(batchResults.size(), 3);
+  ASSERT_EQ(batchResults[0].sequence, 5);
+  ASSERT_EQ(batchResults[0].nextSequence, 7);
+  ASSERT_FALSE(batchResults[0].complete);
+  ASSERT_TRUE(batchResults[0].error.empty());
+  ASSERT_EQ(batchResults[0].data->moveToFbString().toStdString(), "page1page2");
+  ASSERT_EQ(batchResults[1].sequence, 7);
+  ASSERT_TRUE(batchResults[1].complete);
+  ASSERT_EQ(batchResults[1].data, nullptr);
+  ASSERT_NE(batchResults[2].error.find("Task not found"), std::string::npos);
+
+  auto truncated = serializeBatchResults(results);
+  truncated->coalesce();
+  truncated->trimEnd(1);
+  VELOX_ASSERT_THROW(
+      parseBatchResults(std::move(truncated)), "Truncated batched results");
+}
+
+TEST_F(PrestoExchangeSourceTest, batchedResults) {
+  const std::vector<std::string> taskIds = {
+      "20201007_190402_00000_r5erw.1.0.0", "20201007_190402_00000_r5erw.1.1.0"};
+  const std::vector<std::string> pages = {"page1 - xx", "page2 - xxxxx"};
+  std::unordered_map<std::string, std::unique_ptr<Producer>> producers;
+  for (const auto& taskId : taskIds) {
+    auto producer = std::make_unique<Producer>();
+    for (const auto& page : pages) {
+      producer->enqueue(fmt::format("{} {}", taskId, page));
+    }
+    producer->noMoreData();
+    producers[taskId] = std::move(producer);
+  }
+
+  std::atomic<int> numBatchRequests{0};
+  std::atomic<int> numSingleRequests{0};
+  auto producerServer = std::make_unique<http::HttpServer>(
+      std::make_unique<http::HttpConfig>(folly::SocketAddress("127.0.0.1", 0)));
+  producerServer->registerPost(
+      std::string(kBatchResultsPath),
+      [&](proxygen::HTTPMessage* /*message*/,
+          const std::vector<std::string>& /*pathMatch*/) {
+        return new http::CallbackRequestHandler(
+            [&](proxygen::HTTPMessage* /*message*/,
+                const std::vector<std::unique_ptr<folly::IOBuf>>& body,
+                proxygen::ResponseHandler* downstream) {
+              ++numBatchRequests;
+              std::string requestJson;
+              for (auto& buf : body) {
+                requestJson.append((const char*)buf->data(), buf->length());
+              }
+              std::vector<folly::Try<std::unique_ptr<Result>>> results;
+              for (const auto& location : parseResultLocations(requestJson)) {
+                results.emplace_back(producers.at(location.taskId)
+                                         ->getBatchResult(location.token));
+              }
+              proxygen::ResponseBuilder(downstream)
+                  .status(http::kHttpOk, "OK")
+                  .body(serializeBatchResults(results))
+                  .sendWithEOM();
+            });
+      });
+  producerServer->registerGet(
+      R"(/v1/task/(.*)/results/([0-9]+)/([0-9]+))",
+      [&](proxygen::HTTPMessage* message,
+          const std::vector<std::string>& pathMatch) {
+        ++numSingleRequests;
+        return producers.at(pathMatch[1])->getResults(message, pathMatch);
+      });
+  producerServer->registerGet(
+      R"(/v1/task/(.+)/results/([0-9]+)/([0-9]+)/acknowledge)",
+      [&](proxygen::HTTPMessage* message,
+          const std::vector<std::string>& pathMatch) {
+        return producers.at(pathMatch[1])
+            ->acknowledgeResults(message, pathMatch);
+      });
+  producerServer->registerDelete(
+      R"(/v1/task/(.+)/results/([0-9]+))",
+      [&](proxygen::HTTPMessage* message,
+          const std::vector<std::string>& pathMatch) {
+        return producers.at(pathMatch[1])->deleteResults(message, pathMatch);
+      });
+
+  test::HttpServerWrapper serverWrapper(std::move(producerServer));
+  auto producerAddress = serverWrapper.start().get();
+
+  std::vector<std::shared_ptr<exec::ExchangeQueue>> queues;
+  std::vector<std::shared_ptr<PrestoExchangeSource>> sources;
+  for (const auto& taskId : taskIds) {
+    auto queue = std::make_shared<exec::ExchangeQueue>(1 << 20);
+    queue->addSourceLocked();
+    queue->noMoreSources();
+    queues.push_back(queue);
+    sources.push_back(std::make_shared<PrestoExchangeSource>(
+        makeProducerUri(producerAddress, taskId),
+        3,
+        queue,
+        pool_.get(),
+        false,
+        true));
+  }
+
+  for (int i = 0; i < sources.size(); ++i) {
+    requestNextPage(queues[i], sources[i]);
+  }
+  for (int i = 0; i < pages.size(); ++i) {
+    for (int j = 0; j < sources.size(); ++j) {
+      auto page = waitForNextPage(queues[j]);
+      ASSERT_EQ(
+          toString(page.get()), fmt::format("{} {}", taskIds[j], pages[i]));
+      requestNextPage(queues[j], sources[j]);
+    }
+  }
+  for (const auto& queue : queues) {
+    waitForEndMarker(queue);
+  }
+  for (const auto& taskId : taskIds) {
+    producers[taskId]->waitForDeleteResults();
+  }
+  ASSERT_GT(numBatchRequests, 0);
+  ASSERT_EQ(numSingleRequests, 0);
+  serverWrapper.stop();
+  EXPECT_EQ(pool_->getCurrentBytes(), 0);
+}
+
+TEST_F(PrestoExchangeSourceTest, pushedResults) {
+  const std::vector<std::string> pages = {"page1 - xx", "page2 - xxxxx"};
+
+  folly::Promise<PushRegistration> registrationPromise;
+  auto registrationFuture = registrationPromise.getSemiFuture();
+  folly::Promise<bool> deleteResultsPromise;
+  auto deleteResultsFuture = deleteResultsPromise.getSemiFuture();
+  auto producerServer = std::make_unique<http::HttpServer>(
+      std::make_unique<http::HttpConfig>(folly::SocketAddress("127.0.0.1", 0)));
+  producerServer->registerPost(
+      R"(/v1/task/(.+)/results/([0-9]+)/push)",
+      [&](proxygen::HTTPMessage* /*message*/,
+          const std::vector<std::string>& /*pathMatch*/) {
+        return new http::CallbackRequestHandler(
+            [&](proxygen::HTTPMessage* /*message*/,
+                const std::vector<std::unique_ptr<folly::IOBuf>>& body,
+                proxygen::ResponseHandler* downstream) {
+              std::string registrationJson;
+              for (auto& buf : body) {
+                registrationJson.append(
+                    (const char*)buf->data(), buf->length());
+              }
+              registrationPromise.setValue(
+                  parsePushRegistration(registrationJson));
+              http::sendOkResponse(downstream);
+            });
+      });
+  producerServer->registerDelete(
+      R"(/v1/task/(.+)/results/([0-9]+))",
+      [&](proxygen::HTTPMessage* /*message*/,
+          const std::vector<std::string>& /*pathMatch*/) {
+        return new http::CallbackRequestHandler(
+            [&](proxygen::HTTPMessage* /*message*/,
+                const std::vector<std::unique_ptr<folly::IOBuf>>& /*body*/,
+                proxygen::ResponseHandler* downstream) {
+              http::sendOkResponse(downstream);
+              deleteResultsPromise.setValue(true);
+            });
+      });
+  test::HttpServerWrapper producerWrapper(std::move(producerServer));
+  auto producerAddress = producerWrapper.start().get();
+
+  auto consumerServer = std::make_unique<http::HttpServer>(
+      std::make_unique<http::HttpConfig>(folly::SocketAddress("127.0.0.1", 0)));
+  PrestoExchangeSource::registerPushEndpoint(*consumerServer);
+  test::HttpServerWrapper consumerWrapper(std::move(consumerServer));
+  auto consumerAddress = consumerWrapper.start().get();
+
+  auto queue = std::make_shared<exec::ExchangeQueue>(1 << 20);
+  queue->addSourceLocked();
+  queue->noMoreSources();
+  auto exchangeSource = std::make_shared<PrestoExchangeSource>(
+      makeProducerUri(producerAddress),
+      3,
+      queue,
+      pool_.get(),
+      false,
+      false,
+      fmt::format(
+          "http://{}:{}",
+          consumerAddress.getAddressStr(),
+          consumerAddress.getPort()));
+
+  requestNextPage(queue, exchangeSource);
+  auto registration =
+      std::move(registrationFuture).get(std::chrono::seconds(10));
+  ASSERT_TRUE(exchangeSource->testingPushMode());
+  ASSERT_EQ(registration.token, 0);
+  ASSERT_EQ(registration.credits, exchangeSource->testingMaxResponseBytes());
+  const auto pushPath = folly::Uri(registration.uri).path();
+  ASSERT_EQ(pushPath.find(kPushPath), 0);
+
+  auto pushClient =
+      PrestoExchangeSource::httpClientPool().getClient(consumerAddress);
+  auto push = [&](const std::string& path,
+                  int64_t token,
+                  int64_t nextToken,
+                  bool complete,
+                  const std::string& data) {
+    return http::RequestBuilder()
+        .method(proxygen::HTTPMethod::POST)
+        .url(path)
+        .header(protocol::PRESTO_PAGE_TOKEN_HEADER, std::to_string(token))
+        .header(
+            protocol::PRESTO_PAGE_NEXT_TOKEN_HEADER, std::to_string(nextToken))
+        .header(
+            protocol::PRESTO_BUFFER_COMPLETE_HEADER,
+            complete ? "true" : "false")
+        .send(pushClient.get(), pool_.get(), data)
+        .get(std::chrono::seconds(10));
+  };
+  auto credits = [](const std::unique_ptr<http::HttpResponse>& response) {
+    return atol(response->headers()
+                    ->getHeaders()
+                    .getSingleOrEmpty(std::string(kPushCreditsHeader))
+                    .c_str());
+  };
+
+  auto response = push(pushPath, 0, 1, false, makePrestoPage(pages[0]));
+  ASSERT_EQ(response->headers()->getStatusCode(), http::kHttpOk);
+  // The granted credits account for the queued page.
+  ASSERT_GT(credits(response), 0);
+  ASSERT_LT(credits(response), exchangeSource->testingMaxResponseBytes());
+  auto page = waitForNextPage(queue);
+  ASSERT_EQ(
+      toPrestoPageContents(page.get()), std::vector<std::string>{pages[0]});
+  page.reset();
+
+  // A retransmitted push is ignored.
+  response = push(pushPath, 0, 1, false, makePrestoPage(pages[0]));
+  ASSERT_EQ(response->headers()->getStatusCode(), http::kHttpOk);
+  ASSERT_EQ(credits(response), exchangeSource->testingMaxResponseBytes());
+
+  response = push(pushPath, 1, 2, true, makePrestoPage(pages[1]));
+  ASSERT_EQ(response->headers()->getStatusCode(), http::kHttpOk);
+  page = waitForNextPage(queue);
+  ASSERT_EQ(
+      toPrestoPageContents(page.get()), std::vector<std::string>{pages[1]});
+  page.reset();
+  waitForEndMarker(queue);
+  std::move(deleteResultsFuture).get(std::chrono::seconds(10));
+
+  response = push(
+      fmt::format("{}/unknown", kPushPath), 0, 1, false, makePrestoPage("x"));
+  ASSERT_EQ(response->headers()->getStatusCode(), http::kHttpNotFound);
+  response.reset();
+
+  exchangeSource.reset();
+  consumerWrapper.stop();
+  producerWrapper.stop();
+  EXPECT_EQ(pool_->getCurrentBytes(), 0);
+}
+
+TEST_F(PrestoExchangeSourceTest, pageCompression) {
+  using velox::common::CompressionKind;
+  ASSERT_EQ(toPageCodec("lz4"), CompressionKind::CompressionKind_LZ4);
+  ASSERT_EQ(pageCodecName(toPageCodec("zstd")), "zstd");
+  VELOX_ASSERT_THROW(toPageCodec("snappy"), "Unsupported page codec: snappy");
+  ASSERT_EQ(
+      negotiatePageCodec(CompressionKind::CompressionKind_ZSTD, "lz4, zstd"),
+      CompressionKind::CompressionKind_ZSTD);
+  ASSERT_EQ(
+      negotiatePageCodec(CompressionKind::CompressionKind_ZSTD, "lz4"),
+      CompressionKind::CompressionKind_NONE);
+  ASSERT_EQ(
+      negotiatePageCodec(CompressionKind::CompressionKind_LZ4, ""),
+      CompressionKind::CompressionKind_NONE);
+
+  for (auto codec :
+       {CompressionKind::CompressionKind_LZ4,
+        CompressionKind::CompressionKind_ZSTD}) {
+    auto pages =
+        folly::IOBuf::copyBuffer(makePrestoPage(std::string(4096, 'x')));
+    pages->appendToChain(
+        folly::IOBuf::copyBuffer(makePrestoPage(std::string(4096, 'y'))));
+    const auto size = pages->computeChainDataLength();
+    auto compressed = compressPages(*pages, codec);
+    ASSERT_NE(compressed, nullptr);
+    ASSERT_LT(compressed->computeChainDataLength(), size);
+    auto uncompressed = uncompressPages(*compressed, codec, size);
+    ASSERT_TRUE(folly::IOBufEqualTo()(*uncompressed, *pages));
+
+    // Pages which don't shrink are not compressed.
+    std::string random(1024, '\0');
+    folly::Random::secureRandom(random.data(), random.size());
+    ASSERT_EQ(compressPages(*folly::IOBuf::copyBuffer(random), codec), nullptr);
+  }
+}
+
+TEST_F(PrestoExchangeSourceTest, compressedResponse) {
+  const std::vector<std::string> pages = {
+      std::string(1000, 'a'), std::string(2000, 'b')};
+  std::atomic<int> numAcceptingRequests{0};
+  folly::Promise<bool> deleteResultsPromise;
+  auto deleteResultsFuture = deleteResultsPromise.getSemiFuture();
+  auto producerServer = std::make_unique<http::HttpServer>(
+      std::make_unique<http::HttpConfig>(folly::SocketAddress("127.0.0.1", 0)));
+  producerServer->registerGet(
+      R"(/v1/task/(.*)/results/([0-9]+)/([0-9]+))",
+      [&](proxygen::HTTPMessage* message,
+          const std::vector<std::string>& pathMatch) {
+        const auto sequence = folly::to<size_t>(pathMatch[3]);
+        const auto& accepted = message->getHeaders().getSingleOrEmpty(
+            std::string(kPrestoAcceptPageCodecsHeader));
+        if (!accepted.empty()) {
+          ++numAcceptingRequests;
+        }
+        const auto codec = negotiatePageCodec(
+            velox::common::CompressionKind::CompressionKind_ZSTD, accepted);
+        return new http::CallbackRequestHandler(
+            [&, sequence, codec](
+                proxygen::HTTPMessage* /*message*/,
+                const std::vector<std::unique_ptr<folly::IOBuf>>& /*body*/,
+                proxygen::ResponseHandler* downstream) {
+              const bool complete = sequence >= pages.size();
+              proxygen::ResponseBuilder builder(downstream);
+              builder.status(http::kHttpOk, "OK")
+                  .header(
+                      protocol::PRESTO_PAGE_TOKEN_HEADER,
+                      std::to_string(sequence))
+                  .header(
+                      protocol::PRESTO_PAGE_NEXT_TOKEN_HEADER,
+                      std::to_string(complete ? sequence : sequence + 1))
+                  .header(
+                      protocol::PRESTO_BUFFER_COMPLETE_HEADER,
+                      complete ? "true" : "false");
+              if (complete) {
+                builder.sendWithEOM();
+                return;
+              }
+              auto data =
+                  folly::IOBuf::copyBuffer(makePrestoPage(pages[sequence]));
+              const auto uncompressedSize = data->computeChainDataLength();
+              ASSERT_NE(
+                  codec, velox::common::CompressionKind::CompressionKind_NONE);
+              builder
+                  .header(
+                      std::string(kPrestoPageCodecHeader),
+                      std::string(pageCodecName(codec)))
+                  .header(
+                      std::string(kPrestoUncompressedSizeHeader),
+                      std::to_string(uncompressedSize))
+                  .body(compressPages(*data, codec))
+                  .sendWithEOM();
+            });
+      });
+  producerServer->registerGet(
+      R"(/v1/task/(.+)/results/([0-9]+)/([0-9]+)/acknowledge)",
+      [&](proxygen::HTTPMessage* /*message*/,
+          const std::vector<std::string>& /*pathMatch*/) {
+        return new http::CallbackRequestHandler(
+            [&](proxygen::HTTPMessage* /*message*/,
+                const std::vector<std::unique_ptr<folly::IOBuf>>& /*body*/,
+                proxygen::ResponseHandler* downstream) {
+              http::sendOkResponse(downstream);
+            });
+      });
+  producerServer->registerDelete(
+      R"(/v1/task/(.+)/results/([0-9]+))",
+      [&](proxygen::HTTPMessage* /*message*/,
+          const std::vector<std::string>& /*pathMatch*/) {
+        return new http::CallbackRequestHandler(
+            [&](proxygen::HTTPMessage* /*message*/,
+                const std::vector<std::unique_ptr<folly::IOBuf>>& /*body*/,
+                proxygen::ResponseHandler* downstream) {
+              http::sendOkResponse(downstream);
+              deleteResultsPromise.setValue(true);
+            });
+      });
+  test::HttpServerWrapper serverWrapper(std::move(producerServer));
+  auto producerAddress = serverWrapper.start().get();
+
+  auto queue = std::make_shared<exec::ExchangeQueue>(1 << 20);
+  queue->addSourceLocked();
+  queue->noMoreSources();
+  auto exchangeSource = std::make_shared<PrestoExchangeSource>(
+      makeProducerUri(producerAddress), 3, queue, pool_.get());
+
+  requestNextPage(queue, exchangeSource);
+  for (const auto& expected : pages) {
+    auto page = waitForNextPage(queue);
+    ASSERT_EQ(
+        toPrestoPageContents(page.get()), std::vector<std::string>{expected});
+    requestNextPage(queue, exchangeSource);
+  }
+  waitForEndMarker(queue);
+  std::move(deleteResultsFuture).get(std::chrono::seconds(10));
+  ASSERT_EQ(numAcceptingRequests, pages.size() + 1);
+
+  serverWrapper.stop();
+  EXPECT_EQ(pool_->getCurrentBytes(), 0);
+}
+
+TEST_F(PrestoExchangeSourceTest, corruptCompressedResponse) {
+  std::atomic<int> numRequests{0};
+  auto producerServer = std::make_unique<http::HttpServer>(
+      std::make_unique<http::HttpConfig>(folly::SocketAddress("127.0.0.1", 0)));
+  producerServer->registerGet(
+      R"(/v1/task/(.*)/results/([0-9]+)/([0-9]+))",
+      [&](proxygen::HTTPMessage* /*message*/,
+          const std::vector<std::string>& /*pathMatch*/) {
+        return new http::CallbackRequestHandler(
+            [&](proxygen::HTTPMessage* /*message*/,
+                const std::vector<std::unique_ptr<folly::IOBuf>>& /*body*/,
+                proxygen::ResponseHandler* downstream) {
+              ++numRequests;
+              // Claims to be ZSTD compressed but isn't.
+              std::string garbage(1024, '\0');
+              folly::Random::secureRandom(garbage.data(), garbage.size());
+              proxygen::ResponseBuilder(downstream)
+                  .status(http::kHttpOk, "OK")
+                  .header(protocol::PRESTO_PAGE_TOKEN_HEADER, "0")
+                  .header(protocol::PRESTO_PAGE_NEXT_TOKEN_HEADER, "1")
+                  .header(protocol::PRESTO_BUFFER_COMPLETE_HEADER, "false")
+                  .header(
+                      std::string(kPrestoPageCodecHeader),
+                      std::string(pageCodecName(
+                          velox::common::CompressionKind::
+                              CompressionKind_ZSTD)))
+                  .header(std::string(kPrestoUncompressedSizeHeader), "4096")
+                  .body(folly::IOBuf::copyBuffer(garbage))
+                  .sendWithEOM();
+            });
+      });
+  test::HttpServerWrapper serverWrapper(std::move(producerServer));
+  auto producerAddress = serverWrapper.start().get();
+
+  auto queue = std::make_shared<exec::ExchangeQueue>(1 << 20);
+  queue->addSourceLocked();
+  queue->noMoreSources();
+  auto exchangeSource = std::make_shared<PrestoExchangeSource>(
+      makeProducerUri(producerAddress), 3, queue, pool_.get());
+
+  requestNextPage(queue, exchangeSource);
+  VELOX_ASSERT_THROW(waitForNextPage(queue), "Exhausted retries");
+  // A corrupt response is not retried.
+  ASSERT_EQ(numRequests, 1);
+  ASSERT_EQ(exchangeSource->testingFailedAttempts(), 1);
+
+  serverWrapper.stop();
+  EXPECT_EQ(pool_->getCurrentBytes(), 0);
+}
+
+TEST_F(PrestoExchangeSourceTest, nextMaxResponseBytes) {
+  const int64_t kMin = 1 << 20;
+  const int64_t kMax = 32 << 20;
+  // Full response and the consumer keeps up.
+  ASSERT_EQ(
+      PrestoExchangeSource::nextMaxResponseBytes(kMin, kMin, 0, kMin, kMax),
+      2 * kMin);
+  // Full response but the consumer falls behind.
+  ASSERT_EQ(
+      PrestoExchangeSource::nextMaxResponseBytes(
+          4 * kMin, 4 * kMin, 8 * kMin, kMin, kMax),
+      4 * kMin);
+  // Partially filled response.
+  ASSERT_EQ(
+      PrestoExchangeSource::nextMaxResponseBytes(
+          4 * kMin, 3 * kMin / 2, 0, kMin, kMax),
+      4 * kMin);
+  // Mostly empty response.
+  ASSERT_EQ(
+      PrestoExchangeSource::nextMaxResponseBytes(
+          16 * kMin, kMin, 0, kMin, kMax),
+      8 * kMin);
+  ASSERT_EQ(
+      PrestoExchangeSource::nextMaxResponseBytes(
+          16 * kMin, 3 * kMin, 0, kMin, kMax),
+      8 * kMin);
+  // Clamped to the configured range.
+  ASSERT_EQ(
+      PrestoExchangeSource::nextMaxResponseBytes(kMax, kMax, 0, kMin, kMax),
+      kMax);
+  ASSERT_EQ(
+      PrestoExchangeSource::nextMaxResponseBytes(kMin, 0, 0, kMin, kMax),
+      kMin);
+}
+
+TEST_F(PrestoExchangeSourceTest, prefetch) {
+  test::ScopedSystemConfig config(
+      {{SystemConfig::kExchangeMinPrefetchedPages, "3"}});
+
+  std::vector<std::string> pages;
+  for (auto i = 0; i < 5; ++i) {
+    pages.push_back(fmt::format("page{} - xxxxx", i));
+  }
+  auto producer = std::make_unique<Producer>();
+  for (auto& page : pages) {
+    producer->enqueue(page);
+  }
+  producer->noMoreData();
+
+  auto producerServer = std::make_unique<http::HttpServer>(
+      std::make_unique<http::HttpConfig>(folly::SocketAddress("127.0.0.1", 0)));
+  producer->registerEndpoints(producerServer.get());
+  test::HttpServerWrapper serverWrapper(std::move(producerServer));
+  auto producerAddress = serverWrapper.start().get();
+
+  auto queue = std::make_shared<exec::ExchangeQueue>(1 << 20);
+  queue->addSourceLocked();
+  queue->noMoreSources();
+  auto exchangeSource = std::make_shared<PrestoExchangeSource>(
+      makeProducerUri(producerAddress), 3, queue, pool_.get());
+
+  // A single request from the consumer fetches the pages up to the min.
+  requestNextPage(queue, exchangeSource);
+  // The pages are of the same size, each behind its 4 bytes size.
+  const int64_t pageBytes = 4 + pages[0].size();
+  for (;;) {
+    {
+      std::lock_guard<std::mutex> l(queue->mutex());
+      if (queue->totalBytes() >= 3 * pageBytes) {
+        break;
+      }
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  // The fetching stops at the min while the pages are not consumed.
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  {
+    std::lock_guard<std::mutex> l(queue->mutex());
+    EXPECT_EQ(queue->totalBytes(), 3 * pageBytes);
+    EXPECT_TRUE(exchangeSource->shouldRequestLocked());
+  }
+  for (auto i = 0; i < 3; ++i) {
+    auto page = waitForNextPage(queue);
+    ASSERT_EQ(toString(page.get()), pages[i]) << "at " << i;
+  }
+
+  // The next request fetches the rest without further requests.
+  exchangeSource->request();
+  for (auto i = 3; i < pages.size(); ++i) {
+    auto page = waitForNextPage(queue);
+    ASSERT_EQ(toString(page.get()), pages[i]) << "at " << i;
+  }
+  waitForEndMarker(queue);
+
+  producer->waitForDeleteResults();
+  serverWrapper.stop();
+  EXPECT_EQ(pool_->getCurrentBytes(), 0);
+}
+
+TEST_F(PrestoExchangeSourceTest, hedgedDataFetch) {
+  using DataFetch = PrestoExchangeSource::DataFetch;
+  {
+    // The first successful leg wins, the late one is dropped.
+    DataFetch fetch;
+    ASSERT_TRUE(fetch.addLeg());
+    EXPECT_TRUE(fetch.succeed());
+    EXPECT_FALSE(fetch.succeed());
+    EXPECT_FALSE(fetch.fail());
+  }
+  {
+    // The hedge wins after the request failed.
+    DataFetch fetch;
+    ASSERT_TRUE(fetch.addLeg());
+    EXPECT_FALSE(fetch.fail());
+    EXPECT_TRUE(fetch.succeed());
+  }
+  {
+    // The failure is reported once both legs failed.
+    DataFetch fetch;
+    ASSERT_TRUE(fetch.addLeg());
+    EXPECT_FALSE(fetch.fail());
+    EXPECT_TRUE(fetch.fail());
+    EXPECT_FALSE(fetch.succeed());
+  }
+  {
+    // Without a hedge the failure is reported right away.
+    DataFetch fetch;
+    EXPECT_TRUE(fetch.fail());
+    EXPECT_FALSE(fetch.addLeg());
+  }
+  {
+    // The hedge is cancelled if the request succeeded before it is due.
+    DataFetch fetch;
+    EXPECT_TRUE(fetch.succeed());
+    EXPECT_FALSE(fetch.addLeg());
+    EXPECT_FALSE(fetch.fail());
+  }
+}
+
+TEST_F(PrestoExchangeSourceTest, shouldPrefetch) {
+  const int64_t kPageBytes = 1 << 20;
+  // Disabled.
+  ASSERT_FALSE(PrestoExchangeSource::shouldPrefetch(0, kPageBytes, 0));
+  // Empty response.
+  ASSERT_FALSE(PrestoExchangeSource::shouldPrefetch(0, 0, 4));
+  // Fewer pages queued than the min.
+  ASSERT_TRUE(PrestoExchangeSource::shouldPrefetch(kPageBytes, kPageBytes, 4));
+  ASSERT_TRUE(
+      PrestoExchangeSource::shouldPrefetch(3 * kPageBytes, kPageBytes, 4));
+  // Enough pages queued.
+  ASSERT_FALSE(
+      PrestoExchangeSource::shouldPrefetch(4 * kPageBytes, kPageBytes, 4));
+  ASSERT_FALSE(
+      PrestoExchangeSource::shouldPrefetch(16 * kPageBytes, kPageBytes, 4));
+}
+
+TEST_F(PrestoExchangeSourceTest, shouldThrottleRequest) {
+  const int64_t kBudget = 100 << 20;
+  // Unlimited budget.
+  ASSERT_FALSE(PrestoExchangeSource::shouldThrottleRequest(
+      2 * kBudget, 2 * kBudget, 1, 1 << 20, 0));
+  // Within budget.
+  ASSERT_FALSE(PrestoExchangeSource::shouldThrottleRequest(
+      kBudget - 1, kBudget - 1, 1, 1 << 20, kBudget));
+  // Over budget and the query holds more than its fair share.
+  ASSERT_TRUE(PrestoExchangeSource::shouldThrottleRequest(
+      kBudget, kBudget / 2, 2, 1 << 20, kBudget));
+  ASSERT_TRUE(PrestoExchangeSource::shouldThrottleRequest(
+      kBudget, kBudget, 1, 1 << 20, kBudget));
+  // Over budget but the query holds less than its fair share.
+  ASSERT_FALSE(PrestoExchangeSource::shouldThrottleRequest(
+      kBudget, kBudget / 4, 2, 1 << 20, kBudget));
+  // Over budget but the consumer has nothing queued.
+  ASSERT_FALSE(PrestoExchangeSource::shouldThrottleRequest(
+      kBudget, kBudget, 1, 0, kBudget));
+}
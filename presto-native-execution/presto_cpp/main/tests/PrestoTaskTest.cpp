@@ -37,6 +37,17 @@ TEST_F(PrestoTaskTest, malformedTaskId) {
   ASSERT_THROW(PrestoTaskId("q.1.2"), std::invalid_argument);
 }
 
+TEST_F(PrestoTaskTest, taskIdHash) {
+  facebook::presto::TaskIdHash hash;
+  const std::string taskId{"20201107_130540_00011_wrpkw.1.2.3"};
+  EXPECT_EQ(hash(taskId), hash(std::string(taskId)));
+  EXPECT_NE(hash(taskId), hash("20201107_130540_00011_wrpkw.1.2.4"));
+
+  facebook::presto::TaskMap taskMap;
+  taskMap[taskId] = nullptr;
+  EXPECT_EQ(taskMap.count("20201107_130540_00011_wrpkw.1.2.3"), 1);
+}
+
 TEST_F(PrestoTaskTest, runtimeMetricConversion) {
   RuntimeMetric veloxMetric;
   veloxMetric.unit = RuntimeCounter::Unit::kBytes;
@@ -54,3 +65,44 @@ TEST_F(PrestoTaskTest, runtimeMetricConversion) {
   EXPECT_EQ(veloxMetric.max, prestoMetric.max);
   EXPECT_EQ(veloxMetric.min, prestoMetric.min);
 }
+
+TEST_F(PrestoTaskTest, versionedJson) {
+  VersionedJson versions;
+  nlohmann::json document = {{"state", "RUNNING"}, {"rows", 10}};
+
+  // The first request knows no version and gets the whole document.
+  auto update = versions.update(document, 0);
+  EXPECT_EQ(update.version, 1);
+  EXPECT_FALSE(update.notModified);
+  EXPECT_FALSE(update.delta);
+  EXPECT_EQ(update.body, document);
+
+  // Unchanged document.
+  update = versions.update(document, 1);
+  EXPECT_EQ(update.version, 1);
+  EXPECT_TRUE(update.notModified);
+  EXPECT_TRUE(update.body.is_null());
+
+  // Changed document is sent as a patch to the known version.
+  auto previous = document;
+  document["rows"] = 20;
+  update = versions.update(document, 1);
+  EXPECT_EQ(update.version, 2);
+  EXPECT_FALSE(update.notModified);
+  EXPECT_TRUE(update.delta);
+  EXPECT_EQ(update.body.size(), 1);
+  EXPECT_EQ(previous.patch(update.body), document);
+
+  // A client which knows an older version gets the whole document.
+  document["state"] = "FINISHED";
+  update = versions.update(document, 1);
+  EXPECT_EQ(update.version, 3);
+  EXPECT_FALSE(update.delta);
+  EXPECT_EQ(update.body, document);
+
+  update = versions.update(document, 2);
+  EXPECT_EQ(update.version, 3);
+  EXPECT_FALSE(update.notModified);
+  EXPECT_FALSE(update.delta);
+  EXPECT_EQ(update.body, document);
+}
@@ -0,0 +1,146 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/PrometheusStatsReporter.h"
+#include <fmt/format.h>
+#include <gtest/gtest.h>
+#include <thread>
+
+using namespace facebook::presto;
+using facebook::velox::StatType;
+
+TEST(PrometheusStatsReporterTest, sanitizeName) {
+  EXPECT_EQ(
+      PrometheusStatsReporter::sanitizeName("presto_cpp.num_tasks"),
+      "presto_cpp_num_tasks");
+  EXPECT_EQ(
+      PrometheusStatsReporter::sanitizeName("presto_cpp.table.db/t-1"),
+      "presto_cpp_table_db_t_1");
+  EXPECT_EQ(PrometheusStatsReporter::sanitizeName("1a:b"), "_a:b");
+}
+
+TEST(PrometheusStatsReporterTest, stats) {
+  PrometheusStatsReporter reporter;
+  reporter.addStatExportType("presto_cpp.avg", StatType::AVG);
+  reporter.addStatExportType("presto_cpp.count", StatType::COUNT);
+  reporter.addStatExportType("presto_cpp.sum", StatType::SUM);
+
+  reporter.addStatValue("presto_cpp.avg", 10);
+  reporter.addStatValue(std::string("presto_cpp.avg"), 20);
+  reporter.addStatValue("presto_cpp.count", 10);
+  reporter.addStatValue("presto_cpp.count");
+  reporter.addStatValue("presto_cpp.sum", 10);
+  reporter.addStatValue("presto_cpp.sum", 5);
+  // Not registered.
+  reporter.addStatValue("presto_cpp.other", 7);
+
+  EXPECT_EQ(
+      reporter.toPrometheusText(),
+      "# TYPE presto_cpp_avg summary\n"
+      "presto_cpp_avg_sum 30\n"
+      "presto_cpp_avg_count 2\n"
+      "# TYPE presto_cpp_count counter\n"
+      "presto_cpp_count 2\n"
+      "# TYPE presto_cpp_other summary\n"
+      "presto_cpp_other_sum 7\n"
+      "presto_cpp_other_count 1\n"
+      "# TYPE presto_cpp_sum counter\n"
+      "presto_cpp_sum 15\n");
+}
+
+TEST(PrometheusStatsReporterTest, histogram) {
+  PrometheusStatsReporter reporter;
+  reporter.addHistogramExportPercentile(
+      "presto_cpp.latency_ms", 10, 0, 30, {50, 99});
+  for (auto value : {0, 5, 10, 11, 25, 100}) {
+    reporter.addHistogramValue("presto_cpp.latency_ms", value);
+  }
+
+  EXPECT_EQ(
+      reporter.toPrometheusText(),
+      "# TYPE presto_cpp_latency_ms histogram\n"
+      "presto_cpp_latency_ms_bucket{le=\"10\"} 3\n"
+      "presto_cpp_latency_ms_bucket{le=\"20\"} 4\n"
+      "presto_cpp_latency_ms_bucket{le=\"30\"} 5\n"
+      "presto_cpp_latency_ms_bucket{le=\"+Inf\"} 6\n"
+      "presto_cpp_latency_ms_sum 151\n"
+      "presto_cpp_latency_ms_count 6\n");
+
+  // The buckets are widened to keep at most kMaxHistogramBuckets of them.
+  reporter.addHistogramExportPercentile(
+      "presto_cpp.bytes", 1, 0, 1'000'000, {50});
+  const auto text = reporter.toPrometheusText();
+  size_t numBuckets = 0;
+  for (auto pos = text.find("presto_cpp_bytes_bucket");
+       pos != std::string::npos;
+       pos = text.find("presto_cpp_bytes_bucket", pos + 1)) {
+    ++numBuckets;
+  }
+  EXPECT_EQ(numBuckets, PrometheusStatsReporter::kMaxHistogramBuckets + 1);
+}
+
+TEST(PrometheusStatsReporterTest, statsCounter) {
+  auto reporter = std::make_shared<PrometheusStatsReporter>();
+  reporter->addStatExportType("presto_cpp.count", StatType::COUNT);
+  reporter->addHistogramExportPercentile(
+      "presto_cpp.latency_ms", 10, 0, 20, {50});
+
+  const StatsCounter count("presto_cpp.count", reporter);
+  const StatsCounter latency("presto_cpp.latency_ms", reporter);
+  // Not registered.
+  const StatsCounter other("presto_cpp.other", reporter);
+  count.addValue();
+  count.addValue(10);
+  latency.addHistogramValue(5);
+  latency.addHistogramValue(15);
+  other.addValue(7);
+  // The counters add to the same metrics as the keys.
+  reporter->addStatValue("presto_cpp.count");
+
+  EXPECT_EQ(
+      reporter->toPrometheusText(),
+      "# TYPE presto_cpp_count counter\n"
+      "presto_cpp_count 3\n"
+      "# TYPE presto_cpp_latency_ms histogram\n"
+      "presto_cpp_latency_ms_bucket{le=\"10\"} 1\n"
+      "presto_cpp_latency_ms_bucket{le=\"20\"} 2\n"
+      "presto_cpp_latency_ms_bucket{le=\"+Inf\"} 2\n"
+      "presto_cpp_latency_ms_sum 20\n"
+      "presto_cpp_latency_ms_count 2\n"
+      "# TYPE presto_cpp_other summary\n"
+      "presto_cpp_other_sum 7\n"
+      "presto_cpp_other_count 1\n");
+}
+
+TEST(PrometheusStatsReporterTest, concurrent) {
+  PrometheusStatsReporter reporter;
+  reporter.addStatExportType("presto_cpp.sum", StatType::SUM);
+  constexpr int kNumThreads = 8;
+  constexpr int kNumValues = 10'000;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kNumThreads; ++i) {
+    threads.emplace_back([&]() {
+      for (int j = 0; j < kNumValues; ++j) {
+        reporter.addStatValue("presto_cpp.sum", 1);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(
+      reporter.toPrometheusText(),
+      fmt::format(
+          "# TYPE presto_cpp_sum counter\npresto_cpp_sum {}\n",
+          kNumThreads * kNumValues));
+}
@@ -117,3 +117,77 @@ TEST(QueryContextCacheTest, eviction) {
   verifyQueryCtxCache(queryContextCache, queryCtxs, 0, 20);
   EXPECT_EQ(queryContextCache.size(), 0);
 }
+
+TEST(QueryContextCacheTest, eraseExpired) {
+  QueryContextCache queryContextCache(8);
+  auto queryCtx = std::make_shared<core::QueryCtx>();
+  queryContextCache.insert("query-0", queryCtx);
+  queryContextCache.insert("query-1", std::make_shared<core::QueryCtx>());
+  EXPECT_EQ(queryContextCache.size(), 2);
+
+  // The live contexts and the unknown queries are kept as they are.
+  EXPECT_FALSE(queryContextCache.eraseExpired("query-0"));
+  EXPECT_FALSE(queryContextCache.eraseExpired("query-2"));
+  EXPECT_TRUE(queryContextCache.eraseExpired("query-1"));
+  EXPECT_EQ(queryContextCache.size(), 1);
+
+  // The freed slot is reused without growing the capacity.
+  for (int i = 2; i < 9; ++i) {
+    auto queryId = fmt::format("query-{}", i);
+    queryContextCache.insert(queryId, queryCtx);
+  }
+  EXPECT_EQ(queryContextCache.size(), 8);
+  EXPECT_EQ(queryContextCache.capacity(), 8);
+  EXPECT_EQ(queryContextCache.get("query-0").get(), queryCtx.get());
+}
+
+TEST(QueryContextCacheTest, partialAggregationConfigs) {
+  auto configs = [](std::unordered_map<std::string, std::string> session) {
+    QueryContextManager::addPartialAggregationConfigs(session);
+    return std::make_pair(
+        session.at(core::QueryConfig::kAbandonPartialAggregationMinRows),
+        session.at(core::QueryConfig::kAbandonPartialAggregationMinPct));
+  };
+  // The system config defaults.
+  EXPECT_EQ(
+      configs({}), std::make_pair(std::string("100000"), std::string("80")));
+  // The session disables the abandonment or sets the unique rows ratio.
+  EXPECT_EQ(
+      configs({{QueryContextManager::kAdaptivePartialAggregation, "false"}})
+          .first,
+      std::to_string(std::numeric_limits<int64_t>::max()));
+  EXPECT_EQ(
+      configs({{QueryContextManager::kAdaptivePartialAggregationUniqueRowsRatio,
+                "0.5"}})
+          .second,
+      "50");
+  // The Velox configs of the session are kept.
+  EXPECT_EQ(
+      configs({{core::QueryConfig::kAbandonPartialAggregationMinRows, "10"}})
+          .first,
+      "10");
+}
+
+TEST(QueryContextCacheTest, spillMemoryThreshold) {
+  constexpr int64_t kGB = 1L << 30;
+  constexpr auto kMin = QueryContextManager::kMinSpillMemoryThreshold;
+  // An idle node grants up to the per-node limit.
+  EXPECT_EQ(
+      QueryContextManager::spillMemoryThreshold(64 * kGB, 0, 0, 16 * kGB),
+      16 * kGB);
+  // The memory left by the running queries is shared with the new query.
+  EXPECT_EQ(
+      QueryContextManager::spillMemoryThreshold(
+          64 * kGB, 40 * kGB, 3, 16 * kGB),
+      6 * kGB);
+  // A node under pressure still grants the minimum.
+  EXPECT_EQ(
+      QueryContextManager::spillMemoryThreshold(
+          64 * kGB, 70 * kGB, 8, 16 * kGB),
+      kMin);
+  // Which is bound by the per-node limit.
+  EXPECT_EQ(
+      QueryContextManager::spillMemoryThreshold(
+          64 * kGB, 70 * kGB, 8, kMin / 2),
+      kMin / 2);
+}
@@ -0,0 +1,90 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/QueryResourceLedger.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+
+using namespace facebook::presto;
+
+namespace {
+QueryResourceLedger::Resources makeTask(
+    int64_t cpuNanos,
+    int64_t peakMemoryBytes) {
+  QueryResourceLedger::Resources resources;
+  resources.numTasks = 1;
+  resources.cpuNanos = cpuNanos;
+  resources.wallNanos = 2 * cpuNanos;
+  resources.peakMemoryBytes = peakMemoryBytes;
+  resources.spilledBytes = 10;
+  resources.exchangeInputBytes = 100;
+  resources.exchangeOutputBytes = 1'000;
+  return resources;
+}
+} // namespace
+
+TEST(QueryResourceLedgerTest, record) {
+  QueryResourceLedger ledger(1'000);
+  ledger.record("q1", makeTask(5, 300), 100);
+  ledger.record("q2", makeTask(1, 100), 200);
+  ledger.record("q1", makeTask(7, 200), 300);
+
+  auto queries = ledger.snapshot(400);
+  std::sort(queries.begin(), queries.end(), [](auto& a, auto& b) {
+    return a.first < b.first;
+  });
+  ASSERT_EQ(queries.size(), 2);
+  const auto& q1 = queries[0].second;
+  EXPECT_EQ(queries[0].first, "q1");
+  EXPECT_EQ(q1.numTasks, 2);
+  EXPECT_EQ(q1.cpuNanos, 12);
+  EXPECT_EQ(q1.wallNanos, 24);
+  // The peak is the largest of the tasks, not their sum.
+  EXPECT_EQ(q1.peakMemoryBytes, 300);
+  EXPECT_EQ(q1.spilledBytes, 20);
+  EXPECT_EQ(q1.exchangeInputBytes, 200);
+  EXPECT_EQ(q1.exchangeOutputBytes, 2'000);
+  EXPECT_EQ(q1.lastUpdateMs, 300);
+  EXPECT_EQ(queries[1].first, "q2");
+  EXPECT_EQ(queries[1].second.cpuNanos, 1);
+  EXPECT_EQ(ledger.totalSpilledBytes(), 30);
+}
+
+TEST(QueryResourceLedgerTest, retention) {
+  QueryResourceLedger ledger(1'000);
+  ledger.record("q1", makeTask(5, 300), 100);
+  ledger.record("q2", makeTask(1, 100), 900);
+
+  EXPECT_EQ(ledger.snapshot(1'100).size(), 2);
+  // q1 is forgotten 1s after its last task.
+  const auto queries = ledger.snapshot(1'200);
+  ASSERT_EQ(queries.size(), 1);
+  EXPECT_EQ(queries[0].first, "q2");
+  EXPECT_EQ(ledger.snapshot(1'200).size(), 1);
+  EXPECT_TRUE(ledger.snapshot(2'000).empty());
+  // The node total keeps the forgotten queries.
+  EXPECT_EQ(ledger.totalSpilledBytes(), 20);
+}
+
+TEST(QueryResourceLedgerTest, pruneOnRecord) {
+  QueryResourceLedger ledger(1'000);
+  ledger.record("q1", makeTask(5, 300), 100);
+  ledger.record("q2", makeTask(1, 100), 900);
+  EXPECT_EQ(ledger.numQueries(), 2);
+
+  // The expired q1 is forgotten by a later task without any snapshot.
+  ledger.record("q3", makeTask(1, 100), 1'500);
+  EXPECT_EQ(ledger.numQueries(), 2);
+  ledger.record("q4", makeTask(1, 100), 3'000);
+  EXPECT_EQ(ledger.numQueries(), 1);
+}
@@ -0,0 +1,47 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/tests/ScopedSystemConfig.h"
+#include <fstream>
+#include "presto_cpp/main/common/Configs.h"
+
+namespace facebook::presto::test {
+
+ScopedSystemConfig::ScopedSystemConfig(
+    const std::vector<std::pair<std::string_view, std::string>>& overrides)
+    : directory_(velox::exec::test::TempDirectoryPath::create()),
+      previous_(SystemConfig::instance()->values()) {
+  auto properties = previous_;
+  for (const auto& [name, value] : overrides) {
+    properties[std::string(name)] = value;
+  }
+  initialize(properties, "config.properties");
+}
+
+ScopedSystemConfig::~ScopedSystemConfig() {
+  initialize(previous_, "previous.properties");
+}
+
+void ScopedSystemConfig::initialize(
+    const std::unordered_map<std::string, std::string>& properties,
+    const std::string& fileName) {
+  const auto filePath = fmt::format("{}/{}", directory_->path, fileName);
+  {
+    std::ofstream file(filePath);
+    for (const auto& [name, value] : properties) {
+      file << name << "=" << value << "\n";
+    }
+  }
+  SystemConfig::instance()->initialize(filePath);
+}
+} // namespace facebook::presto::test
@@ -0,0 +1,46 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "velox/exec/tests/utils/TempDirectoryPath.h"
+
+namespace facebook::presto::test {
+
+/// Sets 'overrides' on top of the current SystemConfig properties by
+/// initializing it from a config.properties file in a temporary directory.
+/// Restores the previous properties on destruction so that the overrides do
+/// not leak into the other tests of the binary.
+class ScopedSystemConfig {
+ public:
+  explicit ScopedSystemConfig(
+      const std::vector<std::pair<std::string_view, std::string>>& overrides);
+
+  ~ScopedSystemConfig();
+
+ private:
+  void initialize(
+      const std::unordered_map<std::string, std::string>& properties,
+      const std::string& fileName);
+
+  const std::shared_ptr<velox::exec::test::TempDirectoryPath> directory_;
+  const std::unordered_map<std::string, std::string> previous_;
+};
+} // namespace facebook::presto::test
@@ -0,0 +1,164 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/SharedBroadcastExchangeSource.h"
+#include <gtest/gtest.h>
+#include "velox/common/base/tests/GTestUtils.h"
+
+using namespace facebook::presto;
+using namespace facebook::velox;
+
+namespace {
+std::unique_ptr<folly::IOBuf> makePage(const std::string& data) {
+  return folly::IOBuf::copyBuffer(data);
+}
+
+std::vector<std::unique_ptr<folly::IOBuf>> makePages(
+    const std::vector<std::string>& data) {
+  std::vector<std::unique_ptr<folly::IOBuf>> pages;
+  for (const auto& page : data) {
+    pages.push_back(makePage(page));
+  }
+  return pages;
+}
+
+// Returns the contents of the pages in 'queue' and sets 'atEnd' if the end
+// marker was enqueued.
+std::vector<std::string> readPages(
+    const std::shared_ptr<exec::ExchangeQueue>& queue,
+    bool& atEnd) {
+  std::vector<std::string> contents;
+  ContinueFuture future;
+  while (auto page = queue->dequeueLocked(&atEnd, &future)) {
+    contents.push_back(page->getIOBuf()->moveToFbString().toStdString());
+  }
+  return contents;
+}
+
+std::vector<std::string> readPages(
+    const std::shared_ptr<exec::ExchangeQueue>& queue) {
+  bool atEnd;
+  return readPages(queue, atEnd);
+}
+} // namespace
+
+class SharedBroadcastExchangeSourceTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    pool_ = memory::addDefaultLeafMemoryPool("SharedBroadcastExchangeSource");
+    broadcast_ = std::make_shared<SharedBroadcastExchangeSource::Broadcast>();
+  }
+
+  std::shared_ptr<exec::ExchangeQueue> makeQueue() {
+    auto queue = std::make_shared<exec::ExchangeQueue>(1 << 20);
+    queue->addSourceLocked();
+    queue->noMoreSources();
+    return queue;
+  }
+
+  std::shared_ptr<SharedBroadcastExchangeSource> makeSource(
+      const std::shared_ptr<exec::ExchangeQueue>& queue) {
+    return std::make_shared<SharedBroadcastExchangeSource>(
+        "20201007_190402_00000_r5erw.1.0.0",
+        0,
+        queue,
+        pool_.get(),
+        broadcast_,
+        nullptr);
+  }
+
+  static void request(SharedBroadcastExchangeSource& source) {
+    if (source.shouldRequestLocked()) {
+      source.request();
+    }
+  }
+
+  std::shared_ptr<memory::MemoryPool> pool_;
+  std::shared_ptr<SharedBroadcastExchangeSource::Broadcast> broadcast_;
+};
+
+TEST_F(SharedBroadcastExchangeSourceTest, sharedPages) {
+  auto firstQueue = makeQueue();
+  auto secondQueue = makeQueue();
+  auto first = makeSource(firstQueue);
+  auto second = makeSource(secondQueue);
+
+  // The first source waits for the pages to be published.
+  request(*first);
+  EXPECT_TRUE(readPages(firstQueue).empty());
+  broadcast_->publish(makePages({"a", "b"}), false, "");
+  EXPECT_EQ(readPages(firstQueue), (std::vector<std::string>{"a", "b"}));
+
+  // The second source gets the pages published before it was created.
+  request(*second);
+  EXPECT_EQ(readPages(secondQueue), (std::vector<std::string>{"a", "b"}));
+
+  broadcast_->publish(makePages({"c"}), true, "");
+  for (const auto& [source, queue] :
+       {std::make_pair(first, firstQueue),
+        std::make_pair(second, secondQueue)}) {
+    request(*source);
+    bool atEnd = false;
+    EXPECT_EQ(readPages(queue, atEnd), std::vector<std::string>{"c"});
+    EXPECT_TRUE(atEnd);
+    EXPECT_FALSE(source->shouldRequestLocked());
+  }
+}
+
+TEST_F(SharedBroadcastExchangeSourceTest, error) {
+  auto queue = makeQueue();
+  auto source = makeSource(queue);
+  request(*source);
+  broadcast_->publish({}, false, "Producer failed");
+  VELOX_ASSERT_THROW(readPages(queue), "Producer failed");
+
+  // The sources created after the failure fail too.
+  auto lateQueue = makeQueue();
+  request(*makeSource(lateQueue));
+  VELOX_ASSERT_THROW(readPages(lateQueue), "Producer failed");
+}
+
+TEST_F(SharedBroadcastExchangeSourceTest, close) {
+  auto queue = makeQueue();
+  auto source = makeSource(queue);
+  request(*source);
+  source->close();
+  broadcast_->publish(makePages({"a"}), true, "");
+  bool atEnd = false;
+  EXPECT_TRUE(readPages(queue, atEnd).empty());
+  EXPECT_FALSE(atEnd);
+}
+
+TEST_F(SharedBroadcastExchangeSourceTest, closeReleasesWaiter) {
+  auto queue = makeQueue();
+  auto source = makeSource(queue);
+  request(*source);
+  std::weak_ptr<SharedBroadcastExchangeSource> weakSource = source;
+  // A closed source is no longer held by the broadcast it waits on.
+  source->close();
+  source.reset();
+  EXPECT_TRUE(weakSource.expired());
+}
+
+TEST_F(SharedBroadcastExchangeSourceTest, queries) {
+  const auto numQueries = SharedBroadcastExchangeSource::numQueries();
+  SharedBroadcastExchangeSource::addQuery("query1", {"1", "2"});
+  SharedBroadcastExchangeSource::addQuery("query1", {"3"});
+  SharedBroadcastExchangeSource::addQuery("query2", {"1"});
+  EXPECT_EQ(SharedBroadcastExchangeSource::numQueries(), numQueries + 2);
+  SharedBroadcastExchangeSource::removeQuery("query1");
+  SharedBroadcastExchangeSource::removeQuery("query3");
+  EXPECT_EQ(SharedBroadcastExchangeSource::numQueries(), numQueries + 1);
+  SharedBroadcastExchangeSource::removeQuery("query2");
+  EXPECT_EQ(SharedBroadcastExchangeSource::numQueries(), numQueries);
+}
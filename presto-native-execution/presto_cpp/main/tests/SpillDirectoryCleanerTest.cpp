@@ -0,0 +1,95 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/SpillDirectoryCleaner.h"
+#include <fmt/format.h>
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include <filesystem>
+#include <fstream>
+
+using namespace facebook::presto;
+using namespace std::chrono_literals;
+namespace fs = std::filesystem;
+
+class SpillDirectoryCleanerTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    base_ = fs::temp_directory_path() /
+        fmt::format("spill_cleaner_test_{}", getpid());
+    fs::remove_all(base_);
+  }
+
+  void TearDown() override {
+    fs::remove_all(base_);
+  }
+
+  // Creates the spill directory of 'taskId' with a file of 'bytes', last
+  // modified 'age' ago.
+  fs::path makeTaskDirectory(
+      const std::string& queryId,
+      const std::string& taskId,
+      size_t bytes,
+      std::chrono::seconds age) {
+    const auto path =
+        base_ / "2023-01-01" / "presto_native" / queryId / taskId;
+    fs::create_directories(path);
+    std::ofstream(path / "spill_0") << std::string(bytes, 'x');
+    fs::last_write_time(path, fs::file_time_type::clock::now() - age);
+    return path;
+  }
+
+  fs::path base_;
+};
+
+TEST_F(SpillDirectoryCleanerTest, basic) {
+  const auto orphan = makeTaskDirectory("q1", "q1.0.0.1", 100, 1h);
+  const auto live = makeTaskDirectory("q1", "q1.0.0.2", 200, 1h);
+  const auto recent = makeTaskDirectory("q2", "q2.0.0.1", 300, 1s);
+
+  auto stats = cleanupSpillDirectories(
+      base_.string(),
+      [](const std::string& taskId) { return taskId == "q1.0.0.2"; },
+      std::chrono::seconds(600));
+  EXPECT_EQ(stats.numDirectories, 1);
+  EXPECT_EQ(stats.bytes, 100);
+  EXPECT_FALSE(fs::exists(orphan));
+  EXPECT_TRUE(fs::exists(live));
+  EXPECT_TRUE(fs::exists(recent));
+
+  // With no live task and no minimum age the emptied parents go too.
+  stats = cleanupSpillDirectories(
+      base_.string(),
+      [](const std::string& /*taskId*/) { return false; },
+      std::chrono::seconds(0));
+  EXPECT_EQ(stats.numDirectories, 2);
+  EXPECT_EQ(stats.bytes, 500);
+  EXPECT_TRUE(fs::exists(base_));
+  EXPECT_TRUE(fs::is_empty(base_));
+}
+
+TEST_F(SpillDirectoryCleanerTest, nonLocalPath) {
+  const auto stats = cleanupSpillDirectories(
+      "s3://bucket/spill",
+      [](const std::string& /*taskId*/) { return false; },
+      std::chrono::seconds(0));
+  EXPECT_EQ(stats.numDirectories, 0);
+  // A missing base directory is not an error.
+  EXPECT_EQ(
+      cleanupSpillDirectories(
+          base_.string(),
+          [](const std::string& /*taskId*/) { return false; },
+          std::chrono::seconds(0))
+          .numDirectories,
+      0);
+}
@@ -0,0 +1,117 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/SpillPathSelector.h"
+#include <gtest/gtest.h>
+#include <unordered_map>
+#include "velox/common/base/Exceptions.h"
+
+using namespace facebook::presto;
+
+namespace {
+SpillPathSelector::FreeBytesFunc makeFreeBytes(
+    std::unordered_map<std::string, std::optional<uint64_t>>& freeBytes) {
+  return [&freeBytes](const std::string& path) { return freeBytes.at(path); };
+}
+} // namespace
+
+TEST(SpillPathSelectorTest, roundRobin) {
+  SpillPathSelector selector({"/a", "/b", "/c"});
+  EXPECT_EQ(selector.size(), 3);
+  EXPECT_EQ(selector.next(), "/a");
+  EXPECT_EQ(selector.next(), "/b");
+  EXPECT_EQ(selector.next(), "/c");
+  EXPECT_EQ(selector.next(), "/a");
+
+  selector.markUnhealthy("/b");
+  EXPECT_EQ(selector.next(), "/c");
+  EXPECT_EQ(selector.next(), "/a");
+  EXPECT_EQ(selector.next(), "/c");
+
+  const auto stats = selector.stats();
+  ASSERT_EQ(stats.size(), 3);
+  EXPECT_EQ(stats[0].numAssigned, 3);
+  EXPECT_FALSE(stats[1].healthy);
+  EXPECT_EQ(stats[1].numAssigned, 1);
+  EXPECT_EQ(stats[2].numAssigned, 3);
+
+  selector.markUnhealthy("/a");
+  selector.markUnhealthy("/c");
+  EXPECT_EQ(selector.next(), "");
+
+  EXPECT_TRUE(SpillPathSelector({}).empty());
+  EXPECT_EQ(SpillPathSelector({}).next(), "");
+}
+
+TEST(SpillPathSelectorTest, retry) {
+  SpillPathSelector selector(
+      {"/a", "/b"},
+      SpillPathSelector::Policy::kRoundRobin,
+      0,
+      nullptr,
+      0 /*retryMs*/);
+  selector.markUnhealthy("/a");
+  // Back in the rotation right away with no retry time.
+  EXPECT_EQ(selector.next(), "/a");
+  EXPECT_EQ(selector.next(), "/b");
+}
+
+TEST(SpillPathSelectorTest, freeSpace) {
+  std::unordered_map<std::string, std::optional<uint64_t>> freeBytes{
+      {"/a", 300}, {"/b", 100}, {"/c", 10}, {"remote://d", std::nullopt}};
+  SpillPathSelector selector(
+      {"/a", "/b", "/c", "remote://d"},
+      SpillPathSelector::Policy::kFreeSpace,
+      50,
+      makeFreeBytes(freeBytes));
+
+  // Round robin until the free space is known.
+  EXPECT_EQ(selector.next(), "/a");
+  EXPECT_EQ(selector.next(), "/b");
+
+  // '/c' is below the minimum and the free space of 'remote://d' is unknown.
+  selector.refresh();
+  std::unordered_map<std::string, int32_t> counts;
+  constexpr int32_t kNumTasks = 10'000;
+  for (int32_t i = 0; i < kNumTasks; ++i) {
+    ++counts[selector.next()];
+  }
+  EXPECT_EQ(counts.size(), 2);
+  EXPECT_NEAR(counts["/a"], kNumTasks * 3 / 4, kNumTasks / 20);
+  EXPECT_NEAR(counts["/b"], kNumTasks / 4, kNumTasks / 20);
+
+  const auto stats = selector.stats();
+  EXPECT_EQ(stats[0].freeBytes, 300);
+  EXPECT_TRUE(stats[0].healthy);
+  EXPECT_FALSE(stats[2].healthy);
+  EXPECT_TRUE(stats[3].healthy);
+  EXPECT_EQ(stats[3].freeBytes, 0);
+
+  // A failed read of the free space takes the path out.
+  freeBytes["/a"] = 0;
+  selector.refresh();
+  EXPECT_EQ(selector.next(), "/b");
+  EXPECT_FALSE(selector.stats()[0].healthy);
+}
+
+TEST(SpillPathSelectorTest, policyFromString) {
+  EXPECT_EQ(
+      SpillPathSelector::policyFromString("round-robin"),
+      SpillPathSelector::Policy::kRoundRobin);
+  EXPECT_EQ(
+      SpillPathSelector::policyFromString("free-space"),
+      SpillPathSelector::Policy::kFreeSpace);
+  EXPECT_THROW(
+      SpillPathSelector::policyFromString("random"),
+      facebook::velox::VeloxUserError);
+}
@@ -0,0 +1,82 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/SpillQuota.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+
+using namespace facebook::presto;
+
+namespace {
+std::vector<std::string> sorted(std::vector<std::string> queryIds) {
+  std::sort(queryIds.begin(), queryIds.end());
+  return queryIds;
+}
+} // namespace
+
+TEST(SpillQuotaTest, unlimited) {
+  SpillQuota quota(0, 0);
+  EXPECT_FALSE(quota.enabled());
+  EXPECT_TRUE(quota.update({{"q1", 1'000}, {"q2", 2'000}}).empty());
+  EXPECT_EQ(quota.nodeBytes(), 3'000);
+  EXPECT_EQ(quota.queryBytes("q2"), 2'000);
+  EXPECT_EQ(quota.queryBytes("q3"), 0);
+  EXPECT_TRUE(quota.canSpill("q1"));
+}
+
+TEST(SpillQuotaTest, perQuery) {
+  SpillQuota quota(0, 1'000);
+  EXPECT_TRUE(quota.enabled());
+  EXPECT_EQ(
+      sorted(quota.update({{"q1", 1'001}, {"q2", 1'000}, {"q3", 5'000}})),
+      std::vector<std::string>({"q1", "q3"}));
+  EXPECT_FALSE(quota.canSpill("q1"));
+  // At the limit the new tasks do not spill, but the query is not failed.
+  EXPECT_FALSE(quota.canSpill("q2"));
+  EXPECT_TRUE(quota.canSpill("q4"));
+
+  // The spill files are gone with the tasks.
+  EXPECT_TRUE(quota.update({{"q2", 10}}).empty());
+  EXPECT_TRUE(quota.canSpill("q1"));
+  EXPECT_TRUE(quota.canSpill("q2"));
+}
+
+TEST(SpillQuotaTest, perNode) {
+  SpillQuota quota(1'000, 0);
+  EXPECT_TRUE(quota.update({{"q1", 400}, {"q2", 500}}).empty());
+  EXPECT_TRUE(quota.canSpill("q3"));
+
+  // The largest spillers are failed until the rest fits.
+  EXPECT_EQ(
+      sorted(quota.update({{"q1", 400}, {"q2", 500}, {"q3", 300}})),
+      std::vector<std::string>({"q2"}));
+  EXPECT_EQ(quota.nodeBytes(), 1'200);
+  EXPECT_FALSE(quota.canSpill("q1"));
+  EXPECT_FALSE(quota.canSpill("q4"));
+
+  EXPECT_EQ(
+      sorted(quota.update({{"q1", 900}, {"q2", 800}, {"q3", 700}})),
+      std::vector<std::string>({"q1", "q2"}));
+}
+
+TEST(SpillQuotaTest, perQueryAndNode) {
+  SpillQuota quota(1'000, 600);
+  // The query over its own limit is failed first, which brings the node back
+  // under its limit.
+  EXPECT_EQ(
+      sorted(quota.update({{"q1", 700}, {"q2", 500}})),
+      std::vector<std::string>({"q1"}));
+  EXPECT_EQ(
+      sorted(quota.update({{"q1", 700}, {"q2", 500}, {"q3", 550}})),
+      std::vector<std::string>({"q1", "q3"}));
+}
@@ -0,0 +1,117 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <gtest/gtest.h>
+
+#include "presto_cpp/main/SplitPruner.h"
+#include "velox/connectors/hive/HiveConnector.h"
+#include "velox/connectors/hive/HiveConnectorSplit.h"
+
+using namespace facebook::presto;
+using namespace facebook::velox;
+using connector::hive::HiveColumnHandle;
+
+class SplitPrunerTest : public ::testing::Test {
+ protected:
+  // Returns a table scan of a table partitioned by 'ds' and 'hour', with the
+  // regular column 'c0' and 'filters'. The output variables are named unlike
+  // the columns, as the plan converter names them.
+  static core::PlanNodePtr makeTableScan(
+      connector::hive::SubfieldFilters filters) {
+    auto tableHandle = std::make_shared<connector::hive::HiveTableHandle>(
+        "hive", "t", true, std::move(filters), nullptr);
+    std::unordered_map<std::string, std::shared_ptr<connector::ColumnHandle>>
+        assignments{
+            {"c0_0",
+             std::make_shared<HiveColumnHandle>(
+                 "c0",
+                 HiveColumnHandle::ColumnType::kRegular,
+                 BIGINT(),
+                 std::vector<common::Subfield>{})},
+            {"ds_1",
+             std::make_shared<HiveColumnHandle>(
+                 "ds",
+                 HiveColumnHandle::ColumnType::kPartitionKey,
+                 VARCHAR(),
+                 std::vector<common::Subfield>{})},
+            {"hour_2",
+             std::make_shared<HiveColumnHandle>(
+                 "hour",
+                 HiveColumnHandle::ColumnType::kPartitionKey,
+                 INTEGER(),
+                 std::vector<common::Subfield>{})}};
+    return std::make_shared<core::TableScanNode>(
+        "0",
+        ROW({"c0_0", "ds_1", "hour_2"}, {BIGINT(), VARCHAR(), INTEGER()}),
+        tableHandle,
+        assignments);
+  }
+
+  static exec::Split makeSplit(
+      const std::string& ds,
+      std::optional<std::string> hour,
+      std::optional<int> bucket = std::nullopt) {
+    return exec::Split(std::make_shared<connector::hive::HiveConnectorSplit>(
+        "hive",
+        "/file",
+        dwio::common::FileFormat::DWRF,
+        0,
+        100,
+        std::unordered_map<std::string, std::optional<std::string>>{
+            {"ds", ds}, {"hour", hour}},
+        bucket));
+  }
+};
+
+TEST_F(SplitPrunerTest, partitionKeys) {
+  connector::hive::SubfieldFilters filters;
+  filters[common::Subfield("ds")] = std::make_unique<common::BytesValues>(
+      std::vector<std::string>{"2023-01-01", "2023-01-02"}, false);
+  filters[common::Subfield("hour")] =
+      std::make_unique<common::BigintRange>(10, 12, false);
+  filters[common::Subfield("c0")] =
+      std::make_unique<common::BigintRange>(0, 0, false);
+  auto pruner = SplitPruner::create(makeTableScan(std::move(filters)));
+  ASSERT_NE(pruner, nullptr);
+
+  EXPECT_FALSE(pruner->canSkip("0", makeSplit("2023-01-01", "10")));
+  EXPECT_FALSE(pruner->canSkip("0", makeSplit("2023-01-02", "12")));
+  EXPECT_TRUE(pruner->canSkip("0", makeSplit("2023-01-03", "10")));
+  EXPECT_TRUE(pruner->canSkip("0", makeSplit("2023-01-01", "13")));
+  // The null partition values fail the filters not passing nulls.
+  EXPECT_TRUE(pruner->canSkip("0", makeSplit("2023-01-01", std::nullopt)));
+  // The values which can't be tested are kept.
+  EXPECT_FALSE(pruner->canSkip("0", makeSplit("2023-01-01", "ten")));
+  // The splits of the other plan nodes are kept.
+  EXPECT_FALSE(pruner->canSkip("1", makeSplit("2023-01-03", "10")));
+}
+
+TEST_F(SplitPrunerTest, bucket) {
+  connector::hive::SubfieldFilters filters;
+  filters[common::Subfield(std::string(SplitPruner::kBucketColumn))] =
+      std::make_unique<common::BigintRange>(3, 3, false);
+  auto pruner = SplitPruner::create(makeTableScan(std::move(filters)));
+  ASSERT_NE(pruner, nullptr);
+
+  EXPECT_FALSE(pruner->canSkip("0", makeSplit("2023-01-01", "10", 3)));
+  EXPECT_TRUE(pruner->canSkip("0", makeSplit("2023-01-01", "10", 4)));
+  EXPECT_FALSE(pruner->canSkip("0", makeSplit("2023-01-01", "10")));
+}
+
+TEST_F(SplitPrunerTest, noPartitionFilters) {
+  connector::hive::SubfieldFilters filters;
+  filters[common::Subfield("c0")] =
+      std::make_unique<common::BigintRange>(0, 0, false);
+  EXPECT_EQ(SplitPruner::create(makeTableScan(std::move(filters))), nullptr);
+  EXPECT_EQ(SplitPruner::create(makeTableScan({})), nullptr);
+}
@@ -0,0 +1,100 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/SsdCacheStriping.h"
+#include <fmt/format.h>
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+using namespace facebook::presto;
+namespace fs = std::filesystem;
+
+class SsdCacheStripingTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    base_ = fs::temp_directory_path() /
+        fmt::format("ssd_cache_striping_test_{}", getpid());
+    fs::remove_all(base_);
+    fs::create_directories(base_ / "ssd0");
+    fs::create_directories(base_ / "ssd1");
+    paths_ = {(base_ / "ssd0" / "cache").string(),
+              (base_ / "ssd1" / "cache").string()};
+  }
+
+  void TearDown() override {
+    fs::remove_all(base_);
+  }
+
+  // The file SsdCache opens for 'shard'.
+  fs::path shardFile(int32_t shard) const {
+    return fmt::format("{}{}", paths_[0], shard);
+  }
+
+  static std::string readFile(const fs::path& path) {
+    std::ifstream in(path);
+    std::stringstream contents;
+    contents << in.rdbuf();
+    return contents.str();
+  }
+
+  fs::path base_;
+  std::vector<std::string> paths_;
+};
+
+TEST_F(SsdCacheStripingTest, stripe) {
+  for (int i = 0; i < 2; ++i) {
+    EXPECT_EQ(stripeSsdCacheFiles(paths_, 4), paths_[0]);
+    for (int32_t shard : {0, 2}) {
+      EXPECT_FALSE(fs::exists(fs::symlink_status(shardFile(shard))));
+    }
+    for (int32_t shard : {1, 3}) {
+      ASSERT_TRUE(fs::is_symlink(shardFile(shard)));
+      EXPECT_EQ(
+          fs::read_symlink(shardFile(shard)),
+          fmt::format("{}{}", paths_[1], shard));
+    }
+  }
+}
+
+TEST_F(SsdCacheStripingTest, stripeUnstripedFiles) {
+  // The shard files of a cache on a single path keep their contents.
+  for (int32_t shard = 0; shard < 2; ++shard) {
+    std::ofstream(shardFile(shard)) << "shard" << shard;
+  }
+  stripeSsdCacheFiles(paths_, 2);
+  EXPECT_FALSE(fs::is_symlink(shardFile(0)));
+  EXPECT_EQ(readFile(shardFile(0)), "shard0");
+  EXPECT_TRUE(fs::is_symlink(shardFile(1)));
+  EXPECT_EQ(readFile(fmt::format("{}1", paths_[1])), "shard1");
+  EXPECT_EQ(readFile(shardFile(1)), "shard1");
+
+  // Back on a single path, the files are moved back.
+  stripeSsdCacheFiles({paths_[0]}, 2);
+  EXPECT_FALSE(fs::is_symlink(shardFile(1)));
+  EXPECT_EQ(readFile(shardFile(1)), "shard1");
+  EXPECT_FALSE(fs::exists(fmt::format("{}1", paths_[1])));
+}
+
+TEST_F(SsdCacheStripingTest, deleteUnmovableFiles) {
+  std::ofstream(shardFile(1)) << "shard1";
+  std::ofstream(shardFile(1).string() + ".cpt") << "checkpoint";
+  // The file cannot be renamed into a missing directory.
+  paths_[1] = (base_ / "missing" / "cache").string();
+  stripeSsdCacheFiles(paths_, 2);
+  EXPECT_TRUE(fs::is_symlink(shardFile(1)));
+  EXPECT_FALSE(fs::exists(shardFile(1)));
+  EXPECT_FALSE(fs::exists(shardFile(1).string() + ".cpt"));
+}
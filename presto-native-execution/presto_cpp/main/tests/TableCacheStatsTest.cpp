@@ -0,0 +1,73 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/TableCacheStats.h"
+#include <gtest/gtest.h>
+
+using namespace facebook::presto;
+
+namespace {
+TableCacheStats::Stats makeStats(
+    int64_t ramReadBytes,
+    int64_t ssdReadBytes,
+    int64_t storageReadBytes) {
+  TableCacheStats::Stats stats;
+  stats.numRamReads = ramReadBytes > 0;
+  stats.ramReadBytes = ramReadBytes;
+  stats.numSsdReads = ssdReadBytes > 0;
+  stats.ssdReadBytes = ssdReadBytes;
+  stats.numStorageReads = storageReadBytes > 0;
+  stats.storageReadBytes = storageReadBytes;
+  return stats;
+}
+} // namespace
+
+TEST(TableCacheStatsTest, aggregate) {
+  TableCacheStats tableCacheStats(8);
+  tableCacheStats.record("dim", makeStats(60, 20, 0));
+  tableCacheStats.record("fact", makeStats(0, 100, 300));
+  tableCacheStats.record("dim", makeStats(20, 0, 0));
+
+  const auto tables = tableCacheStats.topTables(8);
+  ASSERT_EQ(tables.size(), 2);
+  EXPECT_EQ(tables[0].first, "fact");
+  EXPECT_EQ(tables[0].second.totalBytes(), 400);
+  EXPECT_EQ(tables[0].second.hitPct(), 25);
+  EXPECT_EQ(tables[1].first, "dim");
+  EXPECT_EQ(tables[1].second.numRamReads, 2);
+  EXPECT_EQ(tables[1].second.ramReadBytes, 80);
+  EXPECT_EQ(tables[1].second.hitPct(), 100);
+
+  EXPECT_EQ(tableCacheStats.topTables(1).size(), 1);
+  EXPECT_EQ(TableCacheStats::Stats().hitPct(), 0);
+}
+
+TEST(TableCacheStatsTest, bounded) {
+  TableCacheStats tableCacheStats(2);
+  tableCacheStats.record("a", makeStats(0, 0, 100));
+  tableCacheStats.record("b", makeStats(0, 0, 200));
+  // Reads less than the tracked tables.
+  tableCacheStats.record("c", makeStats(0, 0, 50));
+  EXPECT_EQ(tableCacheStats.numTables(), 2);
+  // Replaces "a", which reads the least.
+  tableCacheStats.record("d", makeStats(0, 0, 150));
+
+  const auto tables = tableCacheStats.topTables(10);
+  ASSERT_EQ(tables.size(), 2);
+  EXPECT_EQ(tables[0].first, "b");
+  EXPECT_EQ(tables[1].first, "d");
+
+  TableCacheStats disabled(0);
+  disabled.record("a", makeStats(0, 0, 100));
+  EXPECT_EQ(disabled.numTables(), 0);
+}
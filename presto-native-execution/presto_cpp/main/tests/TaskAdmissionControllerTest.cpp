@@ -0,0 +1,54 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/TaskAdmissionController.h"
+#include <gtest/gtest.h>
+
+using namespace facebook::presto;
+
+TEST(TaskAdmissionControllerTest, disabled) {
+  TaskAdmissionController controller(TaskAdmissionController::Limits{});
+  EXPECT_FALSE(controller.enabled());
+  controller.update({1'000, 100, 100});
+  EXPECT_TRUE(controller.tryAdmit(16));
+}
+
+TEST(TaskAdmissionControllerTest, drivers) {
+  TaskAdmissionController controller({40, 0, 0});
+  EXPECT_TRUE(controller.enabled());
+  controller.update({10, 99, 99});
+
+  // The admitted drivers count until the next update.
+  EXPECT_TRUE(controller.tryAdmit(16));
+  EXPECT_TRUE(controller.tryAdmit(16));
+  EXPECT_FALSE(controller.tryAdmit(1));
+
+  controller.update({39, 0, 0});
+  EXPECT_TRUE(controller.tryAdmit(16));
+  EXPECT_FALSE(controller.tryAdmit(16));
+}
+
+TEST(TaskAdmissionControllerTest, memoryAndCpu) {
+  TaskAdmissionController controller({0, 80, 90});
+  controller.update({1'000, 50, 50});
+  EXPECT_TRUE(controller.tryAdmit(16));
+
+  controller.update({0, 80, 50});
+  EXPECT_FALSE(controller.tryAdmit(1));
+
+  controller.update({0, 50, 95});
+  EXPECT_FALSE(controller.tryAdmit(1));
+
+  controller.update({0, 79, 89});
+  EXPECT_TRUE(controller.tryAdmit(1));
+}
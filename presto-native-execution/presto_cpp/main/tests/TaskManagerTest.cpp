@@ -12,15 +12,23 @@
  * limitations under the License.
  */
 #include "presto_cpp/main/TaskManager.h"
+#include <folly/ScopeGuard.h>
 #include <folly/executors/ThreadedExecutor.h>
+#include <folly/io/async/ScopedEventBaseThread.h>
+#include <folly/synchronization/Baton.h>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
+#include "presto_cpp/main/InProcessExchangeSource.h"
 #include "presto_cpp/main/PrestoExchangeSource.h"
 #include "presto_cpp/main/TaskResource.h"
 #include "presto_cpp/main/common/Configs.h"
+#include "presto_cpp/main/http/HttpClient.h"
 #include "presto_cpp/main/tests/HttpServerWrapper.h"
+#include "presto_cpp/main/tests/ScopedSystemConfig.h"
 #include "velox/common/base/Fs.h"
+#include "velox/common/base/tests/GTestUtils.h"
 #include "velox/common/file/FileSystems.h"
+#include "velox/common/time/Timer.h"
 #include "velox/dwio/common/tests/utils/BatchMaker.h"
 #include "velox/dwio/dwrf/reader/DwrfReader.h"
 #include "velox/dwio/dwrf/writer/Writer.h"
@@ -170,12 +178,12 @@ class TaskManagerTest : public testing::Test {
     httpServerWrapper_ =
         std::make_unique<facebook::presto::test::HttpServerWrapper>(
             std::move(httpServer));
-    auto serverAddress = httpServerWrapper_->start().get();
+    serverAddress_ = httpServerWrapper_->start().get();
 
     taskManager_->setBaseUri(fmt::format(
         "http://{}:{}",
-        serverAddress.getAddressStr(),
-        serverAddress.getPort()));
+        serverAddress_.getAddressStr(),
+        serverAddress_.getPort()));
   }
 
   void TearDown() override {
@@ -560,6 +568,7 @@ class TaskManagerTest : public testing::Test {
   std::unique_ptr<TaskManager> taskManager_;
   std::unique_ptr<TaskResource> taskResource_;
   std::unique_ptr<facebook::presto::test::HttpServerWrapper> httpServerWrapper_;
+  folly::SocketAddress serverAddress_;
   long splitSequenceId_{0};
 };
 
@@ -589,6 +598,43 @@ TEST_F(TaskManagerTest, tableScanAllSplitsAtOnce) {
   assertResults(taskId, rowType_, "SELECT * FROM tmp WHERE c0 % 5 = 0");
 }
 
+TEST_F(TaskManagerTest, parallelSplitConversion) {
+  auto filePaths = makeFilePaths(5);
+  auto vectors = makeVectors(filePaths.size(), 1'000);
+  for (int i = 0; i < filePaths.size(); i++) {
+    writeToFile(filePaths[i]->path, vectors[i]);
+  }
+  duckDbQueryRunner_.createTable("tmp", vectors);
+
+  // Convert the splits in batches of 2.
+  facebook::presto::test::ScopedSystemConfig config(
+      {{SystemConfig::kTaskSplitConversionBatchSize, "2"}});
+
+  auto planFragment = exec::test::PlanBuilder()
+                          .tableScan(rowType_)
+                          .filter("c0 % 5 = 0")
+                          .partitionedOutput({}, 1, {"c0", "c1"})
+                          .planFragment();
+
+  long splitSequenceId{0};
+  protocol::TaskId taskId = "scan.0.0.1";
+  const auto numBatches = taskManager_->numSplitConversionBatches();
+
+  // An update with no more splits than the batch size is converted serially.
+  auto source = makeSource(
+      "0", {filePaths.begin(), filePaths.begin() + 2}, false, splitSequenceId);
+  taskManager_->createOrUpdateTask(taskId, planFragment, {source}, {}, {}, {});
+  EXPECT_EQ(taskManager_->numSplitConversionBatches(), numBatches);
+
+  // The remaining 3 splits are converted in batches of 2 and 1.
+  source = makeSource(
+      "0", {filePaths.begin() + 2, filePaths.end()}, true, splitSequenceId);
+  taskManager_->createOrUpdateTask(taskId, planFragment, {source}, {}, {}, {});
+  EXPECT_EQ(taskManager_->numSplitConversionBatches(), numBatches + 2);
+
+  assertResults(taskId, rowType_, "SELECT * FROM tmp WHERE c0 % 5 = 0");
+}
+
 TEST_F(TaskManagerTest, taskCleanupWithPendingResultData) {
   // Trigger old task cleanup immediately.
   FLAGS_old_task_ms = 0;
@@ -610,6 +656,9 @@ TEST_F(TaskManagerTest, taskCleanupWithPendingResultData) {
   const protocol::TaskId taskId = "scan.0.0.1";
   const auto taskInfo = taskManager_->createOrUpdateTask(
       taskId, planFragment, {source}, {}, {}, {});
+  size_t numTasks{0};
+  taskManager_->getTaskNumbers(numTasks);
+  ASSERT_EQ(numTasks, 1);
 
   const protocol::Duration longWait("300s");
   const auto maxSize = protocol::DataSize("32MB");
@@ -641,6 +690,77 @@ TEST_F(TaskManagerTest, taskCleanupWithPendingResultData) {
     }
     std::this_thread::sleep_for(std::chrono::milliseconds(100));
   }
+  // The cleaned up task is no longer counted.
+  const auto taskNumbers = taskManager_->getTaskNumbers(numTasks);
+  EXPECT_EQ(numTasks, 0);
+  EXPECT_EQ(taskNumbers[velox::exec::TaskState::kAborted], 0);
+}
+
+TEST_F(TaskManagerTest, taskExpiries) {
+  const auto oldTaskMs = FLAGS_old_task_ms;
+  SCOPE_EXIT {
+    FLAGS_old_task_ms = oldTaskMs;
+  };
+  FLAGS_old_task_ms = 500;
+  auto waitForCleanup = [&]() {
+    for (int i = 0; i < 100; ++i) {
+      if (auto numCleanupTasks = taskManager_->cleanOldTasks()) {
+        return numCleanupTasks;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    return size_t{0};
+  };
+
+  auto vectors = makeVectors(1, 100);
+  duckDbQueryRunner_.createTable("tmp", vectors);
+  const protocol::TaskId valuesTaskId = "values.0.0.1";
+  taskManager_->createOrUpdateTask(
+      valuesTaskId,
+      exec::test::PlanBuilder()
+          .values(vectors)
+          .partitionedOutput({}, 1, {"c0", "c1"})
+          .planFragment(),
+      {},
+      {},
+      {},
+      {});
+  assertResults(valuesTaskId, rowType_, "SELECT * FROM tmp");
+
+  // Keeps running while it waits for its splits.
+  const protocol::TaskId scanTaskId = "scan.0.0.1";
+  taskManager_->createOrUpdateTask(
+      scanTaskId,
+      exec::test::PlanBuilder()
+          .tableScan(rowType_)
+          .partitionedOutput({}, 1, {"c0", "c1"})
+          .planFragment(),
+      {},
+      {},
+      {},
+      {});
+
+  // No expiry is due yet.
+  EXPECT_EQ(taskManager_->cleanOldTasks(), 0);
+  EXPECT_EQ(taskManager_->getNumTasks(), 2);
+
+  // The finished task is cleaned once old.
+  EXPECT_EQ(waitForCleanup(), 1);
+  EXPECT_EQ(taskManager_->getNumTasks(), 1);
+
+  // The expiry of the running task falls due and is rescheduled.
+  std::this_thread::sleep_for(std::chrono::milliseconds(600));
+  EXPECT_EQ(taskManager_->cleanOldTasks(), 0);
+  EXPECT_EQ(taskManager_->getNumTasks(), 1);
+
+  // The scan task is cleaned once old after it finishes.
+  long splitSequenceId{0};
+  taskManager_->createOrUpdateTask(
+      scanTaskId, {}, {makeSource("0", {}, true, splitSequenceId)}, {}, {}, {});
+  assertResults(scanTaskId, rowType_, "SELECT * FROM tmp LIMIT 0");
+  EXPECT_EQ(taskManager_->cleanOldTasks(), 0);
+  EXPECT_EQ(waitForCleanup(), 1);
+  EXPECT_EQ(taskManager_->getNumTasks(), 0);
 }
 
 // Runs "select * from t where c0 % 5 = 1" query.
@@ -675,6 +795,167 @@ TEST_F(TaskManagerTest, tableScanOneSplitAtATime) {
   assertResults(taskId, rowType_, "SELECT * FROM tmp WHERE c0 % 5 = 1");
 }
 
+TEST_F(TaskManagerTest, blockedDriverCounts) {
+  duckDbQueryRunner_.createTable("tmp", makeVectors(1, 10));
+  auto planFragment = exec::test::PlanBuilder()
+                          .tableScan(rowType_)
+                          .partitionedOutput({}, 1, {"c0", "c1"})
+                          .planFragment();
+
+  protocol::TaskId taskId = "scan.0.0.1";
+  taskManager_->createOrUpdateTask(taskId, planFragment, {}, {}, {}, {});
+
+  // The scan drivers wait for their splits. The counts are taken when the
+  // status of the task is fetched.
+  std::unordered_map<std::string, size_t> counts;
+  for (int i = 0; i < 100 && counts.count("waitForSplit") == 0; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    taskManager_
+        ->getTaskStatus(
+            taskId,
+            std::nullopt,
+            protocol::Duration("0s"),
+            http::CallbackRequestHandlerState::create())
+        .getVia(folly::EventBaseManager::get()->getEventBase());
+    counts = taskManager_->getBlockedDriverCounts();
+  }
+  EXPECT_GT(counts["waitForSplit"], 0);
+  EXPECT_EQ(counts.count("notBlocked"), 0);
+
+  long splitSequenceId{0};
+  taskManager_->createOrUpdateTask(
+      taskId, {}, {makeSource("0", {}, true, splitSequenceId)}, {}, {}, {});
+  assertResults(taskId, rowType_, "SELECT * FROM tmp LIMIT 0");
+}
+
+TEST_F(TaskManagerTest, spillIdleOutputBuffer) {
+  auto spillDirectory = exec::test::TempDirectoryPath::create();
+  facebook::presto::test::ScopedSystemConfig config(
+      {{SystemConfig::kOutputBufferSpillPath, spillDirectory->path},
+       {SystemConfig::kOutputBufferSpillMinIdleMs, "0"},
+       {SystemConfig::kOutputBufferSpillMemoryPct, "50"}});
+  TaskManager taskManager;
+
+  auto vectors = makeVectors(10, 1'000);
+  duckDbQueryRunner_.createTable("tmp", vectors);
+  auto planFragment = exec::test::PlanBuilder()
+                          .values(vectors)
+                          .partitionedOutput({}, 1, {"c0", "c1"})
+                          .planFragment();
+  protocol::TaskId taskId = "scan.0.0.1";
+  taskManager.createOrUpdateTask(taskId, planFragment, {}, {}, {}, {});
+
+  // The first page is sent and not acknowledged before the consumer goes
+  // idle.
+  auto resultRequestState = http::CallbackRequestHandlerState::create();
+  auto results =
+      taskManager
+          .getResults(
+              taskId,
+              0,
+              0,
+              protocol::DataSize("1B"),
+              protocol::Duration("2s"),
+              resultRequestState)
+          .getVia(folly::EventBaseManager::get()->getEventBase());
+  ASSERT_EQ(results->nextSequence, 1);
+
+  EXPECT_EQ(taskManager.spillIdleOutputBuffers(49), 0);
+  EXPECT_EQ(taskManager.spillIdleOutputBuffers(50), 1);
+  EXPECT_EQ(taskManager.numSpilledOutputBuffers(), 1);
+  EXPECT_EQ(taskManager.spillIdleOutputBuffers(50), 0);
+
+  // The consumer starts over from the unacknowledged page and reads the
+  // spilled pages, then the output buffer once caught up.
+  Cursor cursor(&taskManager, taskId, rowType_, leafPool_.get());
+  std::vector<RowVectorPtr> fetched;
+  while (auto next = cursor.next()) {
+    fetched.insert(fetched.end(), next->begin(), next->end());
+  }
+  exec::test::assertResults(
+      fetched, rowType_, "SELECT * FROM tmp", duckDbQueryRunner_);
+  EXPECT_EQ(taskManager.numSpilledOutputBuffers(), 0);
+}
+
+TEST_F(TaskManagerTest, admissionQueue) {
+  facebook::presto::test::ScopedSystemConfig config(
+      {{SystemConfig::kTaskAdmissionMaxDrivers, "1"}});
+  TaskManager taskManager;
+
+  auto vectors = makeVectors(2, 100);
+  duckDbQueryRunner_.createTable("tmp", vectors);
+  auto planFragment = exec::test::PlanBuilder()
+                          .values(vectors)
+                          .partitionedOutput({}, 1, {"c0", "c1"})
+                          .planFragment();
+
+  // The first task starts, the drivers it takes fill the node.
+  const protocol::TaskId firstTaskId = "admission.0.0.1";
+  auto taskInfo = taskManager.createOrUpdateTask(
+      firstTaskId, planFragment, {}, {}, {}, {});
+  EXPECT_NE(taskInfo->taskStatus.state, protocol::TaskState::PLANNED);
+  EXPECT_EQ(taskManager.numQueuedTasks(), 0);
+
+  // The next ones wait until the load sampled next admits them.
+  const protocol::TaskId secondTaskId = "admission.0.0.2";
+  taskInfo = taskManager.createOrUpdateTask(
+      secondTaskId, planFragment, {}, {}, {}, {});
+  EXPECT_EQ(taskInfo->taskStatus.state, protocol::TaskState::PLANNED);
+  EXPECT_EQ(taskManager.numQueuedTasks(), 1);
+  EXPECT_EQ(taskManager.updateAdmissionLoad({1, 0, 0}), 0);
+  EXPECT_EQ(taskManager.numQueuedTasks(), 1);
+
+  EXPECT_EQ(taskManager.updateAdmissionLoad({0, 0, 0}), 1);
+  EXPECT_EQ(taskManager.numQueuedTasks(), 0);
+
+  for (const auto& taskId : {firstTaskId, secondTaskId}) {
+    Cursor cursor(&taskManager, taskId, rowType_, leafPool_.get());
+    std::vector<RowVectorPtr> fetched;
+    while (auto next = cursor.next()) {
+      fetched.insert(fetched.end(), next->begin(), next->end());
+    }
+    exec::test::assertResults(
+        fetched, rowType_, "SELECT * FROM tmp", duckDbQueryRunner_);
+  }
+}
+
+TEST_F(TaskManagerTest, cacheAwareSplitOrder) {
+  auto makeSplits = [](const std::vector<std::string>& paths) {
+    std::vector<exec::Split> splits;
+    for (const auto& path : paths) {
+      splits.emplace_back(
+          std::make_shared<connector::hive::HiveConnectorSplit>(
+              "hive", path, dwio::common::FileFormat::DWRF));
+    }
+    return splits;
+  };
+  using Order = std::vector<size_t>;
+
+  // The splits of a file seen first in the same update are not moved.
+  EXPECT_EQ(
+      taskManager_->cacheAwareSplitOrder(makeSplits({"/a", "/b", "/a"})),
+      (Order{0, 1, 2}));
+  EXPECT_EQ(
+      taskManager_->cacheAwareSplitOrder(
+          makeSplits({"/c", "/b", "/d", "/a"})),
+      (Order{1, 3, 0, 2}));
+
+  // Each worker remembers the files its own tasks scanned.
+  TaskManager otherTaskManager;
+  EXPECT_EQ(
+      otherTaskManager.cacheAwareSplitOrder(makeSplits({"/c", "/a"})),
+      (Order{0, 1}));
+
+  facebook::presto::test::ScopedSystemConfig config(
+      {{SystemConfig::kTaskSplitOrderingRecentFiles, "0"}});
+  TaskManager unorderedTaskManager;
+  for (int i = 0; i < 2; ++i) {
+    EXPECT_EQ(
+        unorderedTaskManager.cacheAwareSplitOrder(makeSplits({"/c", "/a"})),
+        (Order{0, 1}));
+  }
+}
+
 // Runs 2-stage tableScan: (1) multiple table scan tasks; (2) single output task
 TEST_F(TaskManagerTest, tableScanMultipleTasks) {
   auto filePaths = makeFilePaths(5);
@@ -758,6 +1039,70 @@ TEST_F(TaskManagerTest, countAggregation) {
   testCountAggregation("test_count_aggr", filePaths);
 }
 
+TEST_F(TaskManagerTest, inProcessExchange) {
+  auto filePaths = makeFilePaths(5);
+  auto vectors = makeVectors(filePaths.size(), 1'000);
+  for (int i = 0; i < filePaths.size(); i++) {
+    writeToFile(filePaths[i]->path, vectors[i]);
+  }
+  duckDbQueryRunner_.createTable("tmp", vectors);
+
+  InProcessExchangeSource::setLocalAddress(
+      serverAddress_.getAddressStr(), serverAddress_.getPort());
+  std::atomic<int> numInProcessSources{0};
+  auto& factories = exec::ExchangeSource::factories();
+  factories.insert(
+      factories.begin(),
+      [&](const std::string& url,
+          int destination,
+          std::shared_ptr<exec::ExchangeQueue> queue,
+          memory::MemoryPool* pool) {
+        auto source = InProcessExchangeSource::createExchangeSource(
+            url, destination, std::move(queue), pool);
+        if (source != nullptr) {
+          ++numInProcessSources;
+        }
+        return source;
+      });
+  SCOPE_EXIT {
+    factories.erase(factories.begin());
+    InProcessExchangeSource::setLocalAddress("", 0);
+  };
+
+  testCountAggregation("test_in_process_exchange", filePaths);
+  // 3 final aggregations reading from 5 partial aggregations each and the
+  // output task reading from the 3 final aggregations.
+  ASSERT_EQ(numInProcessSources, 3 * filePaths.size() + 3);
+}
+
+TEST_F(TaskManagerTest, inProcessExchangeWithoutProducer) {
+  auto queue = std::make_shared<exec::ExchangeQueue>(1 << 20);
+  queue->addSourceLocked();
+  queue->noMoreSources();
+  auto source = std::make_shared<InProcessExchangeSource>(
+      "missing.0.0.0.0",
+      0,
+      queue,
+      leafPool_.get(),
+      std::chrono::milliseconds(100));
+  {
+    std::lock_guard<std::mutex> l(queue->mutex());
+    ASSERT_TRUE(source->shouldRequestLocked());
+  }
+  source->request();
+
+  // The queue fails once the output buffer is not found for the timeout
+  // instead of the source polling for it forever.
+  bool atEnd;
+  ContinueFuture future;
+  ASSERT_EQ(queue->dequeueLocked(&atEnd, &future), nullptr);
+  future.wait(std::chrono::seconds(10));
+  ASSERT_TRUE(future.isReady());
+  VELOX_ASSERT_THROW(
+      queue->dequeueLocked(&atEnd, &future),
+      "Output buffer 0 of task missing.0.0.0.0 not found");
+}
+
 TEST_F(TaskManagerTest, outOfQueryUserMemory) {
   auto filePaths = makeFilePaths(5);
   auto vectors = makeVectors(filePaths.size(), 1'000);
@@ -788,6 +1133,32 @@ TEST_F(TaskManagerTest, outOfQueryUserMemory) {
   }
 }
 
+TEST_F(TaskManagerTest, concurrentTaskCreation) {
+  constexpr int kNumTasks = 100;
+  constexpr int kNumThreads = 8;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kNumThreads; ++i) {
+    threads.emplace_back([&]() {
+      for (int j = 0; j < kNumTasks; ++j) {
+        // Deleting a task which doesn't exist creates it aborted.
+        auto taskInfo =
+            taskManager_->deleteTask(fmt::format("concurrent.0.0.{}", j), true);
+        EXPECT_EQ(taskInfo->taskStatus.state, protocol::TaskState::ABORTED);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  ASSERT_EQ(taskManager_->getNumTasks(), kNumTasks);
+  const auto tasks = taskManager_->tasks();
+  ASSERT_EQ(tasks.size(), kNumTasks);
+  for (const auto& [taskId, prestoTask] : tasks) {
+    ASSERT_EQ(prestoTask->info.taskStatus.state, protocol::TaskState::ABORTED)
+        << taskId;
+  }
+}
+
 // Tests whether the returned futures timeout.
 TEST_F(TaskManagerTest, outOfOrderRequests) {
   auto eventBase = folly::EventBaseManager::get()->getEventBase();
@@ -831,6 +1202,183 @@ TEST_F(TaskManagerTest, outOfOrderRequests) {
   assertResults(taskId, rowType_, "SELECT * FROM tmp WHERE c0 % 5 = 0");
 }
 
+// Result requests queued before the task is created do not wait for the
+// task's mutex, which the task updates and the TaskInfo rebuilds hold.
+TEST_F(TaskManagerTest, resultRequestsBypassTaskMutex) {
+  auto eventBase = folly::EventBaseManager::get()->getEventBase();
+  auto longWait = protocol::Duration("300s");
+  auto shortWait = std::chrono::seconds(1);
+  auto maxSize = protocol::DataSize("32MB");
+
+  auto vectors = makeVectors(1, 1000);
+  duckDbQueryRunner_.createTable("tmp", vectors);
+  auto planFragment = exec::test::PlanBuilder()
+                          .values(vectors)
+                          .partitionedOutput({}, 1, {"c0", "c1"})
+                          .planFragment();
+
+  protocol::TaskId taskId = "scan.0.0.1";
+  protocol::TaskState currentState{};
+  auto statusRequestState = http::CallbackRequestHandlerState::create();
+  auto resultRequestState = http::CallbackRequestHandlerState::create();
+  auto taskStatus = taskManager_->getTaskStatus(
+      taskId, currentState, longWait, statusRequestState);
+  auto prestoTask = taskManager_->tasks().at(taskId);
+
+  // Holds the task's mutex for up to 10s on another thread while the result
+  // request is queued.
+  folly::Baton<> locked;
+  folly::Baton<> requested;
+  std::thread holder([&]() {
+    std::lock_guard<std::mutex> l(prestoTask->mutex);
+    locked.post();
+    requested.try_wait_for(std::chrono::seconds(10));
+  });
+  locked.wait();
+  const auto startMs = getCurrentTimeMs();
+  auto results = taskManager_->getResults(
+      taskId, 0, 0, maxSize, longWait, resultRequestState);
+  EXPECT_LT(getCurrentTimeMs() - startMs, 5'000);
+  requested.post();
+  holder.join();
+  ASSERT_EQ(prestoTask->resultRequests.size(), 1);
+
+  taskManager_->createOrUpdateTask(taskId, planFragment, {}, {}, {}, {});
+  EXPECT_NO_THROW(std::move(taskStatus).within(shortWait).getVia(eventBase));
+  EXPECT_NO_THROW(std::move(results).within(shortWait).getVia(eventBase));
+  assertResults(taskId, rowType_, "SELECT * FROM tmp");
+}
+
+TEST_F(TaskManagerTest, operatorStatsBypassTaskMutex) {
+  auto vectors = makeVectors(1, 1000);
+  duckDbQueryRunner_.createTable("tmp", vectors);
+  auto planFragment = exec::test::PlanBuilder()
+                          .values(vectors)
+                          .partitionedOutput({}, 1, {"c0", "c1"})
+                          .planFragment();
+
+  protocol::TaskId taskId = "values.0.0.2";
+  EXPECT_TRUE(taskManager_->getOperatorStats(taskId)["operators"].empty());
+  taskManager_->createOrUpdateTask(taskId, planFragment, {}, {}, {}, {});
+  assertResults(taskId, rowType_, "SELECT * FROM tmp");
+
+  // The stats are read while another thread holds the task's mutex.
+  auto prestoTask = taskManager_->tasks().at(taskId);
+  std::lock_guard<std::mutex> l(prestoTask->mutex);
+  const auto operators = taskManager_->getOperatorStats(taskId)["operators"];
+  ASSERT_EQ(operators.size(), 2);
+  EXPECT_EQ(operators[0]["operatorType"], "Values");
+  EXPECT_EQ(operators[0]["outputPositions"], 1000);
+  EXPECT_EQ(operators[1]["operatorType"], "PartitionedOutput");
+  EXPECT_EQ(operators[1]["inputPositions"], 1000);
+}
+
+TEST_F(TaskManagerTest, taskStateSubscription) {
+  auto vectors = makeVectors(1, 1000);
+  duckDbQueryRunner_.createTable("tmp", vectors);
+  auto planFragment = exec::test::PlanBuilder()
+                          .values(vectors)
+                          .partitionedOutput({}, 1, {"c0", "c1"})
+                          .planFragment();
+
+  std::mutex mutex;
+  std::vector<std::pair<protocol::TaskId, protocol::TaskState>> events;
+  const auto id = taskManager_->subscribeTaskStates(
+      "scan", [&](const protocol::TaskId& taskId, protocol::TaskState state) {
+        std::lock_guard<std::mutex> l(mutex);
+        events.emplace_back(taskId, state);
+      });
+
+  protocol::TaskId taskId = "scan.0.0.1";
+  taskManager_->createOrUpdateTask(taskId, planFragment, {}, {}, {}, {});
+  // The tasks of other queries are not reported.
+  taskManager_->createOrUpdateTask(
+      "other.0.0.1", planFragment, {}, {}, {}, {});
+  assertResults(taskId, rowType_, "SELECT * FROM tmp");
+  taskManager_->deleteTask("other.0.0.1", true);
+
+  auto finished = [&]() {
+    std::lock_guard<std::mutex> l(mutex);
+    return !events.empty() &&
+        events.back().second == protocol::TaskState::FINISHED;
+  };
+  for (auto i = 0; i < 500 && !finished(); ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  taskManager_->unsubscribeTaskStates("scan", id);
+
+  std::lock_guard<std::mutex> l(mutex);
+  ASSERT_EQ(events.size(), 2);
+  for (const auto& [eventTaskId, state] : events) {
+    EXPECT_EQ(eventTaskId, taskId);
+  }
+  EXPECT_EQ(events[0].second, protocol::TaskState::RUNNING);
+  EXPECT_EQ(events[1].second, protocol::TaskState::FINISHED);
+}
+
+TEST_F(TaskManagerTest, taskStatesEndpoint) {
+  auto vectors = makeVectors(1, 100);
+  duckDbQueryRunner_.createTable("tmp", vectors);
+  auto planFragment = exec::test::PlanBuilder()
+                          .values(vectors)
+                          .partitionedOutput({}, 1, {"c0", "c1"})
+                          .planFragment();
+  const protocol::TaskId taskId = "states.0.0.1";
+  taskManager_->createOrUpdateTask(taskId, planFragment, {}, {}, {}, {});
+
+  // The stream does not end on its own. The client times it out once idle.
+  folly::ScopedEventBaseThread eventBaseThread;
+  auto client = std::make_unique<http::HttpClient>(
+      eventBaseThread.getEventBase(),
+      serverAddress_,
+      std::chrono::milliseconds(1'000));
+  std::mutex mutex;
+  std::string body;
+  auto response =
+      http::RequestBuilder()
+          .method(proxygen::HTTPMethod::GET)
+          .url("/v1/query/states/task-states")
+          .send(client.get(), leafPool_.get(), "", [&](auto* received) {
+            std::lock_guard<std::mutex> l(mutex);
+            body = received->dumpBodyChain();
+          });
+  // Returns the events received in full.
+  auto receivedEvents = [&]() {
+    std::lock_guard<std::mutex> l(mutex);
+    std::vector<json> events;
+    std::istringstream lines(body);
+    std::string line;
+    while (std::getline(lines, line) && !lines.eof()) {
+      events.push_back(json::parse(line));
+    }
+    return events;
+  };
+  auto waitForEvent = [&](const std::string& state) {
+    for (auto i = 0; i < 500; ++i) {
+      auto events = receivedEvents();
+      if (!events.empty() && events.back()["state"] == state) {
+        return;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+  };
+
+  // The stream starts with the current state.
+  waitForEvent("RUNNING");
+  assertResults(taskId, rowType_, "SELECT * FROM tmp");
+  waitForEvent("FINISHED");
+
+  const auto events = receivedEvents();
+  ASSERT_GE(events.size(), 2);
+  for (const auto& event : events) {
+    EXPECT_EQ(event["taskId"], taskId);
+  }
+  EXPECT_EQ(events.front()["state"], "RUNNING");
+  EXPECT_EQ(events.back()["state"], "FINISHED");
+  EXPECT_THROW(
+      std::move(response).get(std::chrono::seconds(10)), std::exception);
+}
+
 // Tests whether the returned futures timeout.
 TEST_F(TaskManagerTest, timeoutOutOfOrderRequests) {
   auto eventBase = folly::EventBaseManager::get()->getEventBase();
@@ -919,6 +1467,134 @@ TEST_F(TaskManagerTest, buildTaskSpillDirectoryPath) {
       TaskManager::buildTaskSpillDirectoryPath("fsx::/root", "Q100", "Task22"));
 }
 
+TEST_F(TaskManagerTest, nextResultMaxBytes) {
+  constexpr uint64_t kRequested = 1 << 20;
+  constexpr uint64_t kMax = 6 << 20;
+  // Grows after a response filled at least half of it, up to the maximum.
+  EXPECT_EQ(
+      TaskManager::nextResultMaxBytes(
+          kRequested, kRequested, kMax, kRequested / 2, false),
+      2 * kRequested);
+  EXPECT_EQ(
+      TaskManager::nextResultMaxBytes(
+          kRequested, 4 * kRequested, kMax, 4 * kRequested, false),
+      kMax);
+  EXPECT_EQ(
+      TaskManager::nextResultMaxBytes(kRequested, kMax, kMax, kMax, false),
+      kMax);
+  // Holds between a quarter and a half.
+  EXPECT_EQ(
+      TaskManager::nextResultMaxBytes(
+          kRequested, 4 * kRequested, kMax, kRequested, false),
+      4 * kRequested);
+  // Resets below a quarter and once complete.
+  EXPECT_EQ(
+      TaskManager::nextResultMaxBytes(
+          kRequested, 4 * kRequested, kMax, kRequested - 1, false),
+      kRequested);
+  EXPECT_EQ(
+      TaskManager::nextResultMaxBytes(
+          kRequested, 4 * kRequested, kMax, 4 * kRequested, true),
+      kRequested);
+}
+
+TEST_F(TaskManagerTest, maxDriversForSplits) {
+  auto filePaths = makeFilePaths(5);
+  auto scanFragment = exec::test::PlanBuilder()
+                          .tableScan(rowType_)
+                          .partitionedOutput({}, 1, {"c0", "c1"})
+                          .planFragment();
+  long splitSequenceId{0};
+  auto allSplits = makeSource("0", filePaths, true, splitSequenceId);
+  EXPECT_EQ(
+      5,
+      TaskManager::maxDriversForSplits(scanFragment, {allSplits}, 16, 1));
+  EXPECT_EQ(
+      3,
+      TaskManager::maxDriversForSplits(scanFragment, {allSplits}, 16, 2));
+  EXPECT_EQ(
+      4, TaskManager::maxDriversForSplits(scanFragment, {allSplits}, 4, 1));
+  EXPECT_EQ(
+      16,
+      TaskManager::maxDriversForSplits(scanFragment, {allSplits}, 16, 0));
+
+  // More splits may come.
+  auto someSplits = makeSource("0", filePaths, false, splitSequenceId);
+  EXPECT_EQ(
+      16,
+      TaskManager::maxDriversForSplits(scanFragment, {someSplits}, 16, 1));
+  EXPECT_EQ(16, TaskManager::maxDriversForSplits(scanFragment, {}, 16, 1));
+
+  // The fragments reading from exchanges keep all the drivers.
+  auto exchangeFragment = exec::test::PlanBuilder()
+                              .exchange(rowType_)
+                              .partitionedOutput({}, 1, {"c0", "c1"})
+                              .planFragment();
+  auto remoteSplits =
+      makeRemoteSource("0", {"http://127.0.0.1/v1/task/t.0.0.1"}, true);
+  EXPECT_EQ(
+      16,
+      TaskManager::maxDriversForSplits(
+          exchangeFragment, {remoteSplits}, 16, 1));
+}
+
+TEST_F(TaskManagerTest, maxDriversForWriter) {
+  auto filePaths = makeFilePaths(5);
+  auto scanFragment = exec::test::PlanBuilder()
+                          .tableScan(rowType_)
+                          .partitionedOutput({}, 1, {"c0", "c1"})
+                          .planFragment();
+  core::PlanFragment writeFragment;
+  writeFragment.planNode = std::make_shared<core::TableWriteNode>(
+      "1",
+      rowType_,
+      rowType_->names(),
+      std::make_shared<core::InsertTableHandle>(
+          exec::test::kHiveConnectorId, nullptr),
+      ROW({"rows"}, {BIGINT()}),
+      connector::CommitStrategy::kNoCommit,
+      exec::test::PlanBuilder().tableScan(rowType_).planNode());
+  long splitSequenceId{0};
+  auto allSplits = makeSource("0", filePaths, true, splitSequenceId);
+  for (auto& split : allSplits.splits) {
+    std::dynamic_pointer_cast<protocol::HiveSplit>(split.split.connectorSplit)
+        ->fileSplit.length = 100;
+  }
+
+  // The fragments that do not write keep the drivers.
+  EXPECT_EQ(
+      16,
+      TaskManager::maxDriversForWriter(scanFragment, {allSplits}, 16, 2, 100));
+
+  EXPECT_EQ(
+      16,
+      TaskManager::maxDriversForWriter(writeFragment, {allSplits}, 16, 0, 0));
+  EXPECT_EQ(
+      4,
+      TaskManager::maxDriversForWriter(writeFragment, {allSplits}, 16, 4, 0));
+  EXPECT_EQ(
+      2, TaskManager::maxDriversForWriter(writeFragment, {allSplits}, 2, 4, 0));
+
+  // One writer per 200 bytes of the 500 bytes of splits.
+  EXPECT_EQ(
+      3,
+      TaskManager::maxDriversForWriter(writeFragment, {allSplits}, 16, 0, 200));
+  EXPECT_EQ(
+      1,
+      TaskManager::maxDriversForWriter(
+          writeFragment, {allSplits}, 16, 0, 1 << 20));
+  EXPECT_EQ(
+      2,
+      TaskManager::maxDriversForWriter(writeFragment, {allSplits}, 16, 2, 100));
+
+  // More splits may come.
+  auto someSplits = makeSource("0", filePaths, false, splitSequenceId);
+  EXPECT_EQ(
+      4,
+      TaskManager::maxDriversForWriter(
+          writeFragment, {someSplits}, 16, 4, 200));
+}
+
 TEST_F(TaskManagerTest, getDataOnAbortedTask) {
   // Simulate scenario where Driver encountered a VeloxException and terminated
   // a task, which removes the entry in BufferManager. The main taskmanager
@@ -984,4 +1660,76 @@ TEST_F(TaskManagerTest, getResultsErrorPropagation) {
       VeloxException);
 }
 
+TEST_F(TaskManagerTest, sessionConfigParsedOnce) {
+  auto* queryContextManager = taskManager_->getQueryContextManager();
+  int numMakeConfigs = 0;
+  auto makeConfigs = [&]() {
+    ++numMakeConfigs;
+    QueryConfigStrings configs;
+    configs.configStrings.emplace(
+        std::string(QuerySessionConfig::kMaxDriversPerTask), "3");
+    configs.configStrings.emplace(
+        core::QueryConfig::kSessionTimezone, "America/Los_Angeles");
+    return configs;
+  };
+
+  std::shared_ptr<const QuerySessionConfig> sessionConfig;
+  auto queryCtx = queryContextManager->findOrCreateQueryCtx(
+      "session.0.0.1", makeConfigs, sessionConfig);
+  ASSERT_NE(sessionConfig, nullptr);
+  EXPECT_EQ(sessionConfig->maxDriversPerTask, 3);
+  EXPECT_FALSE(sessionConfig->concurrentLifespansPerTask.has_value());
+  EXPECT_FALSE(sessionConfig->taskWriterCount.has_value());
+  // The time zone changes the results, the driver count does not. The
+  // timestamps are adjusted to the time zone by default.
+  EXPECT_EQ(
+      sessionConfig->resultConfigs,
+      fmt::format(
+          "{}=true\n{}=America/Los_Angeles\n",
+          core::QueryConfig::kAdjustTimestampToTimezone,
+          core::QueryConfig::kSessionTimezone));
+
+  // The later tasks of the query reuse the context and its session config.
+  std::shared_ptr<const QuerySessionConfig> otherSessionConfig;
+  auto otherQueryCtx = queryContextManager->findOrCreateQueryCtx(
+      "session.0.0.2", makeConfigs, otherSessionConfig);
+  EXPECT_EQ(otherQueryCtx, queryCtx);
+  EXPECT_EQ(otherSessionConfig, sessionConfig);
+  EXPECT_EQ(numMakeConfigs, 1);
+}
+
+TEST_F(TaskManagerTest, createOrUpdateTasks) {
+  protocol::OutputBuffers outputIds;
+  outputIds.type = protocol::BufferType::PARTITIONED;
+  outputIds.version = 1;
+  outputIds.noMoreBufferIds = true;
+  outputIds.buffers = {{"0", 0}};
+  json task = {{"taskId", "tasks.0.0.1"}, {"sources", json::array()}};
+  task["outputIds"] = outputIds;
+  protocol::SessionRepresentation session;
+  session.queryId = "tasks";
+  json update = {
+      {"extraCredentials", json::object()}, {"session", session}};
+  // The second task misses its sources. The JSON error fails only that task.
+  update["tasks"] = json::array({task, {{"taskId", "tasks.0.0.2"}}});
+
+  auto client =
+      PrestoExchangeSource::httpClientPool().getClient(serverAddress_);
+  auto response = http::RequestBuilder()
+                      .method(proxygen::HTTPMethod::POST)
+                      .url("/v1/tasks")
+                      .send(client.get(), leafPool_.get(), update.dump())
+                      .get(std::chrono::seconds(10));
+  ASSERT_EQ(response->headers()->getStatusCode(), http::kHttpOk);
+  std::vector<protocol::TaskInfo> taskInfos =
+      json::parse(response->dumpBodyChain());
+  ASSERT_EQ(taskInfos.size(), 2);
+  EXPECT_EQ(taskInfos[0].taskId, "tasks.0.0.1");
+  EXPECT_NE(taskInfos[0].taskStatus.state, protocol::TaskState::FAILED);
+  EXPECT_EQ(taskInfos[1].taskId, "tasks.0.0.2");
+  EXPECT_EQ(taskInfos[1].taskStatus.state, protocol::TaskState::FAILED);
+  ASSERT_EQ(taskInfos[1].taskStatus.failures.size(), 1);
+  EXPECT_EQ(taskManager_->getNumTasks(), 2);
+}
+
 // TODO: add disk spilling test for order by and hash join later.
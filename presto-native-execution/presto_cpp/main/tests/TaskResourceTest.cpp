@@ -0,0 +1,59 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <gtest/gtest.h>
+
+#include "presto_cpp/main/TaskResource.h"
+
+using namespace facebook::presto;
+
+TEST(TaskResourceTest, parseTaskUpdateJson) {
+  const std::vector<std::string> bodies = {
+      R"({"fragment": "ZnJhZ21lbnQ=", "extraCredentials": {"a": "b"}})",
+      R"({"extraCredentials": {"a": "b"}, "fragment": "ZnJhZ21lbnQ="})",
+  };
+  for (const auto& body : bodies) {
+    SCOPED_TRACE(body);
+    std::shared_ptr<protocol::String> fragment;
+    auto parsed = parseTaskUpdateJson(body, {"fragment"}, fragment);
+    ASSERT_NE(fragment, nullptr);
+    EXPECT_EQ(*fragment, "ZnJhZ21lbnQ=");
+    EXPECT_EQ(parsed, json::parse(R"({"extraCredentials": {"a": "b"}})"));
+  }
+}
+
+TEST(TaskResourceTest, parseNestedTaskUpdateJson) {
+  // The fragment is the last member of the nested object and a key of the
+  // same name at another depth is kept.
+  const std::string body = R"({
+      "fragment": "outer",
+      "taskUpdateRequest": {"outputIds": {"version": 1}, "fragment": "inner"},
+      "shuffleWriteInfo": "info"})";
+  std::shared_ptr<protocol::String> fragment;
+  auto parsed =
+      parseTaskUpdateJson(body, {"taskUpdateRequest", "fragment"}, fragment);
+  ASSERT_NE(fragment, nullptr);
+  EXPECT_EQ(*fragment, "inner");
+  EXPECT_EQ(parsed, json::parse(R"({
+      "fragment": "outer",
+      "taskUpdateRequest": {"outputIds": {"version": 1}},
+      "shuffleWriteInfo": "info"})"));
+}
+
+TEST(TaskResourceTest, parseTaskUpdateJsonWithoutFragment) {
+  std::shared_ptr<protocol::String> fragment;
+  auto parsed =
+      parseTaskUpdateJson(R"({"fragment": null})", {"fragment"}, fragment);
+  EXPECT_EQ(fragment, nullptr);
+  EXPECT_EQ(parsed, json::parse(R"({"fragment": null})"));
+}
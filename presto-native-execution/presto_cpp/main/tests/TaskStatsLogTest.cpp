@@ -0,0 +1,128 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/TaskStatsLog.h"
+#include <gtest/gtest.h>
+#include <thread>
+#include "velox/exec/tests/utils/HiveConnectorTestBase.h"
+#include "velox/exec/tests/utils/PlanBuilder.h"
+#include "velox/exec/tests/utils/TempDirectoryPath.h"
+
+using namespace facebook::presto;
+using namespace facebook::velox;
+
+class TaskStatsLogTest : public exec::test::HiveConnectorTestBase {
+ protected:
+  static exec::TaskStats makeStats(int32_t numOperators) {
+    exec::TaskStats stats;
+    stats.executionStartTimeMs = 1'000;
+    stats.endTimeMs = 3'500;
+    stats.pipelineStats.emplace_back(true, true);
+    for (int32_t i = 0; i < numOperators; ++i) {
+      exec::OperatorStats op(i, 0, fmt::format("{}", i), "FilterProject");
+      op.getOutputTiming.cpuNanos = 100;
+      op.blockedWallNanos = 20;
+      op.inputPositions = 1'000;
+      op.outputPositions = 10 * i;
+      stats.pipelineStats.back().operatorStats.push_back(op);
+    }
+    return stats;
+  }
+
+  void assertRows(
+      const std::vector<std::string>& files,
+      const std::string& duckDbSql) {
+    std::vector<std::shared_ptr<connector::ConnectorSplit>> splits;
+    for (const auto& file : files) {
+      splits.push_back(makeHiveConnectorSplit(file));
+    }
+    auto plan = exec::test::PlanBuilder()
+                    .tableScan(TaskStatsLog::rowType())
+                    .project({"task_id", "task_wall_ms", "output_rows"})
+                    .planNode();
+    assertQuery(plan, splits, duckDbSql);
+  }
+
+  // Waits up to 10s for the background writer to write 'numFiles' files.
+  static void waitForFiles(const TaskStatsLog& log, size_t numFiles) {
+    for (int32_t i = 0; i < 1'000 && log.files().size() < numFiles; ++i) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10)); // NOLINT
+    }
+    ASSERT_EQ(log.files().size(), numFiles);
+  }
+};
+
+TEST_F(TaskStatsLogTest, batches) {
+  auto directory = exec::test::TempDirectoryPath::create();
+  TaskStatsLog log(directory->path, 5, 10, std::chrono::seconds(600));
+  log.onTaskCompletion(
+      "uuid1", "q.1.0.0", exec::TaskState::kFinished, nullptr, makeStats(3));
+  EXPECT_TRUE(log.files().empty());
+
+  // The fifth row fills the batch, which is written in the background.
+  log.onTaskCompletion(
+      "uuid2", "q.1.0.1", exec::TaskState::kFinished, nullptr, makeStats(2));
+  waitForFiles(log, 1);
+  assertRows(
+      log.files(),
+      "VALUES ('q.1.0.0', 2500, 0), ('q.1.0.0', 2500, 10), "
+      "('q.1.0.0', 2500, 20), ('q.1.0.1', 2500, 0), ('q.1.0.1', 2500, 10)");
+
+  log.onTaskCompletion(
+      "uuid3", "q.2.0.0", exec::TaskState::kFailed, nullptr, makeStats(1));
+  log.flush();
+  ASSERT_EQ(log.files().size(), 2);
+  assertRows({log.files().back()}, "VALUES ('q.2.0.0', 2500, 0)");
+}
+
+TEST_F(TaskStatsLogTest, rotation) {
+  auto directory = exec::test::TempDirectoryPath::create();
+  std::vector<std::string> files;
+  {
+    TaskStatsLog log(directory->path, 1, 3, std::chrono::seconds(600));
+    for (int32_t i = 0; i < 5; ++i) {
+      log.onTaskCompletion(
+          "uuid",
+          fmt::format("q.{}.0.0", i),
+          exec::TaskState::kFinished,
+          nullptr,
+          makeStats(1));
+      // Waits for the background write of each row.
+      log.flush();
+    }
+    files = log.files();
+    ASSERT_EQ(files.size(), 3);
+    assertRows({files.front()}, "VALUES ('q.2.0.0', 2500, 0)");
+  }
+
+  // The files of the previous log are kept up to the limit.
+  TaskStatsLog log(directory->path, 1, 3, std::chrono::seconds(600));
+  EXPECT_EQ(log.files(), files);
+  log.onTaskCompletion(
+      "uuid", "q.5.0.0", exec::TaskState::kFinished, nullptr, makeStats(1));
+  log.flush();
+  ASSERT_EQ(log.files().size(), 3);
+  EXPECT_EQ(log.files().front(), files[1]);
+}
+
+TEST_F(TaskStatsLogTest, flushInterval) {
+  auto directory = exec::test::TempDirectoryPath::create();
+  TaskStatsLog log(directory->path, 100, 10, std::chrono::seconds(1));
+  log.onTaskCompletion(
+      "uuid1", "q.1.0.0", exec::TaskState::kFinished, nullptr, makeStats(1));
+  EXPECT_TRUE(log.files().empty());
+
+  // The aged batch is written without another completion or flush().
+  waitForFiles(log, 1);
+  assertRows(log.files(), "VALUES ('q.1.0.0', 2500, 0)");
+}
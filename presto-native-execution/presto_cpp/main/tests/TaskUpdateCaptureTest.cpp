@@ -0,0 +1,100 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/TaskUpdateCapture.h"
+#include <folly/FileUtil.h>
+#include <gtest/gtest.h>
+#include <filesystem>
+#include "velox/exec/tests/utils/TempDirectoryPath.h"
+
+using namespace facebook::presto;
+using namespace facebook::velox;
+
+TEST(TaskUpdateCaptureTest, captureAndList) {
+  auto directory = exec::test::TempDirectoryPath::create();
+  TaskUpdateCapture capture(directory->path, 10);
+  auto body = folly::IOBuf::copyBuffer(R"({"session": )");
+  body->appendToChain(folly::IOBuf::copyBuffer("{}}"));
+  capture.capture("20201007_190402_00000_r5erw.1.0.0", *body, false);
+  capture.capture("q.2.0.1", *folly::IOBuf::copyBuffer("thrift"), true);
+  ASSERT_EQ(capture.files().size(), 2);
+
+  const auto updates = TaskUpdateCapture::list(directory->path);
+  ASSERT_EQ(updates.size(), 2);
+  EXPECT_EQ(updates[0].taskId, "20201007_190402_00000_r5erw.1.0.0");
+  EXPECT_FALSE(updates[0].thrift);
+  EXPECT_EQ(updates[1].taskId, "q.2.0.1");
+  EXPECT_TRUE(updates[1].thrift);
+  std::string content;
+  ASSERT_TRUE(folly::readFile(updates[0].path.c_str(), content));
+  EXPECT_EQ(content, R"({"session":{}})");
+}
+
+TEST(TaskUpdateCaptureTest, credentials) {
+  auto directory = exec::test::TempDirectoryPath::create();
+  TaskUpdateCapture capture(directory->path, 10);
+  capture.capture(
+      "q.1.0.0",
+      *folly::IOBuf::copyBuffer(
+          R"({"session": {"user": "u", "principal": "p"},
+              "extraCredentials": {"token": "secret"}})"),
+      false);
+  // A task of a batch update.
+  capture.capture(
+      "q.1.0.1",
+      nlohmann::json{
+          {"session", {{"user", "u"}}},
+          {"extraCredentials", {{"token", "secret"}}},
+          {"sources", nlohmann::json::array()}});
+
+  const auto updates = TaskUpdateCapture::list(directory->path);
+  ASSERT_EQ(updates.size(), 2);
+  for (const auto& update : updates) {
+    std::string content;
+    ASSERT_TRUE(folly::readFile(update.path.c_str(), content));
+    EXPECT_EQ(content.find("secret"), std::string::npos);
+    const auto json = nlohmann::json::parse(content);
+    EXPECT_EQ(json["session"]["user"], "u");
+    EXPECT_FALSE(json["session"].contains("principal"));
+    EXPECT_TRUE(json["extraCredentials"].empty());
+    // Only the owner reads the captured updates.
+    EXPECT_EQ(
+        std::filesystem::status(update.path).permissions(),
+        std::filesystem::perms::owner_read |
+            std::filesystem::perms::owner_write);
+  }
+  EXPECT_EQ(updates[1].taskId, "q.1.0.1");
+}
+
+TEST(TaskUpdateCaptureTest, rotation) {
+  auto directory = exec::test::TempDirectoryPath::create();
+  {
+    TaskUpdateCapture capture(directory->path, 3);
+    for (auto i = 0; i < 5; ++i) {
+      capture.capture(
+          fmt::format("q.{}.0.0", i), *folly::IOBuf::copyBuffer("{}"), false);
+    }
+    ASSERT_EQ(capture.files().size(), 3);
+  }
+  auto updates = TaskUpdateCapture::list(directory->path);
+  ASSERT_EQ(updates.size(), 3);
+  EXPECT_EQ(updates[0].taskId, "q.2.0.0");
+
+  // The captures of the previous run count toward the limit.
+  TaskUpdateCapture capture(directory->path, 3);
+  capture.capture("q.5.0.0", *folly::IOBuf::copyBuffer("{}"), false);
+  updates = TaskUpdateCapture::list(directory->path);
+  ASSERT_EQ(updates.size(), 3);
+  EXPECT_EQ(updates[0].taskId, "q.3.0.0");
+  EXPECT_EQ(updates[2].taskId, "q.5.0.0");
+}
@@ -0,0 +1,159 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <gtest/gtest.h>
+
+#include "presto_cpp/main/TaskResource.h"
+#include "presto_cpp/main/thrift/ProtocolToThrift.h"
+#include "presto_cpp/main/thrift/ThriftIO.h"
+#include "presto_cpp/main/thrift/gen-cpp2/PrestoThrift.h"
+
+using namespace facebook::presto;
+
+namespace {
+
+template <typename T>
+std::shared_ptr<T> roundTrip(T& thriftObject) {
+  auto decoded = std::make_shared<T>();
+  thriftRead(*thriftWrite(thriftObject), decoded);
+  return decoded;
+}
+
+} // namespace
+
+TEST(ThriftTaskConversionTest, taskInfo) {
+  protocol::TaskInfo taskInfo;
+  taskInfo.taskId = "20230419_000000_00000_abcde.1.0.2";
+  taskInfo.taskStatus.version = 7;
+  taskInfo.taskStatus.state = protocol::TaskState::RUNNING;
+  taskInfo.taskStatus.self =
+      "http://127.0.0.1:7777/v1/task/20230419_000000_00000_abcde.1.0.2";
+  taskInfo.taskStatus.memoryReservationInBytes = 1 << 20;
+  protocol::ExecutionFailureInfo failure;
+  failure.type = "VeloxUserError";
+  failure.message = "boom";
+  failure.errorCode.code = 1;
+  failure.errorCode.name = "GENERIC_USER_ERROR";
+  taskInfo.taskStatus.failures.push_back(failure);
+  taskInfo.outputBuffers.type = "PARTITIONED";
+  taskInfo.outputBuffers.state = protocol::BufferState::FLUSHING;
+  protocol::BufferInfo buffer;
+  buffer.bufferId = "1";
+  buffer.bufferedPages = 3;
+  buffer.pagesSent = 5;
+  taskInfo.outputBuffers.buffers.push_back(buffer);
+  taskInfo.noMoreSplits = {"0", "1"};
+  taskInfo.stats.totalDrivers = 4;
+  protocol::OperatorStats operatorStats;
+  operatorStats.operatorType = "TableScan";
+  operatorStats.inputDataSize = protocol::DataSize("2MB");
+  operatorStats.getOutputWall = protocol::Duration("1500ms");
+  protocol::RuntimeMetric metric;
+  metric.name = "dataSourceWallNanos";
+  metric.sum = 10;
+  metric.count = 2;
+  operatorStats.runtimeStats.emplace(metric.name, metric);
+  protocol::PipelineStats pipelineStats;
+  pipelineStats.pipelineId = 1;
+  pipelineStats.operatorSummaries.push_back(operatorStats);
+  taskInfo.stats.pipelines.push_back(pipelineStats);
+  taskInfo.needsPlan = false;
+  taskInfo.nodeId = "node-1";
+
+  thrift::TaskInfo thriftTaskInfo;
+  toThrift(taskInfo, thriftTaskInfo);
+  auto decoded = roundTrip(thriftTaskInfo);
+  ASSERT_EQ(*decoded, thriftTaskInfo);
+
+  EXPECT_EQ(*decoded->taskId_ref(), taskInfo.taskId);
+  EXPECT_EQ(*decoded->nodeId_ref(), "node-1");
+  EXPECT_EQ(*decoded->noMoreSplits_ref(), taskInfo.noMoreSplits);
+
+  const auto& taskStatus = *decoded->taskStatus_ref();
+  EXPECT_EQ(*taskStatus.version_ref(), 7);
+  EXPECT_EQ(*taskStatus.state_ref(), thrift::TaskState::RUNNING);
+  EXPECT_EQ(*taskStatus.taskName_ref(), taskInfo.taskStatus.self);
+  EXPECT_EQ(*taskStatus.memoryReservationInBytes_ref(), 1 << 20);
+  ASSERT_EQ(taskStatus.failures_ref()->size(), 1);
+  const auto& thriftFailure = taskStatus.failures_ref()->front();
+  EXPECT_EQ(*thriftFailure.message_ref(), "boom");
+  EXPECT_EQ(*thriftFailure.errorCode_ref()->name_ref(), "GENERIC_USER_ERROR");
+
+  const auto& outputBuffers = *decoded->outputBuffers_ref();
+  EXPECT_EQ(*outputBuffers.type_ref(), "PARTITIONED");
+  EXPECT_EQ(*outputBuffers.state_ref(), thrift::BufferState::FLUSHING);
+  ASSERT_EQ(outputBuffers.buffers_ref()->size(), 1);
+  EXPECT_EQ(*outputBuffers.buffers_ref()->front().bufferId_ref(), "1");
+  EXPECT_EQ(*outputBuffers.buffers_ref()->front().bufferedPages_ref(), 3);
+  EXPECT_EQ(*outputBuffers.buffers_ref()->front().pagesSent_ref(), 5);
+
+  // The DataSizes are carried in bytes and the Durations in milliseconds.
+  const auto& stats = *decoded->stats_ref();
+  EXPECT_EQ(*stats.totalDrivers_ref(), 4);
+  ASSERT_EQ(stats.pipelines_ref()->size(), 1);
+  const auto& pipeline = stats.pipelines_ref()->front();
+  EXPECT_EQ(*pipeline.pipelineId_ref(), 1);
+  ASSERT_EQ(pipeline.operatorSummaries_ref()->size(), 1);
+  const auto& thriftOperator = pipeline.operatorSummaries_ref()->front();
+  EXPECT_EQ(*thriftOperator.operatorType_ref(), "TableScan");
+  EXPECT_EQ(*thriftOperator.inputDataSize_ref(), 2 << 20);
+  EXPECT_DOUBLE_EQ(*thriftOperator.getOutputWall_ref(), 1500);
+  const auto& runtimeStats = *thriftOperator.runtimeStats_ref();
+  ASSERT_EQ(runtimeStats.count("dataSourceWallNanos"), 1);
+  EXPECT_EQ(*runtimeStats.at("dataSourceWallNanos").sum_ref(), 10);
+  EXPECT_EQ(*runtimeStats.at("dataSourceWallNanos").count_ref(), 2);
+}
+
+TEST(ThriftTaskConversionTest, taskUpdateRequest) {
+  protocol::TaskUpdateRequest request;
+  request.session.queryId = "20230419_000000_00000_abcde";
+  request.session.user = "user";
+  request.session.systemProperties = {{"query_max_memory_per_node", "1GB"}};
+  request.extraCredentials = {{"token", "secret"}};
+  request.fragment = std::make_shared<protocol::String>("ZnJhZ21lbnQ=");
+  protocol::TaskSource source;
+  source.planNodeId = "0";
+  source.noMoreSplits = true;
+  auto remoteSplit = std::make_shared<protocol::RemoteSplit>();
+  remoteSplit->location.location = "http://127.0.0.1:7777/v1/task/t/results/0";
+  remoteSplit->remoteSourceTaskId = "t";
+  protocol::ScheduledSplit split;
+  split.sequenceId = 3;
+  split.planNodeId = "0";
+  split.split.connectorId = "system";
+  split.split.connectorSplit = remoteSplit;
+  source.splits.push_back(split);
+  request.sources.push_back(source);
+  request.outputIds.type = protocol::BufferType::PARTITIONED;
+  request.outputIds.version = 2;
+  request.outputIds.noMoreBufferIds = true;
+  request.outputIds.buffers = {{"0", 0}, {"1", 1}};
+
+  auto roundTripRequest = [](const protocol::TaskUpdateRequest& request) {
+    thrift::TaskUpdateRequest thriftRequest;
+    toThrift(request, thriftRequest);
+    return parseThriftTaskUpdateRequest(*thriftWrite(thriftRequest));
+  };
+
+  auto decoded = roundTripRequest(request);
+  EXPECT_EQ(json(decoded), json(request));
+  ASSERT_NE(decoded.fragment, nullptr);
+  EXPECT_EQ(*decoded.fragment, "ZnJhZ21lbnQ=");
+  EXPECT_EQ(decoded.tableWriteInfo, nullptr);
+
+  // The optional members are left out.
+  request.fragment = nullptr;
+  decoded = roundTripRequest(request);
+  EXPECT_EQ(decoded.fragment, nullptr);
+  EXPECT_EQ(json(decoded), json(request));
+}
@@ -0,0 +1,115 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/Tracer.h"
+#include <gtest/gtest.h>
+#include "velox/common/base/Exceptions.h"
+
+using namespace facebook::presto;
+
+class TracerTest : public testing::Test {
+ protected:
+  void TearDown() override {
+    Tracer::instance().configure(0, 0);
+  }
+};
+
+TEST_F(TracerTest, disabled) {
+  auto& tracer = Tracer::instance();
+  tracer.configure(0, 100);
+  EXPECT_FALSE(tracer.enabled());
+  EXPECT_FALSE(tracer.sampled("q1.0.0.0"));
+  { TraceSpan span("task.update", "q1.0.0.0"); }
+  EXPECT_TRUE(tracer.spans("").empty());
+
+  EXPECT_THROW(tracer.configure(2, 100), facebook::velox::VeloxUserError);
+}
+
+TEST_F(TracerTest, nestedSpans) {
+  auto& tracer = Tracer::instance();
+  tracer.configure(1, 100);
+  ASSERT_TRUE(tracer.sampled("q1.0.0.0"));
+  {
+    TraceSpan update("task.update", "q1.0.0.0");
+    {
+      // A span of another query does not nest in the active one. The spans
+      // of the active query nest in it across the other query's span.
+      TraceSpan fetch("exchange.fetch", "q2.1.0.0");
+      TraceSpan parse("task.parse", "q1.0.0.0");
+    }
+  }
+  { TraceSpan update("task.update", "q1.0.0.1"); }
+
+  const auto spans = tracer.spans("q1");
+  ASSERT_EQ(spans.size(), 3);
+  EXPECT_EQ(spans[0].name, "task.parse");
+  EXPECT_EQ(spans[1].name, "task.update");
+  EXPECT_EQ(spans[0].parentSpanId, spans[1].spanId);
+  EXPECT_EQ(spans[1].parentSpanId, 0);
+  EXPECT_LE(spans[1].startMicros, spans[0].startMicros);
+  EXPECT_GE(spans[1].endMicros, spans[0].endMicros);
+  // A new root span once the previous one ended.
+  EXPECT_EQ(spans[2].taskId, "q1.0.0.1");
+  EXPECT_EQ(spans[2].parentSpanId, 0);
+
+  const auto fetch = tracer.spans("q2");
+  ASSERT_EQ(fetch.size(), 1);
+  EXPECT_EQ(fetch[0].parentSpanId, 0);
+  EXPECT_EQ(tracer.spans("").size(), 4);
+
+  // A span that ends on another thread nests like a scoped one.
+  {
+    TraceSpan update("task.update", "q1.0.0.2");
+    tracer.finishSpan(tracer.startSpan("task.results", "q1.0.0.2"));
+    tracer.finishSpan(tracer.startSpan("exchange.fetch", "q3.1.0.0"));
+  }
+  const auto results = tracer.spans("q1");
+  ASSERT_EQ(results.size(), 5);
+  EXPECT_EQ(results[3].name, "task.results");
+  EXPECT_EQ(results[3].parentSpanId, results[4].spanId);
+  EXPECT_EQ(tracer.spans("q3")[0].parentSpanId, 0);
+}
+
+TEST_F(TracerTest, ringBuffer) {
+  auto& tracer = Tracer::instance();
+  tracer.configure(1, 2);
+  for (auto name : {"a", "b", "c"}) {
+    TraceSpan span(name, "q1.0.0.0");
+  }
+  const auto spans = tracer.spans("q1");
+  ASSERT_EQ(spans.size(), 2);
+  EXPECT_EQ(spans[0].name, "b");
+  EXPECT_EQ(spans[1].name, "c");
+}
+
+TEST_F(TracerTest, otlp) {
+  auto& tracer = Tracer::instance();
+  tracer.configure(1, 100);
+  {
+    TraceSpan update("task.update", "q1.0.0.0");
+    TraceSpan parse("task.parse", "q1.0.0.0");
+  }
+  const auto otlp = Tracer::toOtlp(tracer.spans("q1"), "node1");
+  const auto& resourceSpans = otlp["resourceSpans"];
+  ASSERT_EQ(resourceSpans.size(), 1);
+  const auto& spans = resourceSpans[0]["scopeSpans"][0]["spans"];
+  ASSERT_EQ(spans.size(), 2);
+  EXPECT_EQ(spans[0]["name"], "task.parse");
+  EXPECT_EQ(spans[0]["traceId"], spans[1]["traceId"]);
+  EXPECT_EQ(spans[0]["traceId"].get<std::string>().size(), 32);
+  EXPECT_EQ(spans[0]["parentSpanId"], spans[1]["spanId"]);
+  EXPECT_FALSE(spans[1].contains("parentSpanId"));
+  EXPECT_EQ(
+      resourceSpans[0]["resource"]["attributes"][1]["value"]["stringValue"],
+      "node1");
+}
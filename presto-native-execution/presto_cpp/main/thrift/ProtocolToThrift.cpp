@@ -37,6 +37,19 @@ void toThrift(const int64_t& proto, int64_t& thrift) {
 void toThrift(const double& proto, double& thrift) {
   thrift = proto;
 }
+void toThrift(const protocol::DataSize& proto, int64_t& thrift) {
+  thrift = proto.getValue(protocol::DataUnit::BYTE);
+}
+void toThrift(const protocol::Duration& proto, double& thrift) {
+  thrift = proto.getValue(protocol::TimeUnit::MILLISECONDS);
+}
+
+// The protocol types without a Thrift equivalent, e.g. the polymorphic ones,
+// are JSON encoded.
+template <typename P>
+void toThrift(const P& proto, std::string& thrift) {
+  thrift = nlohmann::json(proto).dump();
+}
 
 template <typename P, typename T>
 void toThrift(const std::shared_ptr<P>& proto, std::shared_ptr<T>& thrift) {
@@ -46,6 +59,16 @@ void toThrift(const std::shared_ptr<P>& proto, std::shared_ptr<T>& thrift) {
   }
 }
 
+template <typename P, typename T>
+void toThrift(
+    const std::shared_ptr<P>& proto,
+    apache::thrift::optional_field_ref<T> thrift) {
+  if (proto) {
+    thrift.emplace();
+    toThrift(*proto, *thrift);
+  }
+}
+
 template <typename V, typename S>
 void toThrift(const std::vector<V>& v, std::set<S>& s) {
   S toItem;
@@ -64,12 +87,32 @@ void toThrift(const std::vector<P>& p, std::vector<T>& t) {
   }
 }
 
+template <typename PK, typename PV, typename TK, typename TV>
+void toThrift(const std::map<PK, PV>& p, std::map<TK, TV>& t) {
+  for (const auto& [fromKey, fromValue] : p) {
+    TK toKey;
+    toThrift(fromKey, toKey);
+    toThrift(fromValue, t[toKey]);
+  }
+}
+
 void toThrift(const protocol::TaskState& proto, thrift::TaskState& thrift) {
   thrift = (thrift::TaskState)((int)proto);
 }
 void toThrift(const protocol::ErrorType& proto, thrift::ErrorType& thrift) {
   thrift = (thrift::ErrorType)((int)proto);
 }
+void toThrift(
+    const protocol::BlockedReason& proto,
+    thrift::BlockedReason& thrift) {
+  thrift = (thrift::BlockedReason)((int)proto);
+}
+void toThrift(const protocol::RuntimeUnit& proto, thrift::RuntimeUnit& thrift) {
+  thrift = (thrift::RuntimeUnit)((int)proto);
+}
+void toThrift(const protocol::BufferState& proto, thrift::BufferState& thrift) {
+  thrift = (thrift::BufferState)((int)proto);
+}
 void toThrift(const protocol::Lifespan& proto, thrift::Lifespan& thrift) {
   toThrift(proto.isgroup, *thrift.grouped_ref());
   toThrift(proto.groupid, *thrift.groupId_ref());
@@ -139,5 +182,296 @@ void toThrift(
   toThrift(proto.errorCode, *thrift.errorCode_ref());
   toThrift(proto.remoteHost, *thrift.remoteHost_ref());
 }
+void toThrift(
+    const protocol::RuntimeMetric& proto,
+    thrift::RuntimeMetric& thrift) {
+  toThrift(proto.name, *thrift.name_ref());
+  toThrift(proto.unit, *thrift.unit_ref());
+  toThrift(proto.sum, *thrift.sum_ref());
+  toThrift(proto.count, *thrift.count_ref());
+  toThrift(proto.max, *thrift.max_ref());
+  toThrift(proto.min, *thrift.min_ref());
+}
+void toThrift(
+    const protocol::DistributionSnapshot& proto,
+    thrift::DistributionSnapshot& thrift) {
+  toThrift(proto.maxError, *thrift.maxError_ref());
+  toThrift(proto.count, *thrift.count_ref());
+  toThrift(proto.total, *thrift.total_ref());
+  toThrift(proto.p01, *thrift.p01_ref());
+  toThrift(proto.p05, *thrift.p05_ref());
+  toThrift(proto.p10, *thrift.p10_ref());
+  toThrift(proto.p25, *thrift.p25_ref());
+  toThrift(proto.p50, *thrift.p50_ref());
+  toThrift(proto.p75, *thrift.p75_ref());
+  toThrift(proto.p90, *thrift.p90_ref());
+  toThrift(proto.p95, *thrift.p95_ref());
+  toThrift(proto.p99, *thrift.p99_ref());
+  toThrift(proto.min, *thrift.min_ref());
+  toThrift(proto.max, *thrift.max_ref());
+  toThrift(proto.avg, *thrift.avg_ref());
+}
+void toThrift(
+    const protocol::OperatorStats& proto,
+    thrift::OperatorStats& thrift) {
+  toThrift(proto.stageId, *thrift.stageId_ref());
+  toThrift(proto.stageExecutionId, *thrift.stageExecutionId_ref());
+  toThrift(proto.pipelineId, *thrift.pipelineId_ref());
+  toThrift(proto.operatorId, *thrift.operatorId_ref());
+  toThrift(proto.planNodeId, *thrift.planNodeId_ref());
+  toThrift(proto.operatorType, *thrift.operatorType_ref());
+  toThrift(proto.totalDrivers, *thrift.totalDrivers_ref());
+  toThrift(proto.addInputCalls, *thrift.addInputCalls_ref());
+  toThrift(proto.addInputWall, *thrift.addInputWall_ref());
+  toThrift(proto.addInputCpu, *thrift.addInputCpu_ref());
+  toThrift(proto.addInputAllocation, *thrift.addInputAllocation_ref());
+  toThrift(proto.rawInputDataSize, *thrift.rawInputDataSize_ref());
+  toThrift(proto.rawInputPositions, *thrift.rawInputPositions_ref());
+  toThrift(proto.inputDataSize, *thrift.inputDataSize_ref());
+  toThrift(proto.inputPositions, *thrift.inputPositions_ref());
+  toThrift(
+      proto.sumSquaredInputPositions, *thrift.sumSquaredInputPositions_ref());
+  toThrift(proto.getOutputCalls, *thrift.getOutputCalls_ref());
+  toThrift(proto.getOutputWall, *thrift.getOutputWall_ref());
+  toThrift(proto.getOutputCpu, *thrift.getOutputCpu_ref());
+  toThrift(proto.getOutputAllocation, *thrift.getOutputAllocation_ref());
+  toThrift(proto.outputDataSize, *thrift.outputDataSize_ref());
+  toThrift(proto.outputPositions, *thrift.outputPositions_ref());
+  toThrift(
+      proto.physicalWrittenDataSize, *thrift.physicalWrittenDataSize_ref());
+  toThrift(proto.additionalCpu, *thrift.additionalCpu_ref());
+  toThrift(proto.blockedWall, *thrift.blockedWall_ref());
+  toThrift(proto.finishCalls, *thrift.finishCalls_ref());
+  toThrift(proto.finishWall, *thrift.finishWall_ref());
+  toThrift(proto.finishCpu, *thrift.finishCpu_ref());
+  toThrift(proto.finishAllocation, *thrift.finishAllocation_ref());
+  toThrift(proto.userMemoryReservation, *thrift.userMemoryReservation_ref());
+  toThrift(
+      proto.revocableMemoryReservation,
+      *thrift.revocableMemoryReservation_ref());
+  toThrift(
+      proto.systemMemoryReservation, *thrift.systemMemoryReservation_ref());
+  toThrift(
+      proto.peakUserMemoryReservation, *thrift.peakUserMemoryReservation_ref());
+  toThrift(
+      proto.peakSystemMemoryReservation,
+      *thrift.peakSystemMemoryReservation_ref());
+  toThrift(
+      proto.peakTotalMemoryReservation,
+      *thrift.peakTotalMemoryReservation_ref());
+  toThrift(proto.spilledDataSize, *thrift.spilledDataSize_ref());
+  toThrift(proto.blockedReason, thrift.blockedReason_ref());
+  toThrift(proto.runtimeStats, *thrift.runtimeStats_ref());
+}
+void toThrift(const protocol::DriverStats& proto, thrift::DriverStats& thrift) {
+  toThrift(proto.lifespan, *thrift.lifespan_ref());
+  toThrift(proto.createTime, *thrift.createTime_ref());
+  toThrift(proto.startTime, *thrift.startTime_ref());
+  toThrift(proto.endTime, *thrift.endTime_ref());
+  toThrift(proto.queuedTime, *thrift.queuedTime_ref());
+  toThrift(proto.elapsedTime, *thrift.elapsedTime_ref());
+  toThrift(proto.userMemoryReservation, *thrift.userMemoryReservation_ref());
+  toThrift(
+      proto.revocableMemoryReservation,
+      *thrift.revocableMemoryReservation_ref());
+  toThrift(
+      proto.systemMemoryReservation, *thrift.systemMemoryReservation_ref());
+  toThrift(proto.totalScheduledTime, *thrift.totalScheduledTime_ref());
+  toThrift(proto.totalCpuTime, *thrift.totalCpuTime_ref());
+  toThrift(proto.totalBlockedTime, *thrift.totalBlockedTime_ref());
+  toThrift(proto.fullyBlocked, *thrift.fullyBlocked_ref());
+  toThrift(proto.blockedReasons, *thrift.blockedReasons_ref());
+  toThrift(proto.totalAllocation, *thrift.totalAllocation_ref());
+  toThrift(proto.rawInputDataSize, *thrift.rawInputDataSize_ref());
+  toThrift(proto.rawInputPositions, *thrift.rawInputPositions_ref());
+  toThrift(proto.rawInputReadTime, *thrift.rawInputReadTime_ref());
+  toThrift(proto.processedInputDataSize, *thrift.processedInputDataSize_ref());
+  toThrift(
+      proto.processedInputPositions, *thrift.processedInputPositions_ref());
+  toThrift(proto.outputDataSize, *thrift.outputDataSize_ref());
+  toThrift(proto.outputPositions, *thrift.outputPositions_ref());
+  toThrift(
+      proto.physicalWrittenDataSize, *thrift.physicalWrittenDataSize_ref());
+  toThrift(proto.operatorStats, *thrift.operatorStats_ref());
+}
+void toThrift(
+    const protocol::PipelineStats& proto,
+    thrift::PipelineStats& thrift) {
+  toThrift(proto.pipelineId, *thrift.pipelineId_ref());
+  toThrift(proto.firstStartTime, *thrift.firstStartTime_ref());
+  toThrift(proto.lastStartTime, *thrift.lastStartTime_ref());
+  toThrift(proto.lastEndTime, *thrift.lastEndTime_ref());
+  toThrift(proto.inputPipeline, *thrift.inputPipeline_ref());
+  toThrift(proto.outputPipeline, *thrift.outputPipeline_ref());
+  toThrift(proto.totalDrivers, *thrift.totalDrivers_ref());
+  toThrift(proto.queuedDrivers, *thrift.queuedDrivers_ref());
+  toThrift(
+      proto.queuedPartitionedDrivers, *thrift.queuedPartitionedDrivers_ref());
+  toThrift(
+      proto.queuedPartitionedSplitsWeight,
+      *thrift.queuedPartitionedSplitsWeight_ref());
+  toThrift(proto.runningDrivers, *thrift.runningDrivers_ref());
+  toThrift(
+      proto.runningPartitionedDrivers, *thrift.runningPartitionedDrivers_ref());
+  toThrift(
+      proto.runningPartitionedSplitsWeight,
+      *thrift.runningPartitionedSplitsWeight_ref());
+  toThrift(proto.blockedDrivers, *thrift.blockedDrivers_ref());
+  toThrift(proto.completedDrivers, *thrift.completedDrivers_ref());
+  toThrift(
+      proto.userMemoryReservationInBytes,
+      *thrift.userMemoryReservationInBytes_ref());
+  toThrift(
+      proto.revocableMemoryReservationInBytes,
+      *thrift.revocableMemoryReservationInBytes_ref());
+  toThrift(
+      proto.systemMemoryReservationInBytes,
+      *thrift.systemMemoryReservationInBytes_ref());
+  toThrift(proto.queuedTime, *thrift.queuedTime_ref());
+  toThrift(proto.elapsedTime, *thrift.elapsedTime_ref());
+  toThrift(
+      proto.totalScheduledTimeInNanos, *thrift.totalScheduledTimeInNanos_ref());
+  toThrift(proto.totalCpuTimeInNanos, *thrift.totalCpuTimeInNanos_ref());
+  toThrift(
+      proto.totalBlockedTimeInNanos, *thrift.totalBlockedTimeInNanos_ref());
+  toThrift(proto.fullyBlocked, *thrift.fullyBlocked_ref());
+  toThrift(proto.blockedReasons, *thrift.blockedReasons_ref());
+  toThrift(proto.totalAllocationInBytes, *thrift.totalAllocationInBytes_ref());
+  toThrift(
+      proto.rawInputDataSizeInBytes, *thrift.rawInputDataSizeInBytes_ref());
+  toThrift(proto.rawInputPositions, *thrift.rawInputPositions_ref());
+  toThrift(
+      proto.processedInputDataSizeInBytes,
+      *thrift.processedInputDataSizeInBytes_ref());
+  toThrift(
+      proto.processedInputPositions, *thrift.processedInputPositions_ref());
+  toThrift(proto.outputDataSizeInBytes, *thrift.outputDataSizeInBytes_ref());
+  toThrift(proto.outputPositions, *thrift.outputPositions_ref());
+  toThrift(
+      proto.physicalWrittenDataSizeInBytes,
+      *thrift.physicalWrittenDataSizeInBytes_ref());
+  toThrift(proto.operatorSummaries, *thrift.operatorSummaries_ref());
+  toThrift(proto.drivers, *thrift.drivers_ref());
+}
+void toThrift(const protocol::TaskStats& proto, thrift::TaskStats& thrift) {
+  toThrift(proto.createTime, *thrift.createTime_ref());
+  toThrift(proto.firstStartTime, *thrift.firstStartTime_ref());
+  toThrift(proto.lastStartTime, *thrift.lastStartTime_ref());
+  toThrift(proto.lastEndTime, *thrift.lastEndTime_ref());
+  toThrift(proto.endTime, *thrift.endTime_ref());
+  toThrift(proto.elapsedTimeInNanos, *thrift.elapsedTimeInNanos_ref());
+  toThrift(proto.queuedTimeInNanos, *thrift.queuedTimeInNanos_ref());
+  toThrift(proto.totalDrivers, *thrift.totalDrivers_ref());
+  toThrift(proto.queuedDrivers, *thrift.queuedDrivers_ref());
+  toThrift(
+      proto.queuedPartitionedDrivers, *thrift.queuedPartitionedDrivers_ref());
+  toThrift(
+      proto.queuedPartitionedSplitsWeight,
+      *thrift.queuedPartitionedSplitsWeight_ref());
+  toThrift(proto.runningDrivers, *thrift.runningDrivers_ref());
+  toThrift(
+      proto.runningPartitionedDrivers, *thrift.runningPartitionedDrivers_ref());
+  toThrift(
+      proto.runningPartitionedSplitsWeight,
+      *thrift.runningPartitionedSplitsWeight_ref());
+  toThrift(proto.blockedDrivers, *thrift.blockedDrivers_ref());
+  toThrift(proto.completedDrivers, *thrift.completedDrivers_ref());
+  toThrift(proto.cumulativeUserMemory, *thrift.cumulativeUserMemory_ref());
+  toThrift(proto.cumulativeTotalMemory, *thrift.cumulativeTotalMemory_ref());
+  toThrift(
+      proto.userMemoryReservationInBytes,
+      *thrift.userMemoryReservationInBytes_ref());
+  toThrift(
+      proto.revocableMemoryReservationInBytes,
+      *thrift.revocableMemoryReservationInBytes_ref());
+  toThrift(
+      proto.systemMemoryReservationInBytes,
+      *thrift.systemMemoryReservationInBytes_ref());
+  toThrift(proto.peakTotalMemoryInBytes, *thrift.peakTotalMemoryInBytes_ref());
+  toThrift(proto.peakUserMemoryInBytes, *thrift.peakUserMemoryInBytes_ref());
+  toThrift(
+      proto.peakNodeTotalMemoryInBytes,
+      *thrift.peakNodeTotalMemoryInBytes_ref());
+  toThrift(
+      proto.totalScheduledTimeInNanos, *thrift.totalScheduledTimeInNanos_ref());
+  toThrift(proto.totalCpuTimeInNanos, *thrift.totalCpuTimeInNanos_ref());
+  toThrift(
+      proto.totalBlockedTimeInNanos, *thrift.totalBlockedTimeInNanos_ref());
+  toThrift(proto.fullyBlocked, *thrift.fullyBlocked_ref());
+  toThrift(proto.blockedReasons, *thrift.blockedReasons_ref());
+  toThrift(proto.totalAllocationInBytes, *thrift.totalAllocationInBytes_ref());
+  toThrift(
+      proto.rawInputDataSizeInBytes, *thrift.rawInputDataSizeInBytes_ref());
+  toThrift(proto.rawInputPositions, *thrift.rawInputPositions_ref());
+  toThrift(
+      proto.processedInputDataSizeInBytes,
+      *thrift.processedInputDataSizeInBytes_ref());
+  toThrift(
+      proto.processedInputPositions, *thrift.processedInputPositions_ref());
+  toThrift(proto.outputDataSizeInBytes, *thrift.outputDataSizeInBytes_ref());
+  toThrift(proto.outputPositions, *thrift.outputPositions_ref());
+  toThrift(
+      proto.physicalWrittenDataSizeInBytes,
+      *thrift.physicalWrittenDataSizeInBytes_ref());
+  toThrift(proto.fullGcCount, *thrift.fullGcCount_ref());
+  toThrift(proto.fullGcTimeInMillis, *thrift.fullGcTimeInMillis_ref());
+  toThrift(proto.pipelines, *thrift.pipelines_ref());
+  toThrift(proto.runtimeStats, *thrift.runtimeStats_ref());
+}
+void toThrift(
+    const protocol::PageBufferInfo& proto,
+    thrift::PageBufferInfo& thrift) {
+  toThrift(proto.partition, *thrift.partition_ref());
+  toThrift(proto.bufferedPages, *thrift.bufferedPages_ref());
+  toThrift(proto.bufferedBytes, *thrift.bufferedBytes_ref());
+  toThrift(proto.rowsAdded, *thrift.rowsAdded_ref());
+  toThrift(proto.pagesAdded, *thrift.pagesAdded_ref());
+}
+void toThrift(const protocol::BufferInfo& proto, thrift::BufferInfo& thrift) {
+  toThrift(proto.bufferId, *thrift.bufferId_ref());
+  toThrift(proto.finished, *thrift.finished_ref());
+  toThrift(proto.bufferedPages, *thrift.bufferedPages_ref());
+  toThrift(proto.pagesSent, *thrift.pagesSent_ref());
+  toThrift(proto.pageBufferInfo, *thrift.pageBufferInfo_ref());
+}
+void toThrift(
+    const protocol::OutputBufferInfo& proto,
+    thrift::OutputBufferInfo& thrift) {
+  toThrift(proto.type, *thrift.type_ref());
+  toThrift(proto.state, *thrift.state_ref());
+  toThrift(proto.canAddBuffers, *thrift.canAddBuffers_ref());
+  toThrift(proto.canAddPages, *thrift.canAddPages_ref());
+  toThrift(proto.totalBufferedBytes, *thrift.totalBufferedBytes_ref());
+  toThrift(proto.totalBufferedPages, *thrift.totalBufferedPages_ref());
+  toThrift(proto.totalRowsSent, *thrift.totalRowsSent_ref());
+  toThrift(proto.totalPagesSent, *thrift.totalPagesSent_ref());
+  toThrift(proto.buffers, *thrift.buffers_ref());
+}
+void toThrift(
+    const protocol::MetadataUpdates& proto,
+    thrift::MetadataUpdates& thrift) {
+  toThrift(proto.connectorId, *thrift.connectorId_ref());
+}
+void toThrift(const protocol::TaskInfo& proto, thrift::TaskInfo& thrift) {
+  toThrift(proto.taskId, *thrift.taskId_ref());
+  toThrift(proto.taskStatus, *thrift.taskStatus_ref());
+  toThrift(proto.lastHeartbeat, *thrift.lastHeartbeat_ref());
+  toThrift(proto.outputBuffers, *thrift.outputBuffers_ref());
+  toThrift(proto.noMoreSplits, *thrift.noMoreSplits_ref());
+  toThrift(proto.stats, *thrift.stats_ref());
+  toThrift(proto.needsPlan, *thrift.needsPlan_ref());
+  toThrift(proto.metadataUpdates, *thrift.metadataUpdates_ref());
+  toThrift(proto.nodeId, *thrift.nodeId_ref());
+}
+void toThrift(
+    const protocol::TaskUpdateRequest& proto,
+    thrift::TaskUpdateRequest& thrift) {
+  toThrift(proto.session, *thrift.session_ref());
+  toThrift(proto.extraCredentials, *thrift.extraCredentials_ref());
+  toThrift(proto.fragment, thrift.fragment_ref());
+  toThrift(proto.sources, *thrift.sources_ref());
+  toThrift(proto.outputIds, *thrift.outputIds_ref());
+  toThrift(proto.tableWriteInfo, thrift.tableWriteInfo_ref());
+}
 
 } // namespace facebook::presto
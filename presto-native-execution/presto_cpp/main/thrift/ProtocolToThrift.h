@@ -22,8 +22,13 @@
 
 namespace facebook::presto {
 
-void toThrift(protocol::TaskState& proto, thrift::TaskState& thrift);
-void toThrift(protocol::ErrorType& proto, thrift::ErrorType& thrift);
+void toThrift(const protocol::TaskState& proto, thrift::TaskState& thrift);
+void toThrift(const protocol::ErrorType& proto, thrift::ErrorType& thrift);
+void toThrift(
+    const protocol::BlockedReason& proto,
+    thrift::BlockedReason& thrift);
+void toThrift(const protocol::RuntimeUnit& proto, thrift::RuntimeUnit& thrift);
+void toThrift(const protocol::BufferState& proto, thrift::BufferState& thrift);
 void toThrift(const protocol::Lifespan& proto, thrift::Lifespan& thrift);
 void toThrift(
     const protocol::ErrorLocation& proto,
@@ -34,5 +39,33 @@ void toThrift(const protocol::ErrorCode& proto, thrift::ErrorCode& thrift);
 void toThrift(
     const protocol::ExecutionFailureInfo& proto,
     thrift::ExecutionFailureInfo& thrift);
+void toThrift(
+    const protocol::RuntimeMetric& proto,
+    thrift::RuntimeMetric& thrift);
+void toThrift(
+    const protocol::DistributionSnapshot& proto,
+    thrift::DistributionSnapshot& thrift);
+void toThrift(
+    const protocol::OperatorStats& proto,
+    thrift::OperatorStats& thrift);
+void toThrift(const protocol::DriverStats& proto, thrift::DriverStats& thrift);
+void toThrift(
+    const protocol::PipelineStats& proto,
+    thrift::PipelineStats& thrift);
+void toThrift(const protocol::TaskStats& proto, thrift::TaskStats& thrift);
+void toThrift(
+    const protocol::PageBufferInfo& proto,
+    thrift::PageBufferInfo& thrift);
+void toThrift(const protocol::BufferInfo& proto, thrift::BufferInfo& thrift);
+void toThrift(
+    const protocol::OutputBufferInfo& proto,
+    thrift::OutputBufferInfo& thrift);
+void toThrift(
+    const protocol::MetadataUpdates& proto,
+    thrift::MetadataUpdates& thrift);
+void toThrift(const protocol::TaskInfo& proto, thrift::TaskInfo& thrift);
+void toThrift(
+    const protocol::TaskUpdateRequest& proto,
+    thrift::TaskUpdateRequest& thrift);
 
 } // namespace facebook::presto
@@ -15,23 +15,20 @@
 
 #include <thrift/lib/cpp2/protocol/BinaryProtocol.h>
 
+// Decodes 'data' in place. The chain may span several buffers, e.g. as
+// received by the http server.
 template <typename T>
-void thriftRead(std::string data, std::shared_ptr<T>& buffer) {
-  auto inBuf = folly::IOBuf::copyBuffer(data);
+void thriftRead(const folly::IOBuf& data, std::shared_ptr<T>& buffer) {
   apache::thrift::BinaryProtocolReader reader;
-  reader.setInput(inBuf.get());
+  reader.setInput(&data);
   buffer->read(&reader);
 }
 
 template <typename T>
-std::string thriftWrite(T& data) {
+std::unique_ptr<folly::IOBuf> thriftWrite(T& data) {
   folly::IOBufQueue outQueue;
   apache::thrift::BinaryProtocolWriter writer;
   writer.setOutput(&outQueue);
   data.write(&writer);
-
-  std::string str;
-  outQueue.appendToString(str);
-
-  return str;
+  return outQueue.move();
 }
@@ -30,6 +30,25 @@ enum ErrorType {
   EXTERNAL = 3,
 }
 
+enum BlockedReason {
+  WAITING_FOR_MEMORY = 0,
+}
+
+enum RuntimeUnit {
+  NONE = 0,
+  NANO = 1,
+  BYTE = 2,
+}
+
+enum BufferState {
+  OPEN = 0,
+  NO_MORE_BUFFERS = 1,
+  NO_MORE_PAGES = 2,
+  FLUSHING = 3,
+  FINISHED = 4,
+  FAILED = 5,
+}
+
 struct Lifespan {
   1: bool grouped;
   2: i32 groupId;
@@ -82,6 +101,242 @@ struct ExecutionFailureInfo {
   8: HostAddress remoteHost;
 }
 
+// The DataSize fields of the stats are in bytes and the Duration fields in
+// milliseconds.
+struct RuntimeMetric {
+  1: string name;
+  2: RuntimeUnit unit;
+  3: i64 sum;
+  4: i64 count;
+  5: i64 max;
+  6: i64 min;
+}
+
+struct DistributionSnapshot {
+  1: double maxError;
+  2: double count;
+  3: double total;
+  4: i64 p01;
+  5: i64 p05;
+  6: i64 p10;
+  7: i64 p25;
+  8: i64 p50;
+  9: i64 p75;
+  10: i64 p90;
+  11: i64 p95;
+  12: i64 p99;
+  13: i64 min;
+  14: i64 max;
+  15: double avg;
+}
+
+struct OperatorStats {
+  1: i32 stageId;
+  2: i32 stageExecutionId;
+  3: i32 pipelineId;
+  4: i32 operatorId;
+  5: string planNodeId;
+  6: string operatorType;
+  7: i64 totalDrivers;
+  8: i64 addInputCalls;
+  9: double addInputWall;
+  10: double addInputCpu;
+  11: i64 addInputAllocation;
+  12: i64 rawInputDataSize;
+  13: i64 rawInputPositions;
+  14: i64 inputDataSize;
+  15: i64 inputPositions;
+  16: double sumSquaredInputPositions;
+  17: i64 getOutputCalls;
+  18: double getOutputWall;
+  19: double getOutputCpu;
+  20: i64 getOutputAllocation;
+  21: i64 outputDataSize;
+  22: i64 outputPositions;
+  23: i64 physicalWrittenDataSize;
+  24: double additionalCpu;
+  25: double blockedWall;
+  26: i64 finishCalls;
+  27: double finishWall;
+  28: double finishCpu;
+  29: i64 finishAllocation;
+  30: i64 userMemoryReservation;
+  31: i64 revocableMemoryReservation;
+  32: i64 systemMemoryReservation;
+  33: i64 peakUserMemoryReservation;
+  34: i64 peakSystemMemoryReservation;
+  35: i64 peakTotalMemoryReservation;
+  36: i64 spilledDataSize;
+  37: optional BlockedReason blockedReason;
+  38: map<string, RuntimeMetric> runtimeStats;
+}
+
+struct DriverStats {
+  1: Lifespan lifespan;
+  2: string createTime;
+  3: string startTime;
+  4: string endTime;
+  5: double queuedTime;
+  6: double elapsedTime;
+  7: i64 userMemoryReservation;
+  8: i64 revocableMemoryReservation;
+  9: i64 systemMemoryReservation;
+  10: double totalScheduledTime;
+  11: double totalCpuTime;
+  12: double totalBlockedTime;
+  13: bool fullyBlocked;
+  14: list<BlockedReason> blockedReasons;
+  15: i64 totalAllocation;
+  16: i64 rawInputDataSize;
+  17: i64 rawInputPositions;
+  18: double rawInputReadTime;
+  19: i64 processedInputDataSize;
+  20: i64 processedInputPositions;
+  21: i64 outputDataSize;
+  22: i64 outputPositions;
+  23: i64 physicalWrittenDataSize;
+  24: list<OperatorStats> operatorStats;
+}
+
+struct PipelineStats {
+  1: i32 pipelineId;
+  2: string firstStartTime;
+  3: string lastStartTime;
+  4: string lastEndTime;
+  5: bool inputPipeline;
+  6: bool outputPipeline;
+  7: i32 totalDrivers;
+  8: i32 queuedDrivers;
+  9: i32 queuedPartitionedDrivers;
+  10: i64 queuedPartitionedSplitsWeight;
+  11: i32 runningDrivers;
+  12: i32 runningPartitionedDrivers;
+  13: i64 runningPartitionedSplitsWeight;
+  14: i32 blockedDrivers;
+  15: i32 completedDrivers;
+  16: i64 userMemoryReservationInBytes;
+  17: i64 revocableMemoryReservationInBytes;
+  18: i64 systemMemoryReservationInBytes;
+  19: DistributionSnapshot queuedTime;
+  20: DistributionSnapshot elapsedTime;
+  21: i64 totalScheduledTimeInNanos;
+  22: i64 totalCpuTimeInNanos;
+  23: i64 totalBlockedTimeInNanos;
+  24: bool fullyBlocked;
+  25: list<BlockedReason> blockedReasons;
+  26: i64 totalAllocationInBytes;
+  27: i64 rawInputDataSizeInBytes;
+  28: i64 rawInputPositions;
+  29: i64 processedInputDataSizeInBytes;
+  30: i64 processedInputPositions;
+  31: i64 outputDataSizeInBytes;
+  32: i64 outputPositions;
+  33: i64 physicalWrittenDataSizeInBytes;
+  34: list<OperatorStats> operatorSummaries;
+  35: list<DriverStats> drivers;
+}
+
+struct TaskStats {
+  1: string createTime;
+  2: string firstStartTime;
+  3: string lastStartTime;
+  4: string lastEndTime;
+  5: string endTime;
+  6: i64 elapsedTimeInNanos;
+  7: i64 queuedTimeInNanos;
+  8: i32 totalDrivers;
+  9: i32 queuedDrivers;
+  10: i32 queuedPartitionedDrivers;
+  11: i64 queuedPartitionedSplitsWeight;
+  12: i32 runningDrivers;
+  13: i32 runningPartitionedDrivers;
+  14: i64 runningPartitionedSplitsWeight;
+  15: i32 blockedDrivers;
+  16: i32 completedDrivers;
+  17: double cumulativeUserMemory;
+  18: double cumulativeTotalMemory;
+  19: i64 userMemoryReservationInBytes;
+  20: i64 revocableMemoryReservationInBytes;
+  21: i64 systemMemoryReservationInBytes;
+  22: i64 peakTotalMemoryInBytes;
+  23: i64 peakUserMemoryInBytes;
+  24: i64 peakNodeTotalMemoryInBytes;
+  25: i64 totalScheduledTimeInNanos;
+  26: i64 totalCpuTimeInNanos;
+  27: i64 totalBlockedTimeInNanos;
+  28: bool fullyBlocked;
+  29: list<BlockedReason> blockedReasons;
+  30: i64 totalAllocationInBytes;
+  31: i64 rawInputDataSizeInBytes;
+  32: i64 rawInputPositions;
+  33: i64 processedInputDataSizeInBytes;
+  34: i64 processedInputPositions;
+  35: i64 outputDataSizeInBytes;
+  36: i64 outputPositions;
+  37: i64 physicalWrittenDataSizeInBytes;
+  38: i32 fullGcCount;
+  39: i64 fullGcTimeInMillis;
+  40: list<PipelineStats> pipelines;
+  41: map<string, RuntimeMetric> runtimeStats;
+}
+
+struct PageBufferInfo {
+  1: i32 partition;
+  2: i64 bufferedPages;
+  3: i64 bufferedBytes;
+  4: i64 rowsAdded;
+  5: i64 pagesAdded;
+}
+
+struct BufferInfo {
+  1: string bufferId;
+  2: bool finished;
+  3: i32 bufferedPages;
+  4: i64 pagesSent;
+  5: PageBufferInfo pageBufferInfo;
+}
+
+struct OutputBufferInfo {
+  1: string type;
+  2: BufferState state;
+  3: bool canAddBuffers;
+  4: bool canAddPages;
+  5: i64 totalBufferedBytes;
+  6: i64 totalBufferedPages;
+  7: i64 totalRowsSent;
+  8: i64 totalPagesSent;
+  9: list<BufferInfo> buffers;
+}
+
+struct MetadataUpdates {
+  1: string connectorId;
+}
+
+struct TaskInfo {
+  1: string taskId;
+  2: TaskStatus taskStatus;
+  3: string lastHeartbeat;
+  4: OutputBufferInfo outputBuffers;
+  5: list<string> noMoreSplits;
+  6: TaskStats stats;
+  7: bool needsPlan;
+  8: MetadataUpdates metadataUpdates;
+  9: string nodeId;
+}
+
+// The members which have no Thrift equivalent, i.e. the session, the task
+// sources with their connector splits, the output buffers and the table write
+// info, are JSON encoded. 'fragment' is the base64 encoded JSON PlanFragment
+// as in the JSON TaskUpdateRequest.
+struct TaskUpdateRequest {
+  1: binary session;
+  2: map<string, string> extraCredentials;
+  3: optional string fragment;
+  4: binary sources;
+  5: binary outputIds;
+  6: optional binary tableWriteInfo;
+}
+
 service PrestoThrift {
   void fake();
 }
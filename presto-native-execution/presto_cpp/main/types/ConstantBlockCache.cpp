@@ -0,0 +1,56 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/types/ConstantBlockCache.h"
+#include "presto_cpp/external/xxh3.h"
+#include "presto_cpp/main/common/Counters.h"
+#include "velox/common/base/StatsReporter.h"
+
+namespace facebook::presto {
+
+velox::VectorPtr ConstantBlockCache::getOrDecode(
+    const velox::TypePtr& type,
+    std::string_view encoded,
+    const std::function<velox::VectorPtr()>& decode) {
+  if (cache_.maxBytes() == 0 || encoded.size() < kMinCachedBlockSize) {
+    return decode();
+  }
+  const uint64_t hash = XXH3_64bits_withSeed(
+      encoded.data(), encoded.size(), static_cast<uint64_t>(type->kind()));
+  {
+    std::lock_guard<std::mutex> l(mutex_);
+    auto* entry = cache_.get(hash);
+    if (entry != nullptr && entry->encoded == encoded &&
+        entry->type->equivalent(*type)) {
+      REPORT_ADD_STAT_VALUE(kCounterNumConstantBlockCacheHits);
+      return entry->vector;
+    }
+  }
+
+  // Decodes outside of the lock. The concurrent misses for the same block all
+  // decode it.
+  REPORT_ADD_STAT_VALUE(kCounterNumConstantBlockCacheMisses);
+  auto vector = decode();
+  const uint64_t bytes = vector->retainedSize() + encoded.size();
+  if (bytes > cache_.maxBytes()) {
+    return vector;
+  }
+
+  // Replaces the block decoded concurrently or a different block with the
+  // same hash.
+  std::lock_guard<std::mutex> l(mutex_);
+  cache_.put(hash, Entry{type, std::string(encoded), vector}, bytes);
+  return vector;
+}
+
+} // namespace facebook::presto
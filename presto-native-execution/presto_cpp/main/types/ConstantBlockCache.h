@@ -0,0 +1,68 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <functional>
+#include <mutex>
+#include <string_view>
+
+#include "presto_cpp/main/common/ByteLruCache.h"
+#include "velox/vector/BaseVector.h"
+
+namespace facebook::presto {
+
+/// A bounded LRU cache of the vectors decoded from the base64 encoded Presto
+/// blocks of the constants in the plan fragments, e.g. large IN lists. The
+/// tasks of a query running on the same worker carry the same literals, so
+/// each is decoded once per worker. The cached vectors are shared read-only by
+/// the constant expressions of the plans.
+class ConstantBlockCache {
+ public:
+  /// The encoded blocks shorter than this are decoded without the cache.
+  static constexpr size_t kMinCachedBlockSize = 128;
+
+  /// Caches up to 'maxBytes' of vectors. Caches nothing if 'maxBytes' is 0.
+  explicit ConstantBlockCache(uint64_t maxBytes) : cache_(maxBytes) {}
+
+  /// Returns the vector of 'type' decoded from the block 'encoded'. On a miss,
+  /// calls 'decode' which returns the decoded vector.
+  velox::VectorPtr getOrDecode(
+      const velox::TypePtr& type,
+      std::string_view encoded,
+      const std::function<velox::VectorPtr()>& decode);
+
+  size_t size() const {
+    std::lock_guard<std::mutex> l(mutex_);
+    return cache_.size();
+  }
+
+  uint64_t bytes() const {
+    std::lock_guard<std::mutex> l(mutex_);
+    return cache_.bytes();
+  }
+
+ private:
+  struct Entry {
+    // The type and block to tell apart the blocks with the same hash.
+    velox::TypePtr type;
+    std::string encoded;
+    velox::VectorPtr vector;
+  };
+
+  mutable std::mutex mutex_;
+  // The cached vectors keyed by the hashes of their types and blocks.
+  ByteLruCache<uint64_t, Entry> cache_;
+};
+
+} // namespace facebook::presto
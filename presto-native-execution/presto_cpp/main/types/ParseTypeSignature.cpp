@@ -0,0 +1,379 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/main/types/ParseTypeSignature.h"
+
+#include <cctype>
+
+#include <folly/concurrency/ConcurrentHashMap.h>
+
+#include "presto_cpp/main/types/TypeSignatureTypeConverter.h"
+
+using namespace facebook::velox;
+
+namespace facebook::presto {
+namespace {
+
+// Caps the number of memoized signatures. The signatures seen by a worker
+// come from the table schemas and the queries, so this is only reached with
+// an unusually diverse workload, in which case the new signatures are parsed
+// without being memoized.
+constexpr size_t kMaxMemoizedSignatures = 10'000;
+
+// The lexer tokens of the type signature grammar in TypeSignature.g4.
+enum class TokenKind {
+  kEnd,
+  kWord,
+  kTypeWithSpaces,
+  kQuotedId,
+  kNumber,
+  kOpenParen,
+  kCloseParen,
+  kComma,
+  kInvalid,
+};
+
+struct Token {
+  TokenKind kind;
+  std::string_view text;
+};
+
+// The types whose names contain spaces. They are lexed as a single token.
+constexpr std::string_view kTypesWithSpaces[] = {
+    "double precision",
+    "time with time zone",
+    "timestamp with time zone",
+    "interval year to month",
+    "interval day to second",
+};
+
+bool isWordStart(char c) {
+  return std::isalpha(static_cast<unsigned char>(c)) || c == '_';
+}
+
+bool isWordChar(char c) {
+  return std::isalnum(static_cast<unsigned char>(c)) || c == '_' ||
+      c == ':' || c == '@';
+}
+
+bool isDigit(char c) {
+  return c >= '0' && c <= '9';
+}
+
+bool equalsIgnoreCase(std::string_view lhs, std::string_view rhs) {
+  if (lhs.size() != rhs.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < lhs.size(); ++i) {
+    if (std::tolower(static_cast<unsigned char>(lhs[i])) !=
+        std::tolower(static_cast<unsigned char>(rhs[i]))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Recursive descent parser for the grammar in TypeSignature.g4. It works on
+// views into the signature and only allocates the field names of the row
+// types. Returns nullptr from parse() for anything it doesn't recognize,
+// including the constructs the grammar accepts but which are not used in
+// practice, e.g. several numbers as varchar parameters.
+class SignatureParser {
+ public:
+  explicit SignatureParser(std::string_view signature)
+      : signature_(signature) {
+    advance();
+  }
+
+  TypePtr parse() {
+    std::string name;
+    auto type = parseTypeSpec(name);
+    if (type == nullptr || token_.kind != TokenKind::kEnd) {
+      return nullptr;
+    }
+    return type;
+  }
+
+ private:
+  // Moves 'token_' to the next token.
+  void advance() {
+    while (pos_ < signature_.size() &&
+           (signature_[pos_] == ' ' || signature_[pos_] == '\t' ||
+            signature_[pos_] == '\n')) {
+      ++pos_;
+    }
+    if (pos_ == signature_.size()) {
+      token_ = {TokenKind::kEnd, {}};
+      return;
+    }
+
+    const auto rest = signature_.substr(pos_);
+    const char c = rest[0];
+    switch (c) {
+      case '(':
+        token_ = {TokenKind::kOpenParen, rest.substr(0, 1)};
+        ++pos_;
+        return;
+      case ')':
+        token_ = {TokenKind::kCloseParen, rest.substr(0, 1)};
+        ++pos_;
+        return;
+      case ',':
+        token_ = {TokenKind::kComma, rest.substr(0, 1)};
+        ++pos_;
+        return;
+      default:
+        break;
+    }
+
+    size_t length = 1;
+    if (isDigit(c)) {
+      while (length < rest.size() && isDigit(rest[length])) {
+        ++length;
+      }
+      token_ = {TokenKind::kNumber, rest.substr(0, length)};
+    } else if (c == '"') {
+      if (rest.size() < 2 || !isWordStart(rest[1])) {
+        token_ = {TokenKind::kInvalid, {}};
+        return;
+      }
+      length = 2;
+      while (length < rest.size() &&
+             (isWordChar(rest[length]) || rest[length] == ' ')) {
+        ++length;
+      }
+      if (length == rest.size() || rest[length] != '"') {
+        token_ = {TokenKind::kInvalid, {}};
+        return;
+      }
+      ++length;
+      token_ = {TokenKind::kQuotedId, rest.substr(0, length)};
+    } else if (isWordStart(c)) {
+      for (auto typeWithSpaces : kTypesWithSpaces) {
+        if (rest.size() >= typeWithSpaces.size() &&
+            equalsIgnoreCase(
+                rest.substr(0, typeWithSpaces.size()), typeWithSpaces)) {
+          if (rest.size() > typeWithSpaces.size() &&
+              isWordChar(rest[typeWithSpaces.size()])) {
+            // The longest match lexing of ANTLR is not worth replicating for
+            // such signatures.
+            token_ = {TokenKind::kInvalid, {}};
+            return;
+          }
+          token_ = {
+              TokenKind::kTypeWithSpaces,
+              rest.substr(0, typeWithSpaces.size())};
+          pos_ += typeWithSpaces.size();
+          return;
+        }
+      }
+      while (length < rest.size() && isWordChar(rest[length])) {
+        ++length;
+      }
+      token_ = {TokenKind::kWord, rest.substr(0, length)};
+    } else {
+      token_ = {TokenKind::kInvalid, {}};
+      return;
+    }
+    pos_ += length;
+  }
+
+  bool consume(TokenKind kind) {
+    if (token_.kind != kind) {
+      return false;
+    }
+    advance();
+    return true;
+  }
+
+  // Returns the kind of the token following 'token_' without consuming it.
+  TokenKind peekKind() {
+    const auto pos = pos_;
+    const auto token = token_;
+    advance();
+    const auto kind = token_.kind;
+    pos_ = pos;
+    token_ = token;
+    return kind;
+  }
+
+  // type_spec : named_type | type. Sets 'name' to the field name of a named
+  // type.
+  TypePtr parseTypeSpec(std::string& name) {
+    if (token_.kind == TokenKind::kQuotedId) {
+      name = std::string(token_.text.substr(1, token_.text.size() - 2));
+      advance();
+      return parseType();
+    }
+    if (token_.kind == TokenKind::kWord) {
+      const auto next = peekKind();
+      if (next == TokenKind::kWord || next == TokenKind::kTypeWithSpaces) {
+        name = std::string(token_.text);
+        advance();
+        return parseType();
+      }
+    }
+    return parseType();
+  }
+
+  TypePtr parseType() {
+    if (token_.kind == TokenKind::kTypeWithSpaces) {
+      auto type = typeFromString(std::string(token_.text));
+      advance();
+      return type;
+    }
+    if (token_.kind != TokenKind::kWord) {
+      return nullptr;
+    }
+
+    const auto word = token_.text;
+    advance();
+    const bool parameterized = token_.kind == TokenKind::kOpenParen;
+
+    if (equalsIgnoreCase(word, "row")) {
+      return parameterized ? parseRow() : nullptr;
+    }
+    if (equalsIgnoreCase(word, "map")) {
+      return parameterized ? parseMap() : nullptr;
+    }
+    if (equalsIgnoreCase(word, "array")) {
+      return parameterized ? parseArray() : nullptr;
+    }
+    if (equalsIgnoreCase(word, "decimal")) {
+      return parameterized ? parseDecimal() : nullptr;
+    }
+    if (equalsIgnoreCase(word, "varchar") ||
+        equalsIgnoreCase(word, "varbinary")) {
+      if (parameterized) {
+        // The length is not part of the Velox type.
+        advance();
+        consume(TokenKind::kNumber);
+        if (!consume(TokenKind::kCloseParen)) {
+          return nullptr;
+        }
+      }
+      return typeFromString(std::string(word));
+    }
+    if (parameterized) {
+      return nullptr;
+    }
+    return typeFromString(std::string(word));
+  }
+
+  // row_type : 'row' '(' type_list ')'. 'token_' is at the open paren.
+  TypePtr parseRow() {
+    advance();
+    std::vector<std::string> names;
+    std::vector<TypePtr> types;
+    do {
+      std::string name;
+      auto type = parseTypeSpec(name);
+      if (type == nullptr) {
+        return nullptr;
+      }
+      names.push_back(std::move(name));
+      types.push_back(std::move(type));
+    } while (consume(TokenKind::kComma));
+    if (!consume(TokenKind::kCloseParen)) {
+      return nullptr;
+    }
+    return ROW(std::move(names), std::move(types));
+  }
+
+  // map_type : 'map' '(' type ',' type ')'. 'token_' is at the open paren.
+  TypePtr parseMap() {
+    advance();
+    auto keyType = parseType();
+    if (keyType == nullptr || !consume(TokenKind::kComma)) {
+      return nullptr;
+    }
+    auto valueType = parseType();
+    if (valueType == nullptr || !consume(TokenKind::kCloseParen)) {
+      return nullptr;
+    }
+    return MAP(std::move(keyType), std::move(valueType));
+  }
+
+  // array_type : 'array' '(' type ')'. 'token_' is at the open paren.
+  TypePtr parseArray() {
+    advance();
+    auto elementType = parseType();
+    if (elementType == nullptr || !consume(TokenKind::kCloseParen)) {
+      return nullptr;
+    }
+    return ARRAY(std::move(elementType));
+  }
+
+  // decimal_type : 'decimal' '(' NUMBER ',' NUMBER ')'. 'token_' is at the
+  // open paren.
+  TypePtr parseDecimal() {
+    advance();
+    int precision;
+    int scale;
+    if (!parseInt(precision) || !consume(TokenKind::kComma) ||
+        !parseInt(scale) || !consume(TokenKind::kCloseParen)) {
+      return nullptr;
+    }
+    return DECIMAL(precision, scale);
+  }
+
+  bool parseInt(int& value) {
+    // Longer numbers are not valid decimal parameters anyway.
+    if (token_.kind != TokenKind::kNumber || token_.text.size() > 9) {
+      return false;
+    }
+    value = 0;
+    for (auto c : token_.text) {
+      value = value * 10 + (c - '0');
+    }
+    advance();
+    return true;
+  }
+
+  const std::string_view signature_;
+  size_t pos_{0};
+  Token token_;
+};
+
+folly::ConcurrentHashMap<std::string, TypePtr>& memoizedTypes() {
+  static folly::ConcurrentHashMap<std::string, TypePtr> memoizedTypes;
+  return memoizedTypes;
+}
+} // namespace
+
+TypePtr tryParseTypeSignature(std::string_view signature) {
+  try {
+    return SignatureParser(signature).parse();
+  } catch (const VeloxException&) {
+    // Unknown type name. Leave the error to the ANTLR parser.
+    return nullptr;
+  }
+}
+
+TypePtr parseTypeSignature(const std::string& signature) {
+  auto& types = memoizedTypes();
+  auto it = types.find(signature);
+  if (it != types.end()) {
+    return it->second;
+  }
+
+  auto type = tryParseTypeSignature(signature);
+  if (type == nullptr) {
+    type = TypeSignatureTypeConverter::parse(signature);
+  }
+  if (types.size() < kMaxMemoizedSignatures) {
+    types.insert(signature, type);
+  }
+  return type;
+}
+} // namespace facebook::presto
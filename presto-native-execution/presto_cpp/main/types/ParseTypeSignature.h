@@ -15,5 +15,13 @@
 #include "velox/type/Type.h"
 
 namespace facebook::presto {
+/// Returns the type for the Presto type 'signature'. The parsed types are
+/// memoized process-wide. Throws a user error if 'signature' is invalid.
 facebook::velox::TypePtr parseTypeSignature(const std::string& signature);
+
+/// Parses 'signature' with the hand-written parser which covers the
+/// signatures Presto sends in the plan fragments. Returns nullptr if it can't
+/// parse 'signature', in which case parseTypeSignature() resorts to the ANTLR
+/// parser, which either parses it or produces the error.
+facebook::velox::TypePtr tryParseTypeSignature(std::string_view signature);
 } // namespace facebook::presto
@@ -61,7 +61,9 @@ class PrestoTaskId {
   }
 
   int parseInt(const std::string& taskId, int start, int end) {
-    return folly::to<int>(taskId.substr(start, end - start));
+    // Converts in place without copying the substring.
+    return folly::to<int>(
+        folly::StringPiece(taskId).subpiece(start, end - start));
   }
 
   std::string queryId_;
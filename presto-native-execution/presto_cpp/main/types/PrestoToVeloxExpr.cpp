@@ -17,6 +17,7 @@
 #include "presto_cpp/main/types/ParseTypeSignature.h"
 #include "presto_cpp/presto_protocol/Base64Util.h"
 #include "velox/common/base/Exceptions.h"
+#include "velox/functions/FunctionRegistry.h"
 #include "velox/vector/ComplexVector.h"
 #include "velox/vector/ConstantVector.h"
 #include "velox/vector/FlatVector.h"
@@ -91,12 +92,46 @@ std::string getFunctionName(const protocol::SqlFunctionId& functionId) {
                                       : functionId;
 }
 
+// Returns true if the function 'name' may return a different result for the
+// same arguments, so that its calls must not be shared. Uses the metadata of
+// the function registry. The names which are not registered functions, e.g.
+// the special forms, are deterministic.
+bool isNonDeterministicFunction(const std::string& name) {
+  return !velox::isDeterministic(name).value_or(true);
+}
+
 } // namespace
 
+bool isNonDeterministic(const TypedExprPtr& expr) {
+  if (auto call = std::dynamic_pointer_cast<const CallTypedExpr>(expr)) {
+    if (isNonDeterministicFunction(call->name())) {
+      return true;
+    }
+  } else if (
+      auto lambda = std::dynamic_pointer_cast<const LambdaTypedExpr>(expr)) {
+    return isNonDeterministic(lambda->body());
+  }
+  return std::any_of(
+      expr->inputs().begin(), expr->inputs().end(), [](const auto& input) {
+        return isNonDeterministic(input);
+      });
+}
+
+velox::VectorPtr VeloxExprConverter::readBlock(
+    const velox::TypePtr& type,
+    const std::string& encoded) const {
+  if (constantBlockCache_ == nullptr) {
+    return protocol::readBlock(type, encoded, pool_);
+  }
+  return constantBlockCache_->getOrDecode(type, encoded, [&]() {
+    return protocol::readBlock(type, encoded, pool_);
+  });
+}
+
 velox::variant VeloxExprConverter::getConstantValue(
     const velox::TypePtr& type,
     const protocol::Block& block) const {
-  auto valueVector = protocol::readBlock(type, block.data, pool_);
+  auto valueVector = readBlock(type, block.data);
 
   auto typeKind = type->kind();
   if (valueVector->isNullAt(0)) {
@@ -209,11 +244,12 @@ std::optional<TypedExprPtr> tryConvertTry(
   return std::make_shared<CallTypedExpr>(type, newArgs, "try");
 }
 
-std::optional<TypedExprPtr> tryConvertLiteralArray(
+} // namespace
+
+std::optional<TypedExprPtr> VeloxExprConverter::tryConvertLiteralArray(
     const protocol::Signature& signature,
     const std::string& returnType,
-    const std::vector<TypedExprPtr>& args,
-    velox::memory::MemoryPool* pool) {
+    const std::vector<TypedExprPtr>& args) const {
   static const char* kLiteralArray = "presto.default.$literal$array";
   static const char* kFromBase64 = "presto.default.from_base64";
 
@@ -240,19 +276,18 @@ std::optional<TypedExprPtr> tryConvertLiteralArray(
   VELOX_CHECK_NOT_NULL(encoded);
   auto encodedString = encoded->value().value<velox::StringView>();
   auto elementsVector =
-      protocol::readBlock(type->asArray().elementType(), encodedString, pool);
+      readBlock(type->asArray().elementType(), std::string(encodedString));
 
   velox::BufferPtr offsets =
-      velox::AlignedBuffer::allocate<velox::vector_size_t>(1, pool, 0);
+      velox::AlignedBuffer::allocate<velox::vector_size_t>(1, pool_, 0);
   velox::BufferPtr sizes = velox::AlignedBuffer::allocate<velox::vector_size_t>(
-      1, pool, elementsVector->size());
+      1, pool_, elementsVector->size());
   auto arrayVector = std::make_shared<velox::ArrayVector>(
-      pool, type, nullptr, 1, offsets, sizes, elementsVector);
+      pool_, type, nullptr, 1, offsets, sizes, elementsVector);
 
   return std::make_shared<ConstantTypedExpr>(
       velox::BaseVector::wrapInConstant(1, 0, arrayVector));
 }
-} // namespace
 
 std::optional<TypedExprPtr> VeloxExprConverter::tryConvertDate(
     const protocol::CallExpression& pexpr) const {
@@ -271,7 +306,7 @@ std::optional<TypedExprPtr> VeloxExprConverter::tryConvertDate(
   // a VARCHAR or TIMESTAMP (with an optional timezone) type.
   args.emplace_back(toVeloxExpr(pexpr.arguments[0]));
 
-  auto returnType = parseTypeSignature(pexpr.returnType);
+  auto returnType = parseType(pexpr.returnType);
   return std::make_shared<CastTypedExpr>(returnType, args, false);
 }
 
@@ -321,7 +356,7 @@ std::optional<TypedExprPtr> VeloxExprConverter::tryConvertLike(
   }
 
   // Construct the returnType and CallTypedExpr for 'like'
-  auto returnType = parseTypeSignature(pexpr.returnType);
+  auto returnType = parseType(pexpr.returnType);
   return std::make_shared<CallTypedExpr>(
       returnType, args, getFunctionName(signature));
 }
@@ -356,12 +391,12 @@ TypedExprPtr VeloxExprConverter::toVeloxExpr(
     }
 
     auto literal =
-        tryConvertLiteralArray(signature, pexpr.returnType, args, pool_);
+        tryConvertLiteralArray(signature, pexpr.returnType, args);
     if (literal.has_value()) {
       return literal.value();
     }
 
-    auto returnType = parseTypeSignature(pexpr.returnType);
+    auto returnType = parseType(pexpr.returnType);
     return std::make_shared<CallTypedExpr>(
         returnType, args, getFunctionName(signature));
 
@@ -370,7 +405,7 @@ TypedExprPtr VeloxExprConverter::toVeloxExpr(
           std::dynamic_pointer_cast<protocol::SqlFunctionHandle>(
               pexpr.functionHandle)) {
     auto args = toVeloxExpr(pexpr.arguments);
-    auto returnType = parseTypeSignature(pexpr.returnType);
+    auto returnType = parseType(pexpr.returnType);
     return std::make_shared<CallTypedExpr>(
         returnType, args, getFunctionName(sqlFunctionHandle->functionId));
   }
@@ -380,23 +415,21 @@ TypedExprPtr VeloxExprConverter::toVeloxExpr(
 
 std::shared_ptr<const ConstantTypedExpr> VeloxExprConverter::toVeloxExpr(
     std::shared_ptr<protocol::ConstantExpression> pexpr) const {
-  const auto type = parseTypeSignature(pexpr->type);
+  const auto type = parseType(pexpr->type);
   switch (type->kind()) {
     case TypeKind::ROW:
       FOLLY_FALLTHROUGH;
     case TypeKind::ARRAY:
       FOLLY_FALLTHROUGH;
     case TypeKind::MAP: {
-      auto valueVector =
-          protocol::readBlock(type, pexpr->valueBlock.data, pool_);
+      auto valueVector = readBlock(type, pexpr->valueBlock.data);
       return std::make_shared<ConstantTypedExpr>(
           std::make_shared<velox::ConstantVector<velox::ComplexType>>(
               pool_, 1, 0, valueVector));
     }
     case TypeKind::SHORT_DECIMAL:
     case TypeKind::LONG_DECIMAL: {
-      auto valueVector =
-          protocol::readBlock(type, pexpr->valueBlock.data, pool_);
+      auto valueVector = readBlock(type, pexpr->valueBlock.data);
       return std::make_shared<ConstantTypedExpr>(
           velox::BaseVector::wrapInConstant(
               1 /*length*/, 0 /*index*/, valueVector));
@@ -628,7 +661,7 @@ TypedExprPtr VeloxExprConverter::toVeloxExpr(
     return convertInExpr(args, pool_);
   }
 
-  auto returnType = parseTypeSignature(pexpr->returnType);
+  auto returnType = parseType(pexpr->returnType);
 
   if (pexpr->form == protocol::Form::SWITCH) {
     return convertSwitchExpr(returnType, std::move(args));
@@ -655,7 +688,7 @@ TypedExprPtr VeloxExprConverter::toVeloxExpr(
 std::shared_ptr<const FieldAccessTypedExpr> VeloxExprConverter::toVeloxExpr(
     std::shared_ptr<protocol::VariableReferenceExpression> pexpr) const {
   return std::make_shared<FieldAccessTypedExpr>(
-      parseTypeSignature(pexpr->type), pexpr->name);
+      parseType(pexpr->type), pexpr->name);
 }
 
 std::shared_ptr<const LambdaTypedExpr> VeloxExprConverter::toVeloxExpr(
@@ -663,7 +696,7 @@ std::shared_ptr<const LambdaTypedExpr> VeloxExprConverter::toVeloxExpr(
   std::vector<velox::TypePtr> argumentTypes;
   argumentTypes.reserve(lambda->argumentTypes.size());
   for (auto& typeName : lambda->argumentTypes) {
-    argumentTypes.emplace_back(parseTypeSignature(typeName));
+    argumentTypes.emplace_back(parseType(typeName));
   }
 
   auto signature = ROW(std::move(lambda->arguments), std::move(argumentTypes));
@@ -674,31 +707,64 @@ std::shared_ptr<const LambdaTypedExpr> VeloxExprConverter::toVeloxExpr(
 std::shared_ptr<const FieldAccessTypedExpr> VeloxExprConverter::toVeloxExpr(
     const protocol::VariableReferenceExpression& pexpr) const {
   return std::make_shared<FieldAccessTypedExpr>(
-      parseTypeSignature(pexpr.type), pexpr.name);
+      parseType(pexpr.type), pexpr.name);
+}
+
+TypedExprPtr VeloxExprConverter::intern(TypedExprPtr expr) const {
+  // The equal subexpressions of the projections and filters of a plan become
+  // one object, which Velox evaluates once per batch. The non-deterministic
+  // calls and their parents stay distinct so that each is evaluated.
+  bool nonDeterministic = false;
+  if (auto call = std::dynamic_pointer_cast<const CallTypedExpr>(expr)) {
+    nonDeterministic = isNonDeterministicFunction(call->name());
+  } else if (
+      auto lambda = std::dynamic_pointer_cast<const LambdaTypedExpr>(expr)) {
+    nonDeterministic = nonDeterministicExprs_.count(lambda->body());
+  }
+  for (const auto& input : expr->inputs()) {
+    if (nonDeterministic) {
+      break;
+    }
+    nonDeterministic = nonDeterministicExprs_.count(input);
+  }
+  if (nonDeterministic) {
+    nonDeterministicExprs_.insert(expr);
+    return expr;
+  }
+  return *exprs_.insert(std::move(expr)).first;
+}
+
+velox::TypePtr VeloxExprConverter::parseType(
+    const std::string& signature) const {
+  auto it = types_.find(signature);
+  if (it == types_.end()) {
+    it = types_.emplace(signature, parseTypeSignature(signature)).first;
+  }
+  return it->second;
 }
 
 TypedExprPtr VeloxExprConverter::toVeloxExpr(
     std::shared_ptr<protocol::RowExpression> pexpr) const {
   if (auto call = std::dynamic_pointer_cast<protocol::CallExpression>(pexpr)) {
-    return toVeloxExpr(*call);
+    return intern(toVeloxExpr(*call));
   }
   if (auto constant =
           std::dynamic_pointer_cast<protocol::ConstantExpression>(pexpr)) {
-    return toVeloxExpr(constant);
+    return intern(toVeloxExpr(constant));
   }
   if (auto special =
           std::dynamic_pointer_cast<protocol::SpecialFormExpression>(pexpr)) {
-    return toVeloxExpr(special);
+    return intern(toVeloxExpr(special));
   }
   if (auto variable =
           std::dynamic_pointer_cast<protocol::VariableReferenceExpression>(
               pexpr)) {
-    return toVeloxExpr(variable);
+    return intern(toVeloxExpr(variable));
   }
   if (auto lambda =
           std::dynamic_pointer_cast<protocol::LambdaDefinitionExpression>(
               pexpr)) {
-    return toVeloxExpr(lambda);
+    return intern(toVeloxExpr(lambda));
   }
 
   throw std::invalid_argument(
@@ -14,14 +14,30 @@
 #pragma once
 
 #include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+#include "presto_cpp/main/types/ConstantBlockCache.h"
 #include "presto_cpp/presto_protocol/presto_protocol.h"
 #include "velox/core/Expressions.h"
 
 namespace facebook::presto {
 
+/// Returns true if 'expr' calls a function that may return a different result
+/// for the same arguments, e.g. rand(), according to the function registry.
+bool isNonDeterministic(const velox::core::TypedExprPtr& expr);
+
+/// Converts Presto row expressions to Velox typed expressions. The equal
+/// expressions and the types converted by the same converter are interned, so
+/// all the expressions of a plan fragment share their common subexpressions
+/// and types. The constant blocks are decoded through 'constantBlockCache' if
+/// not null, so that the plans share the vectors of the equal literals. Not
+/// thread-safe.
 class VeloxExprConverter {
  public:
-  explicit VeloxExprConverter(velox::memory::MemoryPool* pool) : pool_(pool) {}
+  explicit VeloxExprConverter(
+      velox::memory::MemoryPool* pool,
+      ConstantBlockCache* constantBlockCache = nullptr)
+      : pool_(pool), constantBlockCache_(constantBlockCache) {}
 
   std::shared_ptr<const velox::core::ConstantTypedExpr> toVeloxExpr(
       std::shared_ptr<protocol::ConstantExpression> pexpr) const;
@@ -60,7 +76,52 @@ class VeloxExprConverter {
   std::optional<velox::core::TypedExprPtr> tryConvertDate(
       const protocol::CallExpression& pexpr) const;
 
+  std::optional<velox::core::TypedExprPtr> tryConvertLiteralArray(
+      const protocol::Signature& signature,
+      const std::string& returnType,
+      const std::vector<velox::core::TypedExprPtr>& args) const;
+
+  // Returns the vector of 'type' decoded from the base64 encoded block
+  // 'encoded'. The vector may be shared with the other plans and must not be
+  // modified.
+  velox::VectorPtr readBlock(
+      const velox::TypePtr& type,
+      const std::string& encoded) const;
+
+  // Returns the expression equal to 'expr' converted before if any. Otherwise
+  // remembers and returns 'expr'. Returns 'expr' as is if it has a
+  // non-deterministic call.
+  velox::core::TypedExprPtr intern(velox::core::TypedExprPtr expr) const;
+
+  // Returns the type of the type signature 'signature'. Parses each distinct
+  // signature once.
+  velox::TypePtr parseType(const std::string& signature) const;
+
+  struct TypedExprHasher {
+    size_t operator()(const velox::core::TypedExprPtr& expr) const {
+      return expr->hash();
+    }
+  };
+
+  struct TypedExprComparer {
+    bool operator()(
+        const velox::core::TypedExprPtr& lhs,
+        const velox::core::TypedExprPtr& rhs) const {
+      return *lhs == *rhs;
+    }
+  };
+
   velox::memory::MemoryPool* pool_;
+  ConstantBlockCache* const constantBlockCache_;
+  mutable std::unordered_set<
+      velox::core::TypedExprPtr,
+      TypedExprHasher,
+      TypedExprComparer>
+      exprs_;
+  // The converted expressions with a non-deterministic call, which are not
+  // interned.
+  mutable std::unordered_set<velox::core::TypedExprPtr> nonDeterministicExprs_;
+  mutable std::unordered_map<std::string, velox::TypePtr> types_;
 };
 
 } // namespace facebook::presto
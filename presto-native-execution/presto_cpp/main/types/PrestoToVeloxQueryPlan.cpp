@@ -22,10 +22,14 @@
 #include "velox/exec/RoundRobinPartitionFunction.h"
 #include "velox/vector/ComplexVector.h"
 #include "velox/vector/FlatVector.h"
+#include "presto_cpp/main/types/ParseTypeSignature.h"
 #include "presto_cpp/main/types/TypeSignatureTypeConverter.h"
 #include "presto_cpp/main/operators/PartitionAndSerialize.h"
 #include "presto_cpp/main/operators/ShuffleWrite.h"
+#include "presto_cpp/main/operators/RangePartitionFunction.h"
 #include "presto_cpp/main/operators/ShuffleRead.h"
+#include "presto_cpp/main/operators/Xxh3PartitionFunction.h"
+#include "presto_cpp/presto_protocol/Base64Util.h"
 #include "presto_cpp/presto_protocol/presto_protocol.h"
 #include <velox/core/Expressions.h>
 // clang-format on
@@ -40,7 +44,7 @@ namespace facebook::presto {
 namespace {
 
 TypePtr stringToType(const std::string& typeString) {
-  return TypeSignatureTypeConverter::parse(typeString);
+  return parseTypeSignature(typeString);
 }
 
 std::vector<std::string> getNames(const protocol::Assignments& assignments) {
@@ -93,25 +97,203 @@ connector::hive::HiveColumnHandle::ColumnType toHiveColumnType(
   }
 }
 
+/// The paths of the subfields read of each column, keyed by column name. A
+/// path is the part of a subfield after the column name, e.g. '["key"].a',
+/// and an empty path stands for the whole column.
+using ColumnPaths = std::unordered_map<std::string, std::vector<std::string>>;
+
+/// Returns true if 'name' can be written unquoted in a subfield path.
+bool isPlainPathName(const std::string& name) {
+  return !name.empty() && std::all_of(name.begin(), name.end(), [](char c) {
+           return std::isalnum(static_cast<unsigned char>(c)) || c == '_' ||
+               c == '$';
+         });
+}
+
+/// Returns the subscript of a subfield path for the constant key or index
+/// 'constant', e.g. '["key"]' or '[3]', or std::nullopt if there is none.
+std::optional<std::string> toSubscript(
+    const core::ConstantTypedExpr& constant,
+    bool arrayIndex) {
+  if (constant.hasValueVector() || constant.value().isNull()) {
+    return std::nullopt;
+  }
+  switch (constant.type()->kind()) {
+    case TypeKind::TINYINT:
+    case TypeKind::SMALLINT:
+    case TypeKind::INTEGER:
+    case TypeKind::BIGINT: {
+      const auto index =
+          VariantConverter::convert<TypeKind::BIGINT>(constant.value())
+              .value<int64_t>();
+      // element_at() counts negative array indices from the end.
+      if (arrayIndex && index <= 0) {
+        return std::nullopt;
+      }
+      return fmt::format("[{}]", index);
+    }
+    case TypeKind::VARCHAR: {
+      if (arrayIndex) {
+        return std::nullopt;
+      }
+      std::string key;
+      for (auto c : constant.value().value<std::string>()) {
+        if (c == '"' || c == '\\') {
+          key.push_back('\\');
+        }
+        key.push_back(c);
+      }
+      return fmt::format("[\"{}\"]", key);
+    }
+    default:
+      return std::nullopt;
+  }
+}
+
+/// Returns the column and the path 'expr' reads of it, e.g. 'm' and
+/// '["key"].a' for m['key'].a, or std::nullopt if 'expr' is not a column or
+/// a chain of struct field accesses and constant subscripts over one.
+std::optional<std::pair<std::string, std::string>> toColumnPath(
+    const core::TypedExprPtr& expr) {
+  if (auto field =
+          std::dynamic_pointer_cast<const core::FieldAccessTypedExpr>(expr)) {
+    if (field->inputs().empty() ||
+        std::dynamic_pointer_cast<const core::InputTypedExpr>(
+            field->inputs()[0])) {
+      return std::make_pair(field->name(), std::string());
+    }
+    if (!isPlainPathName(field->name())) {
+      return std::nullopt;
+    }
+    auto path = toColumnPath(field->inputs()[0]);
+    if (path.has_value()) {
+      path->second += "." + field->name();
+    }
+    return path;
+  }
+
+  auto call = std::dynamic_pointer_cast<const core::CallTypedExpr>(expr);
+  if (!call || call->inputs().size() != 2 ||
+      (call->name() != "presto.default.subscript" &&
+       call->name() != "presto.default.element_at")) {
+    return std::nullopt;
+  }
+  const auto& base = call->inputs()[0];
+  auto key =
+      dynamic_cast<const core::ConstantTypedExpr*>(call->inputs()[1].get());
+  if (!key ||
+      (base->type()->kind() != TypeKind::MAP &&
+       base->type()->kind() != TypeKind::ARRAY)) {
+    return std::nullopt;
+  }
+  auto subscript =
+      toSubscript(*key, base->type()->kind() == TypeKind::ARRAY);
+  if (!subscript.has_value()) {
+    return std::nullopt;
+  }
+  auto path = toColumnPath(base);
+  if (path.has_value()) {
+    path->second += subscript.value();
+  }
+  return path;
+}
+
+/// Adds to 'paths' the paths 'expr' reads of the columns it references.
+void collectColumnPaths(const core::TypedExprPtr& expr, ColumnPaths& paths) {
+  if (auto path = toColumnPath(expr)) {
+    paths[path->first].emplace_back(std::move(path->second));
+    return;
+  }
+  if (auto lambda =
+          std::dynamic_pointer_cast<const core::LambdaTypedExpr>(expr)) {
+    // The arguments of the lambda shadow the columns of the same name.
+    ColumnPaths bodyPaths;
+    collectColumnPaths(lambda->body(), bodyPaths);
+    for (const auto& name : lambda->signature()->names()) {
+      bodyPaths.erase(name);
+    }
+    for (auto& [column, columnPaths] : bodyPaths) {
+      auto& allPaths = paths[column];
+      allPaths.insert(allPaths.end(), columnPaths.begin(), columnPaths.end());
+    }
+    return;
+  }
+  for (const auto& input : expr->inputs()) {
+    collectColumnPaths(input, paths);
+  }
+}
+
+/// Returns true if 'path' is 'prefix' or a subfield under it.
+bool isCoveredBy(const std::string& path, const std::string& prefix) {
+  return path.compare(0, prefix.size(), prefix) == 0 &&
+      (path.size() == prefix.size() || path[prefix.size()] == '.' ||
+       path[prefix.size()] == '[');
+}
+
+/// Returns 'paths' without the duplicates and the paths under another path
+/// of the list, e.g. 'a' and 'a.b' become 'a'.
+std::vector<std::string> removeCoveredPaths(std::vector<std::string> paths) {
+  std::sort(paths.begin(), paths.end());
+  std::vector<std::string> result;
+  for (auto& path : paths) {
+    const bool covered =
+        std::any_of(result.begin(), result.end(), [&](const auto& prefix) {
+          return isCoveredBy(path, prefix);
+        });
+    if (!covered) {
+      result.emplace_back(std::move(path));
+    }
+  }
+  return result;
+}
+
 std::vector<common::Subfield> toRequiredSubfields(
     const protocol::List<protocol::Subfield>& subfields) {
   std::vector<common::Subfield> result;
   result.reserve(subfields.size());
-  for (auto& subfield : subfields) {
+  for (auto& subfield : removeCoveredPaths(subfields)) {
     result.emplace_back(subfield);
   }
   return result;
 }
 
+/// Returns the required subfields of the column 'name' that reads 'paths', or
+/// an empty list if it reads the whole column.
+protocol::List<protocol::Subfield> toRequiredSubfields(
+    const std::string& name,
+    const std::vector<std::string>& paths) {
+  if (!isPlainPathName(name)) {
+    return {};
+  }
+  protocol::List<protocol::Subfield> subfields;
+  for (const auto& path : removeCoveredPaths(paths)) {
+    if (path.empty()) {
+      return {};
+    }
+    subfields.emplace_back(name + path);
+  }
+  return subfields;
+}
+
+/// Converts 'column'. If 'paths' is not null and the coordinator has not
+/// pruned the subfields of a Hive column, then the column reads only the
+/// subfields on its 'paths'.
 std::shared_ptr<connector::ColumnHandle> toColumnHandle(
-    const protocol::ColumnHandle* column) {
+    const protocol::ColumnHandle* column,
+    const ColumnPaths* paths = nullptr) {
   if (auto hiveColumn =
           dynamic_cast<const protocol::HiveColumnHandle*>(column)) {
+    auto columnPaths =
+        paths ? paths->find(hiveColumn->name) : ColumnPaths::const_iterator();
     return std::make_shared<connector::hive::HiveColumnHandle>(
         hiveColumn->name,
         toHiveColumnType(hiveColumn->columnType),
         stringToType(hiveColumn->typeSignature),
-        toRequiredSubfields(hiveColumn->requiredSubfields));
+        toRequiredSubfields(
+            paths && columnPaths != paths->end() &&
+                    hiveColumn->requiredSubfields.empty()
+                ? toRequiredSubfields(hiveColumn->name, columnPaths->second)
+                : hiveColumn->requiredSubfields));
   }
 
   if (auto tpchColumn =
@@ -535,6 +717,64 @@ std::unique_ptr<common::Filter> combineBytesRanges(
       std::move(bytesGeneric), nullAllowed, false);
 }
 
+// Returns true if all the 'ranges' are single values, i.e. they come from an
+// IN list.
+bool allSingleValues(const std::vector<protocol::Range>& ranges) {
+  return std::all_of(ranges.begin(), ranges.end(), [](const auto& range) {
+    return range.low.bound == protocol::Bound::EXACTLY &&
+        range.high.bound == protocol::Bound::EXACTLY &&
+        range.low.valueBlock != nullptr && range.high.valueBlock != nullptr &&
+        range.low.valueBlock->data == range.high.valueBlock->data;
+  });
+}
+
+// Converts the single value integer 'ranges' of an IN list without creating a
+// filter per value. The values are sorted and deduplicated once, then turned
+// into a single range if they are contiguous, or otherwise into a bitmask or
+// a hash table filter depending on their density.
+std::unique_ptr<common::Filter> integerValuesToFilter(
+    const std::vector<protocol::Range>& ranges,
+    bool nullAllowed,
+    const VeloxExprConverter& exprConverter,
+    const TypePtr& type) {
+  std::vector<int64_t> values;
+  values.reserve(ranges.size());
+  for (const auto& range : ranges) {
+    values.push_back(toInt64(range.low.valueBlock, exprConverter, type));
+  }
+  // The ranges of a SortedRangeSet are already sorted.
+  if (!std::is_sorted(values.begin(), values.end())) {
+    std::sort(values.begin(), values.end());
+  }
+  values.erase(std::unique(values.begin(), values.end()), values.end());
+
+  if (static_cast<uint64_t>(values.back()) -
+          static_cast<uint64_t>(values.front()) ==
+      values.size() - 1) {
+    return std::make_unique<common::BigintRange>(
+        values.front(), values.back(), nullAllowed);
+  }
+  return common::createBigintValues(values, nullAllowed);
+}
+
+// Same as above for the varchar values.
+std::unique_ptr<common::Filter> bytesValuesToFilter(
+    const std::vector<protocol::Range>& ranges,
+    bool nullAllowed,
+    const VeloxExprConverter& exprConverter,
+    const TypePtr& type) {
+  std::vector<std::string> values;
+  values.reserve(ranges.size());
+  for (const auto& range : ranges) {
+    values.push_back(toString(range.low.valueBlock, exprConverter, type));
+  }
+  if (!std::is_sorted(values.begin(), values.end())) {
+    std::sort(values.begin(), values.end());
+  }
+  values.erase(std::unique(values.begin(), values.end()), values.end());
+  return std::make_unique<common::BytesValues>(values, nullAllowed);
+}
+
 std::unique_ptr<common::Filter> toFilter(
     const TypePtr& type,
     const protocol::Range& range,
@@ -568,7 +808,7 @@ std::unique_ptr<common::Filter> toFilter(
   if (auto sortedRangeSet =
           std::dynamic_pointer_cast<protocol::SortedRangeSet>(domain.values)) {
     auto type = stringToType(sortedRangeSet->type);
-    auto ranges = sortedRangeSet->ranges;
+    const auto& ranges = sortedRangeSet->ranges;
 
     if (ranges.empty()) {
       VELOX_CHECK(nullAllowed, "Unexpected always-false filter");
@@ -594,6 +834,9 @@ std::unique_ptr<common::Filter> toFilter(
     if (type->kind() == TypeKind::BIGINT || type->kind() == TypeKind::INTEGER ||
         type->kind() == TypeKind::SMALLINT ||
         type->kind() == TypeKind::TINYINT) {
+      if (allSingleValues(ranges)) {
+        return integerValuesToFilter(ranges, nullAllowed, exprConverter, type);
+      }
       std::vector<std::unique_ptr<common::BigintRange>> bigintFilters;
       bigintFilters.reserve(ranges.size());
       for (const auto& range : ranges) {
@@ -604,6 +847,9 @@ std::unique_ptr<common::Filter> toFilter(
     }
 
     if (type->kind() == TypeKind::VARCHAR) {
+      if (allSingleValues(ranges)) {
+        return bytesValuesToFilter(ranges, nullAllowed, exprConverter, type);
+      }
       std::vector<std::unique_ptr<common::BytesRange>> bytesFilters;
       bytesFilters.reserve(ranges.size());
       for (const auto& range : ranges) {
@@ -662,11 +908,59 @@ std::unique_ptr<common::Filter> toFilter(
   VELOX_UNSUPPORTED("Unsupported filter found.");
 }
 
+/// Checks if input RowExpression is the placeholder the coordinator puts on
+/// the probe side of a join for one of the JoinNode::dynamicFilters.
+bool isDynamicFilter(
+    const std::shared_ptr<protocol::RowExpression>& expression) {
+  static const std::string_view kDynamicFilter =
+      "$internal$dynamic_filter_function";
+  auto call = std::dynamic_pointer_cast<protocol::CallExpression>(expression);
+  return call && call->displayName == kDynamicFilter;
+}
+
+/// Returns input RowExpression without its dynamic filter conjuncts, or nullptr
+/// if nothing else is left. Velox has no function for the placeholders. The
+/// HashProbe pushes the filters on the build side keys into the probe-side
+/// scan by itself instead.
+std::shared_ptr<protocol::RowExpression> removeDynamicFilters(
+    const std::shared_ptr<protocol::RowExpression>& expression) {
+  if (isDynamicFilter(expression)) {
+    return nullptr;
+  }
+  auto special =
+      std::dynamic_pointer_cast<protocol::SpecialFormExpression>(expression);
+  if (!special || special->form != protocol::Form::AND) {
+    return expression;
+  }
+  std::vector<std::shared_ptr<protocol::RowExpression>> arguments;
+  for (const auto& argument : special->arguments) {
+    if (auto remaining = removeDynamicFilters(argument)) {
+      arguments.push_back(std::move(remaining));
+    }
+  }
+  if (arguments.size() == special->arguments.size() &&
+      std::equal(
+          arguments.begin(), arguments.end(), special->arguments.begin())) {
+    return expression;
+  }
+  if (arguments.empty()) {
+    return nullptr;
+  }
+  if (arguments.size() == 1) {
+    return arguments[0];
+  }
+  auto conjunction =
+      std::make_shared<protocol::SpecialFormExpression>(*special);
+  conjunction->arguments = std::move(arguments);
+  return conjunction;
+}
+
 std::shared_ptr<connector::ConnectorTableHandle> toConnectorTableHandle(
     const protocol::TableHandle& tableHandle,
     const VeloxExprConverter& exprConverter,
     std::unordered_map<std::string, std::shared_ptr<connector::ColumnHandle>>&
-        partitionColumns) {
+        partitionColumns,
+    uint64_t& filterConversionNanos) {
   if (auto hiveLayout =
           std::dynamic_pointer_cast<const protocol::HiveTableLayoutHandle>(
               tableHandle.connectorTableLayout)) {
@@ -680,14 +974,22 @@ std::shared_ptr<connector::ConnectorTableHandle> toConnectorTableHandle(
 
     connector::hive::SubfieldFilters subfieldFilters;
     auto domains = hiveLayout->domainPredicate.domains;
+    const auto start = std::chrono::steady_clock::now();
     for (const auto& domain : *domains) {
       auto filter = domain.second;
       subfieldFilters[common::Subfield(domain.first)] =
           toFilter(domain.second, exprConverter);
     }
-
-    auto remainingFilter =
-        exprConverter.toVeloxExpr(hiveLayout->remainingPredicate);
+    filterConversionNanos +=
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start)
+            .count();
+
+    auto remainingPredicate =
+        removeDynamicFilters(hiveLayout->remainingPredicate);
+    auto remainingFilter = remainingPredicate
+        ? exprConverter.toVeloxExpr(remainingPredicate)
+        : nullptr;
     if (auto constant =
             std::dynamic_pointer_cast<const core::ConstantTypedExpr>(
                 remainingFilter)) {
@@ -741,6 +1043,83 @@ std::vector<core::TypedExprPtr> getProjections(
   return expressions;
 }
 
+/// Records in 'scanPaths' the paths that the expressions of 'node' read of
+/// the output of the TableScanNode under it, if 'node' is a FilterNode or
+/// ProjectNode over the scan, possibly through more FilterNodes. Only a
+/// ProjectNode bounds what the nodes higher up read: the outputs of a
+/// FilterNode are the outputs of the scan, which are then read whole. Keeps
+/// the paths recorded by a node higher up.
+void collectScanPaths(
+    const protocol::PlanNode& node,
+    const VeloxExprConverter& exprConverter,
+    std::unordered_map<std::string, ColumnPaths>& scanPaths) {
+  ColumnPaths paths;
+  const protocol::PlanNode* current = &node;
+  const auto* project = dynamic_cast<const protocol::ProjectNode*>(current);
+  if (project) {
+    for (const auto& expr :
+         getProjections(exprConverter, project->assignments)) {
+      collectColumnPaths(expr, paths);
+    }
+    current = project->source.get();
+  }
+  while (auto filter = dynamic_cast<const protocol::FilterNode*>(current)) {
+    if (auto predicate = removeDynamicFilters(filter->predicate)) {
+      collectColumnPaths(exprConverter.toVeloxExpr(predicate), paths);
+    }
+    current = filter->source.get();
+  }
+  if (auto scan = dynamic_cast<const protocol::TableScanNode*>(current)) {
+    if (!project) {
+      for (const auto& variable : scan->outputVariables) {
+        paths[variable.name].emplace_back("");
+      }
+    }
+    scanPaths.emplace(scan->id, std::move(paths));
+  }
+}
+
+/// Returns the paths of the columns of the Hive table scan 'node' that the
+/// nodes above it and its filters read, given the paths 'outputPaths' read
+/// of its output variables.
+ColumnPaths toHiveColumnPaths(
+    const protocol::TableScanNode& node,
+    const ColumnPaths& outputPaths,
+    const VeloxExprConverter& exprConverter) {
+  ColumnPaths paths;
+  for (const auto& [variable, column] : node.assignments) {
+    auto hiveColumn =
+        dynamic_cast<const protocol::HiveColumnHandle*>(column.get());
+    auto variablePaths = outputPaths.find(variable.name);
+    if (hiveColumn && variablePaths != outputPaths.end()) {
+      auto& columnPaths = paths[hiveColumn->name];
+      columnPaths.insert(
+          columnPaths.end(),
+          variablePaths->second.begin(),
+          variablePaths->second.end());
+    }
+  }
+
+  auto hiveLayout =
+      std::dynamic_pointer_cast<const protocol::HiveTableLayoutHandle>(
+          node.table.connectorTableLayout);
+  if (!hiveLayout) {
+    return paths;
+  }
+  // The filters reference the columns by name.
+  if (hiveLayout->domainPredicate.domains) {
+    for (const auto& [subfield, _] : *hiveLayout->domainPredicate.domains) {
+      const auto end = subfield.find_first_of(".[");
+      paths[subfield.substr(0, end)].emplace_back(
+          end == std::string::npos ? "" : subfield.substr(end));
+    }
+  }
+  if (auto predicate = removeDynamicFilters(hiveLayout->remainingPredicate)) {
+    collectColumnPaths(exprConverter.toVeloxExpr(predicate), paths);
+  }
+  return paths;
+}
+
 template <TypeKind KIND>
 void setCellFromVariantByKind(
     const VectorPtr& column,
@@ -769,24 +1148,6 @@ void setCellFromVariantByKind<TypeKind::VARCHAR>(
   values->set(row, StringView(value.value<Varchar>()));
 }
 
-void setCellFromVariant(
-    const RowVectorPtr& data,
-    vector_size_t row,
-    vector_size_t column,
-    const velox::variant& value) {
-  auto columnVector = data->childAt(column);
-  if (value.isNull()) {
-    columnVector->setNull(row, true);
-    return;
-  }
-  VELOX_DYNAMIC_SCALAR_TYPE_DISPATCH(
-      setCellFromVariantByKind,
-      columnVector->typeKind(),
-      columnVector,
-      row,
-      value);
-}
-
 void setCellFromVariant(
     const VectorPtr& data,
     vector_size_t row,
@@ -799,6 +1160,44 @@ void setCellFromVariant(
       setCellFromVariantByKind, data->typeKind(), data, row, value);
 }
 
+// The max number of rows of each of the vectors a values node is converted
+// to.
+constexpr vector_size_t kMaxValuesBatchRows{10'000};
+
+// Sets the rows of the flat 'column' to the single row vectors returned by
+// 'readCell' for each row.
+template <TypeKind KIND>
+void readFlatValues(
+    const VectorPtr& column,
+    const std::function<VectorPtr(vector_size_t row)>& readCell) {
+  using T = typename TypeTraits<KIND>::NativeType;
+  auto* flatColumn = column->asFlatVector<T>();
+  for (vector_size_t row = 0; row < column->size(); ++row) {
+    const auto value = readCell(row);
+    if (value->isNullAt(0)) {
+      flatColumn->setNull(row, true);
+    } else {
+      flatColumn->set(row, value->as<SimpleVector<T>>()->valueAt(0));
+    }
+  }
+}
+
+// Returns true if the values of 'kind' are decoded into flat vectors by
+// readFlatValues(), false if copied as vectors.
+bool isFlatValuesKind(TypeKind kind) {
+  switch (kind) {
+    case TypeKind::ROW:
+    case TypeKind::ARRAY:
+    case TypeKind::MAP:
+    case TypeKind::SHORT_DECIMAL:
+    case TypeKind::LONG_DECIMAL:
+    case TypeKind::UNKNOWN:
+      return false;
+    default:
+      return true;
+  }
+}
+
 core::SortOrder toVeloxSortOrder(const protocol::SortOrder& sortOrder) {
   switch (sortOrder) {
     case protocol::SortOrder::ASC_NULLS_FIRST:
@@ -1263,6 +1662,35 @@ std::shared_ptr<protocol::CallExpression> isGreaterThan(
   return isFunctionCall(expression, kGreaterThan);
 }
 
+/// Check if input RowExpression is an 'a < b' expression and returns it as
+/// CallExpression. Returns nullptr if input expression is something else.
+std::shared_ptr<protocol::CallExpression> isLessThan(
+    const std::shared_ptr<protocol::RowExpression>& expression) {
+  static const std::string_view kLessThan =
+      "presto.default.$operator$less_than";
+  return isFunctionCall(expression, kLessThan);
+}
+
+/// Check if input RowExpression is an 'a <= b' expression and returns it as
+/// CallExpression. Returns nullptr if input expression is something else.
+std::shared_ptr<protocol::CallExpression> isLessThanOrEqual(
+    const std::shared_ptr<protocol::RowExpression>& expression) {
+  static const std::string_view kLessThanOrEqual =
+      "presto.default.$operator$less_than_or_equal";
+  return isFunctionCall(expression, kLessThanOrEqual);
+}
+
+/// Checks if input Function is a call to row_number().
+bool isRowNumber(const protocol::Function& function) {
+  static const std::string_view kRowNumber = "presto.default.row_number";
+  if (auto builtin = std::dynamic_pointer_cast<protocol::BuiltInFunctionHandle>(
+          function.functionCall.functionHandle)) {
+    return builtin->signature.kind == protocol::FunctionKind::WINDOW &&
+        builtin->signature.name == kRowNumber;
+  }
+  return false;
+}
+
 /// Checks if input PlanNode represents a local exchange with single source and
 /// returns it as ExchangeNode. Returns nullptr if input node is something else.
 std::shared_ptr<const protocol::ExchangeNode> isLocalSingleSourceExchange(
@@ -1300,6 +1728,19 @@ core::PlanNodePtr VeloxQueryPlanConverterBase::toVeloxQueryPlan(
     const std::shared_ptr<const protocol::FilterNode>& node,
     const std::shared_ptr<protocol::TableWriteInfo>& tableWriteInfo,
     const protocol::TaskId& taskId) {
+  auto predicate = removeDynamicFilters(node->predicate);
+  if (!predicate) {
+    return toVeloxQueryPlan(node->source, tableWriteInfo, taskId);
+  }
+  if (predicate != node->predicate) {
+    auto filter = std::make_shared<protocol::FilterNode>(*node);
+    filter->predicate = std::move(predicate);
+    return toVeloxQueryPlan(
+        std::shared_ptr<const protocol::FilterNode>(std::move(filter)),
+        tableWriteInfo,
+        taskId);
+  }
+
   // In Presto, semi and anti joins are implemented using two operators:
   // SemiJoin followed by Filter. SemiJoin operator returns all probe rows plus
   // an extra boolean column which indicates whether there is a match for a
@@ -1384,12 +1825,99 @@ core::PlanNodePtr VeloxQueryPlanConverterBase::toVeloxQueryPlan(
             left->outputType()));
   }
 
+  if (auto topNRowNumber =
+          tryConvertTopNRowNumber(node, tableWriteInfo, taskId)) {
+    return topNRowNumber;
+  }
+
+  collectScanPaths(*node, exprConverter_, scanPaths_);
   return std::make_shared<core::FilterNode>(
       node->id,
       exprConverter_.toVeloxExpr(node->predicate),
       toVeloxQueryPlan(node->source, tableWriteInfo, taskId));
 }
 
+std::shared_ptr<const core::FilterNode>
+VeloxQueryPlanConverterBase::tryConvertTopNRowNumber(
+    const std::shared_ptr<const protocol::FilterNode>& node,
+    const std::shared_ptr<protocol::TableWriteInfo>& tableWriteInfo,
+    const protocol::TaskId& taskId) {
+  // Presto plans the top N rows of a whole result by a window order, e.g. for
+  // leaderboards, as
+  // Filter(rowNumber <= n)
+  //  -> Window(row_number() OVER (ORDER BY ...))
+  // if it has not made it a TopNRowNumberNode. The Window sorts all its input
+  // to number the rows. Without partition keys, the rows passing the filter
+  // are the first n in the window order.
+  //
+  // Detect the pattern above and convert it to:
+  // Filter(as-is)
+  //  -> Window(as-is)
+  //    -> TopN(n)
+  // so that the Window numbers only n rows.
+  auto window =
+      std::dynamic_pointer_cast<const protocol::WindowNode>(node->source);
+  if (!window || !window->specification.partitionBy.empty() ||
+      !window->specification.orderingScheme ||
+      window->windowFunctions.size() != 1) {
+    return nullptr;
+  }
+  const auto& [rowNumberVariable, function] = *window->windowFunctions.begin();
+  if (!isRowNumber(function)) {
+    return nullptr;
+  }
+
+  // 'rowNumber < n' keeps n - 1 rows.
+  int64_t adjustment = 0;
+  auto comparison = isLessThanOrEqual(node->predicate);
+  if (!comparison) {
+    comparison = isLessThan(node->predicate);
+    adjustment = -1;
+  }
+  if (!comparison || !equal(comparison->arguments[0], rowNumberVariable)) {
+    return nullptr;
+  }
+  auto countExpr = std::dynamic_pointer_cast<const core::ConstantTypedExpr>(
+      exprConverter_.toVeloxExpr(comparison->arguments[1]));
+  if (!countExpr || !countExpr->type()->isBigint() ||
+      countExpr->value().isNull()) {
+    return nullptr;
+  }
+  const auto count = countExpr->value().value<int64_t>() + adjustment;
+  if (count <= 0 || count > std::numeric_limits<int32_t>::max()) {
+    return nullptr;
+  }
+
+  std::vector<core::FieldAccessTypedExprPtr> sortingKeys;
+  std::vector<core::SortOrder> sortingOrders;
+  for (const auto& orderBy : window->specification.orderingScheme->orderBy) {
+    sortingKeys.emplace_back(exprConverter_.toVeloxExpr(orderBy.variable));
+    sortingOrders.emplace_back(toVeloxSortOrder(orderBy.sortOrder));
+  }
+  auto topN = std::make_shared<core::TopNNode>(
+      fmt::format("{}.topN", window->id),
+      sortingKeys,
+      sortingOrders,
+      count,
+      false,
+      toVeloxQueryPlan(window->source, tableWriteInfo, taskId));
+
+  std::vector<std::string> windowNames = {rowNumberVariable.name};
+  std::vector<core::WindowNode::Function> windowFunctions = {
+      toVeloxWindowFunction(function)};
+  return std::make_shared<core::FilterNode>(
+      node->id,
+      exprConverter_.toVeloxExpr(node->predicate),
+      std::make_shared<core::WindowNode>(
+          window->id,
+          std::vector<core::FieldAccessTypedExprPtr>{},
+          sortingKeys,
+          sortingOrders,
+          windowNames,
+          windowFunctions,
+          topN));
+}
+
 std::shared_ptr<const core::ProjectNode>
 VeloxQueryPlanConverterBase::tryConvertOffsetLimit(
     const std::shared_ptr<const protocol::ProjectNode>& node,
@@ -1495,6 +2023,7 @@ VeloxQueryPlanConverterBase::toVeloxQueryPlan(
     return limit;
   }
 
+  collectScanPaths(*node, exprConverter_, scanPaths_);
   return std::make_shared<core::ProjectNode>(
       node->id,
       getNames(node->assignments),
@@ -1508,39 +2037,61 @@ VeloxQueryPlanConverterBase::toVeloxQueryPlan(
     const std::shared_ptr<protocol::TableWriteInfo>& /* tableWriteInfo */,
     const protocol::TaskId& taskId) {
   auto rowType = toRowType(node->outputVariables);
-  vector_size_t numRows = node->rows.size();
-  auto numColumns = rowType->size();
-  std::vector<velox::VectorPtr> vectors;
-  vectors.reserve(numColumns);
-
-  for (int i = 0; i < numColumns; ++i) {
-    auto base = velox::BaseVector::create(rowType->childAt(i), numRows, pool_);
-    vectors.emplace_back(base);
-  }
-
-  auto rowVector = std::make_shared<RowVector>(
-      pool_, rowType, BufferPtr(), numRows, std::move(vectors), 0);
+  const vector_size_t numRows = node->rows.size();
+  const auto numColumns = rowType->size();
+
+  // Returns the single row vector of the value of 'column' in 'row'. The
+  // constants are decoded straight from their blocks, bypassing the constant
+  // block cache as the values of a large list are rarely seen again.
+  auto readCell = [&](vector_size_t row, int column) -> VectorPtr {
+    const auto& cell = node->rows[row][column];
+    if (auto constant =
+            std::dynamic_pointer_cast<protocol::ConstantExpression>(cell)) {
+      return protocol::readBlock(
+          rowType->childAt(column), constant->valueBlock.data, pool_);
+    }
+    auto expr = exprConverter_.toVeloxExpr(cell);
+    auto constantExpr =
+        std::dynamic_pointer_cast<const core::ConstantTypedExpr>(expr);
+    VELOX_CHECK_NOT_NULL(constantExpr, "Expected constant expression");
+    if (constantExpr->hasValueVector()) {
+      return constantExpr->valueVector();
+    }
+    auto value = BaseVector::create(rowType->childAt(column), 1, pool_);
+    setCellFromVariant(value, 0, constantExpr->value());
+    return value;
+  };
 
-  for (int row = 0; row < numRows; ++row) {
+  // The rows are converted column by column in batches of at most
+  // kMaxValuesBatchRows, so that large lists produce several vectors.
+  std::vector<RowVectorPtr> batches;
+  vector_size_t start = 0;
+  do {
+    const auto batchRows = std::min(kMaxValuesBatchRows, numRows - start);
+    std::vector<VectorPtr> columns;
+    columns.reserve(numColumns);
     for (int column = 0; column < numColumns; ++column) {
-      auto expr = exprConverter_.toVeloxExpr(node->rows[row][column]);
-
-      if (auto constantExpr =
-              std::dynamic_pointer_cast<const core::ConstantTypedExpr>(expr)) {
-        if (!constantExpr->hasValueVector()) {
-          setCellFromVariant(rowVector, row, column, constantExpr->value());
-        } else {
-          auto columnVector = rowVector->childAt(column);
-          columnVector->copy(constantExpr->valueVector().get(), row, 0, 1);
-        }
+      const auto& type = rowType->childAt(column);
+      auto vector = BaseVector::create(type, batchRows, pool_);
+      auto readRow = [&](vector_size_t row) {
+        return readCell(start + row, column);
+      };
+      if (isFlatValuesKind(type->kind())) {
+        VELOX_DYNAMIC_SCALAR_TYPE_DISPATCH(
+            readFlatValues, type->kind(), vector, readRow);
       } else {
-        VELOX_FAIL("Expected constant expression");
+        for (vector_size_t row = 0; row < batchRows; ++row) {
+          vector->copy(readRow(row).get(), row, 0, 1);
+        }
       }
+      columns.emplace_back(std::move(vector));
     }
-  }
+    batches.emplace_back(std::make_shared<RowVector>(
+        pool_, rowType, BufferPtr(), batchRows, std::move(columns), 0));
+    start += batchRows;
+  } while (start < numRows);
 
-  return std::make_shared<core::ValuesNode>(
-      node->id, std::vector<RowVectorPtr>{rowVector});
+  return std::make_shared<core::ValuesNode>(node->id, std::move(batches));
 }
 
 std::shared_ptr<const core::TableScanNode>
@@ -1549,13 +2100,24 @@ VeloxQueryPlanConverterBase::toVeloxQueryPlan(
     const std::shared_ptr<protocol::TableWriteInfo>& /* tableWriteInfo */,
     const protocol::TaskId& taskId) {
   auto rowType = toRowType(node->outputVariables);
+  // The columns the coordinator has not pruned read only the subfields that
+  // the filters and projections over the scan and the filters of the scan
+  // read, e.g. only the used keys of a map.
+  std::optional<ColumnPaths> paths;
+  auto outputPaths = scanPaths_.find(node->id);
+  if (outputPaths != scanPaths_.end()) {
+    paths = toHiveColumnPaths(*node, outputPaths->second, exprConverter_);
+  }
   std::unordered_map<std::string, std::shared_ptr<connector::ColumnHandle>>
       assignments;
   for (const auto& entry : node->assignments) {
-    assignments.emplace(entry.first.name, toColumnHandle(entry.second.get()));
+    assignments.emplace(
+        entry.first.name,
+        toColumnHandle(
+            entry.second.get(), paths.has_value() ? &paths.value() : nullptr));
   }
-  auto connectorTableHandle =
-      toConnectorTableHandle(node->table, exprConverter_, assignments);
+  auto connectorTableHandle = toConnectorTableHandle(
+      node->table, exprConverter_, assignments, filterConversionNanos_);
   return std::make_shared<core::TableScanNode>(
       node->id, rowType, connectorTableHandle, assignments);
 }
@@ -1787,8 +2349,102 @@ core::PlanNodePtr VeloxQueryPlanConverterBase::toVeloxQueryPlan(
       toRowType(node->outputVariables));
 }
 
-std::shared_ptr<const core::TopNNode>
-VeloxQueryPlanConverterBase::toVeloxQueryPlan(
+namespace {
+/// The order the rows of a converted plan node come out in.
+struct OutputOrder {
+  std::vector<core::FieldAccessTypedExprPtr> sortingKeys;
+  std::vector<core::SortOrder> sortingOrders;
+  // True if all the rows come out in that order, false if only the rows of
+  // each driver do.
+  bool singleStream;
+};
+
+/// Returns the order of the output of 'node', or std::nullopt if it is not
+/// known to be sorted. The sorts, merges and the nodes that keep the order of
+/// their input, e.g. Filter, Limit and the identity projections, are known.
+std::optional<OutputOrder> toOutputOrder(const core::PlanNodePtr& node) {
+  if (auto orderBy = std::dynamic_pointer_cast<const core::OrderByNode>(node)) {
+    return OutputOrder{
+        orderBy->sortingKeys(),
+        orderBy->sortingOrders(),
+        !orderBy->isPartial()};
+  }
+  if (auto topN = std::dynamic_pointer_cast<const core::TopNNode>(node)) {
+    return OutputOrder{
+        topN->sortingKeys(), topN->sortingOrders(), !topN->isPartial()};
+  }
+  if (auto merge =
+          std::dynamic_pointer_cast<const core::LocalMergeNode>(node)) {
+    return OutputOrder{merge->sortingKeys(), merge->sortingOrders(), true};
+  }
+  if (auto merge =
+          std::dynamic_pointer_cast<const core::MergeExchangeNode>(node)) {
+    return OutputOrder{merge->sortingKeys(), merge->sortingOrders(), true};
+  }
+  if (std::dynamic_pointer_cast<const core::FilterNode>(node) ||
+      std::dynamic_pointer_cast<const core::LimitNode>(node)) {
+    return toOutputOrder(node->sources()[0]);
+  }
+  auto project = std::dynamic_pointer_cast<const core::ProjectNode>(node);
+  if (!project) {
+    return std::nullopt;
+  }
+  auto order = toOutputOrder(project->sources()[0]);
+  if (!order.has_value()) {
+    return std::nullopt;
+  }
+  // The output is sorted by the longest prefix of the keys it projects as is.
+  OutputOrder projectedOrder{{}, {}, order->singleStream};
+  for (auto i = 0; i < order->sortingKeys.size(); ++i) {
+    const auto& key = order->sortingKeys[i];
+    core::FieldAccessTypedExprPtr projectedKey;
+    for (auto j = 0; j < project->projections().size(); ++j) {
+      auto field = std::dynamic_pointer_cast<const core::FieldAccessTypedExpr>(
+          project->projections()[j]);
+      if (field && field->inputs().empty() && field->name() == key->name()) {
+        projectedKey = std::make_shared<core::FieldAccessTypedExpr>(
+            key->type(), project->names()[j]);
+        break;
+      }
+    }
+    if (!projectedKey) {
+      break;
+    }
+    projectedOrder.sortingKeys.emplace_back(std::move(projectedKey));
+    projectedOrder.sortingOrders.emplace_back(order->sortingOrders[i]);
+  }
+  if (projectedOrder.sortingKeys.empty()) {
+    return std::nullopt;
+  }
+  return projectedOrder;
+}
+
+/// Returns true if the output of 'source' is sorted by 'sortingKeys' in
+/// 'sortingOrders', over all its rows if 'singleStream' or else within each
+/// driver.
+bool isSortedBy(
+    const core::PlanNodePtr& source,
+    const std::vector<core::FieldAccessTypedExprPtr>& sortingKeys,
+    const std::vector<core::SortOrder>& sortingOrders,
+    bool singleStream) {
+  auto order = toOutputOrder(source);
+  if (!order.has_value() || (singleStream && !order->singleStream) ||
+      order->sortingKeys.size() < sortingKeys.size()) {
+    return false;
+  }
+  for (auto i = 0; i < sortingKeys.size(); ++i) {
+    const auto& sortOrder = order->sortingOrders[i];
+    if (order->sortingKeys[i]->name() != sortingKeys[i]->name() ||
+        sortOrder.isAscending() != sortingOrders[i].isAscending() ||
+        sortOrder.isNullsFirst() != sortingOrders[i].isNullsFirst()) {
+      return false;
+    }
+  }
+  return true;
+}
+} // namespace
+
+core::PlanNodePtr VeloxQueryPlanConverterBase::toVeloxQueryPlan(
     const std::shared_ptr<const protocol::TopNNode>& node,
     const std::shared_ptr<protocol::TableWriteInfo>& tableWriteInfo,
     const protocol::TaskId& taskId) {
@@ -1800,13 +2456,21 @@ VeloxQueryPlanConverterBase::toVeloxQueryPlan(
     sortingKeys.emplace_back(exprConverter_.toVeloxExpr(orderBy.variable));
     sortingOrders.emplace_back(toVeloxSortOrder(orderBy.sortOrder));
   }
+  const bool partial = node->step == protocol::Step::PARTIAL;
+  auto source = toVeloxQueryPlan(node->source, tableWriteInfo, taskId);
+
+  // The first rows of a sorted input are its top N.
+  if (isSortedBy(source, sortingKeys, sortingOrders, !partial)) {
+    return std::make_shared<core::LimitNode>(
+        node->id, 0, node->count, partial, std::move(source));
+  }
   return std::make_shared<core::TopNNode>(
       node->id,
       sortingKeys,
       sortingOrders,
       node->count,
-      node->step == protocol::Step::PARTIAL,
-      toVeloxQueryPlan(node->source, tableWriteInfo, taskId));
+      partial,
+      std::move(source));
 }
 
 std::shared_ptr<const core::LimitNode>
@@ -1822,8 +2486,7 @@ VeloxQueryPlanConverterBase::toVeloxQueryPlan(
       toVeloxQueryPlan(node->source, tableWriteInfo, taskId));
 }
 
-std::shared_ptr<const core::OrderByNode>
-VeloxQueryPlanConverterBase::toVeloxQueryPlan(
+core::PlanNodePtr VeloxQueryPlanConverterBase::toVeloxQueryPlan(
     const std::shared_ptr<const protocol::SortNode>& node,
     const std::shared_ptr<protocol::TableWriteInfo>& tableWriteInfo,
     const protocol::TaskId& taskId) {
@@ -1833,13 +2496,18 @@ VeloxQueryPlanConverterBase::toVeloxQueryPlan(
     sortingKeys.emplace_back(exprConverter_.toVeloxExpr(orderBy.variable));
     sortingOrders.emplace_back(toVeloxSortOrder(orderBy.sortOrder));
   }
+  auto source = toVeloxQueryPlan(node->source, tableWriteInfo, taskId);
 
+  // Skip sorting an input that is already sorted, e.g. by a merge exchange.
+  if (isSortedBy(source, sortingKeys, sortingOrders, !node->isPartial)) {
+    return source;
+  }
   return std::make_shared<core::OrderByNode>(
       node->id,
       sortingKeys,
       sortingOrders,
       node->isPartial,
-      toVeloxQueryPlan(node->source, tableWriteInfo, taskId));
+      std::move(source));
 }
 
 std::shared_ptr<const core::TableWriteNode>
@@ -1947,6 +2615,7 @@ VeloxQueryPlanConverterBase::toVeloxQueryPlan(
     const std::shared_ptr<const protocol::AssignUniqueId>& node,
     const std::shared_ptr<protocol::TableWriteInfo>& tableWriteInfo,
     const protocol::TaskId& taskId) {
+  taskSpecific_ = true;
   auto prestoTaskId = PrestoTaskId(taskId);
   // `taskUniqueId` is an integer to uniquely identify the generated id
   // across all the nodes executing the same query stage in a distributed
@@ -2299,6 +2968,12 @@ velox::core::PlanNodePtr VeloxInteractiveQueryPlanConverter::toVeloxQueryPlan(
     const std::shared_ptr<const protocol::RemoteSourceNode>& node,
     const std::shared_ptr<protocol::TableWriteInfo>& /* tableWriteInfo */,
     const protocol::TaskId& taskId) {
+  if (node->exchangeType == protocol::ExchangeNodeType::REPLICATE) {
+    broadcastSourceFragmentIds_.insert(
+        broadcastSourceFragmentIds_.end(),
+        node->sourceFragmentIds.begin(),
+        node->sourceFragmentIds.end());
+  }
   auto rowType = toRowType(node->outputVariables);
   if (node->orderingScheme) {
     std::vector<core::FieldAccessTypedExprPtr> sortingKeys;
@@ -2330,6 +3005,14 @@ velox::core::PlanFragment VeloxBatchQueryPlanConverter::toVeloxQueryPlan(
   // (2) A "gather" LocalPartitionNode that gathers results from multiple
   //     threads to one thread.
   // (3) A ShuffleWriteNode.
+  // If the rows are sorted by the partition keys, each driver sorts its rows
+  // with a partial OrderByNode, which spills if configured to, and a
+  // LocalMergeNode merges the sorted rows of the drivers before they are
+  // partitioned. The partitioning keeps the order of the rows so the rows of
+  // each partition are written in key order, as one sorted run per task.
+  // If the PartitionAndSerializeNode is fused with the shuffle write, it writes
+  // the rows of each driver to its own shuffle writer and there are no
+  // LocalPartitionNode nor ShuffleWriteNode unless the rows are sorted.
   // To be noted, whether the last node of the plan is PartitionedOutputNode
   // can't guarantee the query has shuffle stage, for example a plan with
   // TableWriteNode can also have PartitionedOutputNode to distribute the
@@ -2349,26 +3032,95 @@ velox::core::PlanFragment VeloxBatchQueryPlanConverter::toVeloxQueryPlan(
         "supported.");
   }
 
-  auto partitionAndSerializeNode = std::make_shared<
-      operators::PartitionAndSerializeNode>(
-      "shuffle-partition-serialize",
-      partitionedOutputNode->keys(),
-      partitionedOutputNode->numPartitions(),
-      ROW({std::string(operators::PartitionAndSerializeNode::
-                           kPartitionColumnNameDefault),
-           std::string(
-               operators::PartitionAndSerializeNode::kDataColumnNameDefault)},
-          {INTEGER(), VARBINARY()}),
-      partitionedOutputNode->sources().back(),
-      partitionedOutputNode->partitionFunctionSpecPtr());
-
-  auto shuffleWriteNode = std::make_shared<operators::ShuffleWriteNode>(
-      "root",
-      shuffleName_,
-      std::move(*serializedShuffleWriteInfo_),
-      core::LocalPartitionNode::gather(
-          "shuffle-gather",
-          std::vector<core::PlanNodePtr>{partitionAndSerializeNode}));
+  std::vector<core::FieldAccessTypedExprPtr> sortingKeys;
+  if (sortByPartitionKeys_) {
+    for (const auto& key : partitionedOutputNode->keys()) {
+      // The constant keys don't affect the order.
+      if (auto field =
+              std::dynamic_pointer_cast<const core::FieldAccessTypedExpr>(
+                  key)) {
+        sortingKeys.push_back(field);
+      }
+    }
+  }
+
+  auto partitionFunctionSpec =
+      partitionedOutputNode->partitionFunctionSpecPtr();
+  if (xxh3HashPartitioning_ &&
+      std::dynamic_pointer_cast<const HashPartitionFunctionSpec>(
+          partitionFunctionSpec) != nullptr) {
+    // Only plain column keys of the supported types are hashed with XXH3.
+    const auto& inputType =
+        partitionedOutputNode->sources().back()->outputType();
+    std::vector<column_index_t> keyChannels;
+    for (const auto& key : partitionedOutputNode->keys()) {
+      auto field =
+          std::dynamic_pointer_cast<const core::FieldAccessTypedExpr>(key);
+      if (field == nullptr ||
+          !operators::Xxh3PartitionFunction::supportsType(*field->type())) {
+        keyChannels.clear();
+        break;
+      }
+      keyChannels.push_back(inputType->getChildIdx(field->name()));
+    }
+    if (!keyChannels.empty()) {
+      partitionFunctionSpec =
+          std::make_shared<operators::Xxh3PartitionFunctionSpec>(
+              std::move(keyChannels));
+    }
+  }
+
+  const auto makePartitionAndSerializeNode =
+      [&](const core::PlanNodePtr& source) {
+        return std::make_shared<operators::PartitionAndSerializeNode>(
+            "shuffle-partition-serialize",
+            partitionedOutputNode->keys(),
+            partitionedOutputNode->numPartitions(),
+            ROW({std::string(operators::PartitionAndSerializeNode::
+                                 kPartitionColumnNameDefault),
+                 std::string(operators::PartitionAndSerializeNode::
+                                 kDataColumnNameDefault)},
+                {INTEGER(), VARBINARY()}),
+            source,
+            partitionFunctionSpec,
+            serdeFormat_,
+            fusePartitionAndWrite_ ? shuffleName_ : "",
+            fusePartitionAndWrite_ ? *serializedShuffleWriteInfo_ : "");
+      };
+
+  core::PlanNodePtr shuffleWriteSource;
+  if (sortingKeys.empty()) {
+    shuffleWriteSource = makePartitionAndSerializeNode(
+        partitionedOutputNode->sources().back());
+    if (!fusePartitionAndWrite_) {
+      shuffleWriteSource = core::LocalPartitionNode::gather(
+          "shuffle-gather", std::vector<core::PlanNodePtr>{shuffleWriteSource});
+    }
+  } else {
+    const std::vector<core::SortOrder> sortingOrders(
+        sortingKeys.size(), core::SortOrder(true, true));
+    auto sortedSource = std::make_shared<core::OrderByNode>(
+        "shuffle-sort",
+        sortingKeys,
+        sortingOrders,
+        true,
+        partitionedOutputNode->sources().back());
+    shuffleWriteSource =
+        makePartitionAndSerializeNode(std::make_shared<core::LocalMergeNode>(
+            "shuffle-merge",
+            sortingKeys,
+            sortingOrders,
+            std::vector<core::PlanNodePtr>{std::move(sortedSource)}));
+  }
+
+  core::PlanNodePtr shuffleWriteNode = shuffleWriteSource;
+  if (!fusePartitionAndWrite_) {
+    shuffleWriteNode = std::make_shared<operators::ShuffleWriteNode>(
+        "root",
+        shuffleName_,
+        std::move(*serializedShuffleWriteInfo_),
+        shuffleWriteSource);
+  }
 
   // For presto_cpp, the last node must be the PartitionedOutputNode in order to
   // get the output (e.g actual data or metadata) and send back to coordinator.
@@ -2385,7 +3137,25 @@ velox::core::PlanNodePtr VeloxBatchQueryPlanConverter::toVeloxQueryPlan(
     const std::shared_ptr<protocol::TableWriteInfo>& /* tableWriteInfo */,
     const protocol::TaskId& taskId) {
   auto rowType = toRowType(node->outputVariables);
-  return std::make_shared<operators::ShuffleReadNode>(node->id, rowType);
+  if (sortByPartitionKeys_ && node->orderingScheme) {
+    // The sorted runs of the writers are merged instead of being sorted
+    // again.
+    std::vector<core::FieldAccessTypedExprPtr> sortingKeys;
+    std::vector<core::SortOrder> sortingOrders;
+    for (const auto& orderBy : node->orderingScheme->orderBy) {
+      sortingKeys.emplace_back(exprConverter_.toVeloxExpr(orderBy.variable));
+      sortingOrders.emplace_back(toVeloxSortOrder(orderBy.sortOrder));
+    }
+    return std::make_shared<operators::ShuffleReadNode>(
+        node->id,
+        rowType,
+        serdeFormat_,
+        std::move(sortingKeys),
+        std::move(sortingOrders),
+        shuffleName_);
+  }
+  return std::make_shared<operators::ShuffleReadNode>(
+      node->id, rowType, serdeFormat_);
 }
 
 void registerPrestoPlanNodeSerDe() {
@@ -2394,9 +3164,15 @@ void registerPrestoPlanNodeSerDe() {
   registry.Register(
       "PartitionAndSerializeNode",
       presto::operators::PartitionAndSerializeNode::create);
+  registry.Register(
+      "RangePartitionFunctionSpec",
+      presto::operators::RangePartitionFunctionSpec::deserialize);
   registry.Register(
       "ShuffleReadNode", presto::operators::ShuffleReadNode::create);
   registry.Register(
       "ShuffleWriteNode", presto::operators::ShuffleWriteNode::create);
+  registry.Register(
+      "Xxh3PartitionFunctionSpec",
+      presto::operators::Xxh3PartitionFunctionSpec::deserialize);
 }
 } // namespace facebook::presto
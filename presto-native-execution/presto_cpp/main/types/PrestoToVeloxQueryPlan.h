@@ -32,8 +32,12 @@ namespace facebook::presto {
 
 class VeloxQueryPlanConverterBase {
  public:
-  explicit VeloxQueryPlanConverterBase(velox::memory::MemoryPool* pool)
-      : pool_(pool), exprConverter_(pool) {}
+  /// Decodes the constant blocks of the plans through 'constantBlockCache' if
+  /// not null.
+  explicit VeloxQueryPlanConverterBase(
+      velox::memory::MemoryPool* pool,
+      ConstantBlockCache* constantBlockCache = nullptr)
+      : pool_(pool), exprConverter_(pool, constantBlockCache) {}
 
   virtual velox::core::PlanFragment toVeloxQueryPlan(
       const protocol::PlanFragment& fragment,
@@ -46,6 +50,26 @@ class VeloxQueryPlanConverterBase {
       const std::shared_ptr<protocol::TableWriteInfo>& tableWriteInfo,
       const protocol::TaskId& taskId);
 
+  /// Returns true if a plan converted by this converter depends on the task it
+  /// was converted for, e.g. has an AssignUniqueIdNode, and can't be shared
+  /// with the other tasks of the stage.
+  bool taskSpecific() const {
+    return taskSpecific_;
+  }
+
+  /// Returns the ids of the fragments whose output is broadcast to the
+  /// remote sources of the converted plans, i.e. whose every consumer task
+  /// reads the same pages.
+  const std::vector<std::string>& broadcastSourceFragmentIds() const {
+    return broadcastSourceFragmentIds_;
+  }
+
+  /// Returns the time spent converting the TupleDomains of the table scans to
+  /// Velox filters.
+  uint64_t filterConversionNanos() const {
+    return filterConversionNanos_;
+  }
+
  protected:
   virtual velox::core::PlanNodePtr toVeloxQueryPlan(
       const std::shared_ptr<const protocol::RemoteSourceNode>& node,
@@ -107,7 +131,7 @@ class VeloxQueryPlanConverterBase {
       const std::shared_ptr<protocol::TableWriteInfo>& tableWriteInfo,
       const protocol::TaskId& taskId);
 
-  std::shared_ptr<const velox::core::TopNNode> toVeloxQueryPlan(
+  velox::core::PlanNodePtr toVeloxQueryPlan(
       const std::shared_ptr<const protocol::TopNNode>& node,
       const std::shared_ptr<protocol::TableWriteInfo>& tableWriteInfo,
       const protocol::TaskId& taskId);
@@ -117,7 +141,7 @@ class VeloxQueryPlanConverterBase {
       const std::shared_ptr<protocol::TableWriteInfo>& tableWriteInfo,
       const protocol::TaskId& taskId);
 
-  std::shared_ptr<const velox::core::OrderByNode> toVeloxQueryPlan(
+  velox::core::PlanNodePtr toVeloxQueryPlan(
       const std::shared_ptr<const protocol::SortNode>& node,
       const std::shared_ptr<protocol::TableWriteInfo>& tableWriteInfo,
       const protocol::TaskId& taskId);
@@ -155,19 +179,35 @@ class VeloxQueryPlanConverterBase {
       const std::shared_ptr<protocol::TableWriteInfo>& tableWriteInfo,
       const protocol::TaskId& taskId);
 
+  std::shared_ptr<const velox::core::FilterNode> tryConvertTopNRowNumber(
+      const std::shared_ptr<const protocol::FilterNode>& node,
+      const std::shared_ptr<protocol::TableWriteInfo>& tableWriteInfo,
+      const protocol::TaskId& taskId);
+
   velox::core::WindowNode::Function toVeloxWindowFunction(
       const protocol::Function& func);
 
   velox::memory::MemoryPool* pool_;
   VeloxExprConverter exprConverter_;
+  bool taskSpecific_{false};
+  std::vector<std::string> broadcastSourceFragmentIds_;
+  uint64_t filterConversionNanos_{0};
+  // The paths of the subfields read of the output columns of the table
+  // scans, keyed by the id of the scan and the name of the column.
+  std::unordered_map<
+      std::string,
+      std::unordered_map<std::string, std::vector<std::string>>>
+      scanPaths_;
 };
 
 class VeloxInteractiveQueryPlanConverter : public VeloxQueryPlanConverterBase {
  public:
   using VeloxQueryPlanConverterBase::toVeloxQueryPlan;
 
-  explicit VeloxInteractiveQueryPlanConverter(velox::memory::MemoryPool* pool)
-      : VeloxQueryPlanConverterBase(pool) {}
+  explicit VeloxInteractiveQueryPlanConverter(
+      velox::memory::MemoryPool* pool,
+      ConstantBlockCache* constantBlockCache = nullptr)
+      : VeloxQueryPlanConverterBase(pool, constantBlockCache) {}
 
  protected:
   velox::core::PlanNodePtr toVeloxQueryPlan(
@@ -180,13 +220,29 @@ class VeloxBatchQueryPlanConverter : public VeloxQueryPlanConverterBase {
  public:
   using VeloxQueryPlanConverterBase::toVeloxQueryPlan;
 
+  /// If 'sortByPartitionKeys' is true, the rows of each shuffle partition are
+  /// written in the ascending order of the partition keys. If
+  /// 'fusePartitionAndWrite' is true, the shuffle writers are fed by the
+  /// PartitionAndSerializeNode instead of a separate ShuffleWriteNode. If
+  /// 'xxh3HashPartitioning' is true, the hash partitions on BIGINT, INTEGER
+  /// and VARCHAR columns are computed by the Xxh3PartitionFunction.
   VeloxBatchQueryPlanConverter(
       const std::string& shuffleName,
       std::shared_ptr<std::string>&& serializedShuffleWriteInfo,
-      velox::memory::MemoryPool* pool)
-      : VeloxQueryPlanConverterBase(pool),
+      velox::memory::MemoryPool* pool,
+      operators::ShuffleSerdeFormat serdeFormat =
+          operators::ShuffleSerdeFormat::kUnsafeRow,
+      bool sortByPartitionKeys = false,
+      bool fusePartitionAndWrite = false,
+      bool xxh3HashPartitioning = false,
+      ConstantBlockCache* constantBlockCache = nullptr)
+      : VeloxQueryPlanConverterBase(pool, constantBlockCache),
         shuffleName_(shuffleName),
-        serializedShuffleWriteInfo_(std::move(serializedShuffleWriteInfo)) {}
+        serializedShuffleWriteInfo_(std::move(serializedShuffleWriteInfo)),
+        serdeFormat_(serdeFormat),
+        sortByPartitionKeys_(sortByPartitionKeys),
+        fusePartitionAndWrite_(fusePartitionAndWrite),
+        xxh3HashPartitioning_(xxh3HashPartitioning) {}
 
   velox::core::PlanFragment toVeloxQueryPlan(
       const protocol::PlanFragment& fragment,
@@ -202,6 +258,11 @@ class VeloxBatchQueryPlanConverter : public VeloxQueryPlanConverterBase {
  private:
   const std::string shuffleName_;
   const std::shared_ptr<std::string> serializedShuffleWriteInfo_;
+  // The format of the data written to and read from the shuffle.
+  const operators::ShuffleSerdeFormat serdeFormat_;
+  const bool sortByPartitionKeys_;
+  const bool fusePartitionAndWrite_;
+  const bool xxh3HashPartitioning_;
 };
 
 void registerPrestoPlanNodeSerDe();
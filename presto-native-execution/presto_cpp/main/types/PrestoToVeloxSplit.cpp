@@ -36,24 +36,56 @@ dwio::common::FileFormat toVeloxFileFormat(
   }
 }
 
+bool samePartitionKeys(
+    const std::vector<protocol::HivePartitionKey>& keys,
+    const std::unordered_map<std::string, std::optional<std::string>>&
+        partitionKeys) {
+  if (keys.size() != partitionKeys.size()) {
+    return false;
+  }
+  for (const auto& key : keys) {
+    auto it = partitionKeys.find(key.name);
+    if (it == partitionKeys.end() ||
+        it->second.has_value() != (key.value != nullptr) ||
+        (key.value != nullptr && *it->second != *key.value)) {
+      return false;
+    }
+  }
+  return true;
+}
+
 } // anonymous namespace
 
 velox::exec::Split toVeloxSplit(
     const presto::protocol::ScheduledSplit& scheduledSplit) {
+  return VeloxSplitConverter().toVeloxSplit(scheduledSplit);
+}
+
+const VeloxSplitConverter::PartitionKeys& VeloxSplitConverter::toPartitionKeys(
+    const protocol::HiveSplit& hiveSplit) {
+  if (hasPartitionKeys_ &&
+      samePartitionKeys(hiveSplit.partitionKeys, partitionKeys_)) {
+    return partitionKeys_;
+  }
+  partitionKeys_.clear();
+  for (const auto& entry : hiveSplit.partitionKeys) {
+    partitionKeys_.emplace(
+        entry.name,
+        entry.value == nullptr ? std::nullopt
+                               : std::optional<std::string>{*entry.value});
+  }
+  hasPartitionKeys_ = true;
+  return partitionKeys_;
+}
+
+velox::exec::Split VeloxSplitConverter::toVeloxSplit(
+    const presto::protocol::ScheduledSplit& scheduledSplit) {
   const auto& connectorSplit = scheduledSplit.split.connectorSplit;
   const auto splitGroupId = scheduledSplit.split.lifespan.isgroup
       ? scheduledSplit.split.lifespan.groupid
       : -1;
   if (auto hiveSplit = std::dynamic_pointer_cast<const protocol::HiveSplit>(
           connectorSplit)) {
-    std::unordered_map<std::string, std::optional<std::string>> partitionKeys;
-    for (const auto& entry : hiveSplit->partitionKeys) {
-      partitionKeys.emplace(
-          entry.name,
-          entry.value == nullptr ? std::nullopt
-                                 : std::optional<std::string>{*entry.value});
-    }
-
     return velox::exec::Split(
         std::make_shared<connector::hive::HiveConnectorSplit>(
             scheduledSplit.split.connectorId,
@@ -61,7 +93,7 @@ velox::exec::Split toVeloxSplit(
             toVeloxFileFormat(hiveSplit->storage.storageFormat.inputFormat),
             hiveSplit->fileSplit.start,
             hiveSplit->fileSplit.length,
-            partitionKeys,
+            toPartitionKeys(*hiveSplit),
             hiveSplit->tableBucketNumber
                 ? std::optional<int>(*hiveSplit->tableBucketNumber)
                 : std::nullopt),
@@ -13,6 +13,9 @@
  */
 #pragma once
 
+#include <optional>
+#include <unordered_map>
+
 #include "presto_cpp/presto_protocol/presto_protocol.h"
 #include "velox/exec/Split.h"
 
@@ -23,4 +26,24 @@ namespace facebook::presto {
 velox::exec::Split toVeloxSplit(
     const presto::protocol::ScheduledSplit& scheduledSplit);
 
+// Converts a sequence of protocol splits. The consecutive hive splits of a
+// partition share their partition keys, which are only converted once.
+// Not thread-safe.
+class VeloxSplitConverter {
+ public:
+  velox::exec::Split toVeloxSplit(
+      const presto::protocol::ScheduledSplit& scheduledSplit);
+
+ private:
+  using PartitionKeys =
+      std::unordered_map<std::string, std::optional<std::string>>;
+
+  // Returns the partition keys of 'hiveSplit'. Reuses the ones of the last
+  // converted hive split if equal.
+  const PartitionKeys& toPartitionKeys(const protocol::HiveSplit& hiveSplit);
+
+  PartitionKeys partitionKeys_;
+  bool hasPartitionKeys_{false};
+};
+
 } // namespace facebook::presto
@@ -15,7 +15,6 @@
 #include <iostream>
 
 #include <antlr4-runtime/antlr4-runtime.h>
-#include "presto_cpp/main/types/ParseTypeSignature.h"
 #include "presto_cpp/main/types/TypeSignatureTypeConverter.h"
 #include "presto_cpp/main/types/antlr/TypeSignatureLexer.h"
 #include "velox/functions/prestosql/types/HyperLogLogType.h"
@@ -25,10 +24,6 @@
 using namespace facebook::velox;
 namespace facebook::presto {
 
-TypePtr parseTypeSignature(const std::string& signature) {
-  return TypeSignatureTypeConverter::parse(signature);
-}
-
 // static
 TypePtr TypeSignatureTypeConverter::parse(const std::string& text) {
   antlr4::ANTLRInputStream input(text);
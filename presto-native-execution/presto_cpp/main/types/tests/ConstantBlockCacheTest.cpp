@@ -0,0 +1,110 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <gtest/gtest.h>
+
+#include "presto_cpp/main/types/ConstantBlockCache.h"
+#include "presto_cpp/presto_protocol/Base64Util.h"
+#include "velox/vector/SimpleVector.h"
+
+using namespace facebook::presto;
+using namespace facebook::velox;
+
+namespace {
+// LONG_ARRAY blocks of the 16 bigints from 0 and from 100.
+const std::string kBlock0 =
+    "CgAAAExPTkdfQVJSQVkQAAAAAAAAAAAAAAAAAQAAAAAAAAACAAAAAAAAAAMAAAAAAAAABAAAAA"
+    "AAAAAFAAAAAAAAAAYAAAAAAAAABwAAAAAAAAAIAAAAAAAAAAkAAAAAAAAACgAAAAAAAAALAAAA"
+    "AAAAAAwAAAAAAAAADQAAAAAAAAAOAAAAAAAAAA8AAAAAAAAA";
+const std::string kBlock100 =
+    "CgAAAExPTkdfQVJSQVkQAAAAAGQAAAAAAAAAZQAAAAAAAABmAAAAAAAAAGcAAAAAAAAAaAAAAA"
+    "AAAABpAAAAAAAAAGoAAAAAAAAAawAAAAAAAABsAAAAAAAAAG0AAAAAAAAAbgAAAAAAAABvAAAA"
+    "AAAAAHAAAAAAAAAAcQAAAAAAAAByAAAAAAAAAHMAAAAAAAAA";
+} // namespace
+
+class ConstantBlockCacheTest : public ::testing::Test {
+ protected:
+  VectorPtr getOrDecode(
+      ConstantBlockCache& cache,
+      const TypePtr& type,
+      const std::string& encoded) {
+    return cache.getOrDecode(type, encoded, [&]() {
+      ++numDecodes_;
+      return protocol::readBlock(type, encoded, pool_.get());
+    });
+  }
+
+  std::shared_ptr<memory::MemoryPool> pool_{
+      memory::addDefaultLeafMemoryPool()};
+  int32_t numDecodes_{0};
+};
+
+TEST_F(ConstantBlockCacheTest, sharesDecodedBlocks) {
+  ConstantBlockCache cache(1 << 20);
+  auto first = getOrDecode(cache, BIGINT(), kBlock0);
+  auto second = getOrDecode(cache, BIGINT(), kBlock0);
+  EXPECT_EQ(numDecodes_, 1);
+  EXPECT_EQ(first.get(), second.get());
+  ASSERT_EQ(first->size(), 16);
+  EXPECT_EQ(first->as<SimpleVector<int64_t>>()->valueAt(15), 15);
+
+  auto other = getOrDecode(cache, BIGINT(), kBlock100);
+  EXPECT_EQ(numDecodes_, 2);
+  EXPECT_EQ(other->as<SimpleVector<int64_t>>()->valueAt(0), 100);
+
+  // The same block decoded as another type is another entry.
+  auto asDouble = getOrDecode(cache, DOUBLE(), kBlock0);
+  EXPECT_EQ(numDecodes_, 3);
+  EXPECT_EQ(asDouble->type()->kind(), TypeKind::DOUBLE);
+  EXPECT_EQ(cache.size(), 3);
+}
+
+TEST_F(ConstantBlockCacheTest, smallBlocks) {
+  ConstantBlockCache cache(1 << 20);
+  const std::string block = "CgAAAExPTkdfQVJSQVkBAAAAAAEAAAAAAAAA";
+  getOrDecode(cache, BIGINT(), block);
+  getOrDecode(cache, BIGINT(), block);
+  EXPECT_EQ(numDecodes_, 2);
+  EXPECT_EQ(cache.size(), 0);
+}
+
+TEST_F(ConstantBlockCacheTest, disabled) {
+  ConstantBlockCache cache(0);
+  getOrDecode(cache, BIGINT(), kBlock0);
+  getOrDecode(cache, BIGINT(), kBlock0);
+  EXPECT_EQ(numDecodes_, 2);
+  EXPECT_EQ(cache.size(), 0);
+}
+
+TEST_F(ConstantBlockCacheTest, evictsLeastRecentlyUsed) {
+  ConstantBlockCache sizing(1 << 20);
+  getOrDecode(sizing, BIGINT(), kBlock0);
+  const auto entryBytes = sizing.bytes();
+
+  // Room for one block only.
+  ConstantBlockCache cache(entryBytes + entryBytes / 2);
+  numDecodes_ = 0;
+  getOrDecode(cache, BIGINT(), kBlock0);
+  getOrDecode(cache, BIGINT(), kBlock100);
+  EXPECT_EQ(cache.size(), 1);
+  EXPECT_LE(cache.bytes(), entryBytes + entryBytes / 2);
+  getOrDecode(cache, BIGINT(), kBlock100);
+  EXPECT_EQ(numDecodes_, 2);
+  getOrDecode(cache, BIGINT(), kBlock0);
+  EXPECT_EQ(numDecodes_, 3);
+
+  // The blocks larger than the cache are not cached.
+  ConstantBlockCache tiny(entryBytes / 2);
+  getOrDecode(tiny, BIGINT(), kBlock0);
+  EXPECT_EQ(tiny.size(), 0);
+}
@@ -21,6 +21,7 @@
 #include "presto_cpp/main/operators/PartitionAndSerialize.h"
 #include "presto_cpp/main/operators/ShuffleRead.h"
 #include "presto_cpp/main/operators/ShuffleWrite.h"
+#include "presto_cpp/main/operators/Xxh3PartitionFunction.h"
 #include "presto_cpp/main/types/PrestoToVeloxQueryPlan.h"
 #include "presto_cpp/presto_protocol/Connectors.h"
 #include "presto_cpp/presto_protocol/presto_protocol.h"
@@ -74,13 +75,22 @@ std::shared_ptr<const core::PlanNode> assertToVeloxQueryPlan(
 std::shared_ptr<const core::PlanNode> assertToBatchVeloxQueryPlan(
     const std::string& fileName,
     const std::string& shuffleName,
-    std::shared_ptr<std::string>&& serializedShuffleWriteInfo) {
+    std::shared_ptr<std::string>&& serializedShuffleWriteInfo,
+    bool sortByPartitionKeys = false,
+    bool fusePartitionAndWrite = false,
+    bool xxh3HashPartitioning = false) {
   const std::string fragment = slurp(getDataPath(fileName));
 
   protocol::PlanFragment prestoPlan = json::parse(fragment);
   auto pool = memory::addDefaultLeafMemoryPool();
   VeloxBatchQueryPlanConverter converter(
-      shuffleName, std::move(serializedShuffleWriteInfo), pool.get());
+      shuffleName,
+      std::move(serializedShuffleWriteInfo),
+      pool.get(),
+      operators::ShuffleSerdeFormat::kUnsafeRow,
+      sortByPartitionKeys,
+      fusePartitionAndWrite,
+      xxh3HashPartitioning);
   return converter
       .toVeloxQueryPlan(
           prestoPlan, nullptr, "20201107_130540_00011_wrpkw.1.2.3")
@@ -110,6 +120,291 @@ TEST_F(PlanConverterTest, scanAgg) {
   assertToVeloxQueryPlan("ScanAggCustomConnectorId.json");
 }
 
+// A Sort or TopN over an input sorted by a Sort is a no-op or a Limit.
+TEST_F(PlanConverterTest, sortedInput) {
+  const json values = json::parse(slurp(getDataPath("ValuesNode.json")));
+  auto orderingScheme = [](const std::string& sortOrder) {
+    return json{
+        {"orderBy",
+         {{{"variable",
+            {{"@type", "variable"}, {"name", "field"}, {"type", "integer"}}},
+           {"sortOrder", sortOrder}}}}};
+  };
+  auto sort = [&](const std::string& id,
+                  const json& source,
+                  const std::string& sortOrder,
+                  bool partial) {
+    return json{
+        {"@type", ".SortNode"},
+        {"id", id},
+        {"source", source},
+        {"orderingScheme", orderingScheme(sortOrder)},
+        {"isPartial", partial}};
+  };
+  auto topN = [&](const json& source,
+                  const std::string& sortOrder,
+                  const std::string& step) {
+    return json{
+        {"@type", ".TopNNode"},
+        {"id", "topN"},
+        {"source", source},
+        {"count", 10},
+        {"orderingScheme", orderingScheme(sortOrder)},
+        {"step", step}};
+  };
+  auto toVeloxPlan = [](const json& node) {
+    std::shared_ptr<protocol::PlanNode> prestoNode = node;
+    auto pool = memory::addDefaultLeafMemoryPool();
+    VeloxInteractiveQueryPlanConverter converter(pool.get());
+    return converter.toVeloxQueryPlan(
+        prestoNode, nullptr, "20201107_130540_00011_wrpkw.1.2.3");
+  };
+
+  // The outer sort is dropped.
+  auto plan = toVeloxPlan(sort(
+      "outer",
+      sort("inner", values, "ASC_NULLS_LAST", false),
+      "ASC_NULLS_LAST",
+      false));
+  ASSERT_NE(std::dynamic_pointer_cast<const core::OrderByNode>(plan), nullptr);
+  ASSERT_EQ(plan->id(), "inner");
+
+  // Unless it sorts in another order or its input is only sorted per driver.
+  plan = toVeloxPlan(sort(
+      "outer",
+      sort("inner", values, "ASC_NULLS_LAST", false),
+      "DESC_NULLS_LAST",
+      false));
+  ASSERT_EQ(plan->id(), "outer");
+  plan = toVeloxPlan(sort(
+      "outer",
+      sort("inner", values, "ASC_NULLS_LAST", true),
+      "ASC_NULLS_LAST",
+      false));
+  ASSERT_EQ(plan->id(), "outer");
+
+  plan = toVeloxPlan(topN(
+      sort("inner", values, "ASC_NULLS_LAST", true),
+      "ASC_NULLS_LAST",
+      "PARTIAL"));
+  auto limit = std::dynamic_pointer_cast<const core::LimitNode>(plan);
+  ASSERT_NE(limit, nullptr);
+  ASSERT_EQ(limit->count(), 10);
+  ASSERT_TRUE(limit->isPartial());
+
+  plan = toVeloxPlan(topN(
+      sort("inner", values, "ASC_NULLS_LAST", true),
+      "ASC_NULLS_LAST",
+      "SINGLE"));
+  ASSERT_NE(std::dynamic_pointer_cast<const core::TopNNode>(plan), nullptr);
+}
+
+// The scan of ScanAgg.json without the required subfields from the
+// coordinator, projecting complex_type[1]['foo'].id and, if 'readWhole',
+// cardinality(complex_type).
+TEST_F(PlanConverterTest, scanDerivedSubfields) {
+  protocol::registerConnector("hive", "hive");
+  auto call = [](const std::string& name,
+                 std::vector<json> arguments,
+                 const std::vector<std::string>& argumentTypes,
+                 const std::string& returnType) {
+    return json{
+        {"@type", "call"},
+        {"arguments", std::move(arguments)},
+        {"displayName", name},
+        {"functionHandle",
+         {{"@type", "$static"},
+          {"signature",
+           {{"argumentTypes", argumentTypes},
+            {"kind", "SCALAR"},
+            {"longVariableConstraints", json::array()},
+            {"name", "presto.default." + name},
+            {"returnType", returnType},
+            {"typeVariableConstraints", json::array()},
+            {"variableArity", false}}}}},
+        {"returnType", returnType}};
+  };
+  const std::string rowType = "row(id bigint, description varchar)";
+  const std::string mapType = "map(varchar, " + rowType + ")";
+  const std::string arrayType = "array(" + mapType + ")";
+  const json column = {
+      {"@type", "variable"}, {"name", "complex_type"}, {"type", arrayType}};
+  const json index = {
+      {"@type", "constant"},
+      {"valueBlock", "CgAAAExPTkdfQVJSQVkBAAAAAAEAAAAAAAAA"},
+      {"type", "bigint"}};
+  const json key = {
+      {"@type", "constant"},
+      {"valueBlock", "DgAAAFZBUklBQkxFX1dJRFRIAQAAAAMAAAAAAwAAAGZvbw=="},
+      {"type", "varchar"}};
+  const json id = {
+      {"@type", "special"},
+      {"form", "DEREFERENCE"},
+      {"returnType", "bigint"},
+      {"arguments",
+       {call(
+            "$operator$subscript",
+            {call("$operator$subscript",
+                  {column, index},
+                  {arrayType, "bigint"},
+                  mapType),
+             key},
+            {mapType, "varchar"},
+            rowType),
+        {{"@type", "constant"},
+         {"valueBlock", "CQAAAElOVF9BUlJBWQEAAAAAAAAAAA=="},
+         {"type", "integer"}}}}};
+
+  auto requiredSubfields = [&](bool readWhole) {
+    json fragment = json::parse(slurp(getDataPath("ScanAgg.json")));
+    auto& project = fragment["root"]["source"];
+    auto& assignments = project["assignments"]["assignments"];
+    assignments["expr<bigint>"] = readWhole
+        ? call("plus",
+               {id,
+                call("cardinality", {column}, {arrayType}, "bigint")},
+               {"bigint", "bigint"},
+               "bigint")
+        : id;
+    for (auto& handle : project["source"]["assignments"]) {
+      handle["requiredSubfields"] = json::array();
+    }
+
+    protocol::PlanFragment prestoPlan = fragment;
+    auto pool = memory::addDefaultLeafMemoryPool();
+    VeloxInteractiveQueryPlanConverter converter(pool.get());
+    auto plan = converter.toVeloxQueryPlan(
+        prestoPlan, nullptr, "20201107_130540_00011_wrpkw.1.2.3");
+    auto* tableScan = dynamic_cast<const core::TableScanNode*>(
+        plan.planNode->sources()[0]->sources()[0]->sources()[0].get());
+    VELOX_CHECK_NOT_NULL(tableScan);
+    auto* columnHandle =
+        dynamic_cast<const connector::hive::HiveColumnHandle*>(
+            tableScan->assignments().at("complex_type").get());
+    VELOX_CHECK_NOT_NULL(columnHandle);
+    std::vector<std::string> subfields;
+    for (const auto& subfield : columnHandle->requiredSubfields()) {
+      subfields.emplace_back(subfield.toString());
+    }
+    return subfields;
+  };
+
+  ASSERT_EQ(
+      requiredSubfields(false),
+      std::vector<std::string>{"complex_type[1][\"foo\"].id"});
+  ASSERT_TRUE(requiredSubfields(true).empty());
+
+  // A Filter directly over the scan passes complex_type through to the
+  // nodes above it, so the whole column is read.
+  const json fragment = json::parse(slurp(getDataPath("ScanAgg.json")));
+  json scan = fragment["root"]["source"]["source"];
+  for (auto& handle : scan["assignments"]) {
+    handle["requiredSubfields"] = json::array();
+  }
+  const json one = {
+      {"@type", "constant"},
+      {"valueBlock", "CgAAAExPTkdfQVJSQVkBAAAAAAEAAAAAAAAA"},
+      {"type", "bigint"}};
+  std::shared_ptr<protocol::PlanNode> filter = json{
+      {"@type", ".FilterNode"},
+      {"id", "filter"},
+      {"source", scan},
+      {"predicate",
+       call("$operator$equal", {id, one}, {"bigint", "bigint"}, "boolean")}};
+  auto pool = memory::addDefaultLeafMemoryPool();
+  VeloxInteractiveQueryPlanConverter converter(pool.get());
+  auto plan = converter.toVeloxQueryPlan(
+      filter, nullptr, "20201107_130540_00011_wrpkw.1.2.3");
+  auto* tableScan =
+      dynamic_cast<const core::TableScanNode*>(plan->sources()[0].get());
+  ASSERT_TRUE(tableScan != nullptr);
+  auto* columnHandle = dynamic_cast<const connector::hive::HiveColumnHandle*>(
+      tableScan->assignments().at("complex_type").get());
+  ASSERT_TRUE(columnHandle != nullptr);
+  ASSERT_TRUE(columnHandle->requiredSubfields().empty());
+}
+
+// The IN lists of the scan of ScanAgg.json are converted in bulk and the
+// conversion time is measured.
+TEST_F(PlanConverterTest, inListFilters) {
+  protocol::registerConnector("hive", "hive");
+  auto values = [](const std::string& type,
+                   const std::vector<std::string>& valueBlocks) {
+    json ranges = json::array();
+    for (const auto& valueBlock : valueBlocks) {
+      const json marker = {
+          {"type", type}, {"valueBlock", valueBlock}, {"bound", "EXACTLY"}};
+      ranges.push_back({{"low", marker}, {"high", marker}});
+    }
+    return json{
+        {"values", {{"@type", "sortable"}, {"type", type}, {"ranges", ranges}}},
+        {"nullAllowed", false}};
+  };
+  // LONG_ARRAY and VARIABLE_WIDTH blocks of a single value.
+  const std::string three = "CgAAAExPTkdfQVJSQVkBAAAAAAMAAAAAAAAA";
+  const std::string four = "CgAAAExPTkdfQVJSQVkBAAAAAAQAAAAAAAAA";
+  const std::string five = "CgAAAExPTkdfQVJSQVkBAAAAAAUAAAAAAAAA";
+  const std::string thousand = "CgAAAExPTkdfQVJSQVkBAAAAAOgDAAAAAAAA";
+  const std::string algeria =
+      "DgAAAFZBUklBQkxFX1dJRFRIAQAAAAcAAAAABwAAAEFMR0VSSUE=";
+  const std::string brazil =
+      "DgAAAFZBUklBQkxFX1dJRFRIAQAAAAYAAAAABgAAAEJSQVpJTA==";
+
+  json fragment = json::parse(slurp(getDataPath("ScanAgg.json")));
+  auto& layout =
+      fragment["root"]["source"]["source"]["table"]["connectorTableLayout"];
+  layout["domainPredicate"]["columnDomains"] = {
+      {{"column", "nationkey"},
+       {"domain", values("bigint", {five, three, four, three})}},
+      {{"column", "regionkey"},
+       {"domain", values("bigint", {three, thousand, five})}},
+      {{"column", "name"},
+       {"domain", values("varchar", {brazil, algeria, brazil})}}};
+
+  protocol::PlanFragment prestoPlan = fragment;
+  auto pool = memory::addDefaultLeafMemoryPool();
+  VeloxInteractiveQueryPlanConverter converter(pool.get());
+  auto plan = converter.toVeloxQueryPlan(
+      prestoPlan, nullptr, "20201107_130540_00011_wrpkw.1.2.3");
+  ASSERT_GT(converter.filterConversionNanos(), 0);
+
+  auto* tableScan = dynamic_cast<const core::TableScanNode*>(
+      plan.planNode->sources()[0]->sources()[0]->sources()[0].get());
+  ASSERT_TRUE(tableScan != nullptr);
+  auto* tableHandle = dynamic_cast<const connector::hive::HiveTableHandle*>(
+      tableScan->tableHandle().get());
+  ASSERT_TRUE(tableHandle != nullptr);
+  const auto& filters = tableHandle->subfieldFilters();
+  ASSERT_EQ(filters.size(), 3);
+
+  // Contiguous values are a range, whatever their order and duplicates.
+  auto* range = dynamic_cast<const common::BigintRange*>(
+      filters.at(common::Subfield("nationkey")).get());
+  ASSERT_TRUE(range != nullptr);
+  ASSERT_EQ(range->lower(), 3);
+  ASSERT_EQ(range->upper(), 5);
+  ASSERT_FALSE(range->testNull());
+
+  const auto& bigintValues = filters.at(common::Subfield("regionkey"));
+  ASSERT_TRUE(
+      bigintValues->kind() == common::FilterKind::kBigintValuesUsingBitmask ||
+      bigintValues->kind() == common::FilterKind::kBigintValuesUsingHashTable);
+  for (auto value : {3, 5, 1000}) {
+    ASSERT_TRUE(bigintValues->testInt64(value)) << value;
+  }
+  for (auto value : {2, 4, 999, 1001}) {
+    ASSERT_FALSE(bigintValues->testInt64(value)) << value;
+  }
+
+  auto* bytesValues = dynamic_cast<const common::BytesValues*>(
+      filters.at(common::Subfield("name")).get());
+  ASSERT_TRUE(bytesValues != nullptr);
+  ASSERT_EQ(bytesValues->values().size(), 2);
+  ASSERT_TRUE(bytesValues->testBytes("ALGERIA", 7));
+  ASSERT_TRUE(bytesValues->testBytes("BRAZIL", 6));
+  ASSERT_FALSE(bytesValues->testBytes("CHINA", 5));
+}
+
 // Final Agg stage plan for select regionkey, sum(1) from nation group by 1
 TEST_F(PlanConverterTest, finalAgg) {
   assertToVeloxQueryPlan("FinalAgg.json");
@@ -140,6 +435,41 @@ TEST_F(PlanConverterTest, offsetLimit) {
   ASSERT_TRUE(foundLimit);
 }
 
+// Last stage plan for SELECT * FROM nation WHERE nationkey > 7 with a
+// dynamic filter on nationkey from a join in another fragment.
+TEST_F(PlanConverterTest, dynamicFilter) {
+  auto plan = assertToVeloxQueryPlan("DynamicFilter.json");
+
+  // The dynamic filter placeholder is dropped from the conjunction.
+  auto filter =
+      std::dynamic_pointer_cast<const core::FilterNode>(plan->sources()[0]);
+  ASSERT_TRUE(filter != nullptr);
+  auto call =
+      std::dynamic_pointer_cast<const core::CallTypedExpr>(filter->filter());
+  ASSERT_TRUE(call != nullptr);
+  ASSERT_EQ("presto.default.gt", call->name());
+}
+
+// Last stage plan for SELECT *, row_number() OVER (ORDER BY nationkey DESC)
+// AS row_number FROM nation with the window filtered by row_number <= 3.
+TEST_F(PlanConverterTest, topNRowNumber) {
+  auto plan = assertToVeloxQueryPlan("TopNRowNumber.json");
+
+  // Look for Filter -> Window -> TopN(count = 3).
+  auto node = plan->sources()[0];
+  ASSERT_TRUE(std::dynamic_pointer_cast<const core::FilterNode>(node));
+  node = node->sources()[0];
+  ASSERT_TRUE(std::dynamic_pointer_cast<const core::WindowNode>(node));
+  auto topN =
+      std::dynamic_pointer_cast<const core::TopNNode>(node->sources()[0]);
+  ASSERT_TRUE(topN != nullptr);
+  ASSERT_EQ(3, topN->count());
+  ASSERT_FALSE(topN->isPartial());
+  ASSERT_EQ(1, topN->sortingKeys().size());
+  ASSERT_EQ("nationkey", topN->sortingKeys()[0]->name());
+  ASSERT_FALSE(topN->sortingOrders()[0].isAscending());
+}
+
 TEST_F(PlanConverterTest, batchPlanConversion) {
   protocol::unregisterConnector("hive");
   protocol::registerConnector("hive", "hive");
@@ -191,3 +521,120 @@ TEST_F(PlanConverterTest, batchPlanConversion) {
       std::dynamic_pointer_cast<const operators::ShuffleReadNode>(curNode);
   ASSERT_NE(shuffleReadNode, nullptr);
 }
+
+TEST_F(PlanConverterTest, batchPlanConversionSortedByPartitionKeys) {
+  protocol::unregisterConnector("hive");
+  protocol::registerConnector("hive", "hive");
+  filesystems::registerLocalFileSystem();
+  auto root = assertToBatchVeloxQueryPlan(
+      "ScanAggBatch.json",
+      std::string(operators::LocalPersistentShuffleFactory::kShuffleName),
+      std::make_shared<std::string>(fmt::format(
+          "{{\n"
+          "  \"rootPath\": \"{}\",\n"
+          "  \"numPartitions\": {}\n"
+          "}}",
+          exec::test::TempDirectoryPath::create()->path,
+          10)),
+      true);
+
+  // Each driver sorts its rows, which are merged before they are partitioned.
+  auto shuffleWrite =
+      std::dynamic_pointer_cast<const operators::ShuffleWriteNode>(
+          root->sources().back());
+  ASSERT_NE(shuffleWrite, nullptr);
+
+  auto partitionAndSerializeNode =
+      std::dynamic_pointer_cast<const operators::PartitionAndSerializeNode>(
+          shuffleWrite->sources().back());
+  ASSERT_NE(partitionAndSerializeNode, nullptr);
+
+  auto localMerge = std::dynamic_pointer_cast<const core::LocalMergeNode>(
+      partitionAndSerializeNode->sources().back());
+  ASSERT_NE(localMerge, nullptr);
+  ASSERT_EQ(
+      localMerge->sortingKeys().size(),
+      partitionAndSerializeNode->keys().size());
+
+  auto orderBy = std::dynamic_pointer_cast<const core::OrderByNode>(
+      localMerge->sources().back());
+  ASSERT_NE(orderBy, nullptr);
+  ASSERT_TRUE(orderBy->isPartial());
+  ASSERT_EQ(orderBy->sortingKeys().size(), localMerge->sortingKeys().size());
+  ASSERT_EQ(
+      std::dynamic_pointer_cast<const core::LocalPartitionNode>(
+          orderBy->sources().back()),
+      nullptr);
+}
+
+TEST_F(PlanConverterTest, batchPlanConversionFusedWrite) {
+  protocol::unregisterConnector("hive");
+  protocol::registerConnector("hive", "hive");
+  filesystems::registerLocalFileSystem();
+  const auto shuffleName =
+      std::string(operators::LocalPersistentShuffleFactory::kShuffleName);
+  auto root = assertToBatchVeloxQueryPlan(
+      "ScanAggBatch.json",
+      shuffleName,
+      std::make_shared<std::string>(fmt::format(
+          "{{\n"
+          "  \"rootPath\": \"{}\",\n"
+          "  \"numPartitions\": {}\n"
+          "}}",
+          exec::test::TempDirectoryPath::create()->path,
+          10)),
+      false,
+      true);
+
+  // The rows of each driver are written to the shuffle by
+  // PartitionAndSerialize.
+  auto partitionAndSerializeNode =
+      std::dynamic_pointer_cast<const operators::PartitionAndSerializeNode>(
+          root->sources().back());
+  ASSERT_NE(partitionAndSerializeNode, nullptr);
+  ASSERT_EQ(partitionAndSerializeNode->shuffleName(), shuffleName);
+  ASSERT_FALSE(partitionAndSerializeNode->serializedShuffleWriteInfo().empty());
+}
+
+TEST_F(PlanConverterTest, batchPlanConversionXxh3Partitioning) {
+  protocol::unregisterConnector("hive");
+  protocol::registerConnector("hive", "hive");
+  filesystems::registerLocalFileSystem();
+  const auto shuffleName =
+      std::string(operators::LocalPersistentShuffleFactory::kShuffleName);
+  auto partitionFunction = [&](bool xxh3HashPartitioning) {
+    auto root = assertToBatchVeloxQueryPlan(
+        "ScanAggBatch.json",
+        shuffleName,
+        std::make_shared<std::string>(fmt::format(
+            "{{\n"
+            "  \"rootPath\": \"{}\",\n"
+            "  \"numPartitions\": {}\n"
+            "}}",
+            exec::test::TempDirectoryPath::create()->path,
+            10)),
+        false,
+        true,
+        xxh3HashPartitioning);
+    auto partitionAndSerializeNode =
+        std::dynamic_pointer_cast<const operators::PartitionAndSerializeNode>(
+            root->sources().back());
+    VELOX_CHECK_NOT_NULL(partitionAndSerializeNode);
+    return partitionAndSerializeNode->partitionFunctionFactory();
+  };
+
+  // The bigint partition key is hashed with XXH3 only when enabled.
+  auto xxh3Spec = partitionFunction(true);
+  ASSERT_NE(
+      std::dynamic_pointer_cast<const operators::Xxh3PartitionFunctionSpec>(
+          xxh3Spec),
+      nullptr);
+  ASSERT_EQ(xxh3Spec->toString().rfind("XXH3(", 0), 0);
+
+  auto defaultSpec = partitionFunction(false);
+  ASSERT_EQ(
+      std::dynamic_pointer_cast<const operators::Xxh3PartitionFunctionSpec>(
+          defaultSpec),
+      nullptr);
+  ASSERT_EQ(defaultSpec->toString().rfind("HASH(", 0), 0);
+}
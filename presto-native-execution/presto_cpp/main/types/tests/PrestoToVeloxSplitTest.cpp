@@ -64,3 +64,40 @@ TEST(PrestoToVeloxSplitTest, nullPartitionKey) {
   ASSERT_FALSE(
       veloxHiveSplit->partitionKeys.at("nullPartitionKey").has_value());
 }
+
+TEST(PrestoToVeloxSplitTest, consecutivePartitions) {
+  auto addPartitionKey = [](protocol::ScheduledSplit& scheduledSplit,
+                            const std::string& name,
+                            std::shared_ptr<std::string> value) {
+    std::dynamic_pointer_cast<protocol::HiveSplit>(
+        scheduledSplit.split.connectorSplit)
+        ->partitionKeys.push_back({name, value});
+  };
+  auto ds = [](const std::string& value) {
+    return std::make_shared<std::string>(value);
+  };
+  std::vector<protocol::ScheduledSplit> scheduledSplits;
+  for (const auto& value : {"2023-01-01", "2023-01-01", "2023-01-02"}) {
+    scheduledSplits.push_back(makeHiveScheduledSplit());
+    addPartitionKey(scheduledSplits.back(), "ds", ds(value));
+  }
+  scheduledSplits.push_back(makeHiveScheduledSplit());
+  addPartitionKey(scheduledSplits.back(), "ds", nullptr);
+  scheduledSplits.push_back(makeHiveScheduledSplit());
+
+  VeloxSplitConverter converter;
+  std::vector<std::unordered_map<std::string, std::optional<std::string>>>
+      partitionKeys;
+  for (const auto& scheduledSplit : scheduledSplits) {
+    auto veloxSplit = converter.toVeloxSplit(scheduledSplit);
+    partitionKeys.push_back(
+        std::dynamic_pointer_cast<connector::hive::HiveConnectorSplit>(
+            veloxSplit.connectorSplit)
+            ->partitionKeys);
+  }
+  ASSERT_EQ(partitionKeys[0].at("ds"), "2023-01-01");
+  ASSERT_EQ(partitionKeys[1].at("ds"), "2023-01-01");
+  ASSERT_EQ(partitionKeys[2].at("ds"), "2023-01-02");
+  ASSERT_FALSE(partitionKeys[3].at("ds").has_value());
+  ASSERT_TRUE(partitionKeys[4].empty());
+}
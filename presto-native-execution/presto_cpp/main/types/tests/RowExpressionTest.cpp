@@ -17,6 +17,7 @@
 #include "presto_cpp/main/types/PrestoToVeloxExpr.h"
 #include "presto_cpp/presto_protocol/presto_protocol.h"
 #include "velox/core/Expressions.h"
+#include "velox/functions/prestosql/registration/RegistrationFunctions.h"
 #include "velox/type/Type.h"
 
 using namespace facebook::presto;
@@ -25,6 +26,11 @@ using namespace facebook::velox::core;
 
 class RowExpressionTest : public ::testing::Test {
  public:
+  static void SetUpTestCase() {
+    // The determinism of the functions is looked up in the registry.
+    functions::prestosql::registerAllScalarFunctions("presto.default.");
+  }
+
   void SetUp() override {
     pool_ = memory::addDefaultLeafMemoryPool();
     converter_ = std::make_unique<VeloxExprConverter>(pool_.get());
@@ -390,6 +396,120 @@ TEST_F(RowExpressionTest, date) {
   testConstantExpression(str, "DATE", "\"2019-10-31\"");
 }
 
+TEST_F(RowExpressionTest, interning) {
+  static const std::string kEqual = R"##(
+      {
+        "@type": "call",
+        "arguments": [
+          {
+            "@type": "variable",
+            "name": "name",
+            "type": "varchar(25)"
+          },
+          {
+            "@type": "constant",
+            "type": "varchar(25)",
+            "valueBlock": "DgAAAFZBUklBQkxFX1dJRFRIAQAAAAMAAAAAAwAAAGZvbw=="
+          }
+        ],
+        "displayName": "EQUAL",
+        "functionHandle": {
+          "@type": "$static",
+          "signature": {
+            "argumentTypes": [
+              "varchar(25)",
+              "varchar(25)"
+            ],
+            "kind": "SCALAR",
+            "longVariableConstraints": [],
+            "name": "presto.default.$operator$equal",
+            "returnType": "boolean",
+            "typeVariableConstraints": [],
+            "variableArity": false
+          }
+        },
+        "returnType": "boolean"
+      }
+  )##";
+  static const std::string kVariable = R"##(
+      {
+        "@type": "variable",
+        "name": "name",
+        "type": "varchar(25)"
+      }
+  )##";
+
+  // Equal expressions converted from distinct row expressions are shared.
+  std::shared_ptr<protocol::RowExpression> first = json::parse(kEqual);
+  std::shared_ptr<protocol::RowExpression> second = json::parse(kEqual);
+  auto firstExpr = converter_->toVeloxExpr(first);
+  auto secondExpr = converter_->toVeloxExpr(second);
+  ASSERT_EQ(firstExpr.get(), secondExpr.get());
+
+  // So are the common subexpressions.
+  std::shared_ptr<protocol::RowExpression> variable = json::parse(kVariable);
+  auto variableExpr = converter_->toVeloxExpr(variable);
+  ASSERT_EQ(firstExpr->inputs()[0].get(), variableExpr.get());
+}
+
+TEST_F(RowExpressionTest, nonDeterministicNotInterned) {
+  static const std::string kRand = R"##(
+      {
+        "@type": "call",
+        "arguments": [],
+        "displayName": "rand",
+        "functionHandle": {
+          "@type": "$static",
+          "signature": {
+            "argumentTypes": [],
+            "kind": "SCALAR",
+            "longVariableConstraints": [],
+            "name": "presto.default.rand",
+            "returnType": "double",
+            "typeVariableConstraints": [],
+            "variableArity": false
+          }
+        },
+        "returnType": "double"
+      }
+  )##";
+  static const std::string kNegateRand = R"##(
+      {
+        "@type": "call",
+        "arguments": [)##" +
+      kRand + R"##(],
+        "displayName": "NEGATION",
+        "functionHandle": {
+          "@type": "$static",
+          "signature": {
+            "argumentTypes": ["double"],
+            "kind": "SCALAR",
+            "longVariableConstraints": [],
+            "name": "presto.default.$operator$negation",
+            "returnType": "double",
+            "typeVariableConstraints": [],
+            "variableArity": false
+          }
+        },
+        "returnType": "double"
+      }
+  )##";
+
+  // Each call of rand() is evaluated on its own, as are its parents.
+  std::shared_ptr<protocol::RowExpression> first = json::parse(kRand);
+  std::shared_ptr<protocol::RowExpression> second = json::parse(kRand);
+  ASSERT_NE(
+      converter_->toVeloxExpr(first).get(),
+      converter_->toVeloxExpr(second).get());
+  std::shared_ptr<protocol::RowExpression> firstNegate =
+      json::parse(kNegateRand);
+  std::shared_ptr<protocol::RowExpression> secondNegate =
+      json::parse(kNegateRand);
+  ASSERT_NE(
+      converter_->toVeloxExpr(firstNegate).get(),
+      converter_->toVeloxExpr(secondNegate).get());
+}
+
 TEST_F(RowExpressionTest, call) {
   static const std::array<std::string, 2> jsonStrings{
       R"##(
@@ -410,3 +410,48 @@ TEST_F(TestTypeSignature, decimalType) {
       parseTypeSignature("decimal(, 20)");
       , VeloxUserError, "Failed to parse type [decimal(, 20)]");
 }
+
+TEST_F(TestTypeSignature, fastParser) {
+  // The hand-written parser agrees with the ANTLR parser.
+  for (const auto& signature : std::vector<std::string>{
+           "bigint",
+           "INT",
+           "double precision",
+           "varchar(25)",
+           "varbinary",
+           "decimal(10, 5)",
+           "array(array(int))",
+           "map(varchar,array(double))",
+           "row(a bigint,b varchar)",
+           "RoW(col iNt, \"x y\" double precision)",
+           "row(double double precision)",
+           "row(row row(a bigint), map map(int, int))",
+           "timestamp with time zone",
+           "json",
+           "hyperloglog"}) {
+    SCOPED_TRACE(signature);
+    auto type = tryParseTypeSignature(signature);
+    ASSERT_NE(type, nullptr);
+    ASSERT_EQ(
+        type->toString(),
+        TypeSignatureTypeConverter::parse(signature)->toString());
+  }
+
+  // The signatures it doesn't handle are left to the ANTLR parser.
+  for (const auto& signature : std::vector<std::string>{
+           "decimal",
+           "decimal(20)",
+           "row(time with time zone)",
+           "function(boolean,varchar(5),boolean)",
+           "array(int",
+           "map(int)"}) {
+    SCOPED_TRACE(signature);
+    ASSERT_EQ(tryParseTypeSignature(signature), nullptr);
+    ASSERT_ANY_THROW(parseTypeSignature(signature));
+  }
+
+  // The parsed types are memoized.
+  ASSERT_EQ(
+      parseTypeSignature("row(a map(int, array(varchar)))").get(),
+      parseTypeSignature("row(a map(int, array(varchar)))").get());
+}
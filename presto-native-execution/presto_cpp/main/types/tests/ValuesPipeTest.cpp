@@ -92,6 +92,42 @@ TEST_F(TestValues, valuesRowVector) {
   }
 }
 
+TEST_F(TestValues, valuesBatches) {
+  std::string str = slurp(getDataPath("ValuesNode.json"));
+
+  json j = json::parse(str);
+  std::shared_ptr<protocol::ValuesNode> p = j;
+  // Repeats the 3 rows up to 25'002 rows.
+  const auto rows = p->rows;
+  while (p->rows.size() < 25'002) {
+    p->rows.insert(p->rows.end(), rows.begin(), rows.end());
+  }
+
+  auto pool = memory::addDefaultLeafMemoryPool();
+  VeloxInteractiveQueryPlanConverter converter(pool.get());
+  auto values = std::dynamic_pointer_cast<const core::ValuesNode>(
+      converter.toVeloxQueryPlan(
+          std::dynamic_pointer_cast<protocol::PlanNode>(p),
+          nullptr,
+          "20201107_130540_00011_wrpkw.1.2.3"));
+
+  ASSERT_NE(values, nullptr);
+  ASSERT_EQ(values->values().size(), 3);
+  ASSERT_EQ(values->values()[0]->size(), 10'000);
+  ASSERT_EQ(values->values()[1]->size(), 10'000);
+  ASSERT_EQ(values->values()[2]->size(), 5'002);
+
+  int32_t row = 0;
+  for (const auto& batch : values->values()) {
+    auto ints = batch->childAt(0)->asFlatVector<int32_t>();
+    auto strings = batch->childAt(1)->asFlatVector<StringView>();
+    for (auto i = 0; i < batch->size(); ++i, ++row) {
+      ASSERT_EQ(ints->valueAt(i), row % 3 + 1);
+      ASSERT_EQ(strings->valueAt(i), StringView(std::string(1, 'a' + row % 3)));
+    }
+  }
+}
+
 TEST_F(TestValues, valuesPlan) {
   // select a, b from (VALUES (1, 'a'), (2, 'b'), (3, 'c')) as t (a, b) where a
   // = 1;
@@ -12,12 +12,16 @@
  * limitations under the License.
  */
 #include "presto_cpp/presto_protocol/Base64Util.h"
+#include <array>
 #include "velox/common/base/BitUtil.h"
-#include "velox/common/encode/Base64.h"
 #include "velox/functions/prestosql/types/TimestampWithTimeZoneType.h"
 #include "velox/vector/ComplexVector.h"
 #include "velox/vector/FlatVector.h"
 
+#if defined(__SSSE3__)
+#include <immintrin.h>
+#endif
+
 namespace facebook::presto::protocol {
 namespace {
 
@@ -32,33 +36,147 @@ static const char* kMap = "MAP";
 static const char* kInt128Array = "INT128_ARRAY";
 static const __int128_t kInt128Mask = ~(static_cast<__int128_t>(1) << 127);
 
+// The 6 bit value of each base64 character, kInvalidBase64 for the others.
+constexpr uint8_t kInvalidBase64 = 0xff;
+constexpr std::array<uint8_t, 256> kBase64Values = []() {
+  std::array<uint8_t, 256> values{};
+  for (auto& value : values) {
+    value = kInvalidBase64;
+  }
+  constexpr std::string_view kAlphabet{
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/"};
+  for (size_t i = 0; i < kAlphabet.size(); ++i) {
+    values[static_cast<uint8_t>(kAlphabet[i])] = i;
+  }
+  return values;
+}();
+
+std::string_view stripBase64Padding(std::string_view encoded) {
+  for (auto i = 0; i < 2 && !encoded.empty() && encoded.back() == '='; ++i) {
+    encoded.remove_suffix(1);
+  }
+  VELOX_USER_CHECK_NE(
+      encoded.size() % 4, 1, "Invalid base64 size: {}", encoded.size());
+  return encoded;
+}
+
+#if defined(__SSSE3__)
+// Decodes the 16 base64 characters at 'input' into 12 bytes at 'output' and
+// writes 16 bytes. Returns false without writing if a character is not valid.
+// See http://0x80.pl/notesen/2016-01-17-sse-base64-decoding.html.
+bool decodeBase64Block(const char* input, char* output) {
+  // Tell the valid characters by their low and high nibbles.
+  const __m128i lutLo = _mm_setr_epi8(
+      0x15,
+      0x11,
+      0x11,
+      0x11,
+      0x11,
+      0x11,
+      0x11,
+      0x11,
+      0x11,
+      0x11,
+      0x13,
+      0x1a,
+      0x1b,
+      0x1b,
+      0x1b,
+      0x1a);
+  const __m128i lutHi = _mm_setr_epi8(
+      0x10,
+      0x10,
+      0x01,
+      0x02,
+      0x04,
+      0x08,
+      0x04,
+      0x08,
+      0x10,
+      0x10,
+      0x10,
+      0x10,
+      0x10,
+      0x10,
+      0x10,
+      0x10);
+  // The offset from a character to its 6 bit value by the high nibble, '/'
+  // apart.
+  const __m128i lutRoll =
+      _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+  const __m128i mask2F = _mm_set1_epi8(0x2f);
+
+  const __m128i chars =
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(input));
+  const __m128i hiNibbles = _mm_and_si128(_mm_srli_epi32(chars, 4), mask2F);
+  const __m128i loNibbles = _mm_and_si128(chars, mask2F);
+  const __m128i hi = _mm_shuffle_epi8(lutHi, hiNibbles);
+  const __m128i lo = _mm_shuffle_epi8(lutLo, loNibbles);
+  if (_mm_movemask_epi8(_mm_cmpgt_epi8(
+          _mm_and_si128(lo, hi), _mm_setzero_si128())) != 0) {
+    return false;
+  }
+  const __m128i eq2F = _mm_cmpeq_epi8(chars, mask2F);
+  const __m128i roll =
+      _mm_shuffle_epi8(lutRoll, _mm_add_epi8(eq2F, hiNibbles));
+  const __m128i values = _mm_add_epi8(chars, roll);
+
+  // Packs the 4 x 6 bits of each 32 bit lane into 24 bits, then the 4 x 24
+  // bits into the first 12 bytes.
+  const __m128i pairs =
+      _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+  const __m128i words = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00011000));
+  const __m128i bytes = _mm_shuffle_epi8(
+      words,
+      _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(output), bytes);
+  return true;
+}
+#endif
+
+// Reads the values of a decoded block. The values are read in place: the
+// strings can point into 'buffer()'.
 struct ByteStream {
-  explicit ByteStream(const char* data, int32_t offset = 0)
-      : data_(data), offset_(offset) {}
+  explicit ByteStream(velox::BufferPtr data)
+      : data_(std::move(data)),
+        rawData_(data_->as<char>()),
+        size_(data_->size()) {}
 
   template <typename T>
   T read() {
     // Directly reading int128 values is not yet supported in ByteStream.
     static_assert(sizeof(T) <= sizeof(uint64_t));
-    T value = *reinterpret_cast<const T*>(data_ + offset_);
-    offset_ += sizeof(T);
+    T value;
+    memcpy(&value, skip(sizeof(T)), sizeof(T));
     return value;
   }
 
-  std::string readString(int32_t size) {
-    std::string value(data_ + offset_, size);
-    offset_ += size;
-    return value;
+  std::string_view readString(int32_t size) {
+    return std::string_view(skip(size), size);
+  }
+
+  void readBytes(size_t size, char* buffer) {
+    memcpy(buffer, skip(size), size);
   }
 
-  void readBytes(int32_t size, char* buffer) {
-    memcpy(buffer, data_ + offset_, size);
+  // Returns the next 'size' bytes, valid as long as 'buffer()'.
+  const char* skip(size_t size) {
+    VELOX_CHECK_LE(
+        offset_ + size, size_, "Unexpected end of block: {} bytes", size_);
+    const auto* data = rawData_ + offset_;
     offset_ += size;
+    return data;
+  }
+
+  const velox::BufferPtr& buffer() const {
+    return data_;
   }
 
  private:
-  const char* data_;
-  int32_t offset_;
+  const velox::BufferPtr data_;
+  const char* rawData_;
+  const uint64_t size_;
+  uint64_t offset_{0};
 };
 
 // ByteStream::read specialization for int128_t
@@ -101,9 +219,15 @@ velox::VectorPtr readScalarBlock(
   velox::BufferPtr buffer =
       velox::AlignedBuffer::allocate<T>(positionCount, pool);
   auto rawBuffer = buffer->asMutable<T>();
-  for (auto i = 0; i < positionCount; i++) {
-    if (!rawNulls || !velox::bits::isBitNull(rawNulls, i)) {
-      rawBuffer[i] = stream.read<T>();
+  if (!rawNulls) {
+    // The values are consecutive, the nulls are not in the block.
+    stream.readBytes(
+        positionCount * sizeof(T), reinterpret_cast<char*>(rawBuffer));
+  } else {
+    for (auto i = 0; i < positionCount; i++) {
+      if (!velox::bits::isBitNull(rawNulls, i)) {
+        rawBuffer[i] = stream.read<T>();
+      }
     }
   }
 
@@ -186,18 +310,16 @@ velox::VectorPtr readVariableWidthBlock(
       velox::AlignedBuffer::allocate<int32_t>(positionCount + 1, pool);
   auto rawOffsets = offsets->asMutable<int32_t>();
   rawOffsets[0] = 0;
-  for (auto i = 0; i < positionCount; i++) {
-    rawOffsets[i + 1] = stream.read<int32_t>();
-  }
+  stream.readBytes(
+      positionCount * sizeof(int32_t),
+      reinterpret_cast<char*>(rawOffsets + 1));
 
   auto nulls = readNulls(positionCount, stream, pool);
 
   auto totalSize = stream.read<int32_t>();
 
-  velox::BufferPtr stringBuffer =
-      velox::AlignedBuffer::allocate<char>(totalSize, pool);
-  auto rawString = stringBuffer->asMutable<char>();
-  stream.readBytes(totalSize, rawString);
+  // The strings point into the decoded block.
+  const char* rawString = stream.skip(totalSize);
 
   velox::BufferPtr buffer =
       velox::AlignedBuffer::allocate<velox::StringView>(positionCount, pool);
@@ -213,12 +335,12 @@ velox::VectorPtr readVariableWidthBlock(
       nulls,
       positionCount,
       buffer,
-      std::vector<velox::BufferPtr>{stringBuffer});
+      std::vector<velox::BufferPtr>{stream.buffer()});
 }
 
 template <velox::TypeKind Kind>
 velox::VectorPtr readScalarBlock(
-    const std::string& encoding,
+    std::string_view encoding,
     const velox::TypePtr& type,
     ByteStream& stream,
     velox::memory::MemoryPool* pool) {
@@ -259,7 +381,7 @@ velox::VectorPtr readRleBlock(
 
   // skip the encoding of the values
   auto encodingLength = stream.read<int32_t>();
-  auto encoding = stream.readString(encodingLength);
+  stream.skip(encodingLength);
 
   auto innerCount = stream.read<int32_t>();
   VELOX_CHECK_EQ(
@@ -293,9 +415,9 @@ auto readArrayOrMapFinalPart(
   velox::BufferPtr offsets =
       velox::AlignedBuffer::allocate<int32_t>(positionCount + 1, pool);
   auto rawOffsets = offsets->asMutable<int32_t>();
-  for (auto i = 0; i < positionCount + 1; i++) {
-    rawOffsets[i] = stream.read<int32_t>();
-  }
+  stream.readBytes(
+      (positionCount + 1) * sizeof(int32_t),
+      reinterpret_cast<char*>(rawOffsets));
 
   velox::BufferPtr nulls = readNulls(positionCount, stream, pool);
 
@@ -321,7 +443,7 @@ velox::VectorPtr readBlockInt(
     velox::memory::MemoryPool* pool) {
   // read the encoding
   auto encodingLength = stream.read<int32_t>();
-  std::string encoding = stream.readString(encodingLength);
+  const auto encoding = stream.readString(encodingLength);
 
   if (encoding == kArray) {
     auto elements = readBlockInt(type->asArray().elementType(), stream, pool);
@@ -339,9 +461,7 @@ velox::VectorPtr readBlockInt(
 
     // We aren't using hashtable.
     auto hashtableSize = stream.read<int32_t>();
-    for (auto i = 0; i < hashtableSize; i++) {
-      stream.read<int32_t>();
-    }
+    stream.skip(hashtableSize * sizeof(int32_t));
 
     auto [nulls, positionCount, offsets, sizes] =
         readArrayOrMapFinalPart(stream, pool);
@@ -407,10 +527,68 @@ velox::VectorPtr readBlock(
     const velox::TypePtr& type,
     const std::string& base64Encoded,
     velox::memory::MemoryPool* pool) {
-  const std::string data = velox::encoding::Base64::decode(base64Encoded);
+  auto data = velox::AlignedBuffer::allocate<char>(
+      base64DecodedSize(base64Encoded) + kBase64DecodePadding, pool);
+  data->setSize(decodeBase64(base64Encoded, data->asMutable<char>()));
 
-  ByteStream stream(data.data());
+  ByteStream stream(std::move(data));
   return readBlockInt(type, stream, pool);
 }
 
+size_t base64DecodedSize(std::string_view encoded) {
+  const auto size = stripBase64Padding(encoded).size();
+  return size / 4 * 3 + (size % 4 == 0 ? 0 : size % 4 - 1);
+}
+
+size_t decodeBase64(std::string_view encoded, char* output) {
+  encoded = stripBase64Padding(encoded);
+  const auto* input = reinterpret_cast<const uint8_t*>(encoded.data());
+  const auto size = encoded.size();
+  size_t i = 0;
+  char* out = output;
+#if defined(__SSSE3__)
+  // Stops at the first invalid character, the scalar loop reports it.
+  for (; i + 16 <= size; i += 16, out += 12) {
+    if (!decodeBase64Block(encoded.data() + i, out)) {
+      break;
+    }
+  }
+#endif
+  for (; i + 4 <= size; i += 4, out += 3) {
+    const uint32_t a = kBase64Values[input[i]];
+    const uint32_t b = kBase64Values[input[i + 1]];
+    const uint32_t c = kBase64Values[input[i + 2]];
+    const uint32_t d = kBase64Values[input[i + 3]];
+    VELOX_USER_CHECK_EQ(
+        (a | b | c | d) & 0xc0, 0, "Invalid base64 character at {}", i);
+    const uint32_t bits = a << 18 | b << 12 | c << 6 | d;
+    out[0] = bits >> 16;
+    out[1] = bits >> 8;
+    out[2] = bits;
+  }
+  // The last 2 or 3 characters of an unpadded size.
+  if (i < size) {
+    const auto remaining = size - i;
+    uint32_t bits = 0;
+    for (auto j = 0; j < remaining; ++j) {
+      const uint32_t value = kBase64Values[input[i + j]];
+      VELOX_USER_CHECK_NE(
+          value, kInvalidBase64, "Invalid base64 character at {}", i + j);
+      bits |= value << (18 - 6 * j);
+    }
+    out[0] = bits >> 16;
+    if (remaining == 3) {
+      out[1] = bits >> 8;
+    }
+    out += remaining - 1;
+  }
+  return out - output;
+}
+
+std::string decodeBase64(std::string_view encoded) {
+  std::string decoded(base64DecodedSize(encoded) + kBase64DecodePadding, '\0');
+  decoded.resize(decodeBase64(encoded, decoded.data()));
+  return decoded;
+}
+
 } // namespace facebook::presto::protocol
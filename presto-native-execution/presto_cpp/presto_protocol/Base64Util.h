@@ -12,16 +12,35 @@
  * limitations under the License.
  */
 #pragma once
+#include <string_view>
 #include "velox/vector/BaseVector.h"
 
 namespace facebook::presto::protocol {
 
 // Deserializes base64-encoded string created by
 // presto-common/src/main/java/com/facebook/presto/common/block/BlockEncodingManager.java
-// into vector.
+// into vector. The values are decoded straight into the vector buffers and the
+// strings of VARIABLE_WIDTH blocks point into the decoded block.
 // TODO Refactor to avoid duplicating logic in PrestoSerializer.
 velox::VectorPtr readBlock(
     const velox::TypePtr& type,
     const std::string& base64Encoded,
     velox::memory::MemoryPool* pool);
+
+/// The decodeBase64() output must have this many bytes of room past the
+/// decoded size.
+constexpr size_t kBase64DecodePadding = 16;
+
+/// Returns the size of the base64 'encoded', with or without padding, once
+/// decoded. Throws if the size is not a valid base64 size.
+size_t base64DecodedSize(std::string_view encoded);
+
+/// Decodes the base64 'encoded', with or without padding, into 'output' which
+/// must have room for base64DecodedSize() + kBase64DecodePadding bytes.
+/// Decodes 16 characters at a time with SSSE3 if available. Returns the
+/// decoded size. Throws on invalid characters.
+size_t decodeBase64(std::string_view encoded, char* output);
+
+/// Returns the base64 'encoded' decoded.
+std::string decodeBase64(std::string_view encoded);
 } // namespace facebook::presto::protocol
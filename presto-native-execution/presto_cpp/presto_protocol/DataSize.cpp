@@ -13,14 +13,29 @@
  */
 #include "presto_cpp/presto_protocol/DataSize.h"
 #include <math.h>
+#include "presto_cpp/presto_protocol/ValueAndUnit.h"
 
 namespace facebook::presto::protocol {
+namespace {
+struct DataUnitName {
+  std::string_view name;
+  DataUnit unit;
+};
+
+constexpr DataUnitName kDataUnitNames[] = {
+    {"B", DataUnit::BYTE},
+    {"kB", DataUnit::KILOBYTE},
+    {"MB", DataUnit::MEGABYTE},
+    {"GB", DataUnit::GIGABYTE},
+    {"TB", DataUnit::TERABYTE},
+    {"PB", DataUnit::PETABYTE},
+};
+} // namespace
 
 DataSize::DataSize(const std::string& string) {
-  static const RE2 kPattern(R"(^\s*(\d+(?:\.\d+)?)\s*([a-zA-Z]+)\s*$)");
   double value;
-  std::string unit;
-  if (!RE2::FullMatch(string, kPattern, &value, &unit)) {
+  std::string_view unit;
+  if (!parseValueAndUnit(string, value, unit)) {
     throw DataSizeStringInvalid();
   }
 
@@ -58,45 +73,22 @@ double DataSize::toBytesPerDataUnit(DataUnit dataUnit) {
   }
 }
 
-DataUnit DataSize::valueOfDataUnit(const std::string& dataUnitString) const {
-  if (dataUnitString == "B") {
-    return DataUnit::BYTE;
-  }
-  if (dataUnitString == "kB") {
-    return DataUnit::KILOBYTE;
-  }
-  if (dataUnitString == "MB") {
-    return DataUnit::MEGABYTE;
-  }
-  if (dataUnitString == "GB") {
-    return DataUnit::GIGABYTE;
-  }
-  if (dataUnitString == "TB") {
-    return DataUnit::TERABYTE;
-  }
-  if (dataUnitString == "PB") {
-    return DataUnit::PETABYTE;
+DataUnit DataSize::valueOfDataUnit(std::string_view dataUnitString) const {
+  for (const auto& dataUnitName : kDataUnitNames) {
+    if (dataUnitName.name == dataUnitString) {
+      return dataUnitName.unit;
+    }
   }
   throw DataSizeDataUnitUnsupported();
 }
 
 std::string DataSize::dataUnitToString(DataUnit dataUnit) const {
-  switch (dataUnit) {
-    case DataUnit::BYTE:
-      return "B";
-    case DataUnit::KILOBYTE:
-      return "kB";
-    case DataUnit::MEGABYTE:
-      return "MB";
-    case DataUnit::GIGABYTE:
-      return "GB";
-    case DataUnit::TERABYTE:
-      return "TB";
-    case DataUnit::PETABYTE:
-      return "PB";
-    default:
-      throw DataSizeDataUnitUnsupported();
+  for (const auto& dataUnitName : kDataUnitNames) {
+    if (dataUnitName.unit == dataUnit) {
+      return std::string(dataUnitName.name);
+    }
   }
+  throw DataSizeDataUnitUnsupported();
 }
 
 } // namespace facebook::presto::protocol
@@ -12,7 +12,9 @@
  * limitations under the License.
  */
 #pragma once
-#include <re2/re2.h>
+#include <exception>
+#include <string>
+#include <string_view>
 
 namespace facebook::presto::protocol {
 
@@ -47,7 +49,7 @@ class DataSize {
 
   static double toBytesPerDataUnit(DataUnit dataUnit);
 
-  DataUnit valueOfDataUnit(const std::string& dataUnitString) const;
+  DataUnit valueOfDataUnit(std::string_view dataUnitString) const;
 
   std::string dataUnitToString(DataUnit dataUnit) const;
 
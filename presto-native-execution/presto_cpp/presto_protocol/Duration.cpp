@@ -12,14 +12,29 @@
  * limitations under the License.
  */
 #include "presto_cpp/presto_protocol/Duration.h"
+#include "presto_cpp/presto_protocol/ValueAndUnit.h"
 
 namespace facebook::presto::protocol {
+namespace {
+struct TimeUnitName {
+  std::string_view name;
+  TimeUnit unit;
+};
 
-Duration::Duration(const std::string& duration) {
-  static const RE2 kPattern(R"(^\s*(\d+(?:\.\d+)?)\s*([a-zA-Z]+)\s*$)");
+constexpr TimeUnitName kTimeUnitNames[] = {
+    {"ns", TimeUnit::NANOSECONDS},
+    {"us", TimeUnit::MICROSECONDS},
+    {"ms", TimeUnit::MILLISECONDS},
+    {"s", TimeUnit::SECONDS},
+    {"m", TimeUnit::MINUTES},
+    {"h", TimeUnit::HOURS},
+    {"d", TimeUnit::DAYS},
+};
+} // namespace
 
-  std::string unit;
-  if (!RE2::FullMatch(duration, kPattern, &value_, &unit)) {
+Duration::Duration(const std::string& duration) {
+  std::string_view unit;
+  if (!parseValueAndUnit(duration, value_, unit)) {
     throw DurationStringInvalid(duration);
   }
 
@@ -58,50 +73,22 @@ double Duration::toMillisPerTimeUnit(TimeUnit timeUnit) {
   }
 }
 
-TimeUnit Duration::valueOfTimeUnit(const std::string& timeUnitString) const {
-  if (timeUnitString == "ns") {
-    return TimeUnit::NANOSECONDS;
-  }
-  if (timeUnitString == "us") {
-    return TimeUnit::MICROSECONDS;
-  }
-  if (timeUnitString == "ms") {
-    return TimeUnit::MILLISECONDS;
-  }
-  if (timeUnitString == "s") {
-    return TimeUnit::SECONDS;
-  }
-  if (timeUnitString == "m") {
-    return TimeUnit::MINUTES;
-  }
-  if (timeUnitString == "h") {
-    return TimeUnit::HOURS;
-  }
-  if (timeUnitString == "d") {
-    return TimeUnit::DAYS;
+TimeUnit Duration::valueOfTimeUnit(std::string_view timeUnitString) const {
+  for (const auto& timeUnitName : kTimeUnitNames) {
+    if (timeUnitName.name == timeUnitString) {
+      return timeUnitName.unit;
+    }
   }
   throw DurationTimeUnitUnsupported();
 }
 
 std::string Duration::timeUnitToString(TimeUnit timeUnit) const {
-  switch (timeUnit) {
-    case TimeUnit::NANOSECONDS:
-      return "ns";
-    case TimeUnit::MICROSECONDS:
-      return "us";
-    case TimeUnit::MILLISECONDS:
-      return "ms";
-    case TimeUnit::SECONDS:
-      return "s";
-    case TimeUnit::MINUTES:
-      return "m";
-    case TimeUnit::HOURS:
-      return "h";
-    case TimeUnit::DAYS:
-      return "d";
-    default:
-      throw DurationTimeUnitUnsupported();
+  for (const auto& timeUnitName : kTimeUnitNames) {
+    if (timeUnitName.unit == timeUnit) {
+      return std::string(timeUnitName.name);
+    }
   }
+  throw DurationTimeUnitUnsupported();
 }
 
 } // namespace facebook::presto::protocol
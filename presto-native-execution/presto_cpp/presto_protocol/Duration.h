@@ -12,7 +12,11 @@
  * limitations under the License.
  */
 #pragma once
-#include <re2/re2.h>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
 
 namespace facebook::presto::protocol {
 
@@ -64,7 +68,7 @@ class Duration {
 
   static double toMillisPerTimeUnit(TimeUnit timeUnit);
 
-  TimeUnit valueOfTimeUnit(const std::string& timeUnitString) const;
+  TimeUnit valueOfTimeUnit(std::string_view timeUnitString) const;
   std::string timeUnitToString(TimeUnit timeUnit) const;
 
   template <typename T>
@@ -0,0 +1,88 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/presto_protocol/ValueAndUnit.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+namespace facebook::presto::protocol {
+namespace {
+// The characters matched by \s in RE2.
+bool isSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\f' || c == '\r';
+}
+
+bool isDigit(char c) {
+  return c >= '0' && c <= '9';
+}
+
+bool isLetter(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+// Returns the position of the first character at or after 'pos' which does
+// not satisfy 'predicate'.
+template <typename Predicate>
+size_t skip(std::string_view input, size_t pos, Predicate predicate) {
+  while (pos < input.size() && predicate(input[pos])) {
+    ++pos;
+  }
+  return pos;
+}
+
+// Converts the decimal number 'number' like the regex match does, with
+// strtod() on a null terminated copy, which is on the stack for the usual
+// short numbers.
+double toDouble(std::string_view number) {
+  char buffer[64];
+  if (number.size() < sizeof(buffer)) {
+    memcpy(buffer, number.data(), number.size());
+    buffer[number.size()] = '\0';
+    return strtod(buffer, nullptr);
+  }
+  return strtod(std::string(number).c_str(), nullptr);
+}
+} // namespace
+
+bool parseValueAndUnit(
+    std::string_view input,
+    double& value,
+    std::string_view& unit) {
+  const size_t numberBegin = skip(input, 0, isSpace);
+  size_t pos = skip(input, numberBegin, isDigit);
+  if (pos == numberBegin) {
+    return false;
+  }
+  if (pos < input.size() && input[pos] == '.') {
+    const size_t fractionBegin = pos + 1;
+    pos = skip(input, fractionBegin, isDigit);
+    if (pos == fractionBegin) {
+      return false;
+    }
+  }
+  const size_t numberEnd = pos;
+
+  const size_t unitBegin = skip(input, numberEnd, isSpace);
+  const size_t unitEnd = skip(input, unitBegin, isLetter);
+  if (unitEnd == unitBegin || skip(input, unitEnd, isSpace) != input.size()) {
+    return false;
+  }
+
+  value = toDouble(input.substr(numberBegin, numberEnd - numberBegin));
+  unit = input.substr(unitBegin, unitEnd - unitBegin);
+  return true;
+}
+
+} // namespace facebook::presto::protocol
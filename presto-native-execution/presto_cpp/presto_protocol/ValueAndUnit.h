@@ -0,0 +1,30 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <string_view>
+
+namespace facebook::presto::protocol {
+
+/// Splits 'input' of the form '<value><unit>' as in DataSize and Duration
+/// strings, e.g. "1.5 MB" or "10s", into the 'value' and the 'unit' letters.
+/// Accepts the same strings as the pattern
+/// ^\s*(\d+(?:\.\d+)?)\s*([a-zA-Z]+)\s*$ without a regex or allocations.
+/// Returns false if 'input' is not of that form. 'unit' points into 'input'.
+bool parseValueAndUnit(
+    std::string_view input,
+    double& value,
+    std::string_view& unit);
+
+} // namespace facebook::presto::protocol
@@ -14,6 +14,7 @@
 #include <gtest/gtest.h>
 
 #include "presto_cpp/presto_protocol/Base64Util.h"
+#include "velox/common/encode/Base64.h"
 #include "velox/functions/prestosql/types/TimestampWithTimeZoneType.h"
 #include "velox/vector/ComplexVector.h"
 #include "velox/vector/FlatVector.h"
@@ -438,3 +439,92 @@ TEST_F(Base64Test, timestampWithTimezone) {
           ->valueAt(0),
       1825);
 }
+
+TEST_F(Base64Test, decodeBase64) {
+  std::string data;
+  for (auto size = 0; size < 200; ++size) {
+    const auto encoded = encoding::Base64::encode(data.data(), data.size());
+    EXPECT_EQ(base64DecodedSize(encoded), size);
+    EXPECT_EQ(decodeBase64(encoded), data);
+    // Without the padding.
+    auto unpadded = encoded;
+    while (!unpadded.empty() && unpadded.back() == '=') {
+      unpadded.pop_back();
+    }
+    EXPECT_EQ(decodeBase64(unpadded), data);
+    data.push_back(static_cast<char>(size * 37 + 11));
+  }
+
+  const auto encoded = encoding::Base64::encode(data.data(), data.size());
+  for (auto position : {0, 5, 20, 100, 190}) {
+    for (auto invalid : {'*', '=', '\n', '\x80'}) {
+      auto corrupted = encoded;
+      corrupted[position] = invalid;
+      EXPECT_THROW(decodeBase64(corrupted), VeloxUserError);
+    }
+  }
+  EXPECT_THROW(decodeBase64("QUJDR"), VeloxUserError);
+}
+
+namespace {
+template <typename T>
+void appendValue(std::string& block, T value) {
+  block.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+std::string makeBlock(std::string_view encoding, int32_t numRows) {
+  std::string block;
+  appendValue<int32_t>(block, encoding.size());
+  block.append(encoding);
+  appendValue<int32_t>(block, numRows);
+  return block;
+}
+} // namespace
+
+TEST_F(Base64Test, largeBlocks) {
+  constexpr int32_t kNumRows = 1'000;
+  auto longBlock = makeBlock("LONG_ARRAY", kNumRows);
+  appendValue<bool>(longBlock, false);
+  for (int64_t i = 0; i < kNumRows; ++i) {
+    appendValue<int64_t>(longBlock, i * 1'000'003);
+  }
+  auto longVector = readBlock(
+      BIGINT(),
+      encoding::Base64::encode(longBlock.data(), longBlock.size()),
+      pool_.get());
+  ASSERT_EQ(longVector->size(), kNumRows);
+  auto longs = longVector->as<SimpleVector<int64_t>>();
+  for (auto i = 0; i < kNumRows; ++i) {
+    ASSERT_EQ(longs->valueAt(i), i * 1'000'003);
+  }
+
+  auto varcharBlock = makeBlock("VARIABLE_WIDTH", kNumRows);
+  std::string values;
+  for (auto i = 0; i < kNumRows; ++i) {
+    values.append(fmt::format("a string longer than inline {}", i));
+    appendValue<int32_t>(varcharBlock, values.size());
+  }
+  appendValue<bool>(varcharBlock, false);
+  appendValue<int32_t>(varcharBlock, values.size());
+  varcharBlock.append(values);
+  auto varcharVector = readBlock(
+      VARCHAR(),
+      encoding::Base64::encode(varcharBlock.data(), varcharBlock.size()),
+      pool_.get());
+  ASSERT_EQ(varcharVector->size(), kNumRows);
+  auto strings = varcharVector->as<SimpleVector<StringView>>();
+  for (auto i = 0; i < kNumRows; ++i) {
+    ASSERT_EQ(
+        strings->valueAt(i).str(),
+        fmt::format("a string longer than inline {}", i));
+  }
+
+  // A truncated block.
+  varcharBlock.resize(varcharBlock.size() - 10);
+  EXPECT_THROW(
+      readBlock(
+          VARCHAR(),
+          encoding::Base64::encode(varcharBlock.data(), varcharBlock.size()),
+          pool_.get()),
+      VeloxRuntimeError);
+}
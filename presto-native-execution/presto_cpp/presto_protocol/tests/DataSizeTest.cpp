@@ -63,3 +63,18 @@ TEST_F(DataSizeTest, basic) {
   ASSERT_NEAR(d.getValue(DataUnit::TERABYTE), 0.00390625, 0.0000000001);
   ASSERT_NEAR(d.getValue(DataUnit::PETABYTE), 3.814697265625e-06, 0.0000000001);
 }
+
+TEST_F(DataSizeTest, whitespace) {
+  assertDataSize(DataSize(" \t12 MB\r\n"), 12, DataUnit::MEGABYTE, "12.000000MB");
+  assertDataSize(DataSize("0.25kB "), 0.25, DataUnit::KILOBYTE, "0.250000kB");
+
+  ASSERT_THROW(DataSize(""), DataSizeStringInvalid);
+  ASSERT_THROW(DataSize("  "), DataSizeStringInvalid);
+  ASSERT_THROW(DataSize("MB"), DataSizeStringInvalid);
+  ASSERT_THROW(DataSize("12"), DataSizeStringInvalid);
+  ASSERT_THROW(DataSize("12. MB"), DataSizeStringInvalid);
+  ASSERT_THROW(DataSize("1 2MB"), DataSizeStringInvalid);
+  ASSERT_THROW(DataSize("12 M B"), DataSizeStringInvalid);
+  ASSERT_THROW(DataSize("-12MB"), DataSizeStringInvalid);
+  ASSERT_THROW(DataSize("12MB."), DataSizeStringInvalid);
+}
@@ -73,3 +73,20 @@ TEST_F(DurationTest, chronoConversion) {
   EXPECT_EQ(d.asChronoDuration<std::chrono::minutes>().count(), 120);
   EXPECT_EQ(d.asChronoDuration<std::chrono::hours>().count(), 2);
 }
+
+TEST_F(DurationTest, parse) {
+  assertDuration(Duration(" 1.5 h\t"), 1.5, TimeUnit::HOURS, "1.50h");
+  assertDuration(Duration("30us"), 30, TimeUnit::MICROSECONDS, "30.00us");
+
+  // A long number is converted like a short one.
+  const std::string digits(100, '1');
+  EXPECT_EQ(Duration(digits + "ns").getValue(), std::stod(digits));
+
+  ASSERT_THROW(Duration(""), DurationStringInvalid);
+  ASSERT_THROW(Duration("s"), DurationStringInvalid);
+  ASSERT_THROW(Duration("1.s"), DurationStringInvalid);
+  ASSERT_THROW(Duration(".5s"), DurationStringInvalid);
+  ASSERT_THROW(Duration("5 s s"), DurationStringInvalid);
+  ASSERT_THROW(Duration("5e3s"), DurationStringInvalid);
+  ASSERT_THROW(Duration("5 sec"), DurationTimeUnitUnsupported);
+}
@@ -0,0 +1,78 @@
+/*
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "presto_cpp/presto_protocol/ValueAndUnit.h"
+#include <gtest/gtest.h>
+#include <re2/re2.h>
+#include <random>
+#include <string>
+
+using namespace facebook::presto::protocol;
+
+namespace {
+// The pattern DataSize and Duration were parsed with before.
+const RE2& valueAndUnitPattern() {
+  static const RE2 kPattern(R"(^\s*(\d+(?:\.\d+)?)\s*([a-zA-Z]+)\s*$)");
+  return kPattern;
+}
+} // namespace
+
+class ValueAndUnitTest : public ::testing::Test {};
+
+TEST_F(ValueAndUnitTest, basic) {
+  double value;
+  std::string_view unit;
+  ASSERT_TRUE(parseValueAndUnit(" 1.5 MB\t", value, unit));
+  EXPECT_EQ(value, 1.5);
+  EXPECT_EQ(unit, "MB");
+  ASSERT_TRUE(parseValueAndUnit("10s", value, unit));
+  EXPECT_EQ(value, 10);
+  EXPECT_EQ(unit, "s");
+
+  for (const auto* input :
+       {"", "MB", "1", "1.MB", ".5MB", "1.5.5MB", "1 M B", "-1MB", "1e3MB"}) {
+    EXPECT_FALSE(parseValueAndUnit(input, value, unit)) << input;
+  }
+}
+
+// Compares the parser with the regex on random strings over the characters
+// of the pattern. The strings are kept short: RE2 does not convert numbers of
+// more than 200 characters.
+TEST_F(ValueAndUnitTest, randomAgainstRegex) {
+  static constexpr std::string_view kAlphabet{" \t\n\v.0123456789kMBsmx+-e"};
+  std::mt19937 rng(1);
+  std::uniform_int_distribution<size_t> lengths(0, 12);
+  std::uniform_int_distribution<size_t> chars(0, kAlphabet.size() - 1);
+  size_t numMatches{0};
+  for (auto i = 0; i < 1'000'000; ++i) {
+    std::string input(lengths(rng), ' ');
+    for (auto& c : input) {
+      c = kAlphabet[chars(rng)];
+    }
+    double expectedValue;
+    std::string expectedUnit;
+    const bool expected = RE2::FullMatch(
+        input, valueAndUnitPattern(), &expectedValue, &expectedUnit);
+    double value;
+    std::string_view unit;
+    ASSERT_EQ(parseValueAndUnit(input, value, unit), expected)
+        << "'" << input << "'";
+    if (expected) {
+      ++numMatches;
+      ASSERT_EQ(value, expectedValue) << "'" << input << "'";
+      ASSERT_EQ(unit, expectedUnit) << "'" << input << "'";
+    }
+  }
+  // Enough of the strings match for the comparison to cover the values.
+  EXPECT_GT(numMatches, 1'000);
+}
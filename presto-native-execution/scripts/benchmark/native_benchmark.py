@@ -0,0 +1,328 @@
+#!/usr/bin/env python3
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+"""Runs the TPC-H and TPC-DS suites on a cluster of native workers.
+
+Starts the native workers against a running coordinator, optionally
+generates the TPC-H tables from the tpch connector, runs the benchto
+queries of presto-benchto-benchmarks and writes a JSON report with the
+wall time, CPU time and peak memory of each query and the deltas of the
+presto_cpp counters of the workers over each query. Reports of two builds
+are compared with the 'compare' command.
+
+    native_benchmark.py run --coordinator http://localhost:8080 \\
+        --presto-server _build/release/presto_cpp/main/presto_server \\
+        --workers 2 --suite tpch --schema tpch_sf10 --generate tpch.sf10 \\
+        --output new.json
+    native_benchmark.py compare old.json new.json
+"""
+
+import argparse
+import json
+import os
+import re
+import shutil
+import signal
+import subprocess
+import sys
+import tempfile
+import time
+import urllib.error
+import urllib.request
+import uuid
+
+SCRIPT_DIR = os.path.dirname(os.path.abspath(__file__))
+NATIVE_DIR = os.path.dirname(os.path.dirname(SCRIPT_DIR))
+SQL_DIR = os.path.join(
+    os.path.dirname(NATIVE_DIR),
+    "presto-benchto-benchmarks/src/main/resources/sql/presto")
+
+TPCH_TABLES = [
+    "customer", "lineitem", "nation", "orders", "part", "partsupp", "region",
+    "supplier"
+]
+
+# Prometheus text lines of the worker metrics, e.g.
+# 'presto_cpu_num_drivers 12' or 'name{quantile="0.5"} 3'.
+METRIC_LINE = re.compile(r"^([a-zA-Z_:][a-zA-Z0-9_:]*)(?:\{[^}]*\})?\s+(\S+)$")
+
+
+def http_request(url, data=None, headers=None, method=None):
+    request = urllib.request.Request(
+        url, data=data, headers=headers or {}, method=method)
+    with urllib.request.urlopen(request, timeout=600) as response:
+        return response.read().decode("utf-8")
+
+
+def execute(args, sql, session=None):
+    """Runs 'sql' to completion and returns the final query stats."""
+    headers = {
+        "X-Presto-User": args.user,
+        "X-Presto-Catalog": args.catalog,
+        "X-Presto-Schema": args.schema,
+    }
+    if session:
+        headers["X-Presto-Session"] = ",".join(
+            f"{k}={v}" for k, v in session.items())
+    result = json.loads(
+        http_request(f"{args.coordinator}/v1/statement",
+                     sql.encode("utf-8"), headers, "POST"))
+    while "nextUri" in result:
+        result = json.loads(http_request(result["nextUri"]))
+    if "error" in result:
+        raise RuntimeError(result["error"].get("message", str(result["error"])))
+    return result["stats"]
+
+
+def worker_metrics(port):
+    """Returns the presto_cpp counters of the worker at 'port'."""
+    try:
+        text = http_request(f"http://127.0.0.1:{port}/v1/metrics")
+    except (urllib.error.URLError, OSError):
+        return {}
+    metrics = {}
+    for line in text.splitlines():
+        match = METRIC_LINE.match(line)
+        if match and "{" not in line:
+            try:
+                metrics[match.group(1)] = float(match.group(2))
+            except ValueError:
+                pass
+    return metrics
+
+
+def all_metrics(ports):
+    total = {}
+    for port in ports:
+        for name, value in worker_metrics(port).items():
+            total[name] = total.get(name, 0) + value
+    return total
+
+
+def metric_deltas(before, after):
+    return {
+        name: after[name] - before.get(name, 0)
+        for name in sorted(after)
+        if after[name] != before.get(name, 0)
+    }
+
+
+def start_workers(args):
+    """Starts 'args.workers' native workers with their own etc directories.
+    Returns their processes and http ports."""
+    root = tempfile.mkdtemp(prefix="native_benchmark_")
+    processes = []
+    ports = []
+    for i in range(args.workers):
+        port = args.worker_base_port + i
+        etc = os.path.join(root, f"worker{i}", "etc")
+        shutil.copytree(args.catalog_dir, os.path.join(etc, "catalog"))
+        with open(os.path.join(etc, "config.properties"), "w") as f:
+            f.write(f"discovery.uri={args.coordinator}\n")
+            f.write(f"presto.version={args.presto_version}\n")
+            f.write(f"http-server.http.port={port}\n")
+            for config in args.worker_config:
+                f.write(f"{config}\n")
+        with open(os.path.join(etc, "node.properties"), "w") as f:
+            f.write("node.environment=benchmark\n")
+            f.write(f"node.id={uuid.uuid4()}\n")
+            f.write("node.ip=127.0.0.1\n")
+            f.write(f"node.location=benchmark-{i}\n")
+        log = open(os.path.join(root, f"worker{i}", "server.log"), "w")
+        processes.append(
+            subprocess.Popen(
+                [args.presto_server, f"--etc_dir={etc}", "--logtostderr=1"],
+                stdout=log,
+                stderr=subprocess.STDOUT))
+        ports.append(port)
+    print(f"Started {args.workers} workers, logs in {root}", file=sys.stderr)
+    return processes, ports
+
+
+def wait_for_workers(args, num_workers):
+    deadline = time.time() + args.startup_timeout
+    while time.time() < deadline:
+        try:
+            nodes = json.loads(http_request(f"{args.coordinator}/v1/node"))
+            if len(nodes) >= num_workers:
+                return
+        except (urllib.error.URLError, OSError, ValueError):
+            pass
+        time.sleep(1)
+    raise RuntimeError(f"{num_workers} workers did not join the coordinator")
+
+
+def generate_tpch(args):
+    """Creates the TPC-H tables of 'args.schema' from the tpch connector
+    schema 'args.generate', e.g. tpch.sf10, if they don't exist."""
+    execute(args, f"CREATE SCHEMA IF NOT EXISTS {args.catalog}.{args.schema}")
+    for table in TPCH_TABLES:
+        print(f"Generating {args.schema}.{table}", file=sys.stderr)
+        execute(
+            args, f"CREATE TABLE IF NOT EXISTS {args.catalog}.{args.schema}."
+            f"{table} AS SELECT * FROM {args.generate}.{table}")
+
+
+def load_queries(args):
+    suite_dir = os.path.join(SQL_DIR, args.suite)
+    names = sorted(
+        name[:-len(".sql")]
+        for name in os.listdir(suite_dir)
+        if name.endswith(".sql"))
+    if args.queries:
+        selected = set(args.queries.split(","))
+        names = [name for name in names if name in selected]
+    queries = {}
+    for name in names:
+        with open(os.path.join(suite_dir, f"{name}.sql")) as f:
+            sql = f.read().strip().rstrip(";")
+        queries[name] = (
+            sql.replace("${database}", args.catalog)
+            .replace("${schema}", args.schema)
+            .replace("${prefix}", ""))
+    return queries
+
+
+def run(args):
+    processes, ports = [], list(args.worker_port)
+    if args.presto_server:
+        processes, started = start_workers(args)
+        ports += started
+    try:
+        wait_for_workers(args, len(ports))
+        if args.generate:
+            generate_tpch(args)
+        session = dict(s.split("=", 1) for s in args.session)
+        results = {}
+        for name, sql in load_queries(args).items():
+            for _ in range(args.prewarm_runs):
+                execute(args, sql, session)
+            runs = []
+            for _ in range(args.runs):
+                before = all_metrics(ports)
+                try:
+                    stats = execute(args, sql, session)
+                except (RuntimeError, urllib.error.URLError) as e:
+                    runs.append({"error": str(e)})
+                    continue
+                runs.append({
+                    "wallMs": stats.get("elapsedTimeMillis"),
+                    "cpuMs": stats.get("cpuTimeMillis"),
+                    "peakMemoryBytes": stats.get("peakMemoryBytes"),
+                    "processedRows": stats.get("processedRows"),
+                    "counters": metric_deltas(before, all_metrics(ports)),
+                })
+            results[name] = runs
+            walls = [r["wallMs"] for r in runs if "wallMs" in r]
+            print(f"{name}: " +
+                  (f"{min(walls)} ms" if walls else runs[-1]["error"]),
+                  file=sys.stderr)
+        report = {
+            "suite": args.suite,
+            "schema": args.schema,
+            "workers": len(ports),
+            "build": args.build_label,
+            "time": time.strftime("%Y-%m-%dT%H:%M:%S"),
+            "queries": results,
+        }
+        with open(args.output, "w") as f:
+            json.dump(report, f, indent=2, sort_keys=True)
+    finally:
+        for process in processes:
+            process.send_signal(signal.SIGTERM)
+        for process in processes:
+            process.wait()
+
+
+def best(runs, key):
+    values = [r[key] for r in runs if r.get(key) is not None]
+    return min(values) if values else None
+
+
+def compare(args):
+    """Prints the best wall and CPU times of each query of both reports and
+    exits with 1 if any query regressed by more than 'args.threshold'."""
+    with open(args.baseline) as f:
+        baseline = json.load(f)["queries"]
+    with open(args.candidate) as f:
+        candidate = json.load(f)["queries"]
+    regressions = []
+    print(f"{'query':<10}{'wall ms':>22}{'cpu ms':>22}{'wall':>8}")
+    for name in sorted(set(baseline) & set(candidate)):
+        base_wall = best(baseline[name], "wallMs")
+        new_wall = best(candidate[name], "wallMs")
+        base_cpu = best(baseline[name], "cpuMs")
+        new_cpu = best(candidate[name], "cpuMs")
+        if base_wall is None or new_wall is None:
+            print(f"{name:<10}{'failed':>22}")
+            continue
+        ratio = new_wall / max(base_wall, 1)
+        print(f"{name:<10}{base_wall:>10} -> {new_wall:<9}"
+              f"{base_cpu:>10} -> {new_cpu:<9}{ratio:>7.2f}x")
+        if ratio > 1 + args.threshold:
+            regressions.append(name)
+    if regressions:
+        print(f"Regressed over {args.threshold:.0%}: {', '.join(regressions)}")
+        sys.exit(1)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    commands = parser.add_subparsers(dest="command", required=True)
+
+    run_parser = commands.add_parser("run", help="Run a suite")
+    run_parser.add_argument("--coordinator", required=True)
+    run_parser.add_argument(
+        "--presto-server", help="presto_server binary to start workers from")
+    run_parser.add_argument("--workers", type=int, default=1)
+    run_parser.add_argument("--worker-base-port", type=int, default=7777)
+    run_parser.add_argument(
+        "--worker-port", type=int, action="append", default=[],
+        help="http port of an already running worker to collect counters of")
+    run_parser.add_argument(
+        "--worker-config", action="append", default=[],
+        help="extra config.properties line of the started workers")
+    run_parser.add_argument(
+        "--catalog-dir", default=os.path.join(NATIVE_DIR, "etc/catalog"))
+    run_parser.add_argument("--presto-version", default="testversion")
+    run_parser.add_argument("--startup-timeout", type=int, default=120)
+    run_parser.add_argument("--suite", choices=["tpch", "tpcds"], default="tpch")
+    run_parser.add_argument("--catalog", default="hive")
+    run_parser.add_argument("--schema", required=True)
+    run_parser.add_argument(
+        "--generate",
+        help="tpch connector schema to create the TPC-H tables from, e.g. "
+        "tpch.sf10. The TPC-DS tables are generated with "
+        "presto-benchto-benchmarks/generate_schemas on a Java cluster")
+    run_parser.add_argument("--queries", help="comma separated, e.g. q01,q06")
+    run_parser.add_argument("--runs", type=int, default=3)
+    run_parser.add_argument("--prewarm-runs", type=int, default=1)
+    run_parser.add_argument(
+        "--session", action="append", default=[], help="name=value")
+    run_parser.add_argument("--user", default="benchmark")
+    run_parser.add_argument("--build-label", default="")
+    run_parser.add_argument("--output", default="benchmark.json")
+
+    compare_parser = commands.add_parser("compare", help="Compare 2 reports")
+    compare_parser.add_argument("baseline")
+    compare_parser.add_argument("candidate")
+    compare_parser.add_argument("--threshold", type=float, default=0.1)
+
+    args = parser.parse_args()
+    if args.command == "run":
+        run(args)
+    else:
+        compare(args)
+
+
+if __name__ == "__main__":
+    main()
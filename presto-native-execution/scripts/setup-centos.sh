@@ -28,6 +28,7 @@ python3 -m pip install regex pyyaml chevron black six
 
 # Required for Antlr4
 dnf install -y libuuid-devel
+dnf install -y libunwind-devel
 
 export CC=/opt/rh/gcc-toolset-9/root/bin/gcc
 export CXX=/opt/rh/gcc-toolset-9/root/bin/g++